@@ -0,0 +1,26 @@
+# Automatically generated by configure - do not modify!
+shared=yes
+build_suffix=
+prefix=/usr/local
+libdir=${prefix}/lib
+incdir=${prefix}/include
+rpath=
+source_path=src
+LIBPREF=lib
+LIBSUF=.a
+extralibs_avutil="-pthread -lm -latomic -lX11"
+extralibs_avcodec="-pthread -lm -latomic"
+extralibs_avformat="-lm -lz -latomic"
+extralibs_avdevice="-lm -latomic"
+extralibs_avfilter="-pthread -lm -latomic"
+extralibs_postproc="-lm -latomic"
+extralibs_swscale="-lm -latomic"
+extralibs_swresample="-lm -latomic"
+avdevice_deps="avfilter swscale avformat avcodec avutil"
+avfilter_deps="swscale avutil"
+swscale_deps="avutil"
+postproc_deps="avutil"
+avformat_deps="avcodec avutil"
+avcodec_deps="avutil"
+swresample_deps="avutil"
+avutil_deps=""
@@ -0,0 +1,10 @@
+static const FFCodec * const codec_list[] = {
+    &ff_rawvideo_encoder,
+    &ff_h264_ni_quadra_encoder,
+    &ff_h265_ni_quadra_encoder,
+    &ff_h264_decoder,
+    &ff_hevc_decoder,
+    &ff_rawvideo_decoder,
+    &ff_h264_ni_quadra_decoder,
+    &ff_h265_ni_quadra_decoder,
+    NULL };
@@ -0,0 +1,2 @@
+static const FFOutputFormat * const outdev_list[] = {
+    NULL };
@@ -0,0 +1,4 @@
+static const FFInputFormat * const demuxer_list[] = {
+    &ff_h264_demuxer,
+    &ff_hevc_demuxer,
+    NULL };
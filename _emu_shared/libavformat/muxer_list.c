@@ -0,0 +1,6 @@
+static const FFOutputFormat * const muxer_list[] = {
+    &ff_framecrc_muxer,
+    &ff_h264_muxer,
+    &ff_hevc_muxer,
+    &ff_null_muxer,
+    NULL };
@@ -0,0 +1,224 @@
+/*
+ * Software emulation of the NETINT libxcoder API - common definitions
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The headers in this directory stand in for the libxcoder headers when
+ * FFmpeg is configured with --enable-ni_quadra_emu. They declare the subset
+ * of the libxcoder 2.79 API used by the NETINT Quadra codecs, filters and
+ * hwcontext, with the same names, signatures and struct members, so that
+ * those sources build unmodified. The implementation in ni_emu*.c runs all
+ * operations in software on the host.
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_DEFS_H
+#define COMPAT_NI_XCODER_NI_DEFS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LIBXCODER_API_VERSION_MAJOR 2
+#define LIBXCODER_API_VERSION_MINOR 79
+
+#define NI_XCODER_REVISION          "5.0.0-emu"
+
+#define QUADRA                      1
+
+#define LIB_API
+
+#define LRETURN goto END
+
+#define NI_INVALID_DEVICE_HANDLE    (-1)
+#define NI_INVALID_SESSION_ID       0xFFFFFFFF
+#define NI_INVALID_IO_SIZE          0
+
+#define NI_MAX_DEVICE_CNT           128
+#define NI_MAX_DEVICE_NAME_LEN      32
+#define MAX_CHAR_IN_DEVICE_NAME     32
+
+#define NI_MAX_NUM_DATA_POINTERS    4
+#define NI_MAX_NUM_OF_DECODER_OUTPUTS 3
+#define NI_MAX_PPU_PARAM_EXPR_CHAR  20
+#define NI_MAX_TX_SZ                0xA00000
+#define NI_FIFO_SZ                  1024
+#define NI_MAX_FIFO_CAPACITY        120
+#define NI_MAX_SEI_DATA             (NI_ENC_MAX_SEI_BUF_SIZE)
+#define NI_ENC_MAX_SEI_BUF_SIZE     (1024 * 3)
+#define NI_MAX_CUSTOM_SEI_DATA      8192
+#define NI_MAX_CUSTOM_SEI_CNT       10
+#define NI_MAX_NUM_AUX_DATA_PER_FRAME 16
+#define NI_MAX_SUPPORT_DRAWBOX_NUM  5
+#define NI_MAX_SUPPORT_WATERMARK_NUM 6
+#define NI_APP_ENC_FRAME_META_DATA_SIZE 64
+#define NI_FW_ENC_BITSTREAM_META_DATA_SIZE 64
+#define NI_FW_META_DATA_SZ          104
+
+#define NI_DEFAULT_KEEP_ALIVE_TIMEOUT 3
+#define NI_MIN_KEEP_ALIVE_TIMEOUT   1
+#define NI_MAX_KEEP_ALIVE_TIMEOUT   100
+
+#define NI_MAX_RESOLUTION_WIDTH     8192
+#define NI_MAX_RESOLUTION_HEIGHT    8192
+#define NI_MAX_RESOLUTION_AREA      (8192 * 5120)
+#define NI_MIN_RESOLUTION_WIDTH     144
+#define NI_MIN_RESOLUTION_HEIGHT    144
+#define NI_MIN_RESOLUTION_WIDTH_JPEG  48
+#define NI_MIN_RESOLUTION_HEIGHT_JPEG 48
+#define NI_MIN_RESOLUTION_WIDTH_SCALER  16
+#define NI_MIN_RESOLUTION_HEIGHT_SCALER 16
+#define NI_MIN_WIDTH                144
+#define NI_MIN_HEIGHT               144
+#define NI_2PASS_ENCODE_MIN_WIDTH   272
+#define NI_2PASS_ENCODE_MIN_HEIGHT  256
+#define NI_PARAM_MAX_WIDTH          8192
+#define NI_PARAM_AV1_MAX_WIDTH      4096
+#define NI_PARAM_AV1_MAX_HEIGHT     4352
+#define NI_PARAM_AV1_MAX_AREA       (4096 * 2304)
+#define NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT 8
+
+#define MAX_NUM_FRAMEPOOL_HWAVFRAME 128
+#define MAX_AV1_ENCODER_GOP_NUM     8
+
+#define NI_NOPTS_VALUE              ((int64_t)0x8000000000000000LL)
+
+#define NI_BEST_MODEL_LOAD_STR      "bestmodelload"
+#define NI_BEST_REAL_LOAD_STR       "bestload"
+
+#define NI_VPU_CEIL(_data, _align)  (((_data) + (_align) - 1) & ~((_align) - 1))
+#define NI_VPU_ALIGN128(_x)         (((_x) + 127) / 128 * 128)
+
+/* Frame indices are allocated from 1..NI_MAX_HWDESC_FRAME_INDEX; P2P
+ * buffers are not emulated so every index is a regular hw frame */
+#define NI_MAX_HWDESC_FRAME_INDEX   4096
+#define NI_GET_MAX_HWDESC_P2P_BUF_ID(x) NI_MAX_HWDESC_FRAME_INDEX
+
+typedef int ni_device_handle_t;
+
+typedef enum {
+    NI_RETCODE_SUCCESS                      = 0,
+    NI_RETCODE_FAILURE                      = -1,
+    NI_RETCODE_INVALID_PARAM                = -2,
+    NI_RETCODE_ERROR_MEM_ALOC               = -3,
+    NI_RETCODE_ERROR_NVME_CMD_FAILED        = -4,
+    NI_RETCODE_ERROR_INVALID_SESSION        = -5,
+    NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE   = -6,
+    NI_RETCODE_PARAM_INVALID_NAME           = -7,
+    NI_RETCODE_PARAM_INVALID_VALUE          = -8,
+    NI_RETCODE_PARAM_ERROR_FRATE            = -9,
+    NI_RETCODE_PARAM_ERROR_BRATE            = -10,
+    NI_RETCODE_PARAM_ERROR_TRATE            = -11,
+    NI_RETCODE_PARAM_ERROR_VBV_BUFFER_SIZE  = -12,
+    NI_RETCODE_PARAM_ERROR_INTRA_PERIOD     = -13,
+    NI_RETCODE_PARAM_ERROR_INTRA_QP         = -14,
+    NI_RETCODE_PARAM_ERROR_GOP_PRESET       = -15,
+    NI_RETCODE_PARAM_ERROR_CU_SIZE_MODE     = -16,
+    NI_RETCODE_PARAM_ERROR_MX_NUM_MERGE     = -17,
+    NI_RETCODE_PARAM_ERROR_DY_MERGE_8X8_EN  = -18,
+    NI_RETCODE_PARAM_ERROR_PIC_WIDTH        = -30,
+    NI_RETCODE_PARAM_ERROR_PIC_HEIGHT       = -31,
+    NI_RETCODE_PARAM_ERROR_OOR              = -40,
+    NI_RETCODE_PARAM_ERROR_ZERO             = -41,
+    NI_RETCODE_PARAM_ERROR_TOO_BIG          = -42,
+    NI_RETCODE_PARAM_ERROR_TOO_SMALL        = -43,
+    NI_RETCODE_PARAM_ERROR_WIDTH_TOO_BIG    = -44,
+    NI_RETCODE_PARAM_ERROR_WIDTH_TOO_SMALL  = -45,
+    NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_BIG   = -46,
+    NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_SMALL = -47,
+    NI_RETCODE_PARAM_ERROR_AREA_TOO_BIG     = -48,
+    NI_RETCODE_PARAM_WARNING_DEPRECATED     = -49,
+    NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION = -50,
+    NI_RETCODE_ERROR_VPU_RECOVERY           = -51,
+    NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL    = 0x3FE,
+} ni_retcode_t;
+
+typedef enum {
+    NI_DEVICE_TYPE_MIN     = 0,
+    NI_DEVICE_TYPE_DECODER = 0,
+    NI_DEVICE_TYPE_ENCODER = 1,
+    NI_DEVICE_TYPE_SCALER  = 2,
+    NI_DEVICE_TYPE_AI      = 3,
+    NI_DEVICE_TYPE_XCODER_MAX = 4,
+    NI_DEVICE_TYPE_UPLOAD  = 4,
+    NI_DEVICE_TYPE_MAX     = 5,
+} ni_device_type_t;
+
+typedef enum {
+    NI_CODEC_FORMAT_H264 = 0,
+    NI_CODEC_FORMAT_H265 = 1,
+    NI_CODEC_FORMAT_VP9  = 2,
+    NI_CODEC_FORMAT_JPEG = 3,
+    NI_CODEC_FORMAT_AV1  = 4,
+} ni_codec_format_t;
+
+typedef enum {
+    NI_PIX_FMT_YUV420P     = 0,
+    NI_PIX_FMT_YUV420P10LE = 1,
+    NI_PIX_FMT_NV12        = 2,
+    NI_PIX_FMT_P010LE      = 3,
+    NI_PIX_FMT_RGBA        = 4,
+    NI_PIX_FMT_BGRA        = 5,
+    NI_PIX_FMT_ARGB        = 6,
+    NI_PIX_FMT_ABGR        = 7,
+    NI_PIX_FMT_BGR0        = 8,
+    NI_PIX_FMT_BGRP        = 9,
+    NI_PIX_FMT_NV16        = 10,
+    NI_PIX_FMT_YUYV422     = 11,
+    NI_PIX_FMT_UYVY422     = 12,
+    NI_PIX_FMT_8_TILED4X4  = 13,
+    NI_PIX_FMT_10_TILED4X4 = 14,
+    NI_PIX_FMT_NONE        = 15,
+} ni_pix_fmt_t;
+
+/* gc620 scaler pixel formats */
+#define GC620_NV12              0
+#define GC620_NV21              1
+#define GC620_I420              2
+#define GC620_P010_MSB          3
+#define GC620_I010              4
+#define GC620_YUYV              5
+#define GC620_UYVY              6
+#define GC620_NV16              7
+#define GC620_RGBA8888          8
+#define GC620_BGRX8888          9
+#define GC620_BGRA8888          10
+#define GC620_ABGR8888          11
+#define GC620_ARGB8888          12
+#define GC620_RGB565            13
+#define GC620_BGR565            14
+#define GC620_B5G5R5X1          15
+#define GC620_RGB888_PLANAR     16
+
+#define NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR 0
+#define NI_PIXEL_PLANAR_FORMAT_PLANAR     1
+#define NI_PIXEL_PLANAR_FORMAT_TILED4X4   3
+
+#define NI_FRAME_LITTLE_ENDIAN  0
+#define NI_FRAME_BIG_ENDIAN     1
+
+typedef enum {
+    PIC_TYPE_I   = 0,
+    PIC_TYPE_P   = 1,
+    PIC_TYPE_B   = 2,
+    PIC_TYPE_IDR = 3,
+} ni_pic_type_t;
+
+#define DECODER_PIC_TYPE_IDR    3
+
+#endif /* COMPAT_NI_XCODER_NI_DEFS_H */
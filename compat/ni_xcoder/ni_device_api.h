@@ -0,0 +1,902 @@
+/*
+ * Software emulation of the NETINT libxcoder API - device and session API
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_DEVICE_API_H
+#define COMPAT_NI_XCODER_NI_DEVICE_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ni_defs.h"
+#include "ni_log.h"
+
+#define NI_MAX_GOP_NUM              8
+#define NI_MAX_REF_PIC              4
+#define NI_CUSTOM_SEI_LOC_BEFORE_VCL 0
+#define NI_CUSTOM_SEI_LOC_AFTER_VCL  1
+#define NI_DEC_CROP_MODE_DISABLE    0
+#define NI_DEC_CROP_MODE_AUTO       1
+#define NI_DEC_CROP_MODE_MANUAL     2
+#define NI_ENABLE_AUD_FOR_GLOBAL_HEADER 2
+#define NI_CODEC_HW_NONE            0
+#define NI_CODEC_HW_ENABLE          (1 << 0)
+#define NI_CODEC_HW_DOWNLOAD        (1 << 1)
+#define NI_CODEC_HW_UPLOAD          (1 << 2)
+#define NI_CODEC_HW_RSVD            (1 << 3)
+#define NI_MAX_ENCODER_QUERY_RETRIES 5000
+#define MOTION_CONSTRAINED_QUALITY_MODE 2
+
+/* scaler operations */
+typedef enum _ni_scaler_opcode {
+    NI_SCALER_OPCODE_SCALE     = 0,
+    NI_SCALER_OPCODE_CROP      = 1,
+    NI_SCALER_OPCODE_PAD       = 2,
+    NI_SCALER_OPCODE_OVERLAY   = 3,
+    NI_SCALER_OPCODE_STACK     = 4,
+    NI_SCALER_OPCODE_ROTATE    = 5,
+    NI_SCALER_OPCODE_DRAWBOX   = 6,
+    NI_SCALER_OPCODE_FLIP      = 7,
+    NI_SCALER_OPCODE_IPOVLY    = 8,
+    NI_SCALER_OPCODE_WATERMARK = 9,
+    NI_SCALER_OPCODE_DELOGO    = 10,
+    NI_SCALER_OPCODE_MERGE     = 11,
+    NI_SCALER_OPCODE_AI_ALIGN  = 12,
+} ni_scaler_opcode_t;
+
+/* scaler and uploader frame flags */
+#define NI_SCALER_FLAG_IO   0x0001  /* 0 = input frame, 1 = output frame */
+#define NI_SCALER_FLAG_PC   0x0002  /* allocate a frame pool */
+#define NI_SCALER_FLAG_PA   0x0004  /* premultiplied alpha */
+#define NI_SCALER_FLAG_P2   0x0008  /* P2P frame pool */
+#define NI_SCALER_FLAG_FCE  0x0010  /* force out of place */
+#define NI_SCALER_FLAG_CS   0x0020  /* full range color space */
+#define NI_SCALER_FLAG_LM   0x0040  /* low memory pool */
+#define NI_SCALER_FLAG_CMP  0x0080  /* compressed output */
+#define NI_UPLOADER_FLAG_LM 0x0010
+
+#define NI_AI_FLAG_IO       0x0001
+#define NI_AI_FLAG_PC       0x0002
+#define NI_AI_FLAG_SC       0x0004
+#define NI_AI_FLAG_LM       0x0010
+
+typedef enum {
+    SESSION_RUN_STATE_NORMAL = 0,
+    SESSION_RUN_STATE_SEQ_CHANGE_DRAINING = 1,
+    SESSION_RUN_STATE_SEQ_CHANGE_OPENING = 2,
+    SESSION_RUN_STATE_RESETTING = 3,
+} ni_session_run_state_t;
+
+typedef enum {
+    NI_FRAME_AUX_DATA_NONE = 0,
+    NI_FRAME_AUX_DATA_A53_CC,
+    NI_FRAME_AUX_DATA_MASTERING_DISPLAY_METADATA,
+    NI_FRAME_AUX_DATA_CONTENT_LIGHT_LEVEL,
+    NI_FRAME_AUX_DATA_HDR_PLUS,
+    NI_FRAME_AUX_DATA_REGIONS_OF_INTEREST,
+    NI_FRAME_AUX_DATA_UDU_SEI,
+    NI_FRAME_AUX_DATA_CUSTOM_SEI,
+    NI_FRAME_AUX_DATA_BITRATE,
+    NI_FRAME_AUX_DATA_INTRAPRD,
+    NI_FRAME_AUX_DATA_LONG_TERM_REF,
+    NI_FRAME_AUX_DATA_LTR_INTERVAL,
+    NI_FRAME_AUX_DATA_INVALID_REF_FRAME,
+    NI_FRAME_AUX_DATA_FRAMERATE,
+    NI_FRAME_AUX_DATA_MAX_FRAME_SIZE,
+    NI_FRAME_AUX_DATA_CRF,
+    NI_FRAME_AUX_DATA_CRF_FLOAT,
+    NI_FRAME_AUX_DATA_VBV_MAX_RATE,
+    NI_FRAME_AUX_DATA_VBV_BUFFER_SIZE,
+} ni_aux_data_type_t;
+
+typedef struct _ni_aux_data {
+    ni_aux_data_type_t type;
+    uint8_t           *data;
+    int                size;
+} ni_aux_data_t;
+
+typedef struct _ni_rational {
+    int num;
+    int den;
+} ni_rational_t;
+
+typedef struct _ni_mastering_display_metadata {
+    ni_rational_t display_primaries[3][2];
+    ni_rational_t white_point[2];
+    ni_rational_t min_luminance;
+    ni_rational_t max_luminance;
+    int has_primaries;
+    int has_luminance;
+} ni_mastering_display_metadata_t;
+
+#define MASTERING_DISP_CHROMA_DEN   50000
+#define MASTERING_DISP_LUMA_DEN     10000
+
+typedef struct _ni_content_light_level {
+    unsigned max_cll;
+    unsigned max_fall;
+} ni_content_light_level_t;
+
+typedef struct _ni_dynamic_hdr_plus {
+    uint8_t itu_t_t35_country_code;
+    uint8_t application_version;
+    uint8_t num_windows;
+} ni_dynamic_hdr_plus_t;
+
+typedef struct _ni_long_term_ref {
+    uint8_t use_cur_src_as_long_term_pic;
+    uint8_t use_long_term_ref;
+} ni_long_term_ref_t;
+
+typedef struct _ni_framerate {
+    int32_t framerate_num;
+    int32_t framerate_denom;
+} ni_framerate_t;
+
+typedef struct _ni_timecode {
+    uint8_t  clock_timestamp_flag;
+    uint8_t  ct_type;
+    uint8_t  nuit_field_based_flag;
+    uint8_t  counting_type;
+    uint8_t  full_timestamp_flag;
+    uint8_t  discontinuity_flag;
+    uint8_t  cnt_dropped_flag;
+    uint16_t n_frames;
+    uint8_t  seconds_value;
+    uint8_t  minutes_value;
+    uint8_t  hours_value;
+    uint8_t  seconds_flag;
+    uint8_t  minutes_flag;
+    uint8_t  hours_flag;
+    uint8_t  time_offset_length;
+    int32_t  time_offset_value;
+} ni_timecode_t;
+
+typedef struct _ni_custom_sei {
+    uint8_t type;
+    uint8_t location;
+    int     size;
+    uint8_t data[NI_MAX_CUSTOM_SEI_DATA];
+} ni_custom_sei_t;
+
+typedef struct _ni_custom_sei_set {
+    ni_custom_sei_t custom_sei[NI_MAX_CUSTOM_SEI_CNT];
+    int count;
+} ni_custom_sei_set_t;
+
+/* hardware frame descriptor, carried in AVFrame.data[3] */
+typedef struct _niFrameSurface1 {
+    uint16_t ui16FrameIdx;
+    uint16_t ui16session_ID;
+    uint16_t ui16width;
+    uint16_t ui16height;
+    uint32_t ui32nodeAddress;
+    int32_t  device_handle;
+    int8_t   bit_depth;
+    int8_t   encoding_type;
+    int8_t   output_idx;
+    int8_t   src_cpu;
+    int32_t  dma_buf_fd;
+} niFrameSurface1_t;
+
+typedef struct _ni_frameclone_desc {
+    uint16_t ui16DstIdx;
+    uint16_t ui16SrcIdx;
+    uint32_t ui32Offset;
+    uint32_t ui32Size;
+} ni_frameclone_desc_t;
+
+typedef struct _ni_buf {
+    void           *buf;
+    struct _ni_buf_pool *pool;
+    struct _ni_buf *p_prev;
+    struct _ni_buf *p_next;
+    struct _ni_buf *p_previous_buffer;
+    struct _ni_buf *p_next_buffer;
+} ni_buf_t;
+
+typedef struct _ni_buf_pool {
+    void     *mutex;
+    uint32_t  number_of_buffers;
+    uint32_t  buf_size;
+    ni_buf_t *p_free_head;
+    ni_buf_t *p_free_tail;
+    ni_buf_t *p_used_head;
+    ni_buf_t *p_used_tail;
+} ni_buf_pool_t;
+
+typedef struct _ni_frame {
+    long long dts;
+    long long pts;
+    uint32_t  end_of_stream;
+    uint32_t  start_of_stream;
+    uint32_t  video_width;
+    uint32_t  video_height;
+
+    uint32_t  crop_top;
+    uint32_t  crop_bottom;
+    uint32_t  crop_left;
+    uint32_t  crop_right;
+
+    int       force_key_frame;
+    int       ni_pict_type;
+    unsigned  int sei_total_len;
+    unsigned  int sei_cc_offset;
+    unsigned  int sei_cc_len;
+    unsigned  int sei_hdr_mastering_display_color_vol_offset;
+    unsigned  int sei_hdr_mastering_display_color_vol_len;
+    unsigned  int sei_hdr_content_light_level_info_offset;
+    unsigned  int sei_hdr_content_light_level_info_len;
+    unsigned  int sei_hdr_plus_offset;
+    unsigned  int sei_hdr_plus_len;
+    unsigned  int sei_user_data_unreg_offset;
+    unsigned  int sei_user_data_unreg_len;
+    unsigned  int sei_alt_transfer_characteristics_offset;
+    unsigned  int sei_alt_transfer_characteristics_len;
+    unsigned  int vui_offset;
+    unsigned  int vui_len;
+
+    unsigned  int roi_len;
+    unsigned  int reconf_len;
+    unsigned  int extra_data_len;
+    uint16_t  force_pic_qp;
+    uint32_t  frame_chunk_idx;
+
+    uint8_t  *p_data[NI_MAX_NUM_DATA_POINTERS];
+    uint32_t  data_len[NI_MAX_NUM_DATA_POINTERS];
+
+    uint8_t  *p_buffer;
+    uint32_t  buffer_size;
+
+    ni_buf_t *dec_buf;
+    uint8_t   preferred_characteristics_data_len;
+
+    uint8_t   use_cur_src_as_long_term_pic;
+    uint8_t   use_long_term_ref;
+
+    int       flags;
+    uint64_t  pkt_pos;
+
+    ni_aux_data_t *aux_data[NI_MAX_NUM_AUX_DATA_PER_FRAME];
+    int       nb_aux_data;
+
+    uint8_t   color_primaries;
+    uint8_t   color_trc;
+    uint8_t   color_space;
+    int       video_full_range_flag;
+    uint32_t  vui_num_units_in_tick;
+    uint32_t  vui_time_scale;
+
+    uint16_t  pixel_format;
+    ni_custom_sei_set_t *p_custom_sei_set;
+
+    void     *p_metadata_buffer;
+    uint32_t  metadata_buffer_size;
+    void     *p_start_buffer;
+    uint32_t  start_buffer_size;
+
+    uint32_t  separate_metadata;
+    uint32_t  separate_start;
+    uint8_t   inconsecutive_transfer;
+    uint32_t  total_start_len;
+    float     error_ratio;
+} ni_frame_t;
+
+typedef struct _ni_packet {
+    long long dts;
+    long long pts;
+    uint8_t   frame_type;
+    int       end_of_stream;
+    int       start_of_stream;
+    uint32_t  video_width;
+    uint32_t  video_height;
+    uint32_t  frame_index;
+    uint16_t  recycle_index;
+    uint32_t  avg_frame_qp;
+    void     *p_data;
+    uint32_t  data_len;
+    int       sent_size;
+    void     *p_buffer;
+    uint32_t  buffer_size;
+    int       flags;
+    long long pkt_pos;
+    long long pos;
+    ni_custom_sei_set_t *p_custom_sei_set;
+    int       no_slice;
+    int       still_image_detected;
+
+    float     psnr_y;
+    float     psnr_u;
+    float     psnr_v;
+    float     average_psnr;
+    float     ssim_y;
+    float     ssim_u;
+    float     ssim_v;
+
+    int       av1_show_frame;
+    void     *av1_p_buffer[MAX_AV1_ENCODER_GOP_NUM];
+    void     *av1_p_data[MAX_AV1_ENCODER_GOP_NUM];
+    uint32_t  av1_buffer_size[MAX_AV1_ENCODER_GOP_NUM];
+    uint32_t  av1_data_len[MAX_AV1_ENCODER_GOP_NUM];
+    int       av1_buffer_index;
+} ni_packet_t;
+
+/* encoder quality statistics, exported in AV_PKT_DATA_PKT_INFO */
+typedef struct _ni_pkt_info {
+    double psnr_y;
+    double psnr_u;
+    double psnr_v;
+    double average_psnr;
+    double ssim_y;
+    double ssim_u;
+    double ssim_v;
+} ni_pkt_info;
+
+typedef struct _ni_session_data_io {
+    union {
+        ni_frame_t  frame;
+        ni_packet_t packet;
+    } data;
+} ni_session_data_io_t;
+
+/* scaler and AI frame configuration */
+typedef struct _ni_frame_config {
+    uint16_t picture_width;
+    uint16_t picture_height;
+    uint16_t rectangle_width;
+    uint16_t rectangle_height;
+    int16_t  rectangle_x;
+    int16_t  rectangle_y;
+    uint32_t rgba_color;
+    uint16_t frame_index;
+    uint16_t session_id;
+    uint8_t  output_index;
+    uint16_t picture_format;
+    uint16_t options;
+    uint8_t  orientation;
+} ni_frame_config_t;
+
+typedef struct _ni_scaler_params {
+    int   filterblit;
+    int   nb_inputs;
+    bool  enable_scaler_params;
+    double scaler_param_b;
+    double scaler_param_c;
+} ni_scaler_params_t;
+
+typedef struct _ni_scaler_drawbox_params {
+    uint32_t start_x;
+    uint32_t start_y;
+    uint32_t end_x;
+    uint32_t end_y;
+    uint32_t rgba_c;
+} ni_scaler_drawbox_params_t;
+
+typedef struct _ni_scaler_multi_drawbox_params {
+    ni_scaler_drawbox_params_t multi_drawbox_params[NI_MAX_SUPPORT_DRAWBOX_NUM];
+} ni_scaler_multi_drawbox_params_t;
+
+typedef struct _ni_scaler_watermark_params {
+    uint32_t ui32StartX;
+    uint32_t ui32StartY;
+    uint32_t ui32Width;
+    uint32_t ui32Height;
+    uint32_t ui32Valid;
+} ni_scaler_watermark_params_t;
+
+typedef struct _ni_scaler_multi_watermark_params {
+    ni_scaler_watermark_params_t multi_watermark_params[NI_MAX_SUPPORT_WATERMARK_NUM];
+} ni_scaler_multi_watermark_params_t;
+
+/* AI network description */
+#define NI_MAX_NETWORK_LAYER_NUM 32
+#define NI_MAX_NETWORK_INPUT_NUM 4
+#define NI_MAX_NETWORK_OUTPUT_NUM 4
+
+typedef struct _ni_network_layer_params {
+    uint32_t num_of_dims;
+    uint32_t sizes[6];
+    int32_t  data_format;
+    int32_t  quant_format;
+    int32_t  fixed_point_pos;
+    float    scale;
+    int32_t  zeroPoint;
+    int32_t  memory_type;
+} ni_network_layer_params_t;
+
+typedef struct _ni_network_layer_info {
+    ni_network_layer_params_t in_param[NI_MAX_NETWORK_INPUT_NUM];
+    ni_network_layer_params_t out_param[NI_MAX_NETWORK_OUTPUT_NUM];
+} ni_network_layer_info_t;
+
+typedef struct _ni_network_layer_offset {
+    int32_t offset;
+} ni_network_layer_offset_t;
+
+typedef struct _ni_network_data {
+    uint32_t input_num;
+    uint32_t output_num;
+    uint16_t hsub_max;
+    uint16_t vsub_max;
+    ni_network_layer_info_t linfo;
+    ni_network_layer_offset_t inset[NI_MAX_NETWORK_INPUT_NUM];
+    ni_network_layer_offset_t outset[NI_MAX_NETWORK_OUTPUT_NUM];
+} ni_network_data_t;
+
+/* PPU (decoder post-processing unit) outputs */
+typedef struct _ni_split_context {
+    int enabled;
+    int w[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int h[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int f[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int f8b[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+} ni_split_context_t;
+
+typedef struct _ni_ppu_config {
+    uint8_t  ppu_set_enable;
+    uint16_t ppu_w[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    uint16_t ppu_h[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+} ni_ppu_config_t;
+
+typedef struct _ni_encoder_change_params {
+    uint32_t enable_option;
+    int32_t  bitrate;
+    int32_t  intraQP;
+} ni_encoder_change_params_t;
+
+typedef struct _ni_gop_params {
+    int poc_offset;
+    int qp_offset;
+    float qp_factor;
+    int temporal_id;
+    int pic_type;
+    int num_ref_pics;
+} ni_gop_params_t;
+
+typedef struct _ni_custom_gop_params {
+    int custom_gop_size;
+    ni_gop_params_t pic_param[NI_MAX_GOP_NUM];
+} ni_custom_gop_params_t;
+
+typedef struct _ni_encoder_rc_params {
+    int enable_rate_control;
+    int enable_cu_level_rate_control;
+    int enable_hvs_qp;
+    int enable_hvs_qp_scale;
+    int hvs_qp_scale;
+    int min_qp;
+    int max_qp;
+    int max_delta_qp;
+    int intra_qp;
+    int rc_init_delay;
+    int vbv_buffer_size;
+    int vbv_max_rate;
+    int enable_filler;
+    int enable_pic_skip;
+} ni_encoder_rc_params_t;
+
+typedef struct _ni_encoder_cfg_params {
+    int frame_rate;
+    int aspectRatioWidth;
+    int aspectRatioHeight;
+    int planar;
+    int maxFrameSize;
+    int maxFrameSizeRatio;
+
+    ni_custom_gop_params_t custom_gop_params;
+    ni_encoder_rc_params_t rc;
+    int roi_enable;
+    int forced_header_enable;
+    int crop_width;
+    int crop_height;
+    int hor_offset;
+    int ver_offset;
+    int crf;
+    float crfFloat;
+    int cbr;
+    int cacheRoi;
+    int long_term_ref_enable;
+    int long_term_ref_interval;
+    int long_term_ref_count;
+    int conf_win_top;
+    int conf_win_bottom;
+    int conf_win_left;
+    int conf_win_right;
+    int intra_period;
+    int keep_alive_timeout;
+    int colorDescPresent;
+    int colorPrimaries;
+    int colorTrc;
+    int colorSpace;
+    int videoFullRange;
+    int hrdEnable;
+    int EnableAUD;
+    int lookAheadDepth;
+    int enable_ssim;
+    int gop_preset_index;
+    int get_psnr_mode;
+    int motionConstrainedMode;
+    int multicoreJointMode;
+    int disable_adaptive_buffers;
+    int enable_acq_limit;
+    int enable_all_sei_passthru;
+
+    int HDR10MaxLight;
+    int HDR10AveLight;
+    int HDR10CLLEnable;
+    int HDR10Enable;
+    int HDR10dx0;
+    int HDR10dy0;
+    int HDR10dx1;
+    int HDR10dy1;
+    int HDR10dx2;
+    int HDR10dy2;
+    int HDR10wx;
+    int HDR10wy;
+    int HDR10maxluma;
+    int HDR10minluma;
+} ni_encoder_cfg_params_t;
+
+typedef struct _ni_decoder_input_params_t {
+    int hwframes;
+    int enable_out1;
+    int enable_out2;
+    int mcmode;
+    int nb_save_pkt;
+    int force_8_bit[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int semi_planar[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int crop_mode[NI_MAX_NUM_OF_DECODER_OUTPUTS];
+    int crop_whxy[NI_MAX_NUM_OF_DECODER_OUTPUTS][4];
+    char cr_expr[NI_MAX_NUM_OF_DECODER_OUTPUTS][4][NI_MAX_PPU_PARAM_EXPR_CHAR + 1];
+    int scale_wh[NI_MAX_NUM_OF_DECODER_OUTPUTS][2];
+    char sc_expr[NI_MAX_NUM_OF_DECODER_OUTPUTS][2][NI_MAX_PPU_PARAM_EXPR_CHAR + 1];
+    int keep_alive_timeout;
+    int decoder_low_delay;
+    int force_low_delay;
+    int enable_low_delay_check;
+    int enable_user_data_sei_passthru;
+    int custom_sei_passthru;
+    int enable_follow_iframe;
+    int skip_extra_headers;
+    int max_extra_hwframe_cnt;
+    int enable_ppu_scale_adapt;
+    int enable_ppu_scale_limit;
+    int reduce_dpb_delay;
+} ni_decoder_input_params_t;
+
+typedef struct _ni_xcoder_params {
+    int log;
+    int preset;
+    int fps_number;
+    int fps_denominator;
+    int source_width;
+    int source_height;
+    int bitrate;
+    int roi_demo_mode;
+    int reconf_demo_mode;
+    int force_pic_qp_demo_mode;
+    int low_delay_mode;
+    int padding;
+    int generate_enc_hdrs;
+    int use_low_delay_poc_type;
+    int dolby_vision_profile;
+    int hwframes;
+    int rootBufId;
+    int enable_vfr;
+    int luma_linesize;
+    int chroma_linesize;
+    int zerocopy_mode;
+
+    ni_encoder_cfg_params_t   cfg_enc_params;
+    ni_decoder_input_params_t dec_input_params;
+    bool  enable_scaler_params;
+    double scaler_param_b;
+    double scaler_param_c;
+} ni_xcoder_params_t;
+
+typedef struct _ni_session_context {
+    /* device and session */
+    ni_device_handle_t device_handle;
+    ni_device_handle_t blk_io_handle;
+    ni_device_handle_t sender_handle;
+    ni_device_handle_t auto_dl_handle;
+    uint32_t session_id;
+    uint64_t session_timestamp;
+    int      hw_id;
+    int      device_type;
+    int      codec_format;
+    int      hw_action;
+    int      ddr_config;
+    int      isP2P;
+    int      is_auto_dl;
+    uint32_t max_nvme_io_size;
+    uint32_t keep_alive_timeout;
+    char     blk_dev_name[NI_MAX_DEVICE_NAME_LEN];
+    char     dev_xcoder_name[MAX_CHAR_IN_DEVICE_NAME];
+    char     blk_xcoder_name[MAX_CHAR_IN_DEVICE_NAME];
+    int      status;
+    int      ready_to_close;
+    int      scaler_operation;
+    ni_session_run_state_t session_run_state;
+    void    *p_session_config;
+    char     param_err_msg[512];
+
+    /* video parameters */
+    int      src_bit_depth;
+    int      src_endian;
+    int      bit_depth_factor;
+    int      ori_bit_depth_factor;
+    int      pixel_format;
+    int      ori_pix_fmt;
+    int      ori_width;
+    int      ori_height;
+    int      ori_luma_linesize;
+    int      ori_chroma_linesize;
+    int      active_video_width;
+    int      active_video_height;
+    int      actual_video_width;
+    ni_framerate_t framerate;
+    int      prev_fps;
+    int      fps_change_detect_count;
+    int64_t  last_change_framenum;
+    int64_t  prev_pts;
+    uint64_t count_frame_num_in_sec;
+    uint64_t passed_time_in_timebase_unit;
+
+    /* decoder */
+    int      decoder_low_delay;
+    int      enable_low_delay_check;
+    int      enable_user_data_sei_passthru;
+    int      burst_control;
+    int      pic_reorder_delay;
+    ni_buf_pool_t *dec_fme_buf_pool;
+    uint8_t *p_leftover;
+    int      prev_size;
+    uint32_t sent_size;
+
+    /* encoder */
+    uint32_t meta_size;
+    uint64_t frame_num;
+    uint64_t pkt_num;
+    int64_t  enc_pts_list[NI_FIFO_SZ];
+    uint64_t enc_pts_r_idx;
+    uint64_t enc_pts_w_idx;
+    int      force_frame_type;
+    int      roi_len;
+    int      roi_avg_qp;
+    ni_custom_sei_set_t *pkt_custom_sei_set[NI_FIFO_SZ];
+    void    *p_master_display_meta_data;
+    int      mdcv_max_min_lum_data_len;
+    int      sei_hdr_mastering_display_color_vol_len;
+    int      light_level_data_len;
+    int      sei_hdr_content_light_level_info_len;
+    float    psnr_y;
+    float    psnr_u;
+    float    psnr_v;
+    float    average_psnr;
+
+    /* AI */
+    int      hvsplus_level;
+
+    /* software emulation state, see ni_emu.c */
+    void    *emu;
+} ni_session_context_t;
+
+extern LIB_API const char *const g_xcoder_preset_names[];
+extern LIB_API const char *const g_xcoder_log_names[];
+
+LIB_API ni_retcode_t ni_device_session_context_init(ni_session_context_t *p_ctx);
+LIB_API void ni_device_session_context_clear(ni_session_context_t *p_ctx);
+LIB_API ni_device_handle_t ni_device_open(const char *dev, uint32_t *p_max_io_size_out);
+LIB_API void ni_device_close(ni_device_handle_t dev);
+LIB_API ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
+                                            ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx,
+                                             int eos_received,
+                                             ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_session_flush(ni_session_context_t *p_ctx,
+                                             ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_dec_session_flush(ni_session_context_t *p_ctx);
+LIB_API int ni_device_session_write(ni_session_context_t *p_ctx,
+                                    ni_session_data_io_t *p_data,
+                                    ni_device_type_t device_type);
+LIB_API int ni_device_session_read(ni_session_context_t *p_ctx,
+                                   ni_session_data_io_t *p_data,
+                                   ni_device_type_t device_type);
+LIB_API int ni_device_session_read_hwdesc(ni_session_context_t *p_ctx,
+                                          ni_session_data_io_t *p_data,
+                                          ni_device_type_t device_type);
+LIB_API int ni_device_session_hwdl(ni_session_context_t *p_ctx,
+                                   ni_session_data_io_t *p_data,
+                                   niFrameSurface1_t *hwdesc);
+LIB_API int ni_device_session_hwup(ni_session_context_t *p_ctx,
+                                   ni_session_data_io_t *p_src_data,
+                                   niFrameSurface1_t *hwdesc);
+LIB_API ni_retcode_t ni_device_session_copy(ni_session_context_t *src_p_ctx,
+                                            ni_session_context_t *dst_p_ctx);
+LIB_API int ni_device_session_init_framepool(ni_session_context_t *p_ctx,
+                                             uint32_t pool_size,
+                                             uint32_t pool);
+LIB_API ni_retcode_t ni_device_session_query_buffer_avail(ni_session_context_t *p_ctx,
+                                                          ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_session_acquire(ni_session_context_t *p_ctx,
+                                               ni_frame_t *p_frame);
+LIB_API ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_ctx,
+                                                       int width, int height,
+                                                       int bit_depth_factor,
+                                                       ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_alloc_frame(ni_session_context_t *p_ctx,
+                                           int width, int height, int format,
+                                           int options, int rectangle_width,
+                                           int rectangle_height,
+                                           int rectangle_x, int rectangle_y,
+                                           int rgba_color, int frame_index,
+                                           ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_alloc_dst_frame(ni_session_context_t *p_ctx,
+                                               niFrameSurface1_t *p_out_surface,
+                                               ni_device_type_t device_type);
+LIB_API ni_retcode_t ni_device_clone_hwframe(ni_session_context_t *p_ctx,
+                                             ni_frameclone_desc_t *p_frameclone_desc);
+LIB_API ni_retcode_t ni_device_config_frame(ni_session_context_t *p_ctx,
+                                            ni_frame_config_t *p_cfg);
+LIB_API ni_retcode_t ni_device_multi_config_frame(ni_session_context_t *p_ctx,
+                                                  ni_frame_config_t p_cfg_in[],
+                                                  int numInCfgs,
+                                                  ni_frame_config_t *p_cfg_out);
+LIB_API ni_retcode_t ni_hwframe_buffer_recycle(niFrameSurface1_t *surface,
+                                               int32_t device_handle);
+LIB_API ni_retcode_t ni_hwframe_buffer_recycle2(niFrameSurface1_t *surface);
+
+LIB_API ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
+                                           int video_height, int alignment,
+                                           int metadata_flag, int factor,
+                                           int hw_frame_count, int is_planar);
+LIB_API ni_retcode_t ni_frame_buffer_alloc_dl(ni_frame_t *p_frame,
+                                              int video_width, int video_height,
+                                              int pixel_format);
+LIB_API ni_retcode_t ni_frame_buffer_alloc_hwenc(ni_frame_t *pframe,
+                                                 int video_width,
+                                                 int video_height,
+                                                 int extra_len);
+LIB_API ni_retcode_t ni_frame_buffer_alloc_pixfmt(ni_frame_t *pframe,
+                                                  int pixel_format,
+                                                  int video_width,
+                                                  int video_height,
+                                                  int linesize[],
+                                                  int alignment,
+                                                  int extra_len);
+LIB_API ni_retcode_t ni_decoder_frame_buffer_alloc(ni_buf_pool_t *p_pool,
+                                                   ni_frame_t *pframe,
+                                                   int alloc_mem,
+                                                   int video_width,
+                                                   int video_height,
+                                                   int alignment, int factor,
+                                                   int is_planar);
+LIB_API ni_retcode_t ni_encoder_frame_buffer_alloc(ni_frame_t *pframe,
+                                                   int video_width,
+                                                   int video_height,
+                                                   int linesize[],
+                                                   int alignment,
+                                                   int extra_len,
+                                                   bool alignment_2pass_wa);
+LIB_API ni_retcode_t ni_encoder_sw_frame_buffer_alloc(bool planar,
+                                                      ni_frame_t *p_frame,
+                                                      int video_width,
+                                                      int video_height,
+                                                      int linesize[],
+                                                      int alignment,
+                                                      int extra_len,
+                                                      bool alignment_2pass_wa);
+LIB_API ni_retcode_t ni_encoder_frame_zerocopy_buffer_alloc(ni_frame_t *p_frame,
+                                                            int video_width,
+                                                            int video_height,
+                                                            const int linesize[],
+                                                            const uint8_t *data[],
+                                                            int extra_len);
+LIB_API ni_retcode_t ni_frame_buffer_free(ni_frame_t *pframe);
+LIB_API ni_retcode_t ni_decoder_frame_buffer_free(ni_frame_t *pframe);
+LIB_API void ni_decoder_frame_buffer_pool_return_buf(ni_buf_t *buf,
+                                                     ni_buf_pool_t *p_buffer_pool);
+LIB_API ni_retcode_t ni_packet_buffer_alloc(ni_packet_t *ppacket, int packet_size);
+LIB_API ni_retcode_t ni_packet_buffer_free(ni_packet_t *ppacket);
+LIB_API ni_retcode_t ni_packet_buffer_free_av1(ni_packet_t *ppacket);
+LIB_API int ni_packet_copy(void *p_destination, const void *const p_source,
+                           int cur_size, void *p_leftover, int *p_prev_size);
+
+LIB_API ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame,
+                                             ni_aux_data_type_t type,
+                                             int data_size);
+LIB_API ni_aux_data_t *ni_frame_new_aux_data_from_raw_data(ni_frame_t *frame,
+                                                           ni_aux_data_type_t type,
+                                                           const uint8_t *raw_data,
+                                                           int data_size);
+LIB_API ni_aux_data_t *ni_frame_get_aux_data(const ni_frame_t *frame,
+                                             ni_aux_data_type_t type);
+LIB_API void ni_frame_free_aux_data(ni_frame_t *frame, ni_aux_data_type_t type);
+LIB_API void ni_frame_wipe_aux_data(ni_frame_t *frame);
+
+LIB_API ni_retcode_t ni_encoder_init_default_params(ni_xcoder_params_t *p_param,
+                                                    int fps_num, int fps_denom,
+                                                    long bit_rate, int width,
+                                                    int height,
+                                                    ni_codec_format_t codec_format);
+LIB_API ni_retcode_t ni_decoder_init_default_params(ni_xcoder_params_t *p_param,
+                                                    int fps_num, int fps_denom,
+                                                    long bit_rate, int width,
+                                                    int height);
+LIB_API ni_retcode_t ni_encoder_params_set_value(ni_xcoder_params_t *p_params,
+                                                 const char *name,
+                                                 const char *value);
+LIB_API ni_retcode_t ni_decoder_params_set_value(ni_xcoder_params_t *p_params,
+                                                 const char *name,
+                                                 char *value);
+LIB_API ni_retcode_t ni_encoder_gop_params_set_value(ni_xcoder_params_t *p_params,
+                                                     const char *name,
+                                                     const char *value);
+LIB_API ni_retcode_t ni_gop_params_check_set(ni_xcoder_params_t *p_param,
+                                             char *value);
+LIB_API bool ni_gop_params_check(ni_xcoder_params_t *p_param);
+LIB_API ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
+                                                     ni_xcoder_params_t *p_enc_params,
+                                                     int width, int height,
+                                                     const int linesize[],
+                                                     bool set_linesize);
+LIB_API ni_retcode_t ni_uploader_frame_zerocopy_check(ni_session_context_t *p_upl_ctx,
+                                                      int width, int height,
+                                                      const int linesize[],
+                                                      int pixel_format);
+LIB_API ni_retcode_t ni_uploader_set_frame_format(ni_session_context_t *p_upl_ctx,
+                                                  int width, int height,
+                                                  ni_pix_fmt_t pixel_format,
+                                                  int isP2P);
+LIB_API ni_retcode_t ni_scaler_set_params(ni_session_context_t *p_ctx,
+                                          ni_scaler_params_t *p_params);
+LIB_API ni_retcode_t ni_scaler_set_drawbox_params(ni_session_context_t *p_ctx,
+                                                  ni_scaler_drawbox_params_t *p_params);
+LIB_API ni_retcode_t ni_scaler_set_watermark_params(ni_session_context_t *p_ctx,
+                                                    ni_scaler_watermark_params_t *p_params);
+LIB_API ni_retcode_t ni_reconfig_ppu_output(ni_session_context_t *p_session_ctx,
+                                            ni_xcoder_params_t *p_param,
+                                            ni_ppu_config_t *ppu_config);
+LIB_API ni_retcode_t ni_dec_reconfig_ppu_params(ni_session_context_t *p_session_ctx,
+                                                ni_xcoder_params_t *p_param,
+                                                ni_ppu_config_t *ppu_config);
+LIB_API ni_retcode_t ni_p2p_send(ni_session_context_t *pSession,
+                                 niFrameSurface1_t *source,
+                                 uint64_t ui64DestAddr, uint32_t ui32FrameSize);
+LIB_API uint32_t ni_calculate_total_frame_size(const ni_session_context_t *p_upl_session,
+                                               const int linesize[]);
+
+LIB_API ni_retcode_t ni_ai_config_network_binary(ni_session_context_t *p_ctx,
+                                                 ni_network_data_t *p_network,
+                                                 const char *file);
+LIB_API ni_retcode_t ni_ai_config_hvsplus(ni_session_context_t *p_ctx,
+                                          ni_network_data_t *p_network);
+LIB_API ni_retcode_t ni_ai_frame_buffer_alloc(ni_frame_t *p_frame,
+                                              ni_network_data_t *p_network);
+LIB_API ni_retcode_t ni_ai_packet_buffer_alloc(ni_packet_t *p_packet,
+                                               ni_network_data_t *p_network);
+LIB_API uint32_t ni_ai_network_layer_dims(ni_network_layer_params_t *p_param);
+LIB_API ni_retcode_t ni_network_layer_convert_output(float *dst, uint32_t num,
+                                                     ni_packet_t *p_packet,
+                                                     ni_network_data_t *p_network,
+                                                     uint32_t layer);
+
+#endif /* COMPAT_NI_XCODER_NI_DEVICE_API_H */
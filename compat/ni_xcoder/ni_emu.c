@@ -0,0 +1,1756 @@
+/*
+ * Software emulation of the NETINT libxcoder API - device, session and
+ * buffer management
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ni_device_api.h"
+#include "ni_emu.h"
+#include "ni_log.h"
+#include "ni_rsrc_api.h"
+#include "ni_util.h"
+
+#define EMU_MAX_POOLS       1024
+#define EMU_LEFTOVER_SIZE   (1 << 20)
+#define EMU_PAGE_SIZE       4096
+#define EMU_DEV_NAME        "/dev/nvme0"
+#define EMU_BLK_NAME        "/dev/nvme0n1"
+
+const char *const g_xcoder_preset_names[] = {
+    "default", "slow", "medium", "fast", "faster", "veryfast", NULL
+};
+
+const char *const g_xcoder_log_names[] = {
+    "none", "fatal", "error", "info", "debug", "trace", NULL
+};
+
+/* ----------------------------------------------------------------------
+ * configuration and timing
+ * ---------------------------------------------------------------------- */
+
+static EmuConfig emu_config;
+static AVOnce emu_config_once = AV_ONCE_INIT;
+
+static void emu_config_init(void)
+{
+    static const struct {
+        const char *name;
+        int         type;
+    } fps_keys[] = {
+        { "dec_fps",    NI_DEVICE_TYPE_DECODER },
+        { "enc_fps",    NI_DEVICE_TYPE_ENCODER },
+        { "scaler_fps", NI_DEVICE_TYPE_SCALER  },
+        { "ai_fps",     NI_DEVICE_TYPE_AI      },
+        { "upload_fps", NI_DEVICE_TYPE_UPLOAD  },
+    };
+    const AVDictionaryEntry *en = NULL;
+    AVDictionary *dict = NULL;
+    const char *env = getenv("NI_QUADRA_EMU");
+
+    emu_config.queue   = 8;
+    emu_config.timeout = 2000000;
+
+    if (!env || !*env)
+        return;
+
+    if (av_dict_parse_string(&dict, env, "=", ":", 0) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "NI_QUADRA_EMU: cannot parse '%s'\n", env);
+        av_dict_free(&dict);
+        return;
+    }
+
+    while ((en = av_dict_iterate(dict, en))) {
+        double val = strtod(en->value, NULL);
+        int i, found = 0;
+
+        if (!strcmp(en->key, "fps")) {
+            for (i = 0; i < NI_DEVICE_TYPE_MAX; i++)
+                emu_config.fps[i] = FFMAX(val, 0);
+            found = 1;
+        }
+        for (i = 0; i < FF_ARRAY_ELEMS(fps_keys); i++) {
+            if (!strcmp(en->key, fps_keys[i].name)) {
+                emu_config.fps[fps_keys[i].type] = FFMAX(val, 0);
+                found = 1;
+            }
+        }
+        if (!strcmp(en->key, "latency")) {
+            emu_config.latency = FFMAX((int64_t)val, 0);
+        } else if (!strcmp(en->key, "queue")) {
+            emu_config.queue = av_clip((int)val, 1, NI_MAX_FIFO_CAPACITY);
+        } else if (!strcmp(en->key, "timeout")) {
+            emu_config.timeout = FFMAX((int64_t)val, 0);
+        } else if (!strcmp(en->key, "dec_pool")) {
+            emu_config.dec_pool = av_clip((int)val, 0, NI_MAX_HWDESC_FRAME_INDEX - 1);
+        } else if (!found) {
+            av_log(NULL, AV_LOG_WARNING, "NI_QUADRA_EMU: unknown key '%s'\n",
+                   en->key);
+        }
+    }
+    av_dict_free(&dict);
+}
+
+const EmuConfig *ff_ni_emu_config(void)
+{
+    ff_thread_once(&emu_config_once, emu_config_init);
+    return &emu_config;
+}
+
+void ff_ni_emu_timer_init(EmuTimer *t, int device_type)
+{
+    const EmuConfig *cfg = ff_ni_emu_config();
+    double fps = cfg->fps[av_clip(device_type, 0, NI_DEVICE_TYPE_MAX - 1)];
+
+    t->period     = fps > 0 ? 1000000.0 / fps : 0;
+    t->busy_until = 0;
+}
+
+int64_t ff_ni_emu_timer_schedule(EmuTimer *t)
+{
+    int64_t now   = av_gettime_relative();
+    int64_t start = FFMAX(now, t->busy_until);
+
+    t->busy_until = start + llrint(t->period);
+    return t->busy_until + ff_ni_emu_config()->latency;
+}
+
+void ff_ni_emu_wait_until(int64_t when)
+{
+    int64_t left;
+
+    while ((left = when - av_gettime_relative()) > 0)
+        av_usleep(left);
+}
+
+/* ----------------------------------------------------------------------
+ * device memory layout
+ * ---------------------------------------------------------------------- */
+
+int ff_ni_emu_layout(int ni_fmt, int width, int height,
+                     int linesize[EMU_MAX_PLANES],
+                     int plane_height[EMU_MAX_PLANES])
+{
+    int chroma_h = FFALIGN(height, 2) / 2;
+
+    memset(linesize, 0, EMU_MAX_PLANES * sizeof(*linesize));
+    memset(plane_height, 0, EMU_MAX_PLANES * sizeof(*plane_height));
+
+    switch (ni_fmt) {
+    case NI_PIX_FMT_YUV420P:
+        linesize[0] = FFALIGN(width, 128);
+        linesize[1] = linesize[2] = FFALIGN(width / 2, 128);
+        plane_height[0] = height;
+        plane_height[1] = plane_height[2] = chroma_h;
+        return 3;
+    case NI_PIX_FMT_YUV420P10LE:
+        linesize[0] = FFALIGN(width * 2, 128);
+        linesize[1] = linesize[2] = FFALIGN(width, 128);
+        plane_height[0] = height;
+        plane_height[1] = plane_height[2] = chroma_h;
+        return 3;
+    case NI_PIX_FMT_NV12:
+    case NI_PIX_FMT_8_TILED4X4:
+        linesize[0] = linesize[1] = FFALIGN(width, 128);
+        plane_height[0] = height;
+        plane_height[1] = chroma_h;
+        return 2;
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_10_TILED4X4:
+        linesize[0] = linesize[1] = FFALIGN(width * 2, 128);
+        plane_height[0] = height;
+        plane_height[1] = chroma_h;
+        return 2;
+    case NI_PIX_FMT_NV16:
+        linesize[0] = linesize[1] = FFALIGN(width, 64);
+        plane_height[0] = plane_height[1] = height;
+        return 2;
+    case NI_PIX_FMT_YUYV422:
+    case NI_PIX_FMT_UYVY422:
+        linesize[0] = FFALIGN(width, 16) * 2;
+        plane_height[0] = height;
+        return 1;
+    case NI_PIX_FMT_RGBA:
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_ARGB:
+    case NI_PIX_FMT_ABGR:
+    case NI_PIX_FMT_BGR0:
+        linesize[0] = FFALIGN(width, 16) * 4;
+        plane_height[0] = height;
+        return 1;
+    case NI_PIX_FMT_BGRP:
+        linesize[0] = linesize[1] = linesize[2] = FFALIGN(width, 32);
+        plane_height[0] = plane_height[1] = plane_height[2] = height;
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+int ff_ni_emu_bit_depth_factor(int ni_fmt)
+{
+    switch (ni_fmt) {
+    case NI_PIX_FMT_YUV420P10LE:
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_10_TILED4X4:
+        return 2;
+    case NI_PIX_FMT_RGBA:
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_ARGB:
+    case NI_PIX_FMT_ABGR:
+    case NI_PIX_FMT_BGR0:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+int ff_ni_emu_gc620_to_ni(int gc620_fmt)
+{
+    switch (gc620_fmt) {
+    case GC620_NV12:
+    case GC620_NV21:        return NI_PIX_FMT_NV12;
+    case GC620_I420:        return NI_PIX_FMT_YUV420P;
+    case GC620_P010_MSB:    return NI_PIX_FMT_P010LE;
+    case GC620_I010:        return NI_PIX_FMT_YUV420P10LE;
+    case GC620_YUYV:        return NI_PIX_FMT_YUYV422;
+    case GC620_UYVY:        return NI_PIX_FMT_UYVY422;
+    case GC620_NV16:        return NI_PIX_FMT_NV16;
+    case GC620_BGRX8888:    return NI_PIX_FMT_BGR0;
+    case GC620_BGRA8888:    return NI_PIX_FMT_BGRA;
+    case GC620_ABGR8888:    return NI_PIX_FMT_ABGR;
+    case GC620_ARGB8888:    return NI_PIX_FMT_ARGB;
+    case GC620_RGB888_PLANAR: return NI_PIX_FMT_BGRP;
+    default:                return NI_PIX_FMT_RGBA;
+    }
+}
+
+void ff_ni_emu_copy_planes(uint8_t *dst[], const int dst_linesize[],
+                           uint8_t *const src[], const int src_linesize[],
+                           const int row_bytes[], const int rows[],
+                           int nb_planes)
+{
+    for (int i = 0; i < nb_planes; i++) {
+        int bytes = FFMIN3(row_bytes[i], dst_linesize[i], src_linesize[i]);
+
+        if (!dst[i] || !src[i] || bytes <= 0)
+            continue;
+        if (dst_linesize[i] == src_linesize[i] && bytes == src_linesize[i]) {
+            memcpy(dst[i], src[i], (size_t)bytes * rows[i]);
+            continue;
+        }
+        for (int y = 0; y < rows[i]; y++)
+            memcpy(dst[i] + (size_t)y * dst_linesize[i],
+                   src[i] + (size_t)y * src_linesize[i], bytes);
+    }
+}
+
+void ni_get_hw_yuv420p_dim(int width, int height, int factor,
+                           int is_semiplanar, int plane_stride[4],
+                           int plane_height[4])
+{
+    plane_stride[0] = NI_VPU_ALIGN128(width * factor);
+    plane_stride[1] = NI_VPU_ALIGN128(width / (is_semiplanar ? 1 : 2) * factor);
+    plane_stride[2] = is_semiplanar ? 0 : plane_stride[1];
+    plane_stride[3] = 0;
+
+    plane_height[0] = FFALIGN(height, 2);
+    plane_height[1] = plane_height[0] / 2;
+    plane_height[2] = is_semiplanar ? 0 : plane_height[1];
+    plane_height[3] = 0;
+}
+
+void ni_get_min_frame_dim(int width, int height, ni_pix_fmt_t pix_fmt,
+                          int plane_stride[4], int plane_height[4])
+{
+    ff_ni_emu_layout(pix_fmt, width, height, plane_stride, plane_height);
+}
+
+/* Width in bytes of the visible part of each plane */
+int ff_ni_emu_row_bytes(int ni_fmt, int width, int row_bytes[EMU_MAX_PLANES])
+{
+    int bdf     = ff_ni_emu_bit_depth_factor(ni_fmt);
+    int chroma  = (width + 1) / 2;
+
+    memset(row_bytes, 0, EMU_MAX_PLANES * sizeof(*row_bytes));
+
+    switch (ni_fmt) {
+    case NI_PIX_FMT_YUV420P:
+    case NI_PIX_FMT_YUV420P10LE:
+        row_bytes[0] = width * bdf;
+        row_bytes[1] = row_bytes[2] = chroma * bdf;
+        return 3;
+    case NI_PIX_FMT_NV12:
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_8_TILED4X4:
+    case NI_PIX_FMT_10_TILED4X4:
+        row_bytes[0] = width * bdf;
+        row_bytes[1] = chroma * 2 * bdf;
+        return 2;
+    case NI_PIX_FMT_NV16:
+        row_bytes[0] = width;
+        row_bytes[1] = chroma * 2;
+        return 2;
+    case NI_PIX_FMT_YUYV422:
+    case NI_PIX_FMT_UYVY422:
+        row_bytes[0] = chroma * 4;
+        return 1;
+    case NI_PIX_FMT_BGRP:
+        row_bytes[0] = row_bytes[1] = row_bytes[2] = width;
+        return 3;
+    case NI_PIX_FMT_NONE:
+        return 0;
+    default:
+        row_bytes[0] = width * 4;
+        return 1;
+    }
+}
+
+void ni_copy_frame_data(uint8_t *p_dst[4], uint8_t *p_src[4],
+                        int frame_width, int frame_height, int factor,
+                        ni_pix_fmt_t pix_fmt, int conf_win_right,
+                        int dst_stride[4], int dst_height[4],
+                        int src_stride[4], int src_height[4])
+{
+    int row_bytes[EMU_MAX_PLANES];
+    int nb_planes = ff_ni_emu_row_bytes(pix_fmt, frame_width, row_bytes);
+
+    for (int i = 0; i < nb_planes; i++) {
+        int bytes = FFMIN(row_bytes[i], dst_stride[i]);
+        int rows  = FFMIN(src_height[i], dst_height[i]);
+        int y;
+
+        if (!p_dst[i] || !p_src[i] || rows <= 0)
+            continue;
+        bytes = FFMIN(bytes, src_stride[i]);
+        for (y = 0; y < rows; y++)
+            memcpy(p_dst[i] + (size_t)y * dst_stride[i],
+                   p_src[i] + (size_t)y * src_stride[i], bytes);
+        /* replicate the last line into the padding below the picture */
+        for (; y < dst_height[i]; y++)
+            memcpy(p_dst[i] + (size_t)y * dst_stride[i],
+                   p_dst[i] + (size_t)(rows - 1) * dst_stride[i], bytes);
+    }
+}
+
+int ni_expand_frame(ni_frame_t *dst, ni_frame_t *src, int dst_stride[],
+                    int raw_width, int raw_height, int ni_fmt, int nb_planes)
+{
+    int src_stride[EMU_MAX_PLANES], src_height[EMU_MAX_PLANES];
+    int row_bytes[EMU_MAX_PLANES];
+
+    ff_ni_emu_layout(ni_fmt, raw_width, raw_height, src_stride, src_height);
+    ff_ni_emu_row_bytes(ni_fmt, raw_width, row_bytes);
+
+    for (int i = 0; i < FFMIN(nb_planes, EMU_MAX_PLANES); i++) {
+        int bytes, rows, y;
+
+        if (!dst->p_data[i] || !src->p_data[i] || !dst_stride[i])
+            continue;
+        bytes = FFMIN3(row_bytes[i], src_stride[i], dst_stride[i]);
+        rows  = FFMIN(src_height[i], (int)(dst->data_len[i] / dst_stride[i]));
+        for (y = 0; y < rows; y++) {
+            uint8_t *d = dst->p_data[i] + (size_t)y * dst_stride[i];
+
+            memcpy(d, src->p_data[i] + (size_t)y * src_stride[i], bytes);
+            /* extend the last sample to the right edge */
+            for (int x = bytes; x + 1 <= dst_stride[i] && bytes > 0; x++)
+                d[x] = d[x - 1];
+        }
+        for (; rows > 0 && y < (int)(dst->data_len[i] / dst_stride[i]); y++)
+            memcpy(dst->p_data[i] + (size_t)y * dst_stride[i],
+                   dst->p_data[i] + (size_t)(rows - 1) * dst_stride[i],
+                   dst_stride[i]);
+    }
+    return 0;
+}
+
+void ni_usleep(int64_t usec)
+{
+    av_usleep(usec);
+}
+
+/* ----------------------------------------------------------------------
+ * logging
+ * ---------------------------------------------------------------------- */
+
+static ni_log_level_t emu_log_level = NI_LOG_INFO;
+
+void ni_log_set_level(ni_log_level_t level)
+{
+    emu_log_level = level;
+}
+
+ni_log_level_t ni_log_get_level(void)
+{
+    return emu_log_level;
+}
+
+ni_log_level_t ff_to_ni_log_level(int fflog_level)
+{
+    if (fflog_level >= AV_LOG_TRACE)
+        return NI_LOG_TRACE;
+    if (fflog_level >= AV_LOG_VERBOSE)
+        return NI_LOG_DEBUG;
+    if (fflog_level >= AV_LOG_WARNING)
+        return NI_LOG_INFO;
+    if (fflog_level >= AV_LOG_ERROR)
+        return NI_LOG_ERROR;
+    if (fflog_level >= AV_LOG_PANIC)
+        return NI_LOG_FATAL;
+    return NI_LOG_NONE;
+}
+
+/* ----------------------------------------------------------------------
+ * hardware frame store
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuPool {
+    int      in_use;
+    int      closed;
+    int      size;
+    int      limited;
+    int      nb_frames;
+    uint32_t session_id;
+    int      device_handle;
+} EmuPool;
+
+typedef struct EmuSlot {
+    EmuFrame frame;
+    int      pool;
+    uint8_t *mem;
+    size_t   mem_size;
+} EmuSlot;
+
+static AVMutex   store_lock = AV_MUTEX_INITIALIZER;
+static EmuSlot   store_slots[NI_MAX_HWDESC_FRAME_INDEX + 1];
+static EmuPool   store_pools[EMU_MAX_POOLS];
+static int       store_next_slot = 1;
+
+int ff_ni_emu_pool_create(int size, int limited, uint32_t session_id,
+                          int device_handle)
+{
+    int id = 0;
+
+    ff_mutex_lock(&store_lock);
+    for (int i = 1; i < EMU_MAX_POOLS; i++) {
+        if (!store_pools[i].in_use) {
+            store_pools[i] = (EmuPool) {
+                .in_use        = 1,
+                .size          = FFMAX(size, 1),
+                .limited       = limited,
+                .session_id    = session_id,
+                .device_handle = device_handle,
+            };
+            id = i;
+            break;
+        }
+    }
+    ff_mutex_unlock(&store_lock);
+    return id;
+}
+
+void ff_ni_emu_pool_close(int pool)
+{
+    if (pool <= 0 || pool >= EMU_MAX_POOLS)
+        return;
+
+    ff_mutex_lock(&store_lock);
+    store_pools[pool].closed = 1;
+    if (!store_pools[pool].nb_frames)
+        store_pools[pool].in_use = 0;
+    ff_mutex_unlock(&store_lock);
+}
+
+static int pool_available_locked(const EmuPool *p)
+{
+    if (!p->in_use || p->closed)
+        return 0;
+    return p->limited ? p->size - p->nb_frames : FFMAX(p->size - p->nb_frames, 1);
+}
+
+int ff_ni_emu_pool_available(int pool)
+{
+    int ret;
+
+    if (pool <= 0 || pool >= EMU_MAX_POOLS)
+        return 0;
+
+    ff_mutex_lock(&store_lock);
+    ret = pool_available_locked(&store_pools[pool]);
+    ff_mutex_unlock(&store_lock);
+    return ret;
+}
+
+int ff_ni_emu_pool_wait(int pool, int64_t timeout)
+{
+    int64_t deadline = av_gettime_relative() + timeout;
+
+    while (!ff_ni_emu_pool_available(pool)) {
+        if (av_gettime_relative() >= deadline)
+            return 0;
+        av_usleep(500);
+    }
+    return 1;
+}
+
+static int slot_take_locked(int pool)
+{
+    EmuPool *p = &store_pools[pool];
+
+    if (!pool_available_locked(p))
+        return 0;
+
+    /* nienc only accepts recycle indices below NI_MAX_HWDESC_FRAME_INDEX */
+    for (int n = 1; n < NI_MAX_HWDESC_FRAME_INDEX; n++) {
+        int i = store_next_slot;
+
+        store_next_slot = store_next_slot % (NI_MAX_HWDESC_FRAME_INDEX - 1) + 1;
+        if (!store_slots[i].pool) {
+            store_slots[i].pool = pool;
+            p->nb_frames++;
+            return i;
+        }
+    }
+    return 0;
+}
+
+int ff_ni_emu_frame_acquire(int pool, int width, int height, int ni_fmt,
+                            int64_t timeout, niFrameSurface1_t *surf)
+{
+    int64_t deadline = av_gettime_relative() + timeout;
+    int ls[EMU_MAX_PLANES], ph[EMU_MAX_PLANES];
+    EmuSlot *slot;
+    size_t size = 0;
+    uint8_t *p;
+    int idx;
+
+    if (pool <= 0 || pool >= EMU_MAX_POOLS)
+        return 0;
+
+    for (;;) {
+        ff_mutex_lock(&store_lock);
+        idx = slot_take_locked(pool);
+        ff_mutex_unlock(&store_lock);
+        if (idx || av_gettime_relative() >= deadline)
+            break;
+        av_usleep(500);
+    }
+    if (!idx)
+        return 0;
+
+    /* the slot is owned by the caller from here on */
+    slot = &store_slots[idx];
+    slot->frame.nb_planes = ff_ni_emu_layout(ni_fmt, width, height, ls, ph);
+    for (int i = 0; i < EMU_MAX_PLANES; i++)
+        size += (size_t)ls[i] * ph[i];
+    if (size > slot->mem_size) {
+        av_freep(&slot->mem);
+        slot->mem_size = 0;
+        slot->mem = av_malloc(size);
+        if (!slot->mem) {
+            ff_ni_emu_frame_release(idx);
+            return 0;
+        }
+        slot->mem_size = size;
+    }
+
+    slot->frame.width  = width;
+    slot->frame.height = height;
+    slot->frame.format = ni_fmt;
+    p = slot->mem;
+    for (int i = 0; i < EMU_MAX_PLANES; i++) {
+        slot->frame.data[i]         = ls[i] ? p : NULL;
+        slot->frame.linesize[i]     = ls[i];
+        slot->frame.plane_height[i] = ph[i];
+        p += (size_t)ls[i] * ph[i];
+    }
+
+    if (surf)
+        ff_ni_emu_fill_surface(surf, idx);
+    return idx;
+}
+
+EmuFrame *ff_ni_emu_frame_get(int index)
+{
+    EmuFrame *f = NULL;
+
+    if (index <= 0 || index > NI_MAX_HWDESC_FRAME_INDEX)
+        return NULL;
+
+    ff_mutex_lock(&store_lock);
+    if (store_slots[index].pool)
+        f = &store_slots[index].frame;
+    ff_mutex_unlock(&store_lock);
+    return f;
+}
+
+static int frame_release(int index)
+{
+    EmuSlot *slot;
+    EmuPool *p;
+
+    if (index <= 0 || index > NI_MAX_HWDESC_FRAME_INDEX)
+        return NI_RETCODE_INVALID_PARAM;
+
+    ff_mutex_lock(&store_lock);
+    slot = &store_slots[index];
+    if (!slot->pool) {
+        ff_mutex_unlock(&store_lock);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    p = &store_pools[slot->pool];
+    slot->pool = 0;
+    p->nb_frames--;
+    if (p->closed) {
+        /* memory of a retired pool is not worth keeping around */
+        av_freep(&slot->mem);
+        slot->mem_size = 0;
+        if (!p->nb_frames)
+            p->in_use = 0;
+    }
+    ff_mutex_unlock(&store_lock);
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_frame_release(int index)
+{
+    frame_release(index);
+}
+
+void ff_ni_emu_fill_surface(niFrameSurface1_t *surf, int index)
+{
+    const EmuSlot *slot = &store_slots[index];
+    const EmuPool *p    = &store_pools[slot->pool];
+    int fmt = slot->frame.format;
+
+    memset(surf, 0, sizeof(*surf));
+    surf->ui16FrameIdx   = index;
+    surf->ui16session_ID = p->session_id;
+    surf->ui16width      = slot->frame.width;
+    surf->ui16height     = slot->frame.height;
+    surf->device_handle  = p->device_handle;
+    surf->bit_depth      = ff_ni_emu_bit_depth_factor(fmt) == 2 ? 2 : 1;
+    surf->encoding_type  = (fmt == NI_PIX_FMT_NV12 || fmt == NI_PIX_FMT_P010LE ||
+                            fmt == NI_PIX_FMT_NV16) ?
+                           NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR :
+                           NI_PIXEL_PLANAR_FORMAT_PLANAR;
+    surf->dma_buf_fd     = -1;
+}
+
+ni_retcode_t ni_hwframe_buffer_recycle(niFrameSurface1_t *surface,
+                                       int32_t device_handle)
+{
+    if (!surface)
+        return NI_RETCODE_INVALID_PARAM;
+    return frame_release(surface->ui16FrameIdx);
+}
+
+ni_retcode_t ni_hwframe_buffer_recycle2(niFrameSurface1_t *surface)
+{
+    if (!surface)
+        return NI_RETCODE_INVALID_PARAM;
+    return frame_release(surface->ui16FrameIdx);
+}
+
+/* ----------------------------------------------------------------------
+ * host frame and packet buffers
+ *
+ * libxcoder callers release these with free(), so they are not allocated
+ * with av_malloc().
+ * ---------------------------------------------------------------------- */
+
+int ff_ni_emu_frame_reserve(ni_frame_t *frame, size_t size)
+{
+    if (frame->p_buffer && frame->buffer_size >= size) {
+        memset(frame->p_buffer, 0, frame->buffer_size);
+        return 0;
+    }
+    free(frame->p_buffer);
+    frame->buffer_size = 0;
+    /* page aligned like the DMA buffers of libxcoder */
+    if (posix_memalign((void **)&frame->p_buffer, EMU_PAGE_SIZE,
+                       FFMAX(size, 1))) {
+        frame->p_buffer = NULL;
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    memset(frame->p_buffer, 0, FFMAX(size, 1));
+    frame->buffer_size = size;
+    return 0;
+}
+
+/* Lay out planes of the given sizes contiguously at the start of p_buffer */
+static void frame_set_planes(ni_frame_t *frame, const uint32_t len[4])
+{
+    uint8_t *p = frame->p_buffer;
+
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        frame->data_len[i] = len[i];
+        frame->p_data[i]   = len[i] ? p : NULL;
+        p += len[i];
+    }
+}
+
+void ff_ni_emu_frame_linesize(const ni_frame_t *frame, int ni_fmt,
+                              int linesize[EMU_MAX_PLANES])
+{
+    int ls[EMU_MAX_PLANES], ph[EMU_MAX_PLANES];
+
+    ff_ni_emu_layout(ni_fmt, frame->video_width, frame->video_height, ls, ph);
+    for (int i = 0; i < EMU_MAX_PLANES; i++)
+        linesize[i] = ph[i] && frame->data_len[i] ? frame->data_len[i] / ph[i] : 0;
+}
+
+ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
+                                   int video_height, int alignment,
+                                   int metadata_flag, int factor,
+                                   int hw_frame_count, int is_planar)
+{
+    uint32_t len[4] = { 0 };
+    int stride[4], height[4];
+    size_t size;
+
+    if (!p_frame)
+        return NI_RETCODE_INVALID_PARAM;
+
+    if (hw_frame_count > 0) {
+        /* descriptors only: p_data[0] is the start of the surface array */
+        size = hw_frame_count * sizeof(niFrameSurface1_t);
+        if (ff_ni_emu_frame_reserve(p_frame, size) < 0)
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        len[3] = size;
+        frame_set_planes(p_frame, len);
+        p_frame->p_data[0] = p_frame->p_data[1] = p_frame->p_data[2] =
+            p_frame->p_buffer;
+    } else {
+        ni_get_hw_yuv420p_dim(video_width, video_height, FFMAX(factor, 1),
+                              is_planar == NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR,
+                              stride, height);
+        for (int i = 0; i < 3; i++)
+            len[i] = stride[i] * height[i];
+        size = len[0] + len[1] + len[2] +
+               (metadata_flag ? NI_FW_META_DATA_SZ : 0);
+        if (ff_ni_emu_frame_reserve(p_frame, size) < 0)
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        frame_set_planes(p_frame, len);
+    }
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_alloc_dl(ni_frame_t *p_frame, int video_width,
+                                      int video_height, int pixel_format)
+{
+    int ls[EMU_MAX_PLANES], ph[EMU_MAX_PLANES];
+    uint32_t len[4] = { 0 };
+
+    if (!p_frame ||
+        !ff_ni_emu_layout(pixel_format, video_width, video_height, ls, ph))
+        return NI_RETCODE_INVALID_PARAM;
+
+    for (int i = 0; i < EMU_MAX_PLANES; i++)
+        len[i] = ls[i] * ph[i];
+    if (ff_ni_emu_frame_reserve(p_frame, len[0] + len[1] + len[2] + len[3]) < 0)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    frame_set_planes(p_frame, len);
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    p_frame->pixel_format = pixel_format;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_alloc_hwenc(ni_frame_t *pframe, int video_width,
+                                         int video_height, int extra_len)
+{
+    uint32_t len[4] = { 0, 0, 0, sizeof(niFrameSurface1_t) };
+
+    if (!pframe)
+        return NI_RETCODE_INVALID_PARAM;
+    if (ff_ni_emu_frame_reserve(pframe, len[3] + FFMAX(extra_len, 0)) < 0)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    frame_set_planes(pframe, len);
+    pframe->video_width  = video_width;
+    pframe->video_height = video_height;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_alloc_pixfmt(ni_frame_t *pframe, int pixel_format,
+                                          int video_width, int video_height,
+                                          int linesize[], int alignment,
+                                          int extra_len)
+{
+    int ls[EMU_MAX_PLANES], ph[EMU_MAX_PLANES];
+    uint32_t len[4] = { 0 };
+    size_t size = 0;
+    int nb_planes;
+
+    if (!pframe)
+        return NI_RETCODE_INVALID_PARAM;
+    nb_planes = ff_ni_emu_layout(pixel_format, video_width, video_height, ls, ph);
+    if (!nb_planes)
+        return NI_RETCODE_INVALID_PARAM;
+
+    for (int i = 0; i < nb_planes; i++) {
+        len[i] = FFMAX(linesize[i], ls[i]) * ph[i];
+        size  += FFMAX(linesize[i], ls[i]) * FFALIGN(ph[i], 2);
+    }
+    if (ff_ni_emu_frame_reserve(pframe, size + FFMAX(extra_len, 0)) < 0)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    frame_set_planes(pframe, len);
+    /* planes have room for an even number of rows, the uploader extends
+     * 4:2:0 frames of odd height by cloning their last row */
+    for (int i = 1; i < nb_planes; i++)
+        pframe->p_data[i] = pframe->p_data[i - 1] +
+                            FFMAX(linesize[i - 1], ls[i - 1]) * FFALIGN(ph[i - 1], 2);
+    pframe->video_width  = video_width;
+    pframe->video_height = video_height;
+    pframe->pixel_format = pixel_format;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_encoder_sw_frame_buffer_alloc(bool planar, ni_frame_t *p_frame,
+                                              int video_width,
+                                              int video_height,
+                                              int linesize[], int alignment,
+                                              int extra_len,
+                                              bool alignment_2pass_wa)
+{
+    int chroma_h = FFALIGN(video_height, 2) / 2;
+    /* the 2-pass workaround pads the last chroma plane to a 32-line luma
+     * height; keep room for it past the nominal plane size */
+    int pad_h    = FFALIGN(video_height, 32) / 2 - chroma_h;
+    uint32_t len[4] = { 0 };
+    int last;
+
+    if (!p_frame || !linesize)
+        return NI_RETCODE_INVALID_PARAM;
+
+    len[0] = linesize[0] * video_height;
+    len[1] = linesize[1] * chroma_h;
+    len[2] = planar ? linesize[2] * chroma_h : 0;
+    last   = planar ? 2 : 1;
+
+    if (ff_ni_emu_frame_reserve(p_frame, len[0] + len[1] + len[2] +
+                                (size_t)linesize[last] * FFMAX(pad_h, 0) +
+                                FFMAX(extra_len, 0)) < 0)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    frame_set_planes(p_frame, len);
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_encoder_frame_buffer_alloc(ni_frame_t *pframe, int video_width,
+                                           int video_height, int linesize[],
+                                           int alignment, int extra_len,
+                                           bool alignment_2pass_wa)
+{
+    return ni_encoder_sw_frame_buffer_alloc(true, pframe, video_width,
+                                            video_height, linesize, alignment,
+                                            extra_len, alignment_2pass_wa);
+}
+
+ni_retcode_t ni_encoder_frame_zerocopy_buffer_alloc(ni_frame_t *p_frame,
+                                                    int video_width,
+                                                    int video_height,
+                                                    const int linesize[],
+                                                    const uint8_t *data[],
+                                                    int extra_len)
+{
+    int chroma_h = FFALIGN(video_height, 2) / 2;
+
+    if (!p_frame || !linesize || !data)
+        return NI_RETCODE_INVALID_PARAM;
+
+    free(p_frame->p_metadata_buffer);
+    p_frame->metadata_buffer_size = 0;
+    p_frame->p_metadata_buffer = calloc(1, FFMAX(extra_len, 1));
+    if (!p_frame->p_metadata_buffer)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    p_frame->metadata_buffer_size = FFMAX(extra_len, 1);
+
+    for (int i = 0; i < 3; i++) {
+        p_frame->p_data[i]   = (uint8_t *)data[i];
+        p_frame->data_len[i] = linesize[i] * (i ? chroma_h : video_height);
+    }
+    p_frame->p_data[3]    = NULL;
+    p_frame->data_len[3]  = 0;
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_free(ni_frame_t *pframe)
+{
+    if (!pframe)
+        return NI_RETCODE_INVALID_PARAM;
+
+    ni_memfree(pframe->p_buffer);
+    ni_memfree(pframe->p_metadata_buffer);
+    ni_memfree(pframe->p_start_buffer);
+    pframe->buffer_size          = 0;
+    pframe->metadata_buffer_size = 0;
+    pframe->start_buffer_size    = 0;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        pframe->p_data[i]   = NULL;
+        pframe->data_len[i] = 0;
+    }
+    ni_frame_wipe_aux_data(pframe);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_packet_buffer_alloc(ni_packet_t *ppacket, int packet_size)
+{
+    if (!ppacket || packet_size < 0)
+        return NI_RETCODE_INVALID_PARAM;
+
+    if (!ppacket->p_buffer || ppacket->buffer_size < (uint32_t)packet_size) {
+        free(ppacket->p_buffer);
+        ppacket->buffer_size = 0;
+        ppacket->p_buffer = malloc(FFMAX(packet_size, 1));
+        if (!ppacket->p_buffer) {
+            ppacket->p_data = NULL;
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+        ppacket->buffer_size = packet_size;
+    }
+    ppacket->p_data = ppacket->p_buffer;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_packet_buffer_free(ni_packet_t *ppacket)
+{
+    if (!ppacket)
+        return NI_RETCODE_INVALID_PARAM;
+
+    ni_memfree(ppacket->p_buffer);
+    ppacket->p_data      = NULL;
+    ppacket->buffer_size = 0;
+    ppacket->data_len    = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_packet_buffer_free_av1(ni_packet_t *ppacket)
+{
+    if (!ppacket)
+        return NI_RETCODE_INVALID_PARAM;
+
+    for (int i = 0; i < MAX_AV1_ENCODER_GOP_NUM; i++) {
+        ni_memfree(ppacket->av1_p_buffer[i]);
+        ppacket->av1_p_data[i]      = NULL;
+        ppacket->av1_buffer_size[i] = 0;
+        ppacket->av1_data_len[i]    = 0;
+    }
+    ppacket->av1_buffer_index = 0;
+    return ni_packet_buffer_free(ppacket);
+}
+
+int ni_packet_copy(void *p_destination, const void *const p_source,
+                   int cur_size, void *p_leftover, int *p_prev_size)
+{
+    uint8_t *dst = p_destination;
+    int prev = p_prev_size ? *p_prev_size : 0;
+
+    if (!prev && cur_size <= 0)
+        return 0;
+    if (!dst || (cur_size > 0 && !p_source) || (prev > 0 && !p_leftover))
+        return NI_RETCODE_INVALID_PARAM;
+
+    if (prev > 0)
+        memcpy(dst, p_leftover, prev);
+    if (cur_size > 0)
+        memcpy(dst + prev, p_source, cur_size);
+    if (p_prev_size)
+        *p_prev_size = 0;
+    return prev + cur_size;
+}
+
+/* ----------------------------------------------------------------------
+ * frame side data
+ * ---------------------------------------------------------------------- */
+
+static void aux_data_free(ni_aux_data_t **p)
+{
+    if (*p) {
+        free((*p)->data);
+        free(*p);
+        *p = NULL;
+    }
+}
+
+ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame, ni_aux_data_type_t type,
+                                     int data_size)
+{
+    ni_aux_data_t *ret;
+
+    if (!frame || data_size < 0)
+        return NULL;
+    ni_frame_free_aux_data(frame, type);
+    if (frame->nb_aux_data >= NI_MAX_NUM_AUX_DATA_PER_FRAME)
+        return NULL;
+
+    ret = calloc(1, sizeof(*ret));
+    if (!ret)
+        return NULL;
+    ret->data = calloc(1, FFMAX(data_size, 1));
+    if (!ret->data) {
+        free(ret);
+        return NULL;
+    }
+    ret->type = type;
+    ret->size = data_size;
+    frame->aux_data[frame->nb_aux_data++] = ret;
+    return ret;
+}
+
+ni_aux_data_t *ni_frame_new_aux_data_from_raw_data(ni_frame_t *frame,
+                                                   ni_aux_data_type_t type,
+                                                   const uint8_t *raw_data,
+                                                   int data_size)
+{
+    ni_aux_data_t *ret = ni_frame_new_aux_data(frame, type, data_size);
+
+    if (ret && raw_data && data_size > 0)
+        memcpy(ret->data, raw_data, data_size);
+    return ret;
+}
+
+ni_aux_data_t *ni_frame_get_aux_data(const ni_frame_t *frame,
+                                     ni_aux_data_type_t type)
+{
+    for (int i = 0; frame && i < frame->nb_aux_data; i++)
+        if (frame->aux_data[i]->type == type)
+            return frame->aux_data[i];
+    return NULL;
+}
+
+void ni_frame_free_aux_data(ni_frame_t *frame, ni_aux_data_type_t type)
+{
+    for (int i = 0; frame && i < frame->nb_aux_data; i++) {
+        if (frame->aux_data[i]->type == type) {
+            aux_data_free(&frame->aux_data[i]);
+            frame->aux_data[i] = frame->aux_data[--frame->nb_aux_data];
+            frame->aux_data[frame->nb_aux_data] = NULL;
+            return;
+        }
+    }
+}
+
+void ni_frame_wipe_aux_data(ni_frame_t *frame)
+{
+    for (int i = 0; frame && i < frame->nb_aux_data; i++)
+        aux_data_free(&frame->aux_data[i]);
+    if (frame)
+        frame->nb_aux_data = 0;
+}
+
+/* ----------------------------------------------------------------------
+ * resource management
+ * ---------------------------------------------------------------------- */
+
+static void fill_device_info(ni_device_info_t *info, ni_device_type_t type)
+{
+    memset(info, 0, sizeof(*info));
+    av_strlcpy(info->dev_name, EMU_DEV_NAME, sizeof(info->dev_name));
+    av_strlcpy(info->blk_name, EMU_BLK_NAME, sizeof(info->blk_name));
+    av_strlcpy(info->fw_rev, "6rEmu", sizeof(info->fw_rev));
+    info->device_type      = type;
+    info->max_instance_cnt = 256;
+}
+
+ni_retcode_t ni_rsrc_list_all_devices(ni_device_t *p_device)
+{
+    if (!p_device)
+        return NI_RETCODE_INVALID_PARAM;
+
+    memset(p_device, 0, sizeof(*p_device));
+    for (int t = 0; t < NI_DEVICE_TYPE_XCODER_MAX; t++) {
+        p_device->xcoder_cnt[t] = 1;
+        fill_device_info(&p_device->xcoders[t][0], t);
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_device_info_t *ni_rsrc_get_device_info(ni_device_type_t device_type, int guid)
+{
+    ni_device_info_t *info;
+
+    if (guid != 0 || device_type < 0 || device_type >= NI_DEVICE_TYPE_XCODER_MAX)
+        return NULL;
+    info = malloc(sizeof(*info));
+    if (info)
+        fill_device_info(info, device_type);
+    return info;
+}
+
+int ni_rsrc_get_device_by_block_name(const char *blk_name,
+                                     ni_device_type_t device_type)
+{
+    return blk_name && !strcmp(blk_name, EMU_BLK_NAME) ? 0 : -1;
+}
+
+void ni_rsrc_free_device_context(ni_device_context_t *p_ctx)
+{
+    free(p_ctx);
+}
+
+/* ----------------------------------------------------------------------
+ * devices and sessions
+ * ---------------------------------------------------------------------- */
+
+static atomic_int emu_next_handle  = 3;
+static atomic_int emu_next_session = 1;
+
+ni_device_handle_t ni_device_open(const char *dev, uint32_t *p_max_io_size_out)
+{
+    if (p_max_io_size_out)
+        *p_max_io_size_out = NI_MAX_TX_SZ;
+    return atomic_fetch_add(&emu_next_handle, 1);
+}
+
+void ni_device_close(ni_device_handle_t dev)
+{
+}
+
+ni_retcode_t ni_device_session_context_init(ni_session_context_t *p_ctx)
+{
+    if (!p_ctx)
+        return NI_RETCODE_INVALID_PARAM;
+
+    /* Nothing is allocated here: the hwcontext duplicates frame contexts,
+     * session context included, with memcpy() and clears every copy. */
+    memset(p_ctx, 0, sizeof(*p_ctx));
+
+    p_ctx->session_id         = NI_INVALID_SESSION_ID;
+    p_ctx->device_handle      = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->blk_io_handle      = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->sender_handle      = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->auto_dl_handle     = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->hw_id              = -1;
+    p_ctx->keep_alive_timeout = NI_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    p_ctx->src_bit_depth      = 8;
+    p_ctx->bit_depth_factor   = 1;
+    p_ctx->pixel_format       = NI_PIX_FMT_YUV420P;
+    p_ctx->max_nvme_io_size   = NI_MAX_TX_SZ;
+    p_ctx->prev_pts           = NI_NOPTS_VALUE;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ni_device_session_context_clear(ni_session_context_t *p_ctx)
+{
+    if (!p_ctx)
+        return;
+    ni_memfree(p_ctx->p_leftover);
+    ni_memfree(p_ctx->p_master_display_meta_data);
+    for (int i = 0; i < NI_FIFO_SZ; i++)
+        ni_memfree(p_ctx->pkt_custom_sei_set[i]);
+}
+
+static int generic_open(ni_session_context_t *p_ctx, int device_type)
+{
+    EmuSession *s = av_mallocz(sizeof(*s));
+
+    if (!s)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    s->device_type = device_type;
+    ff_ni_emu_timer_init(&s->timer, device_type);
+    p_ctx->emu = s;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
+                                    ni_device_type_t device_type)
+{
+    int ret;
+
+    if (!p_ctx || device_type < 0 || device_type >= NI_DEVICE_TYPE_MAX)
+        return NI_RETCODE_INVALID_PARAM;
+    if (p_ctx->emu)
+        return NI_RETCODE_SUCCESS;
+
+    if (p_ctx->device_handle == NI_INVALID_DEVICE_HANDLE)
+        p_ctx->device_handle = ni_device_open(EMU_BLK_NAME, NULL);
+    if (p_ctx->blk_io_handle == NI_INVALID_DEVICE_HANDLE)
+        p_ctx->blk_io_handle = p_ctx->device_handle;
+    if (p_ctx->hw_id < 0)
+        p_ctx->hw_id = 0;
+    if (!p_ctx->dev_xcoder_name[0])
+        av_strlcpy(p_ctx->dev_xcoder_name, EMU_DEV_NAME,
+                   sizeof(p_ctx->dev_xcoder_name));
+    if (!p_ctx->blk_xcoder_name[0])
+        av_strlcpy(p_ctx->blk_xcoder_name, EMU_BLK_NAME,
+                   sizeof(p_ctx->blk_xcoder_name));
+    if (!p_ctx->blk_dev_name[0])
+        av_strlcpy(p_ctx->blk_dev_name, EMU_BLK_NAME,
+                   sizeof(p_ctx->blk_dev_name));
+
+    p_ctx->device_type       = device_type;
+    p_ctx->session_id        = atomic_fetch_add(&emu_next_session, 1) & 0xFFFF;
+    p_ctx->session_timestamp = av_gettime();
+    p_ctx->status            = NI_RETCODE_SUCCESS;
+    p_ctx->ready_to_close    = 0;
+    p_ctx->frame_num         = 0;
+    p_ctx->pkt_num           = 0;
+
+    switch (device_type) {
+    case NI_DEVICE_TYPE_ENCODER:
+        ret = ff_ni_emu_enc_open(p_ctx);
+        break;
+    case NI_DEVICE_TYPE_DECODER:
+        if (!p_ctx->p_leftover)
+            p_ctx->p_leftover = malloc(EMU_LEFTOVER_SIZE);
+        ret = p_ctx->p_leftover ? ff_ni_emu_dec_open(p_ctx) :
+                                  NI_RETCODE_ERROR_MEM_ALOC;
+        break;
+    case NI_DEVICE_TYPE_SCALER:
+        ret = ff_ni_emu_scaler_open(p_ctx);
+        break;
+    case NI_DEVICE_TYPE_AI:
+        ret = ff_ni_emu_ai_open(p_ctx);
+        break;
+    default:
+        ret = generic_open(p_ctx, device_type);
+        break;
+    }
+    if (ret < 0)
+        p_ctx->session_id = NI_INVALID_SESSION_ID;
+    return ret;
+}
+
+ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx,
+                                     int eos_received,
+                                     ni_device_type_t device_type)
+{
+    EmuSession *s;
+
+    if (!p_ctx)
+        return NI_RETCODE_INVALID_PARAM;
+    s = p_ctx->emu;
+    if (!s)
+        return NI_RETCODE_SUCCESS;
+
+    switch (s->device_type) {
+    case NI_DEVICE_TYPE_ENCODER:
+        ff_ni_emu_enc_close(p_ctx);
+        break;
+    case NI_DEVICE_TYPE_DECODER:
+        ff_ni_emu_dec_close(p_ctx);
+        break;
+    case NI_DEVICE_TYPE_SCALER:
+        ff_ni_emu_scaler_close(p_ctx);
+        break;
+    case NI_DEVICE_TYPE_AI:
+        ff_ni_emu_ai_close(p_ctx);
+        break;
+    default:
+        ff_ni_emu_pool_close(s->pool);
+        av_free(s);
+        break;
+    }
+    p_ctx->emu        = NULL;
+    p_ctx->session_id = NI_INVALID_SESSION_ID;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_flush(ni_session_context_t *p_ctx,
+                                     ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (s->device_type == NI_DEVICE_TYPE_ENCODER)
+        return ff_ni_emu_enc_flush(p_ctx);
+    if (s->device_type == NI_DEVICE_TYPE_DECODER)
+        return ff_ni_emu_dec_flush(p_ctx);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_dec_session_flush(ni_session_context_t *p_ctx)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s || s->device_type != NI_DEVICE_TYPE_DECODER)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    ff_ni_emu_dec_reset(p_ctx);
+    return NI_RETCODE_SUCCESS;
+}
+
+int ni_device_session_write(ni_session_context_t *p_ctx,
+                            ni_session_data_io_t *p_data,
+                            ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s || !p_data)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (s->device_type == NI_DEVICE_TYPE_ENCODER)
+        return ff_ni_emu_enc_write(p_ctx, &p_data->data.frame);
+    if (s->device_type == NI_DEVICE_TYPE_DECODER)
+        return ff_ni_emu_dec_write(p_ctx, &p_data->data.packet);
+    if (s->device_type == NI_DEVICE_TYPE_AI)
+        return ff_ni_emu_ai_write(p_ctx, &p_data->data.frame);
+    return NI_RETCODE_INVALID_PARAM;
+}
+
+int ni_device_session_read(ni_session_context_t *p_ctx,
+                           ni_session_data_io_t *p_data,
+                           ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s || !p_data)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (s->device_type == NI_DEVICE_TYPE_ENCODER)
+        return ff_ni_emu_enc_read(p_ctx, &p_data->data.packet);
+    if (s->device_type == NI_DEVICE_TYPE_DECODER)
+        return ff_ni_emu_dec_read(p_ctx, &p_data->data.frame, 0);
+    if (s->device_type == NI_DEVICE_TYPE_AI)
+        return ff_ni_emu_ai_read(p_ctx, &p_data->data.packet);
+    return NI_RETCODE_FAILURE;
+}
+
+int ni_device_session_read_hwdesc(ni_session_context_t *p_ctx,
+                                  ni_session_data_io_t *p_data,
+                                  ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s || !p_data)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (s->device_type == NI_DEVICE_TYPE_DECODER)
+        return ff_ni_emu_dec_read(p_ctx, &p_data->data.frame, 1);
+    if (s->device_type == NI_DEVICE_TYPE_SCALER)
+        return ff_ni_emu_scaler_read_hwdesc(p_ctx, &p_data->data.frame);
+    if (s->device_type == NI_DEVICE_TYPE_AI)
+        return ff_ni_emu_ai_read_hwdesc(p_ctx, &p_data->data.frame);
+    return NI_RETCODE_FAILURE;
+}
+
+int ni_device_session_init_framepool(ni_session_context_t *p_ctx,
+                                     uint32_t pool_size, uint32_t pool)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+
+    ff_ni_emu_pool_close(s->pool);
+    s->pool = ff_ni_emu_pool_create(pool_size, !!(pool & NI_UPLOADER_FLAG_LM),
+                                    p_ctx->session_id, p_ctx->device_handle);
+    return s->pool ? NI_RETCODE_SUCCESS : NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+}
+
+ni_retcode_t ni_device_session_query_buffer_avail(ni_session_context_t *p_ctx,
+                                                  ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+
+    if (!s)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (!s->pool || ff_ni_emu_pool_wait(s->pool, ff_ni_emu_config()->timeout))
+        return NI_RETCODE_SUCCESS;
+    return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+}
+
+ni_retcode_t ni_device_session_acquire(ni_session_context_t *p_ctx,
+                                       ni_frame_t *p_frame)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+    niFrameSurface1_t surf;
+    int idx;
+
+    if (!s || !s->pool)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+
+    idx = ff_ni_emu_frame_acquire(s->pool, p_ctx->active_video_width,
+                                  p_ctx->active_video_height,
+                                  p_ctx->pixel_format,
+                                  ff_ni_emu_config()->timeout, &surf);
+    if (!idx)
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    if (p_frame && p_frame->p_data[3])
+        memcpy(p_frame->p_data[3], &surf, sizeof(surf));
+    return NI_RETCODE_SUCCESS;
+}
+
+int ni_device_session_hwup(ni_session_context_t *p_ctx,
+                           ni_session_data_io_t *p_src_data,
+                           niFrameSurface1_t *hwdesc)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+    int row_bytes[EMU_MAX_PLANES], src_ls[EMU_MAX_PLANES];
+    ni_frame_t *src;
+    EmuFrame *f;
+    int64_t ready;
+    int idx;
+
+    if (!s || !s->pool || !p_src_data || !hwdesc)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+
+    src   = &p_src_data->data.frame;
+    ready = ff_ni_emu_timer_schedule(&s->timer);
+    idx   = ff_ni_emu_frame_acquire(s->pool, src->video_width,
+                                    src->video_height, p_ctx->pixel_format,
+                                    ff_ni_emu_config()->timeout, hwdesc);
+    if (!idx)
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+
+    f = ff_ni_emu_frame_get(idx);
+    ff_ni_emu_frame_linesize(src, f->format, src_ls);
+    ff_ni_emu_row_bytes(f->format, f->width, row_bytes);
+    ff_ni_emu_copy_planes(f->data, f->linesize, src->p_data, src_ls,
+                          row_bytes, f->plane_height, f->nb_planes);
+
+    ff_ni_emu_wait_until(ready);
+    return NI_RETCODE_SUCCESS;
+}
+
+int ni_device_session_hwdl(ni_session_context_t *p_ctx,
+                           ni_session_data_io_t *p_data,
+                           niFrameSurface1_t *hwdesc)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+    int row_bytes[EMU_MAX_PLANES], dst_ls[EMU_MAX_PLANES];
+    int rows[EMU_MAX_PLANES];
+    int64_t ready = 0;
+    ni_frame_t *dst;
+    EmuFrame *f;
+    int ret = 0;
+
+    if (!p_data || !hwdesc)
+        return NI_RETCODE_INVALID_PARAM;
+    f = ff_ni_emu_frame_get(hwdesc->ui16FrameIdx);
+    if (!f)
+        return NI_RETCODE_INVALID_PARAM;
+    if (s)
+        ready = ff_ni_emu_timer_schedule(&s->timer);
+
+    dst = &p_data->data.frame;
+    if (!dst->video_width || !dst->video_height) {
+        dst->video_width  = f->width;
+        dst->video_height = f->height;
+    }
+    ff_ni_emu_frame_linesize(dst, f->format, dst_ls);
+    ff_ni_emu_row_bytes(f->format, FFMIN(f->width, (int)dst->video_width), row_bytes);
+    for (int i = 0; i < EMU_MAX_PLANES; i++) {
+        rows[i] = dst_ls[i] ? FFMIN(f->plane_height[i],
+                                    (int)(dst->data_len[i] / dst_ls[i])) : 0;
+        ret    += dst->data_len[i];
+    }
+    ff_ni_emu_copy_planes(dst->p_data, dst_ls, f->data, f->linesize,
+                          row_bytes, rows, f->nb_planes);
+    dst->pixel_format = f->format;
+
+    ff_ni_emu_wait_until(ready);
+    return FFMAX(ret, 1);
+}
+
+ni_retcode_t ni_device_session_copy(ni_session_context_t *src_p_ctx,
+                                    ni_session_context_t *dst_p_ctx)
+{
+    if (!src_p_ctx || !dst_p_ctx)
+        return NI_RETCODE_INVALID_PARAM;
+
+    dst_p_ctx->device_handle = src_p_ctx->device_handle;
+    dst_p_ctx->blk_io_handle = src_p_ctx->blk_io_handle;
+    dst_p_ctx->session_id    = src_p_ctx->session_id;
+    dst_p_ctx->hw_id         = src_p_ctx->hw_id;
+    dst_p_ctx->device_type   = src_p_ctx->device_type;
+    av_strlcpy(dst_p_ctx->blk_dev_name, src_p_ctx->blk_dev_name,
+               sizeof(dst_p_ctx->blk_dev_name));
+    av_strlcpy(dst_p_ctx->dev_xcoder_name, src_p_ctx->dev_xcoder_name,
+               sizeof(dst_p_ctx->dev_xcoder_name));
+    av_strlcpy(dst_p_ctx->blk_xcoder_name, src_p_ctx->blk_xcoder_name,
+               sizeof(dst_p_ctx->blk_xcoder_name));
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_ctx,
+                                               int width, int height,
+                                               int bit_depth_factor,
+                                               ni_device_type_t device_type)
+{
+    if (!p_ctx || !p_ctx->emu)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+
+    p_ctx->active_video_width  = width;
+    p_ctx->active_video_height = height;
+    p_ctx->bit_depth_factor    = bit_depth_factor;
+    return NI_RETCODE_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------
+ * uploader helpers
+ * ---------------------------------------------------------------------- */
+
+ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
+                                             ni_xcoder_params_t *p_enc_params,
+                                             int width, int height,
+                                             const int linesize[],
+                                             bool set_linesize)
+{
+    /* host memory is never mapped by the emulated device */
+    return NI_RETCODE_FAILURE;
+}
+
+ni_retcode_t ni_uploader_frame_zerocopy_check(ni_session_context_t *p_upl_ctx,
+                                              int width, int height,
+                                              const int linesize[],
+                                              int pixel_format)
+{
+    return NI_RETCODE_FAILURE;
+}
+
+ni_retcode_t ni_uploader_set_frame_format(ni_session_context_t *p_upl_ctx,
+                                          int width, int height,
+                                          ni_pix_fmt_t pixel_format, int isP2P)
+{
+    if (!p_upl_ctx)
+        return NI_RETCODE_INVALID_PARAM;
+
+    p_upl_ctx->active_video_width  = width;
+    p_upl_ctx->active_video_height = height;
+    p_upl_ctx->pixel_format        = pixel_format;
+    p_upl_ctx->bit_depth_factor    = FFMIN(ff_ni_emu_bit_depth_factor(pixel_format), 2);
+    p_upl_ctx->isP2P               = isP2P;
+    return NI_RETCODE_SUCCESS;
+}
+
+uint32_t ni_calculate_total_frame_size(const ni_session_context_t *p_upl_session,
+                                       const int linesize[])
+{
+    int ls[EMU_MAX_PLANES], ph[EMU_MAX_PLANES];
+    uint32_t total = 0;
+
+    ff_ni_emu_layout(p_upl_session->pixel_format,
+                     p_upl_session->active_video_width,
+                     p_upl_session->active_video_height, ls, ph);
+    for (int i = 0; i < EMU_MAX_PLANES; i++)
+        total += linesize[i] * ph[i];
+    return total;
+}
+
+ni_retcode_t ni_p2p_send(ni_session_context_t *pSession,
+                         niFrameSurface1_t *source, uint64_t ui64DestAddr,
+                         uint32_t ui32FrameSize)
+{
+    /* peer-to-peer DMA has no host equivalent */
+    return NI_RETCODE_FAILURE;
+}
+
+/* ----------------------------------------------------------------------
+ * codec parameters
+ * ---------------------------------------------------------------------- */
+
+ni_retcode_t ni_encoder_init_default_params(ni_xcoder_params_t *p_param,
+                                            int fps_num, int fps_denom,
+                                            long bit_rate, int width, int height,
+                                            ni_codec_format_t codec_format)
+{
+    ni_encoder_cfg_params_t *cfg;
+
+    if (!p_param)
+        return NI_RETCODE_INVALID_PARAM;
+
+    memset(p_param, 0, sizeof(*p_param));
+    cfg = &p_param->cfg_enc_params;
+
+    p_param->log             = NI_LOG_INFO;
+    p_param->fps_number      = fps_num > 0 ? fps_num : 30;
+    p_param->fps_denominator = fps_num > 0 && fps_denom > 0 ? fps_denom : 1;
+    p_param->source_width    = width;
+    p_param->source_height   = height;
+    p_param->bitrate         = bit_rate > 0 ? bit_rate : 200000;
+
+    cfg->frame_rate         = p_param->fps_number / p_param->fps_denominator;
+    cfg->planar             = 1;
+    cfg->intra_period       = 120;
+    cfg->gop_preset_index   = -1;
+    cfg->crf                = -1;
+    cfg->crfFloat           = -1.0f;
+    cfg->keep_alive_timeout = NI_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    cfg->colorPrimaries     = 2;
+    cfg->colorTrc           = 2;
+    cfg->colorSpace         = 2;
+    cfg->rc.intra_qp        = 22;
+    cfg->rc.min_qp          = 8;
+    cfg->rc.max_qp          = 51;
+    cfg->rc.max_delta_qp    = 10;
+    cfg->rc.vbv_buffer_size = -1;
+
+    p_param->dec_input_params.max_extra_hwframe_cnt = 255;
+
+    if (width > NI_PARAM_MAX_WIDTH)
+        return NI_RETCODE_PARAM_ERROR_WIDTH_TOO_BIG;
+    if (width > 0 && width < NI_MIN_WIDTH)
+        return NI_RETCODE_PARAM_ERROR_WIDTH_TOO_SMALL;
+    if (height > NI_MAX_RESOLUTION_HEIGHT)
+        return NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_BIG;
+    if (height > 0 && height < NI_MIN_HEIGHT)
+        return NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_SMALL;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_decoder_init_default_params(ni_xcoder_params_t *p_param,
+                                            int fps_num, int fps_denom,
+                                            long bit_rate, int width, int height)
+{
+    if (!p_param)
+        return NI_RETCODE_INVALID_PARAM;
+
+    memset(p_param, 0, sizeof(*p_param));
+    p_param->log             = NI_LOG_INFO;
+    p_param->fps_number      = fps_num > 0 ? fps_num : 30;
+    p_param->fps_denominator = fps_num > 0 && fps_denom > 0 ? fps_denom : 1;
+    p_param->source_width    = width;
+    p_param->source_height   = height;
+    p_param->bitrate         = bit_rate;
+    p_param->dec_input_params.keep_alive_timeout    = NI_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    p_param->dec_input_params.max_extra_hwframe_cnt = 255;
+    p_param->dec_input_params.crop_mode[0] = NI_DEC_CROP_MODE_AUTO;
+    p_param->dec_input_params.crop_mode[1] = NI_DEC_CROP_MODE_AUTO;
+    p_param->dec_input_params.crop_mode[2] = NI_DEC_CROP_MODE_AUTO;
+    return NI_RETCODE_SUCCESS;
+}
+
+static int parse_int(const char *value, int *out)
+{
+    char *end;
+    long v = strtol(value, &end, 0);
+
+    if (end == value || *end)
+        return NI_RETCODE_PARAM_INVALID_VALUE;
+    *out = v;
+    return NI_RETCODE_SUCCESS;
+}
+
+/*
+ * Only the options that influence the emulated stream are interpreted; all
+ * other libxcoder options are accepted and ignored so that command lines
+ * written for the card run unchanged.
+ */
+ni_retcode_t ni_encoder_params_set_value(ni_xcoder_params_t *p_params,
+                                         const char *name, const char *value)
+{
+    ni_encoder_cfg_params_t *cfg;
+
+    if (!p_params || !name || !value)
+        return NI_RETCODE_INVALID_PARAM;
+    cfg = &p_params->cfg_enc_params;
+
+    if (!strcmp(name, "bitrate"))
+        return parse_int(value, &p_params->bitrate);
+    if (!strcmp(name, "intraPeriod"))
+        return parse_int(value, &cfg->intra_period);
+    if (!strcmp(name, "gopPresetIdx"))
+        return parse_int(value, &cfg->gop_preset_index);
+    if (!strcmp(name, "lowDelay"))
+        return parse_int(value, &p_params->low_delay_mode);
+    if (!strcmp(name, "RcEnable"))
+        return parse_int(value, &cfg->rc.enable_rate_control);
+    if (!strcmp(name, "crf"))
+        return parse_int(value, &cfg->crf);
+    if (!strcmp(name, "lookAheadDepth"))
+        return parse_int(value, &cfg->lookAheadDepth);
+    if (!strcmp(name, "frameRate"))
+        return parse_int(value, &cfg->frame_rate);
+    if (!strcmp(name, "repeatHeaders"))
+        return parse_int(value, &cfg->forced_header_enable);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_decoder_params_set_value(ni_xcoder_params_t *p_params,
+                                         const char *name, char *value)
+{
+    ni_decoder_input_params_t *dec;
+
+    if (!p_params || !name || !value)
+        return NI_RETCODE_INVALID_PARAM;
+    dec = &p_params->dec_input_params;
+
+    if (!strcmp(name, "out")) {
+        if (!strcmp(value, "hw"))
+            dec->hwframes = 1;
+        else if (!strcmp(value, "sw"))
+            dec->hwframes = 0;
+        else
+            return NI_RETCODE_PARAM_INVALID_VALUE;
+        return NI_RETCODE_SUCCESS;
+    }
+    if (!strncmp(name, "semiplanar", 10) && name[10] >= '0' && name[10] <= '2' &&
+        !name[11])
+        return parse_int(value, &dec->semi_planar[name[10] - '0']);
+    if (!strncmp(name, "force8Bit", 9) && name[9] >= '0' && name[9] <= '2' &&
+        !name[10])
+        return parse_int(value, &dec->force_8_bit[name[9] - '0']);
+    if (!strcmp(name, "enableOut1"))
+        return parse_int(value, &dec->enable_out1);
+    if (!strcmp(name, "enableOut2"))
+        return parse_int(value, &dec->enable_out2);
+    if (!strcmp(name, "lowDelay"))
+        return parse_int(value, &dec->decoder_low_delay);
+    if (!strcmp(name, "maxExtraHwFrameCnt"))
+        return parse_int(value, &dec->max_extra_hwframe_cnt);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_encoder_gop_params_set_value(ni_xcoder_params_t *p_params,
+                                             const char *name,
+                                             const char *value)
+{
+    return p_params && name && value ? NI_RETCODE_SUCCESS :
+                                       NI_RETCODE_INVALID_PARAM;
+}
+
+ni_retcode_t ni_gop_params_check_set(ni_xcoder_params_t *p_param, char *value)
+{
+    return NI_RETCODE_SUCCESS;
+}
+
+bool ni_gop_params_check(ni_xcoder_params_t *p_param)
+{
+    return true;
+}
+
+ni_retcode_t ni_reconfig_ppu_output(ni_session_context_t *p_session_ctx,
+                                    ni_xcoder_params_t *p_param,
+                                    ni_ppu_config_t *ppu_config)
+{
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_dec_reconfig_ppu_params(ni_session_context_t *p_session_ctx,
+                                        ni_xcoder_params_t *p_param,
+                                        ni_ppu_config_t *ppu_config)
+{
+    return NI_RETCODE_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+ * Software emulation of the NETINT libxcoder API - internal interfaces
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_EMU_H
+#define COMPAT_NI_XCODER_NI_EMU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ni_device_api.h"
+
+/*
+ * Device model
+ *
+ * Hardware frames live in a single process-wide store indexed by
+ * niFrameSurface1_t.ui16FrameIdx (1..NI_MAX_HWDESC_FRAME_INDEX). Every frame
+ * belongs to a pool owned by the session that created it (uploader, scaler,
+ * decoder); a pool that is closed while frames are still referenced is kept
+ * alive until the last of them is recycled, as on the card.
+ *
+ * Each session also owns a timer that models the device as a single
+ * pipelined engine: an operation starts when the engine becomes free, keeps
+ * it busy for 1/fps seconds and completes "latency" microseconds later.
+ * Synchronous operations (upload, download, scaling) block until completion;
+ * codec sessions expose results through read() once they are due, and report
+ * back-pressure once "queue" operations are in flight. AI sessions return
+ * results in submission order and block in read() until the oldest is due.
+ *
+ * The behaviour is tuned with the NI_QUADRA_EMU environment variable, a
+ * "key=value:key=value" list:
+ *
+ *   fps         operations per second of every engine, 0 (default) unlimited
+ *   dec_fps, enc_fps, scaler_fps, ai_fps, upload_fps
+ *               the same for a single engine
+ *   latency     completion latency of every operation in microseconds (0)
+ *   queue       codec operations in flight before back-pressure (8)
+ *   timeout     wait for a free pool frame in microseconds (2000000)
+ *   dec_pool    hardware frames of a decoder, 0 (default) for a pool that
+ *               grows when the frames are not returned
+ *
+ * e.g. NI_QUADRA_EMU=enc_fps=240:dec_fps=480:latency=20000
+ */
+
+#define EMU_MAX_PLANES 4
+
+typedef struct EmuConfig {
+    double  fps[NI_DEVICE_TYPE_MAX]; ///< operations per second, 0 = unlimited
+    int64_t latency;                 ///< completion latency in microseconds
+    int     queue;                   ///< codec operations in flight
+    int64_t timeout;                 ///< resource wait timeout in microseconds
+    int     dec_pool;                ///< decoder hardware frames, 0 = growing
+} EmuConfig;
+
+const EmuConfig *ff_ni_emu_config(void);
+
+typedef struct EmuTimer {
+    double  period;     ///< microseconds per operation
+    int64_t busy_until;
+} EmuTimer;
+
+void ff_ni_emu_timer_init(EmuTimer *t, int device_type);
+
+/**
+ * Schedule one operation on the engine and return its completion time in
+ * av_gettime_relative() units.
+ */
+int64_t ff_ni_emu_timer_schedule(EmuTimer *t);
+
+void ff_ni_emu_wait_until(int64_t when);
+
+/**
+ * Device memory layout of a frame, matching ni_get_min_frame_dim().
+ *
+ * @return number of planes
+ */
+int ff_ni_emu_layout(int ni_fmt, int width, int height,
+                     int linesize[EMU_MAX_PLANES],
+                     int plane_height[EMU_MAX_PLANES]);
+
+/**
+ * Width in bytes of the visible part of each plane of a device format.
+ *
+ * @return number of planes
+ */
+int ff_ni_emu_row_bytes(int ni_fmt, int width, int row_bytes[EMU_MAX_PLANES]);
+
+/** Bytes per sample of the first plane of a device format. */
+int ff_ni_emu_bit_depth_factor(int ni_fmt);
+
+/** Device pixel format of a gc620 scaler format code. */
+int ff_ni_emu_gc620_to_ni(int gc620_fmt);
+
+typedef struct EmuFrame {
+    int      width;
+    int      height;
+    int      format;   ///< ni_pix_fmt_t
+    int      nb_planes;
+    uint8_t *data[EMU_MAX_PLANES];
+    int      linesize[EMU_MAX_PLANES];
+    int      plane_height[EMU_MAX_PLANES];
+} EmuFrame;
+
+/**
+ * State shared by all emulated sessions, first member of the per device type
+ * session structures stored in ni_session_context_t.emu.
+ */
+typedef struct EmuSession {
+    int      device_type;
+    EmuTimer timer;
+    int      pool;        ///< hardware frame pool owned by the session
+} EmuSession;
+
+/**
+ * Create a hardware frame pool.
+ *
+ * @param limited if set, at most size frames are handed out and further
+ *                requests wait for a recycle; otherwise size is a hint
+ * @return pool id (> 0) or 0 if no pool slot is left
+ */
+int ff_ni_emu_pool_create(int size, int limited, uint32_t session_id,
+                          int device_handle);
+
+/**
+ * Close a pool. Frames still referenced stay valid until recycled.
+ */
+void ff_ni_emu_pool_close(int pool);
+
+/** Number of free frames in a pool. */
+int ff_ni_emu_pool_available(int pool);
+
+/**
+ * Take a free frame from a pool and give it the requested geometry, waiting
+ * up to timeout microseconds for one to be recycled.
+ *
+ * @param surf if not NULL, filled with the descriptor of the frame
+ * @return frame index or 0 if the pool stayed exhausted
+ */
+int ff_ni_emu_frame_acquire(int pool, int width, int height, int ni_fmt,
+                            int64_t timeout, niFrameSurface1_t *surf);
+
+/**
+ * Look up a frame that is currently allocated. The returned pointer stays
+ * valid until the frame is recycled.
+ */
+EmuFrame *ff_ni_emu_frame_get(int index);
+
+void ff_ni_emu_frame_release(int index);
+
+/** Fill a hardware frame descriptor for a store frame. */
+void ff_ni_emu_fill_surface(niFrameSurface1_t *surf, int index);
+
+/**
+ * Wait until a pool has a free frame.
+ *
+ * @return 1 if a frame is available, 0 on timeout
+ */
+int ff_ni_emu_pool_wait(int pool, int64_t timeout);
+
+/**
+ * Line sizes of the planes of a host frame allocated by one of the
+ * ni_*frame_buffer_alloc*() functions for the given device format.
+ */
+void ff_ni_emu_frame_linesize(const ni_frame_t *frame, int ni_fmt,
+                              int linesize[EMU_MAX_PLANES]);
+
+/** Allocate the host memory of a frame, reusing its buffer if possible. */
+int ff_ni_emu_frame_reserve(ni_frame_t *frame, size_t size);
+
+/**
+ * Copy a rectangle of planes with a matching layout, converting between
+ * strides. Plane sizes are given in bytes per row and rows.
+ */
+void ff_ni_emu_copy_planes(uint8_t *dst[], const int dst_linesize[],
+                           uint8_t *const src[], const int src_linesize[],
+                           const int row_bytes[], const int rows[],
+                           int nb_planes);
+
+/* Per device type session hooks, see ni_emu_codec.c and ni_emu_filter.c */
+
+int  ff_ni_emu_enc_open(ni_session_context_t *p_ctx);
+void ff_ni_emu_enc_close(ni_session_context_t *p_ctx);
+int  ff_ni_emu_enc_flush(ni_session_context_t *p_ctx);
+int  ff_ni_emu_enc_write(ni_session_context_t *p_ctx, ni_frame_t *frame);
+int  ff_ni_emu_enc_read(ni_session_context_t *p_ctx, ni_packet_t *pkt);
+
+int  ff_ni_emu_dec_open(ni_session_context_t *p_ctx);
+void ff_ni_emu_dec_close(ni_session_context_t *p_ctx);
+int  ff_ni_emu_dec_flush(ni_session_context_t *p_ctx);
+void ff_ni_emu_dec_reset(ni_session_context_t *p_ctx);
+int  ff_ni_emu_dec_write(ni_session_context_t *p_ctx, ni_packet_t *pkt);
+int  ff_ni_emu_dec_read(ni_session_context_t *p_ctx, ni_frame_t *frame,
+                        int hwdesc);
+
+int  ff_ni_emu_scaler_open(ni_session_context_t *p_ctx);
+void ff_ni_emu_scaler_close(ni_session_context_t *p_ctx);
+int  ff_ni_emu_scaler_read_hwdesc(ni_session_context_t *p_ctx,
+                                  ni_frame_t *frame);
+
+int  ff_ni_emu_ai_open(ni_session_context_t *p_ctx);
+void ff_ni_emu_ai_close(ni_session_context_t *p_ctx);
+int  ff_ni_emu_ai_write(ni_session_context_t *p_ctx, ni_frame_t *frame);
+int  ff_ni_emu_ai_read(ni_session_context_t *p_ctx, ni_packet_t *pkt);
+int  ff_ni_emu_ai_read_hwdesc(ni_session_context_t *p_ctx, ni_frame_t *frame);
+
+#endif /* COMPAT_NI_XCODER_NI_EMU_H */
@@ -0,0 +1,1560 @@
+/*
+ * Software emulation of the NETINT libxcoder API - encoder and decoder
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The emulated encoder does not compress anything. Every input frame is
+ * turned into a synthetic access unit that carries its geometry, picture
+ * type, frame number and per-plane average in a user data SEI (metadata OBU
+ * for AV1, comment segment for JPEG), followed by filler up to the size the
+ * configured bitrate allows. H.264 access units are fully conformant
+ * (parameter sets, I_16x16 DC intra slices and all-skip P slices) and decode
+ * to a flat grey picture in any decoder; HEVC and AV1 carry valid parameter
+ * sets and sequence headers for parsers and muxers, but no decodable slice
+ * data.
+ *
+ * The emulated decoder looks for that SEI and outputs a flat picture of the
+ * recorded size and average, so that an encode/decode round trip through
+ * the emulation preserves resolution, timestamps and picture types. Streams
+ * from other encoders decode to mid-grey pictures of the configured size.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ni_av_codec.h"
+#include "ni_device_api.h"
+#include "ni_emu.h"
+#include "ni_util.h"
+
+#define EMU_QUEUE_SIZE      256
+#define EMU_MAGIC           "NIEMU"
+#define EMU_MAGIC_LEN       5
+#define EMU_INFO_NIBBLES    23
+#define EMU_INFO_SIZE       (EMU_MAGIC_LEN + EMU_INFO_NIBBLES)
+#define EMU_HEADER_MAX      512
+#define EMU_PKT_FLAG_DISCARD 0x0004
+
+static const uint8_t emu_sei_uuid[16] = "NETINT-QUADRAEMU";
+
+/* Description of one emulated picture, carried in the bitstream */
+typedef struct EmuPicInfo {
+    int      width;
+    int      height;
+    uint8_t  avg[3];
+    int      key;
+    uint32_t number;
+} EmuPicInfo;
+
+/* ----------------------------------------------------------------------
+ * bitstream writing
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuBits {
+    uint8_t *buf;
+    size_t   size;
+    size_t   bit;
+} EmuBits;
+
+static void bits_init(EmuBits *b, uint8_t *buf, size_t size)
+{
+    memset(buf, 0, size);
+    b->buf  = buf;
+    b->size = size;
+    b->bit  = 0;
+}
+
+static void bits_put(EmuBits *b, int n, uint32_t v)
+{
+    for (int i = n - 1; i >= 0; i--, b->bit++)
+        if ((v >> i & 1) && (b->bit >> 3) < b->size)
+            b->buf[b->bit >> 3] |= 0x80 >> (b->bit & 7);
+}
+
+static void bits_ue(EmuBits *b, uint32_t v)
+{
+    int n = av_log2(v + 1);
+
+    bits_put(b, n, 0);
+    bits_put(b, n + 1, v + 1);
+}
+
+static void bits_se(EmuBits *b, int v)
+{
+    bits_ue(b, v > 0 ? 2 * v - 1 : -2 * v);
+}
+
+/* rbsp_trailing_bits(), returns the payload size in bytes */
+static int bits_trailing(EmuBits *b)
+{
+    bits_put(b, 1, 1);
+    b->bit = FFALIGN(b->bit, 8);
+    return FFMIN(b->bit >> 3, b->size);
+}
+
+/* Write a start code, a NAL unit header and an escaped RBSP */
+static int put_nal(uint8_t *dst, int dst_size, const uint8_t *hdr, int hdr_len,
+                   const uint8_t *rbsp, int len)
+{
+    int pos = 0, zeros = 0;
+
+    if (dst_size < 4 + hdr_len + len + len / 2 + 1)
+        return 0;
+
+    AV_WB32(dst, 1);
+    pos = 4;
+    memcpy(dst + pos, hdr, hdr_len);
+    pos += hdr_len;
+    for (int i = 0; i < len; i++) {
+        if (zeros >= 2 && rbsp[i] <= 3) {
+            dst[pos++] = 3;
+            zeros = 0;
+        }
+        zeros = rbsp[i] ? 0 : zeros + 1;
+        dst[pos++] = rbsp[i];
+    }
+    return pos;
+}
+
+/* Picture description as printable nibbles, free of start code emulation */
+static int put_pic_info(uint8_t *dst, const EmuPicInfo *info)
+{
+    uint64_t fields[] = { info->width, info->height, info->avg[0],
+                          info->avg[1], info->avg[2], info->key, info->number };
+    static const int nibbles[] = { 4, 4, 2, 2, 2, 1, 8 };
+    int pos = EMU_MAGIC_LEN;
+
+    memcpy(dst, EMU_MAGIC, EMU_MAGIC_LEN);
+    for (int i = 0; i < FF_ARRAY_ELEMS(fields); i++)
+        for (int n = nibbles[i] - 1; n >= 0; n--)
+            dst[pos++] = 0x40 | (fields[i] >> (4 * n) & 0xF);
+    return pos;
+}
+
+static int get_pic_info(const uint8_t *buf, int size, EmuPicInfo *info)
+{
+    static const int nibbles[] = { 4, 4, 2, 2, 2, 1, 8 };
+    uint64_t fields[7] = { 0 };
+
+    for (int i = 0; i + EMU_INFO_SIZE <= size; i++) {
+        const uint8_t *p = buf + i + EMU_MAGIC_LEN;
+        int ok = 1;
+
+        if (buf[i] != 'N' || memcmp(buf + i, EMU_MAGIC, EMU_MAGIC_LEN))
+            continue;
+        for (int f = 0; f < FF_ARRAY_ELEMS(nibbles) && ok; f++) {
+            for (int n = 0; n < nibbles[f]; n++, p++) {
+                if ((*p & 0xF0) != 0x40) {
+                    ok = 0;
+                    break;
+                }
+                fields[f] = fields[f] << 4 | (*p & 0xF);
+            }
+        }
+        if (!ok)
+            continue;
+        info->width  = fields[0];
+        info->height = fields[1];
+        info->avg[0] = fields[2];
+        info->avg[1] = fields[3];
+        info->avg[2] = fields[4];
+        info->key    = fields[5];
+        info->number = fields[6];
+        return 1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------
+ * H.264
+ * ---------------------------------------------------------------------- */
+
+static int h264_headers(uint8_t *dst, int size, int w, int h, int bdf)
+{
+    uint8_t rbsp[64];
+    int mbw = (w + 15) >> 4, mbh = (h + 15) >> 4;
+    int crop_r = (mbw * 16 - w) >> 1, crop_b = (mbh * 16 - h) >> 1;
+    int pos = 0, len;
+    EmuBits b;
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_put(&b, 8, bdf > 1 ? 110 : 100);   // profile_idc: High (10)
+    bits_put(&b, 8, 0);                     // constraint flags
+    bits_put(&b, 8, 51);                    // level_idc
+    bits_ue(&b, 0);                         // seq_parameter_set_id
+    bits_ue(&b, 1);                         // chroma_format_idc
+    bits_ue(&b, bdf > 1 ? 2 : 0);           // bit_depth_luma_minus8
+    bits_ue(&b, bdf > 1 ? 2 : 0);           // bit_depth_chroma_minus8
+    bits_put(&b, 1, 0);                     // qpprime_y_zero_transform_bypass
+    bits_put(&b, 1, 0);                     // seq_scaling_matrix_present
+    bits_ue(&b, 12);                        // log2_max_frame_num_minus4
+    bits_ue(&b, 2);                         // pic_order_cnt_type
+    bits_ue(&b, 1);                         // max_num_ref_frames
+    bits_put(&b, 1, 0);                     // gaps_in_frame_num_allowed
+    bits_ue(&b, mbw - 1);
+    bits_ue(&b, mbh - 1);
+    bits_put(&b, 1, 1);                     // frame_mbs_only
+    bits_put(&b, 1, 1);                     // direct_8x8_inference
+    bits_put(&b, 1, crop_r || crop_b);
+    if (crop_r || crop_b) {
+        bits_ue(&b, 0);
+        bits_ue(&b, crop_r);
+        bits_ue(&b, 0);
+        bits_ue(&b, crop_b);
+    }
+    bits_put(&b, 1, 0);                     // vui_parameters_present
+    len  = bits_trailing(&b);
+    pos += put_nal(dst + pos, size - pos, (const uint8_t[]){ 0x67 }, 1, rbsp, len);
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_ue(&b, 0);                         // pic_parameter_set_id
+    bits_ue(&b, 0);                         // seq_parameter_set_id
+    bits_put(&b, 1, 0);                     // entropy_coding_mode (CAVLC)
+    bits_put(&b, 1, 0);                     // bottom_field_pic_order_in_frame
+    bits_ue(&b, 0);                         // num_slice_groups_minus1
+    bits_ue(&b, 0);                         // num_ref_idx_l0_default_minus1
+    bits_ue(&b, 0);                         // num_ref_idx_l1_default_minus1
+    bits_put(&b, 1, 0);                     // weighted_pred
+    bits_put(&b, 2, 0);                     // weighted_bipred_idc
+    bits_se(&b, 0);                         // pic_init_qp_minus26
+    bits_se(&b, 0);                         // pic_init_qs_minus26
+    bits_se(&b, 0);                         // chroma_qp_index_offset
+    bits_put(&b, 1, 1);                     // deblocking_filter_control_present
+    bits_put(&b, 1, 0);                     // constrained_intra_pred
+    bits_put(&b, 1, 0);                     // redundant_pic_cnt_present
+    len  = bits_trailing(&b);
+    pos += put_nal(dst + pos, size - pos, (const uint8_t[]){ 0x68 }, 1, rbsp, len);
+    return pos;
+}
+
+/* One slice covering the picture: I_16x16 DC macroblocks without residual,
+ * or skipped macroblocks */
+static int h264_slice(uint8_t *dst, int size, uint8_t *rbsp, int rbsp_size,
+                      int w, int h, int key, uint32_t frame_num, int idr_id)
+{
+    int nb_mbs = ((w + 15) >> 4) * ((h + 15) >> 4);
+    EmuBits b;
+    int len;
+
+    bits_init(&b, rbsp, rbsp_size);
+    bits_ue(&b, 0);                         // first_mb_in_slice
+    bits_ue(&b, key ? 7 : 5);               // slice_type: all I / all P
+    bits_ue(&b, 0);                         // pic_parameter_set_id
+    bits_put(&b, 16, frame_num & 0xFFFF);
+    if (key)
+        bits_ue(&b, idr_id & 0xFFFF);
+    else {
+        bits_put(&b, 1, 0);                 // num_ref_idx_active_override
+        bits_put(&b, 1, 0);                 // ref_pic_list_modification_l0
+    }
+    if (key) {
+        bits_put(&b, 1, 0);                 // no_output_of_prior_pics
+        bits_put(&b, 1, 0);                 // long_term_reference
+    } else {
+        bits_put(&b, 1, 0);                 // adaptive_ref_pic_marking_mode
+    }
+    bits_se(&b, 0);                         // slice_qp_delta
+    bits_ue(&b, 1);                         // disable_deblocking_filter_idc
+    if (key) {
+        /* mb_type I_16x16_2_0_0, intra_chroma_pred_mode 0, mb_qp_delta 0,
+         * empty Intra16x16DCLevel */
+        for (int i = 0; i < nb_mbs; i++)
+            bits_put(&b, 8, 0x27);
+    } else {
+        bits_ue(&b, nb_mbs);                // mb_skip_run
+    }
+    len = bits_trailing(&b);
+    return put_nal(dst, size, (const uint8_t[]){ key ? 0x65 : 0x41 }, 1,
+                   rbsp, len);
+}
+
+/* ----------------------------------------------------------------------
+ * HEVC
+ * ---------------------------------------------------------------------- */
+
+static void hevc_ptl(EmuBits *b, int bdf)
+{
+    bits_put(b, 2, 0);                      // general_profile_space
+    bits_put(b, 1, 0);                      // general_tier_flag
+    bits_put(b, 5, bdf > 1 ? 2 : 1);        // general_profile_idc
+    bits_put(b, 32, bdf > 1 ? 0x20000000 : 0x60000000);
+    bits_put(b, 4, 0x9);                    // progressive, frame only
+    bits_put(b, 22, 0);                     // 44 reserved bits
+    bits_put(b, 22, 0);
+    bits_put(b, 8, 153);                    // general_level_idc (5.1)
+}
+
+static int hevc_headers(uint8_t *dst, int size, int w, int h, int bdf)
+{
+    uint8_t rbsp[128];
+    int cw = FFALIGN(w, 8), ch = FFALIGN(h, 8);
+    int pos = 0, len;
+    EmuBits b;
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_put(&b, 4, 0);                     // vps_video_parameter_set_id
+    bits_put(&b, 2, 3);                     // base layer internal/available
+    bits_put(&b, 6, 0);                     // vps_max_layers_minus1
+    bits_put(&b, 3, 0);                     // vps_max_sub_layers_minus1
+    bits_put(&b, 1, 1);                     // vps_temporal_id_nesting
+    bits_put(&b, 16, 0xFFFF);
+    hevc_ptl(&b, bdf);
+    bits_put(&b, 1, 1);                     // sub_layer_ordering_info_present
+    bits_ue(&b, 1);
+    bits_ue(&b, 0);
+    bits_ue(&b, 0);
+    bits_put(&b, 6, 0);                     // vps_max_layer_id
+    bits_ue(&b, 0);                         // vps_num_layer_sets_minus1
+    bits_put(&b, 1, 0);                     // vps_timing_info_present
+    bits_put(&b, 1, 0);                     // vps_extension
+    len  = bits_trailing(&b);
+    pos += put_nal(dst + pos, size - pos, (const uint8_t[]){ 32 << 1, 1 }, 2,
+                   rbsp, len);
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_put(&b, 4, 0);                     // sps_video_parameter_set_id
+    bits_put(&b, 3, 0);                     // sps_max_sub_layers_minus1
+    bits_put(&b, 1, 1);                     // sps_temporal_id_nesting
+    hevc_ptl(&b, bdf);
+    bits_ue(&b, 0);                         // sps_seq_parameter_set_id
+    bits_ue(&b, 1);                         // chroma_format_idc
+    bits_ue(&b, cw);
+    bits_ue(&b, ch);
+    bits_put(&b, 1, cw != w || ch != h);    // conformance_window_flag
+    if (cw != w || ch != h) {
+        bits_ue(&b, 0);
+        bits_ue(&b, (cw - w) >> 1);
+        bits_ue(&b, 0);
+        bits_ue(&b, (ch - h) >> 1);
+    }
+    bits_ue(&b, bdf > 1 ? 2 : 0);           // bit_depth_luma_minus8
+    bits_ue(&b, bdf > 1 ? 2 : 0);           // bit_depth_chroma_minus8
+    bits_ue(&b, 4);                         // log2_max_pic_order_cnt_lsb_minus4
+    bits_put(&b, 1, 1);                     // sub_layer_ordering_info_present
+    bits_ue(&b, 1);
+    bits_ue(&b, 0);
+    bits_ue(&b, 0);
+    bits_ue(&b, 0);                         // log2_min_luma_cb_size_minus3
+    bits_ue(&b, 3);                         // log2_diff_max_min_luma_cb_size
+    bits_ue(&b, 0);                         // log2_min_luma_tb_size_minus2
+    bits_ue(&b, 3);                         // log2_diff_max_min_luma_tb_size
+    bits_ue(&b, 0);                         // max_transform_hierarchy_depth_inter
+    bits_ue(&b, 0);                         // max_transform_hierarchy_depth_intra
+    bits_put(&b, 1, 0);                     // scaling_list_enabled
+    bits_put(&b, 1, 0);                     // amp_enabled
+    bits_put(&b, 1, 0);                     // sample_adaptive_offset_enabled
+    bits_put(&b, 1, 0);                     // pcm_enabled
+    bits_ue(&b, 1);                         // num_short_term_ref_pic_sets
+    bits_ue(&b, 1);                         // num_negative_pics
+    bits_ue(&b, 0);                         // num_positive_pics
+    bits_ue(&b, 0);                         // delta_poc_s0_minus1
+    bits_put(&b, 1, 1);                     // used_by_curr_pic_s0
+    bits_put(&b, 1, 0);                     // long_term_ref_pics_present
+    bits_put(&b, 1, 0);                     // sps_temporal_mvp_enabled
+    bits_put(&b, 1, 0);                     // strong_intra_smoothing_enabled
+    bits_put(&b, 1, 0);                     // vui_parameters_present
+    bits_put(&b, 1, 0);                     // sps_extension_present
+    len  = bits_trailing(&b);
+    pos += put_nal(dst + pos, size - pos, (const uint8_t[]){ 33 << 1, 1 }, 2,
+                   rbsp, len);
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_ue(&b, 0);                         // pps_pic_parameter_set_id
+    bits_ue(&b, 0);                         // pps_seq_parameter_set_id
+    bits_put(&b, 1, 0);                     // dependent_slice_segments_enabled
+    bits_put(&b, 1, 0);                     // output_flag_present
+    bits_put(&b, 3, 0);                     // num_extra_slice_header_bits
+    bits_put(&b, 1, 0);                     // sign_data_hiding_enabled
+    bits_put(&b, 1, 0);                     // cabac_init_present
+    bits_ue(&b, 0);                         // num_ref_idx_l0_default_minus1
+    bits_ue(&b, 0);                         // num_ref_idx_l1_default_minus1
+    bits_se(&b, 0);                         // init_qp_minus26
+    bits_put(&b, 1, 0);                     // constrained_intra_pred
+    bits_put(&b, 1, 0);                     // transform_skip_enabled
+    bits_put(&b, 1, 0);                     // cu_qp_delta_enabled
+    bits_se(&b, 0);                         // pps_cb_qp_offset
+    bits_se(&b, 0);                         // pps_cr_qp_offset
+    bits_put(&b, 1, 0);                     // slice_chroma_qp_offsets_present
+    bits_put(&b, 1, 0);                     // weighted_pred
+    bits_put(&b, 1, 0);                     // weighted_bipred
+    bits_put(&b, 1, 0);                     // transquant_bypass_enabled
+    bits_put(&b, 1, 0);                     // tiles_enabled
+    bits_put(&b, 1, 0);                     // entropy_coding_sync_enabled
+    bits_put(&b, 1, 0);                     // loop_filter_across_slices
+    bits_put(&b, 1, 0);                     // deblocking_filter_control_present
+    bits_put(&b, 1, 0);                     // pps_scaling_list_data_present
+    bits_put(&b, 1, 0);                     // lists_modification_present
+    bits_ue(&b, 0);                         // log2_parallel_merge_level_minus2
+    bits_put(&b, 1, 0);                     // slice_segment_header_extension
+    bits_put(&b, 1, 0);                     // pps_extension_present
+    len  = bits_trailing(&b);
+    pos += put_nal(dst + pos, size - pos, (const uint8_t[]){ 34 << 1, 1 }, 2,
+                   rbsp, len);
+    return pos;
+}
+
+static int hevc_slice(uint8_t *dst, int size, int key, uint32_t poc)
+{
+    uint8_t rbsp[32];
+    EmuBits b;
+    int len;
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_put(&b, 1, 1);                     // first_slice_segment_in_pic
+    if (key)
+        bits_put(&b, 1, 0);                 // no_output_of_prior_pics
+    bits_ue(&b, 0);                         // slice_pic_parameter_set_id
+    bits_ue(&b, key ? 2 : 1);               // slice_type
+    if (!key) {
+        bits_put(&b, 8, poc & 0xFF);        // slice_pic_order_cnt_lsb
+        bits_put(&b, 1, 1);                 // short_term_ref_pic_set_sps
+        bits_put(&b, 1, 0);                 // num_ref_idx_active_override
+        bits_ue(&b, 0);                     // five_minus_max_num_merge_cand
+    }
+    bits_se(&b, 0);                         // slice_qp_delta
+    len = bits_trailing(&b);                // byte_alignment()
+    /* placeholder for the CABAC slice data */
+    memset(rbsp + len, 0xA5, 8);
+    len += 8;
+    return put_nal(dst, size,
+                   (const uint8_t[]){ (key ? 19 : 1) << 1, 1 }, 2, rbsp, len);
+}
+
+/* ----------------------------------------------------------------------
+ * AV1
+ * ---------------------------------------------------------------------- */
+
+static int put_leb128(uint8_t *dst, uint32_t v)
+{
+    int n = 0;
+
+    do {
+        dst[n] = v & 0x7F;
+        v >>= 7;
+        if (v)
+            dst[n] |= 0x80;
+        n++;
+    } while (v);
+    return n;
+}
+
+static int put_obu(uint8_t *dst, int size, int type, const uint8_t *payload,
+                   int len)
+{
+    int pos;
+
+    if (size < len + 6)
+        return 0;
+    dst[0] = type << 3 | 2;                 // obu_has_size_field
+    pos = 1 + put_leb128(dst + 1, len);
+    memcpy(dst + pos, payload, len);
+    return pos + len;
+}
+
+static int av1_sequence_header(uint8_t *dst, int size, int w, int h, int bdf)
+{
+    uint8_t rbsp[32];
+    EmuBits b;
+
+    bits_init(&b, rbsp, sizeof(rbsp));
+    bits_put(&b, 3, 0);                     // seq_profile
+    bits_put(&b, 1, 0);                     // still_picture
+    bits_put(&b, 1, 0);                     // reduced_still_picture_header
+    bits_put(&b, 1, 0);                     // timing_info_present
+    bits_put(&b, 1, 0);                     // initial_display_delay_present
+    bits_put(&b, 5, 0);                     // operating_points_cnt_minus_1
+    bits_put(&b, 12, 0);                    // operating_point_idc[0]
+    bits_put(&b, 5, 13);                    // seq_level_idx[0] (5.1)
+    bits_put(&b, 1, 0);                     // seq_tier[0]
+    bits_put(&b, 4, 15);                    // frame_width_bits_minus_1
+    bits_put(&b, 4, 15);                    // frame_height_bits_minus_1
+    bits_put(&b, 16, FFMAX(w, 1) - 1);
+    bits_put(&b, 16, FFMAX(h, 1) - 1);
+    bits_put(&b, 1, 0);                     // frame_id_numbers_present
+    bits_put(&b, 1, 0);                     // use_128x128_superblock
+    bits_put(&b, 1, 0);                     // enable_filter_intra
+    bits_put(&b, 1, 0);                     // enable_intra_edge_filter
+    bits_put(&b, 1, 0);                     // enable_interintra_compound
+    bits_put(&b, 1, 0);                     // enable_masked_compound
+    bits_put(&b, 1, 0);                     // enable_warped_motion
+    bits_put(&b, 1, 0);                     // enable_dual_filter
+    bits_put(&b, 1, 0);                     // enable_order_hint
+    bits_put(&b, 1, 1);                     // seq_choose_screen_content_tools
+    bits_put(&b, 1, 1);                     // seq_choose_integer_mv
+    bits_put(&b, 1, 0);                     // enable_superres
+    bits_put(&b, 1, 0);                     // enable_cdef
+    bits_put(&b, 1, 0);                     // enable_restoration
+    bits_put(&b, 1, bdf > 1);               // high_bitdepth
+    bits_put(&b, 1, 0);                     // mono_chrome
+    bits_put(&b, 1, 0);                     // color_description_present
+    bits_put(&b, 1, 0);                     // color_range
+    bits_put(&b, 2, 0);                     // chroma_sample_position
+    bits_put(&b, 1, 0);                     // separate_uv_delta_q
+    bits_put(&b, 1, 0);                     // film_grain_params_present
+    return put_obu(dst, size, 1, rbsp, bits_trailing(&b));
+}
+
+/* ----------------------------------------------------------------------
+ * picture statistics
+ * ---------------------------------------------------------------------- */
+
+/* Average of every 8th sample of every 8th row, in 8-bit units */
+static void plane_averages(const EmuFrame *f, uint8_t avg[3])
+{
+    int fmt = f->format;
+    int bdf = ff_ni_emu_bit_depth_factor(fmt);
+    int semi = fmt == NI_PIX_FMT_NV12 || fmt == NI_PIX_FMT_P010LE ||
+               fmt == NI_PIX_FMT_NV16;
+    int packed = f->nb_planes == 1;
+
+    avg[0] = avg[1] = avg[2] = 128;
+    if (packed || bdf > 2) {
+        /* RGB and packed YUV: average of the first three bytes per pixel */
+        uint64_t sum[3] = { 0 };
+        int n = 0;
+
+        if (!f->data[0])
+            return;
+        for (int y = 0; y < f->height; y += 8) {
+            const uint8_t *row = f->data[0] + (size_t)y * f->linesize[0];
+            for (int x = 0; x < f->width; x += 8, n++)
+                for (int c = 0; c < 3; c++)
+                    sum[c] += row[x * (packed && bdf < 4 ? 2 : 4) + c];
+        }
+        for (int c = 0; c < 3 && n; c++)
+            avg[c] = sum[c] / n;
+        return;
+    }
+
+    for (int p = 0; p < f->nb_planes && p < 3; p++) {
+        int w = p ? (semi ? f->width / 2 : f->width / 2) : f->width;
+        int comps = p && semi ? 2 : 1;
+        uint64_t sum[2] = { 0 };
+        int n = 0;
+
+        if (!f->data[p])
+            continue;
+        if (fmt == NI_PIX_FMT_BGRP)
+            w = f->width;
+        for (int y = 0; y < f->plane_height[p]; y += 8) {
+            const uint8_t *row = f->data[p] + (size_t)y * f->linesize[p];
+            for (int x = 0; x < w; x += 8, n++) {
+                for (int c = 0; c < comps; c++) {
+                    int i = x * comps + c;
+                    if (bdf == 2)
+                        sum[c] += fmt == NI_PIX_FMT_P010LE ?
+                                  AV_RL16(row + 2 * i) >> 8 :
+                                  AV_RL16(row + 2 * i) >> 2;
+                    else
+                        sum[c] += row[i];
+                }
+            }
+        }
+        if (!n)
+            continue;
+        if (comps == 2) {
+            avg[1] = sum[0] / n;
+            avg[2] = sum[1] / n;
+        } else {
+            avg[p] = sum[0] / n;
+        }
+    }
+}
+
+/* Fill a decoded picture with a flat colour */
+static void fill_planes(int fmt, uint8_t *const data[], const int linesize[],
+                        int w, int h, const uint8_t avg[3])
+{
+    int semi = fmt == NI_PIX_FMT_NV12 || fmt == NI_PIX_FMT_P010LE;
+    int bdf  = ff_ni_emu_bit_depth_factor(fmt);
+    int ch   = (h + 1) / 2;
+
+    for (int p = 0; p < (semi ? 2 : 3); p++) {
+        int rows    = p ? ch : h;
+        int samples = p ? (semi ? w / 2 * 2 : w / 2) : w;
+
+        if (!data[p])
+            continue;
+        for (int y = 0; y < rows; y++) {
+            uint8_t *row = data[p] + (size_t)y * linesize[p];
+
+            if (bdf == 1 && !(p && semi)) {
+                memset(row, avg[p], samples);
+                continue;
+            }
+            for (int x = 0; x < samples; x++) {
+                int c = p && semi ? 1 + (x & 1) : p;
+                if (bdf == 2)
+                    AV_WL16(row + 2 * x, fmt == NI_PIX_FMT_P010LE ?
+                                         avg[c] << 8 : avg[c] << 2);
+                else
+                    row[x] = avg[c];
+            }
+        }
+    }
+}
+
+/* ----------------------------------------------------------------------
+ * encoder
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuEncFrame {
+    int64_t    ready;
+    int64_t    pts;
+    int        recycle_index;
+    EmuPicInfo info;
+} EmuEncFrame;
+
+typedef struct EmuEncoder {
+    EmuSession  s;
+    int         codec;
+    int         width;
+    int         height;
+    int         bdf;
+    int         intra_period;
+    int         repeat_headers;
+    int         frame_bytes;
+
+    uint8_t     header[EMU_HEADER_MAX];
+    int         header_len;
+    int         header_pending;
+
+    EmuEncFrame queue[EMU_QUEUE_SIZE];
+    int         head;
+    int         count;
+    int         flushing;
+
+    uint32_t    coded;
+    uint32_t    since_key;
+    int         idr_id;
+
+    uint8_t    *rbsp;
+    int         rbsp_size;
+} EmuEncoder;
+
+static int enc_headers(EmuEncoder *e, uint8_t *dst, int size)
+{
+    switch (e->codec) {
+    case NI_CODEC_FORMAT_H264:
+        return h264_headers(dst, size, e->width, e->height, e->bdf);
+    case NI_CODEC_FORMAT_H265:
+        return hevc_headers(dst, size, e->width, e->height, e->bdf);
+    case NI_CODEC_FORMAT_AV1:
+        return av1_sequence_header(dst, size, e->width, e->height, e->bdf);
+    default:
+        return 0;
+    }
+}
+
+int ff_ni_emu_enc_open(ni_session_context_t *p_ctx)
+{
+    const ni_xcoder_params_t *param = p_ctx->p_session_config;
+    EmuEncoder *e = av_mallocz(sizeof(*e));
+    double fps = 30;
+    int64_t bitrate = 200000;
+
+    if (!e)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+
+    e->s.device_type = NI_DEVICE_TYPE_ENCODER;
+    ff_ni_emu_timer_init(&e->s.timer, NI_DEVICE_TYPE_ENCODER);
+    e->codec  = p_ctx->codec_format;
+    e->bdf    = p_ctx->src_bit_depth == 10 ? 2 : 1;
+    e->width  = p_ctx->ori_width  > 0 ? p_ctx->ori_width  : 0;
+    e->height = p_ctx->ori_height > 0 ? p_ctx->ori_height : 0;
+    e->intra_period = 120;
+    if (param) {
+        if (param->source_width > 0 && param->source_height > 0) {
+            e->width  = param->source_width;
+            e->height = param->source_height;
+        }
+        if (param->fps_number > 0 && param->fps_denominator > 0)
+            fps = (double)param->fps_number / param->fps_denominator;
+        if (param->bitrate > 0)
+            bitrate = param->bitrate;
+        e->intra_period   = param->cfg_enc_params.intra_period;
+        e->repeat_headers = param->cfg_enc_params.forced_header_enable;
+    }
+    e->width       = av_clip(e->width, 16, NI_MAX_RESOLUTION_WIDTH);
+    e->height      = av_clip(e->height, 16, NI_MAX_RESOLUTION_HEIGHT);
+    e->frame_bytes = av_clip(bitrate / (8 * fps), 64, NI_MAX_TX_SZ / 8);
+
+    e->rbsp_size = ((e->width + 15) >> 4) * ((e->height + 15) >> 4) + 64;
+    e->rbsp = av_malloc(e->rbsp_size);
+    if (!e->rbsp) {
+        av_free(e);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    e->header_len     = enc_headers(e, e->header, sizeof(e->header));
+    e->header_pending = e->codec != NI_CODEC_FORMAT_JPEG;
+
+    p_ctx->meta_size      = NI_FW_ENC_BITSTREAM_META_DATA_SIZE;
+    p_ctx->auto_dl_handle = 0;
+    p_ctx->emu = e;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_enc_close(ni_session_context_t *p_ctx)
+{
+    EmuEncoder *e = p_ctx->emu;
+
+    av_free(e->rbsp);
+    av_free(e);
+}
+
+int ff_ni_emu_enc_flush(ni_session_context_t *p_ctx)
+{
+    EmuEncoder *e = p_ctx->emu;
+
+    e->flushing = 1;
+    return NI_RETCODE_SUCCESS;
+}
+
+int ff_ni_emu_enc_write(ni_session_context_t *p_ctx, ni_frame_t *frame)
+{
+    EmuEncoder *e = p_ctx->emu;
+    int is_hw = !frame->data_len[0] && frame->data_len[3] >= sizeof(niFrameSurface1_t);
+    EmuEncFrame *ef;
+    EmuFrame src;
+
+    if (frame->end_of_stream) {
+        e->flushing = 1;
+        p_ctx->status = NI_RETCODE_SUCCESS;
+        return 1;
+    }
+
+    /* hardware frames are dropped by the caller when rejected, so they are
+     * only refused once the internal queue itself is full */
+    if (e->count >= (is_hw ? EMU_QUEUE_SIZE : ff_ni_emu_config()->queue)) {
+        p_ctx->status = NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL;
+        return 0;
+    }
+    p_ctx->status = NI_RETCODE_SUCCESS;
+
+    ef = &e->queue[(e->head + e->count) % EMU_QUEUE_SIZE];
+    memset(ef, 0, sizeof(*ef));
+    ef->recycle_index = -1;
+
+    if (is_hw) {
+        const niFrameSurface1_t *surf = (const niFrameSurface1_t *)frame->p_data[3];
+        const EmuFrame *hw = ff_ni_emu_frame_get(surf->ui16FrameIdx);
+
+        if (!hw)
+            return NI_RETCODE_INVALID_PARAM;
+        src = *hw;
+        ef->recycle_index = surf->ui16FrameIdx;
+    } else {
+        int ph[EMU_MAX_PLANES];
+
+        memset(&src, 0, sizeof(src));
+        src.format    = p_ctx->pixel_format;
+        src.width     = frame->video_width;
+        src.height    = frame->video_height;
+        src.nb_planes = ff_ni_emu_layout(src.format, src.width, src.height,
+                                         src.linesize, ph);
+        ff_ni_emu_frame_linesize(frame, src.format, src.linesize);
+        for (int i = 0; i < src.nb_planes; i++) {
+            src.data[i]         = frame->p_data[i];
+            src.plane_height[i] = ph[i];
+        }
+    }
+    plane_averages(&src, ef->info.avg);
+
+    ef->info.width  = e->width;
+    ef->info.height = e->height;
+    ef->info.key    = !e->coded ||
+                      (e->intra_period > 0 && e->since_key >= e->intra_period) ||
+                      frame->force_key_frame ||
+                      frame->ni_pict_type == PIC_TYPE_IDR;
+    if (ef->info.key)
+        e->since_key = 0;
+    ef->info.number = e->since_key++;
+    ef->pts   = frame->pts;
+    ef->ready = ff_ni_emu_timer_schedule(&e->s.timer);
+
+    e->coded++;
+    e->count++;
+    p_ctx->frame_num++;
+    return FFMAX(frame->data_len[0] + frame->data_len[1] + frame->data_len[2] +
+                 frame->data_len[3], 1);
+}
+
+static int enc_filler(int codec, uint8_t *dst, int size)
+{
+    static const uint8_t fd_h264[] = { 0x0C }, fd_hevc[] = { 38 << 1, 1 };
+    int pos = 0;
+
+    if (size <= 16)
+        return 0;
+
+    switch (codec) {
+    case NI_CODEC_FORMAT_H264:
+    case NI_CODEC_FORMAT_H265: {
+        int hdr = codec == NI_CODEC_FORMAT_H264 ? 1 : 2;
+        int len = size - 5 - hdr;
+
+        AV_WB32(dst, 1);
+        memcpy(dst + 4, hdr == 1 ? fd_h264 : fd_hevc, hdr);
+        memset(dst + 4 + hdr, 0xFF, len - 1);
+        dst[4 + hdr + len - 1] = 0x80;
+        return size - 1;
+    }
+    case NI_CODEC_FORMAT_JPEG:
+        while (size - pos > 4) {
+            int len = FFMIN(size - pos - 2, 0xFFFF);
+            AV_WB16(dst + pos, 0xFFFE);
+            AV_WB16(dst + pos + 2, len);
+            memset(dst + pos + 4, ' ', len - 2);
+            pos += len + 2;
+        }
+        return pos;
+    default:
+        return 0;
+    }
+}
+
+static int enc_picture(EmuEncoder *e, const EmuEncFrame *ef, uint8_t *dst,
+                       int size)
+{
+    uint8_t info[EMU_INFO_SIZE + 32];
+    int target = ef->info.key ? 3 * e->frame_bytes : e->frame_bytes;
+    int info_len, pos = 0;
+
+    target   = FFMIN(target, size);
+    info_len = put_pic_info(info + 20, &ef->info);
+
+    switch (e->codec) {
+    case NI_CODEC_FORMAT_H264:
+    case NI_CODEC_FORMAT_H265: {
+        int h264 = e->codec == NI_CODEC_FORMAT_H264;
+        int n = 0;
+
+        if (ef->info.key && e->repeat_headers)
+            pos += enc_headers(e, dst + pos, size - pos);
+
+        /* user data unregistered SEI */
+        info[n++] = 5;
+        info[n++] = 16 + info_len;
+        memcpy(info + n, emu_sei_uuid, 16);
+        n += 16;
+        memmove(info + n, info + 20, info_len);
+        n += info_len;
+        info[n++] = 0x80;
+        pos += put_nal(dst + pos, size - pos,
+                       h264 ? (const uint8_t[]){ 0x06 } :
+                              (const uint8_t[]){ 39 << 1, 1 },
+                       h264 ? 1 : 2, info, n);
+
+        if (h264) {
+            if (ef->info.key)
+                e->idr_id++;
+            pos += h264_slice(dst + pos, size - pos, e->rbsp, e->rbsp_size,
+                              e->width, e->height, ef->info.key,
+                              ef->info.number, e->idr_id);
+        } else {
+            pos += hevc_slice(dst + pos, size - pos, ef->info.key,
+                              ef->info.number);
+        }
+        pos += enc_filler(e->codec, dst + pos, target - pos);
+        break;
+    }
+    case NI_CODEC_FORMAT_AV1: {
+        uint8_t *meta = av_malloc(FFMAX(target, 64));
+        int n = 0;
+
+        if (!meta)
+            return 0;
+        pos += put_obu(dst + pos, size - pos, 2, NULL, 0);   // temporal delimiter
+        if (ef->info.key)
+            pos += av1_sequence_header(dst + pos, size - pos, e->width,
+                                       e->height, e->bdf);
+        /* ITU-T T.35 metadata carrying the picture description and filler */
+        meta[n++] = 4;
+        meta[n++] = 0xB5;
+        memcpy(meta + n, info + 20, info_len);
+        n += info_len;
+        if (target - pos - n - 8 > 0) {
+            memset(meta + n, 0x55, target - pos - n - 8);
+            n += target - pos - n - 8;
+        }
+        meta[n++] = 0x80;
+        pos += put_obu(dst + pos, size - pos, 5, meta, n);
+        av_free(meta);
+        break;
+    }
+    default:
+        /* JPEG: SOI, comment with the picture description, EOI */
+        AV_WB16(dst, 0xFFD8);
+        AV_WB16(dst + 2, 0xFFFE);
+        AV_WB16(dst + 4, info_len + 2);
+        memcpy(dst + 6, info + 20, info_len);
+        pos  = 6 + info_len;
+        pos += enc_filler(e->codec, dst + pos, target - pos - 2);
+        AV_WB16(dst + pos, 0xFFD9);
+        pos += 2;
+        break;
+    }
+    return pos;
+}
+
+int ff_ni_emu_enc_read(ni_session_context_t *p_ctx, ni_packet_t *pkt)
+{
+    EmuEncoder *e = p_ctx->emu;
+    int meta = p_ctx->meta_size;
+    EmuEncFrame *ef;
+    int len;
+
+    pkt->end_of_stream = 0;
+    pkt->data_len      = 0;
+
+    if (e->header_pending) {
+        if (ni_packet_buffer_alloc(pkt, meta + e->header_len) < 0)
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        memset(pkt->p_data, 0, meta);
+        memcpy((uint8_t *)pkt->p_data + meta, e->header, e->header_len);
+        pkt->data_len   = meta + e->header_len;
+        pkt->pts        = 0;
+        pkt->frame_type = 0;
+        e->header_pending = 0;
+        return pkt->data_len;
+    }
+
+    if (!e->count) {
+        pkt->end_of_stream = e->flushing;
+        return 0;
+    }
+
+    ef = &e->queue[e->head];
+    if (av_gettime_relative() < ef->ready) {
+        /* a full queue models a blocking device */
+        if (!e->flushing && e->count < ff_ni_emu_config()->queue)
+            return 0;
+        ff_ni_emu_wait_until(ef->ready);
+    }
+
+    if (!pkt->p_buffer || pkt->buffer_size < NI_MAX_TX_SZ)
+        if (ni_packet_buffer_alloc(pkt, NI_MAX_TX_SZ) < 0)
+            return NI_RETCODE_ERROR_MEM_ALOC;
+    pkt->p_data = pkt->p_buffer;
+    memset(pkt->p_data, 0, meta);
+    len = enc_picture(e, ef, (uint8_t *)pkt->p_data + meta,
+                      pkt->buffer_size - meta);
+
+    pkt->data_len       = meta + len;
+    pkt->pts            = ef->pts;
+    pkt->dts            = ef->pts;
+    pkt->frame_type     = ef->info.key ? 0 : 1;
+    pkt->recycle_index  = ef->recycle_index;
+    pkt->av1_show_frame = 1;
+    pkt->avg_frame_qp   = 30;
+    pkt->video_width    = e->width;
+    pkt->video_height   = e->height;
+
+    e->head = (e->head + 1) % EMU_QUEUE_SIZE;
+    e->count--;
+    p_ctx->pkt_num++;
+    return pkt->data_len;
+}
+
+/* ----------------------------------------------------------------------
+ * decoder frame buffer pool
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuDecBuf {
+    ni_buf_t b;
+    size_t   size;
+} EmuDecBuf;
+
+typedef struct EmuBufPoolSync {
+    AVMutex lock;
+    int     in_use;
+    int     closing;
+} EmuBufPoolSync;
+
+static ni_buf_pool_t *buf_pool_create(void)
+{
+    ni_buf_pool_t *pool = calloc(1, sizeof(*pool));
+    EmuBufPoolSync *sync = calloc(1, sizeof(*sync));
+
+    if (!pool || !sync || ff_mutex_init(&sync->lock, NULL)) {
+        free(pool);
+        free(sync);
+        return NULL;
+    }
+    pool->mutex = sync;
+    return pool;
+}
+
+static void buf_pool_destroy(ni_buf_pool_t *pool)
+{
+    EmuBufPoolSync *sync = pool->mutex;
+    ni_buf_t *b = pool->p_free_head;
+
+    while (b) {
+        ni_buf_t *next = b->p_next;
+        free(b->buf);
+        free(b);
+        b = next;
+    }
+    ff_mutex_destroy(&sync->lock);
+    free(sync);
+    free(pool);
+}
+
+/* Mark a pool for destruction once all of its buffers came back */
+static void buf_pool_close(ni_buf_pool_t *pool)
+{
+    EmuBufPoolSync *sync;
+    int destroy;
+
+    if (!pool)
+        return;
+    sync = pool->mutex;
+    ff_mutex_lock(&sync->lock);
+    sync->closing = 1;
+    destroy = !sync->in_use;
+    ff_mutex_unlock(&sync->lock);
+    if (destroy)
+        buf_pool_destroy(pool);
+}
+
+static ni_buf_t *buf_pool_get(ni_buf_pool_t *pool, size_t size)
+{
+    EmuBufPoolSync *sync = pool->mutex;
+    EmuDecBuf *db;
+    ni_buf_t *b;
+
+    ff_mutex_lock(&sync->lock);
+    b = pool->p_free_head;
+    if (b) {
+        pool->p_free_head = b->p_next;
+        pool->number_of_buffers--;
+    }
+    sync->in_use++;
+    ff_mutex_unlock(&sync->lock);
+
+    db = (EmuDecBuf *)b;
+    if (!db) {
+        db = calloc(1, sizeof(*db));
+        if (!db)
+            goto fail;
+        db->b.pool = pool;
+    }
+    if (db->size < size) {
+        free(db->b.buf);
+        db->size  = 0;
+        db->b.buf = malloc(size);
+        if (!db->b.buf) {
+            free(db);
+            goto fail;
+        }
+        db->size = size;
+    }
+    db->b.p_next = NULL;
+    pool->buf_size = FFMAX(pool->buf_size, size);
+    return &db->b;
+
+fail:
+    ff_mutex_lock(&sync->lock);
+    sync->in_use--;
+    ff_mutex_unlock(&sync->lock);
+    return NULL;
+}
+
+void ni_decoder_frame_buffer_pool_return_buf(ni_buf_t *buf,
+                                             ni_buf_pool_t *p_buffer_pool)
+{
+    EmuBufPoolSync *sync;
+    int destroy;
+
+    if (!buf)
+        return;
+    if (!p_buffer_pool) {
+        free(buf->buf);
+        free(buf);
+        return;
+    }
+
+    sync = p_buffer_pool->mutex;
+    ff_mutex_lock(&sync->lock);
+    buf->p_next = p_buffer_pool->p_free_head;
+    p_buffer_pool->p_free_head = buf;
+    p_buffer_pool->number_of_buffers++;
+    sync->in_use--;
+    destroy = sync->closing && !sync->in_use;
+    ff_mutex_unlock(&sync->lock);
+    if (destroy)
+        buf_pool_destroy(p_buffer_pool);
+}
+
+/* Picture layout of decoded frames, see retrieve_frame() in nidec.c */
+static void dec_layout(int w, int h, int factor, int is_planar,
+                       int linesize[3], uint32_t len[4])
+{
+    int semi = is_planar == NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR;
+
+    linesize[0] = NI_VPU_ALIGN128(w * factor);
+    linesize[1] = NI_VPU_ALIGN128(w / (semi ? 1 : 2) * factor);
+    linesize[2] = semi ? 0 : linesize[1];
+    len[0] = linesize[0] * h;
+    len[1] = linesize[1] * (h / 2);
+    len[2] = linesize[2] * (h / 2);
+    len[3] = 0;
+}
+
+ni_retcode_t ni_decoder_frame_buffer_alloc(ni_buf_pool_t *p_pool,
+                                           ni_frame_t *pframe, int alloc_mem,
+                                           int video_width, int video_height,
+                                           int alignment, int factor,
+                                           int is_planar)
+{
+    int linesize[3];
+    uint32_t len[4];
+    ni_buf_t *buf;
+    size_t size;
+    uint8_t *p;
+
+    if (!pframe || video_width <= 0 || video_height <= 0)
+        return NI_RETCODE_INVALID_PARAM;
+
+    factor = FFMAX(factor, 1);
+    dec_layout(video_width, video_height, factor, is_planar, linesize, len);
+    /* odd heights and the second chroma plane may extend past the nominal
+     * plane sizes */
+    size = len[0] + 2 * (size_t)linesize[1] * ((video_height + 1) / 2) +
+           linesize[1] + NI_FW_META_DATA_SZ;
+
+    if (pframe->dec_buf) {
+        ni_decoder_frame_buffer_pool_return_buf(pframe->dec_buf,
+                                                pframe->dec_buf->pool);
+        pframe->dec_buf = NULL;
+    }
+    /* without alloc_mem only the layout is set up, the caller provides the
+     * memory or leaves it to the read */
+    if (!alloc_mem) {
+        pframe->p_buffer    = NULL;
+        pframe->buffer_size = size;
+        for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+            pframe->data_len[i] = len[i];
+            pframe->p_data[i]   = NULL;
+        }
+        pframe->video_width  = video_width;
+        pframe->video_height = video_height;
+        return NI_RETCODE_SUCCESS;
+    }
+    if (p_pool) {
+        buf = buf_pool_get(p_pool, size);
+    } else {
+        EmuDecBuf *db = calloc(1, sizeof(*db));
+
+        buf = NULL;
+        if (db && (db->b.buf = malloc(size))) {
+            db->size = size;
+            buf = &db->b;
+        } else {
+            free(db);
+        }
+    }
+    if (!buf)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+
+    pframe->dec_buf     = buf;
+    pframe->p_buffer    = buf->buf;
+    pframe->buffer_size = size;
+    p = buf->buf;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        pframe->data_len[i] = len[i];
+        pframe->p_data[i]   = i < 3 && linesize[i] ? p : NULL;
+        p += len[i];
+    }
+    pframe->video_width  = video_width;
+    pframe->video_height = video_height;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_decoder_frame_buffer_free(ni_frame_t *pframe)
+{
+    if (!pframe)
+        return NI_RETCODE_INVALID_PARAM;
+
+    if (pframe->dec_buf) {
+        ni_decoder_frame_buffer_pool_return_buf(pframe->dec_buf,
+                                                pframe->dec_buf->pool);
+        pframe->dec_buf = NULL;
+    }
+    pframe->p_buffer    = NULL;
+    pframe->buffer_size = 0;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        pframe->p_data[i]   = NULL;
+        pframe->data_len[i] = 0;
+    }
+    ni_frame_wipe_aux_data(pframe);
+    return NI_RETCODE_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------
+ * decoder
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuDecFrame {
+    int64_t    ready;
+    int64_t    pts;
+    int64_t    dts;
+    int64_t    order;
+    uint64_t   pkt_pos;
+    int        flags;
+    EmuPicInfo info;
+} EmuDecFrame;
+
+typedef struct EmuDecoder {
+    EmuSession  s;
+    int         width;
+    int         height;
+    int         hwframes;
+    int         semi_planar;
+
+    EmuDecFrame frames[EMU_QUEUE_SIZE];
+    int         count;
+    int64_t     order;
+    int         draining;
+} EmuDecoder;
+
+int ff_ni_emu_dec_open(ni_session_context_t *p_ctx)
+{
+    const ni_xcoder_params_t *param = p_ctx->p_session_config;
+    int bdf = FFMAX(p_ctx->bit_depth_factor, 1);
+    EmuDecoder *d = av_mallocz(sizeof(*d));
+
+    if (!d)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+
+    d->s.device_type = NI_DEVICE_TYPE_DECODER;
+    ff_ni_emu_timer_init(&d->s.timer, NI_DEVICE_TYPE_DECODER);
+    if (param) {
+        d->width       = param->source_width;
+        d->height      = param->source_height;
+        d->hwframes    = param->dec_input_params.hwframes;
+        d->semi_planar = param->dec_input_params.semi_planar[0];
+    }
+
+    if (d->semi_planar)
+        p_ctx->pixel_format = bdf > 1 ? NI_PIX_FMT_P010LE : NI_PIX_FMT_NV12;
+    else
+        p_ctx->pixel_format = bdf > 1 ? NI_PIX_FMT_YUV420P10LE : NI_PIX_FMT_YUV420P;
+    if (d->width > 0 && d->height > 0) {
+        p_ctx->active_video_width  = NI_VPU_ALIGN128(d->width * bdf);
+        p_ctx->active_video_height = d->height;
+        p_ctx->actual_video_width  = d->width;
+    }
+
+    if (d->hwframes) {
+        int extra = param->dec_input_params.max_extra_hwframe_cnt;
+        int size  = 24 + (extra == 255 ? 0 : extra) + (d->hwframes >> 4);
+        int fixed = ff_ni_emu_config()->dec_pool;
+
+        /* a fixed pool makes the decoder wait for its frames to be recycled,
+         * as on the card */
+        d->s.pool = ff_ni_emu_pool_create(fixed ? fixed : size, !!fixed,
+                                          p_ctx->session_id,
+                                          p_ctx->device_handle);
+        if (!d->s.pool) {
+            av_free(d);
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+        }
+    }
+
+    p_ctx->dec_fme_buf_pool = buf_pool_create();
+    if (!p_ctx->dec_fme_buf_pool) {
+        ff_ni_emu_pool_close(d->s.pool);
+        av_free(d);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    p_ctx->emu = d;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_dec_close(ni_session_context_t *p_ctx)
+{
+    EmuDecoder *d = p_ctx->emu;
+
+    ff_ni_emu_pool_close(d->s.pool);
+    buf_pool_close(p_ctx->dec_fme_buf_pool);
+    p_ctx->dec_fme_buf_pool = NULL;
+    av_free(d);
+}
+
+int ff_ni_emu_dec_flush(ni_session_context_t *p_ctx)
+{
+    EmuDecoder *d = p_ctx->emu;
+
+    d->draining = 1;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_dec_reset(ni_session_context_t *p_ctx)
+{
+    EmuDecoder *d = p_ctx->emu;
+
+    d->count    = 0;
+    d->draining = 0;
+}
+
+static int dec_in_flight(const EmuDecoder *d, int64_t now)
+{
+    int n = 0;
+
+    for (int i = 0; i < d->count; i++)
+        n += d->frames[i].ready > now;
+    return n;
+}
+
+int ff_ni_emu_dec_write(ni_session_context_t *p_ctx, ni_packet_t *pkt)
+{
+    EmuDecoder *d = p_ctx->emu;
+    int queue = ff_ni_emu_config()->queue;
+    EmuDecFrame *df;
+
+    if (pkt->end_of_stream)
+        d->draining = 1;
+    if (!pkt->data_len)
+        return 0;
+
+    /* the device accepts data as long as it has decode slots; model a full
+     * device by blocking until the oldest picture in flight is done */
+    while (dec_in_flight(d, av_gettime_relative()) >= queue) {
+        int64_t first = INT64_MAX;
+
+        for (int i = 0; i < d->count; i++)
+            if (d->frames[i].ready > av_gettime_relative())
+                first = FFMIN(first, d->frames[i].ready);
+        ff_ni_emu_wait_until(first);
+    }
+    if (d->count >= EMU_QUEUE_SIZE)
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+
+    df = &d->frames[d->count++];
+    memset(df, 0, sizeof(*df));
+    if (!get_pic_info(pkt->p_data, pkt->data_len, &df->info)) {
+        df->info.width  = d->width;
+        df->info.height = d->height;
+        df->info.avg[0] = df->info.avg[1] = df->info.avg[2] = 128;
+        df->info.key    = pkt->flags & 1;
+    }
+    df->pts     = pkt->pts;
+    df->dts     = pkt->dts;
+    df->pkt_pos = pkt->pkt_pos;
+    df->flags   = pkt->flags;
+    df->order   = d->order++;
+    df->ready   = ff_ni_emu_timer_schedule(&d->s.timer);
+
+    p_ctx->pkt_num++;
+    return pkt->data_len;
+}
+
+/* Index of the next picture in presentation order */
+static int dec_next(const EmuDecoder *d)
+{
+    int best = 0;
+
+    for (int i = 1; i < d->count; i++) {
+        const EmuDecFrame *a = &d->frames[i], *b = &d->frames[best];
+        int64_t ka = a->pts == NI_NOPTS_VALUE ? a->order : a->pts;
+        int64_t kb = b->pts == NI_NOPTS_VALUE ? b->order : b->pts;
+        if (ka < kb)
+            best = i;
+    }
+    return best;
+}
+
+int ff_ni_emu_dec_read(ni_session_context_t *p_ctx, ni_frame_t *frame,
+                       int hwdesc)
+{
+    EmuDecoder *d = p_ctx->emu;
+    int bdf = FFMAX(p_ctx->bit_depth_factor, 1);
+    EmuDecFrame df;
+    int idx, w, h;
+
+    frame->end_of_stream = 0;
+
+    if (!d->count || (!d->draining && d->count <= p_ctx->pic_reorder_delay)) {
+        frame->end_of_stream = d->draining && !d->count;
+        return 0;
+    }
+
+    idx = dec_next(d);
+    if (av_gettime_relative() < d->frames[idx].ready) {
+        if (!d->draining &&
+            dec_in_flight(d, av_gettime_relative()) < ff_ni_emu_config()->queue)
+            return 0;
+        ff_ni_emu_wait_until(d->frames[idx].ready);
+    }
+    df = d->frames[idx];
+    memmove(&d->frames[idx], &d->frames[idx + 1],
+            (d->count - idx - 1) * sizeof(*d->frames));
+    d->count--;
+
+    w = df.info.width  > 0 ? df.info.width  : d->width;
+    h = df.info.height > 0 ? df.info.height : d->height;
+    if (w <= 0 || h <= 0)
+        return NI_RETCODE_FAILURE;
+    d->width  = w;
+    d->height = h;
+    p_ctx->active_video_width  = NI_VPU_ALIGN128(w * bdf);
+    p_ctx->active_video_height = h;
+    p_ctx->actual_video_width  = w;
+
+    if (hwdesc) {
+        niFrameSurface1_t *surf;
+        EmuFrame *f;
+        int fidx;
+
+        if (!frame->p_data[3] || frame->data_len[3] < sizeof(*surf))
+            return NI_RETCODE_INVALID_PARAM;
+        surf = (niFrameSurface1_t *)frame->p_data[3];
+        fidx = ff_ni_emu_frame_acquire(d->s.pool, w, h, p_ctx->pixel_format,
+                                       ff_ni_emu_config()->timeout, surf);
+        if (!fidx)
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+        f = ff_ni_emu_frame_get(fidx);
+        fill_planes(f->format, f->data, f->linesize, w, h, df.info.avg);
+        surf->bit_depth     = bdf;
+        surf->encoding_type = d->semi_planar ? NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR :
+                                               NI_PIXEL_PLANAR_FORMAT_PLANAR;
+    } else {
+        int planar = d->semi_planar ? NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR :
+                                      NI_PIXEL_PLANAR_FORMAT_PLANAR;
+        int linesize[3];
+        uint32_t len[4];
+        uint8_t *data[3];
+
+        dec_layout(w, h, bdf, planar, linesize, len);
+        if (!frame->p_buffer || frame->data_len[0] < len[0] ||
+            frame->video_width != w || frame->video_height != h) {
+            if (ni_decoder_frame_buffer_alloc(p_ctx->dec_fme_buf_pool, frame, 1,
+                                              w, h, 0, bdf, planar) < 0)
+                return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+        data[0] = frame->p_data[0];
+        data[1] = data[0] + len[0];
+        data[2] = planar ? data[1] + len[1] : NULL;
+        fill_planes(p_ctx->pixel_format, data, linesize, w, h, df.info.avg);
+    }
+
+    frame->video_width  = w;
+    frame->video_height = h;
+    frame->crop_top     = 0;
+    frame->crop_left    = 0;
+    frame->crop_right   = w;
+    frame->crop_bottom  = h;
+    frame->pts          = df.pts;
+    frame->dts          = df.dts;
+    frame->pkt_pos      = df.pkt_pos;
+    frame->flags        = df.flags & EMU_PKT_FLAG_DISCARD;
+    frame->ni_pict_type = df.info.key ? DECODER_PIC_TYPE_IDR : PIC_TYPE_P;
+    frame->pixel_format = p_ctx->pixel_format;
+    frame->sei_total_len = 0;
+    p_ctx->frame_num++;
+    return FFMAX(frame->data_len[0] + frame->data_len[1] + frame->data_len[2] +
+                 frame->data_len[3], 1);
+}
+
+/* ----------------------------------------------------------------------
+ * ni_av_codec helpers
+ * ---------------------------------------------------------------------- */
+
+int ni_should_send_sei_with_frame(ni_session_context_t *p_enc_ctx,
+                                  ni_pic_type_t pic_type,
+                                  ni_xcoder_params_t *p_param)
+{
+    return pic_type == PIC_TYPE_IDR || pic_type == PIC_TYPE_I;
+}
+
+/* SEI, HDR and ROI side data are accepted but not carried into the emulated
+ * bitstream */
+void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format,
+                          int should_send_sei_with_frame, uint8_t *mdcv_data,
+                          uint8_t *cll_data, uint8_t *cc_data,
+                          uint8_t *udu_data, uint8_t *hdrp_data)
+{
+}
+
+void ni_enc_copy_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format,
+                          const uint8_t *mdcv_data, const uint8_t *cll_data,
+                          const uint8_t *cc_data, const uint8_t *udu_data,
+                          const uint8_t *hdrp_data, int is_hwframe,
+                          int is_semiplanar)
+{
+}
+
+int ni_enc_insert_timecode(ni_session_context_t *p_enc_ctx,
+                           ni_frame_t *p_enc_frame, ni_timecode_t *p_timecode)
+{
+    return 0;
+}
+
+int ni_enc_prep_reconf_demo_data(ni_session_context_t *p_enc_ctx,
+                                 ni_frame_t *p_dec_frame)
+{
+    return 0;
+}
+
+int ni_set_demo_roi_map(ni_session_context_t *p_enc_ctx)
+{
+    return 0;
+}
+
+ni_retcode_t ni_enc_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
+                                       int video_height, int alignment,
+                                       int metadata_flag, int factor,
+                                       int hw_frame_count, int is_planar,
+                                       ni_pix_fmt_t pix_fmt)
+{
+    if (hw_frame_count > 0)
+        return ni_frame_buffer_alloc(p_frame, video_width, video_height,
+                                     alignment, metadata_flag, factor,
+                                     hw_frame_count, is_planar);
+    return ni_frame_buffer_alloc_dl(p_frame, video_width, video_height, pix_fmt);
+}
+
+int ni_dec_packet_parse(ni_session_context_t *p_session_ctx,
+                        ni_xcoder_params_t *p_param, uint8_t *data, int size,
+                        ni_packet_t *p_packet, int low_delay, int codec_format,
+                        int pkt_nal_bitmap, int custom_sei_type,
+                        int *svct_skip_next_packet, int *is_lone_sei_pkt)
+{
+    if (is_lone_sei_pkt)
+        *is_lone_sei_pkt = 0;
+    return 0;
+}
+
+void ni_dec_retrieve_aux_data(ni_frame_t *frame)
+{
+}
@@ -0,0 +1,1284 @@
+/*
+ * Software emulation of the NETINT libxcoder API - 2D engine and AI
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The scaler session collects input frame configurations and executes the
+ * operation selected by scaler_operation when the output frame is
+ * configured, as the 2D engine does. Operations are approximations:
+ * resampling is nearest neighbour, colour conversion uses BT.601 limited
+ * range, delogo copies its input unchanged and drawbox draws two pixel wide
+ * outlines.
+ *
+ * The AI session runs a stand-in for the network: a job is queued for each
+ * input and completes in order on the AI engine timer. Detection networks
+ * return pseudo random values in [-10, 2) that only depend on the input
+ * picture and the position in the output, so that results can be compared
+ * between runs; networks whose outputs repeat their inputs return the input
+ * picture. ni_ai_config_network_binary() takes a text description of the
+ * layers in place of a network binary, one layer per line:
+ *
+ *   input 416 416 3
+ *   output 13 13 18
+ *   output 26 26 18
+ *
+ * Any other file is rejected as a network the device cannot run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "ni_device_api.h"
+#include "ni_emu.h"
+
+#define EMU_MAX_INPUTS 16
+#define EMU_AI_QUEUE   32
+
+typedef struct EmuScaler {
+    EmuSession s;
+
+    ni_frame_config_t in[EMU_MAX_INPUTS];
+    int               nb_in;
+    int               out_index;    ///< result waiting for read_hwdesc
+    int               out_owned;    ///< result was taken from the session pool
+
+    int               pool_width;
+    int               pool_height;
+    int               pool_format;
+
+    ni_scaler_params_t           params;
+    ni_scaler_drawbox_params_t   boxes[NI_MAX_SUPPORT_DRAWBOX_NUM];
+    ni_scaler_watermark_params_t marks[NI_MAX_SUPPORT_WATERMARK_NUM];
+} EmuScaler;
+
+typedef struct EmuAIJob {
+    int64_t  ready;
+    uint32_t seed;        ///< digest of the input picture
+    int      out_index;   ///< output frame of a hardware image network
+    uint8_t *image;       ///< input of a software image network
+    uint32_t image_size;
+} EmuAIJob;
+
+typedef struct EmuAI {
+    EmuSession        s;
+    ni_network_data_t network;
+    int               image;       ///< the output layers repeat the input ones
+
+    int               pool_width;
+    int               pool_height;
+    int               pool_format;
+    int               out_index;   ///< output frame of the next hardware job
+
+    EmuAIJob          queue[EMU_AI_QUEUE];
+    int               head;
+    int               count;
+} EmuAI;
+
+/* ----------------------------------------------------------------------
+ * pixel access
+ * ---------------------------------------------------------------------- */
+
+static int is_rgb(int fmt)
+{
+    switch (fmt) {
+    case NI_PIX_FMT_RGBA:
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_ARGB:
+    case NI_PIX_FMT_ABGR:
+    case NI_PIX_FMT_BGR0:
+    case NI_PIX_FMT_BGRP:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Bytes per element and subsampling of a plane. An element is the smallest
+ * addressable unit: one sample, one interleaved chroma pair, one packed
+ * pixel or one packed 4:2:2 pixel pair. */
+static void plane_desc(int fmt, int plane, int *es, int *sx, int *sy)
+{
+    int bdf = ff_ni_emu_bit_depth_factor(fmt);
+
+    *es = bdf == 2 ? 2 : 1;
+    *sx = *sy = 1;
+    switch (fmt) {
+    case NI_PIX_FMT_YUV420P:
+    case NI_PIX_FMT_YUV420P10LE:
+        if (plane)
+            *sx = *sy = 2;
+        break;
+    case NI_PIX_FMT_NV12:
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_8_TILED4X4:
+    case NI_PIX_FMT_10_TILED4X4:
+        if (plane) {
+            *es *= 2;
+            *sx = *sy = 2;
+        }
+        break;
+    case NI_PIX_FMT_NV16:
+        if (plane) {
+            *es = 2;
+            *sx = 2;
+        }
+        break;
+    case NI_PIX_FMT_YUYV422:
+    case NI_PIX_FMT_UYVY422:
+        *es = 4;
+        *sx = 2;
+        break;
+    case NI_PIX_FMT_BGRP:
+        break;
+    default:
+        *es = 4;
+        break;
+    }
+}
+
+static int get16(const uint8_t *p, int fmt)
+{
+    return fmt == NI_PIX_FMT_P010LE || fmt == NI_PIX_FMT_10_TILED4X4 ?
+           AV_RL16(p) >> 8 : av_clip_uint8(AV_RL16(p) >> 2);
+}
+
+static void put16(uint8_t *p, int fmt, int v)
+{
+    AV_WL16(p, fmt == NI_PIX_FMT_P010LE || fmt == NI_PIX_FMT_10_TILED4X4 ?
+               v << 8 : v << 2);
+}
+
+#define ROW(f, p, y) ((f)->data[p] + (size_t)(y) * (f)->linesize[p])
+
+/* Read one pixel as Y, U, V, A or R, G, B, A, depending on the format */
+static void px_get(const EmuFrame *f, int x, int y, uint8_t c[4])
+{
+    const uint8_t *p;
+
+    c[3] = 255;
+    switch (f->format) {
+    case NI_PIX_FMT_YUV420P:
+        c[0] = ROW(f, 0, y)[x];
+        c[1] = ROW(f, 1, y >> 1)[x >> 1];
+        c[2] = ROW(f, 2, y >> 1)[x >> 1];
+        break;
+    case NI_PIX_FMT_YUV420P10LE:
+        c[0] = get16(ROW(f, 0, y) + 2 * x, f->format);
+        c[1] = get16(ROW(f, 1, y >> 1) + 2 * (x >> 1), f->format);
+        c[2] = get16(ROW(f, 2, y >> 1) + 2 * (x >> 1), f->format);
+        break;
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_10_TILED4X4:
+        p    = ROW(f, 1, y >> 1) + 4 * (x >> 1);
+        c[0] = get16(ROW(f, 0, y) + 2 * x, f->format);
+        c[1] = get16(p, f->format);
+        c[2] = get16(p + 2, f->format);
+        break;
+    case NI_PIX_FMT_NV16:
+        p    = ROW(f, 1, y) + 2 * (x >> 1);
+        c[0] = ROW(f, 0, y)[x];
+        c[1] = p[0];
+        c[2] = p[1];
+        break;
+    case NI_PIX_FMT_YUYV422:
+        p    = ROW(f, 0, y) + 4 * (x >> 1);
+        c[0] = p[2 * (x & 1)];
+        c[1] = p[1];
+        c[2] = p[3];
+        break;
+    case NI_PIX_FMT_UYVY422:
+        p    = ROW(f, 0, y) + 4 * (x >> 1);
+        c[0] = p[1 + 2 * (x & 1)];
+        c[1] = p[0];
+        c[2] = p[2];
+        break;
+    case NI_PIX_FMT_RGBA:
+        p = ROW(f, 0, y) + 4 * x;
+        c[0] = p[0]; c[1] = p[1]; c[2] = p[2]; c[3] = p[3];
+        break;
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_BGR0:
+        p = ROW(f, 0, y) + 4 * x;
+        c[0] = p[2]; c[1] = p[1]; c[2] = p[0];
+        c[3] = f->format == NI_PIX_FMT_BGRA ? p[3] : 255;
+        break;
+    case NI_PIX_FMT_ARGB:
+        p = ROW(f, 0, y) + 4 * x;
+        c[0] = p[1]; c[1] = p[2]; c[2] = p[3]; c[3] = p[0];
+        break;
+    case NI_PIX_FMT_ABGR:
+        p = ROW(f, 0, y) + 4 * x;
+        c[0] = p[3]; c[1] = p[2]; c[2] = p[1]; c[3] = p[0];
+        break;
+    case NI_PIX_FMT_BGRP:
+        c[0] = ROW(f, 2, y)[x];
+        c[1] = ROW(f, 1, y)[x];
+        c[2] = ROW(f, 0, y)[x];
+        break;
+    default: /* NV12 and 8-bit tiled */
+        p    = ROW(f, 1, y >> 1) + 2 * (x >> 1);
+        c[0] = ROW(f, 0, y)[x];
+        c[1] = p[0];
+        c[2] = p[1];
+        break;
+    }
+}
+
+static void px_put(EmuFrame *f, int x, int y, const uint8_t c[4])
+{
+    uint8_t *p;
+
+    switch (f->format) {
+    case NI_PIX_FMT_YUV420P:
+        ROW(f, 0, y)[x] = c[0];
+        ROW(f, 1, y >> 1)[x >> 1] = c[1];
+        ROW(f, 2, y >> 1)[x >> 1] = c[2];
+        break;
+    case NI_PIX_FMT_YUV420P10LE:
+        put16(ROW(f, 0, y) + 2 * x, f->format, c[0]);
+        put16(ROW(f, 1, y >> 1) + 2 * (x >> 1), f->format, c[1]);
+        put16(ROW(f, 2, y >> 1) + 2 * (x >> 1), f->format, c[2]);
+        break;
+    case NI_PIX_FMT_P010LE:
+    case NI_PIX_FMT_10_TILED4X4:
+        p = ROW(f, 1, y >> 1) + 4 * (x >> 1);
+        put16(ROW(f, 0, y) + 2 * x, f->format, c[0]);
+        put16(p, f->format, c[1]);
+        put16(p + 2, f->format, c[2]);
+        break;
+    case NI_PIX_FMT_NV16:
+        p = ROW(f, 1, y) + 2 * (x >> 1);
+        ROW(f, 0, y)[x] = c[0];
+        p[0] = c[1];
+        p[1] = c[2];
+        break;
+    case NI_PIX_FMT_YUYV422:
+        p = ROW(f, 0, y) + 4 * (x >> 1);
+        p[2 * (x & 1)] = c[0];
+        p[1] = c[1];
+        p[3] = c[2];
+        break;
+    case NI_PIX_FMT_UYVY422:
+        p = ROW(f, 0, y) + 4 * (x >> 1);
+        p[1 + 2 * (x & 1)] = c[0];
+        p[0] = c[1];
+        p[2] = c[2];
+        break;
+    case NI_PIX_FMT_RGBA:
+        p = ROW(f, 0, y) + 4 * x;
+        p[0] = c[0]; p[1] = c[1]; p[2] = c[2]; p[3] = c[3];
+        break;
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_BGR0:
+        p = ROW(f, 0, y) + 4 * x;
+        p[0] = c[2]; p[1] = c[1]; p[2] = c[0];
+        p[3] = f->format == NI_PIX_FMT_BGRA ? c[3] : 255;
+        break;
+    case NI_PIX_FMT_ARGB:
+        p = ROW(f, 0, y) + 4 * x;
+        p[0] = c[3]; p[1] = c[0]; p[2] = c[1]; p[3] = c[2];
+        break;
+    case NI_PIX_FMT_ABGR:
+        p = ROW(f, 0, y) + 4 * x;
+        p[0] = c[3]; p[1] = c[2]; p[2] = c[1]; p[3] = c[0];
+        break;
+    case NI_PIX_FMT_BGRP:
+        ROW(f, 2, y)[x] = c[0];
+        ROW(f, 1, y)[x] = c[1];
+        ROW(f, 0, y)[x] = c[2];
+        break;
+    default:
+        p = ROW(f, 1, y >> 1) + 2 * (x >> 1);
+        ROW(f, 0, y)[x] = c[0];
+        p[0] = c[1];
+        p[1] = c[2];
+        break;
+    }
+}
+
+static void rgb_to_yuv(uint8_t c[4])
+{
+    int r = c[0], g = c[1], b = c[2];
+
+    c[0] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) +  16;
+    c[1] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+    c[2] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+}
+
+static void yuv_to_rgb(uint8_t c[4])
+{
+    int y = c[0] - 16, u = c[1] - 128, v = c[2] - 128;
+
+    c[0] = av_clip_uint8((298 * y + 409 * v + 128) >> 8);
+    c[1] = av_clip_uint8((298 * y - 100 * u - 208 * v + 128) >> 8);
+    c[2] = av_clip_uint8((298 * y + 516 * u + 128) >> 8);
+}
+
+static void convert(uint8_t c[4], int src_fmt, int dst_fmt)
+{
+    int src_rgb = is_rgb(src_fmt), dst_rgb = is_rgb(dst_fmt);
+
+    if (src_rgb && !dst_rgb)
+        rgb_to_yuv(c);
+    else if (!src_rgb && dst_rgb)
+        yuv_to_rgb(c);
+}
+
+/* Scaler colours are 0xAARRGGBB */
+static void color_for(uint32_t argb, int fmt, uint8_t c[4])
+{
+    c[0] = argb >> 16;
+    c[1] = argb >> 8;
+    c[2] = argb;
+    c[3] = argb >> 24;
+    if (!is_rgb(fmt))
+        rgb_to_yuv(c);
+}
+
+static void fill_rect(EmuFrame *f, int x0, int y0, int w, int h,
+                      const uint8_t c[4], int alpha)
+{
+    int x1 = FFMIN(x0 + w, f->width), y1 = FFMIN(y0 + h, f->height);
+
+    x0 = FFMAX(x0, 0);
+    y0 = FFMAX(y0, 0);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            uint8_t d[4];
+
+            if (alpha == 255) {
+                px_put(f, x, y, c);
+                continue;
+            }
+            px_get(f, x, y, d);
+            for (int i = 0; i < 3; i++)
+                d[i] = (c[i] * alpha + d[i] * (255 - alpha) + 127) / 255;
+            px_put(f, x, y, d);
+        }
+    }
+}
+
+/* ----------------------------------------------------------------------
+ * blitter
+ * ---------------------------------------------------------------------- */
+
+typedef struct EmuRect {
+    int x, y, w, h;
+} EmuRect;
+
+enum {
+    BLIT_BLEND   = 1,
+    BLIT_PREMULT = 2,
+};
+
+/* Same format, no blending, no rotation: nearest neighbour per plane */
+static void blit_planes(EmuFrame *dst, const EmuRect *dr,
+                        const EmuFrame *src, const EmuRect *sr)
+{
+    for (int p = 0; p < dst->nb_planes; p++) {
+        int es, sx, sy;
+        int dx0, dy0, dw, dh, sx0, sy0, sw, sh;
+
+        plane_desc(dst->format, p, &es, &sx, &sy);
+        dx0 = dr->x / sx; dy0 = dr->y / sy;
+        dw  = FFMAX(dr->w / sx, 1); dh = FFMAX(dr->h / sy, 1);
+        sx0 = sr->x / sx; sy0 = sr->y / sy;
+        sw  = FFMAX(sr->w / sx, 1); sh = FFMAX(sr->h / sy, 1);
+        dw  = FFMIN(dw, dst->linesize[p] / es - dx0);
+        dh  = FFMIN(dh, dst->plane_height[p] - dy0);
+
+        for (int y = 0; y < dh; y++) {
+            int syy = FFMIN(sy0 + (int)((int64_t)y * sh / dh),
+                            src->plane_height[p] - 1);
+            const uint8_t *srow = ROW(src, p, syy) + (size_t)sx0 * es;
+            uint8_t *drow = ROW(dst, p, dy0 + y) + (size_t)dx0 * es;
+
+            if (sw == dw) {
+                memcpy(drow, srow, (size_t)dw * es);
+                continue;
+            }
+            for (int x = 0; x < dw; x++)
+                memcpy(drow + (size_t)x * es,
+                       srow + (size_t)((int64_t)x * sw / dw) * es, es);
+        }
+    }
+}
+
+static int clip_rect(EmuRect *r, int w, int h)
+{
+    if (r->w <= 0 || r->h <= 0) {
+        r->x = r->y = 0;
+        r->w = w;
+        r->h = h;
+    }
+    r->x = av_clip(r->x, 0, w - 1);
+    r->y = av_clip(r->y, 0, h - 1);
+    r->w = FFMIN(r->w, w - r->x);
+    r->h = FFMIN(r->h, h - r->y);
+    return r->w > 0 && r->h > 0;
+}
+
+/**
+ * Copy a source rectangle into a destination rectangle, scaling, rotating
+ * (orientation as in ni_frame_config_t), converting and alpha blending.
+ */
+static void blit(EmuFrame *dst, EmuRect dr, const EmuFrame *src, EmuRect sr,
+                 int orientation, int flags)
+{
+    int swap = orientation == 1 || orientation == 3;
+
+    if (!clip_rect(&dr, dst->width, dst->height) ||
+        !clip_rect(&sr, src->width, src->height))
+        return;
+
+    if (!(flags & BLIT_BLEND) && !orientation && dst->format == src->format &&
+        !((dr.x | dr.y | sr.x | sr.y) & 1)) {
+        blit_planes(dst, &dr, src, &sr);
+        return;
+    }
+
+    for (int v = 0; v < dr.h; v++) {
+        for (int u = 0; u < dr.w; u++) {
+            /* position in the rotated source, then in the source */
+            int ru = (int)((int64_t)u * (swap ? sr.h : sr.w) / dr.w);
+            int rv = (int)((int64_t)v * (swap ? sr.w : sr.h) / dr.h);
+            int x, y;
+            uint8_t c[4], d[4];
+
+            switch (orientation) {
+            case 1:  x = rv;            y = sr.h - 1 - ru; break;
+            case 2:  x = sr.w - 1 - ru; y = sr.h - 1 - rv; break;
+            case 3:  x = sr.w - 1 - rv; y = ru;            break;
+            case 4:  x = sr.w - 1 - ru; y = rv;            break;
+            case 5:  x = ru;            y = sr.h - 1 - rv; break;
+            default: x = ru;            y = rv;            break;
+            }
+            px_get(src, sr.x + x, sr.y + y, c);
+            convert(c, src->format, dst->format);
+
+            if ((flags & BLIT_BLEND) && c[3] != 255) {
+                int a = c[3];
+
+                px_get(dst, dr.x + u, dr.y + v, d);
+                for (int i = 0; i < 3; i++) {
+                    int s = c[i];
+
+                    /* colour conversion of premultiplied black is not
+                     * black in YUV, so blend in the source model */
+                    if (flags & BLIT_PREMULT)
+                        d[i] = av_clip_uint8(s * a / 255 + d[i] * (255 - a) / 255);
+                    else
+                        d[i] = (s * a + d[i] * (255 - a) + 127) / 255;
+                }
+                d[3] = FFMAX(d[3], a);
+                px_put(dst, dr.x + u, dr.y + v, d);
+            } else {
+                px_put(dst, dr.x + u, dr.y + v, c);
+            }
+        }
+    }
+}
+
+static EmuRect cfg_rect(const ni_frame_config_t *cfg)
+{
+    return (EmuRect) { cfg->rectangle_x, cfg->rectangle_y,
+                       cfg->rectangle_width, cfg->rectangle_height };
+}
+
+static const EmuRect full_rect = { 0, 0, 0, 0 };
+
+/* ----------------------------------------------------------------------
+ * operations
+ * ---------------------------------------------------------------------- */
+
+static void draw_boxes(EmuScaler *sc, EmuFrame *f)
+{
+    for (int i = 0; i < NI_MAX_SUPPORT_DRAWBOX_NUM; i++) {
+        const ni_scaler_drawbox_params_t *b = &sc->boxes[i];
+        int w = (int)b->end_x - (int)b->start_x + 1;
+        int h = (int)b->end_y - (int)b->start_y + 1;
+        int alpha = b->rgba_c >> 24;
+        uint8_t c[4];
+
+        if (b->end_x <= b->start_x || b->end_y <= b->start_y)
+            continue;
+        color_for(b->rgba_c, f->format, c);
+        alpha = alpha ? alpha : 255;
+        fill_rect(f, b->start_x, b->start_y, w, 2, c, alpha);
+        fill_rect(f, b->start_x, b->end_y - 1, w, 2, c, alpha);
+        fill_rect(f, b->start_x, b->start_y + 2, 2, h - 4, c, alpha);
+        fill_rect(f, b->end_x - 1, b->start_y + 2, 2, h - 4, c, alpha);
+    }
+}
+
+static void watermark(EmuScaler *sc, EmuFrame *dst, const EmuFrame *mark,
+                      int flags)
+{
+    int any = 0;
+
+    for (int i = 0; i < NI_MAX_SUPPORT_WATERMARK_NUM; i++) {
+        const ni_scaler_watermark_params_t *m = &sc->marks[i];
+        EmuRect r = { m->ui32StartX, m->ui32StartY, m->ui32Width, m->ui32Height };
+
+        if (!m->ui32Valid || !m->ui32Width || !m->ui32Height)
+            continue;
+        any = 1;
+        if (r.x < mark->width && r.y < mark->height)
+            blit(dst, r, mark, r, 0, flags);
+    }
+    if (!any)
+        blit(dst, (EmuRect){ 0, 0, mark->width, mark->height }, mark,
+             full_rect, 0, flags);
+}
+
+static void execute(EmuScaler *sc, int op, const ni_frame_config_t *out,
+                    EmuFrame *dst, int inplace)
+{
+    int blend = BLIT_BLEND | (out->options & NI_SCALER_FLAG_PA ? BLIT_PREMULT : 0);
+    const EmuFrame *src = sc->nb_in ? ff_ni_emu_frame_get(sc->in[0].frame_index) : NULL;
+    const EmuFrame *bg;
+    uint8_t c[4];
+
+    switch (op) {
+    case NI_SCALER_OPCODE_OVERLAY:
+    case NI_SCALER_OPCODE_MERGE:
+    case NI_SCALER_OPCODE_WATERMARK:
+        bg = out->frame_index && out->frame_index != 0xFFFF ?
+             ff_ni_emu_frame_get(out->frame_index) : NULL;
+        if (bg && bg != dst)
+            blit(dst, full_rect, bg, full_rect, 0, 0);
+        if (op == NI_SCALER_OPCODE_WATERMARK) {
+            if (src)
+                watermark(sc, dst, src, blend);
+        } else if (src)
+            blit(dst, (EmuRect){ sc->in[0].rectangle_x, sc->in[0].rectangle_y,
+                                 src->width, src->height },
+                 src, full_rect, 0, op == NI_SCALER_OPCODE_OVERLAY ? blend : 0);
+        break;
+    case NI_SCALER_OPCODE_IPOVLY:
+        if (src)
+            blit(dst, cfg_rect(out), src, cfg_rect(&sc->in[0]), 0, blend);
+        break;
+    case NI_SCALER_OPCODE_STACK:
+        if (out->options & NI_SCALER_FLAG_FCE) {
+            color_for(out->rgba_color, dst->format, c);
+            fill_rect(dst, 0, 0, dst->width, dst->height, c, 255);
+        }
+        for (int i = 0; i < sc->nb_in; i++) {
+            const EmuFrame *f = ff_ni_emu_frame_get(sc->in[i].frame_index);
+            if (f)
+                blit(dst, cfg_rect(&sc->in[i]), f, full_rect, 0, 0);
+        }
+        break;
+    case NI_SCALER_OPCODE_DRAWBOX:
+        if (src && !inplace)
+            blit(dst, full_rect, src, full_rect, 0, 0);
+        draw_boxes(sc, dst);
+        break;
+    case NI_SCALER_OPCODE_AI_ALIGN:
+        if (src && !inplace)
+            blit(dst, full_rect, src, full_rect, 0, 0);
+        break;
+    case NI_SCALER_OPCODE_ROTATE:
+    case NI_SCALER_OPCODE_PAD:
+        color_for(out->rgba_color, dst->format, c);
+        fill_rect(dst, 0, 0, dst->width, dst->height, c, 255);
+        if (src)
+            blit(dst, cfg_rect(out), src,
+                 op == NI_SCALER_OPCODE_ROTATE ? full_rect : cfg_rect(&sc->in[0]),
+                 sc->in[0].orientation, 0);
+        break;
+    default: /* scale, crop, flip, delogo */
+        if (src)
+            blit(dst, cfg_rect(out), src, cfg_rect(&sc->in[0]),
+                 sc->in[0].orientation, 0);
+        break;
+    }
+}
+
+/* Copy the common area of two frames of the same format */
+static void frame_copy(EmuFrame *dst, const EmuFrame *src)
+{
+    int rows[EMU_MAX_PLANES], row_bytes[EMU_MAX_PLANES];
+
+    ff_ni_emu_row_bytes(dst->format, FFMIN(src->width, dst->width), row_bytes);
+    for (int i = 0; i < EMU_MAX_PLANES; i++)
+        rows[i] = FFMIN(src->plane_height[i], dst->plane_height[i]);
+    ff_ni_emu_copy_planes(dst->data, dst->linesize, src->data, src->linesize,
+                          row_bytes, rows, dst->nb_planes);
+}
+
+static int is_inplace(int op, const ni_frame_config_t *out)
+{
+    if (!out->frame_index || out->frame_index == 0xFFFF)
+        return 0;
+    /* these take the background from the output frame index and render
+     * into a new pool frame */
+    return op != NI_SCALER_OPCODE_OVERLAY && op != NI_SCALER_OPCODE_MERGE &&
+           op != NI_SCALER_OPCODE_WATERMARK;
+}
+
+/* Configure the output frame and run the operation */
+static int scaler_output(ni_session_context_t *p_ctx, EmuScaler *sc,
+                         const ni_frame_config_t *out)
+{
+    int op = p_ctx->scaler_operation;
+    int inplace = is_inplace(op, out);
+    int64_t ready = ff_ni_emu_timer_schedule(&sc->s.timer);
+    EmuFrame *dst;
+    int idx;
+
+    if (sc->out_index && sc->out_owned) {
+        /* result never collected, as the device would keep it in the pool */
+        ff_ni_emu_frame_release(sc->out_index);
+        sc->out_index = 0;
+    }
+
+    if (inplace) {
+        idx = out->frame_index;
+        if (!ff_ni_emu_frame_get(idx))
+            return NI_RETCODE_INVALID_PARAM;
+    } else {
+        int fmt = ff_ni_emu_gc620_to_ni(out->picture_format);
+        idx = ff_ni_emu_frame_acquire(sc->s.pool,
+                                      out->picture_width  ? out->picture_width  : sc->pool_width,
+                                      out->picture_height ? out->picture_height : sc->pool_height,
+                                      fmt, ff_ni_emu_config()->timeout, NULL);
+        if (!idx)
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+    dst = ff_ni_emu_frame_get(idx);
+    execute(sc, op, out, dst, inplace);
+
+    sc->nb_in     = 0;
+    sc->out_index = idx;
+    sc->out_owned = !inplace;
+    ff_ni_emu_wait_until(ready);
+    return NI_RETCODE_SUCCESS;
+}
+
+static int scaler_input(EmuScaler *sc, const ni_frame_config_t *in)
+{
+    if (sc->nb_in >= EMU_MAX_INPUTS)
+        return NI_RETCODE_INVALID_PARAM;
+    sc->in[sc->nb_in++] = *in;
+    return NI_RETCODE_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------
+ * session hooks
+ * ---------------------------------------------------------------------- */
+
+int ff_ni_emu_scaler_open(ni_session_context_t *p_ctx)
+{
+    EmuScaler *sc = av_mallocz(sizeof(*sc));
+
+    if (!sc)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    sc->s.device_type = NI_DEVICE_TYPE_SCALER;
+    ff_ni_emu_timer_init(&sc->s.timer, NI_DEVICE_TYPE_SCALER);
+    p_ctx->emu = sc;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_scaler_close(ni_session_context_t *p_ctx)
+{
+    EmuScaler *sc = p_ctx->emu;
+
+    if (sc->out_index && sc->out_owned)
+        ff_ni_emu_frame_release(sc->out_index);
+    ff_ni_emu_pool_close(sc->s.pool);
+    av_free(sc);
+}
+
+int ff_ni_emu_scaler_read_hwdesc(ni_session_context_t *p_ctx, ni_frame_t *frame)
+{
+    EmuScaler *sc = p_ctx->emu;
+    niFrameSurface1_t *surf;
+    int idx = sc->out_index;
+
+    if (!frame->p_data[3] || frame->data_len[3] < sizeof(*surf))
+        return NI_RETCODE_INVALID_PARAM;
+    surf = (niFrameSurface1_t *)frame->p_data[3];
+
+    /* without a pending result, hand out an empty pool frame as the
+     * target of a following in-place operation */
+    if (!idx) {
+        idx = ff_ni_emu_frame_acquire(sc->s.pool, sc->pool_width,
+                                      sc->pool_height, sc->pool_format,
+                                      ff_ni_emu_config()->timeout, NULL);
+        if (!idx)
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+    ff_ni_emu_fill_surface(surf, idx);
+    sc->out_index = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------
+ * AI session hooks
+ * ---------------------------------------------------------------------- */
+
+static uint32_t ai_digest(uint32_t h, const uint8_t *p, size_t len)
+{
+    /* FNV-1a */
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static uint32_t ai_frame_digest(const EmuFrame *f)
+{
+    int row_bytes[EMU_MAX_PLANES];
+    uint32_t h = 2166136261u;
+
+    ff_ni_emu_row_bytes(f->format, f->width, row_bytes);
+    for (int y = 0; y < f->height; y++)
+        h = ai_digest(h, f->data[0] + y * f->linesize[0], row_bytes[0]);
+    return h;
+}
+
+static float ai_output(uint32_t seed, uint32_t i)
+{
+    uint32_t x = seed ^ (i * 0x9E3779B9u);
+
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (x >> 8) * (12.0f / (1 << 24)) - 10.0f;
+}
+
+static uint32_t ai_layers_size(ni_network_layer_params_t *layers, uint32_t nb)
+{
+    uint32_t size = 0;
+
+    for (uint32_t i = 0; i < nb; i++)
+        size += ni_ai_network_layer_dims(&layers[i]);
+    return size;
+}
+
+static void ai_set_output(EmuAI *ai, int index)
+{
+    if (ai->out_index)
+        ff_ni_emu_frame_release(ai->out_index);
+    ai->out_index = index;
+}
+
+static EmuAIJob *ai_job_new(EmuAI *ai)
+{
+    EmuAIJob *job;
+
+    if (ai->count >= EMU_AI_QUEUE)
+        return NULL;
+    job = &ai->queue[(ai->head + ai->count++) % EMU_AI_QUEUE];
+    memset(job, 0, sizeof(*job));
+    job->ready = ff_ni_emu_timer_schedule(&ai->s.timer);
+    return job;
+}
+
+/* Take the oldest job off the queue once its result is due: like the
+ * device, a read does not wait for a result still being computed */
+static EmuAIJob *ai_job_take(EmuAI *ai)
+{
+    EmuAIJob *job = &ai->queue[ai->head];
+
+    if (job->ready > av_gettime_relative())
+        return NULL;
+    ai->head = (ai->head + 1) % EMU_AI_QUEUE;
+    ai->count--;
+    return job;
+}
+
+static void ai_job_free(EmuAIJob *job)
+{
+    if (job->out_index)
+        ff_ni_emu_frame_release(job->out_index);
+    job->out_index = 0;
+    av_freep(&job->image);
+}
+
+static int ai_submit_hw(EmuAI *ai, int frame_index)
+{
+    const EmuFrame *src = ff_ni_emu_frame_get(frame_index);
+    EmuFrame *dst;
+    EmuAIJob *job;
+
+    if (!src)
+        return NI_RETCODE_INVALID_PARAM;
+    job = ai_job_new(ai);
+    if (!job)
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+
+    job->seed      = ai_frame_digest(src);
+    job->out_index = ai->out_index;
+    ai->out_index  = 0;
+    dst = ff_ni_emu_frame_get(job->out_index);
+    if (dst && dst->format == src->format)
+        frame_copy(dst, src);
+    return NI_RETCODE_SUCCESS;
+}
+
+static int ai_config_frame(ni_session_context_t *p_ctx,
+                           const ni_frame_config_t *cfg)
+{
+    EmuAI *ai = p_ctx->emu;
+    int idx;
+
+    if ((cfg->options & (NI_AI_FLAG_IO | NI_AI_FLAG_PC)) ==
+        (NI_AI_FLAG_IO | NI_AI_FLAG_PC)) {
+        ff_ni_emu_pool_close(ai->s.pool);
+        ai->pool_width  = cfg->picture_width;
+        ai->pool_height = cfg->picture_height;
+        ai->pool_format = ff_ni_emu_gc620_to_ni(cfg->picture_format);
+        ai->s.pool = ff_ni_emu_pool_create(cfg->rgba_color,
+                                           !!(cfg->options & NI_AI_FLAG_LM),
+                                           p_ctx->session_id,
+                                           p_ctx->device_handle);
+        return ai->s.pool ? NI_RETCODE_SUCCESS :
+                            NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+    if (cfg->options & NI_AI_FLAG_IO) {
+        idx = ff_ni_emu_frame_acquire(ai->s.pool,
+                                      cfg->picture_width  ? cfg->picture_width  : ai->pool_width,
+                                      cfg->picture_height ? cfg->picture_height : ai->pool_height,
+                                      cfg->picture_width  ? ff_ni_emu_gc620_to_ni(cfg->picture_format) :
+                                                            ai->pool_format,
+                                      ff_ni_emu_config()->timeout, NULL);
+        if (!idx)
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+        ai_set_output(ai, idx);
+        return NI_RETCODE_SUCCESS;
+    }
+    return ai_submit_hw(ai, cfg->frame_index);
+}
+
+int ff_ni_emu_ai_open(ni_session_context_t *p_ctx)
+{
+    EmuAI *ai = av_mallocz(sizeof(*ai));
+
+    if (!ai)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    ai->s.device_type = NI_DEVICE_TYPE_AI;
+    ff_ni_emu_timer_init(&ai->s.timer, NI_DEVICE_TYPE_AI);
+    p_ctx->emu = ai;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ff_ni_emu_ai_close(ni_session_context_t *p_ctx)
+{
+    EmuAI *ai = p_ctx->emu;
+
+    for (int i = 0; i < ai->count; i++)
+        ai_job_free(&ai->queue[(ai->head + i) % EMU_AI_QUEUE]);
+    ai_set_output(ai, 0);
+    ff_ni_emu_pool_close(ai->s.pool);
+    av_free(ai);
+}
+
+int ff_ni_emu_ai_write(ni_session_context_t *p_ctx, ni_frame_t *frame)
+{
+    EmuAI *ai = p_ctx->emu;
+    uint32_t size = frame->data_len[0];
+    EmuAIJob *job;
+
+    if (!ai->network.output_num || !frame->p_data[0] || !size)
+        return NI_RETCODE_INVALID_PARAM;
+    job = ai_job_new(ai);
+    if (!job)
+        return 0;
+
+    job->seed = ai_digest(2166136261u, frame->p_data[0], size);
+    if (ai->image) {
+        job->image = av_memdup(frame->p_data[0], size);
+        if (!job->image) {
+            ai->count--;
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+        job->image_size = size;
+    }
+    return size;
+}
+
+int ff_ni_emu_ai_read(ni_session_context_t *p_ctx, ni_packet_t *pkt)
+{
+    EmuAI *ai = p_ctx->emu;
+    uint32_t nb = ai_layers_size(ai->network.linfo.out_param,
+                                 ai->network.output_num);
+    uint32_t size = ai->image ? nb : nb * sizeof(float);
+    EmuAIJob *job;
+
+    if (!ai->count || !size)
+        return NI_RETCODE_FAILURE;
+    job = ai_job_take(ai);
+    if (!job)
+        return 0;
+    if (ni_packet_buffer_alloc(pkt, size) < 0) {
+        ai_job_free(job);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    if (ai->image) {
+        uint32_t len = FFMIN(size, job->image_size);
+
+        if (job->image)
+            memcpy(pkt->p_data, job->image, len);
+        memset((uint8_t *)pkt->p_data + len, 0, size - len);
+    } else {
+        float *out = pkt->p_data;
+
+        for (uint32_t i = 0; i < nb; i++)
+            out[i] = ai_output(job->seed, i);
+    }
+    ai_job_free(job);
+    pkt->data_len = size;
+    return size;
+}
+
+int ff_ni_emu_ai_read_hwdesc(ni_session_context_t *p_ctx, ni_frame_t *frame)
+{
+    EmuAI *ai = p_ctx->emu;
+    EmuAIJob *job;
+    int idx;
+
+    if (!frame->p_data[3] || frame->data_len[3] < sizeof(niFrameSurface1_t))
+        return NI_RETCODE_INVALID_PARAM;
+    if (!ai->count)
+        return NI_RETCODE_FAILURE;
+    job = ai_job_take(ai);
+    if (!job)
+        return NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL; /* busy, retry */
+
+    idx = job->out_index;
+    job->out_index = 0;
+    ai_job_free(job);
+    if (!idx)
+        return NI_RETCODE_FAILURE;
+    ff_ni_emu_fill_surface((niFrameSurface1_t *)frame->p_data[3], idx);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_alloc_frame(ni_session_context_t *p_ctx,
+                                   int width, int height, int format,
+                                   int options, int rectangle_width,
+                                   int rectangle_height,
+                                   int rectangle_x, int rectangle_y,
+                                   int rgba_color, int frame_index,
+                                   ni_device_type_t device_type)
+{
+    ni_frame_config_t cfg = {
+        .picture_width    = width,
+        .picture_height   = height,
+        .picture_format   = format,
+        .options          = options,
+        .rectangle_width  = rectangle_width,
+        .rectangle_height = rectangle_height,
+        .rectangle_x      = rectangle_x,
+        .rectangle_y      = rectangle_y,
+        .rgba_color       = rgba_color,
+        .frame_index      = frame_index,
+    };
+
+    return ni_device_config_frame(p_ctx, &cfg);
+}
+
+ni_retcode_t ni_device_config_frame(ni_session_context_t *p_ctx,
+                                    ni_frame_config_t *p_cfg)
+{
+    EmuScaler *sc = p_ctx ? p_ctx->emu : NULL;
+
+    if (!sc || !p_cfg)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (sc->s.device_type == NI_DEVICE_TYPE_AI)
+        return ai_config_frame(p_ctx, p_cfg);
+    if (sc->s.device_type != NI_DEVICE_TYPE_SCALER)
+        return NI_RETCODE_FAILURE;
+
+    if ((p_cfg->options & (NI_SCALER_FLAG_IO | NI_SCALER_FLAG_PC)) ==
+        (NI_SCALER_FLAG_IO | NI_SCALER_FLAG_PC)) {
+        ff_ni_emu_pool_close(sc->s.pool);
+        sc->pool_width  = p_cfg->picture_width;
+        sc->pool_height = p_cfg->picture_height;
+        sc->pool_format = ff_ni_emu_gc620_to_ni(p_cfg->picture_format);
+        sc->s.pool = ff_ni_emu_pool_create(p_cfg->rgba_color,
+                                           !!(p_cfg->options & NI_SCALER_FLAG_LM),
+                                           p_ctx->session_id,
+                                           p_ctx->device_handle);
+        return sc->s.pool ? NI_RETCODE_SUCCESS :
+                            NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+    if (p_cfg->options & NI_SCALER_FLAG_IO)
+        return scaler_output(p_ctx, sc, p_cfg);
+    return scaler_input(sc, p_cfg);
+}
+
+ni_retcode_t ni_device_multi_config_frame(ni_session_context_t *p_ctx,
+                                          ni_frame_config_t p_cfg_in[],
+                                          int numInCfgs,
+                                          ni_frame_config_t *p_cfg_out)
+{
+    EmuScaler *sc = p_ctx ? p_ctx->emu : NULL;
+    int ret;
+
+    if (!sc || !p_cfg_out || numInCfgs < 0)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (sc->s.device_type != NI_DEVICE_TYPE_SCALER)
+        return NI_RETCODE_FAILURE;
+
+    sc->nb_in = 0;
+    for (int i = 0; i < numInCfgs; i++) {
+        ret = scaler_input(sc, &p_cfg_in[i]);
+        if (ret < 0)
+            return ret;
+    }
+    ret = scaler_output(p_ctx, sc, p_cfg_out);
+    /* the output frame was acquired up front with read_hwdesc(), so the
+     * result is not handed out again */
+    if (ret == NI_RETCODE_SUCCESS && !sc->out_owned)
+        sc->out_index = 0;
+    return ret;
+}
+
+ni_retcode_t ni_device_alloc_dst_frame(ni_session_context_t *p_ctx,
+                                       niFrameSurface1_t *p_out_surface,
+                                       ni_device_type_t device_type)
+{
+    EmuSession *s = p_ctx ? p_ctx->emu : NULL;
+    int idx;
+
+    if (!s || !s->pool || !p_out_surface)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    idx = ff_ni_emu_frame_acquire(s->pool, p_ctx->active_video_width,
+                                  p_ctx->active_video_height,
+                                  p_ctx->pixel_format,
+                                  ff_ni_emu_config()->timeout, p_out_surface);
+    if (!idx)
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    /* the network writes its result into the frame */
+    if (s->device_type == NI_DEVICE_TYPE_AI)
+        ai_set_output((EmuAI *)s, idx);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_clone_hwframe(ni_session_context_t *p_ctx,
+                                     ni_frameclone_desc_t *p_frameclone_desc)
+{
+    const EmuFrame *src;
+    EmuFrame *dst;
+
+    if (!p_frameclone_desc)
+        return NI_RETCODE_INVALID_PARAM;
+    src = ff_ni_emu_frame_get(p_frameclone_desc->ui16SrcIdx);
+    dst = ff_ni_emu_frame_get(p_frameclone_desc->ui16DstIdx);
+    if (!src || !dst || src->format != dst->format)
+        return NI_RETCODE_INVALID_PARAM;
+
+    frame_copy(dst, src);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_scaler_set_params(ni_session_context_t *p_ctx,
+                                  ni_scaler_params_t *p_params)
+{
+    EmuScaler *sc = p_ctx ? p_ctx->emu : NULL;
+
+    if (!sc || sc->s.device_type != NI_DEVICE_TYPE_SCALER || !p_params)
+        return NI_RETCODE_INVALID_PARAM;
+    sc->params = *p_params;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_scaler_set_drawbox_params(ni_session_context_t *p_ctx,
+                                          ni_scaler_drawbox_params_t *p_params)
+{
+    EmuScaler *sc = p_ctx ? p_ctx->emu : NULL;
+
+    if (!sc || sc->s.device_type != NI_DEVICE_TYPE_SCALER || !p_params)
+        return NI_RETCODE_INVALID_PARAM;
+    memcpy(sc->boxes, p_params, sizeof(sc->boxes));
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_scaler_set_watermark_params(ni_session_context_t *p_ctx,
+                                            ni_scaler_watermark_params_t *p_params)
+{
+    EmuScaler *sc = p_ctx ? p_ctx->emu : NULL;
+
+    if (!sc || sc->s.device_type != NI_DEVICE_TYPE_SCALER || !p_params)
+        return NI_RETCODE_INVALID_PARAM;
+    memcpy(sc->marks, p_params, sizeof(sc->marks));
+    return NI_RETCODE_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------
+ * AI
+ * ---------------------------------------------------------------------- */
+
+static int ai_configure(EmuAI *ai, ni_network_data_t *p_network,
+                        const ni_network_data_t *net)
+{
+    uint32_t offset = 0;
+
+    ai->network = *net;
+    ai->image   = net->input_num == net->output_num;
+    for (uint32_t i = 0; ai->image && i < net->input_num; i++) {
+        const ni_network_layer_params_t *in  = &net->linfo.in_param[i];
+        const ni_network_layer_params_t *out = &net->linfo.out_param[i];
+
+        ai->image = in->num_of_dims == out->num_of_dims &&
+                    !memcmp(in->sizes, out->sizes, sizeof(in->sizes));
+    }
+    for (uint32_t i = 0; i < net->output_num; i++) {
+        uint32_t dims = ni_ai_network_layer_dims(&ai->network.linfo.out_param[i]);
+
+        ai->network.outset[i].offset = offset;
+        offset += ai->image ? dims : dims * sizeof(float);
+    }
+    *p_network = ai->network;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_ai_config_network_binary(ni_session_context_t *p_ctx,
+                                         ni_network_data_t *p_network,
+                                         const char *file)
+{
+    EmuAI *ai = p_ctx ? p_ctx->emu : NULL;
+    ni_network_data_t net = { 0 };
+    char line[256];
+    FILE *f;
+
+    if (!ai || ai->s.device_type != NI_DEVICE_TYPE_AI || !p_network || !file)
+        return NI_RETCODE_INVALID_PARAM;
+    f = fopen(file, "r");
+    if (!f)
+        return NI_RETCODE_INVALID_PARAM;
+
+    while (fgets(line, sizeof(line), f)) {
+        ni_network_layer_params_t layer = { 0 };
+        unsigned sizes[6];
+        char kind[16];
+        int n = sscanf(line, "%15s %u %u %u %u %u %u", kind, &sizes[0],
+                       &sizes[1], &sizes[2], &sizes[3], &sizes[4], &sizes[5]);
+
+        if (n < 1 || kind[0] == '#')
+            continue;
+        layer.num_of_dims = n - 1;
+        for (int i = 0; i < n - 1; i++)
+            layer.sizes[i] = sizes[i];
+
+        if (n > 1 && !strcmp(kind, "input") &&
+            net.input_num < NI_MAX_NETWORK_INPUT_NUM) {
+            net.linfo.in_param[net.input_num++] = layer;
+        } else if (n > 1 && !strcmp(kind, "output") &&
+                   net.output_num < NI_MAX_NETWORK_OUTPUT_NUM) {
+            net.linfo.out_param[net.output_num++] = layer;
+        } else {
+            net.output_num = 0;
+            break;
+        }
+    }
+    fclose(f);
+
+    if (!net.input_num || !net.output_num)
+        return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
+    return ai_configure(ai, p_network, &net);
+}
+
+ni_retcode_t ni_ai_config_hvsplus(ni_session_context_t *p_ctx,
+                                  ni_network_data_t *p_network)
+{
+    EmuAI *ai = p_ctx ? p_ctx->emu : NULL;
+    ni_network_layer_params_t layer = {
+        .num_of_dims = 3,
+        .sizes       = { 3, p_ctx ? p_ctx->active_video_width  : 0,
+                            p_ctx ? p_ctx->active_video_height : 0 },
+    };
+    ni_network_data_t net = {
+        .input_num  = 1,
+        .output_num = 1,
+        .linfo      = { .in_param = { layer }, .out_param = { layer } },
+    };
+
+    if (!ai || ai->s.device_type != NI_DEVICE_TYPE_AI || !p_network ||
+        !layer.sizes[1] || !layer.sizes[2])
+        return NI_RETCODE_INVALID_PARAM;
+    return ai_configure(ai, p_network, &net);
+}
+
+uint32_t ni_ai_network_layer_dims(ni_network_layer_params_t *p_param)
+{
+    uint32_t dims = 1;
+
+    for (uint32_t i = 0; i < FFMIN(p_param->num_of_dims, 6); i++)
+        dims *= p_param->sizes[i];
+    return dims;
+}
+
+ni_retcode_t ni_ai_frame_buffer_alloc(ni_frame_t *p_frame,
+                                      ni_network_data_t *p_network)
+{
+    uint32_t size;
+
+    if (!p_frame || !p_network)
+        return NI_RETCODE_INVALID_PARAM;
+    size = ai_layers_size(p_network->linfo.in_param, p_network->input_num);
+    if (ff_ni_emu_frame_reserve(p_frame, FFMAX(size, 1)) < 0)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    p_frame->p_data[0]   = p_frame->p_buffer;
+    p_frame->data_len[0] = size;
+    return NI_RETCODE_SUCCESS;
+}
+
+/* Room for every output as float, which covers both kinds of network */
+ni_retcode_t ni_ai_packet_buffer_alloc(ni_packet_t *p_packet,
+                                       ni_network_data_t *p_network)
+{
+    uint32_t size;
+
+    if (!p_packet || !p_network)
+        return NI_RETCODE_INVALID_PARAM;
+    size = ai_layers_size(p_network->linfo.out_param, p_network->output_num);
+    return ni_packet_buffer_alloc(p_packet, FFMAX(size * sizeof(float), 1));
+}
+
+/* num is the size of dst in bytes */
+ni_retcode_t ni_network_layer_convert_output(float *dst, uint32_t num,
+                                             ni_packet_t *p_packet,
+                                             ni_network_data_t *p_network,
+                                             uint32_t layer)
+{
+    uint32_t offset, dims;
+
+    if (!dst || !p_packet || !p_network || layer >= p_network->output_num)
+        return NI_RETCODE_INVALID_PARAM;
+    offset = p_network->outset[layer].offset;
+    dims   = ni_ai_network_layer_dims(&p_network->linfo.out_param[layer]);
+    num    = FFMIN(num / sizeof(float), dims);
+    if (!p_packet->p_data || offset + num * sizeof(float) > p_packet->data_len)
+        return NI_RETCODE_INVALID_PARAM;
+    memcpy(dst, (const uint8_t *)p_packet->p_data + offset, num * sizeof(float));
+    return NI_RETCODE_SUCCESS;
+}
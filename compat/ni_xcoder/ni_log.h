@@ -0,0 +1,40 @@
+/*
+ * Software emulation of the NETINT libxcoder API - logging
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_LOG_H
+#define COMPAT_NI_XCODER_NI_LOG_H
+
+#include "ni_defs.h"
+
+typedef enum {
+    NI_LOG_NONE  = 0,
+    NI_LOG_FATAL = 1,
+    NI_LOG_ERROR = 2,
+    NI_LOG_INFO  = 3,
+    NI_LOG_DEBUG = 4,
+    NI_LOG_TRACE = 5,
+} ni_log_level_t;
+
+LIB_API void ni_log_set_level(ni_log_level_t level);
+LIB_API ni_log_level_t ni_log_get_level(void);
+LIB_API ni_log_level_t ff_to_ni_log_level(int fflog_level);
+
+#endif /* COMPAT_NI_XCODER_NI_LOG_H */
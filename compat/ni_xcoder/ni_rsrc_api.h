@@ -0,0 +1,59 @@
+/*
+ * Software emulation of the NETINT libxcoder API - resource management
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_RSRC_API_H
+#define COMPAT_NI_XCODER_NI_RSRC_API_H
+
+#include "ni_defs.h"
+
+#define NI_MAX_DEVICES_PER_HW_INSTANCE 4
+
+typedef struct _ni_device_info {
+    char     dev_name[MAX_CHAR_IN_DEVICE_NAME];
+    char     blk_name[MAX_CHAR_IN_DEVICE_NAME];
+    int      hw_id;
+    int      module_id;
+    int      load;
+    int      model_load;
+    int      active_num_inst;
+    int      max_instance_cnt;
+    ni_device_type_t device_type;
+    char     fw_rev[8];
+} ni_device_info_t;
+
+typedef struct _ni_device {
+    int              xcoder_cnt[NI_DEVICE_TYPE_XCODER_MAX];
+    ni_device_info_t xcoders[NI_DEVICE_TYPE_XCODER_MAX][NI_MAX_DEVICE_CNT];
+} ni_device_t;
+
+typedef struct _ni_device_context {
+    char             shm_name[32];
+    ni_device_info_t *p_device_info;
+} ni_device_context_t;
+
+LIB_API ni_retcode_t ni_rsrc_list_all_devices(ni_device_t *p_device);
+LIB_API ni_device_info_t *ni_rsrc_get_device_info(ni_device_type_t device_type,
+                                                  int guid);
+LIB_API int ni_rsrc_get_device_by_block_name(const char *blk_name,
+                                             ni_device_type_t device_type);
+LIB_API void ni_rsrc_free_device_context(ni_device_context_t *p_ctx);
+
+#endif /* COMPAT_NI_XCODER_NI_RSRC_API_H */
@@ -0,0 +1,59 @@
+/*
+ * Software emulation of the NETINT libxcoder API - utilities
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COMPAT_NI_XCODER_NI_UTIL_H
+#define COMPAT_NI_XCODER_NI_UTIL_H
+
+#include <stdlib.h>
+
+#include "ni_device_api.h"
+
+#define ni_memfree(p_memptr)                                                   \
+    do {                                                                       \
+        free((p_memptr));                                                      \
+        (p_memptr) = NULL;                                                     \
+    } while (0)
+
+#define ni_aligned_free(p_memptr)                                              \
+    do {                                                                       \
+        free((p_memptr));                                                      \
+        (p_memptr) = NULL;                                                     \
+    } while (0)
+
+LIB_API void ni_usleep(int64_t usec);
+
+LIB_API void ni_get_hw_yuv420p_dim(int width, int height, int factor,
+                                   int is_semiplanar, int plane_stride[4],
+                                   int plane_height[4]);
+LIB_API void ni_get_min_frame_dim(int width, int height,
+                                  ni_pix_fmt_t pix_fmt,
+                                  int plane_stride[4], int plane_height[4]);
+LIB_API void ni_copy_frame_data(uint8_t *p_dst[4], uint8_t *p_src[4],
+                                int frame_width, int frame_height,
+                                int factor, ni_pix_fmt_t pix_fmt,
+                                int conf_win_right, int dst_stride[4],
+                                int dst_height[4], int src_stride[4],
+                                int src_height[4]);
+LIB_API int ni_expand_frame(ni_frame_t *dst, ni_frame_t *src,
+                            int dst_stride[], int raw_width, int raw_height,
+                            int ni_fmt, int nb_planes);
+
+#endif /* COMPAT_NI_XCODER_NI_UTIL_H */
@@ -0,0 +1,381 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "libavformat/avio.h"
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "async_writer.h"
+#include "latency_hist.h"
+
+typedef struct Chunk {
+    uint8_t *data;
+    size_t   size;
+    // position in the output where the chunk is to be written
+    int64_t  offset;
+} Chunk;
+
+struct AsyncWriter {
+    void           *logctx;
+
+    // the underlying output context, only accessed by the writer thread
+    // while it is running
+    AVIOContext    *pb;
+
+    size_t          chunk_size;
+
+    // ring of chunks, the ones between head and head + nb_queued are
+    // queued or being written
+    Chunk          *chunks;
+    unsigned int    nb_chunks;
+    unsigned int    head;
+    unsigned int    nb_queued;
+
+    // output position of the next byte written by the muxer, and the
+    // largest position written so far; only accessed by the muxer thread
+    int64_t         pos;
+    int64_t         size;
+
+    int             finish;
+    // first error returned by the underlying context
+    int             error;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       thread;
+    int             thread_started;
+
+    LatencyHist    *latency;
+
+    atomic_uint_least64_t nb_writes;
+    atomic_uint_least64_t bytes_written;
+    atomic_uint_least64_t nb_stalls;
+    atomic_uint_least64_t stall_time;
+    atomic_uint_least64_t nb_syncs;
+};
+
+static void *writer_thread(void *arg)
+{
+    AsyncWriter *aw = arg;
+
+    ff_thread_setname("aw");
+
+    pthread_mutex_lock(&aw->lock);
+
+    while (1) {
+        Chunk  *c;
+        int64_t t0;
+        int     err = 0;
+
+        while (!aw->nb_queued && !aw->finish)
+            pthread_cond_wait(&aw->cond, &aw->lock);
+        if (!aw->nb_queued)
+            break;
+
+        c = &aw->chunks[aw->head];
+        pthread_mutex_unlock(&aw->lock);
+
+        // keep draining the queue after an error, so the muxer does not block
+        if (!aw->error) {
+            t0 = av_gettime_relative();
+
+            if (avio_tell(aw->pb) != c->offset) {
+                int64_t ret = avio_seek(aw->pb, c->offset, SEEK_SET);
+                if (ret < 0)
+                    err = ret;
+            }
+            if (!err) {
+                avio_write(aw->pb, c->data, c->size);
+                err = aw->pb->error;
+            }
+
+            latency_hist_add(aw->latency, av_gettime_relative() - t0);
+            atomic_fetch_add_explicit(&aw->nb_writes, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&aw->bytes_written, c->size,
+                                      memory_order_relaxed);
+        }
+
+        pthread_mutex_lock(&aw->lock);
+
+        if (err < 0 && !aw->error) {
+            av_log(aw->logctx, AV_LOG_ERROR, "Error writing output: %s\n",
+                   av_err2str(err));
+            aw->error = err;
+        }
+
+        aw->head = (aw->head + 1) % aw->nb_chunks;
+        aw->nb_queued--;
+        pthread_cond_broadcast(&aw->cond);
+    }
+
+    pthread_mutex_unlock(&aw->lock);
+
+    return NULL;
+}
+
+static int queue_chunk(AsyncWriter *aw, const uint8_t *buf, size_t size)
+{
+    Chunk *c;
+
+    if (aw->nb_queued == aw->nb_chunks) {
+        int64_t t0 = av_gettime_relative();
+
+        while (aw->nb_queued == aw->nb_chunks)
+            pthread_cond_wait(&aw->cond, &aw->lock);
+
+        atomic_fetch_add_explicit(&aw->nb_stalls, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&aw->stall_time, av_gettime_relative() - t0,
+                                  memory_order_relaxed);
+    }
+
+    if (aw->error < 0)
+        return aw->error;
+
+    // chunks are allocated on first use
+    c = &aw->chunks[(aw->head + aw->nb_queued) % aw->nb_chunks];
+    if (!c->data) {
+        c->data = av_malloc(aw->chunk_size);
+        if (!c->data)
+            return AVERROR(ENOMEM);
+    }
+
+    memcpy(c->data, buf, size);
+    c->size   = size;
+    c->offset = aw->pos;
+
+    aw->pos += size;
+    aw->size = FFMAX(aw->size, aw->pos);
+
+    aw->nb_queued++;
+    pthread_cond_broadcast(&aw->cond);
+
+    return 0;
+}
+
+static int write_packet(void *opaque, const uint8_t *buf, int buf_size)
+{
+    AsyncWriter *aw = opaque;
+    size_t size = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&aw->lock);
+
+    for (int offset = 0; offset < buf_size; offset += size) {
+        size = FFMIN(buf_size - offset, aw->chunk_size);
+        ret  = queue_chunk(aw, buf + offset, size);
+        if (ret < 0)
+            goto finish;
+    }
+
+    // The context buffer is exactly one chunk, so it is only written out
+    // partially when flushed explicitly or before seeking. Wait for all
+    // the data to be written, so it can be read back from the output.
+    if (size < aw->chunk_size) {
+        while (aw->nb_queued)
+            pthread_cond_wait(&aw->cond, &aw->lock);
+        atomic_fetch_add_explicit(&aw->nb_syncs, 1, memory_order_relaxed);
+        ret = aw->error;
+    }
+
+finish:
+    pthread_mutex_unlock(&aw->lock);
+    return ret < 0 ? ret : buf_size;
+}
+
+static int64_t seek(void *opaque, int64_t offset, int whence)
+{
+    AsyncWriter *aw = opaque;
+
+    // the actual seek is done by the writer thread before writing data
+    // to the new position
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return aw->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += aw->pos;
+        break;
+    case SEEK_END:
+        offset += aw->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (offset < 0)
+        return AVERROR(EINVAL);
+
+    aw->pos = offset;
+    return offset;
+}
+
+static void writer_free(AsyncWriter **paw)
+{
+    AsyncWriter *aw = *paw;
+
+    if (!aw)
+        return;
+
+    for (unsigned int i = 0; i < aw->nb_chunks; i++)
+        av_freep(&aw->chunks[i].data);
+    av_freep(&aw->chunks);
+
+    latency_hist_free(&aw->latency);
+
+    pthread_cond_destroy(&aw->cond);
+    pthread_mutex_destroy(&aw->lock);
+
+    av_freep(paw);
+}
+
+int aw_alloc(AsyncWriter **paw, AVIOContext **ppb, size_t chunk_size,
+             size_t max_buffered, void *logctx)
+{
+    AsyncWriter *aw;
+    AVIOContext *pb = NULL;
+    uint8_t *buf;
+    int ret;
+
+    if (!chunk_size || chunk_size > INT_MAX)
+        return AVERROR(EINVAL);
+
+    aw = av_mallocz(sizeof(*aw));
+    if (!aw)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&aw->lock, NULL);
+    if (ret) {
+        av_freep(&aw);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&aw->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&aw->lock);
+        av_freep(&aw);
+        return AVERROR(ret);
+    }
+
+    aw->logctx     = logctx;
+    aw->chunk_size = chunk_size;
+    aw->nb_chunks  = FFMAX(max_buffered / chunk_size, 2);
+
+    aw->chunks  = av_calloc(aw->nb_chunks, sizeof(*aw->chunks));
+    aw->latency = latency_hist_alloc();
+    if (!aw->chunks || !aw->latency) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    buf = av_malloc(chunk_size);
+    if (!buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    pb = avio_alloc_context(buf, chunk_size, 1, aw, NULL, write_packet, seek);
+    if (!pb) {
+        av_freep(&buf);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    pb->seekable = (*ppb)->seekable;
+    // only flush whole chunks at the flush points the muxer marks after
+    // every packet
+    pb->min_packet_size = chunk_size;
+
+    aw->pb   = *ppb;
+    aw->pos  = aw->size = avio_tell(aw->pb);
+    // write the chunks straight through, without splitting them into the
+    // context buffer size
+    aw->pb->direct = 1;
+
+    ret = pthread_create(&aw->thread, NULL, writer_thread, aw);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    aw->thread_started = 1;
+
+    *ppb = pb;
+    *paw = aw;
+
+    return 0;
+fail:
+    if (pb) {
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+    }
+    writer_free(&aw);
+    return ret;
+}
+
+int aw_close(AsyncWriter *aw, AVIOContext **ppb)
+{
+    AVIOContext *pb = ppb ? *ppb : NULL;
+    int ret;
+
+    if (!aw->pb)
+        return 0;
+
+    if (pb) {
+        avio_flush(pb);
+        av_freep(&pb->buffer);
+        avio_context_free(ppb);
+    }
+
+    if (aw->thread_started) {
+        pthread_mutex_lock(&aw->lock);
+        aw->finish = 1;
+        pthread_cond_broadcast(&aw->cond);
+        pthread_mutex_unlock(&aw->lock);
+
+        pthread_join(aw->thread, NULL);
+        aw->thread_started = 0;
+    }
+
+    ret = avio_closep(&aw->pb);
+
+    return aw->error < 0 ? aw->error : ret;
+}
+
+void aw_free(AsyncWriter **paw, AVIOContext **ppb)
+{
+    if (*paw)
+        aw_close(*paw, ppb);
+    writer_free(paw);
+}
+
+void aw_stats(AsyncWriter *aw, AsyncWriterStats *stats,
+              LatencyHistStats *interval)
+{
+    stats->nb_writes     = atomic_load_explicit(&aw->nb_writes,     memory_order_relaxed);
+    stats->bytes_written = atomic_load_explicit(&aw->bytes_written, memory_order_relaxed);
+    stats->nb_stalls     = atomic_load_explicit(&aw->nb_stalls,     memory_order_relaxed);
+    stats->stall_time    = atomic_load_explicit(&aw->stall_time,    memory_order_relaxed);
+    stats->nb_syncs      = atomic_load_explicit(&aw->nb_syncs,      memory_order_relaxed);
+
+    latency_hist_stats(aw->latency, &stats->latency, interval);
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_ASYNC_WRITER_H
+#define FFTOOLS_ASYNC_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavformat/avio.h"
+
+#include "latency_hist.h"
+
+/**
+ * Writer thread for an output AVIOContext. Data written to the context is
+ * coalesced into chunks of a fixed size, which are written to the underlying
+ * context by a separate thread, so that slow storage does not block the
+ * writing thread until the buffered data reaches a given limit.
+ *
+ * Seeking is supported and performed asynchronously as well. Explicit flushes
+ * (avio_flush()) wait until all the data has been written, so that the data is
+ * visible to other readers of the same file.
+ */
+typedef struct AsyncWriter AsyncWriter;
+
+typedef struct AsyncWriterStats {
+    /**
+     * Number of writes performed on the underlying context and total number
+     * of bytes written.
+     */
+    uint64_t nb_writes;
+    uint64_t bytes_written;
+    /**
+     * Number of times and total time (in microseconds) the writing thread
+     * waited, because the buffer was full.
+     */
+    uint64_t nb_stalls;
+    uint64_t stall_time;
+    /**
+     * Number of explicit flushes, which wait for all the data to be written.
+     */
+    uint64_t nb_syncs;
+    /**
+     * Duration of the writes on the underlying context, in microseconds.
+     */
+    LatencyHistStats latency;
+} AsyncWriterStats;
+
+/**
+ * Start a writer thread for an output context.
+ *
+ * @param pb the output context; on success, it becomes owned by the writer
+ *           and is replaced with a context that must be closed with
+ *           aw_close()
+ * @param chunk_size size of the writes to the underlying context
+ * @param max_buffered maximum number of bytes buffered in the writer, at least
+ *                     two chunks are used
+ */
+int aw_alloc(AsyncWriter **aw, AVIOContext **pb, size_t chunk_size,
+             size_t max_buffered, void *logctx);
+
+/**
+ * Write all the buffered data, stop the writer thread and close the original
+ * output context. Calling this function again has no effect.
+ *
+ * @param pb the context returned from aw_alloc(), will be freed and set to NULL
+ * @return the first error that occurred while writing or closing, 0 otherwise
+ */
+int aw_close(AsyncWriter *aw, AVIOContext **pb);
+
+/**
+ * Free the writer, closing it first if it was not closed already.
+ */
+void aw_free(AsyncWriter **aw, AVIOContext **pb);
+
+/**
+ * Get the writer statistics. May be called from any thread.
+ *
+ * @param interval if non-NULL, write latency statistics over the writes since
+ *                 the previous call with a non-NULL interval are written here;
+ *                 only a single thread may request them
+ */
+void aw_stats(AsyncWriter *aw, AsyncWriterStats *stats,
+              LatencyHistStats *interval);
+
+#endif // FFTOOLS_ASYNC_WRITER_H
@@ -0,0 +1,339 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "libavcodec/packet.h"
+
+#include "libavutil/avutil.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "demux_prefetch.h"
+#include "objpool.h"
+
+typedef struct PrefetchEntry {
+    AVPacket *pkt;
+    // dts (or pts) in AV_TIME_BASE, AV_NOPTS_VALUE if unknown
+    int64_t   ts;
+} PrefetchEntry;
+
+struct DemuxPrefetch {
+    DemuxPrefetchRead   read;
+    DemuxPrefetchChoked choked;
+    void               *opaque;
+
+    size_t              max_bytes;
+    int64_t             max_duration;
+
+    ObjPool            *pkt_pool;
+
+    // everything below is protected by lock
+    AVFifo             *queue;
+    size_t              bytes;
+    // timestamp of the newest queued packet
+    int64_t             ts_last;
+
+    // error returned by the read callback, returned to the consumer once
+    // the queue is drained
+    int                 read_ret;
+    // the reader waits for dp_resume() after an error
+    int                 paused;
+    int                 stop;
+    atomic_int          interrupt;
+
+    pthread_mutex_t     lock;
+    // signalled when a packet is queued or an error occurs
+    pthread_cond_t      cond_consumer;
+    // signalled when a packet is taken, on resume and on stop
+    pthread_cond_t      cond_reader;
+    pthread_t           thread;
+    int                 thread_started;
+
+    uint64_t            nb_taken;
+    uint64_t            bytes_sum;
+    uint64_t            bytes_peak;
+    uint64_t            nb_underruns;
+    uint64_t            underrun_time;
+    uint64_t            nb_choked;
+};
+
+static int64_t queue_duration(const DemuxPrefetch *dp)
+{
+    PrefetchEntry e;
+
+    if (dp->ts_last == AV_NOPTS_VALUE ||
+        av_fifo_peek(dp->queue, &e, 1, 0) < 0 || e.ts == AV_NOPTS_VALUE)
+        return 0;
+
+    return FFMAX(dp->ts_last - e.ts, 0);
+}
+
+static int queue_full(const DemuxPrefetch *dp)
+{
+    if (!av_fifo_can_read(dp->queue))
+        return 0;
+
+    return dp->bytes >= dp->max_bytes ||
+           (dp->max_duration && queue_duration(dp) >= dp->max_duration);
+}
+
+static int reader_can_read(DemuxPrefetch *dp)
+{
+    return !dp->paused && !queue_full(dp) &&
+           // do not read ahead while the demuxer is choked, unless the
+           // consumer has nothing to send once it gets unchoked
+           !(av_fifo_can_read(dp->queue) && dp->choked(dp->opaque));
+}
+
+static void *reader_thread(void *arg)
+{
+    DemuxPrefetch *dp = arg;
+
+    pthread_mutex_lock(&dp->lock);
+
+    while (1) {
+        PrefetchEntry e = { .ts = AV_NOPTS_VALUE };
+        int ret;
+
+        if (!dp->stop && !reader_can_read(dp)) {
+            if (!dp->paused && !queue_full(dp))
+                dp->nb_choked++;
+
+            while (!dp->stop && !reader_can_read(dp))
+                pthread_cond_wait(&dp->cond_reader, &dp->lock);
+        }
+        if (dp->stop)
+            break;
+
+        pthread_mutex_unlock(&dp->lock);
+
+        ret = objpool_get(dp->pkt_pool, (void**)&e.pkt);
+        if (ret >= 0)
+            ret = dp->read(dp->opaque, e.pkt);
+        if (ret >= 0) {
+            int64_t ts = e.pkt->dts != AV_NOPTS_VALUE ? e.pkt->dts : e.pkt->pts;
+            if (ts != AV_NOPTS_VALUE && e.pkt->time_base.num > 0)
+                e.ts = av_rescale_q(ts, e.pkt->time_base, AV_TIME_BASE_Q);
+        }
+
+        pthread_mutex_lock(&dp->lock);
+
+        if (ret >= 0)
+            ret = av_fifo_write(dp->queue, &e, 1);
+        if (ret < 0) {
+            objpool_release(dp->pkt_pool, (void**)&e.pkt);
+            dp->read_ret = ret;
+            dp->paused   = 1;
+        } else {
+            dp->bytes     += e.pkt->size;
+            dp->bytes_peak = FFMAX(dp->bytes_peak, dp->bytes);
+            if (e.ts != AV_NOPTS_VALUE)
+                dp->ts_last = dp->ts_last == AV_NOPTS_VALUE ? e.ts :
+                              FFMAX(dp->ts_last, e.ts);
+        }
+
+        pthread_cond_signal(&dp->cond_consumer);
+    }
+
+    pthread_mutex_unlock(&dp->lock);
+
+    return NULL;
+}
+
+int dp_read(DemuxPrefetch *dp, AVPacket *pkt)
+{
+    PrefetchEntry e;
+    int ret = 0;
+
+    pthread_mutex_lock(&dp->lock);
+
+    if (!av_fifo_can_read(dp->queue) && !dp->read_ret) {
+        int64_t t0 = av_gettime_relative();
+
+        while (!av_fifo_can_read(dp->queue) && !dp->read_ret && !dp->stop)
+            pthread_cond_wait(&dp->cond_consumer, &dp->lock);
+
+        dp->nb_underruns++;
+        dp->underrun_time += av_gettime_relative() - t0;
+    }
+
+    if (av_fifo_read(dp->queue, &e, 1) >= 0) {
+        dp->bytes_sum += dp->bytes;
+        dp->nb_taken++;
+        dp->bytes     -= e.pkt->size;
+
+        if (!av_fifo_can_read(dp->queue))
+            dp->ts_last = AV_NOPTS_VALUE;
+
+        av_packet_move_ref(pkt, e.pkt);
+        objpool_release(dp->pkt_pool, (void**)&e.pkt);
+
+        pthread_cond_signal(&dp->cond_reader);
+    } else {
+        ret = dp->read_ret ? dp->read_ret : AVERROR_EXIT;
+        dp->read_ret = 0;
+    }
+
+    pthread_mutex_unlock(&dp->lock);
+
+    return ret;
+}
+
+void dp_resume(DemuxPrefetch *dp)
+{
+    pthread_mutex_lock(&dp->lock);
+    dp->paused = 0;
+    pthread_cond_signal(&dp->cond_reader);
+    pthread_mutex_unlock(&dp->lock);
+}
+
+int dp_start(DemuxPrefetch *dp)
+{
+    int ret;
+
+    ret = pthread_create(&dp->thread, NULL, reader_thread, dp);
+    if (ret)
+        return AVERROR(ret);
+    dp->thread_started = 1;
+
+    return 0;
+}
+
+void dp_stop(DemuxPrefetch *dp)
+{
+    if (!dp->thread_started)
+        return;
+
+    pthread_mutex_lock(&dp->lock);
+    dp->stop = 1;
+    atomic_store(&dp->interrupt, 1);
+    pthread_cond_broadcast(&dp->cond_reader);
+    pthread_cond_broadcast(&dp->cond_consumer);
+    pthread_mutex_unlock(&dp->lock);
+
+    pthread_join(dp->thread, NULL);
+    dp->thread_started = 0;
+
+    // the demuxer may still be closed normally
+    atomic_store(&dp->interrupt, 0);
+}
+
+int dp_interrupted(DemuxPrefetch *dp)
+{
+    return atomic_load(&dp->interrupt);
+}
+
+void dp_stats(DemuxPrefetch *dp, DemuxPrefetchStats *stats)
+{
+    pthread_mutex_lock(&dp->lock);
+
+    stats->nb_packets    = av_fifo_can_read(dp->queue);
+    stats->bytes         = dp->bytes;
+    stats->duration      = queue_duration(dp);
+    stats->max_bytes     = dp->max_bytes;
+    stats->max_duration  = dp->max_duration;
+    stats->bytes_avg     = dp->nb_taken ? dp->bytes_sum / dp->nb_taken : 0;
+    stats->bytes_peak    = dp->bytes_peak;
+    stats->nb_underruns  = dp->nb_underruns;
+    stats->underrun_time = dp->underrun_time;
+    stats->nb_choked     = dp->nb_choked;
+
+    pthread_mutex_unlock(&dp->lock);
+}
+
+void dp_free(DemuxPrefetch **pdp)
+{
+    DemuxPrefetch *dp = *pdp;
+    PrefetchEntry e;
+
+    if (!dp)
+        return;
+
+    dp_stop(dp);
+
+    if (dp->queue) {
+        while (av_fifo_read(dp->queue, &e, 1) >= 0)
+            objpool_release(dp->pkt_pool, (void**)&e.pkt);
+        av_fifo_freep2(&dp->queue);
+    }
+    objpool_free(&dp->pkt_pool);
+
+    pthread_cond_destroy(&dp->cond_reader);
+    pthread_cond_destroy(&dp->cond_consumer);
+    pthread_mutex_destroy(&dp->lock);
+
+    av_freep(pdp);
+}
+
+int dp_alloc(DemuxPrefetch **pdp, size_t max_bytes, int64_t max_duration,
+             DemuxPrefetchRead read_cb, DemuxPrefetchChoked choked_cb,
+             void *opaque)
+{
+    DemuxPrefetch *dp;
+    int ret;
+
+    dp = av_mallocz(sizeof(*dp));
+    if (!dp)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&dp->lock, NULL);
+    if (ret) {
+        av_freep(&dp);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&dp->cond_consumer, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&dp->lock);
+        av_freep(&dp);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&dp->cond_reader, NULL);
+    if (ret) {
+        pthread_cond_destroy(&dp->cond_consumer);
+        pthread_mutex_destroy(&dp->lock);
+        av_freep(&dp);
+        return AVERROR(ret);
+    }
+
+    dp->read         = read_cb;
+    dp->choked       = choked_cb;
+    dp->opaque       = opaque;
+    dp->max_bytes    = max_bytes;
+    dp->max_duration = max_duration;
+    dp->ts_last      = AV_NOPTS_VALUE;
+
+    atomic_init(&dp->interrupt, 0);
+
+    dp->queue    = av_fifo_alloc2(64, sizeof(PrefetchEntry), AV_FIFO_FLAG_AUTO_GROW);
+    dp->pkt_pool = objpool_alloc_packets();
+    if (!dp->queue || !dp->pkt_pool) {
+        dp_free(&dp);
+        return AVERROR(ENOMEM);
+    }
+
+    *pdp = dp;
+
+    return 0;
+}
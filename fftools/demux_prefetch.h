@@ -0,0 +1,129 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_DEMUX_PREFETCH_H
+#define FFTOOLS_DEMUX_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavcodec/packet.h"
+
+/**
+ * Read-ahead thread for a demuxer. Packets are read on a separate thread into
+ * a queue limited by its total size in bytes and, optionally, by the
+ * difference between the timestamps of the newest and oldest queued packets.
+ *
+ * While the demuxer is choked by the scheduler, the reader does not read past
+ * the packets already queued, so read-ahead never lets an input that is ahead
+ * of the others run further ahead.
+ *
+ * When reading fails, the error is returned to the consumer after all the
+ * queued packets and the reader waits for dp_resume() before reading again,
+ * so that the demuxer may e.g. be seeked in between.
+ */
+typedef struct DemuxPrefetch DemuxPrefetch;
+
+/**
+ * Read the next packet, with pkt->time_base set. Called from the reader
+ * thread.
+ */
+typedef int (*DemuxPrefetchRead)(void *opaque, AVPacket *pkt);
+/**
+ * Return non-zero if the demuxer is choked. May be called from any thread.
+ */
+typedef int (*DemuxPrefetchChoked)(void *opaque);
+
+typedef struct DemuxPrefetchStats {
+    /**
+     * Packets currently queued: their number, total size and the difference
+     * between the newest and oldest timestamps (in AV_TIME_BASE units).
+     */
+    unsigned nb_packets;
+    uint64_t bytes;
+    int64_t  duration;
+    /**
+     * Queue limits, max_duration is 0 when unlimited.
+     */
+    uint64_t max_bytes;
+    int64_t  max_duration;
+    /**
+     * Average and peak number of bytes queued, sampled whenever a packet is
+     * taken from the queue.
+     */
+    uint64_t bytes_avg;
+    uint64_t bytes_peak;
+    /**
+     * Number of times and total time (in microseconds) the consumer waited,
+     * because the queue was empty.
+     */
+    uint64_t nb_underruns;
+    uint64_t underrun_time;
+    /**
+     * Number of times the reader waited, because the demuxer was choked.
+     */
+    uint64_t nb_choked;
+} DemuxPrefetchStats;
+
+/**
+ * @param max_bytes maximum total size of queued packets; a packet is always
+ *                  read when the queue is empty
+ * @param max_duration maximum difference between the timestamps of queued
+ *                     packets, in AV_TIME_BASE units; 0 for no limit
+ */
+int dp_alloc(DemuxPrefetch **dp, size_t max_bytes, int64_t max_duration,
+             DemuxPrefetchRead read_cb, DemuxPrefetchChoked choked_cb,
+             void *opaque);
+
+void dp_free(DemuxPrefetch **dp);
+
+/**
+ * Start the reader thread.
+ */
+int dp_start(DemuxPrefetch *dp);
+
+/**
+ * Stop the reader thread. Reading is interrupted, if the read callback checks
+ * dp_interrupted().
+ */
+void dp_stop(DemuxPrefetch *dp);
+
+/**
+ * @return non-zero while the reader thread is being stopped
+ */
+int dp_interrupted(DemuxPrefetch *dp);
+
+/**
+ * Get the next packet, waiting for the reader if necessary.
+ *
+ * @return 0 when a packet was returned, the error returned from the read
+ *         callback otherwise
+ */
+int dp_read(DemuxPrefetch *dp, AVPacket *pkt);
+
+/**
+ * Resume reading after dp_read() returned an error.
+ */
+void dp_resume(DemuxPrefetch *dp);
+
+/**
+ * Get the queue statistics. May be called from any thread.
+ */
+void dp_stats(DemuxPrefetch *dp, DemuxPrefetchStats *stats);
+
+#endif // FFTOOLS_DEMUX_PREFETCH_H
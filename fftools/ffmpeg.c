@@ -79,6 +79,7 @@
 
 #include "cmdutils.h"
 #include "ffmpeg.h"
+#include "ffmpeg_daemon.h"
 #include "ffmpeg_sched.h"
 #include "ffmpeg_utils.h"
 
@@ -100,6 +101,7 @@ atomic_uint nb_output_dumped = 0;
 
 static BenchmarkTimeStamps current_time;
 AVIOContext *progress_avio = NULL;
+AVIOContext *stats_json_avio = NULL;
 
 InputFile   **input_files   = NULL;
 int        nb_input_files   = 0;
@@ -140,6 +142,9 @@ static atomic_int transcode_init_done = 0;
 static volatile int ffmpeg_exited = 0;
 static int64_t copy_ts_first_pts = AV_NOPTS_VALUE;
 
+static int64_t report_last_time = -1;
+static int     report_first     = 1;
+
 static void
 sigterm_handler(int sig)
 {
@@ -332,21 +337,24 @@ static void ffmpeg_cleanup(int ret)
             av_log(NULL, AV_LOG_ERROR,
                    "Error closing vstats file, loss of information possible: %s\n",
                    av_err2str(AVERROR(errno)));
+        vstats_file = NULL;
     }
     av_freep(&vstats_filename);
     of_enc_stats_close();
 
+    avio_closep(&progress_avio);
+    avio_closep(&stats_json_avio);
+
     hw_device_free_all();
 
     av_freep(&filter_nbthreads);
 
     av_freep(&input_files);
     av_freep(&output_files);
+    nb_filtergraphs = nb_output_files = nb_input_files = nb_decoders = 0;
 
     uninit_opts();
 
-    avformat_network_deinit();
-
     if (received_sigterm) {
         av_log(NULL, AV_LOG_INFO, "Exiting normally, received signal %d.\n",
                (int) received_sigterm);
@@ -545,15 +553,185 @@ void update_benchmark(const char *fmt, ...)
     }
 }
 
-static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time, int64_t pts)
+static const char *const latency_stage_names[LATENCY_STAGE_NB] = {
+    [LATENCY_STAGE_DECODE] = "decode",
+    [LATENCY_STAGE_FILTER] = "filter",
+    [LATENCY_STAGE_ENCODE] = "encode",
+    [LATENCY_STAGE_MUX]    = "mux",
+    [LATENCY_STAGE_TOTAL]  = "total",
+};
+
+/*
+ * Add the per-stage latency statistics of the packets written since the
+ * previous report to the progress script and the JSON stats line.
+ */
+static void print_latency(AVBPrint *buf_script, AVBPrint *buf_json)
+{
+    int first_ost = 1, first_of = 1;
+
+    av_bprintf(buf_json, ",\"streams\":[");
+
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        if (!ost->latency[0])
+            continue;
+
+        av_bprintf(buf_json, "%s{\"file\":%d,\"index\":%d,\"type\":\"%s\","
+                   "\"packets\":%"PRIu64",\"latency\":{",
+                   first_ost ? "" : ",", ost->file->index, ost->index,
+                   av_get_media_type_string(ost->type),
+                   atomic_load(&ost->packets_written));
+        first_ost = 0;
+
+        for (int i = 0; i < LATENCY_STAGE_NB; i++) {
+            const char *name = latency_stage_names[i];
+            LatencyHistStats st;
+
+            latency_hist_stats(ost->latency[i], NULL, &st);
+
+            av_bprintf(buf_json, "%s\"%s\":{\"samples\":%"PRIu64,
+                       i ? "," : "", name, st.nb_samples);
+            if (st.nb_samples) {
+                av_bprintf(buf_script,
+                           "stream_%d_%d_latency_%s_p50_us=%"PRId64"\n"
+                           "stream_%d_%d_latency_%s_p99_us=%"PRId64"\n"
+                           "stream_%d_%d_latency_%s_max_us=%"PRId64"\n",
+                           ost->file->index, ost->index, name, st.p50,
+                           ost->file->index, ost->index, name, st.p99,
+                           ost->file->index, ost->index, name, st.max);
+                av_bprintf(buf_json, ",\"p50_us\":%"PRId64",\"p99_us\":%"PRId64
+                           ",\"max_us\":%"PRId64, st.p50, st.p99, st.max);
+            } else {
+                av_bprintf(buf_script,
+                           "stream_%d_%d_latency_%s_p50_us=N/A\n"
+                           "stream_%d_%d_latency_%s_p99_us=N/A\n"
+                           "stream_%d_%d_latency_%s_max_us=N/A\n",
+                           ost->file->index, ost->index, name,
+                           ost->file->index, ost->index, name,
+                           ost->file->index, ost->index, name);
+            }
+            av_bprintf(buf_json, "}");
+        }
+
+        av_bprintf(buf_json, "}}");
+    }
+
+    av_bprintf(buf_json, "],\"writers\":[");
+
+    for (int i = 0; i < nb_output_files; i++) {
+        AsyncWriterStats st;
+        LatencyHistStats lat;
+
+        if (!of_write_stats(output_files[i], &st, &lat))
+            continue;
+
+        av_bprintf(buf_script,
+                   "out_%d_write_bytes=%"PRIu64"\n"
+                   "out_%d_write_stalls=%"PRIu64"\n"
+                   "out_%d_write_stall_us=%"PRIu64"\n",
+                   i, st.bytes_written, i, st.nb_stalls, i, st.stall_time);
+        av_bprintf(buf_json, "%s{\"file\":%d,\"writes\":%"PRIu64
+                   ",\"bytes\":%"PRIu64",\"stalls\":%"PRIu64
+                   ",\"stall_us\":%"PRIu64",\"samples\":%"PRIu64,
+                   first_of ? "" : ",", i, st.nb_writes, st.bytes_written,
+                   st.nb_stalls, st.stall_time, lat.nb_samples);
+        first_of = 0;
+
+        if (lat.nb_samples) {
+            av_bprintf(buf_script,
+                       "out_%d_write_p50_us=%"PRId64"\n"
+                       "out_%d_write_p99_us=%"PRId64"\n"
+                       "out_%d_write_max_us=%"PRId64"\n",
+                       i, lat.p50, i, lat.p99, i, lat.max);
+            av_bprintf(buf_json, ",\"p50_us\":%"PRId64",\"p99_us\":%"PRId64
+                       ",\"max_us\":%"PRId64, lat.p50, lat.p99, lat.max);
+        } else {
+            av_bprintf(buf_script,
+                       "out_%d_write_p50_us=N/A\n"
+                       "out_%d_write_p99_us=N/A\n"
+                       "out_%d_write_max_us=N/A\n", i, i, i);
+        }
+        av_bprintf(buf_json, "}");
+    }
+
+    av_bprintf(buf_json, "]");
+}
+
+static void print_prefetch(AVBPrint *buf_script, AVBPrint *buf_json)
+{
+    int first = 1;
+
+    av_bprintf(buf_json, ",\"prefetch\":[");
+
+    for (int i = 0; i < nb_input_files; i++) {
+        DemuxPrefetchStats st;
+
+        if (!ifile_prefetch_stats(input_files[i], &st))
+            continue;
+
+        av_bprintf(buf_script,
+                   "in_%d_prefetch_bytes=%"PRIu64"\n"
+                   "in_%d_prefetch_fill=%.1f\n"
+                   "in_%d_prefetch_packets=%u\n"
+                   "in_%d_prefetch_duration_us=%"PRId64"\n"
+                   "in_%d_prefetch_underruns=%"PRIu64"\n",
+                   i, st.bytes, i, 100.0 * st.bytes / st.max_bytes,
+                   i, st.nb_packets, i, st.duration, i, st.nb_underruns);
+        av_bprintf(buf_json, "%s{\"file\":%d,\"bytes\":%"PRIu64
+                   ",\"max_bytes\":%"PRIu64",\"packets\":%u,\"duration_us\":%"PRId64
+                   ",\"underruns\":%"PRIu64",\"underrun_us\":%"PRIu64
+                   ",\"choked\":%"PRIu64"}",
+                   first ? "" : ",", i, st.bytes, st.max_bytes, st.nb_packets,
+                   st.duration, st.nb_underruns, st.underrun_time, st.nb_choked);
+        first = 0;
+    }
+
+    av_bprintf(buf_json, "]");
+}
+
+static void print_queues(Scheduler *sch, AVBPrint *buf_script, AVBPrint *buf_json)
+{
+    static const char * const node_names[] = {
+        [SCH_NODE_TYPE_DEC]       = "dec",
+        [SCH_NODE_TYPE_FILTER_IN] = "filter",
+        [SCH_NODE_TYPE_ENC]       = "enc",
+        [SCH_NODE_TYPE_MUX]       = "mux",
+    };
+    ThreadQueueStats st;
+    SchedulerNode node;
+    int first = 1;
+
+    av_bprintf(buf_json, ",\"queues\":[");
+
+    for (unsigned i = 0; !sch_queue_stats(sch, i, &node, &st); i++) {
+        const char *name = node_names[node.type];
+
+        // only the adaptive queues change depth
+        if (st.depth_min == st.depth_max)
+            continue;
+
+        av_bprintf(buf_script,
+                   "queue_%s_%u_depth=%u\n"
+                   "queue_%s_%u_resizes=%"PRIu64"\n",
+                   name, node.idx, st.depth, name, node.idx, st.nb_resizes);
+        av_bprintf(buf_json, "%s{\"node\":\"%s\",\"index\":%u,\"depth\":%u"
+                   ",\"depth_min\":%u,\"depth_max\":%u,\"resizes\":%"PRIu64
+                   ",\"send_stall_us\":%"PRIu64",\"recv_stall_us\":%"PRIu64"}",
+                   first ? "" : ",", name, node.idx, st.depth, st.depth_min,
+                   st.depth_max, st.nb_resizes, st.send_stall, st.recv_stall);
+        first = 0;
+    }
+
+    av_bprintf(buf_json, "]");
+}
+
+static void print_report(Scheduler *sch, int is_last_report,
+                         int64_t timer_start, int64_t cur_time, int64_t pts)
 {
-    AVBPrint buf, buf_script;
+    AVBPrint buf, buf_script, buf_json;
     int64_t total_size = of_filesize(output_files[0]);
     int vid;
     double bitrate;
     double speed;
-    static int64_t last_time = -1;
-    static int first_report = 1;
     uint64_t nb_frames_dup = 0, nb_frames_drop = 0;
     int mins, secs, us;
     int64_t hours;
@@ -561,24 +739,25 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int ret;
     float t;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!print_stats && !is_last_report && !progress_avio && !stats_json_avio)
         return;
 
     if (!is_last_report) {
-        if (last_time == -1) {
-            last_time = cur_time;
+        if (report_last_time == -1) {
+            report_last_time = cur_time;
         }
-        if (((cur_time - last_time) < stats_period && !first_report) ||
-            (first_report && atomic_load(&nb_output_dumped) < nb_output_files))
+        if (((cur_time - report_last_time) < stats_period && !report_first) ||
+            (report_first && atomic_load(&nb_output_dumped) < nb_output_files))
             return;
-        last_time = cur_time;
+        report_last_time = cur_time;
     }
 
     t = (cur_time-timer_start) / 1000000.0;
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
-    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&buf_json, 0, AV_BPRINT_SIZE_UNLIMITED);
     for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
         const float q = ost->enc ? atomic_load(&ost->quality) / (float) FF_QP2LAMBDA : -1;
 
@@ -685,6 +864,22 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf_script, "speed=%4.3gx\n", speed);
     }
 
+    av_bprintf(&buf_json, "{\"time\":%.3f,\"out_time_us\":", t);
+    if (pts == AV_NOPTS_VALUE) av_bprintf(&buf_json, "null");
+    else                       av_bprintf(&buf_json, "%"PRId64, pts);
+    av_bprintf(&buf_json, ",\"total_size\":%"PRId64",\"speed\":", total_size);
+    if (speed < 0) av_bprintf(&buf_json, "null");
+    else           av_bprintf(&buf_json, "%.3f", speed);
+
+    if (progress_avio || stats_json_avio) {
+        print_latency(&buf_script, &buf_json);
+        print_prefetch(&buf_script, &buf_json);
+        print_queues(sch, &buf_script, &buf_json);
+    }
+
+    av_bprintf(&buf_json, ",\"progress\":\"%s\"}\n",
+               is_last_report ? "end" : "continue");
+
     if (print_stats || is_last_report) {
         const char end = is_last_report ? '\n' : '\r';
         if (print_stats==1 && AV_LOG_INFO > av_log_get_level()) {
@@ -702,7 +897,6 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         avio_write(progress_avio, buf_script.str,
                    FFMIN(buf_script.len, buf_script.size - 1));
         avio_flush(progress_avio);
-        av_bprint_finalize(&buf_script, NULL);
         if (is_last_report) {
             if ((ret = avio_closep(&progress_avio)) < 0)
                 av_log(NULL, AV_LOG_ERROR,
@@ -710,7 +904,19 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
-    first_report = 0;
+    if (stats_json_avio) {
+        avio_write(stats_json_avio, buf_json.str, buf_json.len);
+        avio_flush(stats_json_avio);
+        if (is_last_report) {
+            if ((ret = avio_closep(&stats_json_avio)) < 0)
+                av_log(NULL, AV_LOG_ERROR,
+                       "Error closing JSON stats log, loss of information possible: %s\n", av_err2str(ret));
+        }
+    }
+    av_bprint_finalize(&buf_script, NULL);
+    av_bprint_finalize(&buf_json, NULL);
+
+    report_first = 0;
 }
 
 static void print_stream_maps(void)
@@ -896,7 +1102,7 @@ static int transcode(Scheduler *sch)
                 break;
 
         /* dump report by using the output first video and audio streams */
-        print_report(0, timer_start, cur_time, transcode_ts);
+        print_report(sch, 0, timer_start, cur_time, transcode_ts);
     }
 
     ret = sch_stop(sch, &transcode_ts);
@@ -910,7 +1116,7 @@ static int transcode(Scheduler *sch)
     term_exit();
 
     /* dump report by using the first video and audio streams */
-    print_report(1, timer_start, av_gettime_relative(), transcode_ts);
+    print_report(sch, 1, timer_start, av_gettime_relative(), transcode_ts);
 
     return ret;
 }
@@ -959,27 +1165,13 @@ static int64_t getmaxrss(void)
 #endif
 }
 
-int main(int argc, char **argv)
+static int run_job(int argc, char **argv)
 {
     Scheduler *sch = NULL;
 
     int ret;
     BenchmarkTimeStamps ti;
 
-    init_dynload();
-
-    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
-
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
-    parse_loglevel(argc, argv, options);
-
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avformat_network_init();
-
-    show_banner(argc, argv, options);
-
     sch = sch_alloc();
     if (!sch) {
         ret = AVERROR(ENOMEM);
@@ -1030,3 +1222,104 @@ finish:
 
     return ret;
 }
+
+/* restore the state a previous job may have changed */
+static void reset_job_state(void)
+{
+    reset_global_options();
+
+    atomic_store(&nb_output_dumped, 0);
+    atomic_store(&transcode_init_done, 0);
+    ffmpeg_exited     = 0;
+    copy_ts_first_pts = AV_NOPTS_VALUE;
+    report_last_time  = -1;
+    report_first      = 1;
+}
+
+static int run_daemon(const char *path)
+{
+    Daemon *d = NULL;
+    int ret;
+
+    ret = daemon_open(&d, path);
+    if (ret < 0)
+        return 1;
+
+    daemon_mode       = 1;
+    stdin_interaction = 0;
+    hw_device_set_reuse(1);
+    term_init();
+
+    av_log(NULL, AV_LOG_INFO, "Waiting for jobs on %s\n", path);
+
+    while (!received_nb_signals) {
+        DaemonJob *job = NULL;
+        int log_level, log_flags, status;
+        int64_t elapsed;
+
+        ret = daemon_accept(d, &job, 100);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error accepting daemon job: %s\n",
+                   av_err2str(ret));
+            break;
+        }
+        if (!ret)
+            continue;
+
+        av_log(NULL, AV_LOG_VERBOSE, "Starting job with %d arguments\n",
+               job->argc - 1);
+
+        log_level = av_log_get_level();
+        log_flags = av_log_get_flags();
+
+        reset_job_state();
+        daemon_job_log_start(job);
+
+        // the status the job would exit with when run as a process
+        status = run_job(job->argc, job->argv) & 0xff;
+
+        av_log_set_level(log_level);
+        av_log_set_flags(log_flags);
+
+        elapsed = av_gettime_relative() - job->received;
+        daemon_job_finish(&job, status);
+
+        av_log(NULL, AV_LOG_VERBOSE, "Job finished with status %d in %.3fs\n",
+               status, elapsed / 1000000.0);
+    }
+
+    hw_device_set_reuse(0);
+    daemon_close(&d);
+    term_exit();
+
+    return ret < 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret, idx;
+
+    init_dynload();
+
+    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
+
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    parse_loglevel(argc, argv, options);
+
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avformat_network_init();
+
+    show_banner(argc, argv, options);
+
+    idx = locate_option(argc, argv, options, "daemon");
+    if (idx && idx + 1 < argc)
+        ret = run_daemon(argv[idx + 1]);
+    else
+        ret = run_job(argc, argv);
+
+    avformat_network_deinit();
+
+    return ret;
+}
@@ -28,6 +28,9 @@
 
 #include "cmdutils.h"
 #include "ffmpeg_sched.h"
+#include "async_writer.h"
+#include "demux_prefetch.h"
+#include "latency_hist.h"
 #include "sync_queue.h"
 
 #include "libavformat/avformat.h"
@@ -107,10 +110,28 @@ enum LatencyProbe {
     LATENCY_PROBE_NB,
 };
 
+/**
+ * Processing stages for which per-output-stream latency statistics are
+ * gathered. Each stage covers the time since the previous stage's output,
+ * e.g. LATENCY_STAGE_ENCODE spans from the filtergraph output to the encoder
+ * output; stages a packet did not go through are merged into the next one.
+ */
+enum LatencyStage {
+    LATENCY_STAGE_DECODE,
+    LATENCY_STAGE_FILTER,
+    LATENCY_STAGE_ENCODE,
+    LATENCY_STAGE_MUX,
+    // from demuxing to muxing
+    LATENCY_STAGE_TOTAL,
+    LATENCY_STAGE_NB,
+};
+
 typedef struct HWDevice {
     const char *name;
     enum AVHWDeviceType type;
     AVBufferRef *device_ref;
+    // specification the device was created from, set when it may be reused
+    char *spec;
 } HWDevice;
 
 enum ViewSpecifierType {
@@ -165,6 +186,8 @@ typedef struct OptionsContext {
     int rate_emu;
     float readrate;
     double readrate_initial_burst;
+    int64_t prefetch_size;
+    int64_t prefetch_duration;
     int accurate_seek;
     int thread_queue_size;
     // NETINT: add option for force nidec
@@ -191,6 +214,8 @@ typedef struct OptionsContext {
     int64_t recording_time;
     int64_t stop_time;
     int64_t limit_filesize;
+    int64_t async_write_size;
+    int64_t async_write_buffer;
     float mux_preload;
     float mux_max_delay;
     float shortest_buf_duration;
@@ -651,6 +676,10 @@ typedef struct OutputStream {
     /* packet quality factor */
     atomic_int quality;
 
+    // latency of the packets written to the muxer, per stage;
+    // updated by the muxer thread
+    LatencyHist *latency[LATENCY_STAGE_NB];
+
     EncStats enc_stats_pre;
     EncStats enc_stats_post;
 
@@ -739,6 +768,7 @@ extern int print_stats;
 extern int64_t stats_period;
 extern int stdin_interaction;
 extern AVIOContext *progress_avio;
+extern AVIOContext *stats_json_avio;
 extern float max_error_rate;
 
 extern char *filter_nbthreads;
@@ -758,6 +788,9 @@ extern int copy_unknown_streams;
 
 extern int recast_media;
 
+/* set when jobs are received over a socket rather than the command line */
+extern int daemon_mode;
+
 extern FILE *vstats_file;
 
 void term_init(void);
@@ -809,6 +842,10 @@ void fg_send_command(FilterGraph *fg, double time, const char *target,
                      const char *command, const char *arg, int all_filters);
 
 int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch);
+/**
+ * Restore all the global options to their default values.
+ */
+void reset_global_options(void);
 
 void enc_stats_write(OutputStream *ost, EncStats *es,
                      const AVFrame *frame, const AVPacket *pkt,
@@ -825,6 +862,13 @@ int hw_device_init_from_type(enum AVHWDeviceType type,
                              const char *device,
                              HWDevice **dev_out);
 void hw_device_free_all(void);
+/**
+ * When enabled, hw_device_free_all() keeps the devices that were not derived
+ * from other devices, and creating a device with the same specification later
+ * reuses the kept one instead of opening the device again. Disabling reuse
+ * frees the kept devices.
+ */
+void hw_device_set_reuse(int reuse);
 
 /**
  * Get a hardware device to be used with this filtergraph.
@@ -896,9 +940,25 @@ void of_enc_stats_close(void);
 
 int64_t of_filesize(OutputFile *of);
 
+/**
+ * Get the statistics of the asynchronous output writer, with the write latency
+ * over the interval since the previous call.
+ *
+ * @return 1 if the writer is enabled for this file, 0 otherwise
+ */
+int of_write_stats(OutputFile *of, AsyncWriterStats *stats,
+                   LatencyHistStats *interval);
+
 int ifile_open(const OptionsContext *o, const char *filename, Scheduler *sch);
 void ifile_close(InputFile **f);
 
+/**
+ * Get the statistics of the input read-ahead queue.
+ *
+ * @return 1 if read-ahead is enabled for this file, 0 otherwise
+ */
+int ifile_prefetch_stats(InputFile *f, DemuxPrefetchStats *stats);
+
 int ist_output_add(InputStream *ist, OutputStream *ost);
 int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple,
                    const ViewSpecifier *vs, InputFilterOptions *opts,
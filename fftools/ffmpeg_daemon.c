@@ -0,0 +1,392 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if HAVE_SYS_UN_H && HAVE_POLL_H && HAVE_UNISTD_H
+#define DAEMON_SUPPORTED 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define DAEMON_SUPPORTED 0
+#endif
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ffmpeg_daemon.h"
+
+// limits on the size of a job request
+#define MAX_REQUEST_SIZE    (1 << 20)
+#define MAX_ARGS            4096
+// maximum time a client may take to send its whole request, from the
+// connection being accepted, in milliseconds
+#define REQUEST_TIMEOUT     5000
+
+struct Daemon {
+    char *path;
+    int   fd;
+};
+
+#if DAEMON_SUPPORTED
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+static AVMutex log_lock = AV_MUTEX_INITIALIZER;
+static int     log_fd   = -1;
+static int     log_print_prefix = 1;
+
+static void send_all(int fd, const char *buf, size_t size)
+{
+    while (size > 0) {
+        ssize_t ret = send(fd, buf, size, SEND_FLAGS);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        // the client went away, the job still runs to completion
+        if (ret <= 0)
+            return;
+        buf  += ret;
+        size -= ret;
+    }
+}
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    char line[1024];
+
+    if ((level & 0xff) > av_log_get_level())
+        return;
+
+    ff_mutex_lock(&log_lock);
+
+    av_log_format_line2(avcl, level & 0xff, fmt, vl, line, sizeof(line),
+                        &log_print_prefix);
+    if (log_fd >= 0)
+        send_all(log_fd, line, strlen(line));
+
+    ff_mutex_unlock(&log_lock);
+}
+
+int daemon_open(Daemon **pd, const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    mode_t mask;
+    Daemon *d;
+    int ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        av_log(NULL, AV_LOG_ERROR, "Daemon socket path too long: %s\n", path);
+        return AVERROR(EINVAL);
+    }
+    strcpy(addr.sun_path, path);
+
+    d = av_mallocz(sizeof(*d));
+    if (!d)
+        return AVERROR(ENOMEM);
+    d->fd = -1;
+
+    d->path = av_strdup(path);
+    if (!d->path) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    d->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (d->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail_listen;
+    }
+
+    // replace a stale socket left over by a previous daemon, but never the
+    // socket of one that is still running
+    if (!stat(path, &st) && S_ISSOCK(st.st_mode)) {
+        if (!connect(d->fd, (struct sockaddr*)&addr, sizeof(addr))) {
+            av_log(NULL, AV_LOG_ERROR, "Another daemon is listening on %s\n",
+                   path);
+            ret = AVERROR(EADDRINUSE);
+            goto fail;
+        }
+        close(d->fd);
+        unlink(path);
+
+        d->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (d->fd < 0) {
+            ret = AVERROR(errno);
+            goto fail_listen;
+        }
+    }
+
+    // anyone able to connect can run jobs with the rights of the daemon, so
+    // create the socket accessible to its owner only
+    mask = umask(0077);
+    ret  = bind(d->fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    if (ret < 0 || listen(d->fd, 64) < 0) {
+        ret = AVERROR(errno);
+        goto fail_listen;
+    }
+
+    *pd = d;
+
+    return 0;
+fail_listen:
+    av_log(NULL, AV_LOG_ERROR, "Error listening on daemon socket %s: %s\n",
+           path, av_err2str(ret));
+fail:
+    if (d->fd >= 0)
+        close(d->fd);
+    av_freep(&d->path);
+    av_freep(&d);
+    return ret;
+}
+
+void daemon_close(Daemon **pd)
+{
+    Daemon *d = *pd;
+
+    if (!d)
+        return;
+
+    close(d->fd);
+    unlink(d->path);
+
+    av_freep(&d->path);
+    av_freep(pd);
+}
+
+static void job_free(DaemonJob **pjob)
+{
+    DaemonJob *job = *pjob;
+
+    if (!job)
+        return;
+
+    if (job->fd >= 0)
+        close(job->fd);
+    // all the arguments point into a single buffer
+    if (job->argv)
+        av_freep(&job->argv[0]);
+    av_freep(&job->argv);
+
+    av_freep(pjob);
+}
+
+static int read_request(DaemonJob *job)
+{
+    const int64_t deadline = job->received + REQUEST_TIMEOUT * 1000LL;
+    char  *buf = NULL;
+    size_t size = 0, alloc = 0;
+    int ret;
+
+    // the request ends with an empty string, i.e. two consecutive NULs
+    while (size < 2 || buf[size - 1] || buf[size - 2]) {
+        struct pollfd p = { .fd = job->fd, .events = POLLIN };
+        int64_t remaining = deadline - av_gettime_relative();
+        ssize_t len;
+
+        // the whole request must arrive in time, not each part of it
+        if (remaining <= 0) {
+            ret = AVERROR(ETIMEDOUT);
+            goto fail;
+        }
+
+        ret = poll(&p, 1, (remaining + 999) / 1000);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0) {
+            ret = ret < 0 ? AVERROR(errno) : AVERROR(ETIMEDOUT);
+            goto fail;
+        }
+
+        if (size + 4096 > alloc) {
+            if (alloc >= MAX_REQUEST_SIZE) {
+                ret = AVERROR(E2BIG);
+                goto fail;
+            }
+            // leave room for prepending the program name
+            ret = av_reallocp(&buf, alloc + 4096 + 7);
+            if (ret < 0)
+                goto fail;
+            alloc += 4096;
+        }
+
+        len = recv(job->fd, buf + size, alloc - size, 0);
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0) {
+            ret = len < 0 ? AVERROR(errno) :
+                  size    ? AVERROR_INVALIDDATA : AVERROR_EOF;
+            goto fail;
+        }
+        size += len;
+
+        // an empty command line
+        if (size == 1 && !buf[0])
+            break;
+    }
+
+    // count the arguments; the program name is added in front
+    job->argc = 1;
+    for (size_t i = 0; i < size && buf[i]; i += strlen(buf + i) + 1)
+        job->argc++;
+    if (job->argc > MAX_ARGS) {
+        ret = AVERROR(E2BIG);
+        goto fail;
+    }
+
+    job->argv = av_calloc(job->argc + 1, sizeof(*job->argv));
+    if (!job->argv) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    memmove(buf + 7, buf, size);
+    memcpy(buf, "ffmpeg", 7);
+    job->argv[0] = buf;
+    for (int i = 1, pos = 7; i < job->argc; i++) {
+        job->argv[i] = buf + pos;
+        pos += strlen(buf + pos) + 1;
+    }
+
+    return 0;
+fail:
+    av_freep(&buf);
+    return ret;
+}
+
+int daemon_accept(Daemon *d, DaemonJob **pjob, int timeout_ms)
+{
+    struct pollfd p = { .fd = d->fd, .events = POLLIN };
+    DaemonJob *job;
+    int fd, ret;
+
+    ret = poll(&p, 1, timeout_ms);
+    if (ret < 0)
+        return errno == EINTR ? 0 : AVERROR(errno);
+    if (!ret)
+        return 0;
+
+    fd = accept(d->fd, NULL, NULL);
+    if (fd < 0)
+        return (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) ?
+               0 : AVERROR(errno);
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        close(fd);
+        return AVERROR(ENOMEM);
+    }
+    job->fd       = fd;
+    job->received = av_gettime_relative();
+
+    ret = read_request(job);
+    // a connection closed without sending anything, e.g. to check that the
+    // daemon is running
+    if (ret == AVERROR_EOF) {
+        job_free(&job);
+        return 0;
+    }
+    if (ret < 0) {
+        char msg[128];
+
+        av_log(NULL, AV_LOG_ERROR, "Error reading daemon job: %s\n",
+               av_err2str(ret));
+
+        snprintf(msg, sizeof(msg), "Invalid job request: %s\n", av_err2str(ret));
+        send_all(job->fd, msg, strlen(msg));
+        daemon_job_finish(&job, 1);
+        return 0;
+    }
+
+    *pjob = job;
+    return 1;
+}
+
+void daemon_job_log_start(DaemonJob *job)
+{
+    ff_mutex_lock(&log_lock);
+    log_fd           = job->fd;
+    log_print_prefix = 1;
+    ff_mutex_unlock(&log_lock);
+
+    av_log_set_callback(log_callback);
+}
+
+void daemon_job_finish(DaemonJob **pjob, int status)
+{
+    DaemonJob *job = *pjob;
+    char buf[16];
+    int len;
+
+    if (!job)
+        return;
+
+    av_log_set_callback(av_log_default_callback);
+
+    ff_mutex_lock(&log_lock);
+    log_fd = -1;
+    ff_mutex_unlock(&log_lock);
+
+    len = snprintf(buf, sizeof(buf), "%c%d", 0, status);
+    send_all(job->fd, buf, len);
+
+    job_free(pjob);
+}
+
+#else
+
+int daemon_open(Daemon **d, const char *path)
+{
+    av_log(NULL, AV_LOG_ERROR, "Daemon mode is not supported on this platform\n");
+    return AVERROR(ENOSYS);
+}
+
+void daemon_close(Daemon **d)
+{
+}
+
+int daemon_accept(Daemon *d, DaemonJob **job, int timeout_ms)
+{
+    return AVERROR(ENOSYS);
+}
+
+void daemon_job_log_start(DaemonJob *job)
+{
+}
+
+void daemon_job_finish(DaemonJob **job, int status)
+{
+}
+
+#endif
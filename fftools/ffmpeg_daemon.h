@@ -0,0 +1,83 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_FFMPEG_DAEMON_H
+#define FFTOOLS_FFMPEG_DAEMON_H
+
+#include <stdint.h>
+
+/**
+ * Local socket on which a long-running ffmpeg process accepts jobs.
+ *
+ * A client connects to the UNIX stream socket and sends the job command line
+ * (without the program name) as a sequence of NUL-terminated strings, followed
+ * by an empty string. The daemon sends back the log output of the job,
+ * followed by a NUL byte and the exit status of the job in decimal, then
+ * closes the connection. Jobs are run one at a time, in the order they are
+ * received.
+ */
+typedef struct Daemon Daemon;
+
+typedef struct DaemonJob {
+    /**
+     * Job command line, argv[0] is the program name.
+     */
+    int     argc;
+    char  **argv;
+
+    /**
+     * Time the job was received, in av_gettime_relative() units.
+     */
+    int64_t received;
+
+    // the client connection
+    int     fd;
+} DaemonJob;
+
+/**
+ * Create the socket and start listening on it. An existing socket at path is
+ * replaced.
+ */
+int daemon_open(Daemon **d, const char *path);
+
+/**
+ * Stop listening and remove the socket.
+ */
+void daemon_close(Daemon **d);
+
+/**
+ * Wait for a job to be received.
+ *
+ * @param timeout_ms maximum time to wait, in milliseconds
+ * @return 1 when a job was received, 0 when none was received within the
+ *         timeout, a negative error code on failure
+ */
+int daemon_accept(Daemon *d, DaemonJob **job, int timeout_ms);
+
+/**
+ * Send the log output of the calling process to the job client, until
+ * daemon_job_finish() is called.
+ */
+void daemon_job_log_start(DaemonJob *job);
+
+/**
+ * Send the exit status of the job to the client and free the job.
+ */
+void daemon_job_finish(DaemonJob **job, int status);
+
+#endif // FFTOOLS_FFMPEG_DAEMON_H
@@ -1044,6 +1044,7 @@ static int decoder_thread(void *arg)
 finish:
     if (dp->dec_ctx && dp->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
         ff_free_ni_scte35_decoder(scte35_decoder);
+        scte35_decoder = NULL;
     }
 
     dec_thread_uninit(&dt);
@@ -1639,7 +1640,7 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
         // called after avcodec_open2() because the user-set value of
         // extra_hw_frames becomes valid in there, and we need to add
         // this on top of it.
-        int extra_frames = DEFAULT_FRAME_THREAD_QUEUE_SIZE;
+        int extra_frames = sch_frame_queue_size_max(dp->sch);
         if (dp->dec_ctx->extra_hw_frames >= 0)
             dp->dec_ctx->extra_hw_frames += extra_frames;
         else
@@ -19,6 +19,7 @@
 #include <float.h>
 #include <stdint.h>
 
+#include "demux_prefetch.h"
 #include "ffmpeg.h"
 #include "ffmpeg_sched.h"
 #include "ffmpeg_utils.h"
@@ -131,6 +132,9 @@ typedef struct Demuxer {
 
     Scheduler            *sch;
 
+    // reads packets ahead on a separate thread, when enabled
+    DemuxPrefetch        *prefetch;
+
     AVPacket             *pkt_heartbeat;
 
     int                   read_started;
@@ -141,8 +145,8 @@ typedef struct Demuxer {
 typedef struct DemuxThreadContext {
     // packet used for reading from the demuxer
     AVPacket *pkt_demux;
-    // packet for reading from BSFs
-    AVPacket *pkt_bsf;
+    // packets for reading from BSFs, sent downstream in batches
+    AVPacket *pkt_bsf[SCH_SEND_BATCH_MAX];
 } DemuxThreadContext;
 
 static DemuxStream *ds_from_ist(InputStream *ist)
@@ -511,16 +515,18 @@ static void readrate_sleep(Demuxer *d)
     }
 }
 
-static int do_send(Demuxer *d, DemuxStream *ds, AVPacket *pkt, unsigned flags,
-                   const char *pkt_desc)
+static int do_send(Demuxer *d, DemuxStream *ds, AVPacket **pkts, unsigned nb_pkts,
+                   unsigned flags, const char *pkt_desc)
 {
     int ret;
 
-    pkt->stream_index = ds->sch_idx_stream;
+    for (unsigned i = 0; i < nb_pkts; i++)
+        pkts[i]->stream_index = ds->sch_idx_stream;
 
-    ret = sch_demux_send(d->sch, d->f.index, pkt, flags);
+    ret = sch_demux_send_batch(d->sch, d->f.index, pkts, nb_pkts, flags);
     if (ret == AVERROR_EOF) {
-        av_packet_unref(pkt);
+        for (unsigned i = 0; i < nb_pkts; i++)
+            av_packet_unref(pkts[i]);
 
         av_log(ds, AV_LOG_VERBOSE, "All consumers of this stream are done\n");
         ds->finished = 1;
@@ -561,13 +567,15 @@ static int demux_send(Demuxer *d, DemuxThreadContext *dt, DemuxStream *ds,
             d->pkt_heartbeat->time_base    = pkt->time_base;
             d->pkt_heartbeat->opaque       = (void*)(intptr_t)PKT_OPAQUE_SUB_HEARTBEAT;
 
-            ret = do_send(d, ds1, d->pkt_heartbeat, 0, "heartbeat");
+            ret = do_send(d, ds1, &d->pkt_heartbeat, 1, 0, "heartbeat");
             if (ret < 0)
                 return ret;
         }
     }
 
     if (ds->bsf) {
+        unsigned nb_bsf = 0;
+
         if (pkt)
             av_packet_rescale_ts(pkt, pkt->time_base, ds->bsf->time_base_in);
 
@@ -580,28 +588,36 @@ static int demux_send(Demuxer *d, DemuxThreadContext *dt, DemuxStream *ds,
             return ret;
         }
 
+        // collect all the packets the filters output for this input packet,
+        // so they are sent downstream in a single batch
         while (1) {
-            ret = av_bsf_receive_packet(ds->bsf, dt->pkt_bsf);
-            if (ret == AVERROR(EAGAIN))
-                return 0;
-            else if (ret < 0) {
-                if (ret != AVERROR_EOF)
-                    av_log(ds, AV_LOG_ERROR,
-                           "Error applying bitstream filters to a packet: %s\n",
-                           av_err2str(ret));
-                return ret;
-            }
+            ret = av_bsf_receive_packet(ds->bsf, dt->pkt_bsf[nb_bsf]);
+            if (ret >= 0) {
+                dt->pkt_bsf[nb_bsf]->time_base = ds->bsf->time_base_out;
+                if (++nb_bsf < FF_ARRAY_ELEMS(dt->pkt_bsf))
+                    continue;
+            } else if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+                av_log(ds, AV_LOG_ERROR,
+                       "Error applying bitstream filters to a packet: %s\n",
+                       av_err2str(ret));
 
-            dt->pkt_bsf->time_base = ds->bsf->time_base_out;
+            if (nb_bsf) {
+                int err = do_send(d, ds, dt->pkt_bsf, nb_bsf, 0, "filtered");
+                if (err < 0) {
+                    for (unsigned i = 0; i < nb_bsf; i++)
+                        av_packet_unref(dt->pkt_bsf[i]);
+                    return err;
+                }
+                nb_bsf = 0;
+            }
 
-            ret = do_send(d, ds, dt->pkt_bsf, 0, "filtered");
-            if (ret < 0) {
-                av_packet_unref(dt->pkt_bsf);
+            if (ret == AVERROR(EAGAIN))
+                return 0;
+            else if (ret < 0)
                 return ret;
-            }
         }
     } else {
-        ret = do_send(d, ds, pkt, flags, "demuxed");
+        ret = do_send(d, ds, &pkt, 1, flags, "demuxed");
         if (ret < 0)
             return ret;
     }
@@ -662,7 +678,8 @@ static void thread_set_name(InputFile *f)
 static void demux_thread_uninit(DemuxThreadContext *dt)
 {
     av_packet_free(&dt->pkt_demux);
-    av_packet_free(&dt->pkt_bsf);
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(dt->pkt_bsf); i++)
+        av_packet_free(&dt->pkt_bsf[i]);
 
     memset(dt, 0, sizeof(*dt));
 }
@@ -675,13 +692,67 @@ static int demux_thread_init(DemuxThreadContext *dt)
     if (!dt->pkt_demux)
         return AVERROR(ENOMEM);
 
-    dt->pkt_bsf = av_packet_alloc();
-    if (!dt->pkt_bsf)
-        return AVERROR(ENOMEM);
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(dt->pkt_bsf); i++) {
+        dt->pkt_bsf[i] = av_packet_alloc();
+        if (!dt->pkt_bsf[i])
+            return AVERROR(ENOMEM);
+    }
 
     return 0;
 }
 
+// read the next packet from the demuxer, skipping packets of streams that
+// appeared after the input was opened
+static int read_packet(void *arg, AVPacket *pkt)
+{
+    Demuxer   *d = arg;
+    InputFile *f = &d->f;
+
+    while (1) {
+        int ret = av_read_frame(f->ctx, pkt);
+
+        if (ret == AVERROR(EAGAIN)) {
+            av_usleep(10000);
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+
+        if (do_pkt_dump) {
+            av_pkt_dump_log2(NULL, AV_LOG_INFO, pkt, do_hex_dump,
+                             f->ctx->streams[pkt->stream_index]);
+        }
+
+        /* the following test is needed in case new streams appear
+           dynamically in stream : we ignore them */
+        if (pkt->stream_index >= f->nb_streams) {
+            report_new_stream(d, pkt);
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        pkt->time_base = f->streams[pkt->stream_index]->st->time_base;
+
+        return 0;
+    }
+}
+
+static int prefetch_choked(void *arg)
+{
+    Demuxer *d = arg;
+    return sch_demux_choked(d->sch, d->f.index);
+}
+
+static int demux_interrupt_cb(void *arg)
+{
+    Demuxer *d = arg;
+
+    if (d->prefetch && dp_interrupted(d->prefetch))
+        return 1;
+
+    return int_cb.callback(int_cb.opaque);
+}
+
 static int input_thread(void *arg)
 {
     Demuxer   *d = arg;
@@ -702,16 +773,18 @@ static int input_thread(void *arg)
     d->read_started    = 1;
     d->wallclock_start = av_gettime_relative();
 
+    if (d->prefetch) {
+        ret = dp_start(d->prefetch);
+        if (ret < 0)
+            goto finish;
+    }
+
     while (1) {
         DemuxStream *ds;
         unsigned send_flags = 0;
 
-        ret = av_read_frame(f->ctx, dt.pkt_demux);
-
-        if (ret == AVERROR(EAGAIN)) {
-            av_usleep(10000);
-            continue;
-        }
+        ret = d->prefetch ? dp_read(d->prefetch, dt.pkt_demux) :
+                            read_packet(d, dt.pkt_demux);
         if (ret < 0) {
             int ret_bsf;
 
@@ -733,8 +806,11 @@ static int input_thread(void *arg)
                 if (ret >= 0)
                     ret = seek_to_start(d, (Timestamp){ .ts = dt.pkt_demux->pts,
                                                         .tb = dt.pkt_demux->time_base });
-                if (ret >= 0)
+                if (ret >= 0) {
+                    if (d->prefetch)
+                        dp_resume(d->prefetch);
                     continue;
+                }
 
                 /* fallthrough to the error path */
             }
@@ -742,17 +818,8 @@ static int input_thread(void *arg)
             break;
         }
 
-        if (do_pkt_dump) {
-            av_pkt_dump_log2(NULL, AV_LOG_INFO, dt.pkt_demux, do_hex_dump,
-                             f->ctx->streams[dt.pkt_demux->stream_index]);
-        }
-
-        /* the following test is needed in case new streams appear
-           dynamically in stream : we ignore them */
-        ds = dt.pkt_demux->stream_index < f->nb_streams ?
-             ds_from_ist(f->streams[dt.pkt_demux->stream_index]) : NULL;
-        if (!ds || ds->discard || ds->finished) {
-            report_new_stream(d, dt.pkt_demux);
+        ds = ds_from_ist(f->streams[dt.pkt_demux->stream_index]);
+        if (ds->discard || ds->finished) {
             av_packet_unref(dt.pkt_demux);
             continue;
         }
@@ -785,6 +852,9 @@ static int input_thread(void *arg)
         ret = 0;
 
 finish:
+    if (d->prefetch)
+        dp_stop(d->prefetch);
+
     demux_thread_uninit(&dt);
 
     return ret;
@@ -828,6 +898,17 @@ static void demux_final_stats(Demuxer *d)
 
     av_log(f, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) demuxed\n",
            total_packets, total_size);
+
+    if (d->prefetch) {
+        DemuxPrefetchStats st;
+
+        dp_stats(d->prefetch, &st);
+        av_log(f, AV_LOG_VERBOSE, "  Prefetch: average fill %"PRIu64" bytes "
+               "(%.1f%%), peak %"PRIu64" bytes; %"PRIu64" underruns (%.3fs); "
+               "%"PRIu64" choked waits\n",
+               st.bytes_avg, 100.0 * st.bytes_avg / st.max_bytes, st.bytes_peak,
+               st.nb_underruns, st.underrun_time / 1e6, st.nb_choked);
+    }
 }
 
 static void ist_free(InputStream **pist)
@@ -872,11 +953,24 @@ void ifile_close(InputFile **pf)
 
     avformat_close_input(&f->ctx);
 
+    dp_free(&d->prefetch);
+
     av_packet_free(&d->pkt_heartbeat);
 
     av_freep(pf);
 }
 
+int ifile_prefetch_stats(InputFile *f, DemuxPrefetchStats *stats)
+{
+    Demuxer *d = demuxer_from_ifile(f);
+
+    if (!d->prefetch)
+        return 0;
+
+    dp_stats(d->prefetch, stats);
+    return 1;
+}
+
 static int ist_use(InputStream *ist, int decoding_needed,
                    const ViewSpecifier *vs, SchedulerNode *src)
 {
@@ -1770,6 +1864,9 @@ int ifile_open(const OptionsContext *o, const char *filename, Scheduler *sch)
     if (o->bitexact)
         ic->flags |= AVFMT_FLAG_BITEXACT;
     ic->interrupt_callback = int_cb;
+    // allow interrupting reads when stopping the prefetch thread
+    if (o->prefetch_size > 0 || o->prefetch_duration > 0)
+        ic->interrupt_callback = (AVIOInterruptCB){ demux_interrupt_cb, d };
 
     if (!av_dict_get(o->g->format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
         av_dict_set(&o->g->format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
@@ -1915,6 +2012,16 @@ int ifile_open(const OptionsContext *o, const char *filename, Scheduler *sch)
                "since neither -readrate nor -re were given\n");
     }
 
+    if (o->prefetch_size > 0 || o->prefetch_duration > 0) {
+        size_t max_bytes = o->prefetch_size > 0 ? FFMIN(o->prefetch_size, SIZE_MAX) :
+                                                  16 << 20;
+
+        ret = dp_alloc(&d->prefetch, max_bytes, FFMAX(o->prefetch_duration, 0),
+                       read_packet, prefetch_choked, d);
+        if (ret < 0)
+            return ret;
+    }
+
     /* Add all the streams from the given input file to the demuxer */
     for (int i = 0; i < ic->nb_streams; i++) {
         ret = ist_add(o, d, ic->streams[i], &opts_used);
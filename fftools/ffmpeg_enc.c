@@ -50,6 +50,10 @@ struct Encoder {
 
     Scheduler      *sch;
     unsigned        sch_idx;
+
+    // packets received from the encoder, not yet sent downstream
+    AVPacket       *send_pkts[SCH_SEND_BATCH_MAX];
+    unsigned     nb_send_pkts;
 };
 
 // data that is local to the decoder thread and not visible outside of it
@@ -65,6 +69,9 @@ void enc_free(Encoder **penc)
     if (!enc)
         return;
 
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(enc->send_pkts); i++)
+        av_packet_free(&enc->send_pkts[i]);
+
     av_freep(penc);
 }
 
@@ -82,6 +89,14 @@ int enc_alloc(Encoder **penc, const AVCodec *codec,
     enc->sch     = sch;
     enc->sch_idx = sch_idx;
 
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(enc->send_pkts); i++) {
+        enc->send_pkts[i] = av_packet_alloc();
+        if (!enc->send_pkts[i]) {
+            enc_free(&enc);
+            return AVERROR(ENOMEM);
+        }
+    }
+
     *penc = enc;
 
     return 0;
@@ -601,6 +616,21 @@ static int update_video_stats(OutputStream *ost, const AVPacket *pkt, int write_
     return 0;
 }
 
+static int send_pending_packets(Encoder *e)
+{
+    int ret;
+
+    if (!e->nb_send_pkts)
+        return 0;
+
+    ret = sch_enc_send_batch(e->sch, e->sch_idx, e->send_pkts, e->nb_send_pkts);
+    for (unsigned i = 0; i < e->nb_send_pkts; i++)
+        av_packet_unref(e->send_pkts[i]);
+    e->nb_send_pkts = 0;
+
+    return ret;
+}
+
 static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame,
                         AVPacket *pkt)
 {
@@ -663,10 +693,12 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame,
 
         if (ret == AVERROR(EAGAIN)) {
             av_assert0(frame); // should never happen during flushing
-            return 0;
+            return send_pending_packets(e);
+        } else if (ret == AVERROR_EOF) {
+            int err = send_pending_packets(e);
+            return err < 0 ? err : ret;
         } else if (ret < 0) {
-            if (ret != AVERROR_EOF)
-                av_log(ost, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
+            av_log(ost, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
             return ret;
         }
 
@@ -713,10 +745,12 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame,
 
         e->packets_encoded++;
 
-        ret = sch_enc_send(e->sch, e->sch_idx, pkt);
-        if (ret < 0) {
-            av_packet_unref(pkt);
-            return ret;
+        // all the packets output for this frame are sent downstream at once
+        av_packet_move_ref(e->send_pkts[e->nb_send_pkts++], pkt);
+        if (e->nb_send_pkts == FF_ARRAY_ELEMS(e->send_pkts)) {
+            ret = send_pending_packets(e);
+            if (ret < 0)
+                return ret;
         }
     }
 
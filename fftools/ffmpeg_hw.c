@@ -18,6 +18,7 @@
 
 #include <string.h>
 
+#include "libavutil/avstring.h"
 #include "libavutil/mem.h"
 
 #include "ffmpeg.h"
@@ -25,6 +26,35 @@
 static int nb_hw_devices;
 static HWDevice **hw_devices;
 
+typedef struct HWDeviceKept {
+    char        *spec;
+    AVBufferRef *device_ref;
+} HWDeviceKept;
+
+// devices kept by hw_device_free_all() for reuse
+static int           reuse_devices;
+static int        nb_kept_devices;
+static HWDeviceKept *kept_devices;
+
+static AVBufferRef *hw_device_take_kept(const char *spec)
+{
+    for (int i = 0; i < nb_kept_devices; i++) {
+        AVBufferRef *device_ref = kept_devices[i].device_ref;
+
+        if (strcmp(kept_devices[i].spec, spec))
+            continue;
+
+        av_freep(&kept_devices[i].spec);
+        memmove(&kept_devices[i], &kept_devices[i + 1],
+                (nb_kept_devices - i - 1) * sizeof(*kept_devices));
+        nb_kept_devices--;
+
+        av_log(NULL, AV_LOG_VERBOSE, "Reusing hardware device \"%s\"\n", spec);
+        return device_ref;
+    }
+    return NULL;
+}
+
 HWDevice *hw_device_get_by_type(enum AVHWDeviceType type)
 {
     HWDevice *found = NULL;
@@ -105,6 +135,7 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
     enum AVHWDeviceType type;
     HWDevice *dev, *src;
     AVBufferRef *device_ref = NULL;
+    char *spec = NULL;
     int err;
     const char *errmsg, *p, *q;
     size_t k;
@@ -145,7 +176,19 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
         }
     }
 
-    if (!*p) {
+    // derived devices depend on their source, so they are never reused
+    if (reuse_devices && *p != '@') {
+        spec = av_strdup(arg);
+        if (!spec) {
+            err = AVERROR(ENOMEM);
+            goto fail;
+        }
+        device_ref = hw_device_take_kept(spec);
+    }
+
+    if (device_ref) {
+        // Device kept from a previous job.
+    } else if (!*p) {
         // New device with no parameters.
         err = av_hwdevice_ctx_create(&device_ref, type,
                                      NULL, NULL, 0);
@@ -216,15 +259,18 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
     dev->name = name;
     dev->type = type;
     dev->device_ref = device_ref;
+    dev->spec = spec;
 
     if (dev_out)
         *dev_out = dev;
 
     name = NULL;
+    spec = NULL;
     err = 0;
 done:
     av_freep(&type_name);
     av_freep(&name);
+    av_freep(&spec);
     av_freep(&device);
     av_dict_free(&options);
     return err;
@@ -246,7 +292,7 @@ int hw_device_init_from_type(enum AVHWDeviceType type,
 {
     AVBufferRef *device_ref = NULL;
     HWDevice *dev;
-    char *name;
+    char *name, *spec = NULL;
     int err;
 
     name = hw_device_default_name(type);
@@ -255,11 +301,24 @@ int hw_device_init_from_type(enum AVHWDeviceType type,
         goto fail;
     }
 
-    err = av_hwdevice_ctx_create(&device_ref, type, device, NULL, 0);
-    if (err < 0) {
-        av_log(NULL, AV_LOG_ERROR,
-               "Device creation failed: %d.\n", err);
-        goto fail;
+    if (reuse_devices) {
+        // same as the equivalent -init_hw_device argument
+        spec = device ? av_asprintf("%s:%s", av_hwdevice_get_type_name(type), device) :
+                        av_strdup(av_hwdevice_get_type_name(type));
+        if (!spec) {
+            err = AVERROR(ENOMEM);
+            goto fail;
+        }
+        device_ref = hw_device_take_kept(spec);
+    }
+
+    if (!device_ref) {
+        err = av_hwdevice_ctx_create(&device_ref, type, device, NULL, 0);
+        if (err < 0) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Device creation failed: %d.\n", err);
+            goto fail;
+        }
     }
 
     dev = hw_device_add();
@@ -271,6 +330,7 @@ int hw_device_init_from_type(enum AVHWDeviceType type,
     dev->name = name;
     dev->type = type;
     dev->device_ref = device_ref;
+    dev->spec = spec;
 
     if (dev_out)
         *dev_out = dev;
@@ -279,6 +339,7 @@ int hw_device_init_from_type(enum AVHWDeviceType type,
 
 fail:
     av_freep(&name);
+    av_freep(&spec);
     av_buffer_unref(&device_ref);
     return err;
 }
@@ -287,14 +348,45 @@ void hw_device_free_all(void)
 {
     int i;
     for (i = 0; i < nb_hw_devices; i++) {
-        av_freep(&hw_devices[i]->name);
-        av_buffer_unref(&hw_devices[i]->device_ref);
+        HWDevice *dev = hw_devices[i];
+
+        if (reuse_devices && dev->spec) {
+            HWDeviceKept *kept = av_realloc_array(kept_devices, nb_kept_devices + 1,
+                                                  sizeof(*kept_devices));
+            if (kept) {
+                kept_devices = kept;
+                kept_devices[nb_kept_devices].spec       = dev->spec;
+                kept_devices[nb_kept_devices].device_ref = dev->device_ref;
+                nb_kept_devices++;
+
+                dev->spec       = NULL;
+                dev->device_ref = NULL;
+            }
+        }
+
+        av_freep(&dev->name);
+        av_freep(&dev->spec);
+        av_buffer_unref(&dev->device_ref);
         av_freep(&hw_devices[i]);
     }
     av_freep(&hw_devices);
     nb_hw_devices = 0;
 }
 
+void hw_device_set_reuse(int reuse)
+{
+    reuse_devices = reuse;
+    if (reuse)
+        return;
+
+    for (int i = 0; i < nb_kept_devices; i++) {
+        av_freep(&kept_devices[i].spec);
+        av_buffer_unref(&kept_devices[i].device_ref);
+    }
+    av_freep(&kept_devices);
+    nb_kept_devices = 0;
+}
+
 AVBufferRef *hw_device_for_filter(void)
 {
     // Pick the last hardware device if the user doesn't pick the device for
@@ -135,6 +135,45 @@ static void mux_log_debug_ts(OutputStream *ost, const AVPacket *pkt)
            pkt->size, *latency ? latency : "N/A");
 }
 
+static void mux_update_latency(OutputStream *ost, const AVPacket *pkt)
+{
+    static const enum LatencyProbe stage_end[] = {
+        [LATENCY_STAGE_DECODE] = LATENCY_PROBE_DEC_POST,
+        [LATENCY_STAGE_FILTER] = LATENCY_PROBE_FILTER_POST,
+        [LATENCY_STAGE_ENCODE] = LATENCY_PROBE_ENC_POST,
+        [LATENCY_STAGE_MUX]    = LATENCY_PROBE_NB,
+    };
+
+    const FrameData *fd;
+    int64_t now, start, prev;
+
+    if (!pkt->opaque_ref)
+        return;
+    fd = (const FrameData*)pkt->opaque_ref->data;
+
+    start = fd->wallclock[LATENCY_PROBE_DEMUX];
+    if (start == INT64_MIN)
+        return;
+
+    now  = av_gettime_relative();
+    prev = start;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(stage_end); i++) {
+        int64_t t = stage_end[i] == LATENCY_PROBE_NB ? now :
+                    fd->wallclock[stage_end[i]];
+
+        // the packet bypassed this stage, the time is accounted for
+        // in the next one
+        if (t == INT64_MIN)
+            continue;
+
+        latency_hist_add(ost->latency[i], t - prev);
+        prev = t;
+    }
+
+    latency_hist_add(ost->latency[LATENCY_STAGE_TOTAL], now - start);
+}
+
 static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
 {
     OutputStream *ost = &ms->ost;
@@ -233,6 +272,8 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
     if (ms->stats.io)
         enc_stats_write(ost, &ms->stats, NULL, pkt, frame_num);
 
+    mux_update_latency(ost, pkt);
+
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         av_log(ost, AV_LOG_ERROR,
@@ -715,12 +756,36 @@ static void mux_final_stats(Muxer *mux)
         av_log(of, AV_LOG_VERBOSE, "%"PRIu64" packets muxed (%"PRIu64" bytes); ",
                atomic_load(&ost->packets_written), s);
 
+        if (ost->latency[LATENCY_STAGE_TOTAL]) {
+            LatencyHistStats st;
+
+            latency_hist_stats(ost->latency[LATENCY_STAGE_TOTAL], &st, NULL);
+            if (st.nb_samples)
+                av_log(of, AV_LOG_VERBOSE, "latency p50/p99/max: %g/%g/%g ms; ",
+                       st.p50 / 1e3, st.p99 / 1e3, st.max / 1e3);
+        }
+
         av_log(of, AV_LOG_VERBOSE, "\n");
     }
 
     av_log(of, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) muxed\n",
            total_packets, total_size);
 
+    if (mux->aw) {
+        AsyncWriterStats st;
+
+        aw_stats(mux->aw, &st, NULL);
+        av_log(of, AV_LOG_VERBOSE, "  Output writer: %"PRIu64" writes "
+               "(%"PRIu64" bytes); %"PRIu64" stalls (%.3fs); %"PRIu64" syncs",
+               st.nb_writes, st.bytes_written, st.nb_stalls,
+               st.stall_time / 1e6, st.nb_syncs);
+        if (st.latency.nb_samples)
+            av_log(of, AV_LOG_VERBOSE, "; write latency p50/p99/max: %g/%g/%g ms",
+                   st.latency.p50 / 1e3, st.latency.p99 / 1e3,
+                   st.latency.max / 1e3);
+        av_log(of, AV_LOG_VERBOSE, "\n");
+    }
+
     if (total_size && file_size > 0 && file_size >= total_size) {
         snprintf(overhead, sizeof(overhead), "%f%%",
                  100.0 * (file_size - total_size) / total_size);
@@ -737,6 +802,13 @@ static void mux_final_stats(Muxer *mux)
            overhead);
 }
 
+static int mux_close_pb(Muxer *mux)
+{
+    if (mux->aw)
+        return aw_close(mux->aw, &mux->fc->pb);
+    return avio_closep(&mux->fc->pb);
+}
+
 int of_write_trailer(OutputFile *of)
 {
     Muxer *mux = mux_from_of(of);
@@ -759,7 +831,7 @@ int of_write_trailer(OutputFile *of)
     mux->last_filesize = filesize(fc->pb);
 
     if (!(fc->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_closep(&fc->pb);
+        ret = mux_close_pb(mux);
         if (ret < 0) {
             av_log(mux, AV_LOG_ERROR, "Error closing file: %s\n", av_err2str(ret));
             mux_result = err_merge(mux_result, ret);
@@ -813,6 +885,9 @@ static void ost_free(OutputStream **post)
 
     av_packet_free(&ms->pkt);
 
+    for (int i = 0; i < LATENCY_STAGE_NB; i++)
+        latency_hist_free(&ost->latency[i]);
+
     av_freep(&ost->kf.pts);
     av_expr_free(ost->kf.pexpr);
 
@@ -831,18 +906,18 @@ static void ost_free(OutputStream **post)
     av_freep(post);
 }
 
-static void fc_close(AVFormatContext **pfc)
+static void fc_close(Muxer *mux)
 {
-    AVFormatContext *fc = *pfc;
+    AVFormatContext *fc = mux->fc;
 
     if (!fc)
         return;
 
     if (!(fc->oformat->flags & AVFMT_NOFILE))
-        avio_closep(&fc->pb);
+        mux_close_pb(mux);
     avformat_free_context(fc);
 
-    *pfc = NULL;
+    mux->fc = NULL;
 }
 
 void of_free(OutputFile **pof)
@@ -867,7 +942,8 @@ void of_free(OutputFile **pof)
 
     av_packet_free(&mux->sq_pkt);
 
-    fc_close(&mux->fc);
+    fc_close(mux);
+    aw_free(&mux->aw, NULL);
 
     av_freep(pof);
 }
@@ -877,3 +953,15 @@ int64_t of_filesize(OutputFile *of)
     Muxer *mux = mux_from_of(of);
     return atomic_load(&mux->last_filesize);
 }
+
+int of_write_stats(OutputFile *of, AsyncWriterStats *stats,
+                   LatencyHistStats *interval)
+{
+    Muxer *mux = mux_from_of(of);
+
+    if (!mux->aw)
+        return 0;
+
+    aw_stats(mux->aw, stats, interval);
+    return 1;
+}
@@ -24,6 +24,7 @@
 #include <stdatomic.h>
 #include <stdint.h>
 
+#include "async_writer.h"
 #include "ffmpeg_sched.h"
 
 #include "libavformat/avformat.h"
@@ -90,6 +91,9 @@ typedef struct Muxer {
 
     AVFormatContext        *fc;
 
+    // writes the output from a separate thread, when enabled
+    AsyncWriter            *aw;
+
     Scheduler              *sch;
     unsigned                sch_idx;
 
@@ -1267,6 +1267,12 @@ static int ost_add(Muxer *mux, const OptionsContext *o, enum AVMediaType type,
     if (!ms->pkt)
         return AVERROR(ENOMEM);
 
+    for (int i = 0; i < LATENCY_STAGE_NB; i++) {
+        ost->latency[i] = latency_hist_alloc();
+        if (!ost->latency[i])
+            return AVERROR(ENOMEM);
+    }
+
     if (ost->enc_ctx) {
         AVIOContext *s = NULL;
         char *buf = NULL, *arg = NULL;
@@ -3341,6 +3347,20 @@ int of_open(const OptionsContext *o, const char *filename, Scheduler *sch)
                    filename, av_err2str(err));
             return err;
         }
+
+        if (o->async_write_size > 0) {
+            size_t chunk_size = FFALIGN(FFMIN(o->async_write_size, 1 << 30), 4096);
+            size_t max_buffered = o->async_write_buffer > 0 ?
+                                  FFMIN(o->async_write_buffer, SIZE_MAX) :
+                                  4 * chunk_size;
+
+            err = aw_alloc(&mux->aw, &oc->pb, chunk_size, max_buffered, mux);
+            if (err < 0) {
+                av_log(mux, AV_LOG_FATAL, "Error starting the output writer: %s\n",
+                       av_err2str(err));
+                return err;
+            }
+        }
     } else if (strcmp(oc->oformat->name, "image2")==0 && !av_filename_number_test(filename)) {
         err = assert_file_overwrite(filename);
         if (err < 0)
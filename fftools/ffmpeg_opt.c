@@ -42,6 +42,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
+#include "libavutil/cpu.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
@@ -87,6 +88,43 @@ int ignore_unknown_streams = 0;
 int copy_unknown_streams = 0;
 int recast_media = 0;
 
+int daemon_mode = 0;
+
+void reset_global_options(void)
+{
+    filter_hw_device         = NULL;
+    audio_drift_threshold    = 0.1;
+    dts_delta_threshold      = 10;
+    dts_error_threshold      = 3600*30;
+    ni_interval_fps          = 0;
+#if FFMPEG_OPT_VSYNC
+    video_sync_method        = VSYNC_AUTO;
+#endif
+    frame_drop_threshold     = 0;
+    do_benchmark             = 0;
+    do_benchmark_all         = 0;
+    do_hex_dump              = 0;
+    do_pkt_dump              = 0;
+    copy_ts                  = 0;
+    start_at_zero            = 0;
+    copy_tb                  = -1;
+    debug_ts                 = 0;
+    exit_on_error            = 0;
+    abort_on_flags           = 0;
+    print_stats              = -1;
+    stdin_interaction        = 1;
+    max_error_rate           = 2.0/3;
+    filter_complex_nbthreads = 0;
+    vstats_version           = 2;
+    auto_conversion_filters  = 1;
+    stats_period             = 500000;
+    file_overwrite           = 0;
+    no_file_overwrite        = 0;
+    ignore_unknown_streams   = 0;
+    copy_unknown_streams     = 0;
+    recast_media             = 0;
+}
+
 static void uninit_options(OptionsContext *o)
 {
     /* all OPT_SPEC and OPT_TYPE_STRING can be freed in generic way */
@@ -616,6 +654,45 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(sch, arg);
 }
 
+static int opt_thread_queue_type(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    return sch_thread_queue_type(sch, arg);
+}
+
+static int opt_thread_queue_depth(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    unsigned depth_min, depth_max, frame_depth_max = 0;
+    char tail;
+    int ret;
+
+    ret = sscanf(arg, "%u:%u:%u%c", &depth_min, &depth_max, &frame_depth_max, &tail);
+    if (ret != 2 && ret != 3) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid thread queue depth range: %s, "
+               "expected <min>:<max>[:<frame_max>]\n", arg);
+        return AVERROR(EINVAL);
+    }
+
+    return sch_thread_queue_depth(sch, depth_min, depth_max, frame_depth_max);
+}
+
+static int opt_sched_workers(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    double num;
+    int ret;
+
+    if (!strcmp(arg, "auto"))
+        return sch_workers(sch, av_cpu_count());
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, 0, INT_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    return sch_workers(sch, num);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -948,6 +1025,13 @@ static int opt_vstats_file(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_daemon(void *optctx, const char *opt, const char *arg)
+{
+    // handled in main() when starting the daemon
+    av_log(NULL, AV_LOG_FATAL, "Option -%s cannot be used in a daemon job\n", opt);
+    return AVERROR(EINVAL);
+}
+
 static int opt_vstats(void *optctx, const char *opt, const char *arg)
 {
     char filename[40];
@@ -1345,6 +1429,25 @@ static int open_files(OptionGroupList *l, const char *inout, Scheduler *sch,
     return 0;
 }
 
+/* options changing the state of the whole process, which would outlive
+ * the job in daemon mode */
+static int check_daemon_job_options(const OptionGroup *g)
+{
+    static const char *const process_opts[] = {
+        "timelimit", "cpuflags", "cpucount", "report",
+    };
+
+    for (int i = 0; i < g->nb_opts; i++)
+        for (int j = 0; j < FF_ARRAY_ELEMS(process_opts); j++)
+            if (!strcmp(g->opts[i].opt->name, process_opts[j])) {
+                av_log(NULL, AV_LOG_FATAL, "Option -%s cannot be used in a "
+                       "daemon job\n", g->opts[i].key);
+                return AVERROR(EINVAL);
+            }
+
+    return 0;
+}
+
 int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch)
 {
     OptionParseContext octx;
@@ -1361,6 +1464,14 @@ int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch)
         goto fail;
     }
 
+    if (daemon_mode) {
+        ret = check_daemon_job_options(&octx.global_opts);
+        if (ret < 0) {
+            errmsg = "parsing global options";
+            goto fail;
+        }
+    }
+
     /* apply global options */
     ret = parse_optgroup(sch, &octx.global_opts, options);
     if (ret < 0) {
@@ -1368,6 +1479,10 @@ int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch)
         goto fail;
     }
 
+    /* a job must not wait for input on the terminal of the daemon */
+    if (daemon_mode)
+        stdin_interaction = 0;
+
     /* configure terminal and setup signal handlers */
     term_init();
 
@@ -1431,6 +1546,24 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_stats_json(void *optctx, const char *opt, const char *arg)
+{
+    AVIOContext *avio = NULL;
+    int ret;
+
+    if (!strcmp(arg, "-"))
+        arg = "pipe:";
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open JSON stats URL \"%s\": %s\n",
+               arg, av_err2str(ret));
+        return ret;
+    }
+    avio_closep(&stats_json_avio);
+    stats_json_avio = avio;
+    return 0;
+}
+
 int opt_timelimit(void *optctx, const char *opt, const char *arg)
 {
 #if HAVE_SETRLIMIT
@@ -1578,12 +1711,18 @@ const OptionDef options[] = {
     { "progress",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "stats_json",             OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_stats_json },
+      "periodically write a JSON line with progress and per-stage latency statistics", "url" },
     { "stdin",                  OPT_TYPE_BOOL, OPT_EXPERT,
         { &stdin_interaction },
       "enable or disable interaction on standard input" },
     { "timelimit",              OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_timelimit },
         "set max runtime in seconds in CPU user time", "limit" },
+    { "daemon",                 OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_daemon },
+        "run jobs received on the specified UNIX socket", "path" },
     { "dump",                   OPT_TYPE_BOOL, OPT_EXPERT,
         { &do_pkt_dump },
         "dump each input packet" },
@@ -1599,6 +1738,12 @@ const OptionDef options[] = {
     { "readrate_initial_burst", OPT_TYPE_DOUBLE, OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
         { .off = OFFSET(readrate_initial_burst) },
         "The initial amount of input to burst read before imposing any readrate", "seconds" },
+    { "prefetch_size",          OPT_TYPE_INT64, OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+        { .off = OFFSET(prefetch_size) },
+        "read input packets ahead on a separate thread, up to the given total size", "bytes" },
+    { "prefetch_duration",      OPT_TYPE_TIME, OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+        { .off = OFFSET(prefetch_duration) },
+        "read input packets ahead on a separate thread, up to the given duration", "time_duration" },
     { "target",                 OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_PERFILE | OPT_EXPERT | OPT_OUTPUT,
         { .func_arg = opt_target },
         "specify target file type (\"vcd\", \"svcd\", \"dvd\", \"dv\" or \"dv50\" "
@@ -1725,6 +1870,16 @@ const OptionDef options[] = {
     { "thread_queue_size",   OPT_TYPE_INT,  OPT_OFFSET | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT,
         { .off = OFFSET(thread_queue_size) },
         "set the maximum number of queued packets from the demuxer" },
+    { "thread_queue_type",   OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_thread_queue_type },
+        "set the implementation of inter-thread queues", "mutex|lockfree" },
+    { "thread_queue_depth",  OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_thread_queue_depth },
+        "let thread queue depths adapt within the given range", "min:max[:frame_max]" },
+    { "sched_workers",       OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_workers },
+        "limit the number of decoding/filtering/encoding threads running at once "
+        "(a concurrency limit, not a thread pool)", "number|auto" },
     { "find_stream_info",    OPT_TYPE_BOOL, OPT_INPUT | OPT_EXPERT | OPT_OFFSET,
         { .off = OFFSET(find_stream_info) },
         "read and decode the streams to fill missing information with heuristics" },
@@ -1953,6 +2108,12 @@ const OptionDef options[] = {
     { "sdp_file",   OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT | OPT_OUTPUT,
         { .func_arg = opt_sdp_file },
         "specify a file in which to print sdp information", "file" },
+    { "async_write_size",   OPT_TYPE_INT64, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT,
+        { .off = OFFSET(async_write_size) },
+        "write the output from a separate thread, in chunks of the given size", "bytes" },
+    { "async_write_buffer", OPT_TYPE_INT64, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT,
+        { .off = OFFSET(async_write_buffer) },
+        "maximum amount of data buffered for asynchronous writing", "bytes" },
 
     { "time_base",     OPT_TYPE_STRING, OPT_EXPERT | OPT_PERSTREAM | OPT_OUTPUT,
         { .off = OFFSET(time_bases) },
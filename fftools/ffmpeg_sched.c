@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <inttypes.h>
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -61,6 +62,26 @@ typedef struct SchWaiter {
     int                 choked_next;
 } SchWaiter;
 
+/**
+ * Execution slots bounding the number of processing tasks that run at the
+ * same time. A task holds a slot while it runs and gives it up for the
+ * duration of every scheduler call that may block; tasks waiting for a slot
+ * are served in FIFO order.
+ */
+typedef struct SchSlots {
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+
+    unsigned            nb_slots;
+    unsigned            nb_free;
+
+    uint64_t            ticket_next;
+    uint64_t            ticket_serving;
+
+    // number of times a task had to wait for a slot
+    uint64_t            nb_waits;
+} SchSlots;
+
 typedef struct SchTask {
     Scheduler          *parent;
     SchedulerNode       node;
@@ -68,6 +89,9 @@ typedef struct SchTask {
     SchThreadFunc       func;
     void               *func_arg;
 
+    // non-NULL if this task needs an execution slot to run
+    SchSlots           *slots;
+
     pthread_t           thread;
     int                 thread_running;
 } SchTask;
@@ -144,8 +168,8 @@ typedef struct SchEnc {
     // tq_send() to queue returned EOF
     int                 in_finished;
 
-    // temporary storage used by sch_enc_send()
-    AVPacket           *send_pkt;
+    // temporary storage used by sch_enc_send_batch()
+    AVPacket           *send_pkts[SCH_SEND_BATCH_MAX];
 } SchEnc;
 
 typedef struct SchDemuxStream {
@@ -163,8 +187,8 @@ typedef struct SchDemux {
     SchTask             task;
     SchWaiter           waiter;
 
-    // temporary storage used by sch_demux_send()
-    AVPacket           *send_pkt;
+    // temporary storage used by sch_demux_send_batch()
+    AVPacket           *send_pkts[SCH_SEND_BATCH_MAX];
 
     // protected by schedule_lock
     int                 task_exited;
@@ -312,6 +336,15 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    enum ThreadQueueType queue_type;
+    // bounds for adaptive packet queue depths, 0 when disabled
+    unsigned            queue_depth_min;
+    unsigned            queue_depth_max;
+    // upper bound for adaptive frame queue depths, 0 when disabled
+    unsigned            frame_queue_depth_max;
+
+    SchSlots            slots;
 };
 
 /**
@@ -372,8 +405,8 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
-static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
-                       enum QueueType type)
+static int queue_alloc(Scheduler *sch, ThreadQueue **ptq, unsigned nb_streams,
+                       unsigned queue_size, enum QueueType type)
 {
     ThreadQueue *tq;
     ObjPool *op;
@@ -400,12 +433,28 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
         return AVERROR(ENOMEM);
 
     tq = tq_alloc(nb_streams, queue_size, op,
-                  (type == QUEUE_PACKETS) ? pkt_move : frame_move);
+                  (type == QUEUE_PACKETS) ? pkt_move : frame_move,
+                  sch->queue_type);
     if (!tq) {
         objpool_free(&op);
         return AVERROR(ENOMEM);
     }
 
+    // frame queues start at their fixed size and may only grow up to the
+    // bound the decoders accounted for, see sch_frame_queue_size_max()
+    if (type == QUEUE_PACKETS ? !!sch->queue_depth_max :
+                                sch->frame_queue_depth_max > queue_size) {
+        int ret = (type == QUEUE_PACKETS) ?
+                  tq_set_depth_range(tq, sch->queue_depth_min,
+                                     sch->queue_depth_max) :
+                  tq_set_depth_range(tq, queue_size,
+                                     sch->frame_queue_depth_max);
+        if (ret < 0) {
+            tq_free(&tq);
+            return ret;
+        }
+    }
+
     *ptq = tq;
     return 0;
 }
@@ -420,6 +469,13 @@ static int task_start(SchTask *task)
 
     av_assert0(!task->thread_running);
 
+    // demuxers and muxers mostly wait for I/O, only the processing tasks
+    // are limited by the execution slots
+    if (task->parent->slots.nb_slots &&
+        task->node.type != SCH_NODE_TYPE_DEMUX &&
+        task->node.type != SCH_NODE_TYPE_MUX)
+        task->slots = &task->parent->slots;
+
     ret = pthread_create(&task->thread, NULL, task_wrapper, task);
     if (ret) {
         av_log(task->func_arg, AV_LOG_ERROR, "pthread_create() failed: %s\n",
@@ -443,6 +499,71 @@ static void task_init(Scheduler *sch, SchTask *task, enum SchedulerNodeType type
     task->func_arg  = func_arg;
 }
 
+static void task_slot_acquire(SchTask *task)
+{
+    SchSlots *s = task->slots;
+    uint64_t ticket;
+
+    if (!s)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+
+    // nobody is queued, take a free slot right away
+    if (s->ticket_next == s->ticket_serving && s->nb_free) {
+        s->nb_free--;
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+
+    ticket = s->ticket_next++;
+    s->nb_waits++;
+
+    while (ticket != s->ticket_serving || !s->nb_free)
+        pthread_cond_wait(&s->cond, &s->lock);
+
+    s->nb_free--;
+    s->ticket_serving++;
+
+    // let the next task in line proceed if there are more free slots
+    if (s->nb_free && s->ticket_serving != s->ticket_next)
+        pthread_cond_broadcast(&s->cond);
+
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void task_slot_release(SchTask *task)
+{
+    SchSlots *s = task->slots;
+
+    if (!s)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+
+    s->nb_free++;
+    if (s->ticket_serving != s->ticket_next)
+        pthread_cond_broadcast(&s->cond);
+
+    pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * Stop limiting a task producing hardware frames. Such a task may wait inside
+ * its codec or filter for the device to get frames back, which only the tasks
+ * downstream of it can return, so holding a slot while waiting could starve
+ * them. Must be called by the task itself while it does not hold a slot.
+ */
+static void task_slot_leave(SchTask *task, const AVFrame *frame)
+{
+    if (!task->slots || !frame || !frame->hw_frames_ctx)
+        return;
+
+    av_log(task->func_arg, AV_LOG_VERBOSE,
+           "Outputs hardware frames, not limited by the workers\n");
+    task->slots = NULL;
+}
+
 static int64_t trailing_dts(const Scheduler *sch, int count_finished)
 {
     int64_t min_dts = INT64_MAX;
@@ -484,7 +605,8 @@ void sch_free(Scheduler **psch)
         }
         av_freep(&d->streams);
 
-        av_packet_free(&d->send_pkt);
+        for (unsigned j = 0; j < FF_ARRAY_ELEMS(d->send_pkts); j++)
+            av_packet_free(&d->send_pkts[j]);
 
         waiter_uninit(&d->waiter);
     }
@@ -538,7 +660,8 @@ void sch_free(Scheduler **psch)
 
         tq_free(&enc->queue);
 
-        av_packet_free(&enc->send_pkt);
+        for (unsigned j = 0; j < FF_ARRAY_ELEMS(enc->send_pkts); j++)
+            av_packet_free(&enc->send_pkts[j]);
 
         av_freep(&enc->dst);
         av_freep(&enc->dst_finished);
@@ -575,6 +698,9 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->mux_done_lock);
     pthread_cond_destroy(&sch->mux_done_cond);
 
+    pthread_mutex_destroy(&sch->slots.lock);
+    pthread_cond_destroy(&sch->slots.cond);
+
     av_freep(psch);
 }
 
@@ -611,6 +737,14 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->slots.lock, NULL);
+    if (ret)
+        goto fail;
+
+    ret = pthread_cond_init(&sch->slots.cond, NULL);
+    if (ret)
+        goto fail;
+
     return sch;
 fail:
     sch_free(&sch);
@@ -624,6 +758,110 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+int sch_thread_queue_type(Scheduler *sch, const char *type)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    if (sch->nb_demux || sch->nb_dec || sch->nb_enc ||
+        sch->nb_filters || sch->nb_mux) {
+        av_log(sch, AV_LOG_ERROR,
+               "The thread queue type must be set before any inputs/outputs\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (!strcmp(type, "mutex"))
+        sch->queue_type = THREAD_QUEUE_MUTEX;
+    else if (!strcmp(type, "lockfree"))
+        sch->queue_type = THREAD_QUEUE_LOCKFREE;
+    else {
+        av_log(sch, AV_LOG_ERROR, "Invalid thread queue type: %s\n", type);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+int sch_thread_queue_depth(Scheduler *sch, unsigned depth_min,
+                           unsigned depth_max, unsigned frame_depth_max)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    if (sch->nb_demux || sch->nb_dec || sch->nb_enc ||
+        sch->nb_filters || sch->nb_mux) {
+        av_log(sch, AV_LOG_ERROR,
+               "The thread queue depth must be set before any inputs/outputs\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (!depth_min || depth_min > depth_max) {
+        av_log(sch, AV_LOG_ERROR, "Invalid thread queue depth range: %u-%u\n",
+               depth_min, depth_max);
+        return AVERROR(EINVAL);
+    }
+
+    if (frame_depth_max && frame_depth_max < DEFAULT_FRAME_THREAD_QUEUE_SIZE) {
+        av_log(sch, AV_LOG_ERROR, "Invalid frame thread queue depth: %u\n",
+               frame_depth_max);
+        return AVERROR(EINVAL);
+    }
+
+    sch->queue_depth_min       = depth_min;
+    sch->queue_depth_max       = depth_max;
+    sch->frame_queue_depth_max = frame_depth_max;
+
+    return 0;
+}
+
+unsigned sch_frame_queue_size_max(const Scheduler *sch)
+{
+    return FFMAX(sch->frame_queue_depth_max, DEFAULT_FRAME_THREAD_QUEUE_SIZE);
+}
+
+int sch_queue_stats(Scheduler *sch, unsigned idx, SchedulerNode *node,
+                    ThreadQueueStats *stats)
+{
+    ThreadQueue *tq;
+
+    if (idx < sch->nb_dec) {
+        *node = SCH_DEC_IN(idx);
+        tq    = sch->dec[idx].queue;
+    } else if ((idx -= sch->nb_dec) < sch->nb_filters) {
+        *node = SCH_FILTER_IN(idx, 0);
+        tq    = sch->filters[idx].queue;
+    } else if ((idx -= sch->nb_filters) < sch->nb_enc) {
+        *node = SCH_ENC(idx);
+        tq    = sch->enc[idx].queue;
+    } else if ((idx -= sch->nb_enc) < sch->nb_mux) {
+        *node = SCH_MSTREAM(idx, 0);
+        tq    = sch->mux[idx].queue;
+    } else
+        return AVERROR_EOF;
+
+    // muxer queues are only created once all the muxer streams are known
+    if (!tq) {
+        memset(stats, 0, sizeof(*stats));
+        return 0;
+    }
+
+    tq_stats(tq, stats);
+    return 0;
+}
+
+int sch_workers(Scheduler *sch, int nb_workers)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    if (nb_workers < 0) {
+        av_log(sch, AV_LOG_ERROR, "Invalid number of workers: %d\n", nb_workers);
+        return AVERROR(EINVAL);
+    }
+
+    sch->slots.nb_slots = nb_workers;
+    sch->slots.nb_free  = nb_workers;
+
+    return 0;
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -702,9 +940,12 @@ int sch_add_demux(Scheduler *sch, SchThreadFunc func, void *ctx)
     task_init(sch, &d->task, SCH_NODE_TYPE_DEMUX, idx, func, ctx);
 
     d->class    = &sch_demux_class;
-    d->send_pkt = av_packet_alloc();
-    if (!d->send_pkt)
-        return AVERROR(ENOMEM);
+
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(d->send_pkts); i++) {
+        d->send_pkts[i] = av_packet_alloc();
+        if (!d->send_pkts[i])
+            return AVERROR(ENOMEM);
+    }
 
     ret = waiter_init(&d->waiter);
     if (ret < 0)
@@ -770,7 +1011,7 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
+    ret = queue_alloc(sch, &dec->queue, 1, 0, QUEUE_PACKETS);
     if (ret < 0)
         return ret;
 
@@ -810,11 +1051,13 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
 
     task_init(sch, &enc->task, SCH_NODE_TYPE_ENC, idx, func, ctx);
 
-    enc->send_pkt = av_packet_alloc();
-    if (!enc->send_pkt)
-        return AVERROR(ENOMEM);
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(enc->send_pkts); i++) {
+        enc->send_pkts[i] = av_packet_alloc();
+        if (!enc->send_pkts[i])
+            return AVERROR(ENOMEM);
+    }
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(sch, &enc->queue, 1, 0, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -862,7 +1105,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(sch, &fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -1546,7 +1789,7 @@ static int start_prepare(Scheduler *sch)
             }
         }
 
-        ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
+        ret = queue_alloc(sch, &mux->queue, mux->nb_streams, mux->queue_size,
                           QUEUE_PACKETS);
         if (ret < 0)
             return ret;
@@ -1868,15 +2111,25 @@ static int mux_queue_packet(SchMux *mux, SchMuxStream *ms, AVPacket *pkt)
     return 0;
 }
 
+/**
+ * Send nb_pkts packets for the given stream to the muxer, or EOF if nb_pkts
+ * is 0.
+ */
 static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
-                       AVPacket *pkt)
+                       AVPacket **pkts, unsigned nb_pkts)
 {
     SchMuxStream *ms = &mux->streams[stream_idx];
-    int64_t dts = (pkt && pkt->dts != AV_NOPTS_VALUE)                                    ?
-                  av_rescale_q(pkt->dts + pkt->duration, pkt->time_base, AV_TIME_BASE_Q) :
-                  AV_NOPTS_VALUE;
+    int64_t dts = AV_NOPTS_VALUE;
+
+    // the trailing dts is determined by the last packet that has one
+    for (unsigned i = nb_pkts; i > 0 && dts == AV_NOPTS_VALUE; i--) {
+        const AVPacket *pkt = pkts[i - 1];
 
-    // queue the packet if the muxer cannot be started yet
+        if (pkt->dts != AV_NOPTS_VALUE)
+            dts = av_rescale_q(pkt->dts + pkt->duration, pkt->time_base, AV_TIME_BASE_Q);
+    }
+
+    // queue the packets if the muxer cannot be started yet
     if (!atomic_load(&mux->mux_started)) {
         int queued = 0;
 
@@ -1885,7 +2138,11 @@ static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
         pthread_mutex_lock(&sch->mux_ready_lock);
 
         if (!atomic_load(&mux->mux_started)) {
-            int ret = mux_queue_packet(mux, ms, pkt);
+            int ret = nb_pkts ? 0 : mux_queue_packet(mux, ms, NULL);
+
+            for (unsigned i = 0; i < nb_pkts && ret >= 0; i++)
+                ret = mux_queue_packet(mux, ms, pkts[i]);
+
             queued = ret < 0 ? ret : 1;
         }
 
@@ -1897,13 +2154,13 @@ static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
             goto update_schedule;
     }
 
-    if (pkt) {
+    if (nb_pkts) {
         int ret;
 
         if (ms->init_eof)
             return AVERROR_EOF;
 
-        ret = tq_send(mux->queue, stream_idx, pkt);
+        ret = tq_send_batch(mux->queue, stream_idx, (void**)pkts, nb_pkts);
         if (ret < 0)
             return ret;
     } else
@@ -1912,11 +2169,11 @@ static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
 update_schedule:
     // TODO: use atomics to check whether this changes trailing dts
     // to avoid locking unnecesarily
-    if (dts != AV_NOPTS_VALUE || !pkt) {
+    if (dts != AV_NOPTS_VALUE || !nb_pkts) {
         pthread_mutex_lock(&sch->schedule_lock);
 
-        if (pkt) ms->last_dts = dts;
-        else     ms->source_finished = 1;
+        if (nb_pkts) ms->last_dts = dts;
+        else         ms->source_finished = 1;
 
         schedule_update_locked(sch);
 
@@ -1928,25 +2185,27 @@ update_schedule:
 
 static int
 demux_stream_send_to_dst(Scheduler *sch, const SchedulerNode dst,
-                         uint8_t *dst_finished, AVPacket *pkt, unsigned flags)
+                         uint8_t *dst_finished, AVPacket **pkts,
+                         unsigned nb_pkts, unsigned flags)
 {
     int ret;
 
     if (*dst_finished)
         return AVERROR_EOF;
 
-    if (pkt && dst.type == SCH_NODE_TYPE_MUX &&
+    if (nb_pkts && dst.type == SCH_NODE_TYPE_MUX &&
         (flags & DEMUX_SEND_STREAMCOPY_EOF)) {
-        av_packet_unref(pkt);
-        pkt = NULL;
+        for (unsigned i = 0; i < nb_pkts; i++)
+            av_packet_unref(pkts[i]);
+        nb_pkts = 0;
     }
 
-    if (!pkt)
+    if (!nb_pkts)
         goto finish;
 
     ret = (dst.type == SCH_NODE_TYPE_MUX) ?
-          send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, pkt) :
-          tq_send(sch->dec[dst.idx].queue, 0, pkt);
+          send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, pkts, nb_pkts) :
+          tq_send_batch(sch->dec[dst.idx].queue, 0, (void**)pkts, nb_pkts);
     if (ret == AVERROR_EOF)
         goto finish;
 
@@ -1954,7 +2213,7 @@ demux_stream_send_to_dst(Scheduler *sch, const SchedulerNode dst,
 
 finish:
     if (dst.type == SCH_NODE_TYPE_MUX)
-        send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, NULL);
+        send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, NULL, 0);
     else
         tq_send_finish(sch->dec[dst.idx].queue, 0);
 
@@ -1963,28 +2222,34 @@ finish:
 }
 
 static int demux_send_for_stream(Scheduler *sch, SchDemux *d, SchDemuxStream *ds,
-                                 AVPacket *pkt, unsigned flags)
+                                 AVPacket **pkts, unsigned nb_pkts, unsigned flags)
 {
     unsigned nb_done = 0;
 
     for (unsigned i = 0; i < ds->nb_dst; i++) {
-        AVPacket *to_send = pkt;
+        AVPacket **to_send = pkts;
         uint8_t *finished = &ds->dst_finished[i];
 
         int ret;
 
-        // sending a packet consumes it, so make a temporary reference if needed
-        if (pkt && i < ds->nb_dst - 1) {
-            to_send = d->send_pkt;
+        // sending a packet consumes it, so make temporary references if needed
+        if (nb_pkts && i < ds->nb_dst - 1) {
+            to_send = d->send_pkts;
 
-            ret = av_packet_ref(to_send, pkt);
-            if (ret < 0)
-                return ret;
+            for (unsigned j = 0; j < nb_pkts; j++) {
+                ret = av_packet_ref(to_send[j], pkts[j]);
+                if (ret < 0) {
+                    while (j--)
+                        av_packet_unref(to_send[j]);
+                    return ret;
+                }
+            }
         }
 
-        ret = demux_stream_send_to_dst(sch, ds->dst[i], finished, to_send, flags);
-        if (to_send)
-            av_packet_unref(to_send);
+        ret = demux_stream_send_to_dst(sch, ds->dst[i], finished,
+                                       to_send, nb_pkts, flags);
+        for (unsigned j = 0; j < nb_pkts; j++)
+            av_packet_unref(to_send[j]);
         if (ret == AVERROR_EOF)
             nb_done++;
         else if (ret < 0)
@@ -2057,7 +2322,37 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
 
     av_assert0(pkt->stream_index < d->nb_streams);
 
-    return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
+    return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index],
+                                 &pkt, 1, flags);
+}
+
+int sch_demux_send_batch(Scheduler *sch, unsigned demux_idx,
+                         AVPacket **pkts, unsigned nb_pkts, unsigned flags)
+{
+    SchDemux *d;
+    int terminate, stream_idx;
+
+    av_assert0(demux_idx < sch->nb_demux);
+    d = &sch->demux[demux_idx];
+
+    av_assert0(nb_pkts > 0 && nb_pkts <= SCH_SEND_BATCH_MAX);
+    stream_idx = pkts[0]->stream_index;
+    av_assert0(stream_idx >= 0 && stream_idx < d->nb_streams);
+    for (unsigned i = 1; i < nb_pkts; i++)
+        av_assert0(pkts[i]->stream_index == stream_idx);
+
+    terminate = waiter_wait(sch, &d->waiter);
+    if (terminate)
+        return AVERROR_EXIT;
+
+    return demux_send_for_stream(sch, d, &d->streams[stream_idx],
+                                 pkts, nb_pkts, flags);
+}
+
+int sch_demux_choked(Scheduler *sch, unsigned demux_idx)
+{
+    av_assert0(demux_idx < sch->nb_demux);
+    return atomic_load(&sch->demux[demux_idx].waiter.choked);
 }
 
 static int demux_done(Scheduler *sch, unsigned demux_idx)
@@ -2066,7 +2361,7 @@ static int demux_done(Scheduler *sch, unsigned demux_idx)
     int ret = 0;
 
     for (unsigned i = 0; i < d->nb_streams; i++) {
-        int err = demux_send_for_stream(sch, d, &d->streams[i], NULL, 0);
+        int err = demux_send_for_stream(sch, d, &d->streams[i], NULL, 0, 0);
         if (err != AVERROR_EOF)
             ret = err_merge(ret, err);
     }
@@ -2177,14 +2472,19 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
     // the decoder should have given us post-flush end timestamp in pkt
     if (dec->expect_end_ts) {
         Timestamp ts = (Timestamp){ .ts = pkt->pts, .tb = pkt->time_base };
+
+        task_slot_release(&dec->task);
         ret = av_thread_message_queue_send(dec->queue_end_ts, &ts, 0);
+        task_slot_acquire(&dec->task);
         if (ret < 0)
             return ret;
 
         dec->expect_end_ts = 0;
     }
 
+    task_slot_release(&dec->task);
     ret = tq_receive(dec->queue, &dummy, pkt);
+    task_slot_acquire(&dec->task);
     av_assert0(dummy <= 0);
 
     // got a flush packet, on the next call to this function the decoder
@@ -2242,20 +2542,11 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx,
-                 unsigned out_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, SchDec *dec, SchDecOutput *o, AVFrame *frame)
 {
-    SchDec *dec;
-    SchDecOutput *o;
     int ret;
     unsigned nb_done = 0;
 
-    av_assert0(dec_idx < sch->nb_dec);
-    dec = &sch->dec[dec_idx];
-
-    av_assert0(out_idx < dec->nb_outputs);
-    o = &dec->outputs[out_idx];
-
     for (unsigned i = 0; i < o->nb_dst; i++) {
         uint8_t *finished = &o->dst_finished[i];
         AVFrame *to_send  = frame;
@@ -2300,6 +2591,25 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx,
+                 unsigned out_idx, AVFrame *frame)
+{
+    SchDec *dec;
+    int ret;
+
+    av_assert0(dec_idx < sch->nb_dec);
+    dec = &sch->dec[dec_idx];
+
+    av_assert0(out_idx < dec->nb_outputs);
+
+    task_slot_release(&dec->task);
+    task_slot_leave(&dec->task, frame);
+    ret = dec_send(sch, dec, &dec->outputs[out_idx], frame);
+    task_slot_acquire(&dec->task);
+
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2348,26 +2658,29 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
     av_assert0(enc_idx < sch->nb_enc);
     enc = &sch->enc[enc_idx];
 
+    task_slot_release(&enc->task);
     ret = tq_receive(enc->queue, &dummy, frame);
+    task_slot_acquire(&enc->task);
     av_assert0(dummy <= 0);
 
     return ret;
 }
 
 static int enc_send_to_dst(Scheduler *sch, const SchedulerNode dst,
-                           uint8_t *dst_finished, AVPacket *pkt)
+                           uint8_t *dst_finished, AVPacket **pkts,
+                           unsigned nb_pkts)
 {
     int ret;
 
     if (*dst_finished)
         return AVERROR_EOF;
 
-    if (!pkt)
+    if (!nb_pkts)
         goto finish;
 
     ret = (dst.type == SCH_NODE_TYPE_MUX) ?
-          send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, pkt) :
-          tq_send(sch->dec[dst.idx].queue, 0, pkt);
+          send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, pkts, nb_pkts) :
+          tq_send_batch(sch->dec[dst.idx].queue, 0, (void**)pkts, nb_pkts);
     if (ret == AVERROR_EOF)
         goto finish;
 
@@ -2375,7 +2688,7 @@ static int enc_send_to_dst(Scheduler *sch, const SchedulerNode dst,
 
 finish:
     if (dst.type == SCH_NODE_TYPE_MUX)
-        send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, NULL);
+        send_to_mux(sch, &sch->mux[dst.idx], dst.idx_stream, NULL, 0);
     else
         tq_send_finish(sch->dec[dst.idx].queue, 0);
 
@@ -2384,7 +2697,8 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+int sch_enc_send_batch(Scheduler *sch, unsigned enc_idx,
+                       AVPacket **pkts, unsigned nb_pkts)
 {
     SchEnc *enc;
     int ret;
@@ -2392,22 +2706,32 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     av_assert0(enc_idx < sch->nb_enc);
     enc = &sch->enc[enc_idx];
 
+    av_assert0(nb_pkts > 0 && nb_pkts <= SCH_SEND_BATCH_MAX);
+
     for (unsigned i = 0; i < enc->nb_dst; i++) {
         uint8_t *finished = &enc->dst_finished[i];
-        AVPacket *to_send = pkt;
+        AVPacket **to_send = pkts;
 
-        // sending a packet consumes it, so make a temporary reference if needed
+        // sending a packet consumes it, so make temporary references if needed
         if (i < enc->nb_dst - 1) {
-            to_send = enc->send_pkt;
+            to_send = enc->send_pkts;
 
-            ret = av_packet_ref(to_send, pkt);
-            if (ret < 0)
-                return ret;
+            for (unsigned j = 0; j < nb_pkts; j++) {
+                ret = av_packet_ref(to_send[j], pkts[j]);
+                if (ret < 0) {
+                    while (j--)
+                        av_packet_unref(to_send[j]);
+                    return ret;
+                }
+            }
         }
 
-        ret = enc_send_to_dst(sch, enc->dst[i], finished, to_send);
+        task_slot_release(&enc->task);
+        ret = enc_send_to_dst(sch, enc->dst[i], finished, to_send, nb_pkts);
+        task_slot_acquire(&enc->task);
         if (ret < 0) {
-            av_packet_unref(to_send);
+            for (unsigned j = 0; j < nb_pkts; j++)
+                av_packet_unref(to_send[j]);
             if (ret == AVERROR_EOF)
                 continue;
             return ret;
@@ -2417,6 +2741,11 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    return sch_enc_send_batch(sch, enc_idx, &pkt, 1);
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2425,7 +2754,7 @@ static int enc_done(Scheduler *sch, unsigned enc_idx)
     tq_receive_finish(enc->queue, 0);
 
     for (unsigned i = 0; i < enc->nb_dst; i++) {
-        int err = enc_send_to_dst(sch, enc->dst[i], &enc->dst_finished[i], NULL);
+        int err = enc_send_to_dst(sch, enc->dst[i], &enc->dst_finished[i], NULL, 0);
         if (err < 0 && err != AVERROR_EOF)
             ret = err_merge(ret, err);
     }
@@ -2457,14 +2786,21 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 
     if (*in_idx == fg->nb_inputs) {
-        int terminate = waiter_wait(sch, &fg->waiter);
+        int terminate;
+
+        task_slot_release(&fg->task);
+        terminate = waiter_wait(sch, &fg->waiter);
+        task_slot_acquire(&fg->task);
+
         return terminate ? AVERROR_EOF : AVERROR(EAGAIN);
     }
 
     while (1) {
         int ret, idx;
 
+        task_slot_release(&fg->task);
         ret = tq_receive(fg->queue, &idx, frame);
+        task_slot_acquire(&fg->task);
         if (idx < 0)
             return AVERROR_EOF;
         else if (ret >= 0) {
@@ -2502,6 +2838,7 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
+    int ret;
 
     av_assert0(fg_idx < sch->nb_filters);
     fg = &sch->filters[fg_idx];
@@ -2509,9 +2846,14 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
     av_assert0(out_idx < fg->nb_outputs);
     dst = fg->outputs[out_idx].dst;
 
-    return (dst.type == SCH_NODE_TYPE_ENC)                                    ?
-           send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
-           send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    task_slot_release(&fg->task);
+    task_slot_leave(&fg->task, frame);
+    ret = (dst.type == SCH_NODE_TYPE_ENC)                                    ?
+          send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
+          send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    task_slot_acquire(&fg->task);
+
+    return ret;
 }
 
 static int filter_done(Scheduler *sch, unsigned fg_idx)
@@ -2572,11 +2914,15 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    task_slot_acquire(task);
+
     ret = task->func(task->func_arg);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
 
+    task_slot_release(task);
+
     err = task_cleanup(sch, task->node);
     ret = err_merge(ret, err);
 
@@ -2609,6 +2955,25 @@ static int task_stop(Scheduler *sch, SchTask *task)
     return (intptr_t)thread_ret;
 }
 
+static void queue_stats_log(void *logctx, const char *desc, ThreadQueue *tq)
+{
+    ThreadQueueStats st;
+
+    tq_stats(tq, &st);
+
+    av_log(logctx, AV_LOG_VERBOSE,
+           "%s queue: %"PRIu64" items sent, %"PRIu64" send waits (%gs), "
+           "%"PRIu64" receive waits (%gs), %"PRIu64" wakeups; "
+           "%"PRIu64" objects reused, %"PRIu64" allocated; depth %u",
+           desc, st.nb_sent, st.nb_send_waits, st.send_stall / 1e6,
+           st.nb_recv_waits, st.recv_stall / 1e6, st.nb_wakeups,
+           st.pool.nb_hits, st.pool.nb_misses, st.depth);
+    if (st.depth_min != st.depth_max)
+        av_log(logctx, AV_LOG_VERBOSE, " (%u-%u, %"PRIu64" changes)",
+               st.depth_min, st.depth_max, st.nb_resizes);
+    av_log(logctx, AV_LOG_VERBOSE, "\n");
+}
+
 int sch_stop(Scheduler *sch, int64_t *finish_ts)
 {
     int ret = 0, err;
@@ -2662,6 +3027,19 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
     if (finish_ts)
         *finish_ts = trailing_dts(sch, 1);
 
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        queue_stats_log(&sch->dec[i], "Packet", sch->dec[i].queue);
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        queue_stats_log(&sch->filters[i], "Frame", sch->filters[i].queue);
+    for (unsigned i = 0; i < sch->nb_enc; i++)
+        queue_stats_log(&sch->enc[i], "Frame", sch->enc[i].queue);
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        queue_stats_log(&sch->mux[i], "Packet", sch->mux[i].queue);
+
+    if (sch->slots.nb_slots)
+        av_log(sch, AV_LOG_VERBOSE, "%u workers, waited for a worker %"PRIu64" times\n",
+               sch->slots.nb_slots, sch->slots.nb_waits);
+
     sch->state = SCH_STATE_STOPPED;
 
     return ret;
@@ -26,6 +26,7 @@
 #include <stdint.h>
 
 #include "ffmpeg_utils.h"
+#include "thread_queue.h"
 
 /*
  * This file contains the API for the transcode scheduler.
@@ -299,6 +300,63 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Select the implementation of the queues used to pass packets and frames
+ * between the scheduler tasks. Must be called before any components are added
+ * to the scheduler.
+ *
+ * @param type "mutex" (default) or "lockfree"
+ */
+int sch_thread_queue_type(Scheduler *sch, const char *type);
+
+/**
+ * Make the depth of the packet queues (the decoder and muxer inputs) adapt to
+ * the observed back-pressure: a queue grows when both its producers and its
+ * consumer keep blocking (bursty traffic) and shrinks when the extra depth is
+ * not needed. Must be called before any components are added to the
+ * scheduler.
+ *
+ * @param depth_min minimum number of packets a queue can hold, at least 1
+ * @param depth_max maximum number of packets a queue can hold
+ * @param frame_depth_max maximum number of frames the frame queues (the
+ *                        filtergraph and encoder inputs) can hold; they start
+ *                        at DEFAULT_FRAME_THREAD_QUEUE_SIZE and only adapt
+ *                        when this is larger, see sch_frame_queue_size_max()
+ */
+int sch_thread_queue_depth(Scheduler *sch, unsigned depth_min,
+                           unsigned depth_max, unsigned frame_depth_max);
+
+/**
+ * @return the largest number of frames a frame queue may hold, which
+ *         decoders with fixed-size frame pools must account for
+ */
+unsigned sch_frame_queue_size_max(const Scheduler *sch);
+
+/**
+ * Get the statistics of an input queue of the scheduler components, may be
+ * called while the scheduler is running.
+ *
+ * @param idx  index of the queue, from 0 to the number of queues - 1
+ * @param node filled with the component the queue feeds
+ * @return 0 on success, AVERROR_EOF if idx is past the last queue
+ */
+int sch_queue_stats(Scheduler *sch, unsigned idx, SchedulerNode *node,
+                    ThreadQueueStats *stats);
+
+/**
+ * Limit the number of decoding, filtering and encoding tasks that may run at
+ * the same time. Every task keeps its own thread; it needs one of nb_workers
+ * execution slots to run, and gives it up whenever it has to wait for its
+ * inputs or outputs, so that the slot can be handed over to a task that is
+ * ready to proceed. Demuxing and muxing tasks, and tasks outputting hardware
+ * frames, are not limited.
+ *
+ * Must be called before sch_start().
+ *
+ * @param nb_workers number of execution slots, 0 for no limit (the default)
+ */
+int sch_workers(Scheduler *sch, int nb_workers);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -361,6 +419,40 @@ enum DemuxSendFlags {
 int sch_demux_send(Scheduler *sch, unsigned demux_idx, struct AVPacket *pkt,
                    unsigned flags);
 
+/**
+ * Maximum number of packets that may be passed to a single call to
+ * sch_demux_send_batch() or sch_enc_send_batch().
+ */
+#define SCH_SEND_BATCH_MAX 16
+
+/**
+ * Same as sch_demux_send(), but sends several packets for the same stream at
+ * once. Compared to calling sch_demux_send() for each of them, the demuxer
+ * waits for its choke state and the destination queues are locked and their
+ * receivers woken up only once per batch.
+ *
+ * @param demux_idx demuxer index
+ * @param pkts Demuxed packets to send. All of them must have the same,
+ *             non-negative, pkt->stream_index; demuxer flushing is not
+ *             supported by this function.
+ * @param nb_pkts Number of packets in pkts, at most SCH_SEND_BATCH_MAX.
+ * @param flags Applied to all the packets.
+ *
+ * @return same as sch_demux_send()
+ */
+int sch_demux_send_batch(Scheduler *sch, unsigned demux_idx,
+                         struct AVPacket **pkts, unsigned nb_pkts,
+                         unsigned flags);
+
+/**
+ * Check whether the demuxer is currently choked, i.e. whether
+ * sch_demux_send() would block because the outputs it feeds are ahead of the
+ * others. May be called from any thread.
+ *
+ * @param demux_idx demuxer index
+ */
+int sch_demux_choked(Scheduler *sch, unsigned demux_idx);
+
 /**
  * Called by decoder tasks to receive a packet for decoding.
  *
@@ -471,6 +563,21 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, struct AVFrame *frame);
  */
 int sch_enc_send   (Scheduler *sch, unsigned enc_idx, struct AVPacket *pkt);
 
+/**
+ * Same as sch_enc_send(), but sends several packets at once, locking the
+ * destination queues and waking up their receivers only once per batch.
+ *
+ * @param enc_idx Encoder index previously returned by sch_add_enc().
+ * @param pkts    Encoded packets; they will be consumed and cleared by this
+ *                function on success.
+ * @param nb_pkts Number of packets in pkts, at most SCH_SEND_BATCH_MAX.
+ *
+ * @retval 0     success
+ * @retval "<0"  Error code.
+ */
+int sch_enc_send_batch(Scheduler *sch, unsigned enc_idx,
+                       struct AVPacket **pkts, unsigned nb_pkts);
+
 /**
  * Called by muxer tasks to obtain packets for muxing. Will wait for a packet
  * for any muxed stream to become available and return it in pkt.
@@ -0,0 +1,161 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "latency_hist.h"
+
+// each power of two is split into (1 << SUB_BITS) linear buckets
+#define SUB_BITS    3
+#define SUB         (1 << SUB_BITS)
+// values are clamped to 32 bits, i.e. a bit over an hour
+#define NB_BUCKETS  ((32 - SUB_BITS + 1) * SUB)
+
+struct LatencyHist {
+    atomic_uint_least64_t buckets[NB_BUCKETS];
+    atomic_int_least64_t  max;
+    atomic_int_least64_t  max_interval;
+
+    // owned by the reader: bucket counts at the end of the previous interval
+    uint64_t              prev[NB_BUCKETS];
+};
+
+static unsigned bucket_idx(uint32_t val)
+{
+    int e;
+
+    if (val < SUB)
+        return val;
+
+    e = av_log2(val) - SUB_BITS;
+    return (e + 1) * SUB + ((val >> e) & (SUB - 1));
+}
+
+// middle of the value range covered by the bucket
+static int64_t bucket_val(unsigned idx)
+{
+    int e;
+
+    if (idx < SUB)
+        return idx;
+
+    e = idx / SUB - 1;
+    return ((int64_t)(SUB + idx % SUB) << e) + ((1 << e) >> 1);
+}
+
+LatencyHist *latency_hist_alloc(void)
+{
+    LatencyHist *h = av_mallocz(sizeof(*h));
+
+    if (!h)
+        return NULL;
+
+    for (int i = 0; i < NB_BUCKETS; i++)
+        atomic_init(&h->buckets[i], 0);
+    atomic_init(&h->max,          0);
+    atomic_init(&h->max_interval, 0);
+
+    return h;
+}
+
+void latency_hist_free(LatencyHist **h)
+{
+    av_freep(h);
+}
+
+static void update_max(atomic_int_least64_t *max, int64_t val)
+{
+    int_least64_t cur = atomic_load_explicit(max, memory_order_relaxed);
+
+    while (val > cur &&
+           !atomic_compare_exchange_weak_explicit(max, &cur, val,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+void latency_hist_add(LatencyHist *h, int64_t val)
+{
+    val = av_clip64(val, 0, UINT32_MAX);
+
+    atomic_fetch_add_explicit(&h->buckets[bucket_idx(val)], 1,
+                              memory_order_relaxed);
+
+    update_max(&h->max,          val);
+    update_max(&h->max_interval, val);
+}
+
+static void hist_stats(const uint64_t *counts, int64_t max,
+                       LatencyHistStats *st)
+{
+    uint64_t nb = 0, rank50, rank99, cum = 0;
+
+    for (int i = 0; i < NB_BUCKETS; i++)
+        nb += counts[i];
+
+    *st = (LatencyHistStats){ .nb_samples = nb, .max = max };
+    if (!nb)
+        return;
+
+    rank50 = (nb * 50 + 99) / 100;
+    rank99 = (nb * 99 + 99) / 100;
+
+    for (int i = 0; i < NB_BUCKETS; i++) {
+        if (!counts[i])
+            continue;
+
+        if (cum < rank50 && cum + counts[i] >= rank50)
+            st->p50 = FFMIN(bucket_val(i), max);
+        cum += counts[i];
+        if (cum >= rank99) {
+            st->p99 = FFMIN(bucket_val(i), max);
+            break;
+        }
+    }
+}
+
+void latency_hist_stats(LatencyHist *h, LatencyHistStats *total,
+                        LatencyHistStats *interval)
+{
+    uint64_t counts[NB_BUCKETS];
+
+    for (int i = 0; i < NB_BUCKETS; i++)
+        counts[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+
+    if (total)
+        hist_stats(counts, atomic_load_explicit(&h->max, memory_order_relaxed),
+                   total);
+
+    if (interval) {
+        int64_t max = atomic_exchange_explicit(&h->max_interval, 0,
+                                               memory_order_relaxed);
+
+        for (int i = 0; i < NB_BUCKETS; i++) {
+            uint64_t cur = counts[i];
+
+            counts[i] -= h->prev[i];
+            h->prev[i] = cur;
+        }
+
+        hist_stats(counts, max, interval);
+    }
+}
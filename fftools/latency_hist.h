@@ -0,0 +1,56 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_LATENCY_HIST_H
+#define FFTOOLS_LATENCY_HIST_H
+
+#include <stdint.h>
+
+/**
+ * Histogram of non-negative durations (in microseconds) with logarithmic
+ * buckets, each covering at most 1/8 of its lower bound.
+ *
+ * Samples are added by a single thread, while statistics may be read
+ * concurrently by another (single) thread.
+ */
+typedef struct LatencyHist LatencyHist;
+
+typedef struct LatencyHistStats {
+    uint64_t nb_samples;
+    int64_t  p50;
+    int64_t  p99;
+    int64_t  max;
+} LatencyHistStats;
+
+LatencyHist *latency_hist_alloc(void);
+void         latency_hist_free(LatencyHist **h);
+
+void latency_hist_add(LatencyHist *h, int64_t val);
+
+/**
+ * Get the statistics of the histogram.
+ *
+ * @param total if non-NULL, statistics over all the samples added so far are
+ *              written here
+ * @param interval if non-NULL, statistics over the samples added since the
+ *                 previous call with a non-NULL interval are written here
+ */
+void latency_hist_stats(LatencyHist *h, LatencyHistStats *total,
+                        LatencyHistStats *interval);
+
+#endif // FFTOOLS_LATENCY_HIST_H
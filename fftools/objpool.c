@@ -16,7 +16,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "libavcodec/packet.h"
 
@@ -24,16 +26,31 @@
 #include "libavutil/error.h"
 #include "libavutil/frame.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 
 #include "objpool.h"
 
+#define CACHE_SIZE 16
+
 struct ObjPool {
     void        *pool[32];
     unsigned int pool_count;
 
+    pthread_mutex_t lock;
+
     ObjPoolCBAlloc alloc;
     ObjPoolCBReset reset;
     ObjPoolCBFree  free;
+
+    atomic_uint_least64_t nb_hits;
+    atomic_uint_least64_t nb_misses;
+};
+
+struct ObjPoolCache {
+    ObjPool     *op;
+
+    void        *objs[CACHE_SIZE];
+    unsigned int nb_objs;
 };
 
 ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
@@ -44,10 +61,18 @@ ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
     if (!op)
         return NULL;
 
+    if (pthread_mutex_init(&op->lock, NULL)) {
+        av_freep(&op);
+        return NULL;
+    }
+
     op->alloc = cb_alloc;
     op->reset = cb_reset;
     op->free  = cb_free;
 
+    atomic_init(&op->nb_hits,   0);
+    atomic_init(&op->nb_misses, 0);
+
     return op;
 }
 
@@ -61,18 +86,65 @@ void objpool_free(ObjPool **pop)
     for (unsigned int i = 0; i < op->pool_count; i++)
         op->free(&op->pool[i]);
 
+    pthread_mutex_destroy(&op->lock);
+
     av_freep(pop);
 }
 
+static int obj_alloc(ObjPool *op, void **obj)
+{
+    *obj = op->alloc();
+    if (!*obj)
+        return AVERROR(ENOMEM);
+
+    atomic_fetch_add_explicit(&op->nb_misses, 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * Move up to nb objects from the pool to dst, return the number moved.
+ */
+static unsigned int pool_take(ObjPool *op, void **dst, unsigned int nb)
+{
+    pthread_mutex_lock(&op->lock);
+
+    nb = FFMIN(nb, op->pool_count);
+    op->pool_count -= nb;
+    memcpy(dst, op->pool + op->pool_count, nb * sizeof(*dst));
+
+    pthread_mutex_unlock(&op->lock);
+
+    return nb;
+}
+
+/**
+ * Move nb already reset objects from src to the pool, freeing the ones that
+ * do not fit.
+ */
+static void pool_put(ObjPool *op, void **src, unsigned int nb)
+{
+    unsigned int nb_put;
+
+    pthread_mutex_lock(&op->lock);
+
+    nb_put = FFMIN(nb, FF_ARRAY_ELEMS(op->pool) - op->pool_count);
+    memcpy(op->pool + op->pool_count, src, nb_put * sizeof(*src));
+    op->pool_count += nb_put;
+
+    pthread_mutex_unlock(&op->lock);
+
+    for (unsigned int i = nb_put; i < nb; i++)
+        op->free(&src[i]);
+}
+
 int  objpool_get(ObjPool *op, void **obj)
 {
-    if (op->pool_count) {
-        *obj = op->pool[--op->pool_count];
-        op->pool[op->pool_count] = NULL;
-    } else
-        *obj = op->alloc();
+    if (pool_take(op, obj, 1)) {
+        atomic_fetch_add_explicit(&op->nb_hits, 1, memory_order_relaxed);
+        return 0;
+    }
 
-    return *obj ? 0 : AVERROR(ENOMEM);
+    return obj_alloc(op, obj);
 }
 
 void objpool_release(ObjPool *op, void **obj)
@@ -82,11 +154,76 @@ void objpool_release(ObjPool *op, void **obj)
 
     op->reset(*obj);
 
-    if (op->pool_count < FF_ARRAY_ELEMS(op->pool))
-        op->pool[op->pool_count++] = *obj;
-    else
-        op->free(obj);
+    pool_put(op, obj, 1);
+
+    *obj = NULL;
+}
+
+void objpool_stats(ObjPool *op, ObjPoolStats *stats)
+{
+    stats->nb_hits   = atomic_load_explicit(&op->nb_hits,   memory_order_relaxed);
+    stats->nb_misses = atomic_load_explicit(&op->nb_misses, memory_order_relaxed);
+}
+
+ObjPoolCache *objpool_cache_alloc(ObjPool *op)
+{
+    ObjPoolCache *c = av_mallocz(sizeof(*c));
+
+    if (!c)
+        return NULL;
+
+    c->op = op;
+
+    return c;
+}
+
+void objpool_cache_free(ObjPoolCache **pc)
+{
+    ObjPoolCache *c = *pc;
+
+    if (!c)
+        return;
+
+    pool_put(c->op, c->objs, c->nb_objs);
+
+    av_freep(pc);
+}
+
+int  objpool_cache_get(ObjPoolCache *c, void **obj)
+{
+    ObjPool *op = c->op;
+
+    // refill half of the cache at once, so that alternating gets and
+    // releases do not keep going back to the pool
+    if (!c->nb_objs)
+        c->nb_objs = pool_take(op, c->objs, CACHE_SIZE / 2);
+
+    if (!c->nb_objs)
+        return obj_alloc(op, obj);
+
+    *obj = c->objs[--c->nb_objs];
+    c->objs[c->nb_objs] = NULL;
+
+    atomic_fetch_add_explicit(&op->nb_hits, 1, memory_order_relaxed);
+    return 0;
+}
+
+void objpool_cache_release(ObjPoolCache *c, void **obj)
+{
+    if (!*obj)
+        return;
+
+    c->op->reset(*obj);
+
+    // hand the older half of a full cache back to the pool
+    if (c->nb_objs == CACHE_SIZE) {
+        pool_put(c->op, c->objs, CACHE_SIZE / 2);
+
+        c->nb_objs -= CACHE_SIZE / 2;
+        memmove(c->objs, c->objs + CACHE_SIZE / 2, c->nb_objs * sizeof(*c->objs));
+    }
 
+    c->objs[c->nb_objs++] = *obj;
     *obj = NULL;
 }
 
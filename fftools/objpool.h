@@ -19,8 +19,35 @@
 #ifndef FFTOOLS_OBJPOOL_H
 #define FFTOOLS_OBJPOOL_H
 
+#include <stdint.h>
+
+/**
+ * A pool of reusable objects. All the functions operating on the pool itself
+ * are thread-safe.
+ */
 typedef struct ObjPool ObjPool;
 
+/**
+ * A small per-thread cache (magazine) of objects in front of an ObjPool.
+ * Getting and releasing objects through the cache does not lock the pool;
+ * it is only accessed when the cache runs empty or full, and then several
+ * objects are exchanged with it at once.
+ *
+ * A cache must not be used by more than one thread at a time.
+ */
+typedef struct ObjPoolCache ObjPoolCache;
+
+typedef struct ObjPoolStats {
+    /**
+     * Number of objects handed out that were reused from the pool or a cache.
+     */
+    uint64_t nb_hits;
+    /**
+     * Number of objects handed out that had to be newly allocated.
+     */
+    uint64_t nb_misses;
+} ObjPoolStats;
+
 typedef void* (*ObjPoolCBAlloc)(void);
 typedef void  (*ObjPoolCBReset)(void *);
 typedef void  (*ObjPoolCBFree)(void **);
@@ -34,4 +61,22 @@ ObjPool *objpool_alloc_frames(void);
 int  objpool_get(ObjPool *op, void **obj);
 void objpool_release(ObjPool *op, void **obj);
 
+/**
+ * Get a snapshot of the pool statistics, including the objects handed out
+ * by all of its caches.
+ */
+void objpool_stats(ObjPool *op, ObjPoolStats *stats);
+
+/**
+ * Allocate a cache for the given pool. The pool must outlive the cache.
+ */
+ObjPoolCache *objpool_cache_alloc(ObjPool *op);
+/**
+ * Return all the objects held by the cache to its pool and free the cache.
+ */
+void          objpool_cache_free(ObjPoolCache **c);
+
+int  objpool_cache_get(ObjPoolCache *c, void **obj);
+void objpool_cache_release(ObjPoolCache *c, void **obj);
+
 #endif // FFTOOLS_OBJPOOL_H
@@ -65,8 +65,22 @@
  * streams 0 and 1 end at t=8 and t=9 respectively. All frames that _end_ at
  * or before t=5 can be output, i.e. the first 3 frames from stream 0, first
  * frame from stream 1, and all 4 frames from stream 2.
+ *
+ * To avoid scanning all the streams on every operation, which gets expensive
+ * with many streams, two binary heaps of stream indices are maintained:
+ * - HEAP_HEAD contains the limiting streams that have a head timestamp,
+ *   ordered by it; the head stream is at its top;
+ * - HEAP_TAIL contains the streams whose tail frame could be output as far as
+ *   the stream itself is concerned, ordered by the tail frame end timestamp;
+ *   when the stream at its top cannot be output, no stream can.
  */
 
+enum {
+    HEAP_HEAD,
+    HEAP_TAIL,
+    NB_HEAPS,
+};
+
 typedef struct SyncQueueStream {
     AVFifo          *fifo;
     AVRational       tb;
@@ -83,6 +97,11 @@ typedef struct SyncQueueStream {
     uint64_t         samples_sent;
     uint64_t         frames_max;
     int              frame_samples;
+
+    /* end timestamp of the tail frame, valid when in HEAP_TAIL */
+    int64_t          tail_ts;
+    /* position of this stream in each heap, -1 if not in it */
+    int              heap_pos[NB_HEAPS];
 } SyncQueueStream;
 
 struct SyncQueue {
@@ -97,12 +116,19 @@ struct SyncQueue {
     int head_stream;
     /* the finished stream with the smallest finish timestamp or -1 */
     int head_finished_stream;
+    /* the stream with the _largest_ head timestamp or -1 */
+    int ahead_stream;
 
     // maximum buffering duration in microseconds
     int64_t buf_size_us;
 
     SyncQueueStream *streams;
     unsigned int  nb_streams;
+    unsigned int  nb_limiting;
+    unsigned int  nb_finished;
+
+    unsigned int *heaps[NB_HEAPS];
+    unsigned int  nb_heap[NB_HEAPS];
 
     // pool of preallocated frames to avoid constant allocations
     ObjPool *pool;
@@ -148,7 +174,144 @@ static int frame_null(const SyncQueue *sq, SyncQueueFrame frame)
     return (sq->type == SYNC_QUEUE_PACKETS) ? (frame.p == NULL) : (frame.f == NULL);
 }
 
-static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
+static int heap_cmp(const SyncQueue *sq, int heap,
+                    unsigned int a, unsigned int b)
+{
+    const SyncQueueStream *sta = &sq->streams[a];
+    const SyncQueueStream *stb = &sq->streams[b];
+    int64_t tsa = (heap == HEAP_HEAD) ? sta->head_ts : sta->tail_ts;
+    int64_t tsb = (heap == HEAP_HEAD) ? stb->head_ts : stb->tail_ts;
+    int cmp;
+
+    // frames with no timestamps can always be output, sort them first
+    if (tsa == AV_NOPTS_VALUE || tsb == AV_NOPTS_VALUE)
+        cmp = (tsb == AV_NOPTS_VALUE) - (tsa == AV_NOPTS_VALUE);
+    else
+        cmp = av_compare_ts(tsa, sta->tb, tsb, stb->tb);
+
+    // prefer lower stream indices on ties, like a linear scan would
+    return cmp ? cmp : (a > b) - (a < b);
+}
+
+static void heap_set(SyncQueue *sq, int heap, unsigned int pos,
+                     unsigned int stream_idx)
+{
+    sq->heaps[heap][pos] = stream_idx;
+    sq->streams[stream_idx].heap_pos[heap] = pos;
+}
+
+static void heap_sift_up(SyncQueue *sq, int heap, unsigned int pos)
+{
+    unsigned int *h = sq->heaps[heap];
+    unsigned int idx = h[pos];
+
+    while (pos) {
+        unsigned int parent = (pos - 1) / 2;
+
+        if (heap_cmp(sq, heap, h[parent], idx) <= 0)
+            break;
+
+        heap_set(sq, heap, pos, h[parent]);
+        pos = parent;
+    }
+
+    heap_set(sq, heap, pos, idx);
+}
+
+static void heap_sift_down(SyncQueue *sq, int heap, unsigned int pos)
+{
+    unsigned int *h = sq->heaps[heap];
+    unsigned int  n = sq->nb_heap[heap];
+    unsigned int idx = h[pos];
+
+    while (1) {
+        unsigned int child = 2 * pos + 1;
+
+        if (child >= n)
+            break;
+        if (child + 1 < n && heap_cmp(sq, heap, h[child + 1], h[child]) < 0)
+            child++;
+        if (heap_cmp(sq, heap, idx, h[child]) <= 0)
+            break;
+
+        heap_set(sq, heap, pos, h[child]);
+        pos = child;
+    }
+
+    heap_set(sq, heap, pos, idx);
+}
+
+/* insert the stream into the heap, or restore the heap order after its key
+ * changed */
+static void heap_update(SyncQueue *sq, int heap, unsigned int stream_idx)
+{
+    int pos = sq->streams[stream_idx].heap_pos[heap];
+
+    if (pos < 0) {
+        pos = sq->nb_heap[heap]++;
+        heap_set(sq, heap, pos, stream_idx);
+    }
+
+    heap_sift_up(sq, heap, pos);
+    heap_sift_down(sq, heap, sq->streams[stream_idx].heap_pos[heap]);
+}
+
+static void heap_remove(SyncQueue *sq, int heap, unsigned int stream_idx)
+{
+    int pos = sq->streams[stream_idx].heap_pos[heap];
+    unsigned int last;
+
+    if (pos < 0)
+        return;
+
+    sq->streams[stream_idx].heap_pos[heap] = -1;
+
+    last = sq->heaps[heap][--sq->nb_heap[heap]];
+    if (last == stream_idx)
+        return;
+
+    heap_set(sq, heap, pos, last);
+    heap_update(sq, heap, last);
+}
+
+/* update the stream's position in HEAP_TAIL after its tail, sample count or
+ * finished state changed */
+static void tail_update(SyncQueue *sq, unsigned int stream_idx)
+{
+    SyncQueueStream *st = &sq->streams[stream_idx];
+    SyncQueueFrame peek;
+    int nb_samples;
+
+    if (!av_fifo_can_read(st->fifo) ||
+        (st->frame_samples > st->samples_queued && !st->finished)) {
+        heap_remove(sq, HEAP_TAIL, stream_idx);
+        return;
+    }
+
+    nb_samples = st->frame_samples;
+    if (st->finished)
+        nb_samples = FFMIN(nb_samples, st->samples_queued);
+
+    av_fifo_peek(st->fifo, &peek, 1, 0);
+    st->tail_ts = frame_end(sq, peek, nb_samples);
+
+    heap_update(sq, HEAP_TAIL, stream_idx);
+}
+
+static void mark_finished(SyncQueue *sq, unsigned int stream_idx)
+{
+    SyncQueueStream *st = &sq->streams[stream_idx];
+
+    if (st->finished)
+        return;
+
+    st->finished = 1;
+    sq->nb_finished++;
+
+    tail_update(sq, stream_idx);
+}
+
+static void tb_update(SyncQueue *sq, SyncQueueStream *st,
                       const SyncQueueFrame frame)
 {
     AVRational tb = (sq->type == SYNC_QUEUE_PACKETS) ?
@@ -166,6 +329,9 @@ static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
         st->head_ts = av_rescale_q(st->head_ts, st->tb, tb);
 
     st->tb = tb;
+
+    if (st->heap_pos[HEAP_HEAD] >= 0)
+        heap_update(sq, HEAP_HEAD, st - sq->streams);
 }
 
 static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
@@ -177,7 +343,7 @@ static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
                "sq: finish %u; head ts %s\n", stream_idx,
                av_ts2timestr(st->head_ts, &st->tb));
 
-    st->finished = 1;
+    mark_finished(sq, stream_idx);
 
     if (st->limiting && st->head_ts != AV_NOPTS_VALUE) {
         /* check if this stream is the new finished head */
@@ -200,53 +366,31 @@ static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
                            "sq: finish secondary %u; head ts %s\n", i,
                            av_ts2timestr(st1->head_ts, &st1->tb));
 
-                st1->finished = 1;
+                mark_finished(sq, i);
             }
         }
     }
 
     /* mark the whole queue as finished if all streams are finished */
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        if (!sq->streams[i].finished)
-            return;
-    }
+    if (sq->nb_finished < sq->nb_streams)
+        return;
     sq->finished = 1;
 
     av_log(sq->logctx, AV_LOG_DEBUG, "sq: finish queue\n");
 }
 
-static void queue_head_update(SyncQueue *sq)
+static void queue_head_update(SyncQueue *sq, unsigned int stream_idx)
 {
     av_assert0(sq->have_limiting);
 
-    if (sq->head_stream < 0) {
-        unsigned first_limiting = UINT_MAX;
-
-        /* wait for one timestamp in each stream before determining
-         * the queue head */
-        for (unsigned int i = 0; i < sq->nb_streams; i++) {
-            SyncQueueStream *st = &sq->streams[i];
-            if (!st->limiting)
-                continue;
-            if (st->head_ts == AV_NOPTS_VALUE)
-                return;
-            if (first_limiting == UINT_MAX)
-                first_limiting = i;
-        }
+    heap_update(sq, HEAP_HEAD, stream_idx);
 
-        // placeholder value, correct one will be found below
-        av_assert0(first_limiting < UINT_MAX);
-        sq->head_stream = first_limiting;
-    }
+    /* wait for one timestamp in each stream before determining
+     * the queue head */
+    if (sq->head_stream < 0 && sq->nb_heap[HEAP_HEAD] < sq->nb_limiting)
+        return;
 
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        SyncQueueStream *st_head  = &sq->streams[sq->head_stream];
-        SyncQueueStream *st_other = &sq->streams[i];
-        if (st_other->limiting && st_other->head_ts != AV_NOPTS_VALUE &&
-            av_compare_ts(st_other->head_ts, st_other->tb,
-                          st_head->head_ts,  st_head->tb) < 0)
-            sq->head_stream = i;
-    }
+    sq->head_stream = sq->heaps[HEAP_HEAD][0];
 }
 
 /* update this stream's head timestamp */
@@ -260,6 +404,11 @@ static void stream_update_ts(SyncQueue *sq, unsigned int stream_idx, int64_t ts)
 
     st->head_ts = ts;
 
+    if (sq->ahead_stream < 0 ||
+        av_compare_ts(ts, st->tb, sq->streams[sq->ahead_stream].head_ts,
+                      sq->streams[sq->ahead_stream].tb) > 0)
+        sq->ahead_stream = stream_idx;
+
     /* if this stream is now ahead of some finished stream, then
      * this stream is also finished */
     if (sq->head_finished_stream >= 0 &&
@@ -268,10 +417,9 @@ static void stream_update_ts(SyncQueue *sq, unsigned int stream_idx, int64_t ts)
                       ts, st->tb) <= 0)
         finish_stream(sq, stream_idx);
 
-    /* update the overall head timestamp if it could have changed */
-    if (st->limiting &&
-        (sq->head_stream < 0 || sq->head_stream == stream_idx))
-        queue_head_update(sq);
+    /* update the overall head timestamp */
+    if (st->limiting)
+        queue_head_update(sq, stream_idx);
 }
 
 /* If the queue for the given stream (or all streams when stream_idx=-1)
@@ -287,18 +435,7 @@ static int overflow_heartbeat(SyncQueue *sq, int stream_idx)
 
     /* if no stream specified, pick the one that is most ahead */
     if (stream_idx < 0) {
-        int64_t ts = AV_NOPTS_VALUE;
-
-        for (int i = 0; i < sq->nb_streams; i++) {
-            st = &sq->streams[i];
-            if (st->head_ts != AV_NOPTS_VALUE &&
-                (ts == AV_NOPTS_VALUE ||
-                 av_compare_ts(ts, sq->streams[stream_idx].tb,
-                               st->head_ts, st->tb) < 0)) {
-                ts = st->head_ts;
-                stream_idx = i;
-            }
-        }
+        stream_idx = sq->ahead_stream;
         /* no stream has a timestamp yet -> nothing to do */
         if (stream_idx < 0)
             return 0;
@@ -391,6 +528,8 @@ int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
     st->samples_queued += nb_samples;
     st->samples_sent   += nb_samples;
 
+    tail_update(sq, stream_idx);
+
     if (st->frame_samples)
         st->frames_sent = st->samples_sent / st->frame_samples;
     else
@@ -567,6 +706,8 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
                 st->samples_queued -= frame_samples(sq, frame);
             }
 
+            tail_update(sq, stream_idx);
+
             av_log(sq->logctx, AV_LOG_DEBUG,
                    "sq: receive %u ts %s queue head %d ts %s\n", stream_idx,
                    av_ts2timestr(frame_end(sq, frame, 0), &st->tb),
@@ -583,7 +724,6 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
 
 static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
 {
-    int nb_eof = 0;
     int ret;
 
     /* read a frame for a specific stream */
@@ -592,17 +732,19 @@ static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
         return (ret < 0) ? ret : stream_idx;
     }
 
-    /* read a frame for any stream with available output */
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+    /* read a frame for any stream with available output; if the stream with
+     * the earliest tail frame has none, no other stream does */
+    if (sq->nb_heap[HEAP_TAIL]) {
+        const unsigned int i = sq->heaps[HEAP_TAIL][0];
+
         ret = receive_for_stream(sq, i, frame);
-        if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN)) {
-            nb_eof += (ret == AVERROR_EOF);
-            continue;
-        }
-        return (ret < 0) ? ret : i;
+        if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN))
+            return (ret < 0) ? ret : i;
     }
 
-    return (nb_eof == sq->nb_streams) ? AVERROR_EOF : AVERROR(EAGAIN);
+    /* all streams return EOF once the queue is finished, and some stream is
+     * not finished yet otherwise */
+    return (sq->finished || !sq->nb_streams) ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
 int sq_receive(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
@@ -621,6 +763,14 @@ int sq_add_stream(SyncQueue *sq, int limiting)
 {
     SyncQueueStream *tmp, *st;
 
+    for (int i = 0; i < NB_HEAPS; i++) {
+        unsigned int *heap = av_realloc_array(sq->heaps[i], sq->nb_streams + 1,
+                                              sizeof(*heap));
+        if (!heap)
+            return AVERROR(ENOMEM);
+        sq->heaps[i] = heap;
+    }
+
     tmp = av_realloc_array(sq->streams, sq->nb_streams + 1, sizeof(*sq->streams));
     if (!tmp)
         return AVERROR(ENOMEM);
@@ -641,7 +791,11 @@ int sq_add_stream(SyncQueue *sq, int limiting)
     st->frames_max = UINT64_MAX;
     st->limiting   = limiting;
 
+    for (int i = 0; i < NB_HEAPS; i++)
+        st->heap_pos[i] = -1;
+
     sq->have_limiting |= limiting;
+    sq->nb_limiting   += !!limiting;
 
     return sq->nb_streams++;
 }
@@ -670,6 +824,8 @@ void sq_frame_samples(SyncQueue *sq, unsigned int stream_idx,
     st->frame_samples = frame_samples;
 
     sq->align_mask = av_cpu_max_align() - 1;
+
+    tail_update(sq, stream_idx);
 }
 
 SyncQueue *sq_alloc(enum SyncQueueType type, int64_t buf_size_us, void *logctx)
@@ -685,6 +841,7 @@ SyncQueue *sq_alloc(enum SyncQueueType type, int64_t buf_size_us, void *logctx)
 
     sq->head_stream          = -1;
     sq->head_finished_stream = -1;
+    sq->ahead_stream         = -1;
 
     sq->pool = (type == SYNC_QUEUE_PACKETS) ? objpool_alloc_packets() :
                                               objpool_alloc_frames();
@@ -713,6 +870,9 @@ void sq_free(SyncQueue **psq)
 
     av_freep(&sq->streams);
 
+    for (int i = 0; i < NB_HEAPS; i++)
+        av_freep(&sq->heaps[i]);
+
     objpool_free(&sq->pool);
 
     av_freep(psq);
@@ -16,15 +16,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/common.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include "objpool.h"
 #include "thread_queue.h"
@@ -34,24 +37,224 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+// minimum number of items received between two depth adaptations
+#define ADAPT_MIN_ITEMS     32
+// stall time, relative to the adaptation window, considered significant
+#define ADAPT_STALL_RATIO   20
+// number of consecutive windows with no significant stalls before shrinking
+#define ADAPT_CALM_WINDOWS  4
+
 typedef struct FifoElem {
     void        *obj;
     unsigned int stream_idx;
 } FifoElem;
 
+/**
+ * A slot in the lock-free ring. The sequence number encodes the slot state
+ * relative to the ring position pos the slot is used for:
+ *
+ * seq == 2 * pos:          the slot is free for the producer claiming pos
+ * seq == 2 * pos + 1:      the slot contains the item written at pos
+ * seq == 2 * (pos + size): the item at pos was consumed, the slot is free for
+ *                          the producer claiming pos + size
+ *
+ * The factor of two keeps the free and full states distinct for size=1.
+ */
+typedef struct RingSlot {
+    atomic_uint_least64_t seq;
+    void           *obj;
+    unsigned int    stream_idx;
+} RingSlot;
+
+/**
+ * Parking spot for threads that cannot proceed. Waking threads only touch the
+ * mutex when nb_waiters is nonzero.
+ */
+typedef struct Parking {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    atomic_int      nb_waiters;
+} Parking;
+
 struct ThreadQueue {
-    int              *finished;
-    unsigned int    nb_streams;
+    enum ThreadQueueType type;
 
-    AVFifo  *fifo;
+    atomic_int       *finished;
+    unsigned int    nb_streams;
 
     ObjPool *obj_pool;
     void   (*obj_move)(void *dst, void *src);
 
+    // maximum number of queued items; the fifo/ring is allocated for
+    // depth_max items and depth varies between depth_min and depth_max
+    atomic_uint     depth;
+    unsigned int    depth_min;
+    unsigned int    depth_max;
+
+    // depth adaptation state, only accessed by the receiving thread
+    unsigned int    adapt_nb_items;
+    unsigned int    adapt_nb_calm;
+    int64_t         adapt_start;
+    uint64_t        adapt_send_stall;
+    uint64_t        adapt_recv_stall;
+
+    // THREAD_QUEUE_MUTEX
+    AVFifo  *fifo;
+    // object cache for the senders, only accessed with lock held
+    ObjPoolCache *send_cache;
+    // object cache for the receiving thread, accessed without locking
+    ObjPoolCache *recv_cache;
+
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    // THREAD_QUEUE_LOCKFREE
+    RingSlot       *ring;
+    size_t          ring_size;
+    // next position to be claimed by a producer
+    atomic_uint_least64_t tail;
+    // next position to be read, only written by the consumer
+    atomic_uint_least64_t head;
+
+    Parking         park_send;
+    Parking         park_recv;
+
+    atomic_uint_least64_t nb_sent;
+    atomic_uint_least64_t nb_send_waits;
+    atomic_uint_least64_t nb_recv_waits;
+    atomic_uint_least64_t nb_wakeups;
+    atomic_uint_least64_t nb_resizes;
+    // total time spent blocked, in microseconds
+    atomic_uint_least64_t send_stall;
+    atomic_uint_least64_t recv_stall;
 };
 
+static int parking_init(Parking *p)
+{
+    int ret;
+
+    atomic_init(&p->nb_waiters, 0);
+
+    ret = pthread_mutex_init(&p->lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+
+    ret = pthread_cond_init(&p->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&p->lock);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+static void parking_uninit(Parking *p)
+{
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+}
+
+static void parking_wake(ThreadQueue *tq, Parking *p, int all)
+{
+    // pairs with the increment of nb_waiters in the parking thread, which
+    // rechecks the queue state after announcing itself
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!atomic_load_explicit(&p->nb_waiters, memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    if (all)
+        pthread_cond_broadcast(&p->cond);
+    else
+        pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+
+    atomic_fetch_add_explicit(&tq->nb_wakeups, 1, memory_order_relaxed);
+}
+
+/**
+ * Block until can_proceed() returns nonzero or another thread wakes us up.
+ * Spurious returns are allowed, the caller must recheck its state.
+ */
+static void parking_wait(ThreadQueue *tq, Parking *p,
+                         int (*can_proceed)(ThreadQueue *tq, void *opaque),
+                         void *opaque)
+{
+    pthread_mutex_lock(&p->lock);
+
+    atomic_fetch_add(&p->nb_waiters, 1);
+    if (!can_proceed(tq, opaque))
+        pthread_cond_wait(&p->cond, &p->lock);
+    atomic_fetch_sub(&p->nb_waiters, 1);
+
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void stall_add(atomic_uint_least64_t *stall, int64_t start)
+{
+    atomic_fetch_add_explicit(stall, av_gettime_relative() - start,
+                              memory_order_relaxed);
+}
+
+/**
+ * Called by the receiver for every received item. Once per window, update
+ * the queue depth according to the time the sides spent blocked:
+ * - when both the senders and the receiver stalled significantly, the flow
+ *   is bursty and a deeper queue lets both sides keep running, so the depth
+ *   is doubled
+ * - when only the senders stalled, the receiver is the bottleneck and the
+ *   queue is full all the time, extra depth only adds memory and latency
+ * - when nobody stalled for several windows, the depth is not needed
+ * in the latter two cases the depth is decremented.
+ *
+ * @return 1 if the depth was increased, so the senders need to be woken up
+ */
+static int adapt_depth(ThreadQueue *tq)
+{
+    unsigned int depth = atomic_load_explicit(&tq->depth, memory_order_relaxed);
+    unsigned int new_depth = depth;
+    uint64_t send_stall, recv_stall;
+    int64_t now, elapsed;
+    int send_stalled, recv_stalled;
+
+    if (tq->depth_min == tq->depth_max ||
+        ++tq->adapt_nb_items < FFMAX(ADAPT_MIN_ITEMS, 4 * depth))
+        return 0;
+
+    now        = av_gettime_relative();
+    send_stall = atomic_load_explicit(&tq->send_stall, memory_order_relaxed);
+    recv_stall = atomic_load_explicit(&tq->recv_stall, memory_order_relaxed);
+
+    elapsed      = FFMAX(now - tq->adapt_start, 1);
+    send_stalled = (send_stall - tq->adapt_send_stall) * ADAPT_STALL_RATIO > elapsed;
+    recv_stalled = (recv_stall - tq->adapt_recv_stall) * ADAPT_STALL_RATIO > elapsed;
+
+    tq->adapt_nb_items   = 0;
+    tq->adapt_start      = now;
+    tq->adapt_send_stall = send_stall;
+    tq->adapt_recv_stall = recv_stall;
+
+    if (send_stalled && recv_stalled) {
+        new_depth         = FFMIN(2 * depth, tq->depth_max);
+        tq->adapt_nb_calm = 0;
+    } else if (send_stalled) {
+        new_depth         = FFMAX(depth - 1, tq->depth_min);
+        tq->adapt_nb_calm = 0;
+    } else if (!recv_stalled && ++tq->adapt_nb_calm >= ADAPT_CALM_WINDOWS) {
+        new_depth         = FFMAX(depth - 1, tq->depth_min);
+        tq->adapt_nb_calm = 0;
+    }
+
+    if (new_depth == depth)
+        return 0;
+
+    atomic_store(&tq->depth, new_depth);
+    atomic_fetch_add_explicit(&tq->nb_resizes, 1, memory_order_relaxed);
+
+    return new_depth > depth;
+}
+
 void tq_free(ThreadQueue **ptq)
 {
     ThreadQueue *tq = *ptq;
@@ -66,18 +269,58 @@ void tq_free(ThreadQueue **ptq)
     }
     av_fifo_freep2(&tq->fifo);
 
+    objpool_cache_free(&tq->send_cache);
+    objpool_cache_free(&tq->recv_cache);
+
+    if (tq->ring) {
+        for (size_t i = 0; i < tq->ring_size; i++)
+            objpool_release(tq->obj_pool, &tq->ring[i].obj);
+    }
+    av_freep(&tq->ring);
+
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
 
+    parking_uninit(&tq->park_send);
+    parking_uninit(&tq->park_recv);
+
     pthread_cond_destroy(&tq->cond);
     pthread_mutex_destroy(&tq->lock);
 
     av_freep(ptq);
 }
 
+static int ring_alloc(ThreadQueue *tq, size_t queue_size, ObjPool *obj_pool)
+{
+    tq->ring = av_calloc(queue_size, sizeof(*tq->ring));
+    if (!tq->ring)
+        return AVERROR(ENOMEM);
+
+    // every slot owns an object for its whole lifetime, so that the
+    // producers never need to touch the (non-thread-safe) object pool
+    for (size_t i = 0; i < queue_size; i++) {
+        int ret = objpool_get(obj_pool, &tq->ring[i].obj);
+        if (ret < 0) {
+            while (i--)
+                objpool_release(obj_pool, &tq->ring[i].obj);
+            av_freep(&tq->ring);
+            return ret;
+        }
+
+        atomic_init(&tq->ring[i].seq, 2 * i);
+    }
+    tq->ring_size = queue_size;
+
+    atomic_init(&tq->tail, 0);
+    atomic_init(&tq->head, 0);
+
+    return 0;
+}
+
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src))
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      enum ThreadQueueType type)
 {
     ThreadQueue *tq;
     int ret;
@@ -99,14 +342,47 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         return NULL;
     }
 
+    ret = parking_init(&tq->park_send);
+    if (ret < 0) {
+        pthread_mutex_destroy(&tq->lock);
+        pthread_cond_destroy(&tq->cond);
+        av_freep(&tq);
+        return NULL;
+    }
+
+    ret = parking_init(&tq->park_recv);
+    if (ret < 0) {
+        parking_uninit(&tq->park_send);
+        pthread_mutex_destroy(&tq->lock);
+        pthread_cond_destroy(&tq->cond);
+        av_freep(&tq);
+        return NULL;
+    }
+
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
     tq->nb_streams = nb_streams;
 
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
-        goto fail;
+    tq->type = type;
+
+    atomic_init(&tq->depth, queue_size);
+    tq->depth_min = tq->depth_max = queue_size;
+
+    if (type == THREAD_QUEUE_LOCKFREE) {
+        ret = ring_alloc(tq, queue_size, obj_pool);
+        if (ret < 0)
+            goto fail;
+    } else {
+        tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
+        if (!tq->fifo)
+            goto fail;
+
+        tq->send_cache = objpool_cache_alloc(obj_pool);
+        tq->recv_cache = objpool_cache_alloc(obj_pool);
+        if (!tq->send_cache || !tq->recv_cache)
+            goto fail;
+    }
 
     tq->obj_pool = obj_pool;
     tq->obj_move = obj_move;
@@ -117,13 +393,52 @@ fail:
     return NULL;
 }
 
-int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+int tq_set_depth_range(ThreadQueue *tq, unsigned int depth_min,
+                       unsigned int depth_max)
 {
-    int *finished;
+    unsigned int depth = atomic_load(&tq->depth);
     int ret;
 
-    av_assert0(stream_idx < tq->nb_streams);
-    finished = &tq->finished[stream_idx];
+    av_assert0(depth_min > 0 && depth_min <= depth_max);
+
+    if (tq->type == THREAD_QUEUE_LOCKFREE) {
+        if (depth_max != tq->ring_size) {
+            for (size_t i = 0; i < tq->ring_size; i++)
+                objpool_release(tq->obj_pool, &tq->ring[i].obj);
+            av_freep(&tq->ring);
+            tq->ring_size = 0;
+
+            ret = ring_alloc(tq, depth_max, tq->obj_pool);
+            if (ret < 0)
+                return ret;
+        }
+    } else if (depth_max > av_fifo_can_write(tq->fifo)) {
+        ret = av_fifo_grow2(tq->fifo, depth_max - av_fifo_can_write(tq->fifo));
+        if (ret < 0)
+            return ret;
+    }
+
+    tq->depth_min = depth_min;
+    tq->depth_max = depth_max;
+    atomic_store(&tq->depth, av_clip(depth, depth_min, depth_max));
+
+    tq->adapt_start = av_gettime_relative();
+
+    return 0;
+}
+
+static void mutex_signal(ThreadQueue *tq)
+{
+    pthread_cond_broadcast(&tq->cond);
+    atomic_fetch_add_explicit(&tq->nb_wakeups, 1, memory_order_relaxed);
+}
+
+static int mutex_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                            void **data, unsigned int nb_items)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    unsigned int nb_sent = 0, nb_pending = 0;
+    int ret = 0;
 
     pthread_mutex_lock(&tq->lock);
 
@@ -132,46 +447,69 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
         goto finish;
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo))
-        pthread_cond_wait(&tq->cond, &tq->lock);
-
-    if (*finished & FINISHED_RECV) {
-        ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
-    } else {
+    while (nb_sent < nb_items) {
         FifoElem elem = { .stream_idx = stream_idx };
 
-        ret = objpool_get(tq->obj_pool, &elem.obj);
+        while (!(*finished & FINISHED_RECV) &&
+               av_fifo_can_read(tq->fifo) >= atomic_load(&tq->depth)) {
+            int64_t start;
+
+            // let the receiver drain what was sent so far
+            if (nb_pending) {
+                mutex_signal(tq);
+                nb_pending = 0;
+            }
+
+            atomic_fetch_add_explicit(&tq->nb_send_waits, 1, memory_order_relaxed);
+            start = av_gettime_relative();
+            pthread_cond_wait(&tq->cond, &tq->lock);
+            stall_add(&tq->send_stall, start);
+        }
+
+        if (*finished & FINISHED_RECV) {
+            ret = AVERROR_EOF;
+            *finished |= FINISHED_SEND;
+            break;
+        }
+
+        ret = objpool_cache_get(tq->send_cache, &elem.obj);
         if (ret < 0)
-            goto finish;
+            break;
 
-        tq->obj_move(elem.obj, data);
+        tq->obj_move(elem.obj, data[nb_sent++]);
 
         ret = av_fifo_write(tq->fifo, &elem, 1);
         av_assert0(ret >= 0);
-        pthread_cond_broadcast(&tq->cond);
+        nb_pending++;
     }
 
+    if (nb_pending)
+        mutex_signal(tq);
+    atomic_fetch_add_explicit(&tq->nb_sent, nb_sent, memory_order_relaxed);
+
 finish:
     pthread_mutex_unlock(&tq->lock);
 
     return ret;
 }
 
+/**
+ * On success, the received object is returned in obj. Moving its contents
+ * out and recycling it is left to the caller, to be done after unlocking.
+ */
 static int receive_locked(ThreadQueue *tq, int *stream_idx,
-                          void *data)
+                          void **obj)
 {
     FifoElem elem;
     unsigned int nb_finished = 0;
 
     while (av_fifo_read(tq->fifo, &elem, 1) >= 0) {
         if (tq->finished[elem.stream_idx] & FINISHED_RECV) {
-            objpool_release(tq->obj_pool, &elem.obj);
+            objpool_cache_release(tq->recv_cache, &elem.obj);
             continue;
         }
 
-        tq->obj_move(data, elem.obj);
-        objpool_release(tq->obj_pool, &elem.obj);
+        *obj        = elem.obj;
         *stream_idx = elem.stream_idx;
         return 0;
     }
@@ -193,25 +531,32 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
-int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
+static int mutex_receive(ThreadQueue *tq, int *stream_idx, void *data)
 {
+    void *obj = NULL;
     int ret;
 
-    *stream_idx = -1;
-
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
         size_t can_read = av_fifo_can_read(tq->fifo);
 
-        ret = receive_locked(tq, stream_idx, data);
+        int grown = 0;
+
+        ret = receive_locked(tq, stream_idx, &obj);
+        if (ret >= 0)
+            grown = adapt_depth(tq);
 
         // signal other threads if the fifo state changed
-        if (can_read != av_fifo_can_read(tq->fifo))
-            pthread_cond_broadcast(&tq->cond);
+        if (can_read != av_fifo_can_read(tq->fifo) || grown)
+            mutex_signal(tq);
 
         if (ret == AVERROR(EAGAIN)) {
+            int64_t start = av_gettime_relative();
+
+            atomic_fetch_add_explicit(&tq->nb_recv_waits, 1, memory_order_relaxed);
             pthread_cond_wait(&tq->cond, &tq->lock);
+            stall_add(&tq->recv_stall, start);
             continue;
         }
 
@@ -220,20 +565,274 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     pthread_mutex_unlock(&tq->lock);
 
+    if (obj) {
+        tq->obj_move(data, obj);
+        objpool_cache_release(tq->recv_cache, &obj);
+    }
+
+    return ret;
+}
+
+/**
+ * Claim the next free slot in the ring for writing.
+ *
+ * @return the claimed slot, its position is written into pos;
+ *         NULL if the ring is full
+ */
+static RingSlot *ring_claim(ThreadQueue *tq, uint64_t *ppos)
+{
+    uint64_t pos = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+
+    while (1) {
+        RingSlot *slot = &tq->ring[pos % tq->ring_size];
+        uint64_t   seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t   diff = (int64_t)(seq - 2 * pos);
+
+        // the ring may be allocated larger than the current depth
+        if ((int64_t)(pos - atomic_load(&tq->head)) >= atomic_load(&tq->depth))
+            return NULL;
+
+        if (!diff) {
+            // on failure pos is updated to the current tail
+            if (atomic_compare_exchange_weak_explicit(&tq->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *ppos = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // the slot still contains an item that was not consumed yet
+            return NULL;
+        } else
+            pos = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+    }
+}
+
+static int ring_can_send(ThreadQueue *tq, void *opaque)
+{
+    const unsigned int stream_idx = *(unsigned int*)opaque;
+    uint64_t pos = atomic_load(&tq->tail);
+    uint64_t seq = atomic_load(&tq->ring[pos % tq->ring_size].seq);
+
+    return ((int64_t)(seq - 2 * pos) >= 0 &&
+            (int64_t)(pos - atomic_load(&tq->head)) < atomic_load(&tq->depth)) ||
+           (atomic_load(&tq->finished[stream_idx]) & FINISHED_RECV);
+}
+
+static int ring_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                           void **data, unsigned int nb_items)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    unsigned int nb_sent = 0, nb_pending = 0;
+    int ret = 0;
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    while (nb_sent < nb_items) {
+        RingSlot *slot;
+        uint64_t  pos;
+        int64_t   start;
+
+        if (atomic_load(finished) & FINISHED_RECV) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        slot = ring_claim(tq, &pos);
+        if (slot) {
+            tq->obj_move(slot->obj, data[nb_sent++]);
+            slot->stream_idx = stream_idx;
+
+            atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_release);
+            nb_pending++;
+            continue;
+        }
+
+        // the receiver may be parked waiting for the items sent so far
+        if (nb_pending) {
+            parking_wake(tq, &tq->park_recv, 0);
+            nb_pending = 0;
+        }
+
+        atomic_fetch_add_explicit(&tq->nb_send_waits, 1, memory_order_relaxed);
+        start = av_gettime_relative();
+        parking_wait(tq, &tq->park_send, ring_can_send, &stream_idx);
+        stall_add(&tq->send_stall, start);
+    }
+
+    if (nb_pending)
+        parking_wake(tq, &tq->park_recv, 0);
+    atomic_fetch_add_explicit(&tq->nb_sent, nb_sent, memory_order_relaxed);
+
     return ret;
 }
 
+/**
+ * @return 1 if the item at the ring head is available,
+ *         0 if the ring is empty,
+ *         AVERROR(EAGAIN) if the item at the head is still being written
+ */
+static int ring_peek(ThreadQueue *tq, RingSlot **pslot)
+{
+    uint64_t  head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+    RingSlot *slot = &tq->ring[head % tq->ring_size];
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) == 2 * head + 1) {
+        *pslot = slot;
+        return 1;
+    }
+
+    return atomic_load(&tq->tail) == head ? 0 : AVERROR(EAGAIN);
+}
+
+static void ring_consume(ThreadQueue *tq, RingSlot *slot, int adapt)
+{
+    uint64_t head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+    int grown = adapt && adapt_depth(tq);
+
+    atomic_store_explicit(&slot->seq, 2 * (head + tq->ring_size),
+                          memory_order_release);
+    atomic_store(&tq->head, head + 1);
+
+    parking_wake(tq, &tq->park_send, grown);
+}
+
+static int ring_can_receive(ThreadQueue *tq, void *opaque)
+{
+    unsigned int nb_finished = 0;
+    RingSlot *slot;
+    int ret;
+
+    ret = ring_peek(tq, &slot);
+    if (ret)
+        return ret > 0;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
+            continue;
+        if (!(finished & FINISHED_RECV))
+            return 1;
+        nb_finished++;
+    }
+
+    return nb_finished == tq->nb_streams;
+}
+
+static int ring_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    while (1) {
+        unsigned int nb_finished = 0;
+        int retry = 0;
+        RingSlot *slot;
+        int64_t start;
+        int ret;
+
+        ret = ring_peek(tq, &slot);
+        if (ret > 0) {
+            const unsigned int idx = slot->stream_idx;
+
+            if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
+                // the consumer is no longer interested in this stream;
+                // reset the object by cycling it through the pool, which is
+                // only ever touched by the consumer in this mode
+                objpool_release(tq->obj_pool, &slot->obj);
+                ret = objpool_get(tq->obj_pool, &slot->obj);
+                av_assert0(ret >= 0);
+
+                ring_consume(tq, slot, 0);
+                continue;
+            }
+
+            tq->obj_move(data, slot->obj);
+            ring_consume(tq, slot, 1);
+
+            *stream_idx = idx;
+            return 0;
+        } else if (ret == AVERROR(EAGAIN))
+            goto wait;
+
+        for (unsigned int i = 0; i < tq->nb_streams; i++) {
+            int finished = atomic_load(&tq->finished[i]);
+
+            if (!finished)
+                continue;
+
+            /* return EOF to the consumer at most once for each stream */
+            if (!(finished & FINISHED_RECV)) {
+                // items sent before the stream was finished must be
+                // delivered before the EOF; they are visible now if the
+                // ring was not empty after all
+                if (atomic_load(&tq->tail) != atomic_load(&tq->head)) {
+                    retry = 1;
+                    break;
+                }
+
+                atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+                *stream_idx = i;
+                return AVERROR_EOF;
+            }
+
+            nb_finished++;
+        }
+
+        if (retry)
+            continue;
+        if (nb_finished == tq->nb_streams)
+            return AVERROR_EOF;
+
+wait:
+        atomic_fetch_add_explicit(&tq->nb_recv_waits, 1, memory_order_relaxed);
+        start = av_gettime_relative();
+        parking_wait(tq, &tq->park_recv, ring_can_receive, NULL);
+        stall_add(&tq->recv_stall, start);
+    }
+}
+
+int tq_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                  void **data, unsigned int nb_items)
+{
+    av_assert0(stream_idx < tq->nb_streams);
+
+    return (tq->type == THREAD_QUEUE_LOCKFREE) ?
+           ring_send_batch (tq, stream_idx, data, nb_items) :
+           mutex_send_batch(tq, stream_idx, data, nb_items);
+}
+
+int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    return tq_send_batch(tq, stream_idx, &data, 1);
+}
+
+int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    *stream_idx = -1;
+
+    return (tq->type == THREAD_QUEUE_LOCKFREE) ?
+           ring_receive (tq, stream_idx, data) :
+           mutex_receive(tq, stream_idx, data);
+}
+
 void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->type == THREAD_QUEUE_LOCKFREE) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+        parking_wake(tq, &tq->park_recv, 0);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
     tq->finished[stream_idx] |= FINISHED_SEND;
-    pthread_cond_broadcast(&tq->cond);
+    mutex_signal(tq);
 
     pthread_mutex_unlock(&tq->lock);
 }
@@ -242,13 +841,38 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->type == THREAD_QUEUE_LOCKFREE) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
+        // all the senders blocked on a full queue need to recheck their
+        // stream state
+        parking_wake(tq, &tq->park_send, 1);
+        parking_wake(tq, &tq->park_recv, 0);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
     tq->finished[stream_idx] |= FINISHED_RECV;
-    pthread_cond_broadcast(&tq->cond);
+    mutex_signal(tq);
 
     pthread_mutex_unlock(&tq->lock);
 }
+
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats)
+{
+    stats->nb_sent       = atomic_load_explicit(&tq->nb_sent,       memory_order_relaxed);
+    stats->nb_send_waits = atomic_load_explicit(&tq->nb_send_waits, memory_order_relaxed);
+    stats->nb_recv_waits = atomic_load_explicit(&tq->nb_recv_waits, memory_order_relaxed);
+    stats->nb_wakeups    = atomic_load_explicit(&tq->nb_wakeups,    memory_order_relaxed);
+    stats->nb_resizes    = atomic_load_explicit(&tq->nb_resizes,    memory_order_relaxed);
+    stats->send_stall    = atomic_load_explicit(&tq->send_stall,    memory_order_relaxed);
+    stats->recv_stall    = atomic_load_explicit(&tq->recv_stall,    memory_order_relaxed);
+    stats->depth         = atomic_load_explicit(&tq->depth,         memory_order_relaxed);
+    stats->depth_min     = tq->depth_min;
+    stats->depth_max     = tq->depth_max;
+
+    objpool_stats(tq->obj_pool, &stats->pool);
+}
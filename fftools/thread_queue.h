@@ -19,12 +19,68 @@
 #ifndef FFTOOLS_THREAD_QUEUE_H
 #define FFTOOLS_THREAD_QUEUE_H
 
+#include <stdint.h>
 #include <string.h>
 
 #include "objpool.h"
 
 typedef struct ThreadQueue ThreadQueue;
 
+enum ThreadQueueType {
+    /**
+     * All operations are serialized through a single mutex, every state
+     * change wakes up all the waiting threads.
+     */
+    THREAD_QUEUE_MUTEX,
+    /**
+     * Items are passed through a lock-free bounded ring buffer (multiple
+     * producers, single consumer). Threads only park on a mutex/condition
+     * pair when the queue is actually full (sending) or empty (receiving),
+     * and are only woken up when somebody is parked.
+     */
+    THREAD_QUEUE_LOCKFREE,
+};
+
+typedef struct ThreadQueueStats {
+    /**
+     * Number of items that went through the queue.
+     */
+    uint64_t nb_sent;
+    /**
+     * Number of times a sender had to wait because the queue was full.
+     */
+    uint64_t nb_send_waits;
+    /**
+     * Number of times the receiver had to wait because the queue was empty.
+     */
+    uint64_t nb_recv_waits;
+    /**
+     * Number of times a waiting thread was signalled.
+     */
+    uint64_t nb_wakeups;
+    /**
+     * Total time senders/the receiver spent blocked, in microseconds.
+     */
+    uint64_t send_stall;
+    uint64_t recv_stall;
+    /**
+     * Current maximum number of queued items and its bounds, see
+     * tq_set_depth_range().
+     */
+    unsigned int depth;
+    unsigned int depth_min;
+    unsigned int depth_max;
+    /**
+     * Number of times the depth was changed.
+     */
+    uint64_t nb_resizes;
+    /**
+     * Statistics of the object pool storing the queued items. Once the queue
+     * reaches a steady state, no more objects should need to be allocated.
+     */
+    ObjPoolStats pool;
+} ThreadQueueStats;
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -35,11 +91,24 @@ typedef struct ThreadQueue ThreadQueue;
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
+ * @param type queue implementation to use
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      enum ThreadQueueType type);
 void         tq_free(ThreadQueue **tq);
 
+/**
+ * Make the queue depth adaptive. The number of items that can be stored in the
+ * queue without blocking then varies between depth_min and depth_max,
+ * according to the time senders and the receiver spend blocked. It starts
+ * at the queue_size passed to tq_alloc(), clipped to the given range.
+ *
+ * Must be called before any item is sent.
+ */
+int tq_set_depth_range(ThreadQueue *tq, unsigned int depth_min,
+                       unsigned int depth_max);
+
 /**
  * Send an item for the given stream to the queue.
  *
@@ -53,6 +122,18 @@ void         tq_free(ThreadQueue **tq);
  * - AVERROR_EOF the receiving side has marked the given stream as finished
  */
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data);
+/**
+ * Send several items for the given stream to the queue. This is equivalent to
+ * calling tq_send() for each of them in order, except that the queue is locked
+ * and the receiver woken up only once per batch, rather than once per item
+ * (more often if the queue fills up and the sender has to wait).
+ *
+ * @param data array of nb_items items to send; the items that were sent are
+ *             left blank, the ones after a failure are left untouched
+ * @return same as tq_send(); on failure, some of the items may have been sent
+ */
+int tq_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                  void **data, unsigned int nb_items);
 /**
  * Mark the given stream finished from the sending side.
  */
@@ -78,4 +159,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Get a snapshot of the queue statistics. May be called from any thread.
+ */
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
@@ -31,6 +31,8 @@
  * one after the last successfully split frame.
  */
 
+#include <inttypes.h>
+
 #include "libavutil/opt.h"
 
 #include "avcodec.h"
@@ -39,16 +41,13 @@
 #else
 #include "bsf.h"
 #endif
-#include "cbs.h"
-#include "cbs_av1.h"
 #include "ni_av1_rbsp.h"
+#include "ni_bsf_async.h"
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "libavutil/mem.h"
 #endif
 typedef struct AV1FtoTileContext {
-    AVPacket *buffer_pkt;
-    CodedBitstreamContext *cbc;
-    CodedBitstreamFragment temporal_unit;
+    NIBSFAsync *async;
 
     int width;
     int height;
@@ -58,6 +57,7 @@ typedef struct AV1FtoTileContext {
     int y;
     int x_w;
     int y_h;
+    int async_depth;
 
     int nb_frames;
     int cur_frame;
@@ -65,16 +65,87 @@ typedef struct AV1FtoTileContext {
     int last_frame_idx;
 } AV1FtoTileContext;
 
-// called by raw_to_tile_bsf
-static int av1_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
+/*
+ * The tile repack only needs the type and the sizes of the OBUs and where
+ * the tile groups are, so the OBU headers are walked instead of parsing the
+ * whole temporal unit: the repack parses the headers of the first tile
+ * again anyway.
+ */
+static int av1_rawtotile_scan(AVBSFContext *ctx, const uint8_t *data, int size,
+                              AV1TileInfo *tileinfo)
+{
+    int pos = 0;
+
+    while (pos < size) {
+        const uint8_t *obu = data + pos;
+        int left = size - pos;
+        int header_size, type, i;
+        uint64_t obu_size;
+
+        if (tileinfo->num_obu == MAX_NUM_OBU_PER_FRAME) {
+            av_log(ctx, AV_LOG_ERROR, "more than %d OBUs in the temporal unit\n",
+                   MAX_NUM_OBU_PER_FRAME);
+            return AVERROR_INVALIDDATA;
+        }
+
+        if (obu[0] & 0x80) {
+            av_log(ctx, AV_LOG_ERROR, "OBU forbidden bit set\n");
+            return AVERROR_INVALIDDATA;
+        }
+        type        = (obu[0] >> 3) & 0xf;
+        header_size = 1 + !!(obu[0] & 0x04);
+        if (header_size > left)
+            return AVERROR_INVALIDDATA;
+
+        if (obu[0] & 0x02) {
+            obu_size = 0;
+            for (i = 0; i < 8; i++) {
+                if (header_size >= left)
+                    return AVERROR_INVALIDDATA;
+                obu_size |= (uint64_t)(obu[header_size] & 0x7f) << (7 * i);
+                if (!(obu[header_size++] & 0x80))
+                    break;
+            }
+            if (i == 8 || obu_size > left - header_size) {
+                av_log(ctx, AV_LOG_ERROR, "invalid OBU size\n");
+                return AVERROR_INVALIDDATA;
+            }
+        } else {
+            obu_size = left - header_size;
+        }
+
+        tileinfo->type[tileinfo->num_obu]      = type;
+        tileinfo->unit_size[tileinfo->num_obu] = header_size + obu_size;
+        tileinfo->obu_size[tileinfo->num_obu]  = obu_size;
+        tileinfo->num_obu++;
+
+        if (type == AV1_OBU_TILE_GROUP) {
+            if (tileinfo->num_tile_group == MAX_MUM_TILE_GROUP_OBU_PER_FRAME) {
+                av_log(ctx, AV_LOG_ERROR, "more than %d tile groups in the "
+                       "temporal unit\n", MAX_MUM_TILE_GROUP_OBU_PER_FRAME);
+                return AVERROR_INVALIDDATA;
+            }
+            tileinfo->tile_raw_data_size[tileinfo->num_tile_group] = obu_size;
+            tileinfo->tile_raw_data_pos[tileinfo->num_tile_group] = pos + header_size;
+            tileinfo->num_tile_group++;
+        }
+        pos += header_size + obu_size;
+
+        av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: unit %d type %d unit_size %d obu_size %"PRIu64" raw_data_pos %d\n",
+            __FILE__, __LINE__, __func__, tileinfo->num_obu - 1, type, header_size + (int)obu_size, obu_size, tileinfo->tile_raw_data_pos[0]);
+    }
+    tileinfo->total_raw_data_pos = pos;
+
+    return 0;
+}
+
+// called by raw_to_tile_bsf, on the worker thread when async_depth > 1
+static int av1_rawtotile_process(AVBSFContext *ctx, AVPacket *pkt_in, AVPacket *out)
 {
     AV1FtoTileContext *s = ctx->priv_data;
-    CodedBitstreamFragment *td = &s->temporal_unit;
-    int i, ret;
-    AV1RawOBU *obu;
+    int ret;
     int out_size = 0;
     AV1TileInfo tileinfo = {0};
-    AVPacket *pkt_in = s->buffer_pkt;
 
     av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d c %d r %d x %d y %d nb_number %d cur_frame %d %d %d\n",
             __FILE__, __LINE__, __func__,
@@ -89,138 +160,59 @@ static int av1_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
     tileinfo.x_w = s->x_w;
     tileinfo.y_h = s->y_h;
 
-    if (!s->buffer_pkt->data) {
-        ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-        if (ret < 0)
-            return ret;
-
-        // read headers and save in ctx->priv_data in cbs_av1_read_unit()
-        ret = ff_cbs_read_packet(s->cbc, td, s->buffer_pkt);
-        if (ret < 0) {
-            av_log(ctx, AV_LOG_INFO, "Failed to parse temporal unit.\n");
-            goto passthrough;
-        }
-
-        av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: nb_units %d pkt_in->size %d sizeof AV1TileInfo %ld\n",
-                __FILE__, __LINE__, __func__, td->nb_units, pkt_in->size, sizeof(AV1TileInfo));
-
-        tileinfo.num_obu = td->nb_units;
-        for (i = 0; i < td->nb_units; i++) {
-            CodedBitstreamUnit *unit = &td->units[i];
-            obu = (AV1RawOBU *) unit->content;
-
-            tileinfo.type[i] = unit->type;
-            tileinfo.unit_size[i] = unit->data_size;
-            tileinfo.obu_size[i] = obu->obu_size;
-
-            if(unit->type == AV1_OBU_TILE_GROUP) {
-                tileinfo.tile_raw_data_size[tileinfo.num_tile_group] = obu->obu_size;
-                tileinfo.tile_raw_data_pos[tileinfo.num_tile_group] = (unit->data_size - obu->obu_size) + tileinfo.total_raw_data_pos;
-                tileinfo.num_tile_group++;
-            }
-            tileinfo.total_raw_data_pos += unit->data_size;
-
-            av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: unit %d type %d unit_size %ld obu_size %ld raw_data_pos %d\n",
-                __FILE__, __LINE__, __func__, i, unit->type, unit->data_size, obu->obu_size, tileinfo.tile_raw_data_pos[0]);
-        }
+    ret = av1_rawtotile_scan(ctx, pkt_in->data, pkt_in->size, &tileinfo);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_INFO, "Failed to parse temporal unit.\n");
+        return 0;
     }
 
+    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: nb_units %d pkt_in->size %d sizeof AV1TileInfo %ld\n",
+            __FILE__, __LINE__, __func__, tileinfo.num_obu, pkt_in->size, sizeof(AV1TileInfo));
+
     out_size = pkt_in->size + sizeof(AV1TileInfo);
     ret = av_new_packet(out, out_size);
     if (ret < 0) {
         return ret;
     }
 
-    av_packet_copy_props(out, s->buffer_pkt);
+    av_packet_copy_props(out, pkt_in);
 
     // out data structure is AV1TileInfo + AV1 frame data
     memcpy(out->data, (uint8_t *)&tileinfo, sizeof(AV1TileInfo));
 
-    memcpy(out->data + sizeof(AV1TileInfo), s->buffer_pkt->data, pkt_in->size);
+    memcpy(out->data + sizeof(AV1TileInfo), pkt_in->data, pkt_in->size);
     out->size = pkt_in->size + sizeof(AV1TileInfo);
 
-passthrough:
-    av_packet_unref(s->buffer_pkt);
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(td);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, td);
-#else
-    ff_cbs_fragment_uninit(s->cbc, td);
-#endif
     return 0;
 }
 
-static const CodedBitstreamUnitType decompose_unit_types[] = {
-    AV1_OBU_TEMPORAL_DELIMITER,
-    AV1_OBU_SEQUENCE_HEADER,
-    AV1_OBU_FRAME_HEADER,
-    AV1_OBU_TILE_GROUP,
-    AV1_OBU_FRAME,
-};
-
-static int av1_rawtotile_init(AVBSFContext *ctx)
+static int av1_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
 {
     AV1FtoTileContext *s = ctx->priv_data;
-    CodedBitstreamFragment *td = &s->temporal_unit;
-    void *pb_buf;
-    int ret;
-
-    s->buffer_pkt = av_packet_alloc();
-    if (!s->buffer_pkt)
-        return AVERROR(ENOMEM);
-
-    ret = ff_cbs_init(&s->cbc, AV_CODEC_ID_AV1, ctx);
-    if (ret < 0)
-        return ret;
 
-    s->cbc->decompose_unit_types    = (CodedBitstreamUnitType*)decompose_unit_types;
-    s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
-
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(td);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, td);
-#else
-    ff_cbs_fragment_uninit(s->cbc, td);
-#endif
+    return ff_ni_bsf_async_filter(s->async, out);
+}
 
-    pb_buf = av_mallocz(MAX_PUT_BUF_SIZE);
-    if (!pb_buf) {
-        return AVERROR(ENOMEM);
-    }
+static int av1_rawtotile_init(AVBSFContext *ctx)
+{
+    AV1FtoTileContext *s = ctx->priv_data;
 
-    return 0;
+    return ff_ni_bsf_async_init(&s->async, ctx, av1_rawtotile_process,
+                                s->async_depth);
 }
 
 static void av1_rawtotile_flush(AVBSFContext *ctx)
 {
     AV1FtoTileContext *s = ctx->priv_data;
 
-    av_packet_unref(s->buffer_pkt);
-
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(&s->temporal_unit);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, &s->temporal_unit);
-#else
-    ff_cbs_fragment_uninit(s->cbc, &s->temporal_unit);
-#endif
+    ff_ni_bsf_async_flush(s->async);
 }
 
 static void av1_rawtotile_close(AVBSFContext *ctx)
 {
     AV1FtoTileContext *s = ctx->priv_data;
 
-    av_packet_free(&s->buffer_pkt);
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_free(&s->temporal_unit);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_free(s->cbc, &s->temporal_unit);
-#else
-    ff_cbs_fragment_uninit(s->cbc, &s->temporal_unit);
-#endif
-    ff_cbs_close(&s->cbc);
+    ff_ni_bsf_async_free(&s->async);
 }
 
 static const enum AVCodecID av1_rawtotile_codec_ids[] = {
@@ -238,6 +230,8 @@ static const AVOption options[] = {
         {"y", "set y", OFFSET(y), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 8192, 0, 0},  //support 8192 rows max
         {"x_w", "set x_w", OFFSET(x_w), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 8192, 0, 0},  //support 8192 columns max
         {"y_h", "set y_h", OFFSET(y_h), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 8192, 0, 0},  //support 8192 rows max
+        {"async_depth", "number of packets in flight on a worker thread, 1 to convert them synchronously",
+         OFFSET(async_depth), AV_OPT_TYPE_INT, {.i64 = 1}, 1, NI_BSF_ASYNC_MAX_DEPTH, 0, 0},
         { NULL },
 };
 
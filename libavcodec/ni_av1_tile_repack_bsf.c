@@ -26,6 +26,11 @@
  * just one frame.
  */
 
+#include <inttypes.h>
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 
 #include "avcodec.h"
@@ -36,11 +41,35 @@
 #endif
 #include "cbs.h"
 #include "cbs_av1.h"
+#include "get_bits.h"
 #include "internal.h"
 #include "ni_av1_rbsp.h"
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "libavutil/mem.h"
 #endif
+/* where the tile_info of a frame header OBU of the first tile is */
+typedef struct AV1RepackHeaderPos {
+    const uint8_t *data;
+    int tile_info;  // bit position of uniform_tile_spacing_flag
+    int quant;      // bit position of base_q_idx
+    int end;        // bit position of the trailing one bit
+} AV1RepackHeaderPos;
+
+/*
+ * Apart from the tile_info the repacked frame header is the frame header of
+ * the first tile bit for bit, and the tile_info only depends on the frame
+ * and tile geometry. So it is written through the CBS path once and the
+ * following frame headers are spliced around it.
+ */
+typedef struct AV1RepackTemplate {
+    int valid;
+    int use_128x128_superblock;
+    int context_update_tile_id;
+    int nb_tiles;
+    int nb_bits;
+    uint8_t bits[128 + AV_INPUT_BUFFER_PADDING_SIZE];
+} AV1RepackTemplate;
+
 typedef struct AV1RepackContext {
     AVPacket *buffer_pkt;
     AVPacket **tile_pkt;
@@ -49,6 +78,30 @@ typedef struct AV1RepackContext {
     PutBitContext stream;
     AV1TileInfo tileinfo[MAX_NUM_TILE_PER_FRAME];
 
+    /* frame size and tile layout the templates were made for */
+    int *geometry;
+    int *cur_geometry;
+    int geometry_size;
+
+    /* last sequence header OBU of the first tile and its repacked copy */
+    uint8_t *seq_in;
+    unsigned int seq_in_alloc;
+    int seq_in_size;
+    uint8_t *seq_out;
+    unsigned int seq_out_alloc;
+    int seq_out_size;
+
+    AV1RepackTemplate tmpl;
+    AV1RepackHeaderPos hdr_pos[MAX_NUM_OBU_PER_FRAME];
+    int nb_hdr_pos;
+
+    /* frames are allocated from a pool sized to the largest frame so far */
+    AVBufferPool *pool;
+    int pool_size;
+
+    int64_t nb_spliced;
+    int64_t nb_rewritten;
+
     int tile_pos;
     int tile_num;
 } AV1RepackContext;
@@ -60,14 +113,19 @@ static int ni_av1_log2(int blksize, int target)
     return k;
 }
 
-static int av1_rawtotile_encode_sequence_header_obu(AVBSFContext *ctx, AV1RawSequenceHeader *current, AV1TileInfo *tileinfo)
+static void av1_tile_repack_patch_sequence_header(AV1RawSequenceHeader *current, AV1TileInfo *tileinfo)
 {
-    AV1RepackContext *s = ctx->priv_data;
-
     current->max_frame_width_minus_1 = tileinfo->width - 1;
     current->max_frame_height_minus_1 = tileinfo->height - 1;
     current->frame_width_bits_minus_1 = ni_av1_log2(1, tileinfo->width) - 1;
     current->frame_height_bits_minus_1 = ni_av1_log2(1, tileinfo->height) - 1;
+}
+
+static int av1_rawtotile_encode_sequence_header_obu(AVBSFContext *ctx, AV1RawSequenceHeader *current, AV1TileInfo *tileinfo)
+{
+    AV1RepackContext *s = ctx->priv_data;
+
+    av1_tile_repack_patch_sequence_header(current, tileinfo);
 
     av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d\n",
             __FILE__, __LINE__, __func__, tileinfo->width, tileinfo->height);
@@ -155,6 +213,455 @@ static int av1_rawtotile_encode_frame_obu(
 }
 #endif
 
+static void av1_tile_repack_trace(void *trace_context, GetBitContext *gbc,
+                                  int length, const char *name,
+                                  const int *subscripts, int64_t value)
+{
+    AV1RepackContext *s = trace_context;
+    AV1RepackHeaderPos *pos;
+
+    if (!strcmp(name, "uniform_tile_spacing_flag")) {
+        if (s->nb_hdr_pos == MAX_NUM_OBU_PER_FRAME)
+            return;
+        pos = &s->hdr_pos[s->nb_hdr_pos++];
+        pos->data      = gbc->buffer;
+        pos->tile_info = get_bits_count(gbc);
+        pos->quant     = -1;
+    } else if (!strcmp(name, "base_q_idx") && s->nb_hdr_pos) {
+        pos = &s->hdr_pos[s->nb_hdr_pos - 1];
+        if (pos->data == gbc->buffer && pos->quant < 0)
+            pos->quant = get_bits_count(gbc);
+    }
+}
+
+static AV1RepackHeaderPos *av1_tile_repack_find_pos(AV1RepackContext *s,
+                                                    const CodedBitstreamUnit *unit)
+{
+    for (int i = 0; i < s->nb_hdr_pos; i++)
+        if (s->hdr_pos[i].data == unit->data)
+            return s->hdr_pos[i].quant >= 0 ? &s->hdr_pos[i] : NULL;
+    return NULL;
+}
+
+// bit position of the trailing one bit of an OBU, -1 if there is none
+static int av1_tile_repack_trailing_bit(const uint8_t *data, int size)
+{
+    int i;
+
+    for (i = size - 1; i >= 0 && !data[i]; i--);
+    if (i < 0)
+        return -1;
+    return 8 * i + 7 - ff_ctz(data[i]);
+}
+
+static int av1_tile_repack_leb128_size(uint64_t value)
+{
+    return (av_log2(value) + 7) / 7;
+}
+
+static uint8_t *av1_tile_repack_put_leb128(uint8_t *dst, uint64_t value)
+{
+    int len = av1_tile_repack_leb128_size(value);
+
+    for (int i = 0; i < len; i++)
+        *dst++ = (value >> (7 * i) & 0x7f) | (i < len - 1 ? 0x80 : 0);
+    return dst;
+}
+
+// OBU header of the repacked OBU, which always has a size field
+static uint8_t *av1_tile_repack_put_obu_header(uint8_t *dst,
+                                               const CodedBitstreamUnit *unit)
+{
+    *dst++ = unit->data[0] | 0x02;
+    if (unit->data[0] & 0x04)
+        *dst++ = unit->data[1];
+    return dst;
+}
+
+static void av1_tile_repack_copy_bits(PutBitContext *pb, GetBitContext *gb,
+                                      int nb_bits)
+{
+    for (; nb_bits >= 32; nb_bits -= 32)
+        put_bits32(pb, get_bits_long(gb, 32));
+    if (nb_bits)
+        put_bits(pb, nb_bits, get_bits_long(gb, nb_bits));
+}
+
+static int av1_tile_repack_bits_equal(GetBitContext *a, GetBitContext *b,
+                                      int nb_bits)
+{
+    for (; nb_bits > 0; nb_bits -= 32) {
+        int n = FFMIN(nb_bits, 32);
+        if (get_bits_long(a, n) != get_bits_long(b, n))
+            return 0;
+    }
+    return 1;
+}
+
+static void av1_tile_repack_update_geometry(AV1RepackContext *s)
+{
+    int *g = s->cur_geometry;
+
+    g[0] = s->tileinfo[0].width;
+    g[1] = s->tileinfo[0].height;
+    g[2] = s->tileinfo[0].column;
+    g[3] = s->tileinfo[0].row;
+    for (int i = 0; i < s->tile_num; i++) {
+        g[4 + 2 * i]     = s->tileinfo[i].x_w;
+        g[4 + 2 * i + 1] = s->tileinfo[i].y_h;
+    }
+
+    if (memcmp(s->geometry, g, s->geometry_size * sizeof(*g))) {
+        memcpy(s->geometry, g, s->geometry_size * sizeof(*g));
+        s->seq_in_size = 0;
+        s->tmpl.valid  = 0;
+    }
+}
+
+/*
+ * Patch the sequence header like the CBS path does, the frame headers read
+ * afterwards depend on it, and write the OBU through the CBS path only when
+ * it differs from the last one.
+ */
+static int av1_tile_repack_sequence_header(AVBSFContext *ctx,
+                                           CodedBitstreamUnit *unit)
+{
+    AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamAV1Context *priv = s->cbc->priv_data;
+    AV1RawOBU *obu = unit->content;
+    PutBitContext pbc_tmp;
+    int start_pos, size, ret;
+
+    if (s->seq_in_size == unit->data_size &&
+        !memcmp(s->seq_in, unit->data, unit->data_size)) {
+        av1_tile_repack_patch_sequence_header(&obu->obu.sequence_header,
+                                              &s->tileinfo[0]);
+        priv->sequence_header = &obu->obu.sequence_header;
+        return 0;
+    }
+    s->seq_in_size = 0;
+
+    obu->header.obu_has_size_field = 1;
+    netint_av1_write_obu_header(s->cbc, &s->stream, &obu->header);
+    pbc_tmp = s->stream;
+    put_bits32(&s->stream, 0);
+    put_bits32(&s->stream, 0);
+    start_pos = put_bits_count(&s->stream);
+
+    ret = av1_rawtotile_encode_sequence_header_obu(ctx, &obu->obu.sequence_header,
+                                                   &s->tileinfo[0]);
+    priv->sequence_header = &obu->obu.sequence_header;
+    if (ret >= 0)
+        ret = netint_av1_update_obu_data_length(s->cbc, &s->stream, start_pos,
+                                                obu, &pbc_tmp, 1);
+    size = put_bits_count(&s->stream) / 8;
+    if (ret < 0)
+        goto end;
+
+    av_fast_malloc(&s->seq_in, &s->seq_in_alloc, unit->data_size);
+    av_fast_malloc(&s->seq_out, &s->seq_out_alloc, size);
+    if (!s->seq_in || !s->seq_out) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memcpy(s->seq_in, unit->data, unit->data_size);
+    memcpy(s->seq_out, s->stream.buf, size);
+    s->seq_in_size  = unit->data_size;
+    s->seq_out_size = size;
+
+end:
+    netint_av1_bitstream_reset(&s->stream);
+    return ret;
+}
+
+/*
+ * Write a frame header through the CBS path and keep its tile_info as the
+ * template, after checking that the bits around it went through unchanged.
+ */
+static int av1_tile_repack_template(AVBSFContext *ctx,
+                                    CodedBitstreamUnit *unit,
+                                    const AV1RepackHeaderPos *pos)
+{
+    AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamAV1Context *priv = s->cbc->priv_data;
+    AV1RawOBU *obu = unit->content;
+    AV1RawFrameHeader *fh = &obu->obu.frame_header;
+    AV1RepackTemplate *tmpl = &s->tmpl;
+    int payload_pos = 8 * (unit->data_size - obu->obu_size);
+    int prefix_bits = pos->tile_info - payload_pos;
+    int suffix_bits = pos->end - pos->quant;
+    int context_update_tile_id = fh->context_update_tile_id;
+    GetBitContext gb_in, gb_out;
+    PutBitContext pb;
+    int nb_bits, ret;
+
+    tmpl->valid = 0;
+
+    priv->seen_frame_header = 0;
+    ret = av1_rawtotile_encode_frame_header_obu(ctx, NULL, fh, &s->tileinfo[0]);
+    nb_bits = put_bits_count(&s->stream) - prefix_bits - suffix_bits;
+    flush_put_bits(&s->stream);
+    if (ret < 0)
+        goto end;
+    if (nb_bits <= 0 || nb_bits > 8 * sizeof(tmpl->bits) - 8 * AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = AVERROR(ENOSPC);
+        goto end;
+    }
+
+    init_get_bits(&gb_in, unit->data, 8 * unit->data_size);
+    init_get_bits(&gb_out, s->stream.buf, put_bits_count(&s->stream));
+    skip_bits_long(&gb_in, payload_pos);
+    if (!av1_tile_repack_bits_equal(&gb_in, &gb_out, prefix_bits)) {
+        ret = AVERROR_PATCHWELCOME;
+        goto end;
+    }
+
+    init_put_bits(&pb, tmpl->bits, sizeof(tmpl->bits));
+    av1_tile_repack_copy_bits(&pb, &gb_out, nb_bits);
+    flush_put_bits(&pb);
+
+    skip_bits_long(&gb_in, pos->quant - pos->tile_info);
+    if (!av1_tile_repack_bits_equal(&gb_in, &gb_out, suffix_bits)) {
+        ret = AVERROR_PATCHWELCOME;
+        goto end;
+    }
+
+    tmpl->use_128x128_superblock = priv->sequence_header->use_128x128_superblock;
+    tmpl->context_update_tile_id = context_update_tile_id;
+    tmpl->nb_tiles = priv->tile_cols * priv->tile_rows;
+    tmpl->nb_bits  = nb_bits;
+    tmpl->valid    = 1;
+
+end:
+    netint_av1_bitstream_reset(&s->stream);
+    return ret;
+}
+
+/*
+ * Check that the temporal unit of the first tile can be repacked from the
+ * templates and bring them up to date.
+ *
+ * @return 1 if it can, 0 if it has to go through the CBS path
+ */
+static int av1_tile_repack_prepare(AVBSFContext *ctx)
+{
+    AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamFragment *td = &s->temporal_unit;
+    CodedBitstreamAV1Context *priv = s->cbc->priv_data;
+    AV1RepackHeaderPos *pos;
+    int tile_group_index = 0;
+    int nb_frame_headers = 0;
+    int i, j, ret;
+
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
+
+        switch (unit->type) {
+        case AV1_OBU_TEMPORAL_DELIMITER:
+        case AV1_OBU_SEQUENCE_HEADER:
+            break;
+        case AV1_OBU_FRAME_HEADER:
+            pos = av1_tile_repack_find_pos(s, unit);
+            if (!pos || obu->obu.frame_header.frame_size_override_flag ||
+                !obu->obu.frame_header.uniform_tile_spacing_flag)
+                return 0;
+            pos->end = av1_tile_repack_trailing_bit(unit->data, unit->data_size);
+            if (pos->end <= pos->quant)
+                return 0;
+            nb_frame_headers++;
+            break;
+        case AV1_OBU_TILE_GROUP:
+            if (obu->obu.tile_group.tile_start_and_end_present_flag ||
+                tile_group_index == MAX_MUM_TILE_GROUP_OBU_PER_FRAME)
+                return 0;
+            for (j = 0; j < s->tile_num; j++) {
+                int data_pos  = s->tileinfo[j].tile_raw_data_pos[tile_group_index];
+                int data_size = s->tileinfo[j].tile_raw_data_size[tile_group_index];
+
+                if (data_pos < 0 || data_size < 0 ||
+                    data_size > s->tile_pkt[j]->size - data_pos) {
+                    av_log(ctx, AV_LOG_ERROR, "tile %d: tile group %d out of "
+                           "the packet\n", j, tile_group_index);
+                    return AVERROR_INVALIDDATA;
+                }
+            }
+            tile_group_index++;
+            break;
+        default:
+            return 0;
+        }
+    }
+
+    av1_tile_repack_update_geometry(s);
+
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
+
+        if (unit->type == AV1_OBU_SEQUENCE_HEADER) {
+            ret = av1_tile_repack_sequence_header(ctx, unit);
+            if (ret < 0)
+                return 0;
+        } else if (unit->type == AV1_OBU_FRAME_HEADER) {
+            if (s->tmpl.valid &&
+                s->tmpl.use_128x128_superblock == priv->sequence_header->use_128x128_superblock &&
+                s->tmpl.context_update_tile_id == obu->obu.frame_header.context_update_tile_id)
+                continue;
+
+            ret = av1_tile_repack_template(ctx, unit, av1_tile_repack_find_pos(s, unit));
+            if (ret < 0) {
+                av_log(ctx, AV_LOG_DEBUG, "no frame header template: %s\n",
+                       av_err2str(ret));
+                return 0;
+            }
+        }
+    }
+
+    return !nb_frame_headers || s->tmpl.nb_tiles == s->tile_num;
+}
+
+/*
+ * Write the repacked frame in one pass: the OBU headers and sizes directly,
+ * the sequence header from its cached copy, the frame headers spliced
+ * around the tile_info template and the tile data of every tile after each
+ * other.
+ */
+static int av1_tile_repack_splice(AVBSFContext *ctx, AVPacket *out)
+{
+    AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamFragment *td = &s->temporal_unit;
+    int tile_group_size[MAX_MUM_TILE_GROUP_OBU_PER_FRAME] = { 0 };
+    int tile_group_index = 0;
+    const AV1RepackHeaderPos *pos;
+    GetBitContext gb;
+    PutBitContext pb;
+    uint8_t *dst, *end;
+    int64_t new_size = 0;
+    int i, j, size, ret;
+
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
+
+        switch (unit->type) {
+        case AV1_OBU_SEQUENCE_HEADER:
+            new_size += s->seq_out_size;
+            continue;
+        case AV1_OBU_TEMPORAL_DELIMITER:
+            size = 0;
+            break;
+        case AV1_OBU_FRAME_HEADER:
+            pos  = av1_tile_repack_find_pos(s, unit);
+            size = (pos->tile_info - 8 * (unit->data_size - obu->obu_size) +
+                    s->tmpl.nb_bits + pos->end - pos->quant) / 8 + 1;
+            break;
+        default:
+            size = (s->tile_num > 1) + TILE_SIZE_BYTES * (s->tile_num - 1);
+            for (j = 0; j < s->tile_num; j++)
+                size += s->tileinfo[j].tile_raw_data_size[tile_group_index];
+            tile_group_size[tile_group_index++] = size;
+            break;
+        }
+        new_size += 1 + !!(unit->data[0] & 0x04) +
+                    av1_tile_repack_leb128_size(size) + size;
+    }
+
+    if (new_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(ERANGE);
+    if (new_size + AV_INPUT_BUFFER_PADDING_SIZE > s->pool_size) {
+        av_buffer_pool_uninit(&s->pool);
+        s->pool_size = new_size + new_size / 4 + AV_INPUT_BUFFER_PADDING_SIZE;
+        s->pool = av_buffer_pool_init(s->pool_size, NULL);
+        if (!s->pool) {
+            s->pool_size = 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    out->buf = av_buffer_pool_get(s->pool);
+    if (!out->buf) {
+        av_log(ctx, AV_LOG_ERROR, "failed to allocate new packet data\n");
+        return AVERROR(ENOMEM);
+    }
+    out->data = out->buf->data;
+    out->size = new_size;
+    memset(out->data + new_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    ret = av_packet_copy_props(out, s->tile_pkt[0]);
+    if (ret < 0) {
+        av_packet_unref(out);
+        return ret;
+    }
+
+    dst = out->data;
+    end = out->data + new_size + AV_INPUT_BUFFER_PADDING_SIZE;
+    tile_group_index = 0;
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
+
+        switch (unit->type) {
+        case AV1_OBU_SEQUENCE_HEADER:
+            memcpy(dst, s->seq_out, s->seq_out_size);
+            dst += s->seq_out_size;
+            break;
+        case AV1_OBU_TEMPORAL_DELIMITER:
+            dst = av1_tile_repack_put_obu_header(dst, unit);
+            dst = av1_tile_repack_put_leb128(dst, 0);
+            break;
+        case AV1_OBU_FRAME_HEADER: {
+            int payload_pos = 8 * (unit->data_size - obu->obu_size);
+
+            pos  = av1_tile_repack_find_pos(s, unit);
+            size = (pos->tile_info - payload_pos + s->tmpl.nb_bits +
+                    pos->end - pos->quant) / 8 + 1;
+            dst = av1_tile_repack_put_obu_header(dst, unit);
+            dst = av1_tile_repack_put_leb128(dst, size);
+
+            init_put_bits(&pb, dst, end - dst);
+            init_get_bits(&gb, unit->data, 8 * unit->data_size);
+            skip_bits_long(&gb, payload_pos);
+            av1_tile_repack_copy_bits(&pb, &gb, pos->tile_info - payload_pos);
+            skip_bits_long(&gb, pos->quant - pos->tile_info);
+            {
+                GetBitContext gb_tmpl;
+
+                init_get_bits(&gb_tmpl, s->tmpl.bits, s->tmpl.nb_bits);
+                av1_tile_repack_copy_bits(&pb, &gb_tmpl, s->tmpl.nb_bits);
+            }
+            av1_tile_repack_copy_bits(&pb, &gb, pos->end - pos->quant);
+            // trailing bits
+            put_bits(&pb, 1, 1);
+            flush_put_bits(&pb);
+            av_assert1(put_bytes_output(&pb) == size);
+            dst += size;
+            break;
+        }
+        default:
+            dst = av1_tile_repack_put_obu_header(dst, unit);
+            dst = av1_tile_repack_put_leb128(dst, tile_group_size[tile_group_index]);
+            if (s->tile_num > 1)
+                *dst++ = 0; // tile_start_and_end_present_flag, byte_alignment()
+            for (j = 0; j < s->tile_num; j++) {
+                size = s->tileinfo[j].tile_raw_data_size[tile_group_index];
+                if (j < s->tile_num - 1) {
+                    AV_WL32(dst, size - 1);
+                    dst += TILE_SIZE_BYTES;
+                }
+                memcpy(dst, s->tile_pkt[j]->data +
+                       s->tileinfo[j].tile_raw_data_pos[tile_group_index], size);
+                dst += size;
+            }
+            tile_group_index++;
+            break;
+        }
+    }
+    av_assert0(dst == out->data + new_size);
+
+    return 0;
+}
+
 // called from tile_repack_bsf()
 static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
     AV1RepackContext *s = ctx->priv_data;
@@ -294,12 +801,26 @@ static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
         priv->frame_height = s->tileinfo[0].height;
 
         // read headers and save in ctx->priv_data in cbs_av1_read_unit()
+        // and find the tile_info of the frame headers on the way
+        s->nb_hdr_pos = 0;
+        s->cbc->trace_enable = 1;
         ret = ff_cbs_read_packet(s->cbc, td, tile_pkt);
+        s->cbc->trace_enable = 0;
         if (ret < 0) {
             av_log(ctx, AV_LOG_INFO, "Failed to parse temporal unit.\n");
             goto end;
         }
 
+        ret = av1_tile_repack_prepare(ctx);
+        if (ret < 0)
+            goto release;
+        if (ret > 0) {
+            s->nb_spliced++;
+            ret = av1_tile_repack_splice(ctx, out);
+            goto release;
+        }
+        s->nb_rewritten++;
+
         for (i = 0; i < td->nb_units; i++) {
 
             CodedBitstreamUnit *unit = &td->units[i];
@@ -419,6 +940,16 @@ static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
                 obu_size = netint_av1_update_obu_data_length(s->cbc, &s->stream, start_pos, obu, &pbc_tmp, add_trailing_bits);
             }
         }
+
+        new_size = put_bits_count(&s->stream) / 8;
+        ret = av_new_packet(out, new_size);
+        if (ret >= 0) {
+            netint_av1_bitstream_fetch(&s->stream, out, new_size);
+            ret = av_packet_copy_props(out, s->tile_pkt[0]);
+        }
+        netint_av1_bitstream_reset(&s->stream);
+
+release:
         for(i = 0; i < s->tile_num; i++)
         {
             av_buffer_unref(&s->tile_pkt[i]->buf);
@@ -433,19 +964,8 @@ static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
         ff_cbs_fragment_uninit(s->cbc, td);
 #endif
 
-        new_size = put_bits_count(&s->stream) / 8;
-        ret = av_new_packet(out, new_size);
-        if (ret < 0) {
-            return ret;
-        }
-
-        av_packet_copy_props(out, s->buffer_pkt);
-
-        netint_av1_bitstream_fetch(&s->stream, out, new_size);
-        netint_av1_bitstream_reset(&s->stream);
-
         s->tile_pos = 0;
-        goto end;
+        return ret;
     } else {
         return AVERROR(EAGAIN);
     }
@@ -504,6 +1024,14 @@ static int av1_tile_repack_init(AVBSFContext *ctx) {
 
     s->cbc->decompose_unit_types    = (CodedBitstreamUnitType*)decompose_unit_types;
     s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
+    s->cbc->trace_context           = s;
+    s->cbc->trace_read_callback     = av1_tile_repack_trace;
+
+    s->geometry_size = 4 + 2 * s->tile_num;
+    s->geometry      = av_calloc(2 * s->geometry_size, sizeof(*s->geometry));
+    if (!s->geometry)
+        return AVERROR(ENOMEM);
+    s->cur_geometry  = s->geometry + s->geometry_size;
 
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
@@ -547,6 +1075,7 @@ static void av1_tile_repack_flush(AVBSFContext *ctx) {
     for (i = 0; i < s->tile_num; i++) {
         av_packet_unref(s->tile_pkt[i]);
     }
+    s->tile_pos = 0;
 
     av_packet_unref(s->buffer_pkt);
 
@@ -583,6 +1112,14 @@ static void av1_tile_repack_close(AVBSFContext *ctx) {
 #endif
 
     ff_cbs_close(&s->cbc);
+
+    av_log(ctx, AV_LOG_VERBOSE, "%"PRId64" frames spliced from the header "
+           "templates, %"PRId64" rewritten through CBS\n",
+           s->nb_spliced, s->nb_rewritten);
+    av_freep(&s->geometry);
+    av_freep(&s->seq_in);
+    av_freep(&s->seq_out);
+    av_buffer_pool_uninit(&s->pool);
 }
 
 static const enum AVCodecID av1_tile_repack_codec_ids[] = {
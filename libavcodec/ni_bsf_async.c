@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "bsf_internal.h"
+#include "ni_bsf_async.h"
+
+typedef struct NIBSFAsyncJob {
+    AVPacket *in;
+    AVPacket *out;
+    int ret;
+} NIBSFAsyncJob;
+
+struct NIBSFAsync {
+    AVBSFContext *ctx;
+    NIBSFAsyncProcess process;
+
+    /* FIFO of the packets taken from the filter input: the first nb_done
+     * ones from head are converted, the following ones wait for the
+     * worker. Only the caller thread changes head and nb_queued. */
+    NIBSFAsyncJob *jobs;
+    int depth;
+    int head;
+    int nb_queued;
+    int nb_done;
+    int eof;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    int thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int exit;
+#endif
+};
+
+#if HAVE_THREADS
+static void *worker(void *arg)
+{
+    NIBSFAsync *a = arg;
+
+    pthread_mutex_lock(&a->lock);
+    while (!a->exit) {
+        NIBSFAsyncJob *job;
+
+        if (a->nb_done == a->nb_queued) {
+            pthread_cond_wait(&a->cond, &a->lock);
+            continue;
+        }
+        job = &a->jobs[(a->head + a->nb_done) % a->depth];
+        pthread_mutex_unlock(&a->lock);
+
+        job->ret = a->process(a->ctx, job->in, job->out);
+        av_packet_unref(job->in);
+
+        pthread_mutex_lock(&a->lock);
+        a->nb_done++;
+        pthread_cond_broadcast(&a->cond);
+    }
+    pthread_mutex_unlock(&a->lock);
+
+    return NULL;
+}
+#endif
+
+int ff_ni_bsf_async_init(NIBSFAsync **pa, AVBSFContext *ctx,
+                         NIBSFAsyncProcess process, int depth)
+{
+    NIBSFAsync *a;
+    int i;
+
+    a = av_mallocz(sizeof(*a));
+    if (!a)
+        return AVERROR(ENOMEM);
+    *pa = a;
+
+    a->ctx     = ctx;
+    a->process = process;
+#if HAVE_THREADS
+    a->depth   = av_clip(depth, 1, NI_BSF_ASYNC_MAX_DEPTH);
+#else
+    a->depth   = 1;
+#endif
+
+    a->jobs = av_calloc(a->depth, sizeof(*a->jobs));
+    if (!a->jobs)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < a->depth; i++) {
+        a->jobs[i].in  = av_packet_alloc();
+        a->jobs[i].out = av_packet_alloc();
+        if (!a->jobs[i].in || !a->jobs[i].out)
+            return AVERROR(ENOMEM);
+    }
+
+#if HAVE_THREADS
+    if (a->depth > 1) {
+        int ret;
+
+        pthread_mutex_init(&a->lock, NULL);
+        pthread_cond_init(&a->cond, NULL);
+        ret = pthread_create(&a->thread, NULL, worker, a);
+        if (ret) {
+            pthread_cond_destroy(&a->cond);
+            pthread_mutex_destroy(&a->lock);
+            return AVERROR(ret);
+        }
+        a->thread_started = 1;
+    }
+#endif
+
+    return 0;
+}
+
+static int filter_sync(NIBSFAsync *a, AVPacket *out)
+{
+    NIBSFAsyncJob *job = &a->jobs[0];
+    int ret;
+
+    do {
+        ret = ff_bsf_get_packet_ref(a->ctx, job->in);
+        if (ret < 0)
+            return ret;
+        ret = a->process(a->ctx, job->in, out);
+        av_packet_unref(job->in);
+    } while (ret == AVERROR(EAGAIN));
+
+    return ret;
+}
+
+int ff_ni_bsf_async_filter(NIBSFAsync *a, AVPacket *out)
+{
+#if HAVE_THREADS
+    NIBSFAsyncJob *job;
+    int ret;
+
+    if (!a->thread_started)
+        return filter_sync(a, out);
+
+    for (;;) {
+        int done;
+
+        pthread_mutex_lock(&a->lock);
+        done = a->nb_done;
+        pthread_mutex_unlock(&a->lock);
+
+        if (done) {
+            job = &a->jobs[a->head];
+            ret = job->ret;
+            av_packet_move_ref(out, job->out);
+
+            pthread_mutex_lock(&a->lock);
+            a->head = (a->head + 1) % a->depth;
+            a->nb_queued--;
+            a->nb_done--;
+            pthread_mutex_unlock(&a->lock);
+
+            if (ret == AVERROR(EAGAIN))
+                continue;
+            return ret;
+        }
+
+        if (!a->eof && a->nb_queued < a->depth) {
+            job = &a->jobs[(a->head + a->nb_queued) % a->depth];
+            ret = ff_bsf_get_packet_ref(a->ctx, job->in);
+            if (ret == AVERROR_EOF) {
+                a->eof = 1;
+            } else if (ret < 0) {
+                /* ask for more input rather than waiting for the worker */
+                return ret;
+            } else {
+                pthread_mutex_lock(&a->lock);
+                a->nb_queued++;
+                pthread_cond_broadcast(&a->cond);
+                pthread_mutex_unlock(&a->lock);
+                continue;
+            }
+        }
+
+        if (!a->nb_queued)
+            return AVERROR_EOF;
+
+        /* the FIFO is full or the input is over: wait for the oldest */
+        pthread_mutex_lock(&a->lock);
+        while (!a->nb_done)
+            pthread_cond_wait(&a->cond, &a->lock);
+        pthread_mutex_unlock(&a->lock);
+    }
+#else
+    return filter_sync(a, out);
+#endif
+}
+
+void ff_ni_bsf_async_flush(NIBSFAsync *a)
+{
+    int i;
+
+#if HAVE_THREADS
+    if (a->thread_started) {
+        pthread_mutex_lock(&a->lock);
+        while (a->nb_done < a->nb_queued)
+            pthread_cond_wait(&a->cond, &a->lock);
+        a->head      = 0;
+        a->nb_queued = 0;
+        a->nb_done   = 0;
+        pthread_mutex_unlock(&a->lock);
+    }
+#endif
+    a->eof = 0;
+
+    for (i = 0; i < a->depth; i++) {
+        av_packet_unref(a->jobs[i].in);
+        av_packet_unref(a->jobs[i].out);
+    }
+}
+
+void ff_ni_bsf_async_free(NIBSFAsync **pa)
+{
+    NIBSFAsync *a = *pa;
+    int i;
+
+    if (!a)
+        return;
+
+#if HAVE_THREADS
+    if (a->thread_started) {
+        pthread_mutex_lock(&a->lock);
+        a->exit = 1;
+        pthread_cond_broadcast(&a->cond);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->thread, NULL);
+        pthread_cond_destroy(&a->cond);
+        pthread_mutex_destroy(&a->lock);
+    }
+#endif
+
+    for (i = 0; a->jobs && i < a->depth; i++) {
+        av_packet_free(&a->jobs[i].in);
+        av_packet_free(&a->jobs[i].out);
+    }
+    av_freep(&a->jobs);
+    av_freep(pa);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Packets converted on a worker thread by the NETINT rawtotile bitstream
+ * filters.
+ *
+ * Every tile of a picture is a stream of its own, converted by its own
+ * filter instance, and the caller usually runs all the instances from one
+ * thread. With a depth above 1, an instance hands its packets to a worker
+ * thread and returns them converted on later calls, so the tiles of a
+ * picture are converted concurrently. Packets are converted and returned
+ * in input order.
+ */
+
+#ifndef AVCODEC_NI_BSF_ASYNC_H
+#define AVCODEC_NI_BSF_ASYNC_H
+
+#include "bsf.h"
+#include "packet.h"
+
+#define NI_BSF_ASYNC_MAX_DEPTH 16
+
+/**
+ * Convert a packet of the filter.
+ *
+ * @param in  input packet, unreferenced by the caller afterwards
+ * @param out output packet
+ * @return 0 with out set, AVERROR(EAGAIN) if the packet has no output or
+ *         a negative error code
+ */
+typedef int (*NIBSFAsyncProcess)(AVBSFContext *ctx, AVPacket *in,
+                                 AVPacket *out);
+
+typedef struct NIBSFAsync NIBSFAsync;
+
+/**
+ * @param depth number of packets being converted or waiting to be
+ *              returned, 1 to convert them synchronously
+ */
+int ff_ni_bsf_async_init(NIBSFAsync **pa, AVBSFContext *ctx,
+                         NIBSFAsyncProcess process, int depth);
+
+/**
+ * Take the input packets of the filter and return the next converted one,
+ * to be called from the filter callback.
+ */
+int ff_ni_bsf_async_filter(NIBSFAsync *a, AVPacket *out);
+
+/**
+ * Wait for the packets being converted and drop them and the converted
+ * ones. The worker is idle afterwards, so the filter state can be reset.
+ */
+void ff_ni_bsf_async_flush(NIBSFAsync *a);
+
+void ff_ni_bsf_async_free(NIBSFAsync **pa);
+
+#endif /* AVCODEC_NI_BSF_ASYNC_H */
@@ -27,9 +27,16 @@
  * be decoded independently.
  */
 
+#include <inttypes.h>
+#include <string.h>
+
 #include "version.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
 
 #include "avcodec.h"
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 91)
@@ -41,6 +48,7 @@
 #include "cbs_h265.h"
 #include "ni_hevc_extradata.h"
 #include "ni_hevc_rbsp.h"
+#include "refstruct.h"
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "libavutil/mem.h"
 #endif
@@ -60,7 +68,39 @@ struct tile_format {
     int *row_idx;
 };
 
+/* Only the slice header is parsed, from the first bytes of the slice. */
+#define SLICE_HEADER_PROBE_SIZE 4096
+/* Smaller temporal units are not worth waking up the slice threads for */
+#define SLICE_THREAD_THRESHOLD  (64 << 10)
+
+typedef struct HEVCFSplitNAL {
+    int type;
+    int start;  /* first byte of the start code */
+    int offset; /* first byte of the NAL unit header */
+    int size;   /* escaped size, without trailing zero bytes */
+} HEVCFSplitNAL;
+
+/* A slice of the temporal unit re-encoded for its tile */
+typedef struct HEVCFSplitSlice {
+    int nal;        /* index in nals */
+    int tile_idx;
+    int ret;
+    /* room for the parameter sets pending in the stream of the tile, then
+     * the re-encoded slice */
+    AVBufferRef *buf;
+    int prefix;
+    int size;
+} HEVCFSplitSlice;
+
+/* What a slice thread needs to parse and re-encode slices on its own */
+typedef struct HEVCFSplitThread {
+    CodedBitstreamContext *cbc;
+    CodedBitstreamFragment frag;
+    ni_bitstream_t stream;
+} HEVCFSplitThread;
+
 typedef struct HEVCFSplitContext {
+    const AVClass *class;
     AVPacket *buffer_pkt;
     CodedBitstreamContext *cbc;
     CodedBitstreamFragment temporal_unit;
@@ -69,9 +109,37 @@ typedef struct HEVCFSplitContext {
     struct tile_format **this_tile;
     ni_bitstream_t *streams;
 
+    /* NAL units of the temporal unit being split */
+    HEVCFSplitNAL *nals;
+    unsigned int nals_size;
+    int nb_nals;
+
+    /* its slices, re-encoded all at once and returned in order */
+    HEVCFSplitSlice *slices;
+    unsigned int slices_size;
+    int next_slice;
+
+    AVSliceThread *slicethread;
+    HEVCFSplitThread *threads;
+    int nb_threads;
+
+    /* The parameter sets of a temporal unit and their re-encoding for each
+     * tile, reused as long as the following temporal units repeat them
+     * byte for byte. */
+    uint8_t *ps_key;
+    unsigned int ps_key_size;
+    int ps_key_len;
+    uint8_t *ps_raw;
+    unsigned int ps_raw_size;
+    int ps_raw_len;
+    uint8_t *ps_enc;
+    unsigned int ps_enc_size;
+    int *ps_enc_offset;
+    int64_t nb_ps_reused;
+    int64_t nb_ps_encoded;
+
     int tile_enabled;
     int num_tiles;
-    int unit_offset;
     int nb_slices;
 } HEVCFSplitContext;
 
@@ -396,38 +464,6 @@ static int hevc_frame_tiles_encode_pps(HEVCFSplitContext *s, AVBSFContext *ctx,
     return ret;
 }
 
-static int hevc_frame_encode_slice_header(HEVCFSplitContext *s,
-                                          AVBSFContext *ctx,
-                                          CodedBitstreamUnit *unit,
-                                          int tile_idx, int hid) {
-    H265RawSlice *slice             = unit->content;
-    ni_bitstream_t *stream          = &s->streams[tile_idx];
-    CodedBitstreamH265Context *priv = s->cbc->priv_data;
-    H265RawPPS *pps                 = priv->pps[hid];
-    H265RawSPS *sps                 = priv->sps[pps->pps_seq_parameter_set_id];
-    int i, ret;
-
-    ni_write_nal_header(stream, slice->header.nal_unit_header.nal_unit_type, 0,
-                        1);
-
-    ret = ni_hevc_encode_nal_slice_header(stream, &slice->header, sps, pps, -1,
-                                          -1, 1 /* disable tile */, 0, 0,
-                                          1 /* independent */);
-    if (ret < 0) {
-        av_log(ctx, AV_LOG_ERROR, "failed to encode slice header for tile %d\n",
-               tile_idx);
-        return ret;
-    }
-
-    av_assert0((slice->data_bit_start % 8) == 0);
-
-    for (i = 0; i < slice->data_size; i++) {
-        ni_put_bits(stream, 8, slice->data[i]);
-    }
-
-    return 0;
-}
-
 static int hevc_frame_init_bitstream(HEVCFSplitContext *s) {
     int i;
 
@@ -440,6 +476,11 @@ static int hevc_frame_init_bitstream(HEVCFSplitContext *s) {
         ni_bitstream_init(&s->streams[i]);
     }
 
+    s->ps_enc_offset = av_calloc(s->num_tiles + 1, sizeof(*s->ps_enc_offset));
+    if (!s->ps_enc_offset) {
+        return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
@@ -475,37 +516,181 @@ static int hevc_frame_parse_tiles(HEVCFSplitContext *s, AVBSFContext *ctx,
     return 0;
 }
 
-static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
-    HEVCFSplitContext *s       = ctx->priv_data;
+/**
+ * Find the next 00 00 01 start code.
+ *
+ * @return the first byte of the start code, or end
+ */
+static const uint8_t *hevc_frame_find_start_code(const uint8_t *p,
+                                                 const uint8_t *end) {
+    const uint8_t *q = p + 2;
+
+    while (q < end) {
+        q = memchr(q, 1, end - q);
+        if (!q) {
+            break;
+        }
+        if (!q[-1] && !q[-2]) {
+            return q - 2;
+        }
+        q++;
+    }
+    return end;
+}
+
+/**
+ * Locate the NAL units of the packet, without unescaping them. NAL units
+ * CBS would discard are left out.
+ */
+static int hevc_frame_split_nals(HEVCFSplitContext *s, const AVPacket *pkt) {
+    const uint8_t *end = pkt->data + pkt->size;
+    const uint8_t *sc  = hevc_frame_find_start_code(pkt->data, end);
+
+    s->nb_nals   = 0;
+    s->nb_slices = 0;
+
+    while (sc < end) {
+        const uint8_t *nal  = sc + 3;
+        const uint8_t *next = hevc_frame_find_start_code(nal, end);
+        const uint8_t *last = next;
+        HEVCFSplitNAL *n;
+        int type;
+
+        while (last > nal && !last[-1]) {
+            last--;
+        }
+
+        if (last - nal >= 2) {
+            int layer_id = ((nal[0] & 1) << 5) | (nal[1] >> 3);
+
+            type = (nal[0] >> 1) & 0x3F;
+            if (!layer_id || (type >= HEVC_NAL_VPS && type <= HEVC_NAL_PPS)) {
+                n = av_fast_realloc(s->nals, &s->nals_size,
+                                    (s->nb_nals + 1) * sizeof(*s->nals));
+                if (!n) {
+                    return AVERROR(ENOMEM);
+                }
+                s->nals = n;
+
+                n         = &s->nals[s->nb_nals];
+                n->type   = type;
+                n->start  = sc - pkt->data;
+                n->offset = nal - pkt->data;
+                n->size   = last - nal;
+
+                if (type <= HEVC_NAL_RSV_VCL31) {
+                    HEVCFSplitSlice *sl;
+
+                    sl = av_fast_realloc(s->slices, &s->slices_size,
+                                         (s->nb_slices + 1) * sizeof(*s->slices));
+                    if (!sl) {
+                        return AVERROR(ENOMEM);
+                    }
+                    s->slices = sl;
+
+                    sl = &s->slices[s->nb_slices++];
+                    memset(sl, 0, sizeof(*sl));
+                    sl->nal = s->nb_nals;
+                }
+                s->nb_nals++;
+            }
+        }
+        sc = next;
+    }
+
+    return 0;
+}
+
+/**
+ * Share the parameter sets known to the main CBS context with the CBS
+ * contexts of the slice threads.
+ */
+static void hevc_frame_sync_ps(HEVCFSplitContext *s) {
+    const CodedBitstreamH265Context *priv = s->cbc->priv_data;
+    int i, j;
+
+    for (i = 0; i < s->nb_threads; i++) {
+        CodedBitstreamH265Context *tpriv = s->threads[i].cbc->priv_data;
+
+        for (j = 0; j < HEVC_MAX_VPS_COUNT; j++) {
+            ff_refstruct_replace(&tpriv->vps[j], priv->vps[j]);
+        }
+        for (j = 0; j < HEVC_MAX_SPS_COUNT; j++) {
+            ff_refstruct_replace(&tpriv->sps[j], priv->sps[j]);
+        }
+        for (j = 0; j < HEVC_MAX_PPS_COUNT; j++) {
+            ff_refstruct_replace(&tpriv->pps[j], priv->pps[j]);
+        }
+    }
+}
+
+/**
+ * Re-encode the parameter sets of the temporal unit for every tile, or
+ * append the re-encoding of the previous ones when they are the same.
+ */
+static int hevc_frame_tiles_encode_ps(HEVCFSplitContext *s, AVBSFContext *ctx) {
     CodedBitstreamFragment *td = &s->temporal_unit;
-    int i, ret, tile_idx = 0, new_size, *slice_addr;
-    H265RawSlice *slice;
-    ni_bitstream_t *stream = &s->streams[0];
+    const uint8_t *data = s->buffer_pkt->data;
+    int header_size     = s->buffer_pkt->size;
+    uint8_t *p;
+    int i, ret, size;
+
+    /* the key is the escaped parameter sets before the first slice, each
+     * preceded by its size */
+    s->ps_key_len = 0;
+    for (i = 0; i < s->nb_nals; i++) {
+        const HEVCFSplitNAL *nal = &s->nals[i];
+
+        if (nal->type <= HEVC_NAL_RSV_VCL31) {
+            header_size = nal->start;
+            break;
+        }
+        if (nal->type < HEVC_NAL_VPS || nal->type > HEVC_NAL_PPS) {
+            continue;
+        }
 
-    if (!s->tile_enabled) {
-        av_assert0(s->tile_enabled);
-        goto passthrough;
+        p = av_fast_realloc(s->ps_key, &s->ps_key_size,
+                            s->ps_key_len + 4 + nal->size);
+        if (!p) {
+            return AVERROR(ENOMEM);
+        }
+        s->ps_key = p;
+        AV_WB32(s->ps_key + s->ps_key_len, nal->size);
+        memcpy(s->ps_key + s->ps_key_len + 4, data + nal->offset, nal->size);
+        s->ps_key_len += 4 + nal->size;
     }
 
-    if (s->buffer_pkt->data) {
-        av_assert0(s->nb_slices > 0);
-        goto slice_split;
+    if (!s->ps_key_len) {
+        return 0;
     }
 
-    ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-    if (ret < 0) {
-        av_log(ctx, AV_LOG_DEBUG, "failed to get packet ref: 0x%x\n", ret);
-        return ret;
+    if (s->ps_key_len == s->ps_raw_len &&
+        !memcmp(s->ps_key, s->ps_raw, s->ps_key_len)) {
+        for (i = 0; i < s->num_tiles; i++) {
+            ret = ni_bitstream_put_bytes(
+                &s->streams[i], s->ps_enc + s->ps_enc_offset[i],
+                s->ps_enc_offset[i + 1] - s->ps_enc_offset[i]);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        s->nb_ps_reused++;
+        return 0;
     }
 
-    ret = ff_cbs_read_packet(s->cbc, td, s->buffer_pkt);
+    /* the streams are byte aligned between NAL units */
+    s->ps_raw_len = 0;
+    for (i = 0; i < s->num_tiles; i++) {
+        s->ps_enc_offset[i] = ni_bitstream_count(&s->streams[i]) / 8;
+    }
+
+    ret = ff_cbs_read(s->cbc, td, data, header_size);
     if (ret < 0) {
-        av_log(ctx, AV_LOG_WARNING, "Failed to parse temporal unit.\n");
-        goto passthrough;
+        av_log(ctx, AV_LOG_WARNING, "Failed to parse parameter sets.\n");
+        return ret;
     }
+    hevc_frame_sync_ps(s);
 
-    s->nb_slices   = 0;
-    s->unit_offset = 0;
     for (i = 0; i < td->nb_units; i++) {
         CodedBitstreamUnit *unit = &td->units[i];
         av_log(ctx, AV_LOG_DEBUG, "query index %d, unit type %d\n", i,
@@ -515,7 +700,7 @@ static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
             ret = hevc_frame_tiles_encode_vps(s, ctx, unit);
             if (ret < 0) {
                 av_log(ctx, AV_LOG_ERROR, "failed to re-encode vps\n");
-                return ret;
+                goto end;
             }
         } else if (unit->type == HEVC_NAL_SPS) {
             if (i < td->nb_units - 1 && td->units[i + 1].type == HEVC_NAL_PPS) {
@@ -526,102 +711,317 @@ static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
                     ret = hevc_frame_parse_tiles(s, ctx, sps, pps);
                     if (ret < 0) {
                         av_log(ctx, AV_LOG_ERROR, "failed to parse tiles\n");
-                        return ret;
+                        goto end;
                     }
 
                     ret = hevc_frame_tiles_encode_sps(
                         s, ctx, unit, pps->pps_pic_parameter_set_id);
                     if (ret < 0) {
                         av_log(ctx, AV_LOG_ERROR, "failed to re-encode sps\n");
-                        return ret;
+                        goto end;
                     }
                 } else {
                     av_log(ctx, AV_LOG_ERROR,
                            "seq_parameter_set_id mismatch: %d, %d\n",
                            pps->pps_seq_parameter_set_id,
                            sps->sps_seq_parameter_set_id);
-                    return AVERROR(EINVAL);
+                    ret = AVERROR(EINVAL);
+                    goto end;
                 }
             } else {
                 av_log(ctx, AV_LOG_ERROR, "failed to find PPS after SPS\n");
-                return AVERROR(EINVAL);
+                ret = AVERROR(EINVAL);
+                goto end;
             }
         } else if (unit->type == HEVC_NAL_PPS) {
             ret = hevc_frame_tiles_encode_pps(s, ctx, unit);
             if (ret < 0) {
                 av_log(ctx, AV_LOG_ERROR, "failed to re-encode pps\n");
-                return ret;
+                goto end;
             }
-        } else if (unit->type <= HEVC_NAL_RSV_VCL31) {
-            if (s->nb_slices == 0) {
-                s->unit_offset = i;
-            }
-            s->nb_slices++;
         }
     }
 
-    if (s->nb_slices == 0) {
-        ret = AVERROR(EAGAIN);
+    /* keep the re-encoding for the next temporal units */
+    for (i = 0, size = 0; i < s->num_tiles; i++) {
+        size += ni_bitstream_count(&s->streams[i]) / 8 - s->ps_enc_offset[i];
+    }
+    p = av_fast_realloc(s->ps_enc, &s->ps_enc_size, size);
+    if (!p) {
+        ret = AVERROR(ENOMEM);
         goto end;
     }
+    s->ps_enc = p;
 
-slice_split:
-    for (i = s->unit_offset; i < td->nb_units; i++) {
-        CodedBitstreamUnit *unit = &td->units[i];
-        if (unit->type <= HEVC_NAL_RSV_VCL31) {
-            slice = unit->content;
-            tile_idx =
-                slice_addr_to_idx(s, slice->header.slice_segment_address,
-                                  slice->header.slice_pic_parameter_set_id);
-            av_assert0(tile_idx >= 0 && tile_idx < s->num_tiles);
-            av_log(ctx, AV_LOG_DEBUG, "slice_seg_addr %d, tile_idx %d\n",
-                   slice->header.slice_segment_address, tile_idx);
-
-            ret = hevc_frame_encode_slice_header(
-                s, ctx, unit, tile_idx,
-                slice->header.slice_pic_parameter_set_id);
-            if (ret) {
-                av_log(ctx, AV_LOG_ERROR, "failed to re-encode slice header\n");
-                av_assert0(0);
-            }
+    for (i = 0, size = 0; i < s->num_tiles; i++) {
+        int start = s->ps_enc_offset[i];
+        int len   = ni_bitstream_count(&s->streams[i]) / 8 - start;
 
-            stream = &s->streams[tile_idx];
-            break;
+        memcpy(s->ps_enc + size, s->streams[i].pb_buf + start, len);
+        s->ps_enc_offset[i] = size;
+        size += len;
+    }
+    s->ps_enc_offset[s->num_tiles] = size;
+
+    FFSWAP(uint8_t *, s->ps_key, s->ps_raw);
+    FFSWAP(unsigned int, s->ps_key_size, s->ps_raw_size);
+    s->ps_raw_len = s->ps_key_len;
+    s->nb_ps_encoded++;
+
+end:
+#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
+    ff_cbs_fragment_reset(td);
+#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
+    ff_cbs_fragment_reset(s->cbc, td);
+#else
+    ff_cbs_fragment_uninit(s->cbc, td);
+#endif
+    return ret;
+}
+
+/**
+ * Position in the escaped payload of a NAL unit of a position in its
+ * unescaped payload.
+ */
+static int hevc_frame_escaped_offset(const uint8_t *nal, int size, int pos) {
+    int i, zeros = 0;
+
+    for (i = 0; i < size && pos > 0; i++) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
         }
+        zeros = nal[i] ? 0 : zeros + 1;
+        pos--;
     }
 
-    new_size = (int)(ni_bitstream_count(stream) / 8);
-    ret      = av_new_packet(out, new_size);
-    if (ret < 0) {
-        return ret;
+    return i;
+}
+
+/**
+ * Re-encode a slice for its tile into a buffer of its own, leaving room in
+ * front for the parameter sets pending in the stream of the tile. It runs
+ * on the slice threads and only reads the shared context.
+ */
+static int hevc_frame_encode_slice(HEVCFSplitContext *s, AVBSFContext *ctx,
+                                   HEVCFSplitThread *t, HEVCFSplitSlice *sl) {
+    CodedBitstreamFragment *td      = &t->frag;
+    CodedBitstreamH265Context *priv = t->cbc->priv_data;
+    const HEVCFSplitNAL *nal        = &s->nals[sl->nal];
+    const uint8_t *data = s->buffer_pkt->data;
+    int size            = nal->offset + nal->size - nal->start;
+    CodedBitstreamUnit *unit;
+    H265RawSlice *slice;
+    ni_bitstream_t *stream = &t->stream;
+    const H265RawPPS *pps;
+    const H265RawSPS *sps;
+    int ret, hid, offset, header_size;
+
+    /* the slice data is copied as is, so only the header is parsed */
+    ret = ff_cbs_read(t->cbc, td, data + nal->start,
+                      FFMIN(size, SLICE_HEADER_PROBE_SIZE));
+    if ((ret < 0 || td->nb_units != 1) && size > SLICE_HEADER_PROBE_SIZE) {
+#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
+        ff_cbs_fragment_reset(td);
+#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
+        ff_cbs_fragment_reset(t->cbc, td);
+#else
+        ff_cbs_fragment_uninit(t->cbc, td);
+#endif
+        ret = ff_cbs_read(t->cbc, td, data + nal->start, size);
+    }
+    if (ret < 0 || td->nb_units != 1) {
+        av_log(ctx, AV_LOG_ERROR, "failed to parse slice header\n");
+        ret = ret < 0 ? ret : AVERROR_INVALIDDATA;
+        goto end;
     }
 
-    av_packet_copy_props(out, s->buffer_pkt);
+    unit  = &td->units[0];
+    slice = unit->content;
+    hid   = slice->header.slice_pic_parameter_set_id;
+    pps   = priv->pps[hid];
+    sps   = pps ? priv->sps[pps->pps_seq_parameter_set_id] : NULL;
+    if (!sps || !s->tiles[hid]) {
+        av_log(ctx, AV_LOG_ERROR, "slice refers to unknown pps %d\n", hid);
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
 
-    slice_addr = (int *)av_packet_new_side_data(out, AV_PKT_DATA_SLICE_ADDR,
-                                                sizeof(*slice_addr));
-    av_assert0(slice_addr);
-    *slice_addr = tile_idx;
+    sl->tile_idx = slice_addr_to_idx(s, slice->header.slice_segment_address, hid);
+    av_assert0(sl->tile_idx >= 0 && sl->tile_idx < s->num_tiles);
+    av_log(ctx, AV_LOG_DEBUG, "slice_seg_addr %d, tile_idx %d\n",
+           slice->header.slice_segment_address, sl->tile_idx);
 
-    ni_bitstream_fetch(stream, out->data, new_size);
-    ni_bitstream_reset(stream);
+    ni_write_nal_header(stream, slice->header.nal_unit_header.nal_unit_type, 0,
+                        1);
 
-    s->unit_offset++;
-    if (s->unit_offset < td->nb_units) {
-        // To be continued...
-        return ret;
+    ret = ni_hevc_encode_nal_slice_header(stream, &slice->header, sps, pps, -1,
+                                          -1, 1 /* disable tile */, 0, 0,
+                                          1 /* independent */);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to encode slice header for tile %d\n",
+               sl->tile_idx);
+        goto end;
+    }
+
+    av_assert0((slice->data_bit_start % 8) == 0);
+
+    /* the header ends with a non zero byte, so the escaped slice data
+     * follows it unchanged */
+    offset = hevc_frame_escaped_offset(data + nal->offset, nal->size,
+                                       slice->data - unit->data);
+    header_size = ni_bitstream_count(stream) / 8;
+
+    sl->prefix = ni_bitstream_count(&s->streams[sl->tile_idx]) / 8;
+    sl->size   = header_size + nal->size - offset;
+    sl->buf    = av_buffer_alloc(sl->prefix + sl->size +
+                                 AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!sl->buf) {
+        ret = AVERROR(ENOMEM);
+        goto end;
     }
+    memcpy(sl->buf->data + sl->prefix, stream->pb_buf, header_size);
+    memcpy(sl->buf->data + sl->prefix + header_size,
+           data + nal->offset + offset, nal->size - offset);
+    memset(sl->buf->data + sl->prefix + sl->size, 0,
+           AV_INPUT_BUFFER_PADDING_SIZE);
 
 end:
-    av_packet_unref(s->buffer_pkt);
+    ni_bitstream_reset(stream);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, td);
+    ff_cbs_fragment_reset(t->cbc, td);
 #else
-    ff_cbs_fragment_uninit(s->cbc, td);
+    ff_cbs_fragment_uninit(t->cbc, td);
 #endif
     return ret;
+}
+
+static void hevc_frame_slice_job(void *priv, int jobnr, int threadnr,
+                                 int nb_jobs, int nb_threads) {
+    AVBSFContext *ctx    = priv;
+    HEVCFSplitContext *s = ctx->priv_data;
+    HEVCFSplitSlice *sl  = &s->slices[jobnr];
+
+    sl->ret = hevc_frame_encode_slice(s, ctx, &s->threads[threadnr], sl);
+}
+
+/**
+ * Re-encode all the slices of the temporal unit, on the slice threads when
+ * the temporal unit is large enough. The order they are returned in does
+ * not depend on the threads.
+ */
+static void hevc_frame_encode_slices(HEVCFSplitContext *s, AVBSFContext *ctx) {
+    int i;
+
+    if (s->slicethread && s->nb_slices > 1 &&
+        s->buffer_pkt->size >= SLICE_THREAD_THRESHOLD) {
+        avpriv_slicethread_execute(s->slicethread, s->nb_slices, 0);
+        return;
+    }
+
+    for (i = 0; i < s->nb_slices; i++) {
+        hevc_frame_slice_job(ctx, i, 0, s->nb_slices, 1);
+    }
+}
+
+static void hevc_frame_release_slices(HEVCFSplitContext *s) {
+    int i;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        av_buffer_unref(&s->slices[i].buf);
+    }
+    s->nb_slices  = 0;
+    s->next_slice = 0;
+}
+
+static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
+    HEVCFSplitContext *s       = ctx->priv_data;
+    CodedBitstreamFragment *td = &s->temporal_unit;
+    HEVCFSplitSlice *sl;
+    ni_bitstream_t *stream;
+    int ret, pending, *slice_addr;
+
+    if (!s->tile_enabled) {
+        av_assert0(s->tile_enabled);
+        goto passthrough;
+    }
+
+    if (s->buffer_pkt->data) {
+        av_assert0(s->next_slice < s->nb_slices);
+        goto slice_split;
+    }
+
+    ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_DEBUG, "failed to get packet ref: 0x%x\n", ret);
+        return ret;
+    }
+
+    ret = hevc_frame_split_nals(s, s->buffer_pkt);
+    if (ret < 0) {
+        goto end;
+    }
+
+    ret = hevc_frame_tiles_encode_ps(s, ctx);
+    if (ret == AVERROR_INVALIDDATA) {
+        goto passthrough;
+    } else if (ret < 0) {
+        return ret;
+    }
+
+    if (s->nb_slices == 0) {
+        ret = AVERROR(EAGAIN);
+        goto end;
+    }
+
+    hevc_frame_encode_slices(s, ctx);
+
+slice_split:
+    sl = &s->slices[s->next_slice];
+    if (sl->ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to re-encode slice header\n");
+        ret = sl->ret;
+        goto end;
+    }
+
+    /* the parameter sets go with the first slice of the tile */
+    stream  = &s->streams[sl->tile_idx];
+    pending = ni_bitstream_count(stream) / 8;
+    av_assert0(pending == sl->prefix || !pending);
+
+    out->buf  = sl->buf;
+    out->data = sl->buf->data + sl->prefix - pending;
+    out->size = pending + sl->size;
+    sl->buf   = NULL;
+    ni_bitstream_fetch(stream, out->data, pending);
+    ni_bitstream_reset(stream);
+
+    ret = av_packet_copy_props(out, s->buffer_pkt);
+    if (ret < 0) {
+        av_packet_unref(out);
+        goto end;
+    }
+
+    slice_addr = (int *)av_packet_new_side_data(out, AV_PKT_DATA_SLICE_ADDR,
+                                                sizeof(*slice_addr));
+    if (!slice_addr) {
+        av_packet_unref(out);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    *slice_addr = sl->tile_idx;
+
+    if (++s->next_slice < s->nb_slices) {
+        // To be continued...
+        return 0;
+    }
+
+end:
+    hevc_frame_release_slices(s);
+    av_packet_unref(s->buffer_pkt);
+    return ret;
 
 passthrough:
     av_packet_move_ref(out, s->buffer_pkt);
@@ -636,6 +1036,54 @@ passthrough:
     return ret;
 }
 
+/**
+ * Create the slice threads and the contexts each of them parses and
+ * re-encodes slices with.
+ */
+static int hevc_frame_init_threads(HEVCFSplitContext *s, AVBSFContext *ctx) {
+    int nb_threads = s->nb_threads;
+    int i, ret;
+
+    if (nb_threads <= 0) {
+        nb_threads = av_cpu_count();
+    }
+    nb_threads    = FFMIN(nb_threads, s->num_tiles);
+    s->nb_threads = 1;
+    if (nb_threads > 1) {
+        ret = avpriv_slicethread_create(&s->slicethread, ctx,
+                                        hevc_frame_slice_job, NULL, nb_threads);
+        if (ret > 1) {
+            s->nb_threads = ret;
+        } else if (ret < 0 && ret != AVERROR(ENOSYS)) {
+            return ret;
+        } else {
+            avpriv_slicethread_free(&s->slicethread);
+        }
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "%d tiles split on %d threads\n", s->num_tiles,
+           s->nb_threads);
+
+    s->threads = av_calloc(s->nb_threads, sizeof(*s->threads));
+    if (!s->threads) {
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < s->nb_threads; i++) {
+        HEVCFSplitThread *t = &s->threads[i];
+
+        ret = ff_cbs_init(&t->cbc, AV_CODEC_ID_HEVC, ctx);
+        if (ret < 0) {
+            return ret;
+        }
+        ret = ni_bitstream_init(&t->stream);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    hevc_frame_sync_ps(s);
+
+    return 0;
+}
+
 static int hevc_frame_split_init(AVBSFContext *ctx) {
     HEVCFSplitContext *s       = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
@@ -680,6 +1128,12 @@ static int hevc_frame_split_init(AVBSFContext *ctx) {
         goto fail_out;
     }
 
+    ret = hevc_frame_init_threads(s, ctx);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to initialize slice threads\n");
+        goto fail_out;
+    }
+
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
@@ -709,6 +1163,7 @@ static void hevc_frame_split_flush(AVBSFContext *ctx) {
         ni_bitstream_reset(&s->streams[i]);
     }
 
+    hevc_frame_release_slices(s);
     av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(&s->temporal_unit);
@@ -727,6 +1182,17 @@ static void hevc_frame_split_close(AVBSFContext *ctx) {
         ni_bitstream_deinit(&s->streams[i]);
     }
 
+    hevc_frame_release_slices(s);
+    avpriv_slicethread_free(&s->slicethread);
+    if (s->threads) {
+        for (i = 0; i < s->nb_threads; i++) {
+            ni_bitstream_deinit(&s->threads[i].stream);
+            ff_cbs_fragment_free(&s->threads[i].frag);
+            ff_cbs_close(&s->threads[i].cbc);
+        }
+        av_freep(&s->threads);
+    }
+
     for (i = 0; i < HEVC_MAX_PPS_COUNT; i++) {
         if (s->tiles[i]) {
             av_freep(&s->tiles[i]->column_width);
@@ -734,7 +1200,17 @@ static void hevc_frame_split_close(AVBSFContext *ctx) {
         }
     }
 
+    av_log(ctx, AV_LOG_VERBOSE,
+           "parameter sets re-encoded %" PRId64 " times, reused %" PRId64
+           " times\n", s->nb_ps_encoded, s->nb_ps_reused);
+
     av_freep(&s->streams);
+    av_freep(&s->nals);
+    av_freep(&s->slices);
+    av_freep(&s->ps_key);
+    av_freep(&s->ps_raw);
+    av_freep(&s->ps_enc);
+    av_freep(&s->ps_enc_offset);
     av_packet_free(&s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_free(&s->temporal_unit);
@@ -751,6 +1227,27 @@ static const enum AVCodecID hevc_frame_split_codec_ids[] = {
     AV_CODEC_ID_NONE,
 };
 
+#define OFFSET(x) offsetof(HEVCFSplitContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_BSF_PARAM)
+static const AVOption options[] = {
+    {"threads",
+     "number of threads re-encoding the slices of a frame, 0 for automatic",
+     OFFSET(nb_threads),
+     AV_OPT_TYPE_INT,
+     {.i64 = 0},
+     0,
+     INT_MAX,
+     FLAGS},
+    {NULL},
+};
+
+static const AVClass hevc_frame_split_class = {
+    .class_name = "hevc_frame_split",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const
 #if (LIBAVCODEC_VERSION_MAJOR > 59 || LIBAVCODEC_VERSION_MAJOR >= 59 && LIBAVCODEC_VERSION_MINOR >= 37)
 FFBitStreamFilter
@@ -761,9 +1258,11 @@ ff_hevc_frame_split_bsf = {
 #if (LIBAVCODEC_VERSION_MAJOR > 59 || LIBAVCODEC_VERSION_MAJOR >= 59 && LIBAVCODEC_VERSION_MINOR >= 37)
     .p.name         = "hevc_frame_split",
     .p.codec_ids    = hevc_frame_split_codec_ids,
+    .p.priv_class   = &hevc_frame_split_class,
 #else
     .name           = "hevc_frame_split",
     .codec_ids      = hevc_frame_split_codec_ids,
+    .priv_class     = &hevc_frame_split_class,
 #endif
     .priv_data_size = sizeof(HEVCFSplitContext),
     .init           = hevc_frame_split_init,
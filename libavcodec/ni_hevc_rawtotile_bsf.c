@@ -46,11 +46,12 @@
 #endif
 #include "cbs.h"
 #include "cbs_h265.h"
+#include "ni_bsf_async.h"
 #include "ni_hevc_rbsp.h"
 
 
 typedef struct HEVCFtoTileContext {
-    AVPacket *buffer_pkt;
+    NIBSFAsync *async;
     CodedBitstreamContext *cbc;
     CodedBitstreamFragment temporal_unit;
 
@@ -60,6 +61,7 @@ typedef struct HEVCFtoTileContext {
     int row;    //total tile number in row
     int x;
     int y;
+    int async_depth;
 
     ni_bitstream_t stream;
 } HEVCFtoTileContext;
@@ -108,19 +110,14 @@ static int hevc_rawtotile_slice(HEVCFtoTileContext *s, AVBSFContext *ctx, CodedB
     return 0;
 }
 
-static int hevc_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
+/* runs on the worker thread of the instance when async_depth > 1 */
+static int hevc_rawtotile_process(AVBSFContext *ctx, AVPacket *in, AVPacket *out)
 {
     HEVCFtoTileContext *s = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
     int i, ret, new_size, nb_slices, unit_offset;
 
-    ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-    if (ret < 0) {
-        // EOF
-        return ret;
-    }
-
-    ret = ff_cbs_read_packet(s->cbc, td, s->buffer_pkt);
+    ret = ff_cbs_read_packet(s->cbc, td, in);
     if (ret < 0) {
         av_log(ctx, AV_LOG_WARNING, "Failed to parse temporal unit.\n");
         goto passthrough;
@@ -180,13 +177,12 @@ static int hevc_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
         return ret;
     }
 
-    av_packet_copy_props(out, s->buffer_pkt);
+    av_packet_copy_props(out, in);
 
     ni_bitstream_fetch(&s->stream, out->data, new_size);
     ni_bitstream_reset(&s->stream);
 
 end:
-    av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58) && (LIBAVCODEC_VERSION_MINOR >= 54)
@@ -197,7 +193,7 @@ end:
     return ret;
 
 passthrough:
-    av_packet_move_ref(out, s->buffer_pkt);
+    av_packet_move_ref(out, in);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
@@ -208,16 +204,19 @@ passthrough:
     return 0;
 }
 
+static int hevc_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
+{
+    HEVCFtoTileContext *s = ctx->priv_data;
+
+    return ff_ni_bsf_async_filter(s->async, out);
+}
+
 static int hevc_rawtotile_init(AVBSFContext *ctx)
 {
     HEVCFtoTileContext *s = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
     int ret;
 
-    s->buffer_pkt = av_packet_alloc();
-    if (!s->buffer_pkt)
-        return AVERROR(ENOMEM);
-
     ret = ff_cbs_init(&s->cbc, AV_CODEC_ID_HEVC, ctx);
     if (ret < 0)
         return ret;
@@ -248,15 +247,16 @@ static int hevc_rawtotile_init(AVBSFContext *ctx)
 
     ni_bitstream_init(&s->stream);
 
-    return 0;
+    return ff_ni_bsf_async_init(&s->async, ctx, hevc_rawtotile_process,
+                                s->async_depth);
 }
 
 static void hevc_rawtotile_flush(AVBSFContext *ctx)
 {
     HEVCFtoTileContext *s = ctx->priv_data;
 
+    ff_ni_bsf_async_flush(s->async);
     ni_bitstream_reset(&s->stream);
-    av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(&s->temporal_unit);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
@@ -270,8 +270,8 @@ static void hevc_rawtotile_close(AVBSFContext *ctx)
 {
     HEVCFtoTileContext *s = ctx->priv_data;
 
+    ff_ni_bsf_async_free(&s->async);
     ni_bitstream_deinit(&s->stream);
-    av_packet_free(&s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_free(&s->temporal_unit);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
@@ -295,6 +295,8 @@ static const AVOption options[] = {
         {"row", NULL, OFFSET(row), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 128, 0, 0},  //support 128 rows max
         {"x", NULL, OFFSET(x), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 8192, 0, 0},  //support 8192 columns max
         {"y", NULL, OFFSET(y), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 8192, 0, 0},  //support 8192 rows max
+        {"async_depth", "number of packets in flight on a worker thread, 1 to convert them synchronously",
+         OFFSET(async_depth), AV_OPT_TYPE_INT, {.i64 = 1}, 1, NI_BSF_ASYNC_MAX_DEPTH, 0, 0},
         { NULL },
 };
 
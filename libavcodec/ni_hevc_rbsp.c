@@ -109,6 +109,32 @@ static void ni_put_byte(ni_bitstream_t *stream, uint8_t data) {
     flush_put_bits(&stream->pbc);
 }
 
+/**
+ * \brief Append data that is already escaped to a byte aligned bitstream
+ * \param stream  stream the data is to be appended to
+ * \param data  escaped data, a NAL unit payload or whole NAL units
+ * \param size  number of bytes of data
+ */
+int ni_bitstream_put_bytes(ni_bitstream_t *stream, const uint8_t *data,
+                           int size) {
+    av_assert0(stream->cur_bits == 0);
+
+    if (size > put_bytes_left(&stream->pbc, 0)) {
+        return AVERROR(ENOSPC);
+    }
+
+    memcpy(put_bits_ptr(&stream->pbc), data, size);
+    skip_put_bytes(&stream->pbc, size);
+
+    // escaped data ends with at most two zero bytes
+    stream->zero_cnt = 0;
+    while (stream->zero_cnt < 2 && stream->zero_cnt < size &&
+           !data[size - 1 - stream->zero_cnt]) {
+        stream->zero_cnt++;
+    }
+    return 0;
+}
+
 /**
  * \brief Write bits to bitstream
  *        Buffers individual bits untill they make a full byte.
@@ -26,6 +26,8 @@
  * just one frame.
  */
 
+#include <string.h>
+
 #include "version.h"
 
 #include "libavutil/avassert.h"
@@ -39,12 +41,6 @@
 #include "bsf.h"
 #endif
 
-#if (LIBAVCODEC_VERSION_MAJOR > 59 || LIBAVCODEC_VERSION_MAJOR >= 59 && LIBAVCODEC_VERSION_MINOR >= 37)
-#include "startcode.h"
-#else
-#include "internal.h"
-#endif
-
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "hevc/hevc.h"
 #include "libavutil/mem.h"
@@ -52,19 +48,163 @@
 #include "hevc.h"
 #endif
 
+typedef struct HEVCRepackRange {
+    int offset;
+    int size;
+} HEVCRepackRange;
+
+typedef struct HEVCRepackTile {
+    AVPacket *pkt;
+    /* NAL units the tile adds to the frame, found when it arrives;
+     * adjacent ones are merged so a tile usually needs a single copy */
+    HEVCRepackRange *ranges;
+    unsigned int ranges_size;
+    int nb_ranges;
+    int size;
+} HEVCRepackTile;
+
 typedef struct HEVCRepackContext {
     AVPacket *buffer_pkt;
-    AVPacket **tile_pkt;
+    HEVCRepackTile *tiles;
+    /* frames are allocated from a pool sized to the largest frame so far */
+    AVBufferPool *pool;
+    int pool_size;
+    int first_tile;
     int tile_pos;
     int tile_num;
 } HEVCRepackContext;
 
+static int hevc_tile_repack_add_range(HEVCRepackTile *tile, int offset,
+                                      int size) {
+    HEVCRepackRange *r;
+
+    if (tile->nb_ranges) {
+        r = &tile->ranges[tile->nb_ranges - 1];
+        if (r->offset + r->size == offset) {
+            r->size    += size;
+            tile->size += size;
+            return 0;
+        }
+    }
+
+    r = av_fast_realloc(tile->ranges, &tile->ranges_size,
+                        (tile->nb_ranges + 1) * sizeof(*tile->ranges));
+    if (!r) {
+        return AVERROR(ENOMEM);
+    }
+    tile->ranges = r;
+
+    r = &tile->ranges[tile->nb_ranges++];
+    r->offset   = offset;
+    r->size     = size;
+    tile->size += size;
+    return 0;
+}
+
+/**
+ * Find the next 00 00 01 start code followed by a NAL unit header, the way
+ * avpriv_find_start_code() does, but with memchr() looking for the 01 so
+ * that slice payloads are skipped many bytes at a time.
+ *
+ * @return the first byte of the start code, or end
+ */
+static const uint8_t *hevc_tile_repack_find_nal(const uint8_t *p,
+                                                const uint8_t *end) {
+    const uint8_t *q = p + 2;
+
+    while (end - q >= 3) {
+        q = memchr(q, 1, end - 2 - q);
+        if (!q) {
+            break;
+        }
+        if (!q[-1] && !q[-2]) {
+            return q - 2;
+        }
+        q++;
+    }
+    return end;
+}
+
+/**
+ * Find the NAL units of a tile that go into the frame: all of the first
+ * tile, only the VCL NAL units of the others. Each unit runs from its
+ * 00 00 01 to the 00 00 01 of the next one.
+ */
+static int hevc_tile_repack_scan(AVBSFContext *ctx, HEVCRepackTile *tile,
+                                 int tile_idx) {
+    const uint8_t *start = tile->pkt->data;
+    const uint8_t *end   = start + tile->pkt->size;
+    const uint8_t *nal   = NULL;
+    const uint8_t *ptr;
+    int ret;
+
+    tile->nb_ranges = 0;
+    tile->size      = 0;
+
+    if (tile_idx == 0) {
+        return hevc_tile_repack_add_range(tile, 0, tile->pkt->size);
+    }
+
+    for (ptr = hevc_tile_repack_find_nal(start, end); ptr < end;
+         ptr = hevc_tile_repack_find_nal(ptr + 4, end)) {
+        int nalu_type = (ptr[3] >> 1) & 0x3F;
+
+        av_log(ctx, AV_LOG_DEBUG, "tile %d, nal type %d at %d\n", tile_idx,
+               nalu_type, (int)(ptr - start));
+
+        if (nal) {
+            ret = hevc_tile_repack_add_range(tile, nal - start, ptr - nal);
+            if (ret < 0) {
+                return ret;
+            }
+            nal = NULL;
+        }
+
+        if (nalu_type <= HEVC_NAL_RSV_VCL31) {
+            nal = ptr;
+        }
+    }
+
+    if (nal) {
+        return hevc_tile_repack_add_range(tile, nal - start, end - nal);
+    }
+    return 0;
+}
+
+static int hevc_tile_repack_copy_props(AVPacket *dst, const AVPacket *src) {
+    int i;
+
+    dst->pts          = src->pts;
+    dst->dts          = src->dts;
+    dst->pos          = src->pos;
+    dst->flags        = src->flags;
+    dst->stream_index = src->stream_index;
+
+    for (i = 0; i < src->side_data_elems; i++) {
+        enum AVPacketSideDataType type = src->side_data[i].type;
+        uint8_t *dst_data;
+
+        if (type == AV_PKT_DATA_SLICE_ADDR) {
+            continue;
+        }
+
+        dst_data = av_packet_new_side_data(dst, type, src->side_data[i].size);
+        if (!dst_data) {
+            av_packet_free_side_data(dst);
+            return AVERROR(ENOMEM);
+        }
+        memcpy(dst_data, src->side_data[i].data, src->side_data[i].size);
+    }
+    return 0;
+}
+
 static int hevc_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
     HEVCRepackContext *s = ctx->priv_data;
+    HEVCRepackTile *tile;
     int ret;
     int tile_idx;
     int *side_data;
-    int i;
+    int i, j;
 
     av_log(ctx, AV_LOG_DEBUG, "tile_pos %d, tile_num %d\n", s->tile_pos,
            s->tile_num);
@@ -87,140 +227,94 @@ static int hevc_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
         }
 
         tile_idx = *side_data;
-        if (tile_idx >= s->tile_num) {
+        if (tile_idx < 0 || tile_idx >= s->tile_num) {
             av_log(ctx, AV_LOG_ERROR,
                    "tile index %d exceeds maximum tile number %d\n", tile_idx,
                    s->tile_num);
             return AVERROR(EINVAL);
         }
 
-        if (s->tile_pkt[tile_idx]->buf) {
+        tile = &s->tiles[tile_idx];
+        if (tile->pkt->data) {
             av_log(ctx, AV_LOG_ERROR, "duplicated tile index %d\n", tile_idx);
             return AVERROR(EINVAL);
         }
 
-        s->tile_pkt[tile_idx]->buf = av_buffer_ref(s->buffer_pkt->buf);
-        if (!s->tile_pkt[tile_idx]->buf) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to get buffer for tile index %d\n", tile_idx);
-            return AVERROR(ENOMEM);
-        }
-        s->tile_pkt[tile_idx]->data = s->buffer_pkt->data;
-        s->tile_pkt[tile_idx]->size = s->buffer_pkt->size;
-
-        av_log(ctx, AV_LOG_DEBUG, "tile %d, data actual size %d\n", tile_idx,
-               s->buffer_pkt->size);
-
         if (s->tile_pos == 0) {
-            s->tile_pkt[0]->pts          = s->buffer_pkt->pts;
-            s->tile_pkt[0]->dts          = s->buffer_pkt->dts;
-            s->tile_pkt[0]->pos          = s->buffer_pkt->pos;
-            s->tile_pkt[0]->flags        = s->buffer_pkt->flags;
-            s->tile_pkt[0]->stream_index = s->buffer_pkt->stream_index;
-
-            s->tile_pkt[0]->side_data       = NULL;
-            s->tile_pkt[0]->side_data_elems = 0;
-
-            for (i = 0; i < s->tile_pkt[0]->side_data_elems; i++) {
-                enum AVPacketSideDataType type =
-                    s->buffer_pkt->side_data[i].type;
-                if (type != AV_PKT_DATA_SLICE_ADDR) {
-                    int size          = s->buffer_pkt->side_data[i].size;
-                    uint8_t *src_data = s->buffer_pkt->side_data[i].data;
-                    uint8_t *dst_data =
-                        av_packet_new_side_data(s->tile_pkt[0], type, size);
-
-                    if (!dst_data) {
-                        av_packet_free_side_data(s->tile_pkt[0]);
-                        return AVERROR(ENOMEM);
-                    }
-
-                    memcpy(dst_data, src_data, size);
-                }
-            }
+            s->first_tile = tile_idx;
         } else {
-            if (s->buffer_pkt->pts != s->tile_pkt[0]->pts ||
-                s->buffer_pkt->dts != s->tile_pkt[0]->dts ||
-                s->buffer_pkt->flags != s->tile_pkt[0]->flags ||
-                s->buffer_pkt->stream_index != s->tile_pkt[0]->stream_index) {
+            const AVPacket *first = s->tiles[s->first_tile].pkt;
+
+            if (s->buffer_pkt->pts != first->pts ||
+                s->buffer_pkt->dts != first->dts ||
+                s->buffer_pkt->flags != first->flags ||
+                s->buffer_pkt->stream_index != first->stream_index) {
                 av_log(ctx, AV_LOG_ERROR, "packet metadata does not match\n");
                 return AVERROR(EINVAL);
             }
         }
+
+        av_packet_move_ref(tile->pkt, s->buffer_pkt);
+
+        ret = hevc_tile_repack_scan(ctx, tile, tile_idx);
+        if (ret < 0) {
+            av_packet_unref(tile->pkt);
+            return ret;
+        }
+
+        av_log(ctx, AV_LOG_DEBUG, "tile %d, data actual size %d, %d bytes "
+               "in %d ranges\n", tile_idx, tile->pkt->size, tile->size,
+               tile->nb_ranges);
+
         s->tile_pos++;
-        av_packet_unref(s->buffer_pkt);
     }
 
     if (s->tile_pos == s->tile_num) {
         int new_size = 0;
-        int found;
-        const uint8_t *ptr;
-        const uint8_t *end;
-        const uint8_t *p_offset;
-        uint32_t nalu_type;
-        uint32_t stc;
-        uint8_t *data;
-        AVBufferRef *buf;
-
-        /* max payload size */
+        uint8_t *dst;
+
         for (i = 0; i < s->tile_num; i++) {
-            new_size += s->tile_pkt[i]->size;
+            new_size += s->tiles[i].size;
+        }
+
+        if (new_size + AV_INPUT_BUFFER_PADDING_SIZE > s->pool_size) {
+            av_buffer_pool_uninit(&s->pool);
+            s->pool_size = new_size + new_size / 4 +
+                           AV_INPUT_BUFFER_PADDING_SIZE;
+            s->pool = av_buffer_pool_init(s->pool_size, NULL);
+            if (!s->pool) {
+                s->pool_size = 0;
+                return AVERROR(ENOMEM);
+            }
         }
 
-        buf = av_buffer_alloc(new_size);
-        if (!buf) {
+        out->buf = av_buffer_pool_get(s->pool);
+        if (!out->buf) {
             av_log(ctx, AV_LOG_ERROR, "failed to allocate new packet data\n");
             return AVERROR(ENOMEM);
         }
+        out->data = out->buf->data;
+        out->size = new_size;
+        memset(out->data + new_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
-        data = buf->data;
-        memcpy(data, s->tile_pkt[0]->data, s->tile_pkt[0]->size);
-        new_size = s->tile_pkt[0]->size;
-        av_log(ctx, AV_LOG_DEBUG, "tile %d size %d\n", 0, new_size);
-        av_buffer_unref(&s->tile_pkt[0]->buf);
-        s->tile_pkt[0]->buf = NULL;
-
-        for (i = 1; i < s->tile_num; i++) {
-            ptr = s->tile_pkt[i]->data;
-            end = s->tile_pkt[i]->data + s->tile_pkt[i]->size;
-
-            stc   = -1;
-            found = 0;
-            ptr   = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
-            while (ptr < end) {
-                av_log(ctx, AV_LOG_DEBUG, "tile %d, %02x %02x %02x %02x %02x\n",
-                       i, *(ptr - 4), *(ptr - 3), *(ptr - 2), *(ptr - 1), *ptr);
-
-                if (found) {
-                    memcpy(data + new_size, p_offset, ptr - 4 - p_offset);
-                    new_size += (int)(ptr - 4 - p_offset);
-                    found = 0;
-                }
-
-                nalu_type = (stc >> 1) & 0x3F;
-                if (nalu_type <= HEVC_NAL_RSV_VCL31) {
-                    p_offset = ptr - 4;
-                    found    = 1;
-                }
-
-                stc = -1;
-                ptr = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
-            }
+        ret = hevc_tile_repack_copy_props(out, s->tiles[s->first_tile].pkt);
+        if (ret < 0) {
+            av_packet_unref(out);
+            return ret;
+        }
 
-            if (found) {
-                memcpy(data + new_size, p_offset, end - p_offset);
-                new_size += (int)(end - p_offset);
-                av_log(ctx, AV_LOG_DEBUG, "tile %d size %d\n", i,
-                       (int)(end - p_offset));
+        /* a single gather pass over the ranges found on arrival */
+        dst = out->data;
+        for (i = 0; i < s->tile_num; i++) {
+            tile = &s->tiles[i];
+            for (j = 0; j < tile->nb_ranges; j++) {
+                memcpy(dst, tile->pkt->data + tile->ranges[j].offset,
+                       tile->ranges[j].size);
+                dst += tile->ranges[j].size;
             }
-            av_buffer_unref(&s->tile_pkt[i]->buf);
-            s->tile_pkt[i]->buf = NULL;
+            av_packet_unref(tile->pkt);
         }
 
-        out->buf  = buf;
-        out->data = data;
-        out->size = new_size;
-
         av_log(ctx, AV_LOG_DEBUG, "repacket new size %d\n", new_size);
 
         s->tile_pos = 0;
@@ -232,7 +326,6 @@ static int hevc_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
 
 static int hevc_tile_repack_init(AVBSFContext *ctx) {
     HEVCRepackContext *s = ctx->priv_data;
-    int ret;
     int i;
 
     av_log(ctx, AV_LOG_INFO, "number of tiles %d\n", s->tile_num);
@@ -245,33 +338,19 @@ static int hevc_tile_repack_init(AVBSFContext *ctx) {
         return AVERROR(ENOMEM);
     }
 
-    s->tile_pkt = av_malloc(sizeof(AVPacket *) * s->tile_num);
-    if (!s->tile_pkt) {
-        ret = AVERROR(ENOMEM);
-        goto fail_alloc_tile_pkt;
+    s->tiles = av_calloc(s->tile_num, sizeof(*s->tiles));
+    if (!s->tiles) {
+        return AVERROR(ENOMEM);
     }
-    memset(s->tile_pkt, 0, sizeof(AVPacket *) * s->tile_num);
 
     for (i = 0; i < s->tile_num; i++) {
-        s->tile_pkt[i] = av_packet_alloc();
-        if (!s->tile_pkt[i]) {
-            ret = AVERROR(ENOMEM);
-            goto fail_alloc_pkts;
+        s->tiles[i].pkt = av_packet_alloc();
+        if (!s->tiles[i].pkt) {
+            return AVERROR(ENOMEM);
         }
     }
 
     return 0;
-
-fail_alloc_pkts:
-    for (i -= 1; i >= 0; i--) {
-        av_packet_free(&s->tile_pkt[i]);
-    }
-    av_freep(&s->tile_pkt);
-
-fail_alloc_tile_pkt:
-    av_packet_free(&s->buffer_pkt);
-
-    return ret;
 }
 
 static void hevc_tile_repack_flush(AVBSFContext *ctx) {
@@ -281,8 +360,9 @@ static void hevc_tile_repack_flush(AVBSFContext *ctx) {
     av_packet_unref(s->buffer_pkt);
 
     for (i = 0; i < s->tile_num; i++) {
-        av_packet_unref(s->tile_pkt[i]);
+        av_packet_unref(s->tiles[i].pkt);
     }
+    s->tile_pos = 0;
 }
 
 static void hevc_tile_repack_close(AVBSFContext *ctx) {
@@ -291,10 +371,14 @@ static void hevc_tile_repack_close(AVBSFContext *ctx) {
 
     av_packet_free(&s->buffer_pkt);
 
-    for (i = 0; i < s->tile_num; i++) {
-        av_packet_free(&s->tile_pkt[i]);
+    if (s->tiles) {
+        for (i = 0; i < s->tile_num; i++) {
+            av_packet_free(&s->tiles[i].pkt);
+            av_freep(&s->tiles[i].ranges);
+        }
     }
-    av_freep(&s->tile_pkt);
+    av_freep(&s->tiles);
+    av_buffer_pool_uninit(&s->pool);
 }
 
 static const enum AVCodecID hevc_tile_repack_codec_ids[] = {
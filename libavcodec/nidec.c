@@ -89,6 +89,12 @@ int ff_xcoder_decode_close(AVCodecContext *avctx)
     /* this call shall release resource based on s->api_ctx */
     xcoder_dec_close(avctx, s);
 
+    if (s->frame_pool)
+        av_log(avctx, AV_LOG_VERBOSE, "Decoder frame pool: %" PRIu64 " hits, "
+               "%" PRIu64 " misses\n", s->frame_pool_hits, s->frame_pool_misses);
+    av_buffer_unref(&s->frame_buf);
+    av_buffer_pool_uninit(&s->frame_pool);
+
     av_packet_unref(&s->buffered_pkt);
     av_packet_unref(&s->lone_sei_pkt);
 
@@ -681,6 +687,84 @@ static inline void __ni_free(void *opaque, uint8_t *data)
     free(data); // Free data allocated by libxcoder
 }
 
+static AVBufferRef *dec_frame_buffer_alloc(void *opaque, size_t size)
+{
+    XCoderDecContext *s = opaque;
+
+    s->frame_pool_misses++;
+    /* page aligned like the buffers of the libxcoder frame pool */
+    return av_buffer_alloc_quadra(size);
+}
+
+/**
+ * Get a buffer from the frame pool and lay out xfme in it for the decoder to
+ * read the next frame into. The layout is taken from libxcoder once per frame
+ * geometry, the pool is recreated when it changes.
+ */
+static int dec_frame_buffer_get(XCoderDecContext *s, ni_frame_t *xfme,
+                                int width, int height, int alignment,
+                                int factor, int planar)
+{
+    uint64_t misses = s->frame_pool_misses;
+    uint8_t *p;
+    int i;
+
+    av_buffer_unref(&s->frame_buf);
+
+    if (!s->frame_pool || s->pool_width != width ||
+        s->pool_height != height || s->pool_alignment != alignment ||
+        s->pool_factor != factor || s->pool_planar != planar) {
+        ni_frame_t layout = { 0 };
+
+        av_buffer_pool_uninit(&s->frame_pool);
+        /* without alloc_mem only the buffer layout is set up */
+        if (ni_decoder_frame_buffer_alloc(NULL, &layout, 0, width, height,
+                                          alignment, factor, planar) !=
+            NI_RETCODE_SUCCESS)
+            return AVERROR_EXTERNAL;
+        s->pool_buf_size = layout.buffer_size;
+        memcpy(s->pool_data_len, layout.data_len, sizeof(s->pool_data_len));
+        ni_decoder_frame_buffer_free(&layout);
+
+        s->frame_pool = av_buffer_pool_init2(s->pool_buf_size, s,
+                                             dec_frame_buffer_alloc, NULL);
+        if (!s->frame_pool)
+            return AVERROR(ENOMEM);
+        s->pool_width     = width;
+        s->pool_height    = height;
+        s->pool_alignment = alignment;
+        s->pool_factor    = factor;
+        s->pool_planar    = planar;
+    }
+
+    s->frame_buf = av_buffer_pool_get(s->frame_pool);
+    if (!s->frame_buf)
+        return AVERROR(ENOMEM);
+    if (s->frame_pool_misses == misses)
+        s->frame_pool_hits++;
+
+    p = s->frame_buf->data;
+    xfme->p_buffer    = p;
+    xfme->buffer_size = s->pool_buf_size;
+    for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        xfme->data_len[i] = s->pool_data_len[i];
+        xfme->p_data[i]   = s->pool_data_len[i] ? p : NULL;
+        p += s->pool_data_len[i];
+    }
+    xfme->video_width  = width;
+    xfme->video_height = height;
+    return 0;
+}
+
+static void dec_frame_buffer_free(XCoderDecContext *s, ni_frame_t *xfme)
+{
+    /* a pooled buffer is not libxcoder's to free */
+    if (s->frame_buf && xfme->p_buffer == s->frame_buf->data)
+        xfme->p_buffer = NULL;
+    av_buffer_unref(&s->frame_buf);
+    ni_decoder_frame_buffer_free(xfme);
+}
+
 static enum AVPixelFormat ni_supported_pixel_formats[] =
 {
     AV_PIX_FMT_YUV420P, //0
@@ -1729,6 +1813,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
                        sizeof(niFrameSurface1_t));
             }
         }
+    } else if (s->frame_buf && xfme->p_buffer == s->frame_buf->data) {
+        // the frame was read into a pooled buffer, hand it over as is
+        frame->buf[0] = s->frame_buf;
+        s->frame_buf  = NULL;
     } else {
         frame->buf[0] = av_buffer_create(buf, buf_size, ni_align_free, xfme->dec_buf, 0);
     }
@@ -2085,7 +2173,14 @@ read_op:
         break;
     }
 
-    if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
+    if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD && alloc_mem) {
+        ret = dec_frame_buffer_get(s, &(p_session_data->data.frame),
+                                   actual_width, height,
+                                   (avctx->codec_id == AV_CODEC_ID_H264),
+                                   s->api_ctx.bit_depth_factor, frame_planar);
+        if (ret < 0)
+            return ret;
+    } else if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
         ret = ni_decoder_frame_buffer_alloc(
             s->api_ctx.dec_fme_buf_pool, &(p_session_data->data.frame), alloc_mem,
             actual_width, height, (avctx->codec_id == AV_CODEC_ID_H264),
@@ -2110,7 +2205,7 @@ read_op:
     if (ret == 0) {
         s->eos = p_session_data->data.frame.end_of_stream;
         if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
-            ni_decoder_frame_buffer_free(&(p_session_data->data.frame));
+            dec_frame_buffer_free(s, &(p_session_data->data.frame));
         } else {
             ni_frame_buffer_free(&(p_session_data->data.frame));
         }
@@ -2129,7 +2224,7 @@ read_op:
             av_log(avctx, AV_LOG_DEBUG,
                    "Current frame is dropped when AV_PKT_FLAG_DISCARD is set\n");
             if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
-                ni_decoder_frame_buffer_free(&(p_session_data->data.frame));
+                dec_frame_buffer_free(s, &(p_session_data->data.frame));
             } else {
                 // recycle frame mem bin buffer of all PPU outputs & free p_buffer
                 int num_outputs = (s->api_param.dec_input_params.enable_out1 > 0) +
@@ -2252,6 +2347,7 @@ read_op:
         // release buffer ownership and let frame owner return frame buffer to
         // buffer pool later
         p_session_data->data.frame.dec_buf = NULL;
+        av_buffer_unref(&s->frame_buf);
 
         ni_memfree(p_session_data->data.frame.p_custom_sei_set);
     } else {
@@ -2261,7 +2357,7 @@ read_op:
         if (NI_RETCODE_ERROR_VPU_RECOVERY == ret) {
             av_log(avctx, AV_LOG_WARNING, "xcoder_dec_receive VPU recovery, need to reset ..\n");
             if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
-                ni_decoder_frame_buffer_free(&(p_session_data->data.frame));
+                dec_frame_buffer_free(s, &(p_session_data->data.frame));
             } else {
                 ni_frame_buffer_free(&(p_session_data->data.frame));
             }
@@ -2269,14 +2365,14 @@ read_op:
         } else if (ret == NI_RETCODE_ERROR_INVALID_SESSION ||
                   ret == NI_RETCODE_ERROR_NVME_CMD_FAILED) {
             if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
-                ni_decoder_frame_buffer_free(&(p_session_data->data.frame));
+                dec_frame_buffer_free(s, &(p_session_data->data.frame));
             } else {
                 ni_frame_buffer_free(&(p_session_data->data.frame));
             }
             return AVERROR_EOF;
         }
         if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
-            ni_decoder_frame_buffer_free(&(p_session_data->data.frame));
+            dec_frame_buffer_free(s, &(p_session_data->data.frame));
         } else {
             ni_frame_buffer_free(&(p_session_data->data.frame));
         }
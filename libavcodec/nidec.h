@@ -85,6 +85,20 @@ typedef struct XCoderDecContext {
     int eos;
     AVHWFramesContext    *frames;
 
+    /* system memory frames are read into buffers from frame_pool, which are
+     * laid out as libxcoder lays out a frame of the pool_* geometry */
+    AVBufferPool *frame_pool;
+    AVBufferRef *frame_buf;         /* buffer of the frame being read */
+    int pool_width;
+    int pool_height;
+    int pool_alignment;
+    int pool_factor;
+    int pool_planar;
+    uint32_t pool_buf_size;
+    uint32_t pool_data_len[NI_MAX_NUM_DATA_POINTERS];
+    uint64_t frame_pool_hits;
+    uint64_t frame_pool_misses;     /* buffers allocated by the pool */
+
 #if LIBAVCODEC_VERSION_MAJOR >= 60
     /* for temporarily storing the opaque pointers when AV_CODEC_FLAG_COPY_OPAQUE is set */
     OpaqueData *opaque_data_array;
@@ -33,10 +33,12 @@
 
 #include "libavcodec/put_bits.h"
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/hdr_dynamic_metadata.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/hwcontext_ni_quad.h"
 #include "libavutil/mastering_display_metadata.h"
+#include "libavutil/time.h"
 #include "ni_av_codec.h"
 #include "ni_util.h"
 #include "put_bits.h"
@@ -294,6 +296,97 @@ static int xcoder_encoder_header_check_set(AVCodecContext *avctx)
     return 0;
 }
 
+// frames accepted beyond lookahead and GOP, covering the device input queue
+#define NI_ENC_RING_MARGIN 16
+
+// number of frames the encoder holds back before it outputs one: the lookahead
+// plus one reordering GOP
+static int input_ring_capacity(const ni_xcoder_params_t *pparams)
+{
+    const ni_encoder_cfg_params_t *cfg = &pparams->cfg_enc_params;
+    int gop_size;
+
+    if (cfg->custom_gop_params.custom_gop_size) {
+        gop_size = cfg->custom_gop_params.custom_gop_size;
+    } else {
+        switch (cfg->gop_preset_index) {
+        case 1:
+        case 2:
+        case 3:
+        case 9:
+            gop_size = 1;
+            break;
+        case 4:
+            gop_size = 2;
+            break;
+        case 5:
+        case 6:
+        case 7:
+        case 10:
+            gop_size = 4;
+            break;
+        default: // adaptive GOP, random access
+            gop_size = 8;
+            break;
+        }
+    }
+
+    return FFMIN(FFMAX(cfg->lookAheadDepth, 0) + gop_size + NI_ENC_RING_MARGIN,
+                 NI_MAX_FIFO_CAPACITY);
+}
+
+static void input_ring_free(NIEncFrameRing *r)
+{
+    av_freep(&r->frames);
+    r->capacity = 0;
+    r->head     = 0;
+    r->count    = 0;
+}
+
+static int input_ring_alloc(NIEncFrameRing *r, int capacity)
+{
+    input_ring_free(r);
+    r->frames = av_calloc(capacity, sizeof(*r->frames));
+    if (!r->frames) {
+        return AVERROR(ENOMEM);
+    }
+    r->capacity = capacity;
+    r->head     = 0;
+    r->count    = 0;
+    r->peak     = 0;
+    r->nb_full  = 0;
+    r->last_report = 0;
+    r->report_peak = 0;
+    r->report_full = 0;
+    return 0;
+}
+
+// interval of the verbose fill level reports, in microseconds
+#define NI_ENC_RING_REPORT_INTERVAL 1000000
+
+static void input_ring_report(AVCodecContext *avctx, NIEncFrameRing *r)
+{
+    int64_t now = av_gettime_relative();
+
+    if (!r->frames)
+        return;
+    if (!r->last_report) {
+        r->last_report = now;
+        return;
+    }
+    if (now - r->last_report < NI_ENC_RING_REPORT_INTERVAL)
+        return;
+
+    av_log(avctx, AV_LOG_VERBOSE, "Encoder input ring: fill %d/%d, peak %d, "
+           "full %"PRIu64" times in the last %.1fs\n", r->count, r->capacity,
+           r->report_peak, r->nb_full - r->report_full,
+           (now - r->last_report) / 1000000.0);
+
+    r->last_report = now;
+    r->report_peak = r->count;
+    r->report_full = r->nb_full;
+}
+
 static int xcoder_setup_encoder(AVCodecContext *avctx)
 {
     XCoderEncContext *s = avctx->priv_data;
@@ -337,26 +430,6 @@ static int xcoder_setup_encoder(AVCodecContext *avctx)
     s->latest_dts = 0;
     s->first_frame_pts = INT_MIN;
 
-    if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != s->api_ctx.session_run_state) {
-        av_log(avctx, AV_LOG_INFO, "Session state: %d allocate frame fifo.\n",
-               s->api_ctx.session_run_state);
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        s->fme_fifo = av_fifo_alloc2((size_t) 1, sizeof(AVFrame), 0);
-#else
-        s->fme_fifo = av_fifo_alloc(sizeof(AVFrame));
-#endif
-    } else {
-        av_log(avctx, AV_LOG_INFO, "Session seq change, fifo size: %lu.\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-               av_fifo_can_read(s->fme_fifo));
-#else
-               av_fifo_size(s->fme_fifo) / sizeof(AVFrame));
-#endif
-    }
-
-    if (!s->fme_fifo) {
-        return AVERROR(ENOMEM);
-    }
     s->eos_fme_received = 0;
 
     //Xcoder User Configuration
@@ -696,6 +769,18 @@ static int xcoder_setup_encoder(AVCodecContext *avctx)
     }
     av_log(avctx, AV_LOG_VERBOSE, "dts offset set to %ld\n", s->dtsOffset);
 
+    if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != s->api_ctx.session_run_state) {
+        ret = input_ring_alloc(&s->fme_ring, input_ring_capacity(pparams));
+        if (ret < 0) {
+            return ret;
+        }
+        av_log(avctx, AV_LOG_INFO, "Session state: %d allocate frame ring of %d.\n",
+               s->api_ctx.session_run_state, s->fme_ring.capacity);
+    } else {
+        av_log(avctx, AV_LOG_INFO, "Session seq change, ring fill: %d.\n",
+               s->fme_ring.count);
+    }
+
     s->total_frames_received = 0;
     s->gop_offset_count = 0;
     av_log(avctx, AV_LOG_INFO, "dts offset: %ld, gop_offset_count: %d\n",
@@ -846,6 +931,126 @@ av_cold int ff_xcoder_encode_init(AVCodecContext *avctx)
     return 0;
 }
 
+// Packets are read into NI_MAX_TX_SZ buffers. Only those filling a good part
+// of one are handed out without a copy, smaller ones are not worth pinning it.
+#define NI_ENC_ZEROCOPY_MIN_SIZE (NI_MAX_TX_SZ / 4)
+// pool buffers, including the one reads go to, beyond which packets are read
+// into libxcoder buffers and copied
+#define NI_ENC_PKT_POOL_MAX      4
+
+static void xcoder_packet_buffer_free(void *opaque, uint8_t *data)
+{
+    ni_packet_t xpkt = { 0 };
+
+    xpkt.p_buffer = data;
+    ni_packet_buffer_free(&xpkt);
+}
+
+static AVBufferRef *xcoder_packet_buffer_alloc(void *opaque, size_t size)
+{
+    XCoderEncContext *ctx = opaque;
+    ni_packet_t xpkt = { 0 };
+    AVBufferRef *buf;
+
+    // the pool only grows while packets hold its buffers
+    if (ctx->pkt_pool_nb >= NI_ENC_PKT_POOL_MAX) {
+        return NULL;
+    }
+    if (ni_packet_buffer_alloc(&xpkt, NI_MAX_TX_SZ) != NI_RETCODE_SUCCESS) {
+        return NULL;
+    }
+    buf = av_buffer_create(xpkt.p_buffer, xpkt.buffer_size,
+                           xcoder_packet_buffer_free, NULL, 0);
+    if (!buf) {
+        ni_packet_buffer_free(&xpkt);
+        return NULL;
+    }
+    ctx->pkt_pool_nb++;
+    return buf;
+}
+
+// Give the pool buffer installed in api_pkt back without libxcoder freeing it.
+static void xcoder_packet_buffer_release(XCoderEncContext *ctx)
+{
+    ni_packet_t *xpkt = &ctx->api_pkt.data.packet;
+
+    if (!ctx->pkt_buf) {
+        return;
+    }
+    if (xpkt->p_buffer == ctx->pkt_buf->data) {
+        xpkt->p_buffer    = NULL;
+        xpkt->p_data      = NULL;
+        xpkt->buffer_size = 0;
+    }
+    av_buffer_unref(&ctx->pkt_buf);
+}
+
+// Read packets into pooled buffers so that their payload can be handed out
+// without a copy. AV1 merges several reads into one packet and keeps using
+// buffers from libxcoder.
+static int xcoder_packet_buffer_get(AVCodecContext *avctx)
+{
+    XCoderEncContext *ctx = avctx->priv_data;
+    ni_packet_t *xpkt = &ctx->api_pkt.data.packet;
+
+    if (avctx->codec_id == AV_CODEC_ID_AV1) {
+        return ni_packet_buffer_alloc(xpkt, NI_MAX_TX_SZ) ? AVERROR(ENOMEM) : 0;
+    }
+
+    if (!ctx->pkt_buf) {
+        if (!ctx->pkt_pool) {
+            ctx->pkt_pool = av_buffer_pool_init2(NI_MAX_TX_SZ, ctx,
+                                                 xcoder_packet_buffer_alloc, NULL);
+            if (!ctx->pkt_pool) {
+                return AVERROR(ENOMEM);
+            }
+        }
+        ctx->pkt_buf = av_buffer_pool_get(ctx->pkt_pool);
+        if (!ctx->pkt_buf) {
+            // all pool buffers are held by packets, read into a libxcoder
+            // buffer and copy
+            return ni_packet_buffer_alloc(xpkt, NI_MAX_TX_SZ) ? AVERROR(ENOMEM) : 0;
+        }
+        ni_packet_buffer_free(xpkt);
+        xpkt->p_buffer    = ctx->pkt_buf->data;
+        xpkt->buffer_size = ctx->pkt_buf->size;
+    }
+    xpkt->p_data   = xpkt->p_buffer;
+    xpkt->data_len = NI_MAX_TX_SZ;
+    return 0;
+}
+
+// Hand the payload of a packet read into a pool buffer over to the AVPacket,
+// the buffer returns to the pool when the packet is unreferenced.
+static int xcoder_packet_wrap(AVCodecContext *avctx, AVPacket *pkt, int meta_size)
+{
+    XCoderEncContext *ctx = avctx->priv_data;
+    ni_packet_t *xpkt = &ctx->api_pkt.data.packet;
+    uint8_t *data;
+    int size = xpkt->data_len - meta_size;
+
+    if (!ctx->pkt_buf || xpkt->p_buffer != ctx->pkt_buf->data ||
+        size < NI_ENC_ZEROCOPY_MIN_SIZE ||
+        (uint8_t *)xpkt->p_data + xpkt->data_len + AV_INPUT_BUFFER_PADDING_SIZE >
+        ctx->pkt_buf->data + ctx->pkt_buf->size) {
+        return 0;
+    }
+
+    data = (uint8_t *)xpkt->p_data + meta_size;
+    memset(data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    pkt->buf  = ctx->pkt_buf;
+    pkt->data = data;
+    pkt->size = size;
+
+    // the next read gets a fresh buffer from the pool
+    ctx->pkt_buf      = NULL;
+    xpkt->p_buffer    = NULL;
+    xpkt->p_data      = NULL;
+    xpkt->buffer_size = 0;
+    return 1;
+}
+
 int ff_xcoder_encode_close(AVCodecContext *avctx)
 {
     XCoderEncContext *ctx = avctx->priv_data;
@@ -885,25 +1090,21 @@ int ff_xcoder_encode_close(AVCodecContext *avctx)
         || ctx->api_fme.data.frame.start_buffer_size) {
         ni_frame_buffer_free(&(ctx->api_fme.data.frame));
     }
+    xcoder_packet_buffer_release(ctx);
+    av_buffer_pool_uninit(&ctx->pkt_pool);
     ni_packet_buffer_free(&(ctx->api_pkt.data.packet));
     if (AV_CODEC_ID_AV1 == avctx->codec_id &&
         ctx->api_pkt.data.packet.av1_buffer_index)
         ni_packet_buffer_free_av1(&(ctx->api_pkt.data.packet));
 
-    av_log(avctx, AV_LOG_DEBUG, "fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-           av_fifo_can_read(ctx->fme_fifo));
-#else
-           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+    av_log(avctx, AV_LOG_DEBUG, "ring num frames: %d\n", ctx->fme_ring.count);
     if (ctx->api_ctx.session_run_state != SESSION_RUN_STATE_SEQ_CHANGE_DRAINING) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_freep2(&ctx->fme_fifo);
-#else
-        if (ctx->fme_fifo)
-            av_fifo_free(ctx->fme_fifo);
-        ctx->fme_fifo = NULL;
-#endif
+        if (ctx->fme_ring.frames) {
+            av_log(avctx, AV_LOG_VERBOSE, "Encoder input ring: capacity %d, "
+                   "peak fill %d, full %"PRIu64" times\n", ctx->fme_ring.capacity,
+                   ctx->fme_ring.peak, ctx->fme_ring.nb_full);
+        }
+        input_ring_free(&ctx->fme_ring);
         av_log(avctx, AV_LOG_DEBUG, " , freed.\n");
     } else {
         av_log(avctx, AV_LOG_DEBUG, " , kept.\n");
@@ -1014,96 +1215,66 @@ static int xcoder_encode_reset(AVCodecContext *avctx)
     return ff_xcoder_encode_init(avctx);
 }
 
-// frame fifo operations
+// frame ring operations
 static int is_input_fifo_empty(XCoderEncContext *s)
 {
-    if (!s->fme_fifo) {
-        return 1;
-    }
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    return av_fifo_can_read(s->fme_fifo) ? 0 : 1;
-#else
-    return av_fifo_size(s->fme_fifo) < sizeof(AVFrame);
-#endif
+    return !s->fme_ring.count;
 }
 
-static int enqueue_frame(AVCodecContext *avctx, const AVFrame *inframe)
+static int is_input_fifo_full(XCoderEncContext *s)
 {
-    XCoderEncContext *ctx = avctx->priv_data;
-    size_t nb_elems;
-    int ret = 0;
+    return s->fme_ring.frames && s->fme_ring.count >= s->fme_ring.capacity;
+}
 
-    // expand frame buffer fifo if not enough space
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    if (!av_fifo_can_write(ctx->fme_fifo)) {
-#else
-    if (av_fifo_space(ctx->fme_fifo) < sizeof(AVFrame)) {
-#endif
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        if (av_fifo_can_read(ctx->fme_fifo) >= NI_MAX_FIFO_CAPACITY) {
-            av_log(avctx, AV_LOG_ERROR, "Encoder frame buffer fifo capacity (%lu) reached maximum (%d)\n",
-                   av_fifo_can_read(ctx->fme_fifo), NI_MAX_FIFO_CAPACITY);
-            return AVERROR_EXTERNAL;
-#else
-        if (av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame) >= NI_MAX_FIFO_CAPACITY) {
-            av_log(avctx, AV_LOG_ERROR, "Encoder frame buffer fifo capacity (%lu) reached maximum (%d)\n",
-                   av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame), NI_MAX_FIFO_CAPACITY);
-            return AVERROR_EXTERNAL;
-#endif
-        }
+static void input_ring_peek(XCoderEncContext *s, AVFrame *frame)
+{
+    *frame = s->fme_ring.frames[s->fme_ring.head];
+}
 
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        ret = av_fifo_grow2(ctx->fme_fifo, (size_t) 1);
-#else
-        ret = av_fifo_grow(ctx->fme_fifo, sizeof(AVFrame));
-#endif
-        if (ret < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Cannot grow FIFO: out of memory\n");
-            return ret;
-        }
+static void input_ring_drain(XCoderEncContext *s)
+{
+    NIEncFrameRing *r = &s->fme_ring;
 
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        nb_elems = av_fifo_can_read(ctx->fme_fifo) + av_fifo_can_write(ctx->fme_fifo);
-#else
-        nb_elems = (av_fifo_size(ctx->fme_fifo) + av_fifo_space(ctx->fme_fifo)) / sizeof(AVFrame);
-#endif
-        if ((nb_elems % 100) == 0) {
-            av_log(avctx, AV_LOG_INFO, "Enc fifo being extended to: %lu\n", nb_elems);
-        }
-#if (LIBAVUTIL_VERSION_MAJOR < 59)
-        av_assert0(0 == (av_fifo_size(ctx->fme_fifo) + av_fifo_space(ctx->fme_fifo)) % sizeof(AVFrame));
-#endif
+    memset(&r->frames[r->head], 0, sizeof(*r->frames));
+    r->head = (r->head + 1) % r->capacity;
+    r->count--;
+}
+
+static int enqueue_frame(AVCodecContext *avctx, const AVFrame *inframe)
+{
+    XCoderEncContext *ctx = avctx->priv_data;
+    NIEncFrameRing *r = &ctx->fme_ring;
+    AVFrame *slot;
+    int ret;
+
+    if (is_input_fifo_full(ctx)) {
+        r->nb_full++;
+        av_log(avctx, AV_LOG_DEBUG, "Encoder frame ring full (%d), back-pressure\n",
+               r->capacity);
+        return AVERROR(EAGAIN);
     }
 
+    slot = &r->frames[(r->head + r->count) % r->capacity];
     if (inframe == &ctx->buffered_fme) {
         // For FFmpeg-n4.4+ receive_packet interface the buffered_fme is fetched from
         // ff_alloc_get_frame rather than passed as function argument. So we need to
         // judge whether they are the same object. If they are the same NO need to do
         // any reference before queue operation.
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_write(ctx->fme_fifo, (void *)inframe, (size_t) 1);
-#else
-        av_fifo_generic_write(ctx->fme_fifo, (void *)inframe, sizeof(*inframe), NULL);
-#endif
+        *slot = *inframe;
     } else {
-        AVFrame temp_frame;
-        memset(&temp_frame, 0, sizeof(AVFrame));
         // In case double free for external input frame and our buffered frame.
-        av_frame_ref(&temp_frame, inframe);
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_write(ctx->fme_fifo, &temp_frame, 1);
-#else
-        av_fifo_generic_write(ctx->fme_fifo, &temp_frame, sizeof(*inframe), NULL);
-#endif
+        ret = av_frame_ref(slot, inframe);
+        if (ret < 0) {
+            return ret;
+        }
     }
+    r->count++;
+    r->peak = FFMAX(r->peak, r->count);
+    r->report_peak = FFMAX(r->report_peak, r->count);
 
-    av_log(avctx, AV_LOG_DEBUG, "fme queued, fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-           av_fifo_can_read(ctx->fme_fifo));
-#else
-           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
-    return ret;
+    av_log(avctx, AV_LOG_DEBUG, "fme queued, ring num frames: %d/%d\n",
+           r->count, r->capacity);
+    return 0;
 }
 
 int ff_xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
@@ -1142,6 +1313,8 @@ int ff_xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
 
     av_log(avctx, AV_LOG_VERBOSE, "XCoder send frame\n");
 
+    input_ring_report(avctx, &ctx->fme_ring);
+
     p_param = (ni_xcoder_params_t *) ctx->api_ctx.p_session_config;
     alignment_2pass_wa = ((p_param->cfg_enc_params.lookAheadDepth ||
                            p_param->cfg_enc_params.crf >= 0 ||
@@ -1154,12 +1327,7 @@ int ff_xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
     if (ctx->started == 0) {
         if (!is_input_fifo_empty(ctx)) {
             av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from fifo peek\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-            av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-            av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                               NULL);
-#endif
+            input_ring_peek(ctx, &ctx->buffered_fme);
             ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
             first_frame = &ctx->buffered_fme;
 
@@ -1172,12 +1340,7 @@ int ff_xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
     } else if (ctx->api_ctx.session_run_state == SESSION_RUN_STATE_SEQ_CHANGE_OPENING) {
         if (!is_input_fifo_empty(ctx)) {
             av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from fifo peek\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-            av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-            av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                               NULL);
-#endif
+            input_ring_peek(ctx, &ctx->buffered_fme);
             ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
             first_frame = &ctx->buffered_fme;
         } else {
@@ -1348,15 +1511,9 @@ int ff_xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
             if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING !=
                 ctx->api_ctx.session_run_state) {
                 if (! is_input_fifo_empty(ctx)) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-                    av_fifo_drain2(ctx->fme_fifo, (size_t) 1);
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_can_read(ctx->fme_fifo));
-#else
-                    av_fifo_drain(ctx->fme_fifo, sizeof(AVFrame));
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+                    input_ring_drain(ctx);
+                    av_log(avctx, AV_LOG_DEBUG, "fme popped, ring num frames: %d\n",
+                           ctx->fme_ring.count);
                 }
             }
             ret = AVERROR_EXTERNAL;
@@ -1438,12 +1595,7 @@ resend:
         }
     } else {
         av_log(avctx, AV_LOG_DEBUG, "fifo peek fme\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-        av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                             NULL);
-#endif
+        input_ring_peek(ctx, &ctx->buffered_fme);
         ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
     }
 
@@ -2425,15 +2577,9 @@ resend:
             if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING !=
                 ctx->api_ctx.session_run_state) {
                 if (!is_input_fifo_empty(ctx)) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-                    av_fifo_drain2(ctx->fme_fifo, (size_t) 1);
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_can_read(ctx->fme_fifo));
-#else
-                    av_fifo_drain(ctx->fme_fifo, sizeof(AVFrame));
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+                    input_ring_drain(ctx);
+                    av_log(avctx, AV_LOG_DEBUG, "fme popped, ring num frames: %d\n",
+                           ctx->fme_ring.count);
                 }
                 av_frame_unref(&ctx->buffered_fme);
                 ishwframe = (ctx->buffered_fme.format == AV_PIX_FMT_NI_QUAD) &&
@@ -2468,15 +2614,12 @@ resend:
     // try to flush encoder input fifo if it's not in seqchange draining state.
     // Sending a frame before seqchange done may lead to stuck because the new frame's
     // resolution could be different from that of the last sequence. Need to flush the
-    // fifo because its size increases with seqchange.
-    if (ret == 0 && frame && !is_input_fifo_empty(ctx) &&
+    // fifo because its size increases with seqchange. Stop once the device
+    // refuses input: the frames stay in the ring until it has room again.
+    if (ret == 0 && sent > 0 && frame && !is_input_fifo_empty(ctx) &&
         SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != ctx->api_ctx.session_run_state) {
-        av_log(avctx, AV_LOG_DEBUG, "try to flush encoder input fifo. Fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-               av_fifo_can_read(ctx->fme_fifo));
-#else
-               av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+        av_log(avctx, AV_LOG_DEBUG, "try to flush encoder input fifo. Ring num frames: %d\n",
+               ctx->fme_ring.count);
         goto resend;
     }
 
@@ -2523,11 +2666,7 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
 
     // re-init avctx's resolution to the changed one that is
     // stored in the first frame of the fifo
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    av_fifo_peek(ctx->fme_fifo, &temp_frame, (size_t) 1, NULL);
-#else
-    av_fifo_generic_peek(ctx->fme_fifo, &temp_frame, sizeof(AVFrame), NULL);
-#endif
+    input_ring_peek(ctx, &temp_frame);
     temp_frame.extended_data = temp_frame.data;
 
     ishwframe = temp_frame.format == AV_PIX_FMT_NI_QUAD;
@@ -2783,7 +2922,7 @@ int ff_xcoder_receive_packet2(AVCodecContext *avctx, AVPacket *pkt)
         return AVERROR_EOF;
     }
 
-    if (ni_packet_buffer_alloc(xpkt, NI_MAX_TX_SZ)) {
+    if (xcoder_packet_buffer_get(avctx) < 0) {
         av_log(avctx, AV_LOG_ERROR,
                "ff_xcoder_receive_packet2: packet buffer size %d allocation failed\n",
                NI_MAX_TX_SZ);
@@ -3145,17 +3284,25 @@ int ff_xcoder_receive_packet2(AVCodecContext *avctx, AVPacket *pkt)
                     }
                 }
             } else {
+                int zerocopy = 0;
+
                 data_len += xpkt->data_len - meta_size + total_custom_sei_size;
                 if (avctx->codec_id == AV_CODEC_ID_AV1)
                     av_log(avctx, AV_LOG_TRACE, "ff_xcoder_receive_packet2: AV1 output pkt size %d\n", data_len);
 
+                // custom SEIs are spliced into the bitstream, which needs a copy
+                if (!custom_sei_count) {
+                    zerocopy = xcoder_packet_wrap(avctx, pkt, meta_size);
+                }
+                if (!zerocopy) {
 #if (LIBAVCODEC_VERSION_MAJOR >= 59)
-                ret = ff_get_encode_buffer(avctx, pkt, data_len, 0);
+                    ret = ff_get_encode_buffer(avctx, pkt, data_len, 0);
 #else
-                ret = ff_alloc_packet2(avctx, pkt, data_len, data_len);
+                    ret = ff_alloc_packet2(avctx, pkt, data_len, data_len);
 #endif
+                }
 
-                if (!ret) {
+                if (!ret && !zerocopy) {
                     uint8_t *p_dst = pkt->data;
 
                     if (custom_sei_count && avctx->codec_id != AV_CODEC_ID_AV1) {
@@ -3381,6 +3528,40 @@ int ff_xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
     AVFrame *frame = &ctx->buffered_fme;
     int ret;
 
+    // back-pressure: while the input ring is full, or holds frames that must
+    // go out before EOS, leave the next frame or EOF with the caller and move
+    // the queued frames to the device. Packets may be returned meanwhile but
+    // EAGAIN only once the ring can take more input.
+    if (is_input_fifo_full(ctx)) {
+        ctx->fme_ring.nb_full++;
+    }
+    while (!is_input_fifo_empty(ctx) && !ctx->encoder_flushing &&
+           (is_input_fifo_full(ctx) || avctx->internal->draining)) {
+        int count = ctx->fme_ring.count;
+
+        if (SESSION_RUN_STATE_NORMAL == ctx->api_ctx.session_run_state) {
+            // a NULL frame sends the ring head; it also clears the draining
+            // flag the caller's EOF is still pending on
+            int draining = avctx->internal->draining;
+            ret = ff_xcoder_send_frame(avctx, NULL);
+            avctx->internal->draining = draining;
+            if (ret < 0) {
+                return ret;
+            }
+            if (ctx->fme_ring.count < count) {
+                continue;
+            }
+        }
+
+        ret = ff_xcoder_receive_packet2(avctx, pkt);
+        if (ret != AVERROR(EAGAIN)) {
+            return ret;
+        }
+        if (ctx->fme_ring.count == count) {
+            av_usleep(100);
+        }
+    }
+
     ret = ff_encode_get_frame(avctx, frame);
     if (!ctx->encoder_flushing && ret >= 0 || ret == AVERROR_EOF) {
         ret = ff_xcoder_send_frame(avctx, (ret == AVERROR_EOF ? NULL : frame));
@@ -35,7 +35,6 @@
 #include "internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/imgutils.h"
-#include "libavutil/fifo.h"
 
 // Needed for hwframe on FFmpeg-n4.3+
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 82)
@@ -49,6 +48,25 @@
 #define IS_FFMPEG_61_AND_ABOVE_FOR_LIBAVCODEC                                                \
     (LIBAVCODEC_VERSION_MAJOR  >= 60)
 
+/**
+ * Fixed-capacity ring of input frames waiting for the encoder, sized from the
+ * lookahead and GOP configuration. Frames are stored by value and ownership
+ * goes to whoever peeks the head, as with the AVFifo it replaces.
+ */
+typedef struct NIEncFrameRing {
+    AVFrame *frames;    /* capacity frames, allocated once per session */
+    int capacity;
+    int head;
+    int count;          /* current fill level */
+    int peak;           /* highest fill level reached */
+    uint64_t nb_full;   /* times input was refused because the ring was full */
+
+    /* periodic fill level report while encoding */
+    int64_t last_report;
+    int report_peak;    /* highest fill level since the last report */
+    uint64_t report_full;
+} NIEncFrameRing;
+
 typedef struct XCoderEncContext {
     AVClass *avclass;
 
@@ -63,16 +81,15 @@ typedef struct XCoderEncContext {
     ni_device_context_t *rsrc_ctx;  /* resource management context */
     uint64_t xcode_load_pixel; /* xcode load in pixels by this encode task */
 
-#if LIBAVUTIL_VERSION_MAJOR >= 59 //7.0
-    AVFifo *fme_fifo;
-#else
-    // frame fifo, to be used for sequence change frame buffering
-    AVFifoBuffer *fme_fifo;
-#endif
+    // frame ring, to be used for back-pressure and sequence change frame buffering
+    NIEncFrameRing fme_ring;
     int eos_fme_received;
     AVFrame buffered_fme; // buffered frame for sequence change handling
 
     ni_session_data_io_t  api_pkt; /* used for receiving bitstream from xcoder */
+    AVBufferPool *pkt_pool;         /* packet buffers handed out as AVPacket payload */
+    int pkt_pool_nb;                /* buffers allocated by pkt_pool */
+    AVBufferRef *pkt_buf;           /* pool buffer installed in api_pkt */
     ni_session_data_io_t   api_fme; /* used for sending YUV data to xcoder */
     ni_session_context_t api_ctx;
     ni_xcoder_params_t api_param;
@@ -0,0 +1,394 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Every tile of a 4096x2304 frame split in 2x1 to 8x8 uniformly spaced
+ * tiles is written with CBS as its own single tile AV1 stream: a key frame
+ * with a sequence header and 7 inter frames, the quantizer and the loop
+ * filter changing from frame to frame and the tile data random. Each tile
+ * stream goes through av1_rawtotile, synchronously and on a worker thread
+ * which must give the same packets, and the tiles of each frame are
+ * repacked by av1_tile_repack, in order or in reverse order. A line with
+ * the size and checksum of each repacked frame is printed.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "libavcodec/bsf.h"
+#include "libavcodec/cbs.h"
+#include "libavcodec/cbs_av1.h"
+
+#define WIDTH     4096
+#define HEIGHT    2304
+#define GOP       8
+#define MAX_TILES 64
+
+static const int8_t default_loop_filter_ref_deltas[AV1_TOTAL_REFS_PER_FRAME] =
+    { 1, 0, 0, 0, -1, 0, -1, -1 };
+
+static int ilog2(int target)
+{
+    int k;
+    for (k = 0; (1 << k) < target; k++);
+    return k;
+}
+
+static void fill_sequence_header(AV1RawSequenceHeader *seq, int width, int height)
+{
+    memset(seq, 0, sizeof(*seq));
+    seq->seq_level_idx[0]                = 12;
+    seq->frame_width_bits_minus_1        = ilog2(width) - 1;
+    seq->frame_height_bits_minus_1       = ilog2(height) - 1;
+    seq->max_frame_width_minus_1         = width - 1;
+    seq->max_frame_height_minus_1        = height - 1;
+    seq->enable_filter_intra             = 1;
+    seq->enable_intra_edge_filter        = 1;
+    seq->enable_order_hint               = 1;
+    seq->seq_choose_screen_content_tools = 1;
+    seq->seq_force_screen_content_tools  = AV1_SELECT_SCREEN_CONTENT_TOOLS;
+    seq->seq_choose_integer_mv           = 1;
+    seq->seq_force_integer_mv            = AV1_SELECT_INTEGER_MV;
+    seq->order_hint_bits_minus_1         = 6;
+    seq->enable_cdef                     = 1;
+    seq->color_config.color_primaries          = AVCOL_PRI_UNSPECIFIED;
+    seq->color_config.transfer_characteristics = AVCOL_TRC_UNSPECIFIED;
+    seq->color_config.matrix_coefficients      = AVCOL_SPC_UNSPECIFIED;
+    seq->color_config.subsampling_x            = 1;
+    seq->color_config.subsampling_y            = 1;
+}
+
+static void fill_frame_header(AV1RawFrameHeader *fh, int width, int height, int n)
+{
+    int key = !n;
+
+    memset(fh, 0, sizeof(*fh));
+    fh->frame_type     = key ? AV1_FRAME_KEY : AV1_FRAME_INTER;
+    fh->show_frame     = 1;
+    fh->showable_frame = !key;
+    fh->order_hint     = n;
+    /* the writer checks the values it infers */
+    fh->frame_width_minus_1   = width - 1;
+    fh->frame_height_minus_1  = height - 1;
+    fh->render_width_minus_1  = width - 1;
+    fh->render_height_minus_1 = height - 1;
+    if (key) {
+        fh->error_resilient_mode = 1;
+        fh->primary_ref_frame    = AV1_PRIMARY_REF_NONE;
+        fh->refresh_frame_flags  = 0xff;
+    } else {
+        /* every inter frame refers to the key frame in slot 0 */
+        fh->refresh_frame_flags  = 1 << n;
+        for (int i = 1; i < n; i++)
+            fh->ref_order_hint[i] = i;
+        fh->allow_high_precision_mv = n & 1;
+    }
+
+    fh->uniform_tile_spacing_flag = 1;
+    fh->width_in_sbs_minus_1[0]   = (width + 63) / 64 - 1;
+    fh->height_in_sbs_minus_1[0]  = (height + 63) / 64 - 1;
+    fh->base_q_idx = 60 + 13 * n;
+
+    fh->loop_filter_level[0] = 10 + n;
+    fh->loop_filter_level[1] = 8 + n;
+    fh->loop_filter_level[2] = 4;
+    fh->loop_filter_level[3] = 4;
+    fh->loop_filter_sharpness = n % 3;
+    fh->loop_filter_delta_enabled = 1;
+    memcpy(fh->loop_filter_ref_deltas, default_loop_filter_ref_deltas,
+           sizeof(default_loop_filter_ref_deltas));
+
+    fh->cdef_damping_minus_3   = 2;
+    fh->cdef_y_pri_strength[0] = n % 16;
+    fh->cdef_y_sec_strength[0] = 1;
+    fh->tx_mode = AV1_TX_MODE_SELECT;
+}
+
+static int synth_tile(AVPacket **pkts, int width, int height, int idx,
+                      int key_size, int inter_size, AVLFG *lfg)
+{
+    CodedBitstreamContext *cbc = NULL;
+    CodedBitstreamFragment frag = { 0 };
+    AV1RawOBU *obus;
+    int ret;
+
+    obus = av_calloc(4, sizeof(*obus));
+    if (!obus)
+        return AVERROR(ENOMEM);
+
+    ret = ff_cbs_init(&cbc, AV_CODEC_ID_AV1, NULL);
+    if (ret < 0)
+        goto fail;
+
+    for (int n = 0; n < GOP; n++) {
+        AV1RawOBU *td = &obus[0], *seq = &obus[1], *fh = &obus[2], *tg = &obus[3];
+        int size = n ? inter_size : key_size;
+        uint8_t *data;
+        int *addr;
+
+        memset(obus, 0, 4 * sizeof(*obus));
+        td->header.obu_type  = AV1_OBU_TEMPORAL_DELIMITER;
+        seq->header.obu_type = AV1_OBU_SEQUENCE_HEADER;
+        fh->header.obu_type  = AV1_OBU_FRAME_HEADER;
+        tg->header.obu_type  = AV1_OBU_TILE_GROUP;
+        fill_sequence_header(&seq->obu.sequence_header, width, height);
+        fill_frame_header(&fh->obu.frame_header, width, height, n);
+
+        data = av_malloc(size);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (int i = 0; i < size; i++)
+            data[i] = av_lfg_get(lfg);
+        tg->obu.tile_group.tile_data.data      = data;
+        tg->obu.tile_group.tile_data.data_size = size;
+
+        if ((ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_TEMPORAL_DELIMITER, td, NULL)) < 0 ||
+            (!n && (ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_SEQUENCE_HEADER, seq, NULL)) < 0) ||
+            (ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_FRAME_HEADER, fh, NULL)) < 0 ||
+            (ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_TILE_GROUP, tg, NULL)) < 0) {
+            av_free(data);
+            goto fail;
+        }
+
+        pkts[n] = av_packet_alloc();
+        ret = pkts[n] ? ff_cbs_write_packet(cbc, pkts[n], &frag) : AVERROR(ENOMEM);
+        ff_cbs_fragment_reset(&frag);
+        av_free(data);
+        if (ret < 0)
+            goto fail;
+
+        addr = (int *)av_packet_new_side_data(pkts[n], AV_PKT_DATA_SLICE_ADDR,
+                                              sizeof(*addr));
+        if (!addr) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        *addr = idx;
+        pkts[n]->pts = pkts[n]->dts = n;
+        if (!n)
+            pkts[n]->flags |= AV_PKT_FLAG_KEY;
+    }
+
+fail:
+    ff_cbs_fragment_free(&frag);
+    ff_cbs_close(&cbc);
+    av_free(obus);
+    return ret;
+}
+
+/* Run a tile stream through av1_rawtotile */
+static int rawtotile(AVPacket **in, AVPacket **out, int cols, int rows,
+                     int idx, int async_depth)
+{
+    const AVBitStreamFilter *filter = av_bsf_get_by_name("av1_rawtotile");
+    int tile_w = WIDTH / cols, tile_h = HEIGHT / rows;
+    AVBSFContext *bsf = NULL;
+    AVPacket *pkt = NULL;
+    int n = 0;
+    int ret;
+
+    if (!filter)
+        return AVERROR_BSF_NOT_FOUND;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    ret = av_bsf_alloc(filter, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_AV1;
+    av_opt_set_int(bsf->priv_data, "width",  WIDTH,  0);
+    av_opt_set_int(bsf->priv_data, "height", HEIGHT, 0);
+    av_opt_set_int(bsf->priv_data, "column", cols,   0);
+    av_opt_set_int(bsf->priv_data, "row",    rows,   0);
+    av_opt_set_int(bsf->priv_data, "x",      idx % cols * tile_w, 0);
+    av_opt_set_int(bsf->priv_data, "y",      idx / cols * tile_h, 0);
+    av_opt_set_int(bsf->priv_data, "x_w",    tile_w, 0);
+    av_opt_set_int(bsf->priv_data, "y_h",    tile_h, 0);
+    av_opt_set_int(bsf->priv_data, "async_depth", async_depth, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    /* a worker may hold packets back until the end of the stream */
+    for (int i = 0; i <= GOP; i++) {
+        if (i < GOP) {
+            ret = av_packet_ref(pkt, in[i]);
+            if (ret >= 0)
+                ret = av_bsf_send_packet(bsf, pkt);
+        } else {
+            ret = av_bsf_send_packet(bsf, NULL);
+        }
+        while (ret >= 0) {
+            ret = av_bsf_receive_packet(bsf, pkt);
+            if (ret < 0)
+                break;
+            if (n == GOP) {
+                ret = AVERROR_BUG;
+                goto finish;
+            }
+            av_packet_move_ref(out[n++], pkt);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto finish;
+    }
+    ret = n == GOP ? 0 : AVERROR_BUG;
+
+finish:
+    av_bsf_free(&bsf);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int run(int cols, int rows, int key_size, int inter_size)
+{
+    const AVBitStreamFilter *repack = av_bsf_get_by_name("av1_tile_repack");
+    int nb_tiles = cols * rows;
+    AVPacket *streams[MAX_TILES][GOP] = { { NULL } };
+    AVPacket *tiles[MAX_TILES][GOP]   = { { NULL } };
+    AVPacket *tiles_async[GOP]        = { NULL };
+    AVBSFContext *bsf = NULL;
+    AVPacket *tmp = NULL, *out = NULL;
+    AVLFG lfg;
+    int ret = 0;
+
+    if (!repack)
+        return AVERROR_BSF_NOT_FOUND;
+
+    av_lfg_init(&lfg, 0x4e49 + nb_tiles);
+    tmp = av_packet_alloc();
+    out = av_packet_alloc();
+    if (!tmp || !out) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+    for (int n = 0; n < GOP; n++) {
+        tiles_async[n] = av_packet_alloc();
+        if (!tiles_async[n]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+    }
+
+    for (int i = 0; i < nb_tiles; i++) {
+        ret = synth_tile(streams[i], WIDTH / cols, HEIGHT / rows, i,
+                         key_size / nb_tiles, inter_size / nb_tiles, &lfg);
+        if (ret < 0)
+            goto finish;
+
+        for (int n = 0; n < GOP; n++) {
+            tiles[i][n] = av_packet_alloc();
+            if (!tiles[i][n]) {
+                ret = AVERROR(ENOMEM);
+                goto finish;
+            }
+        }
+        ret = rawtotile(streams[i], tiles[i], cols, rows, i, 1);
+        if (ret >= 0)
+            ret = rawtotile(streams[i], tiles_async, cols, rows, i, 3);
+        if (ret < 0)
+            goto finish;
+        for (int n = 0; n < GOP; n++) {
+            if (tiles_async[n]->size != tiles[i][n]->size ||
+                memcmp(tiles_async[n]->data, tiles[i][n]->data,
+                       tiles[i][n]->size)) {
+                fprintf(stderr, "%dx%d tiles: tile %d of frame %d differs on "
+                        "the worker\n", cols, rows, i, n);
+                ret = AVERROR_BUG;
+                goto finish;
+            }
+            av_packet_unref(tiles_async[n]);
+        }
+    }
+
+    ret = av_bsf_alloc(repack, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_AV1;
+    av_opt_set_int(bsf->priv_data, "tile_num", nb_tiles, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    for (int n = 0; n < GOP; n++) {
+        for (int i = 0; i < nb_tiles; i++) {
+            /* the tiles of odd frames come in reverse order */
+            ret = av_packet_ref(tmp, tiles[n & 1 ? nb_tiles - 1 - i : i][n]);
+            if (ret < 0)
+                goto finish;
+            ret = av_bsf_send_packet(bsf, tmp);
+            if (ret < 0)
+                goto finish;
+            ret = av_bsf_receive_packet(bsf, out);
+            if (i < nb_tiles - 1 ? ret != AVERROR(EAGAIN) : ret < 0) {
+                ret = ret < 0 ? ret : AVERROR_BUG;
+                goto finish;
+            }
+        }
+
+        printf("%dx%d, %d, %"PRId64", %d, %7d, 0x%08"PRIx32"\n", cols, rows, n,
+               out->pts, out->flags, out->size,
+               av_adler32_update(0, out->data, out->size));
+        av_packet_unref(out);
+    }
+
+finish:
+    for (int i = 0; i < nb_tiles; i++) {
+        for (int n = 0; n < GOP; n++) {
+            av_packet_free(&streams[i][n]);
+            av_packet_free(&tiles[i][n]);
+        }
+    }
+    for (int n = 0; n < GOP; n++)
+        av_packet_free(&tiles_async[n]);
+    av_bsf_free(&bsf);
+    av_packet_free(&tmp);
+    av_packet_free(&out);
+    return ret;
+}
+
+int main(void)
+{
+    static const int layouts[][2] = {
+        { 2, 1 }, { 2, 2 }, { 4, 2 }, { 4, 4 }, { 8, 4 }, { 8, 8 },
+    };
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(layouts); i++)
+        ret = run(layouts[i][0], layouts[i][1], 64 << 10, 8 << 10);
+
+    if (ret < 0) {
+        fprintf(stderr, "av1_tile_repack failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
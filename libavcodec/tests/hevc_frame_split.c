@@ -0,0 +1,343 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Split 1080p HEVC streams of 2x1 to 8x4 uniformly spaced tiles, one slice
+ * per tile, written with CBS. The slice payloads are random with enough
+ * zero bytes to need emulation prevention. The parameter sets come with
+ * the first frames, are missing from one frame and change from the next
+ * one on, so that the parameter set re-encoding is both reused and
+ * redone. A line with the size and checksum of each tile packet is
+ * printed, and the split with slice threads must give the same packets.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "libavcodec/bsf.h"
+#include "libavcodec/cbs.h"
+#include "libavcodec/cbs_h265.h"
+#include "libavcodec/hevc/hevc.h"
+
+#define WIDTH     1920
+#define HEIGHT    1080
+#define LOG2_CTB  6
+#define CTB_W     ((WIDTH  + (1 << LOG2_CTB) - 1) >> LOG2_CTB)
+#define CTB_H     ((HEIGHT + (1 << LOG2_CTB) - 1) >> LOG2_CTB)
+#define NB_FRAMES 6
+/* the parameter sets are left out of this frame, and change after it */
+#define PS_GAP    3
+
+typedef struct Layout {
+    int cols, rows;
+    int col_ctb[9];
+    int row_ctb[9];
+} Layout;
+
+static void fill_ps(H265RawVPS *vps, H265RawSPS *sps, H265RawPPS *pps,
+                    const Layout *l, int qp)
+{
+    H265RawProfileTierLevel ptl = { 0 };
+
+    ptl.general_profile_idc                   = 1;
+    ptl.general_profile_compatibility_flag[1] = 1;
+    ptl.general_profile_compatibility_flag[2] = 1;
+    ptl.general_progressive_source_flag       = 1;
+    ptl.general_frame_only_constraint_flag    = 1;
+    ptl.general_level_idc                     = 123;
+
+    memset(vps, 0, sizeof(*vps));
+    vps->nal_unit_header.nal_unit_type         = HEVC_NAL_VPS;
+    vps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    vps->vps_base_layer_internal_flag          = 1;
+    vps->vps_base_layer_available_flag         = 1;
+    vps->vps_temporal_id_nesting_flag          = 1;
+    vps->profile_tier_level                    = ptl;
+    vps->vps_sub_layer_ordering_info_present_flag = 1;
+    vps->vps_max_dec_pic_buffering_minus1[0]   = 4;
+    vps->layer_id_included_flag[0][0]          = 1;
+
+    memset(sps, 0, sizeof(*sps));
+    sps->nal_unit_header.nal_unit_type         = HEVC_NAL_SPS;
+    sps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    sps->sps_temporal_id_nesting_flag          = 1;
+    sps->profile_tier_level                    = ptl;
+    sps->chroma_format_idc                     = 1;
+    sps->pic_width_in_luma_samples             = WIDTH;
+    sps->pic_height_in_luma_samples            = HEIGHT;
+    sps->log2_max_pic_order_cnt_lsb_minus4     = 4;
+    sps->sps_sub_layer_ordering_info_present_flag = 1;
+    sps->sps_max_dec_pic_buffering_minus1[0]   = 4;
+    sps->log2_diff_max_min_luma_coding_block_size    = LOG2_CTB - 3;
+    sps->log2_diff_max_min_luma_transform_block_size = 3;
+    sps->max_transform_hierarchy_depth_inter   = 1;
+    sps->max_transform_hierarchy_depth_intra   = 1;
+    sps->sample_adaptive_offset_enabled_flag   = 1;
+    sps->sps_temporal_mvp_enabled_flag         = 1;
+    sps->strong_intra_smoothing_enabled_flag   = 1;
+    /* the values inferred without VUI */
+    sps->vui.video_format                      = 5;
+    sps->vui.colour_primaries                  = 2;
+    sps->vui.transfer_characteristics          = 2;
+    sps->vui.matrix_coefficients               = 2;
+    sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
+    sps->vui.max_bytes_per_pic_denom           = 2;
+    sps->vui.max_bits_per_min_cu_denom         = 1;
+    sps->vui.log2_max_mv_length_horizontal     = 15;
+    sps->vui.log2_max_mv_length_vertical       = 15;
+
+    memset(pps, 0, sizeof(*pps));
+    pps->nal_unit_header.nal_unit_type         = HEVC_NAL_PPS;
+    pps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    pps->init_qp_minus26                       = qp - 26;
+    pps->cu_qp_delta_enabled_flag              = 1;
+    pps->tiles_enabled_flag                    = 1;
+    pps->num_tile_columns_minus1               = l->cols - 1;
+    pps->num_tile_rows_minus1                  = l->rows - 1;
+    pps->uniform_spacing_flag                  = 1;
+}
+
+static void fill_data(uint8_t *data, int size, AVLFG *lfg)
+{
+    for (int i = 0; i < size; i++) {
+        unsigned r = av_lfg_get(lfg);
+        /* one byte in eight is zero so that escapes are common */
+        data[i] = r & 7 ? r >> 8 : 0;
+    }
+    data[size - 1] = 0x80;
+}
+
+static int synth_frame(CodedBitstreamContext *cbc, CodedBitstreamFragment *frag,
+                       const Layout *l, int poc, int idr, int slice_size,
+                       uint8_t *data, AVLFG *lfg, AVPacket *pkt)
+{
+    int nb_tiles = l->cols * l->rows;
+    H265RawSlice *slices;
+    H265RawVPS vps;
+    H265RawSPS sps;
+    H265RawPPS pps;
+    int ret = 0;
+
+    slices = av_calloc(nb_tiles, sizeof(*slices));
+    if (!slices)
+        return AVERROR(ENOMEM);
+
+    if (poc != PS_GAP) {
+        fill_ps(&vps, &sps, &pps, l, poc < PS_GAP ? 26 : 30);
+        ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_VPS, &vps, NULL);
+        if (ret >= 0)
+            ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_SPS, &sps, NULL);
+        if (ret >= 0)
+            ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_PPS, &pps, NULL);
+    }
+
+    for (int t = 0; ret >= 0 && t < nb_tiles; t++) {
+        H265RawSlice *slice     = &slices[t];
+        H265RawSliceHeader *sh  = &slice->header;
+        int col = t % l->cols, row = t / l->cols;
+        /* tiles of a frame differ in size as they do in real streams */
+        int size = slice_size / 2 + av_lfg_get(lfg) % slice_size;
+
+        sh->nal_unit_header.nal_unit_type = idr ? HEVC_NAL_IDR_W_RADL :
+                                                  HEVC_NAL_TRAIL_R;
+        sh->nal_unit_header.nuh_temporal_id_plus1 = 1;
+        sh->slice_segment_address = l->row_ctb[row] * CTB_W + l->col_ctb[col];
+        sh->first_slice_segment_in_pic_flag = !sh->slice_segment_address;
+        sh->slice_type             = HEVC_SLICE_I;
+        sh->slice_pic_order_cnt_lsb = poc & 0xff;
+        sh->slice_sao_luma_flag    = 1;
+        sh->slice_sao_chroma_flag  = 1;
+        sh->slice_qp_delta         = t % 5 - 2;
+
+        fill_data(data, size, lfg);
+        slice->data      = data;
+        slice->data_size = size;
+        data += size;
+
+        ret = ff_cbs_insert_unit_content(frag, -1, sh->nal_unit_header.nal_unit_type,
+                                         slice, NULL);
+    }
+
+    if (ret >= 0)
+        ret = ff_cbs_write_packet(cbc, pkt, frag);
+    ff_cbs_fragment_reset(frag);
+    av_free(slices);
+    return ret;
+}
+
+static int split(AVPacket **frames, int threads, uint32_t *sums, int nb_sums,
+                 const char *name, const Layout *l)
+{
+    const AVBitStreamFilter *filter = av_bsf_get_by_name("hevc_frame_split");
+    AVBSFContext *bsf = NULL;
+    AVPacket *pkt = NULL;
+    int n = 0;
+    int ret;
+
+    if (!filter)
+        return AVERROR_BSF_NOT_FOUND;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    ret = av_bsf_alloc(filter, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_HEVC;
+    /* the parameter sets of the first frame */
+    bsf->par_in->extradata = av_mallocz(frames[0]->size +
+                                        AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!bsf->par_in->extradata) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+    memcpy(bsf->par_in->extradata, frames[0]->data, frames[0]->size);
+    bsf->par_in->extradata_size = frames[0]->size;
+    av_opt_set_int(bsf->priv_data, "threads", threads, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    for (int i = 0; i < NB_FRAMES; i++) {
+        ret = av_packet_ref(pkt, frames[i]);
+        if (ret >= 0)
+            ret = av_bsf_send_packet(bsf, pkt);
+        while (ret >= 0) {
+            const int *tile;
+            uint32_t sum;
+
+            ret = av_bsf_receive_packet(bsf, pkt);
+            if (ret < 0)
+                break;
+            tile = (const int *)av_packet_get_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                                        NULL);
+            sum  = av_adler32_update(0, pkt->data, pkt->size);
+            if (!tile || n >= nb_sums) {
+                ret = AVERROR_BUG;
+                break;
+            }
+            if (threads == 1) {
+                printf("%s %dx%d, %d, %2d, %"PRId64", %6d, 0x%08"PRIx32"\n",
+                       name, l->cols, l->rows, i, *tile, pkt->pts, pkt->size,
+                       sum);
+                sums[n] = sum;
+            } else if (sums[n] != sum) {
+                fprintf(stderr, "%s %dx%d: frame %d tile %d differs with %d "
+                        "threads\n", name, l->cols, l->rows, i, *tile, threads);
+                ret = AVERROR_BUG;
+                break;
+            }
+            n++;
+            av_packet_unref(pkt);
+        }
+        if (ret != AVERROR(EAGAIN))
+            goto finish;
+    }
+    ret = n == nb_sums ? 0 : AVERROR_BUG;
+
+finish:
+    av_bsf_free(&bsf);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int run(const char *name, int cols, int rows, int intra, int frame_size)
+{
+    int nb_tiles = cols * rows;
+    CodedBitstreamContext *cbc = NULL;
+    CodedBitstreamFragment frag = { 0 };
+    AVPacket *frames[NB_FRAMES] = { NULL };
+    uint32_t *sums = NULL;
+    uint8_t *data = NULL;
+    Layout l;
+    AVLFG lfg;
+    int ret;
+
+    l.cols = cols;
+    l.rows = rows;
+    for (int i = 0; i <= cols; i++)
+        l.col_ctb[i] = i * CTB_W / cols;
+    for (int i = 0; i <= rows; i++)
+        l.row_ctb[i] = i * CTB_H / rows;
+    av_lfg_init(&lfg, 0x4e49 + nb_tiles);
+
+    data = av_malloc(frame_size * 2 + nb_tiles);
+    sums = av_calloc(NB_FRAMES * nb_tiles, sizeof(*sums));
+    if (!data || !sums) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    ret = ff_cbs_init(&cbc, AV_CODEC_ID_HEVC, NULL);
+    if (ret < 0)
+        goto finish;
+    for (int i = 0; i < NB_FRAMES; i++) {
+        frames[i] = av_packet_alloc();
+        if (!frames[i]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        ret = synth_frame(cbc, &frag, &l, i, intra, frame_size / nb_tiles,
+                          data, &lfg, frames[i]);
+        if (ret < 0)
+            goto finish;
+        frames[i]->pts = i;
+    }
+
+    ret = split(frames, 1, sums, NB_FRAMES * nb_tiles, name, &l);
+    if (ret >= 0)
+        ret = split(frames, 3, sums, NB_FRAMES * nb_tiles, name, &l);
+
+finish:
+    ff_cbs_fragment_free(&frag);
+    ff_cbs_close(&cbc);
+    for (int i = 0; i < NB_FRAMES; i++)
+        av_packet_free(&frames[i]);
+    av_free(sums);
+    av_free(data);
+    return ret;
+}
+
+int main(void)
+{
+    static const int layouts[][2] = { { 2, 1 }, { 2, 2 }, { 4, 2 }, { 4, 4 }, { 8, 4 } };
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(layouts); i++)
+        ret = run("intra", layouts[i][0], layouts[i][1], 1, 64 << 10);
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(layouts); i++)
+        ret = run("inter", layouts[i][0], layouts[i][1], 0, 8 << 10);
+
+    if (ret < 0) {
+        fprintf(stderr, "hevc_frame_split failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Repack frames of 2 to 64 tiles synthesized the way the tile encoders emit
+ * them: the first tile with its parameter sets, every other tile with
+ * parameter sets, SEI and one or two slices, some NAL units behind 4 byte
+ * start codes. The tiles of each frame are sent in order, in reverse order
+ * and shuffled, and a line with the size and checksum of each repacked
+ * frame is printed.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/opt.h"
+
+#include "libavcodec/bsf.h"
+#include "libavcodec/packet.h"
+#include "libavcodec/hevc/hevc.h"
+
+#define MAX_TILES 64
+
+static uint8_t *put_nal(uint8_t *p, AVLFG *lfg, int type, int size, int long_sc)
+{
+    if (long_sc)
+        *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 1;
+    *p++ = type << 1;
+    *p++ = 1;
+    /* random payload with zero runs, but no emulated start code and no
+     * trailing zero */
+    for (int i = 0; i < size; i++) {
+        unsigned v = av_lfg_get(lfg);
+
+        *p = v & 0x300 ? v : 0;
+        if ((!p[-1] && !p[-2] && *p <= 3) || (i == size - 1 && !*p))
+            *p = 3;
+        p++;
+    }
+    return p;
+}
+
+static int synth_tile(AVPacket *pkt, AVLFG *lfg, int idx, int slice_size,
+                      int intra)
+{
+    int slice_type = intra ? HEVC_NAL_IDR_W_RADL : HEVC_NAL_TRAIL_R;
+    int *addr;
+    uint8_t *p;
+    int ret;
+
+    ret = av_new_packet(pkt, 256 + slice_size + 7 * 7);
+    if (ret < 0)
+        return ret;
+
+    p = put_nal(pkt->data, lfg, HEVC_NAL_VPS, 20, 1);
+    p = put_nal(p, lfg, HEVC_NAL_SPS, 40, 0);
+    p = put_nal(p, lfg, HEVC_NAL_PPS, 10, 0);
+    if (idx) {
+        p = put_nal(p, lfg, HEVC_NAL_SEI_PREFIX, 24, 0);
+        if (idx % 3 == 1) {
+            p = put_nal(p, lfg, slice_type, slice_size / 2, 1);
+            p = put_nal(p, lfg, slice_type, slice_size - slice_size / 2, 0);
+        } else {
+            p = put_nal(p, lfg, slice_type, slice_size, idx & 1);
+        }
+        if (idx % 4 == 2)
+            p = put_nal(p, lfg, HEVC_NAL_SEI_SUFFIX, 16, 1);
+    } else {
+        p = put_nal(p, lfg, slice_type, slice_size, 0);
+    }
+    av_shrink_packet(pkt, p - pkt->data);
+
+    addr = (int *)av_packet_new_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                          sizeof(*addr));
+    if (!addr)
+        return AVERROR(ENOMEM);
+    *addr = idx;
+    if (intra)
+        pkt->flags |= AV_PKT_FLAG_KEY;
+    return 0;
+}
+
+static int repack(AVBSFContext *bsf, AVPacket **tiles, const int *order,
+                  int nb_tiles, int64_t pts, AVPacket *tmp, AVPacket *out)
+{
+    int ret;
+
+    for (int i = 0; i < nb_tiles; i++) {
+        ret = av_packet_ref(tmp, tiles[order[i]]);
+        if (ret < 0)
+            return ret;
+        tmp->pts = tmp->dts = pts;
+        ret = av_bsf_send_packet(bsf, tmp);
+        if (ret < 0)
+            return ret;
+        ret = av_bsf_receive_packet(bsf, out);
+        if (i < nb_tiles - 1 ? ret != AVERROR(EAGAIN) : ret < 0)
+            return ret < 0 ? ret : AVERROR_BUG;
+    }
+
+    if (av_packet_get_side_data(out, AV_PKT_DATA_SLICE_ADDR, NULL)) {
+        fprintf(stderr, "tile index side data left on the frame\n");
+        return AVERROR_BUG;
+    }
+    printf("%2d tiles, %"PRId64", %d, %7d, 0x%08"PRIx32"\n", nb_tiles,
+           out->pts, out->flags, out->size,
+           av_adler32_update(0, out->data, out->size));
+    av_packet_unref(out);
+    return 0;
+}
+
+static int run(int nb_tiles, int frame_size, int intra)
+{
+    const AVBitStreamFilter *filter = av_bsf_get_by_name("hevc_tile_repack");
+    AVPacket *tiles[MAX_TILES] = { NULL };
+    AVBSFContext *bsf = NULL;
+    AVPacket *tmp = NULL, *out = NULL;
+    int order[MAX_TILES];
+    AVLFG lfg;
+    int ret;
+
+    if (!filter)
+        return AVERROR_BSF_NOT_FOUND;
+
+    av_lfg_init(&lfg, 0x4e49 + nb_tiles);
+    for (int i = 0; i < nb_tiles; i++) {
+        tiles[i] = av_packet_alloc();
+        if (!tiles[i]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        ret = synth_tile(tiles[i], &lfg, i, frame_size / nb_tiles, intra);
+        if (ret < 0)
+            goto finish;
+    }
+
+    tmp = av_packet_alloc();
+    out = av_packet_alloc();
+    if (!tmp || !out) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    ret = av_bsf_alloc(filter, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_HEVC;
+    av_opt_set_int(bsf->priv_data, "tile_num", nb_tiles, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    /* the frame must not depend on the order the tiles come in */
+    for (int i = 0; i < nb_tiles; i++)
+        order[i] = i;
+    ret = repack(bsf, tiles, order, nb_tiles, 0, tmp, out);
+    if (ret < 0)
+        goto finish;
+
+    for (int i = 0; i < nb_tiles; i++)
+        order[i] = nb_tiles - 1 - i;
+    ret = repack(bsf, tiles, order, nb_tiles, 1, tmp, out);
+    if (ret < 0)
+        goto finish;
+
+    for (int i = nb_tiles - 1; i > 0; i--) {
+        int j = av_lfg_get(&lfg) % (i + 1);
+        FFSWAP(int, order[i], order[j]);
+    }
+    ret = repack(bsf, tiles, order, nb_tiles, 2, tmp, out);
+
+finish:
+    av_bsf_free(&bsf);
+    av_packet_free(&tmp);
+    av_packet_free(&out);
+    for (int i = 0; i < nb_tiles; i++)
+        av_packet_free(&tiles[i]);
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int intra = 1; ret >= 0 && intra >= 0; intra--) {
+        /* inter frames are a tenth of the size */
+        int size = intra ? 1 << 16 : (1 << 16) / 10;
+
+        for (int nb_tiles = 2; ret >= 0 && nb_tiles <= MAX_TILES; nb_tiles *= 2)
+            ret = run(nb_tiles, size, intra);
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "hevc_tile_repack failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/hwcontext.h"
+#include "libavutil/hwcontext_ni_quad.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "ni_ai_pipe.h"
+#include "ni_util.h"
+
+int ff_ni_ai_pipe_init(NIAIPipe *p, int depth)
+{
+    memset(p, 0, sizeof(*p));
+    p->entries = av_calloc(depth, sizeof(*p->entries));
+    if (!p->entries)
+        return AVERROR(ENOMEM);
+    p->depth = depth;
+    return 0;
+}
+
+void ff_ni_ai_pipe_fit_input(void *log_ctx, NIAIPipe *p, const AVFrame *frame)
+{
+    const AVHWFramesContext *hwfc;
+    int pool_size;
+
+    av_assert0(!p->count);
+    if (!frame->hw_frames_ctx)
+        return;
+
+    hwfc = (const AVHWFramesContext *)frame->hw_frames_ctx->data;
+    if (hwfc->format != AV_PIX_FMT_NI_QUAD)
+        return;
+
+    pool_size = ((const AVNIFramesContext *)hwfc->hwctx)->pool_size;
+    if (pool_size > 0 && p->depth > pool_size) {
+        av_log(log_ctx, AV_LOG_WARNING,
+               "depth %d reduced to the %d frames of the input pool\n",
+               p->depth, pool_size);
+        p->depth = pool_size;
+    }
+}
+
+void ff_ni_ai_pipe_uninit(NIAIPipe *p)
+{
+    while (p->count)
+        ff_ni_ai_pipe_pop(p);
+    av_freep(&p->entries);
+}
+
+NIAIPipeEntry *ff_ni_ai_pipe_push(NIAIPipe *p, AVFrame *frame)
+{
+    NIAIPipeEntry *e;
+
+    av_assert0(p->count < p->depth);
+    e = &p->entries[(p->head + p->count) % p->depth];
+    memset(e, 0, sizeof(*e));
+    e->frame       = frame;
+    e->submit_time = av_gettime_relative();
+
+    if (!p->first_time)
+        p->first_time = e->submit_time;
+    p->count++;
+    p->max_count = FFMAX(p->max_count, p->count);
+    return e;
+}
+
+void ff_ni_ai_pipe_pop(NIAIPipe *p)
+{
+    NIAIPipeEntry *e = &p->entries[p->head];
+
+    av_assert0(p->count > 0);
+    if (e->surface.ui16FrameIdx)
+        ni_hwframe_buffer_recycle(&e->surface, e->surface.device_handle);
+    av_frame_free(&e->frame);
+
+    p->last_time = av_gettime_relative();
+    p->latency  += p->last_time - e->submit_time;
+    p->nb_frames++;
+    p->nb_inferences += e->submitted;
+
+    p->head = (p->head + 1) % p->depth;
+    p->count--;
+}
+
+int ff_ni_ai_pipe_read(void *log_ctx, NIAIPipe *p,
+                       ni_session_context_t *api_ctx,
+                       ni_session_data_io_t *dst, int hwdesc, int timeout)
+{
+    int64_t start = av_gettime_relative();
+    ni_retcode_t retval;
+
+    for (;;) {
+        if (hwdesc)
+            retval = ni_device_session_read_hwdesc(api_ctx, dst,
+                                                   NI_DEVICE_TYPE_AI);
+        else
+            retval = ni_device_session_read(api_ctx, dst, NI_DEVICE_TYPE_AI);
+        if (retval < 0) {
+            av_log(log_ctx, AV_LOG_ERROR, "failed to read ai result: retval %d\n",
+                   retval);
+            return AVERROR(EIO);
+        }
+        /* a packet read returns its size, a hwdesc read success */
+        if (hwdesc ? retval == NI_RETCODE_SUCCESS : retval > 0)
+            break;
+        if (timeout == NI_AI_PIPE_NO_WAIT)
+            return AVERROR(EAGAIN);
+        if (timeout && av_gettime_relative() - start > timeout * 1000000LL) {
+            av_log(log_ctx, AV_LOG_ERROR, "read ai result timeout\n");
+            return AVERROR(ETIMEDOUT);
+        }
+        ni_usleep(100);
+    }
+
+    p->wait_time += av_gettime_relative() - start;
+    return 0;
+}
+
+int ff_ni_ai_pipe_complete_ready(AVFilterContext *ctx, NIAIPipe *p,
+                                 int (*complete)(AVFilterContext *ctx,
+                                                 int wait))
+{
+    while (p->count) {
+        int ret = complete(ctx, 0);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+void ff_ni_ai_pipe_log_stats(void *log_ctx, const NIAIPipe *p)
+{
+    double elapsed;
+
+    if (!p->nb_frames)
+        return;
+
+    elapsed = (p->last_time - p->first_time) / 1000000.0;
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "%"PRId64" frames, %"PRId64" inferences in %.3f s: %.2f fps, "
+           "depth %d (%d used), latency %.2f ms, read wait %.2f ms\n",
+           p->nb_frames, p->nb_inferences, elapsed,
+           elapsed > 0 ? p->nb_frames / elapsed : 0.0, p->depth, p->max_count,
+           p->latency / 1000.0 / p->nb_frames,
+           p->nb_inferences ? p->wait_time / 1000.0 / p->nb_inferences : 0.0);
+}
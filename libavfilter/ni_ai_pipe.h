@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Frames in flight on the AI engine of the NETINT Quadra AI filters.
+ *
+ * A filter submits frame N + 1 to the network before it reads back and
+ * post-processes the result of frame N, so the accelerator, the PCIe link
+ * and the CPU work overlap. Results come back in submission order, so the
+ * frames are kept in a FIFO and completed from its head.
+ */
+
+#ifndef AVFILTER_NI_AI_PIPE_H
+#define AVFILTER_NI_AI_PIPE_H
+
+#include <stdint.h>
+
+#include "libavutil/frame.h"
+
+#include "avfilter.h"
+
+#include <ni_device_api.h>
+
+#define NI_AI_PIPE_MAX_DEPTH 8
+
+/* ff_ni_ai_pipe_read() timeout returning at once if there is no result */
+#define NI_AI_PIPE_NO_WAIT -1
+
+#define NI_AI_PIPE_OPTION_DEPTH                                                      \
+    { "depth", "number of frames in flight on the AI engine", OFFSET(depth),        \
+      AV_OPT_TYPE_INT, {.i64 = 1}, 1, NI_AI_PIPE_MAX_DEPTH, FLAGS }
+
+typedef struct NIAIPipeEntry {
+    AVFrame *frame;
+    /* device frame the network reads, recycled when the entry is popped;
+     * ui16FrameIdx 0 when there is none */
+    niFrameSurface1_t surface;
+    /* 0 when the frame did not go through the network */
+    int submitted;
+    int64_t submit_time;
+} NIAIPipeEntry;
+
+typedef struct NIAIPipe {
+    NIAIPipeEntry *entries;
+    int depth;
+    int head;
+    int count;
+
+    /* throughput statistics */
+    int64_t nb_frames;
+    int64_t nb_inferences;
+    int64_t first_time;
+    int64_t last_time;
+    int64_t wait_time;
+    int64_t latency;
+    int max_count;
+} NIAIPipe;
+
+int ff_ni_ai_pipe_init(NIAIPipe *p, int depth);
+
+/**
+ * Every frame in flight holds a frame of the input, so reduce the depth to
+ * the size of the input frame pool when it is known. Call it before the
+ * first push.
+ */
+void ff_ni_ai_pipe_fit_input(void *log_ctx, NIAIPipe *p, const AVFrame *frame);
+
+/**
+ * Free the frames still in flight and recycle their device frames.
+ */
+void ff_ni_ai_pipe_uninit(NIAIPipe *p);
+
+/**
+ * Append a frame to the pipe, which must not be full. The pipe owns the
+ * frame until the entry is popped.
+ */
+NIAIPipeEntry *ff_ni_ai_pipe_push(NIAIPipe *p, AVFrame *frame);
+
+static inline int ff_ni_ai_pipe_full(const NIAIPipe *p)
+{
+    return p->count >= p->depth;
+}
+
+/**
+ * @return the oldest entry, or NULL if the pipe is empty
+ */
+static inline NIAIPipeEntry *ff_ni_ai_pipe_head(NIAIPipe *p)
+{
+    return p->count ? &p->entries[p->head] : NULL;
+}
+
+/**
+ * Remove the oldest entry, recycle its device frame and free its frame
+ * unless the caller took it.
+ */
+void ff_ni_ai_pipe_pop(NIAIPipe *p);
+
+/**
+ * Read the result of the oldest submitted frame, waiting for it.
+ *
+ * @param hwdesc  read a device frame descriptor instead of a packet
+ * @param timeout seconds to wait for the result, 0 to wait forever,
+ *                NI_AI_PIPE_NO_WAIT not to wait
+ * @return 0 on success, AVERROR(EAGAIN) if the result is not there yet and
+ *         timeout is NI_AI_PIPE_NO_WAIT, another negative error code on
+ *         failure
+ */
+int ff_ni_ai_pipe_read(void *log_ctx, NIAIPipe *p,
+                       ni_session_context_t *api_ctx,
+                       ni_session_data_io_t *dst, int hwdesc, int timeout);
+
+/**
+ * Complete the frames in flight whose result is already there, in order,
+ * without waiting. Call it on every activation so that results go out as
+ * soon as the AI engine returns them, not only when the pipe fills up.
+ *
+ * @param complete sends out the oldest frame in flight; with wait 0 it
+ *                 returns AVERROR(EAGAIN) and keeps the frame when its
+ *                 result is not there yet
+ */
+int ff_ni_ai_pipe_complete_ready(AVFilterContext *ctx, NIAIPipe *p,
+                                 int (*complete)(AVFilterContext *ctx,
+                                                 int wait));
+
+void ff_ni_ai_pipe_log_stats(void *log_ctx, const NIAIPipe *p);
+
+#endif /* AVFILTER_NI_AI_PIPE_H */
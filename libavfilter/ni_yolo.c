@@ -0,0 +1,710 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/attributes.h"
+#include "libavutil/bswap.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/intfloat.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "ni_yolo.h"
+
+/* class groups of fewer detections are suppressed pairwise */
+#define NMS_GRID_MIN_DETS 32
+#define NMS_GRID_MAX_SIZE 32
+/* boxes which meet more cells are compared to all the others */
+#define NMS_GRID_MAX_SPAN 25
+
+static int entry_index(const ni_roi_network_layer_t *l, int batch,
+                       int location, int entry)
+{
+    int n   = location / (l->width * l->height);
+    int loc = location % (l->width * l->height);
+    return batch * l->output_number +
+           n * l->width * l->height * (4 + l->classes + 1) +
+           entry * l->width * l->height + loc;
+}
+
+static inline float sigmoid(float x)
+{
+    return (float)(1.0 / (1.0 + (float)exp((double)(-x))));
+}
+
+/* map floats to integers of the same order, -inf to +inf being contiguous */
+static uint32_t float_key(float f)
+{
+    uint32_t bits = av_float2int(f);
+    return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+}
+
+static float key_float(uint32_t key)
+{
+    return av_int2float(key & 0x80000000 ? key & 0x7fffffff : ~key);
+}
+
+/*
+ * The smallest logit whose sigmoid() is thresh or more, NaN if there is
+ * none. sigmoid() is monotonic, and the probability of a class is the
+ * objectness times a sigmoid() of at most 1, so an anchor with a smaller
+ * objectness logit cannot have any class above thresh.
+ */
+static float logit_threshold(float thresh)
+{
+    uint32_t lo = float_key(-INFINITY);
+    uint32_t hi = float_key(INFINITY);
+
+    if (!(sigmoid(INFINITY) >= thresh))
+        return NAN;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (sigmoid(key_float(mid)) >= thresh)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return key_float(lo);
+}
+
+/*
+ * nw: network input width
+ * nh: network input height
+ * lw: layer width
+ * lh: layer height
+ */
+static box get_yolo_box(const float *x, const float *biases, int n, int index,
+                        int col, int row, int lw, int lh, int nw, int nh,
+                        int stride)
+{
+    box b;
+
+    b.x = (float)((float)col + sigmoid(x[index + 0 * stride])) / (float)lw;
+    b.y = (float)((float)row + sigmoid(x[index + 1 * stride])) / (float)lh;
+    b.w = (float)exp((double)x[index + 2 * stride]) * biases[2 * n] / (float)nw;
+    b.h = (float)exp((double)x[index + 3 * stride]) * biases[2 * n + 1] /
+          (float)nh;
+
+    b.x -= (float)(b.w / 2.0);
+    b.y -= (float)(b.h / 2.0);
+
+    return b;
+}
+
+static int get_yolo_detections(void *ctx, NIYoloContext *y,
+                               const ni_roi_network_layer_t *l, int netw,
+                               int neth, float thresh, int *dets_num)
+{
+    detection_cache *det_cache = &y->det_cache;
+    const float *predictions   = l->output;
+    const int wh               = l->width * l->height;
+    const float logit          = logit_threshold(thresh);
+    int32_t *cand[NI_YOLO_MAX_COMPONENT];
+    int nb_cand[NI_YOLO_MAX_COMPONENT];
+    int pos[NI_YOLO_MAX_COMPONENT] = { 0 };
+    int i, n, k;
+    float max_prob;
+    int prob_class;
+    int total = 0;
+    int count = 0;
+    detection *dets;
+    int row;
+    int col;
+    int obj_index;
+    float objectness;
+    int class_index;
+    double prob;
+    int box_index;
+    box bbox;
+
+    *dets_num = 0;
+
+    av_log(ctx, AV_LOG_TRACE,
+           "pic %dx%d, comp=%d, class=%d, net %dx%d, thresh=%f\n", l->width,
+           l->height, l->component, l->classes, netw, neth, thresh);
+
+    if (l->component > NI_YOLO_MAX_COMPONENT) {
+        av_log(ctx, AV_LOG_ERROR, "unsupported number of anchors %d\n",
+               l->component);
+        return AVERROR(EINVAL);
+    }
+
+    av_fast_malloc(&y->cand, &y->cand_size,
+                   sizeof(*y->cand) * l->component * wh);
+    if (!y->cand)
+        return AVERROR(ENOMEM);
+
+    for (n = 0; n < l->component; n++) {
+        const float *obj = predictions + entry_index(l, 0, n * wh, 4);
+
+        cand[n]    = y->cand + n * wh;
+        nb_cand[n] = 0;
+        for (i = 0; i < wh; i++) {
+            cand[n][nb_cand[n]] = i;
+            nb_cand[n] += obj[i] >= logit;
+        }
+        total += nb_cand[n];
+    }
+
+    if (!total)
+        return 0;
+
+    if (det_cache->dets_num + total > det_cache->capacity) {
+        int capacity = FFMAX(det_cache->capacity, 10);
+
+        while (capacity < det_cache->dets_num + total)
+            capacity *= 2;
+        dets = av_realloc_array(det_cache->dets, capacity, sizeof(*dets));
+        if (!dets) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "failed to realloc detections capacity %d\n", capacity);
+            return AVERROR(ENOMEM);
+        }
+        det_cache->dets     = dets;
+        det_cache->capacity = capacity;
+        if (capacity >= 100) {
+            av_log(ctx, AV_LOG_WARNING, "too many detections %d\n",
+                   det_cache->dets_num + total);
+        }
+    }
+    dets = det_cache->dets;
+
+    /* visit the candidates by location, then anchor, as a full scan would */
+    for (;;) {
+        n = -1;
+        i = INT_MAX;
+        for (k = 0; k < l->component; k++) {
+            if (pos[k] < nb_cand[k] && cand[k][pos[k]] < i) {
+                n = k;
+                i = cand[k][pos[k]];
+            }
+        }
+        if (n < 0)
+            break;
+        pos[n]++;
+
+        row = i / l->width;
+        col = i % l->width;
+
+        obj_index  = entry_index(l, 0, n * wh + i, 4);
+        objectness = sigmoid(predictions[obj_index]);
+
+        prob_class = -1;
+        max_prob   = thresh;
+        for (k = 0; k < l->classes; k++) {
+            class_index = entry_index(l, 0, n * wh + i, 4 + 1 + k);
+            prob = objectness * sigmoid(predictions[class_index]);
+            if (prob >= max_prob) {
+                prob_class = k;
+                max_prob   = (float)prob;
+            }
+        }
+
+        if (prob_class < 0)
+            continue;
+
+        box_index = entry_index(l, 0, n * wh + i, 0);
+
+        av_log(ctx, AV_LOG_TRACE, "max_prob %f, class %d\n", max_prob,
+               prob_class);
+        bbox = get_yolo_box(predictions, l->biases, l->mask[n], box_index, col,
+                            row, l->width, l->height, netw, neth, wh);
+
+        dets[det_cache->dets_num].max_prob   = max_prob;
+        dets[det_cache->dets_num].prob_class = prob_class;
+        dets[det_cache->dets_num].bbox       = bbox;
+        dets[det_cache->dets_num].objectness = objectness;
+        dets[det_cache->dets_num].classes    = l->classes;
+        dets[det_cache->dets_num].color      = n;
+
+        av_log(ctx, AV_LOG_TRACE, "%d, x %f, y %f, w %f, h %f\n",
+               det_cache->dets_num, dets[det_cache->dets_num].bbox.x,
+               dets[det_cache->dets_num].bbox.y,
+               dets[det_cache->dets_num].bbox.w,
+               dets[det_cache->dets_num].bbox.h);
+        det_cache->dets_num++;
+        count++;
+    }
+    *dets_num = count;
+    return 0;
+}
+
+static int nms_comparator(const void *pa, const void *pb)
+{
+    detection *a = (detection *)pa;
+    detection *b = (detection *)pb;
+
+    if (a->prob_class > b->prob_class)
+        return 1;
+    else if (a->prob_class < b->prob_class)
+        return -1;
+    else {
+        if (a->max_prob < b->max_prob)
+            return 1;
+        else if (a->max_prob > b->max_prob)
+            return -1;
+    }
+    return 0;
+}
+
+static float overlap(float x1, float w1, float x2, float w2)
+{
+    float l1    = x1 - w1 / 2;
+    float l2    = x2 - w2 / 2;
+    float left  = l1 > l2 ? l1 : l2;
+    float r1    = x1 + w1 / 2;
+    float r2    = x2 + w2 / 2;
+    float right = r1 < r2 ? r1 : r2;
+    return right - left;
+}
+
+static float box_intersection(box a, box b)
+{
+    float w = overlap(a.x, a.w, b.x, b.w);
+    float h = overlap(a.y, a.h, b.y, b.h);
+    float area;
+
+    if (w < 0 || h < 0)
+        return 0;
+
+    area = w * h;
+    return area;
+}
+
+static float box_iou(box a, box b)
+{
+    float I = box_intersection(a, b);
+    float U = a.w * a.h + b.w * b.h - I;
+    if (I == 0 || U == 0)
+        return 0;
+
+    return I / U;
+}
+
+/* dets all have the same class */
+static void nms_pairwise(detection *dets, int dets_num, float nms_thresh)
+{
+    int i, j;
+
+    for (i = 0; i < dets_num - 1; i++) {
+        if (dets[i].max_prob == 0)
+            continue;
+
+        for (j = i + 1; j < dets_num; j++) {
+            if (dets[j].max_prob == 0)
+                continue;
+
+            if (box_iou(dets[i].bbox, dets[j].bbox) > nms_thresh)
+                dets[j].max_prob = 0;
+        }
+    }
+}
+
+static int grid_cell(float p, int size)
+{
+    float c = p * size;
+    return c < 1 ? 0 : c >= size ? size - 1 : (int)c;
+}
+
+/* cells met by a box side as overlap() sees it, all of them if it is NaN */
+static void grid_span(float x, float w, int size, int *lo, int *hi)
+{
+    float l = x - w / 2;
+    float r = x + w / 2;
+
+    if (isnan(l) || isnan(r)) {
+        *lo = 0;
+        *hi = size - 1;
+    } else {
+        *lo = grid_cell(l, size);
+        *hi = grid_cell(r, size);
+    }
+}
+
+/*
+ * Same result as nms_pairwise() for a threshold of 0 or more: such a
+ * threshold needs a positive intersection, so a box is only compared to the
+ * boxes of the grid cells it meets and to the boxes too big for the grid.
+ * Boxes are still visited in order so that suppressed boxes do not
+ * suppress others.
+ */
+static int nms_grid(NIYoloContext *y, detection *dets, int dets_num,
+                    float nms_thresh)
+{
+    const int size     = av_clip((int)sqrt(dets_num / 8), 2, NMS_GRID_MAX_SIZE);
+    const int nb_cells = size * size;
+    int *range, *start, *cell_dets, *visited;
+    int nb_entries = 0, nb_large = 0;
+    int i, j, k, cx, cy;
+
+    av_fast_malloc(&y->cell_range, &y->cell_range_size,
+                   sizeof(*y->cell_range) * 4 * dets_num);
+    av_fast_malloc(&y->cell_start, &y->cell_start_size,
+                   sizeof(*y->cell_start) * nb_cells);
+    av_fast_malloc(&y->cell_dets, &y->cell_dets_size,
+                   sizeof(*y->cell_dets) * NMS_GRID_MAX_SPAN * dets_num);
+    av_fast_malloc(&y->visited, &y->visited_size,
+                   sizeof(*y->visited) * dets_num);
+    if (!y->cell_range || !y->cell_start || !y->cell_dets || !y->visited)
+        return AVERROR(ENOMEM);
+    range     = y->cell_range;
+    start     = y->cell_start;
+    cell_dets = y->cell_dets;
+    visited   = y->visited;
+
+    /* large boxes get an empty range and are compared to every box */
+    for (i = 0; i < dets_num; i++) {
+        int *r = range + 4 * i;
+
+        grid_span(dets[i].bbox.x, dets[i].bbox.w, size, &r[0], &r[1]);
+        grid_span(dets[i].bbox.y, dets[i].bbox.h, size, &r[2], &r[3]);
+        if (r[0] > r[1] || r[2] > r[3]) {
+            r[1] = r[0] - 1;
+        } else if ((r[1] - r[0] + 1) * (r[3] - r[2] + 1) > NMS_GRID_MAX_SPAN) {
+            r[1] = r[0] - 1;
+            r[2] = INT_MAX;
+            nb_large++;
+        }
+    }
+    if (nb_large > dets_num / 2)
+        return AVERROR(ERANGE);
+
+    /* once filled, cell c holds cell_dets[c ? start[c - 1] : 0 .. start[c]) */
+    memset(start, 0, sizeof(*start) * nb_cells);
+    for (i = 0; i < dets_num; i++) {
+        const int *r = range + 4 * i;
+        for (cy = r[2]; cy <= r[3]; cy++)
+            for (cx = r[0]; cx <= r[1]; cx++)
+                start[cy * size + cx]++;
+    }
+    for (k = 0; k < nb_cells; k++) {
+        int cnt     = start[k];
+        start[k]    = nb_entries;
+        nb_entries += cnt;
+    }
+    for (i = 0; i < dets_num; i++) {
+        const int *r = range + 4 * i;
+        for (cy = r[2]; cy <= r[3]; cy++)
+            for (cx = r[0]; cx <= r[1]; cx++)
+                cell_dets[start[cy * size + cx]++] = i;
+    }
+    /* the large boxes follow, in increasing order too */
+    for (i = 0, k = nb_entries; i < dets_num; i++)
+        if (range[4 * i + 2] == INT_MAX)
+            cell_dets[k++] = i;
+
+    for (i = 0; i < dets_num; i++)
+        visited[i] = -1;
+
+    for (i = 0; i < dets_num - 1; i++) {
+        const int *r = range + 4 * i;
+
+        if (dets[i].max_prob == 0)
+            continue;
+
+        if (r[2] == INT_MAX) {
+            for (j = i + 1; j < dets_num; j++) {
+                if (dets[j].max_prob == 0)
+                    continue;
+
+                if (box_iou(dets[i].bbox, dets[j].bbox) > nms_thresh)
+                    dets[j].max_prob = 0;
+            }
+            continue;
+        }
+
+        for (cy = r[2]; cy <= r[3]; cy++) {
+            for (cx = r[0]; cx <= r[1]; cx++) {
+                const int c     = cy * size + cx;
+                const int begin = c ? start[c - 1] : 0;
+
+                /* cells list their boxes in increasing order */
+                for (k = start[c] - 1; k >= begin && cell_dets[k] > i; k--) {
+                    j = cell_dets[k];
+
+                    if (visited[j] == i)
+                        continue;
+                    visited[j] = i;
+
+                    if (dets[j].max_prob == 0)
+                        continue;
+
+                    if (box_iou(dets[i].bbox, dets[j].bbox) > nms_thresh)
+                        dets[j].max_prob = 0;
+                }
+            }
+        }
+
+        for (k = nb_entries + nb_large - 1; k >= nb_entries && cell_dets[k] > i; k--) {
+            j = cell_dets[k];
+
+            if (dets[j].max_prob == 0)
+                continue;
+
+            if (box_iou(dets[i].bbox, dets[j].bbox) > nms_thresh)
+                dets[j].max_prob = 0;
+        }
+    }
+
+    return 0;
+}
+
+/* dets are sorted by class, suppress within each class */
+static void nms_sort(NIYoloContext *y, detection *dets, int dets_num,
+                     float nms_thresh)
+{
+    int first, end;
+
+    for (first = 0; first < dets_num; first = end) {
+        for (end = first + 1;
+             end < dets_num && dets[end].prob_class == dets[first].prob_class;
+             end++)
+            ;
+
+        if (end - first < NMS_GRID_MIN_DETS || !(nms_thresh >= 0) ||
+            nms_grid(y, dets + first, end - first, nms_thresh) < 0)
+            nms_pairwise(dets + first, end - first, nms_thresh);
+    }
+}
+
+static int resize_coords(void *ctx, detection *dets, int dets_num,
+                         uint32_t img_width, uint32_t img_height,
+                         struct roi_box **roi_box, int *roi_num)
+{
+    int i;
+    int left, right, top, bot;
+    struct roi_box *rbox;
+    int rbox_num = 0;
+
+    if (dets_num == 0) {
+        return 0;
+    }
+
+    rbox = av_malloc(sizeof(struct roi_box) * dets_num);
+    if (!rbox)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < dets_num; i++) {
+        av_log(ctx, AV_LOG_TRACE, "index %d, max_prob %f, class %d\n", i,
+               dets[i].max_prob, dets[i].prob_class);
+        if (dets[i].max_prob == 0)
+            continue;
+
+        top   = (int)floor(dets[i].bbox.y * img_height + 0.5);
+        left  = (int)floor(dets[i].bbox.x * img_width + 0.5);
+        right = (int)floor((dets[i].bbox.x + dets[i].bbox.w) * img_width + 0.5);
+        bot = (int)floor((dets[i].bbox.y + dets[i].bbox.h) * img_height + 0.5);
+
+        if (top < 0)
+            top = 0;
+
+        if (left < 0)
+            left = 0;
+
+        if (right > img_width)
+            right = img_width;
+
+        if (bot > img_height)
+            bot = img_height;
+
+        av_log(ctx, AV_LOG_DEBUG, "top %d, left %d, right %d, bottom %d\n", top,
+               left, right, bot);
+
+        rbox[rbox_num].left       = left;
+        rbox[rbox_num].right      = right;
+        rbox[rbox_num].top        = top;
+        rbox[rbox_num].bottom     = bot;
+        rbox[rbox_num].cls        = dets[i].prob_class;
+        rbox[rbox_num].objectness = dets[i].objectness;
+        rbox[rbox_num].color      = dets[i].color;
+        rbox[rbox_num].prob       = dets[i].max_prob;
+        rbox_num++;
+    }
+
+    if (rbox_num == 0) {
+        av_freep(&rbox);
+        *roi_num = rbox_num;
+        *roi_box = NULL;
+    } else {
+        *roi_num = rbox_num;
+        *roi_box = rbox;
+    }
+
+    return 0;
+}
+
+int ff_ni_yolo_get_detections(void *ctx, NIYoloContext *y,
+                              ni_roi_network_layer_t *layers, int nb_layers,
+                              int netw, int neth, uint32_t img_width,
+                              uint32_t img_height, float obj_thresh,
+                              float nms_thresh, struct roi_box **roi_box,
+                              int *roi_num)
+{
+    detection_cache *det_cache = &y->det_cache;
+    int i;
+    int ret;
+    int dets_num    = 0;
+    detection *dets = NULL;
+
+    *roi_box = NULL;
+    *roi_num = 0;
+
+    det_cache->dets_num = 0;
+    for (i = 0; i < nb_layers; i++) {
+        ret = get_yolo_detections(ctx, y, &layers[i], netw, neth, obj_thresh,
+                                  &dets_num);
+        if (ret != 0) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "failed to get yolo detection at layer %d\n", i);
+            return ret;
+        }
+        av_log(ctx, AV_LOG_TRACE, "layer %d, yolo detections: %d\n", i,
+               dets_num);
+    }
+
+    if (det_cache->dets_num == 0)
+        return 0;
+
+    dets     = det_cache->dets;
+    dets_num = det_cache->dets_num;
+    for (i = 0; i < dets_num; i++) {
+        av_log(ctx, AV_LOG_TRACE,
+               "orig dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
+               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
+               dets[i].prob_class, dets[i].max_prob);
+    }
+
+    qsort(dets, dets_num, sizeof(detection), nms_comparator);
+    for (i = 0; i < dets_num; i++) {
+        av_log(ctx, AV_LOG_TRACE,
+               "sorted dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
+               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
+               dets[i].prob_class, dets[i].max_prob);
+    }
+
+    nms_sort(y, dets, dets_num, nms_thresh);
+    ret = resize_coords(ctx, dets, dets_num, img_width, img_height, roi_box,
+                        roi_num);
+    if (ret != 0) {
+        av_log(ctx, AV_LOG_ERROR, "cannot resize coordinates\n");
+        return ret;
+    }
+
+    return 0;
+}
+
+int ff_ni_yolo_dump_layers(FILE *f, const ni_roi_network_layer_t *layers,
+                           int nb_layers, int netw, int neth)
+{
+    const uint32_t header[4] = { NI_YOLO_DUMP_TAG, netw, neth, nb_layers };
+    int i;
+
+    if (fwrite(header, sizeof(header), 1, f) != 1)
+        return AVERROR(EIO);
+
+    for (i = 0; i < nb_layers; i++) {
+        const ni_roi_network_layer_t *l = &layers[i];
+        const uint32_t dims[3] = { l->width, l->height, l->channel };
+
+        if (fwrite(dims, sizeof(dims), 1, f) != 1 ||
+            fwrite(l->output, sizeof(*l->output), l->output_number, f) !=
+                l->output_number)
+            return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+int ff_ni_yolo_read_layers(FILE *f, ni_roi_network_layer_t *layers,
+                           int max_layers, int *nb_layers, int *netw,
+                           int *neth)
+{
+    uint32_t header[4];
+    int i;
+
+    *nb_layers = 0;
+
+    if (fread(header, sizeof(header), 1, f) != 1)
+        return AVERROR_EOF;
+    if (header[0] == av_bswap32(NI_YOLO_DUMP_TAG))
+        return AVERROR_PATCHWELCOME;
+    if (header[0] != NI_YOLO_DUMP_TAG || !header[1] || header[1] > INT_MAX ||
+        !header[2] || header[2] > INT_MAX || !header[3] ||
+        header[3] > max_layers)
+        return AVERROR_INVALIDDATA;
+    *netw = header[1];
+    *neth = header[2];
+
+    for (i = 0; i < header[3]; i++) {
+        ni_roi_network_layer_t *l = &layers[i];
+        uint32_t dims[3];
+
+        if (fread(dims, sizeof(dims), 1, f) != 1)
+            return AVERROR_INVALIDDATA;
+        if (!dims[0] || !dims[1] || dims[2] < NI_YOLO_MAX_COMPONENT * 6 ||
+            dims[2] % NI_YOLO_MAX_COMPONENT || dims[2] > INT_MAX ||
+            (uint64_t)dims[0] * dims[1] > INT_MAX / sizeof(float) / dims[2])
+            return AVERROR_INVALIDDATA;
+
+        l->width         = dims[0];
+        l->height        = dims[1];
+        l->channel       = dims[2];
+        l->component     = NI_YOLO_MAX_COMPONENT;
+        l->classes       = l->channel / l->component - 5;
+        l->output_number = l->width * l->height * l->channel;
+        l->output = av_malloc_array(l->output_number, sizeof(*l->output));
+        if (!l->output)
+            return AVERROR(ENOMEM);
+        (*nb_layers)++;
+
+        if (fread(l->output, sizeof(*l->output), l->output_number, f) !=
+            l->output_number)
+            return AVERROR_INVALIDDATA;
+    }
+
+    return 0;
+}
+
+av_cold int ff_ni_yolo_init(NIYoloContext *y)
+{
+    memset(y, 0, sizeof(*y));
+
+    y->det_cache.capacity = 20;
+    y->det_cache.dets     = av_malloc(sizeof(detection) * y->det_cache.capacity);
+    if (!y->det_cache.dets)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+av_cold void ff_ni_yolo_uninit(NIYoloContext *y)
+{
+    av_freep(&y->det_cache.dets);
+    av_freep(&y->cand);
+    av_freep(&y->cell_range);
+    av_freep(&y->cell_start);
+    av_freep(&y->cell_dets);
+    av_freep(&y->visited);
+}
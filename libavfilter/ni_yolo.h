@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * YOLO output decoding and non-maximum suppression of the NETINT Quadra
+ * roi filter. It does not depend on libxcoder so that its FATE test and
+ * tools/ni_yolo_bench can run it on layer dumps.
+ */
+
+#ifndef AVFILTER_NI_YOLO_H
+#define AVFILTER_NI_YOLO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "libavutil/macros.h"
+
+#define NI_YOLO_MAX_COMPONENT 3
+
+/**
+ * Layer dump file: each frame starts with NI_YOLO_DUMP_TAG, then the
+ * network width, network height and number of layers, then each layer
+ * follows as its width, height and channel count and its
+ * width * height * channel floats. Everything is in host byte order as
+ * 32-bit values; a byte swapped tag tells a dump of another endianness.
+ */
+#define NI_YOLO_DUMP_TAG MKTAG('N', 'I', 'Y', 'F')
+
+typedef struct _ni_roi_network_layer {
+    int32_t width;
+    int32_t height;
+    int32_t channel;
+    int32_t classes;
+    int32_t component;
+    int32_t mask[3];
+    float biases[12];
+    int32_t output_number;
+    float *output;
+} ni_roi_network_layer_t;
+
+typedef struct box {
+    float x, y, w, h;
+} box;
+
+typedef struct detection {
+    box bbox;
+    float objectness;
+    int classes;
+    int color;
+    float *prob;
+    int prob_class;
+    float max_prob;
+} detection;
+
+typedef struct detetion_cache {
+    detection *dets;
+    int capacity;
+    int dets_num;
+} detection_cache;
+
+struct roi_box {
+    int left;
+    int right;
+    int top;
+    int bottom;
+    int color;
+    float objectness;
+    int cls;
+    float prob;
+};
+
+typedef struct NIYoloContext {
+    detection_cache det_cache;
+
+    /* objectness pre-filter: the locations of each anchor which pass it */
+    int32_t *cand;
+    unsigned int cand_size;
+
+    /* NMS grid: the cell range of each detection, the detections of each
+     * cell and the last box each detection was compared to */
+    int *cell_range;
+    unsigned int cell_range_size;
+    int *cell_start;
+    unsigned int cell_start_size;
+    int *cell_dets;
+    unsigned int cell_dets_size;
+    int *visited;
+    unsigned int visited_size;
+} NIYoloContext;
+
+int ff_ni_yolo_init(NIYoloContext *y);
+void ff_ni_yolo_uninit(NIYoloContext *y);
+
+/**
+ * Decode the detections of all the layers, suppress the overlapping ones
+ * and scale the others to the picture.
+ *
+ * @param roi_box set to an array of roi_num boxes to be freed with
+ *                av_free(), or NULL if there is none
+ */
+int ff_ni_yolo_get_detections(void *log_ctx, NIYoloContext *y,
+                              ni_roi_network_layer_t *layers, int nb_layers,
+                              int netw, int neth, uint32_t img_width,
+                              uint32_t img_height, float obj_thresh,
+                              float nms_thresh, struct roi_box **roi_box,
+                              int *roi_num);
+
+/**
+ * Append the output of all the layers to a layer dump file.
+ */
+int ff_ni_yolo_dump_layers(FILE *f, const ni_roi_network_layer_t *layers,
+                           int nb_layers, int netw, int neth);
+
+/**
+ * Read the next frame of a layer dump. The dimensions, classes, component
+ * count and output of the layers are set, their mask and biases are left
+ * to the caller.
+ *
+ * @param nb_layers set to the number of layers whose output was allocated,
+ *                  which the caller must free with av_freep() even on error
+ * @return 0 on success, AVERROR_EOF at the end of the dump, another
+ *         negative error code on failure
+ */
+int ff_ni_yolo_read_layers(FILE *f, ni_roi_network_layer_t *layers,
+                           int max_layers, int *nb_layers, int *netw,
+                           int *neth);
+
+#endif /* AVFILTER_NI_YOLO_H */
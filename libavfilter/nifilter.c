@@ -43,6 +43,7 @@
 #include "libavutil/libm.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/ni_copy.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 
@@ -164,10 +165,9 @@ int ff_ni_ffmpeg_to_libxcoder_pix_fmt(enum AVPixelFormat pix_fmt)
     return -1;
 }
 
-int ff_ni_copy_device_to_host_frame(AVFrame *dst, const ni_frame_t *src, int pix_fmt)
+static int gc620_nb_planes(int pix_fmt)
 {
-  switch (pix_fmt)
-  {
+    switch (pix_fmt) {
     /* packed */
     case GC620_RGBA8888:
     case GC620_BGRA8888:
@@ -177,75 +177,93 @@ int ff_ni_copy_device_to_host_frame(AVFrame *dst, const ni_frame_t *src, int pix
     case GC620_BGR565:
     case GC620_B5G5R5X1:
     case GC620_YUYV:
-      memcpy(dst->data[0],src->p_data[0],src->data_len[0]);
-      break;
+        return 1;
 
     /* semi-planar */
     case GC620_NV12:
     case GC620_NV21:
     case GC620_P010_MSB:
     case GC620_NV16:
-      memcpy(dst->data[0], src->p_data[0], src->data_len[0]);
-      memcpy(dst->data[1], src->p_data[1], src->data_len[1]);
-      break;
+        return 2;
 
     /* planar */
     case GC620_I420:
     case GC620_I010:
-      memcpy(dst->data[0], src->p_data[0], src->data_len[0]);
-      memcpy(dst->data[1], src->p_data[1], src->data_len[1]);
-      memcpy(dst->data[2], src->p_data[2], src->data_len[2]);
-      break;
+        return 3;
 
     default:
-      return -1;
-  }
+        return -1;
+    }
+}
+
+/* Contiguous planes are copied as 4 KiB rows so that large frames bypass the
+ * cache with non-temporal stores */
+#define COPY_ROW_SIZE 4096
+
+static void copy_planes(uint8_t *const dst[], const uint8_t *const src[],
+                        const uint32_t len[], int nb_planes)
+{
+    NICopyPlane planes[2 * NI_MAX_NUM_DATA_POINTERS] = { 0 };
+    int i, n = 0;
+
+    for (i = 0; i < nb_planes; i++) {
+        int rows = len[i] / COPY_ROW_SIZE;
+        int tail = len[i] % COPY_ROW_SIZE;
+
+        if (rows) {
+            planes[n].dst          = dst[i];
+            planes[n].src          = src[i];
+            planes[n].dst_linesize = COPY_ROW_SIZE;
+            planes[n].src_linesize = COPY_ROW_SIZE;
+            planes[n].bytewidth    = COPY_ROW_SIZE;
+            planes[n].height       = rows;
+            n++;
+        }
+        if (tail) {
+            planes[n].dst          = dst[i] + (ptrdiff_t)rows * COPY_ROW_SIZE;
+            planes[n].src          = src[i] + (ptrdiff_t)rows * COPY_ROW_SIZE;
+            planes[n].dst_linesize = tail;
+            planes[n].src_linesize = tail;
+            planes[n].bytewidth    = tail;
+            planes[n].height       = 1;
+            n++;
+        }
+    }
 
-  return 0;
+    avpriv_ni_copy_planes(NULL, planes, n);
 }
 
-int ff_ni_copy_host_to_device_frame(ni_frame_t *dst, const AVFrame *src, int pix_fmt)
+int ff_ni_copy_device_to_host_frame(AVFrame *dst, const ni_frame_t *src, int pix_fmt)
 {
-  switch (pix_fmt)
-  {
-    /* packed */
-    case GC620_RGBA8888:
-    case GC620_BGRA8888:
-    case GC620_ABGR8888:
-    case GC620_ARGB8888:
-    case GC620_RGB565:
-    case GC620_BGR565:
-    case GC620_B5G5R5X1:
-    case GC620_YUYV:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      dst->pixel_format = pix_fmt;
-      break;
+    const uint8_t *src_data[NI_MAX_NUM_DATA_POINTERS];
+    int i, nb_planes = gc620_nb_planes(pix_fmt);
 
-    /* planar */
-    case GC620_I420:
-    case GC620_I010:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      memcpy(dst->p_data[1], src->data[1], dst->data_len[1]);
-      memcpy(dst->p_data[2], src->data[2], dst->data_len[2]);
-      dst->pixel_format = pix_fmt;
-      break;
+    if (nb_planes < 0)
+        return -1;
 
-    /* semi-planar */
-    case GC620_NV12:
-    case GC620_NV21:
-    case GC620_P010_MSB:
-    case GC620_NV16:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      dst->pixel_format = pix_fmt;
-      break;
+    for (i = 0; i < nb_planes; i++)
+        src_data[i] = src->p_data[i];
+    copy_planes(dst->data, src_data, src->data_len, nb_planes);
 
-    default:
-      dst->pixel_format = -1;
-      return -1;
-  }
+    return 0;
+}
+
+int ff_ni_copy_host_to_device_frame(ni_frame_t *dst, const AVFrame *src, int pix_fmt)
+{
+    const uint8_t *src_data[NI_MAX_NUM_DATA_POINTERS];
+    int i, nb_planes = gc620_nb_planes(pix_fmt);
+
+    if (nb_planes < 0) {
+        dst->pixel_format = -1;
+        return -1;
+    }
+
+    for (i = 0; i < nb_planes; i++)
+        src_data[i] = src->data[i];
+    copy_planes(dst->p_data, src_data, dst->data_len, nb_planes);
+    dst->pixel_format = pix_fmt;
 
-  return 0;
+    return 0;
 }
 
 void ff_ni_frame_free(void *opaque, uint8_t *data)
@@ -0,0 +1,193 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Run the YOLO post-processing of ni_quadra_roi on a layer dump and print
+ * the number of regions of interest of every frame with a checksum of their
+ * coordinates, class and color; the regions themselves are listed for
+ * frames with few of them. Without an argument, the dump is synthesized for
+ * a 416x416 face network where 1% to 50% of the anchors hold an object,
+ * written to a temporary file and read back.
+ *
+ * Usage: ni_yolo [dump_file]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+
+#include "libavfilter/ni_yolo.h"
+
+#define MAX_LAYERS 8
+#define MAX_LISTED 32
+
+/* human face model of the filter */
+static const int32_t masks[2][3] = {{3, 4, 5}, {0, 1, 2}};
+static const float biases[] = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
+
+static float uniform(AVLFG *lfg, float lo, float hi)
+{
+    return lo + (hi - lo) * (av_lfg_get(lfg) / 4294967296.0f);
+}
+
+static int write_frame(FILE *f, AVLFG *lfg, float density)
+{
+    static const int sizes[2] = { 13, 26 };
+    ni_roi_network_layer_t layers[2] = { { 0 } };
+    int ret = 0;
+
+    for (int i = 0; i < 2 && ret >= 0; i++) {
+        ni_roi_network_layer_t *l = &layers[i];
+        int wh = sizes[i] * sizes[i];
+
+        l->width         = sizes[i];
+        l->height        = sizes[i];
+        l->component     = 3;
+        l->classes       = 1;
+        l->channel       = l->component * (5 + l->classes);
+        l->output_number = wh * l->channel;
+        l->output = av_malloc_array(l->output_number, sizeof(*l->output));
+        if (!l->output) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+
+        for (int n = 0; n < l->component; n++) {
+            float *p = l->output + n * wh * (5 + l->classes);
+            for (int j = 0; j < wh; j++) {
+                p[0 * wh + j] = uniform(lfg, -3.0f, 3.0f);
+                p[1 * wh + j] = uniform(lfg, -3.0f, 3.0f);
+                p[2 * wh + j] = uniform(lfg, -1.5f, 0.5f);
+                p[3 * wh + j] = uniform(lfg, -1.5f, 0.5f);
+                p[4 * wh + j] = uniform(lfg, 0.0f, 1.0f) < density ?
+                                uniform(lfg, -1.0f, 4.0f) :
+                                uniform(lfg, -12.0f, -2.0f);
+                for (int k = 0; k < l->classes; k++)
+                    p[(5 + k) * wh + j] = uniform(lfg, -1.0f, 4.0f);
+            }
+        }
+    }
+
+    if (ret >= 0)
+        ret = ff_ni_yolo_dump_layers(f, layers, 2, 416, 416);
+    for (int i = 0; i < 2; i++)
+        av_freep(&layers[i].output);
+    return ret;
+}
+
+static FILE *synth_dump(void)
+{
+    static const float densities[] = { 0.01f, 0.05f, 0.2f, 0.5f };
+    FILE *f = tmpfile();
+    AVLFG lfg;
+
+    if (!f)
+        return NULL;
+
+    av_lfg_init(&lfg, 0x4e49);
+    for (int d = 0; d < FF_ARRAY_ELEMS(densities); d++) {
+        for (int i = 0; i < 2; i++) {
+            if (write_frame(f, &lfg, densities[d]) < 0) {
+                fclose(f);
+                return NULL;
+            }
+        }
+    }
+    rewind(f);
+    return f;
+}
+
+/* the probabilities are left out, their last bits depend on the libm */
+static uint32_t checksum(const struct roi_box *roi, int nb_rois)
+{
+    uint32_t sum = 0;
+
+    for (int i = 0; i < nb_rois; i++) {
+        const int v[6] = { roi[i].left, roi[i].top, roi[i].right,
+                           roi[i].bottom, roi[i].cls, roi[i].color };
+        uint8_t buf[sizeof(v) / sizeof(*v) * 4];
+
+        for (int j = 0; j < FF_ARRAY_ELEMS(v); j++)
+            AV_WL32(buf + 4 * j, v[j]);
+        sum = av_adler32_update(sum, buf, sizeof(buf));
+    }
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    ni_roi_network_layer_t layers[MAX_LAYERS] = { { 0 } };
+    NIYoloContext y;
+    FILE *f;
+    int ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    f = argc > 1 ? fopen(argv[1], "rb") : synth_dump();
+    if (!f) {
+        fprintf(stderr, "Cannot open the layer dump\n");
+        return 1;
+    }
+
+    ret = ff_ni_yolo_init(&y);
+
+    for (int frame = 0; ret >= 0; frame++) {
+        struct roi_box *roi;
+        int nb_layers, netw, neth, nb_rois;
+
+        ret = ff_ni_yolo_read_layers(f, layers, MAX_LAYERS, &nb_layers,
+                                     &netw, &neth);
+        for (int i = 0; i < nb_layers; i++) {
+            memcpy(layers[i].mask, masks[FFMIN(i, 1)], sizeof(layers[i].mask));
+            memcpy(layers[i].biases, biases, sizeof(layers[i].biases));
+        }
+        if (ret >= 0)
+            ret = ff_ni_yolo_get_detections(NULL, &y, layers, nb_layers,
+                                            netw, neth, 1920, 1080,
+                                            0.25f, 0.45f, &roi, &nb_rois);
+        for (int i = 0; i < nb_layers; i++)
+            av_freep(&layers[i].output);
+        if (ret < 0)
+            break;
+
+        printf("frame %d: %4d rois, 0x%08"PRIx32"\n", frame, nb_rois,
+               checksum(roi, nb_rois));
+        for (int i = 0; nb_rois <= MAX_LISTED && i < nb_rois; i++)
+            printf("%4d %4d %4d %4d, %d, %d, %.4f, %.4f\n",
+                   roi[i].left, roi[i].top, roi[i].right, roi[i].bottom,
+                   roi[i].cls, roi[i].color, roi[i].objectness, roi[i].prob);
+        av_free(roi);
+    }
+
+    ff_ni_yolo_uninit(&y);
+    fclose(f);
+
+    if (ret < 0 && ret != AVERROR_EOF) {
+        fprintf(stderr, "ni_yolo failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
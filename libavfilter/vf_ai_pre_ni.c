@@ -45,6 +45,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/time.h"
 #include "libswscale/swscale.h"
+#include "ni_ai_pipe.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
 #include "video.h"
@@ -104,6 +105,9 @@ typedef struct NetIntAiPreprocessContext {
     int buffer_limit;
     int align_width;
     int skip_ai_align;
+
+    int depth;                  /* frames in flight on the AI engine */
+    NIAIPipe pipe;
 } NetIntAiPreprocessContext;
 
 static int query_formats(AVFilterContext * ctx)
@@ -260,7 +264,7 @@ static int init_ai_context(AVFilterContext * ctx,
                                    0,   // rec height
                                    0,   // rec X pos
                                    0,   // rec Y pos
-                                   8,   // rgba color/pool size
+                                   8 + s->pipe.depth - 1,   // rgba color/pool size
                                    0,   // frame index
                                    NI_DEVICE_TYPE_AI);
     if (retval != NI_RETCODE_SUCCESS) {
@@ -556,7 +560,11 @@ static av_cold int init(AVFilterContext * ctx)
         av_log(ctx, AV_LOG_ERROR, "invalid network binary path\n");
         return AVERROR(EINVAL);
     }
-    return 0;
+#if !IS_FFMPEG_61_AND_ABOVE
+    /* frames in flight can only be flushed from activate() */
+    s->depth = 1;
+#endif
+    return ff_ni_ai_pipe_init(&s->pipe, s->depth);
 }
 
 static av_cold void uninit(AVFilterContext * ctx)
@@ -564,6 +572,9 @@ static av_cold void uninit(AVFilterContext * ctx)
     NetIntAiPreprocessContext *s = ctx->priv;
     ni_ai_pre_network_t *network = &s->network;
 
+    ff_ni_ai_pipe_log_stats(ctx, &s->pipe);
+    ff_ni_ai_pipe_uninit(&s->pipe);
+
     cleanup_ai_context(ctx, s);
 
     ni_destroy_network(ctx, network);
@@ -585,6 +596,8 @@ static int config_input(AVFilterContext * ctx, AVFrame * frame)
     if (s->initialized)
         return 0;
 
+    ff_ni_ai_pipe_fit_input(ctx, &s->pipe, frame);
+
     ret = init_ai_context(ctx, s, frame);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to initialize ai context\n");
@@ -1125,48 +1138,21 @@ static int ni_to_avframe_copy(AVFrame * dst, const ni_packet_t * src,
     return 0;
 }
 
-static int filter_frame(AVFilterLink * link, AVFrame * in)
+/* read the output of the oldest frame in flight and send it out, unless
+ * wait is 0 and it is not there yet */
+static int ai_pre_complete(AVFilterContext * ctx, int wait)
 {
-    AVFilterContext *ctx = link->dst;
-    AVHWFramesContext *in_frames_context = NULL;    //= (AVHWFramesContext *) in->hw_frames_ctx->data;
     NetIntAiPreprocessContext *s = ctx->priv;
+    AiContext *ai_ctx = s->ai_ctx;
+    NIAIPipeEntry *e = ff_ni_ai_pipe_head(&s->pipe);
+    AVFrame *in = e->frame;
+    AVHWFramesContext *in_frames_context = NULL;
     AVFrame *out = NULL;
     ni_retcode_t retval;
     int ret;
-    AiContext *ai_ctx;
     ni_ai_pre_network_t *network = &s->network;
     int nb_planes;
-    int hwframe;
-    int64_t start_t;
-
-    if (in == NULL) {
-        av_log(ctx, AV_LOG_WARNING, "in frame is null\n");
-        return AVERROR(EINVAL);
-    }
-    hwframe = in->format == AV_PIX_FMT_NI_QUAD ? 1 : 0;
-    if (!s->initialized) {
-        AVHWFramesContext *pAVHFWCtx;
-        if (hwframe) {
-            pAVHFWCtx = (AVHWFramesContext *) in->hw_frames_ctx->data;
-        }
-        ret = config_input(ctx, in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
-            goto failed_out;
-        }
-        if (hwframe) {
-            av_hwframe_ctx_init(s->out_frames_ref);
-            AVHWFramesContext *out_frames_ctx =
-                (AVHWFramesContext *) s->out_frames_ref->data;
-            AVNIFramesContext *out_ni_ctx =
-                (AVNIFramesContext *) out_frames_ctx->hwctx;
-            ni_cpy_hwframe_ctx(pAVHFWCtx, out_frames_ctx);
-            ni_device_session_copy(&s->ai_ctx->api_ctx,
-                                   &out_ni_ctx->api_ctx);
-        }
-    }
 
-    ai_ctx = s->ai_ctx;
     out = av_frame_alloc();
     if (!out) {
         ret = AVERROR(ENOMEM);
@@ -1176,11 +1162,9 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
     av_frame_copy_props(out, in);
     out->width = s->out_width;
     out->height = s->out_height;
-    if (hwframe) {
+    if (in->format == AV_PIX_FMT_NI_QUAD) {
         niFrameSurface1_t *frame_surface;
         niFrameSurface1_t *frame_surface2;
-        int ai_out_format;
-        niFrameSurface1_t dst_surface = { 0 };
 
         in_frames_context = (AVHWFramesContext *) in->hw_frames_ctx->data;
         out->format = AV_PIX_FMT_NI_QUAD;
@@ -1193,9 +1177,159 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
             goto failed_out;
         }
 
+        memcpy(out->data[3], in->data[3], sizeof(niFrameSurface1_t));
+
+        /* Set the new frame index */
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_frame, 1,
+                                 wait ? s->ai_timeout : NI_AI_PIPE_NO_WAIT);
+        if (ret < 0) {
+            av_freep(&out->data[3]);
+            goto failed_out;
+        }
+
+#ifdef NI_MEASURE_LATENCY
+        ff_ni_update_benchmark("ni_quadra_ai_pre");
+#endif
+
+        frame_surface2 =
+            (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.
+            p_data[3];
+        frame_surface = (niFrameSurface1_t *) out->data[3];
+
+        av_log(ctx, AV_LOG_DEBUG, "ai pre process, idx=%d\n",
+               frame_surface2->ui16FrameIdx);
+
+        frame_surface->ui16FrameIdx = frame_surface2->ui16FrameIdx;
+        frame_surface->ui16session_ID = frame_surface2->ui16session_ID;
+        frame_surface->device_handle = frame_surface2->device_handle;
+        frame_surface->output_idx = frame_surface2->output_idx;
+        frame_surface->src_cpu = frame_surface2->src_cpu;
+        frame_surface->ui32nodeAddress = 0;
+        frame_surface->dma_buf_fd = 0;
+        ff_ni_set_bit_depth_and_encoding_type(&frame_surface->bit_depth,
+                                              &frame_surface->
+                                              encoding_type,
+                                              in_frames_context->
+                                              sw_format);
+        frame_surface->ui16width = out->width;
+        frame_surface->ui16height = out->height;
+
+        out->buf[0] = av_buffer_create(out->data[3],
+                                       sizeof(niFrameSurface1_t),
+                                       ff_ni_frame_free, NULL, 0);
+        if (!out->buf[0]) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "ni ai_pre filter av_buffer_create returned NULL\n");
+            ret = AVERROR(ENOMEM);
+            av_log(NULL, AV_LOG_DEBUG,
+                   "Recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
+                   frame_surface->ui16FrameIdx,
+                   frame_surface->device_handle);
+            retval =
+                ni_hwframe_buffer_recycle(frame_surface,
+                                          frame_surface->device_handle);
+            if (retval != NI_RETCODE_SUCCESS) {
+                av_log(NULL, AV_LOG_ERROR,
+                       "ERROR Failed to recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
+                       frame_surface->ui16FrameIdx,
+                       frame_surface->device_handle);
+            }
+            av_freep(&out->data[3]);
+            goto failed_out;
+        }
+
+        /* Reference the new hw frames context */
+        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+    } else {
+        out->format = in->format;
+        if (av_frame_get_buffer(out, 32) < 0) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "Could not allocate the AVFrame buffers\n");
+            ret = AVERROR(ENOMEM);
+            goto failed_out;
+        }
+
+        retval =
+            ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
+                                      &network->raw);
+        if (retval != NI_RETCODE_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "failed to allocate ni packet\n");
+            ret = AVERROR(ENOMEM);
+            goto failed_out;
+        }
+
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_frame, 0,
+                                 wait ? s->ai_timeout : NI_AI_PIPE_NO_WAIT);
+        if (ret < 0)
+            goto failed_out;
+#ifdef NI_MEASURE_LATENCY
+        ff_ni_update_benchmark("ni_quadra_ai_pre");
+#endif
+        nb_planes = av_pix_fmt_count_planes(out->format);
+        if (s->channel_mode) {
+            if (out->format != AV_PIX_FMT_YUV420P
+                && out->format != AV_PIX_FMT_YUVJ420P) {
+                av_log(ctx, AV_LOG_ERROR,
+                       "Error: support yuv420p and yuvj420p only, current fmt %d\n",
+                       out->format);
+                ret = AVERROR(EINVAL);
+                goto failed_out;
+            }
+            nb_planes = 1;      // only copy Y data
+        }
+        retval =
+            ni_to_avframe_copy(out, &ai_ctx->api_dst_frame.data.packet,
+                               nb_planes);
+        if (retval < 0) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "ai_pre cannot copy ai frame to avframe\n");
+            ret = AVERROR(EIO);
+            goto failed_out;
+        }
+        if (s->channel_mode) {
+            // copy U/V data from the input sw frame
+            memcpy(out->data[1], in->data[1],
+                   in->height * in->linesize[1] / 2);
+            memcpy(out->data[2], in->data[2],
+                   in->height * in->linesize[2] / 2);
+        }
+    }
+
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ff_filter_frame(ctx->outputs[0], out);
+
+failed_out:
+    av_frame_free(&out);
+    /* no output yet, the frame stays in flight */
+    if (ret == AVERROR(EAGAIN))
+        return ret;
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ret;
+}
+
+/* send a frame to the network, the pipe must not be full */
+static int ai_pre_submit(AVFilterContext * ctx, AVFrame * in)
+{
+    NetIntAiPreprocessContext *s = ctx->priv;
+    AiContext *ai_ctx = s->ai_ctx;
+    AVHWFramesContext *in_frames_context = NULL;
+    NIAIPipeEntry *e;
+    ni_retcode_t retval;
+    int ret;
+    ni_ai_pre_network_t *network = &s->network;
+    int nb_planes;
+    int64_t start_t;
+
+    if (in->format == AV_PIX_FMT_NI_QUAD) {
+        niFrameSurface1_t *frame_surface;
+        int ai_out_format;
+        niFrameSurface1_t dst_surface = { 0 };
+
+        in_frames_context = (AVHWFramesContext *) in->hw_frames_ctx->data;
         frame_surface = (niFrameSurface1_t *) in->data[3];
 
-        memcpy(out->data[3], frame_surface, sizeof(niFrameSurface1_t));
         av_log(ctx, AV_LOG_DEBUG, "input frame surface frameIdx %d\n",
                frame_surface->ui16FrameIdx);
 
@@ -1317,89 +1451,7 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
             ret = AVERROR(ENOMEM);
             goto failed_out;
         }
-
-        /* Set the new frame index */
-        start_t = av_gettime();
-        do {
-            retval =
-                ni_device_session_read_hwdesc(&ai_ctx->api_ctx,
-                                              &s->ai_ctx->api_dst_frame,
-                                              NI_DEVICE_TYPE_AI);
-
-            if (retval < NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "failed to read hwdesc,ret=%d\n",
-                       ret);
-                ret = AVERROR(EINVAL);
-                goto failed_out;
-            }
-            if (av_gettime() - start_t > s->ai_timeout * 1000000) {
-                av_log(ctx, AV_LOG_ERROR, "alloc hw output timeout\n");
-                ret = AVERROR(ENOMEM);
-                goto failed_out;
-            }
-        } while (retval != NI_RETCODE_SUCCESS);
-
-#ifdef NI_MEASURE_LATENCY
-        ff_ni_update_benchmark("ni_quadra_ai_pre");
-#endif
-
-        frame_surface2 =
-            (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.
-            p_data[3];
-        frame_surface = (niFrameSurface1_t *) out->data[3];
-
-        av_log(ctx, AV_LOG_DEBUG, "ai pre process, idx=%d\n",
-               frame_surface2->ui16FrameIdx);
-
-        frame_surface->ui16FrameIdx = frame_surface2->ui16FrameIdx;
-        frame_surface->ui16session_ID = frame_surface2->ui16session_ID;
-        frame_surface->device_handle = frame_surface2->device_handle;
-        frame_surface->output_idx = frame_surface2->output_idx;
-        frame_surface->src_cpu = frame_surface2->src_cpu;
-        frame_surface->ui32nodeAddress = 0;
-        frame_surface->dma_buf_fd = 0;
-        ff_ni_set_bit_depth_and_encoding_type(&frame_surface->bit_depth,
-                                              &frame_surface->
-                                              encoding_type,
-                                              in_frames_context->
-                                              sw_format);
-        frame_surface->ui16width = out->width;
-        frame_surface->ui16height = out->height;
-
-        out->buf[0] = av_buffer_create(out->data[3],
-                                       sizeof(niFrameSurface1_t),
-                                       ff_ni_frame_free, NULL, 0);
-        if (!out->buf[0]) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "ni ai_pre filter av_buffer_create returned NULL\n");
-            ret = AVERROR(ENOMEM);
-            av_log(NULL, AV_LOG_DEBUG,
-                   "Recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
-                   frame_surface->ui16FrameIdx,
-                   frame_surface->device_handle);
-            retval =
-                ni_hwframe_buffer_recycle(frame_surface,
-                                          frame_surface->device_handle);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(NULL, AV_LOG_ERROR,
-                       "ERROR Failed to recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
-                       frame_surface->ui16FrameIdx,
-                       frame_surface->device_handle);
-            }
-            goto failed_out;
-        }
-
-        /* Reference the new hw frames context */
-        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
     } else {
-        out->format = in->format;
-        if (av_frame_get_buffer(out, 32) < 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "Could not allocate the AVFrame buffers\n");
-            ret = AVERROR(ENOMEM);
-            goto failed_out;
-        }
-
         start_t = av_gettime();
         retval =
             ni_ai_frame_buffer_alloc(&ai_ctx->api_src_frame.data.frame,
@@ -1433,7 +1485,7 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
         ff_ni_update_benchmark(NULL);
 #endif
 
-        /* write frame */
+        /* write frame, making room by completing the frames in flight */
         do {
             retval =
                 ni_device_session_write(&ai_ctx->api_ctx,
@@ -1444,6 +1496,10 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
                        "failed to write ai session: retval %d\n", retval);
                 ret = AVERROR(EIO);
                 goto failed_out;
+            } else if (retval == 0 && s->pipe.count) {
+                ret = ai_pre_complete(ctx, 1);
+                if (ret < 0)
+                    goto failed_out;
             }
 
             if (av_gettime() - start_t > s->ai_timeout * 1000000) {
@@ -1453,77 +1509,64 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
                 goto failed_out;
             }
         } while (retval == 0);
-        retval =
-            ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
-                                      &network->raw);
-        if (retval != NI_RETCODE_SUCCESS) {
-            av_log(ctx, AV_LOG_ERROR, "failed to allocate ni packet\n");
-            ret = AVERROR(ENOMEM);
-            goto failed_out;
-        }
+    }
 
-        start_t = av_gettime();
-        do {
-            retval =
-                ni_device_session_read(&ai_ctx->api_ctx,
-                                       &ai_ctx->api_dst_frame,
-                                       NI_DEVICE_TYPE_AI);
-            if (retval < 0) {
-                av_log(NULL, AV_LOG_ERROR, "read AI data retval %d\n",
-                       retval);
-                ret = AVERROR(EIO);
-                goto failed_out;
-            } else if (retval > 0) {
-                if (av_gettime() - start_t > s->ai_timeout * 1000000) {
-                    av_log(ctx, AV_LOG_ERROR,
-                           "read sw frame from AI timeout\n");
-                    ret = AVERROR(ENOMEM);
-                    goto failed_out;
-                }
-            }
-        } while (retval == 0);
-#ifdef NI_MEASURE_LATENCY
-        ff_ni_update_benchmark("ni_quadra_ai_pre");
-#endif
-        nb_planes = av_pix_fmt_count_planes(out->format);
-        if (s->channel_mode) {
-            if (out->format != AV_PIX_FMT_YUV420P
-                && out->format != AV_PIX_FMT_YUVJ420P) {
-                av_log(ctx, AV_LOG_ERROR,
-                       "Error: support yuv420p and yuvj420p only, current fmt %d\n",
-                       out->format);
-                ret = AVERROR(EINVAL);
-                goto failed_out;
-            }
-            nb_planes = 1;      // only copy Y data
+    /* the input is read by the network until the output is */
+    e = ff_ni_ai_pipe_push(&s->pipe, in);
+    e->submitted = 1;
+    return 0;
+
+failed_out:
+    av_frame_free(&in);
+    return ret;
+}
+
+static int filter_frame(AVFilterLink * link, AVFrame * in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntAiPreprocessContext *s = ctx->priv;
+    int ret;
+    int hwframe;
+
+    if (in == NULL) {
+        av_log(ctx, AV_LOG_WARNING, "in frame is null\n");
+        return AVERROR(EINVAL);
+    }
+    hwframe = in->format == AV_PIX_FMT_NI_QUAD ? 1 : 0;
+    if (!s->initialized) {
+        AVHWFramesContext *pAVHFWCtx;
+        if (hwframe) {
+            pAVHFWCtx = (AVHWFramesContext *) in->hw_frames_ctx->data;
         }
-        retval =
-            ni_to_avframe_copy(out, &ai_ctx->api_dst_frame.data.packet,
-                               nb_planes);
-        if (retval < 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "ai_pre cannot copy ai frame to avframe\n");
-            ret = AVERROR(EIO);
-            goto failed_out;
+        ret = config_input(ctx, in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
+            av_frame_free(&in);
+            return ret;
         }
-        if (s->channel_mode) {
-            // copy U/V data from the input sw frame
-            memcpy(out->data[1], in->data[1],
-                   in->height * in->linesize[1] / 2);
-            memcpy(out->data[2], in->data[2],
-                   in->height * in->linesize[2] / 2);
+        if (hwframe) {
+            av_hwframe_ctx_init(s->out_frames_ref);
+            AVHWFramesContext *out_frames_ctx =
+                (AVHWFramesContext *) s->out_frames_ref->data;
+            AVNIFramesContext *out_ni_ctx =
+                (AVNIFramesContext *) out_frames_ctx->hwctx;
+            ni_cpy_hwframe_ctx(pAVHFWCtx, out_frames_ctx);
+            ni_device_session_copy(&s->ai_ctx->api_ctx,
+                                   &out_ni_ctx->api_ctx);
         }
     }
 
-    av_frame_free(&in);
-    return ff_filter_frame(link->dst->outputs[0], out);
-
-failed_out:
-    if (out)
-        av_frame_free(&out);
+    ret = ai_pre_submit(ctx, in);
+    if (ret < 0)
+        return ret;
 
-    av_frame_free(&in);
-    return ret;
+    /* with depth 1 this reads the frame just submitted */
+    while (ff_ni_ai_pipe_full(&s->pipe)) {
+        ret = ai_pre_complete(ctx, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
 }
 
 #if IS_FFMPEG_61_AND_ABOVE
@@ -1533,11 +1576,18 @@ static int activate(AVFilterContext * ctx)
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *frame = NULL;
     int ret = 0;
+    int status;
+    int64_t pts;
     NetIntAiPreprocessContext *s = inlink->dst->priv;
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    /* send out the frames whose result is already there */
+    ret = ff_ni_ai_pipe_complete_ready(ctx, &s->pipe, ai_pre_complete);
+    if (ret < 0)
+        return ret;
+
     if (ff_inlink_check_available_frame(inlink)) {
         ret = ff_inlink_consume_frame(inlink, &frame);
         if (ret < 0)
@@ -1550,7 +1600,16 @@ static int activate(AVFilterContext * ctx)
         return ret;
     }
     // We did not get a frame from input link, check its status
-    FF_FILTER_FORWARD_STATUS(inlink, outlink);
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        // Read back the frames still in flight before forwarding EOF
+        while (s->pipe.count) {
+            ret = ai_pre_complete(ctx, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
 
     // We have no frames yet from input link and no EOF, so request some.
     FF_FILTER_FORWARD_WANTED(outlink, inlink);
@@ -1573,6 +1632,7 @@ static const AVOption ni_ai_pre_options[] = {
     { "align_w", "Set width of the align.",           OFFSET(align_width),  AV_OPT_TYPE_INT, {.i64 = 4}, 0, NI_MAX_RESOLUTION_WIDTH,  FLAGS },
     { "skip_ai_align", "Set skip do ai align.",       OFFSET(skip_ai_align), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1,  FLAGS },
     { "timeout", "Timeout for AI operations",         OFFSET(ai_timeout),   AV_OPT_TYPE_INT, {.i64 = NI_DEFAULT_KEEP_ALIVE_TIMEOUT}, NI_MIN_KEEP_ALIVE_TIMEOUT, NI_MAX_KEEP_ALIVE_TIMEOUT, FLAGS },
+    NI_AI_PIPE_OPTION_DEPTH,
     NI_FILT_OPTION_KEEPALIVE10,
     NI_FILT_OPTION_BUFFER_LIMIT,
     { NULL }
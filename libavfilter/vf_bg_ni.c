@@ -39,6 +39,7 @@
 #if HAVE_IO_H
 #include <io.h>
 #endif
+#include "ni_ai_pipe.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
 #include "video.h"
@@ -133,6 +134,9 @@ typedef struct NetIntBgContext {
     int keep_alive_timeout; /* keep alive timeout setting */
     bool is_p2p;
     int buffer_limit;
+
+    int depth;              /* frames in flight on the AI engine */
+    NIAIPipe pipe;
 } NetIntBgContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -379,10 +383,12 @@ static av_cold int init_hwframe_scale(AVFilterContext *ctx, NetIntBgContext *s,
 #if IS_FFMPEG_61_AND_ABOVE
     s->buffer_limit = 1;
 #endif
-    /* Create scale frame pool on device */
+    /* Create scale frame pool on device, the scaled frames in flight stay
+     * allocated until their mask is read back */
     retval = ff_ni_build_frame_pool(&hws_ctx->api_ctx, s->network.netw,
                                     s->network.neth, format,
-                                    DEFAULT_NI_FILTER_POOL_SIZE, s->buffer_limit);
+                                    DEFAULT_NI_FILTER_POOL_SIZE + s->pipe.depth - 1,
+                                    s->buffer_limit);
     if (retval < 0) {
         av_log(ctx, AV_LOG_ERROR, "could not build frame pool\n");
         ret = AVERROR(EIO);
@@ -547,6 +553,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     NetIntBgContext *s            = ctx->priv;
     ni_roi_network_t *network = &s->network;
 
+    ff_ni_ai_pipe_log_stats(ctx, &s->pipe);
+    ff_ni_ai_pipe_uninit(&s->pipe);
+
     av_buffer_unref(&s->hwframe);
     av_buffer_unref(&s->hwdevice);
 
@@ -880,6 +889,15 @@ static int ni_bg_config_input(AVFilterContext *ctx, AVFrame *frame)
                 "WARNING: Full color range input, limited color range output\n");
     }
 
+#if !IS_FFMPEG_61_AND_ABOVE
+    /* frames in flight can only be flushed from activate() */
+    s->depth = 1;
+#endif
+    ret = ff_ni_ai_pipe_init(&s->pipe, s->depth);
+    if (ret < 0)
+        return ret;
+    ff_ni_ai_pipe_fit_input(ctx, &s->pipe, frame);
+
     ret = init_hwframe_uploader(ctx, s, frame);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to initialize uploader session\n");
@@ -1337,112 +1355,41 @@ static int ni_bg_process(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
     return 0;
 }
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+/* read the mask of the oldest frame in flight, overlay the background and
+ * send it out, unless wait is 0 and the mask is not there yet */
+static int bg_complete(AVFilterContext *ctx, int wait)
 {
-    AVFilterContext *ctx = link->dst;
     NetIntBgContext *s = ctx->priv;
-    int ret;
-    /* ai roi */
-    ni_roi_network_t *network;
+    AiContext *ai_ctx  = s->ai_ctx;
+    NIAIPipeEntry *e   = ff_ni_ai_pipe_head(&s->pipe);
+    AVFrame *in        = e->frame;
     ni_retcode_t retval;
-    AiContext *ai_ctx;
+    int ret;
     /* overlay */
     AVFrame *realout;
 
-    av_log(ctx, AV_LOG_INFO, "entering %s\n", __func__);
-
-    s->framecount++;
-
-    if (!s->initialized) {
-#if IS_FFMPEG_71_AND_ABOVE
-        AVFilterLink *outlink = link->dst->outputs[0];
-        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
-           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
-        }
-#endif
-        ret = ni_bg_config_input(ctx, in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
+    /* a skipped frame uses the last mask */
+    if (e->submitted) {
+        retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
+                                           &s->network.raw);
+        if (retval != NI_RETCODE_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
+            ret = AVERROR(EAGAIN);
             goto fail;
         }
 
-#if !IS_FFMPEG_342_AND_ABOVE
-        ret = config_output(ctx->outputs[0], in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config output\n");
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_pkt, 0,
+                                 wait ? 0 : NI_AI_PIPE_NO_WAIT);
+        if (ret == AVERROR(EAGAIN))
+            return ret;
+        if (ret < 0)
             goto fail;
-        }
-#endif
-
-        AVHWFramesContext *in_frames_ctx = (AVHWFramesContext *)in->hw_frames_ctx->data;
-        AVHWFramesContext *out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
-        AVNIFramesContext *out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
-        ni_cpy_hwframe_ctx(in_frames_ctx, out_frames_ctx);
-        ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
-
-        s->initialized = 1;
-    }
-
-    ai_ctx  = s->ai_ctx;
-    network = &s->network;
-
-    retval  = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
-                                       &network->raw);
-    if (retval != NI_RETCODE_SUCCESS) {
-        av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
-        ret = AVERROR(EAGAIN);
-        goto fail;
-    }
-
-#ifdef NI_MEASURE_LATENCY
-    ff_ni_update_benchmark(NULL);
-#endif
-
-    if (in->format == AV_PIX_FMT_NI_QUAD) {
-        niFrameSurface1_t *filt_frame_surface;
-
-        if ((s->skip == 0) || ((s->framecount-1) % (s->skip + 1) == 0)) {
-            ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
-                                   &filt_frame_surface);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
-                goto fail;
-            }
 
-            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
-                   filt_frame_surface->ui16FrameIdx);
-
-            /* allocate output buffer */
-            retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
-                                           filt_frame_surface->ui32nodeAddress,
-                                           filt_frame_surface->ui16FrameIdx,
-                                           NI_DEVICE_TYPE_AI);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
-                ret = AVERROR(ENOMEM);
-                goto fail;
-            }
-
-            do {
-                retval = ni_device_session_read(
-                    &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-                if (retval < 0) {
-                    av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                    ret = AVERROR(EIO);
-                    goto fail;
-                } else if (retval > 0) {
-                    ret = ni_bg_process(ctx, &ai_ctx->api_dst_pkt, in);
-                    if (ret != 0) {
-                        av_log(ctx, AV_LOG_ERROR,
-                               "failed to read roi from packet\n");
-                        goto fail;
-                    }
-                }
-                ni_usleep(100); //prevent spamming HW
-            } while (retval == 0);
-
-           ni_hwframe_buffer_recycle(filt_frame_surface,
-                                     filt_frame_surface->device_handle);
+        ret = ni_bg_process(ctx, &ai_ctx->api_dst_pkt, in);
+        if (ret != 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to read roi from packet\n");
+            goto fail;
         }
     }
 
@@ -1502,14 +1449,125 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     ff_ni_update_benchmark("ni_quadra_bg");
 #endif
 
-    av_frame_free(&in);
     av_frame_free(&s->alpha_mask_hwframe);
+    ff_ni_ai_pipe_pop(&s->pipe);
 
     return ff_filter_frame(ctx->outputs[0], realout);
 fail:
-    av_frame_free(&in);
     if (s->alpha_mask_hwframe)
         av_frame_free(&s->alpha_mask_hwframe);
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ret;
+}
+
+/* send a frame to the network unless it is skipped, the pipe must not be
+ * full */
+static int bg_submit(AVFilterContext *ctx, AVFrame *in)
+{
+    NetIntBgContext *s = ctx->priv;
+    AiContext *ai_ctx  = s->ai_ctx;
+    ni_roi_network_t *network = &s->network;
+    niFrameSurface1_t *filt_frame_surface;
+    NIAIPipeEntry *e;
+    ni_retcode_t retval;
+    int ret;
+
+    s->framecount++;
+
+#ifdef NI_MEASURE_LATENCY
+    ff_ni_update_benchmark(NULL);
+#endif
+
+    if (in->format != AV_PIX_FMT_NI_QUAD ||
+        !((s->skip == 0) || ((s->framecount-1) % (s->skip + 1) == 0))) {
+        ff_ni_ai_pipe_push(&s->pipe, in);
+        return 0;
+    }
+
+    ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
+                           &filt_frame_surface);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
+        goto fail;
+    }
+
+    av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
+           filt_frame_surface->ui16FrameIdx);
+
+    /* allocate output buffer */
+    retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
+                                   filt_frame_surface->ui32nodeAddress,
+                                   filt_frame_surface->ui16FrameIdx,
+                                   NI_DEVICE_TYPE_AI);
+    if (retval != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
+        ni_hwframe_buffer_recycle(filt_frame_surface,
+                                  filt_frame_surface->device_handle);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the scaled frame is read by the network until the mask is */
+    e = ff_ni_ai_pipe_push(&s->pipe, in);
+    e->surface   = *filt_frame_surface;
+    e->submitted = 1;
+    return 0;
+fail:
+    av_frame_free(&in);
+    return ret;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntBgContext *s = ctx->priv;
+    int ret;
+
+    av_log(ctx, AV_LOG_INFO, "entering %s\n", __func__);
+
+    if (!s->initialized) {
+#if IS_FFMPEG_71_AND_ABOVE
+        AVFilterLink *outlink = link->dst->outputs[0];
+        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
+           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
+        }
+#endif
+        ret = ni_bg_config_input(ctx, in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
+            goto fail;
+        }
+
+#if !IS_FFMPEG_342_AND_ABOVE
+        ret = config_output(ctx->outputs[0], in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config output\n");
+            goto fail;
+        }
+#endif
+
+        AVHWFramesContext *in_frames_ctx = (AVHWFramesContext *)in->hw_frames_ctx->data;
+        AVHWFramesContext *out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
+        AVNIFramesContext *out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
+        ni_cpy_hwframe_ctx(in_frames_ctx, out_frames_ctx);
+        ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
+
+        s->initialized = 1;
+    }
+
+    ret = bg_submit(ctx, in);
+    if (ret < 0)
+        return ret;
+
+    /* with depth 1 this completes the frame just submitted */
+    while (ff_ni_ai_pipe_full(&s->pipe)) {
+        ret = bg_complete(ctx, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+fail:
+    av_frame_free(&in);
     return ret;
 }
 
@@ -1521,10 +1579,17 @@ static int activate(AVFilterContext *ctx)
     NetIntBgContext *s = ctx->priv;
     AVFrame *frame = NULL;
     int ret = 0;
+    int status;
+    int64_t pts;
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    /* send out the frames whose result is already there */
+    ret = ff_ni_ai_pipe_complete_ready(ctx, &s->pipe, bg_complete);
+    if (ret < 0)
+        return ret;
+
     if (ff_inlink_check_available_frame(inlink)) {
         // Consume from inlink framequeue only when outlink framequeue is empty
         // to prevent filter from exhausting all pre-allocated device buffers
@@ -1553,7 +1618,16 @@ static int activate(AVFilterContext *ctx)
     }
 
     // We did not get a frame from input link, check its status
-    FF_FILTER_FORWARD_STATUS(inlink, outlink);
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        // Complete the frames still in flight before forwarding EOF
+        while (s->pipe.count) {
+            ret = bg_complete(ctx, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
 
     // We have no frames yet from input link and no EOF, so request some.
     FF_FILTER_FORWARD_WANTED(outlink, inlink);
@@ -1569,6 +1643,7 @@ static const AVOption ni_bg_options[] = {
     { "bg_img",         "path to replacement background file", OFFSET(bg_img),         AV_OPT_TYPE_STRING, .flags = FLAGS},
     { "use_default_bg", "use bright green background image",   OFFSET(use_default_bg), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,       FLAGS},
     { "skip",           "frames to skip between inference",    OFFSET(skip),           AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, FLAGS},
+    NI_AI_PIPE_OPTION_DEPTH,
     NI_FILT_OPTION_IS_P2P,
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
@@ -40,6 +40,7 @@
 #if HAVE_IO_H
 #include <io.h>
 #endif
+#include "ni_ai_pipe.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
 #include "video.h"
@@ -133,6 +134,9 @@ typedef struct NetIntBgrContext {
     int skip_random_offset;
     int keep_alive_timeout; /* keep alive timeout setting */
     int buffer_limit;
+
+    int depth;              /* frames in flight on the AI engine */
+    NIAIPipe pipe;
 } NetIntBgrContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -381,10 +385,11 @@ static av_cold int init_hwframe_scale(AVFilterContext *ctx, NetIntBgrContext *s,
 #if IS_FFMPEG_61_AND_ABOVE
     s->buffer_limit = 1;
 #endif
-    /* Create scale frame pool on device */
+    /* Create scale frame pool on device, the downscaled frames in flight
+     * stay allocated until their mask is read back */
     retval = ff_ni_build_frame_pool(&hws_ctx->api_ctx, s->network.netw,
                                     s->network.neth, format,
-                                    DEFAULT_NI_FILTER_POOL_SIZE,
+                                    DEFAULT_NI_FILTER_POOL_SIZE + s->pipe.depth - 1,
                                     s->buffer_limit);
     if (retval < 0) {
         av_log(ctx, AV_LOG_ERROR, "could not build frame pool\n");
@@ -588,6 +593,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     NetIntBgrContext *s            = ctx->priv;
     ni_roi_network_t *network = &s->network;
 
+    ff_ni_ai_pipe_log_stats(ctx, &s->pipe);
+    ff_ni_ai_pipe_uninit(&s->pipe);
+
     av_buffer_unref(&s->hwframe);
     av_buffer_unref(&s->hwdevice);
 
@@ -632,6 +640,15 @@ static int ni_bgr_config_input(AVFilterContext *ctx, AVFrame *frame)
     init_out_hwframe_ctx(ctx, (AVHWFramesContext *)frame->hw_frames_ctx->data);
 #endif
 
+#if !IS_FFMPEG_61_AND_ABOVE
+    /* frames in flight can only be flushed from activate() */
+    s->depth = 1;
+#endif
+    ret = ff_ni_ai_pipe_init(&s->pipe, s->depth);
+    if (ret < 0)
+        return ret;
+    ff_ni_ai_pipe_fit_input(ctx, &s->pipe, frame);
+
     ret = init_hwframe_uploader(ctx, s, frame);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to initialize uploader session\n");
@@ -1057,68 +1074,105 @@ static int ni_bgr_create_output(AVFilterContext* ctx, AVFrame* in, AVFrame** rea
 }
 
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+/* read the mask of the oldest frame in flight, apply it and send it out,
+ * unless wait is 0 and the mask is not there yet */
+static int bgr_complete(AVFilterContext *ctx, int wait)
 {
-    AVFilterContext *ctx = link->dst;
     NetIntBgrContext *s = ctx->priv;
-    int ret;
-    int clean_scale_format = 0;
-
-    /* ai roi */
-    ni_roi_network_t *network;
-    ni_retcode_t retval;
-    AiContext *ai_ctx;
-    niFrameSurface1_t *downscale_bgr_surface;
+    AiContext *ai_ctx   = s->ai_ctx;
+    NIAIPipeEntry *e    = ff_ni_ai_pipe_head(&s->pipe);
+    AVFrame *in         = e->frame;
     niFrameSurface1_t *rgba_frame_surface;
     niFrameSurface1_t *logging_surface;
     niFrameSurface1_t *logging_surface_out;
-    AVFrame *realout;
-
-    s->framecount++;
-
-#define CLEAN_SCALE 1
-#define CLEAN_FORMAT 2
-
-    av_log(ctx, AV_LOG_DEBUG, "entering %s\n", __func__);
+    AVFrame *realout = NULL;
+    ni_retcode_t retval;
+    int ret;
 
-    if (!s->initialized) {
-#if IS_FFMPEG_71_AND_ABOVE
-        AVFilterLink *outlink = link->dst->outputs[0];
-        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
-           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
-        }
-#endif
-        s->skip_random_offset = 1;
-        ret = ni_bgr_config_input(ctx, in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
+    /* a skipped frame uses the last frame background shape; read the mask
+     * first so that nothing is done when it is not there yet */
+    s->skipInference = !e->submitted;
+    if (e->submitted) {
+        retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
+                                           &s->network.raw);
+        if (retval != NI_RETCODE_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
+            ret = AVERROR(EAGAIN);
             goto fail;
         }
 
-#if !IS_FFMPEG_342_AND_ABOVE
-        ret = config_output(ctx->outputs[0], in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config output\n");
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_pkt, 0,
+                                 wait ? 0 : NI_AI_PIPE_NO_WAIT);
+        if (ret == AVERROR(EAGAIN))
+            return ret;
+        if (ret < 0)
             goto fail;
-        }
-#endif
+    }
 
-        s->initialized = 1;
+    ret = ni_hwframe_convert_format(ctx, s, in, &rgba_frame_surface);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR,
+                "Error in runnig hwframe for format conversion\n");
+        goto fail;
+    }
+    ret = ni_hwframe_converted_download(ctx, s, rgba_frame_surface);
+    ni_hwframe_buffer_recycle(rgba_frame_surface,
+                              rgba_frame_surface->device_handle);
+    if (ret <= 0) {
+        av_log(ctx, AV_LOG_ERROR,
+                "Error in downloading hwframe for format conversion\n");
+        goto fail;
     }
 
-    ai_ctx  = s->ai_ctx;
-    network = &s->network;
+    ret = ni_bgr_process(ctx, &ai_ctx->api_dst_pkt);
+    if (ret != 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to process tensor\n");
+        goto fail;
+    }
+
+    //output AVframe created
+    ret = ni_bgr_create_output(ctx, in, &realout);
+    if (ret < 0) {
+        av_frame_free(&realout);
+        goto fail;
+    }
 
 #ifdef NI_MEASURE_LATENCY
-    ff_ni_update_benchmark(NULL);
+    ff_ni_update_benchmark("ni_quadra_bgr");
 #endif
 
-    retval  = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
-                                        &network->raw);
-    if (retval != NI_RETCODE_SUCCESS) {
-        av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
-        return AVERROR(EAGAIN);
-    }
+    //Logging for hwframe tracking
+    logging_surface = (niFrameSurface1_t*)in->data[3];
+    logging_surface_out = (niFrameSurface1_t*)realout->data[3];
+    av_log(ctx, AV_LOG_DEBUG,
+        "vf_bgr_ni.c:IN trace ui16FrameIdx = [%d] --> out [%d]\n",
+        logging_surface->ui16FrameIdx, logging_surface_out->ui16FrameIdx);
+
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ff_filter_frame(ctx->outputs[0], realout);
+fail:
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ret;
+}
+
+/* send a frame to the network unless it is skipped, the pipe must not be
+ * full */
+static int bgr_submit(AVFilterContext *ctx, AVFrame *in)
+{
+    NetIntBgrContext *s = ctx->priv;
+    AiContext *ai_ctx   = s->ai_ctx;
+    ni_roi_network_t *network = &s->network;
+    niFrameSurface1_t *downscale_bgr_surface;
+    NIAIPipeEntry *e;
+    ni_retcode_t retval;
+    int ret;
+
+    s->framecount++;
+
+#ifdef NI_MEASURE_LATENCY
+    ff_ni_update_benchmark(NULL);
+#endif
 
     if ((s->skip == 0) || ((s->framecount - 1) % (s->skip + 1) == 0)) {
         if (s->skip_random_offset) {
@@ -1127,110 +1181,90 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                    ai_ctx->api_ctx.session_id, s->framecount);
             s->skip_random_offset = 0;
         }
-        s->skipInference = false;
     } else {
-        s->skipInference = true;
         av_log(ctx, AV_LOG_DEBUG, "Inference skip, framecount %d\n", s->framecount);
+        ff_ni_ai_pipe_push(&s->pipe, in);
+        return 0;
     }
-    //Main Job
-    {
-        if (!s->skipInference) {
-            ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
-                                    &downscale_bgr_surface);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
-                goto fail;
-            }
-            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
-                downscale_bgr_surface->ui16FrameIdx);
-        }
 
-        if (!s->skipInference) {
-            /* allocate output buffer */
-            retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
-                                            downscale_bgr_surface->ui32nodeAddress,
-                                            downscale_bgr_surface->ui16FrameIdx,
-                                            NI_DEVICE_TYPE_AI);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
-                ret =  AVERROR(ENOMEM);
-                clean_scale_format |= CLEAN_SCALE;
-                goto fail;
-            }
+    ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
+                           &downscale_bgr_surface);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
+        goto fail;
+    }
+    av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
+           downscale_bgr_surface->ui16FrameIdx);
+
+    /* allocate output buffer */
+    retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
+                                   downscale_bgr_surface->ui32nodeAddress,
+                                   downscale_bgr_surface->ui16FrameIdx,
+                                   NI_DEVICE_TYPE_AI);
+    if (retval != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
+        ni_hwframe_buffer_recycle(downscale_bgr_surface,
+                                  downscale_bgr_surface->device_handle);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the downscaled frame is read by the network until the mask is */
+    e = ff_ni_ai_pipe_push(&s->pipe, in);
+    e->surface   = *downscale_bgr_surface;
+    e->submitted = 1;
+    return 0;
+fail:
+    av_frame_free(&in);
+    return ret;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntBgrContext *s = ctx->priv;
+    int ret;
+
+    av_log(ctx, AV_LOG_DEBUG, "entering %s\n", __func__);
+
+    if (!s->initialized) {
+#if IS_FFMPEG_71_AND_ABOVE
+        AVFilterLink *outlink = link->dst->outputs[0];
+        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
+           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
         }
-        ret = ni_hwframe_convert_format(ctx, s, in, &rgba_frame_surface);
-        if (ret < 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                    "Error in runnig hwframe for format conversion\n");
+#endif
+        s->skip_random_offset = 1;
+        ret = ni_bgr_config_input(ctx, in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
             goto fail;
         }
-        ret = ni_hwframe_converted_download(ctx, s, rgba_frame_surface);
-        if (ret <= 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                    "Error in downloading hwframe for format conversion\n");
-            clean_scale_format |= CLEAN_FORMAT;
+
+#if !IS_FFMPEG_342_AND_ABOVE
+        ret = config_output(ctx->outputs[0], in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config output\n");
             goto fail;
         }
-        ni_hwframe_buffer_recycle(rgba_frame_surface,
-                                    rgba_frame_surface->device_handle);
-        if (!s->skipInference) {
-            do {
-                retval = ni_device_session_read(
-                    &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-                if (retval < 0) {
-                    av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                    ret = AVERROR(EIO);
-                    clean_scale_format |= CLEAN_SCALE;
-                    goto fail;
-                } else if (retval > 0) {
-                    ret = ni_bgr_process(ctx, &ai_ctx->api_dst_pkt);
-                    if (ret != 0) {
-                        av_log(ctx, AV_LOG_ERROR,
-                                "failed to process tensor\n");
-                        clean_scale_format |= CLEAN_SCALE;
-                        goto fail;
-                    }
-                }
-                ni_usleep(100); //this loop should be in libxcoder side ideally
-            } while (retval == 0);
-            ni_hwframe_buffer_recycle(downscale_bgr_surface,
-                                        downscale_bgr_surface->device_handle);
-        } else { // use the last frame background shape if current frame is skipped
-            ret = ni_bgr_process(ctx, &ai_ctx->api_dst_pkt);
-            if (ret != 0) {
-                av_log(ctx, AV_LOG_ERROR, "failed to process tensor\n");
-                goto fail;
-            }
-        }
+#endif
 
+        s->initialized = 1;
     }
 
-    //output AVframe created
-    ni_bgr_create_output(ctx, in, &realout);
-
-#ifdef NI_MEASURE_LATENCY
-    ff_ni_update_benchmark("ni_quadra_bgr");
-#endif
-
-    //Logging for hwframe tracking
-    logging_surface = (niFrameSurface1_t*)in->data[3];
-    logging_surface_out = (niFrameSurface1_t*)realout->data[3];
-    av_log(link->dst, AV_LOG_DEBUG,
-        "vf_bgr_ni.c:IN trace ui16FrameIdx = [%d] --> out [%d]\n",
-        logging_surface->ui16FrameIdx, logging_surface_out->ui16FrameIdx);
+    ret = bgr_submit(ctx, in);
+    if (ret < 0)
+        return ret;
 
-    av_frame_free(&in);
-    return ff_filter_frame(ctx->outputs[0], realout);
+    /* with depth 1 this completes the frame just submitted */
+    while (ff_ni_ai_pipe_full(&s->pipe)) {
+        ret = bgr_complete(ctx, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
 fail:
     av_frame_free(&in);
-    if (clean_scale_format & CLEAN_SCALE) {
-        ni_hwframe_buffer_recycle(downscale_bgr_surface,
-                                  downscale_bgr_surface->device_handle);
-    }
-    if (clean_scale_format & CLEAN_FORMAT) {
-        ni_hwframe_buffer_recycle(rgba_frame_surface,
-                                  rgba_frame_surface->device_handle);
-    }
     return ret;
 }
 
@@ -1244,10 +1278,17 @@ static int activate(AVFilterContext *ctx)
     AVHWFramesContext *hwfc;
     AVNIFramesContext *f_hwctx;
     int ret = 0;
+    int status;
+    int64_t pts;
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    /* send out the frames whose result is already there */
+    ret = ff_ni_ai_pipe_complete_ready(ctx, &s->pipe, bgr_complete);
+    if (ret < 0)
+        return ret;
+
     if (ff_inlink_check_available_frame(inlink)) {
         if (s->initialized) {
             hwfc = (AVHWFramesContext *) s->hw_frames_ctx->data;
@@ -1276,7 +1317,16 @@ static int activate(AVFilterContext *ctx)
     }
 
     // We did not get a frame from input link, check its status
-    FF_FILTER_FORWARD_STATUS(inlink, outlink);
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        // Complete the frames still in flight before forwarding EOF
+        while (s->pipe.count) {
+            ret = bgr_complete(ctx, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
 
     // We have no frames yet from input link and no EOF, so request some.
     FF_FILTER_FORWARD_WANTED(outlink, inlink);
@@ -1290,6 +1340,7 @@ static int activate(AVFilterContext *ctx)
 static const AVOption ni_bgr_options[] = {
     { "nb",   "path to network binary file",      OFFSET(nb_file), AV_OPT_TYPE_STRING, .flags = FLAGS},
     { "skip", "frames to skip between inference", OFFSET(skip),    AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    NI_AI_PIPE_OPTION_DEPTH,
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
     { NULL },
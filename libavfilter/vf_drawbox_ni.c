@@ -307,6 +307,8 @@ static int init_out_pool(AVFilterContext *ctx)
 #if IS_FFMPEG_61_AND_ABOVE
     s->buffer_limit = 1;
 #endif
+    ((AVNIFramesContext *)out_frames_ctx->hwctx)->pool_size = pool_size;
+
     /* Create frame pool on device */
     return ff_ni_build_frame_pool(&s->api_ctx, out_frames_ctx->width,
                                   out_frames_ctx->height, s->out_format,
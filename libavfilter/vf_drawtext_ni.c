@@ -53,7 +53,6 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
-#include "libavutil/tree.h"
 #include "libavutil/lfg.h"
 #include "libavutil/version.h"
 #include "nifilter.h"
@@ -153,6 +152,114 @@ enum expansion_mode {
     EXP_STRFTIME,
 };
 
+typedef struct Glyph {
+    FT_Glyph glyph;        ///< NULL once bitmap is packed into the atlas
+    FT_Glyph border_glyph; ///< NULL once border_bitmap is packed into the atlas
+    uint32_t code;
+    unsigned int fontsize;
+    FT_Bitmap bitmap; ///< array holding bitmaps of font
+    FT_Bitmap border_bitmap; ///< array holding bitmaps of font border
+    FT_BBox bbox;
+    int advance;
+    int bitmap_left;
+    int bitmap_top;
+} Glyph;
+
+/* inputs an expansion depends on */
+enum expansion_dep {
+    EXP_DEP_N         = 1 << 0,     ///< frame number
+    EXP_DEP_T         = 1 << 1,     ///< timestamp
+    EXP_DEP_PICT_TYPE = 1 << 2,
+    EXP_DEP_CLOCK     = 1 << 3,     ///< wall clock or strftime time, in seconds
+    EXP_DEP_METADATA  = 1 << 4,     ///< frame metadata
+    EXP_DEP_VARS      = 1 << 5,     ///< any expression variable
+    EXP_DEP_ALWAYS    = 1 << 6,     ///< random, never the same twice
+};
+
+/**
+ * What a text expanded to, with the inputs it was expanded from, so that
+ * it is only expanded again when one of them changes.
+ */
+typedef struct TextExpansion {
+    char *str;
+    unsigned int size;
+    unsigned int len;
+    int valid;
+    unsigned int deps;              ///< EXP_DEP_* flags
+    double var_values[VAR_VARS_NB];
+    time_t clock;
+    unsigned int metadata_serial;
+} TextExpansion;
+
+#define GLYPH_ATLAS_PAGE_SIZE (64 * 1024)
+
+/**
+ * Rendered glyphs, found in a hash table keyed by code and font size, with
+ * their bitmaps packed next to each other in pages.
+ */
+typedef struct GlyphAtlas {
+    Glyph **slots;                  ///< open addressing, nb_slots is a power of 2
+    unsigned int nb_slots;
+    unsigned int nb_glyphs;
+    uint8_t **pages;
+    unsigned int nb_pages;
+    size_t page_used;               ///< bytes used in the last page
+} GlyphAtlas;
+
+/**
+ * A rectangle on the canvas, x0/y0 inclusive and x1/y1 exclusive; empty if
+ * x0 >= x1 or y0 >= y1.
+ */
+typedef struct TextRect {
+    int x0, y0, x1, y1;
+} TextRect;
+
+/**
+ * Everything that decides what a text puts on the canvas. A text is only
+ * drawn again when this changes.
+ */
+typedef struct TextRunDraw {
+    unsigned int layout_serial;
+    int x, y;
+    int bb_top, bb_right, bb_bottom, bb_left;
+    uint8_t fontcolor[4];
+    uint8_t shadowcolor[4];
+    uint8_t bordercolor[4];
+    uint8_t boxcolor[4];
+    TextRect rect;                  ///< pixels the text may touch
+} TextRunDraw;
+
+/**
+ * Layout of one text, kept as long as the text it was computed from and the
+ * state carried over from the texts before it do not change.
+ */
+typedef struct TextRun {
+    char *text;                     ///< expanded text the layout is for
+    unsigned int text_size;
+    unsigned int fontsize;
+    int in_extents[4];              ///< glyph x_min, x_max, y_min, y_max so far
+    uint32_t in_prev_code;
+    unsigned int layout_serial;     ///< 0 if not laid out
+
+    Glyph **glyphs;                 ///< glyph of each character, NULL if not drawn
+    FT_Vector *positions;           ///< position of each character
+    unsigned int nb_chars;
+    unsigned int chars_size;
+    int out_extents[4];
+    uint32_t out_prev_code;
+    int text_w, text_h;
+    TextRect ink;                   ///< glyph bitmaps, relative to the text position
+    TextRect border_ink;            ///< border bitmaps, relative to the text position
+
+    FFDrawColor fontcolor;          ///< colors of the current frame, with alpha
+    FFDrawColor shadowcolor;
+    FFDrawColor bordercolor;
+    FFDrawColor boxcolor;
+    TextRunDraw next;               ///< what the current frame needs on the canvas
+    int drawn;                      ///< draw holds what is on the canvas
+    TextRunDraw draw;
+} TextRun;
+
 typedef struct NetIntDrawTextContext {
     const AVClass *class;
     int exp_mode;                   ///< expansion mode to use for the text
@@ -168,8 +275,6 @@ typedef struct NetIntDrawTextContext {
     uint8_t *fontcolor_expr[MAX_TEXT_NUM];        ///< fontcolor expression to evaluate
     AVBPrint expanded_fontcolor;    ///< used to contain the expanded fontcolor spec
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
-    FT_Vector *positions;           ///< positions for each element in the text
-    size_t nb_positions;            ///< number of elements of positions array
     char *textfile;                 ///< file with text to be drawn
     int x[MAX_TEXT_NUM];            ///< x position to start drawing one text
     int y[MAX_TEXT_NUM];            ///< y position to start drawing one text
@@ -209,7 +314,9 @@ typedef struct NetIntDrawTextContext {
     FT_Library library;             ///< freetype font library handle
     FT_Face face[MAX_TEXT_NUM];     ///< freetype font face handle
     FT_Stroker stroker;             ///< freetype stroker handle
-    struct AVTreeNode *glyphs;      ///< rendered glyphs, stored using the UTF-32 char code
+    GlyphAtlas glyphs;              ///< rendered glyphs of all texts
+    TextRun runs[MAX_TEXT_NUM];
+    unsigned int layout_serial;
     char *x_expr[MAX_TEXT_NUM];     ///< expression for x position
     char *y_expr[MAX_TEXT_NUM];     ///< expression for y position
     AVExpr *x_pexpr[MAX_TEXT_NUM];  //< parsed expressions for x
@@ -279,6 +386,33 @@ typedef struct NetIntDrawTextContext {
     int framerate;
     int initiated_upload_width;
     int initiated_upload_height;
+
+    // drawing is limited to what changed since the previous frame
+    int canvas_valid;               ///< dl_frame holds the texts as in runs[]
+    int canvas_w, canvas_h;
+    TextRect dirty;                 ///< area of dl_frame drawn for this frame
+    uint8_t *txt_buf;               ///< txt_frame buffer holding txt_x/txt_y
+    int txt_x, txt_y;
+    unsigned int canvas_serial;     ///< changes when the uploaded image does
+    unsigned int uploaded_serial;
+    unsigned int nb_drawn;
+    unsigned int nb_draw_skipped;
+    unsigned int nb_uploads;
+    unsigned int nb_uploads_skipped;
+
+    // texts are only expanded again when their inputs change
+    TextExpansion expansions[MAX_TEXT_NUM];
+    TextExpansion fontcolor_expansions[MAX_TEXT_NUM];
+    unsigned int expansion_deps;    ///< EXP_DEP_* of the expansion in progress
+    unsigned int deps_seen;         ///< EXP_DEP_* of all expansions so far
+    AVDictionary *prev_metadata;
+    unsigned int metadata_serial;   ///< changes when the frame metadata does
+    char *loaded_text;              ///< text file content before shaping
+    size_t loaded_text_size;
+    unsigned int nb_expanded;
+    unsigned int nb_expansions_reused;
+    unsigned int nb_reloads;
+    unsigned int nb_reloads_unchanged;
 } NetIntDrawTextContext;
 
 static const enum AVPixelFormat alpha_pix_fmts[] = {
@@ -690,28 +824,111 @@ static const struct ft_error {
 
 #define FT_ERRMSG(e) ft_errors[e].err_msg
 
-typedef struct Glyph {
-    FT_Glyph glyph;
-    FT_Glyph border_glyph;
-    uint32_t code;
-    unsigned int fontsize;
-    FT_Bitmap bitmap; ///< array holding bitmaps of font
-    FT_Bitmap border_bitmap; ///< array holding bitmaps of font border
-    FT_BBox bbox;
-    int advance;
-    int bitmap_left;
-    int bitmap_top;
-} Glyph;
+static unsigned int glyph_hash(uint32_t code, unsigned int fontsize)
+{
+    return code * 0x9E3779B1U ^ fontsize * 0x85EBCA77U;
+}
 
-static int glyph_cmp(const void *key, const void *b)
+static Glyph *glyph_atlas_find(const GlyphAtlas *a, uint32_t code,
+                               unsigned int fontsize)
 {
-    const Glyph *a = key, *bb = b;
-    int64_t diff = (int64_t)a->code - (int64_t)bb->code;
+    unsigned int mask = a->nb_slots - 1, i;
+
+    if (!a->nb_slots)
+        return NULL;
+    for (i = glyph_hash(code, fontsize) & mask; a->slots[i]; i = (i + 1) & mask)
+        if (a->slots[i]->code == code && a->slots[i]->fontsize == fontsize)
+            return a->slots[i];
+    return NULL;
+}
 
-    if (diff != 0)
-        return diff > 0 ? 1 : -1;
-    else
-        return FFDIFFSIGN((int64_t)a->fontsize, (int64_t)bb->fontsize);
+static void glyph_atlas_place(Glyph **slots, unsigned int nb_slots, Glyph *glyph)
+{
+    unsigned int mask = nb_slots - 1, i;
+
+    for (i = glyph_hash(glyph->code, glyph->fontsize) & mask; slots[i];
+         i = (i + 1) & mask);
+    slots[i] = glyph;
+}
+
+static int glyph_atlas_insert(GlyphAtlas *a, Glyph *glyph)
+{
+    /* keep the table at most half full */
+    if (2 * (a->nb_glyphs + 1) > a->nb_slots) {
+        unsigned int nb_slots = a->nb_slots ? 2 * a->nb_slots : 256;
+        Glyph **slots = av_calloc(nb_slots, sizeof(*slots));
+
+        if (!slots)
+            return AVERROR(ENOMEM);
+        for (unsigned int i = 0; i < a->nb_slots; i++)
+            if (a->slots[i])
+                glyph_atlas_place(slots, nb_slots, a->slots[i]);
+        av_free(a->slots);
+        a->slots    = slots;
+        a->nb_slots = nb_slots;
+    }
+    glyph_atlas_place(a->slots, a->nb_slots, glyph);
+    a->nb_glyphs++;
+    return 0;
+}
+
+/**
+ * Move a glyph bitmap into the atlas pages, so that the bitmaps of a text
+ * are close to each other when it is drawn.
+ *
+ * @return 1 if the bitmap no longer points into the FreeType glyph, which can
+ *         then be freed, 0 if it does not fit and is left where FreeType put it
+ */
+static int glyph_atlas_pack(GlyphAtlas *a, FT_Bitmap *bitmap)
+{
+    size_t size = (size_t)bitmap->rows * bitmap->pitch;
+    size_t aligned = FFALIGN(size, 16);
+    uint8_t *dst;
+
+    if (bitmap->pitch < 0 || aligned > GLYPH_ATLAS_PAGE_SIZE)
+        return 0;
+    if (!size) {
+        bitmap->buffer = NULL;
+        return 1;
+    }
+
+    if (!a->nb_pages || a->page_used + aligned > GLYPH_ATLAS_PAGE_SIZE) {
+        uint8_t **pages = av_realloc_array(a->pages, a->nb_pages + 1,
+                                           sizeof(*pages));
+        if (!pages)
+            return 0;
+        a->pages = pages;
+        if (!(pages[a->nb_pages] = av_malloc(GLYPH_ATLAS_PAGE_SIZE)))
+            return 0;
+        a->nb_pages++;
+        a->page_used = 0;
+    }
+
+    dst = a->pages[a->nb_pages - 1] + a->page_used;
+    memcpy(dst, bitmap->buffer, size);
+    bitmap->buffer = dst;
+    a->page_used  += aligned;
+    return 1;
+}
+
+static void glyph_free(Glyph *glyph)
+{
+    FT_Done_Glyph(glyph->glyph);
+    FT_Done_Glyph(glyph->border_glyph);
+    av_free(glyph);
+}
+
+static void glyph_atlas_free(GlyphAtlas *a)
+{
+    for (unsigned int i = 0; i < a->nb_slots; i++)
+        if (a->slots[i])
+            glyph_free(a->slots[i]);
+    for (unsigned int i = 0; i < a->nb_pages; i++)
+        av_free(a->pages[i]);
+    av_freep(&a->slots);
+    av_freep(&a->pages);
+    a->nb_slots = a->nb_glyphs = a->nb_pages = 0;
+    a->page_used = 0;
 }
 
 /**
@@ -721,29 +938,24 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code, in
 {
     NetIntDrawTextContext *s = ctx->priv;
     FT_BitmapGlyph bitmapglyph;
-    Glyph *glyph, dummy = { 0 };
-    struct AVTreeNode *node = NULL;
+    Glyph *glyph;
     int ret;
 
-    /* load glyph into s->face->glyph */
-    if (FT_Load_Char(s->face[index], code, s->ft_load_flags))
-        return AVERROR(EINVAL);
-
-    /* if glyph has already insert into s->glyphs, return directly */
-    dummy.code = code;
-    dummy.fontsize = s->fontsize[index];
-    glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+    /* if glyph has already been rendered, return directly */
+    glyph = glyph_atlas_find(&s->glyphs, code, s->fontsize[index]);
     if (glyph) {
         if (glyph_ptr)
             *glyph_ptr = glyph;
         return 0;
     }
 
+    /* load glyph into s->face->glyph */
+    if (FT_Load_Char(s->face[index], code, s->ft_load_flags))
+        return AVERROR(EINVAL);
+
     glyph = av_mallocz(sizeof(*glyph));
-    if (!glyph) {
-        ret = AVERROR(ENOMEM);
-        goto error;
-    }
+    if (!glyph)
+        return AVERROR(ENOMEM);
     glyph->code  = code;
     glyph->fontsize = s->fontsize[index];
 
@@ -776,22 +988,24 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code, in
     FT_Glyph_Get_CBox(glyph->glyph, ft_glyph_bbox_pixels, &glyph->bbox);
 
     /* cache the newly created glyph */
-    if (!(node = av_tree_node_alloc())) {
-        ret = AVERROR(ENOMEM);
+    if ((ret = glyph_atlas_insert(&s->glyphs, glyph)) < 0)
         goto error;
+    /* only the metrics and the packed bitmaps are needed from now on */
+    if (glyph_atlas_pack(&s->glyphs, &glyph->bitmap)) {
+        FT_Done_Glyph(glyph->glyph);
+        glyph->glyph = NULL;
+    }
+    if (s->borderw && glyph_atlas_pack(&s->glyphs, &glyph->border_bitmap)) {
+        FT_Done_Glyph(glyph->border_glyph);
+        glyph->border_glyph = NULL;
     }
-    av_tree_insert(&s->glyphs, glyph, glyph_cmp, &node);
 
     if (glyph_ptr)
         *glyph_ptr = glyph;
     return 0;
 
 error:
-    if (glyph)
-        av_freep(&glyph->glyph);
-
-    av_freep(&glyph);
-    av_freep(&node);
+    glyph_free(glyph);
     return ret;
 }
 
@@ -1069,6 +1283,13 @@ static int load_textfile(AVFilterContext *ctx)
         return err;
     }
 
+    /* the text, and its shaping, are still those of the same content */
+    if (s->loaded_text && s->loaded_text_size == textbuf_size &&
+        !memcmp(s->loaded_text, textbuf, textbuf_size)) {
+        av_file_unmap(textbuf, textbuf_size);
+        return 1;
+    }
+
     if (textbuf_size > SIZE_MAX - 1 || !(tmp = av_realloc(s->text[0], textbuf_size + 1))) {
         av_file_unmap(textbuf, textbuf_size);
         return AVERROR(ENOMEM);
@@ -1076,6 +1297,12 @@ static int load_textfile(AVFilterContext *ctx)
     s->text[0] = tmp;
     memcpy(s->text[0], textbuf, textbuf_size);
     s->text[0][textbuf_size] = 0;
+
+    av_freep(&s->loaded_text);
+    s->loaded_text_size = 0;
+    if ((s->loaded_text = av_memdup(textbuf, textbuf_size)))
+        s->loaded_text_size = textbuf_size;
+    s->expansions[0].valid = 0;
     av_file_unmap(textbuf, textbuf_size);
 
     return 0;
@@ -1277,16 +1504,6 @@ static int config_output(AVFilterLink *outlink, AVFrame *in)
     return 0;
 }
 
-static int glyph_enu_free(void *opaque, void *elem)
-{
-    Glyph *glyph = elem;
-
-    FT_Done_Glyph(glyph->glyph);
-    FT_Done_Glyph(glyph->border_glyph);
-    av_free(elem);
-    return 0;
-}
-
 
 static av_cold int init(AVFilterContext *ctx)
 {
@@ -1414,6 +1631,18 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     NetIntDrawTextContext *s = ctx->priv;
     int i;
+
+    if (s->nb_drawn || s->nb_draw_skipped)
+        av_log(ctx, AV_LOG_VERBOSE, "Texts drawn %u, unchanged %u; "
+               "overlay uploads %u, skipped %u\n", s->nb_drawn,
+               s->nb_draw_skipped, s->nb_uploads, s->nb_uploads_skipped);
+    if (s->nb_expanded || s->nb_expansions_reused)
+        av_log(ctx, AV_LOG_VERBOSE, "Text expansions %u, reused %u (%.1f%%); "
+               "text file reloads %u, unchanged %u\n", s->nb_expanded,
+               s->nb_expansions_reused, 100.0 * s->nb_expansions_reused /
+               (s->nb_expanded + s->nb_expansions_reused),
+               s->nb_reloads, s->nb_reloads_unchanged);
+
     // NI HW frame related uninit
     av_frame_free(&s->keep_overlay);
     ni_frame_buffer_free(&s->dl_frame.data.frame);
@@ -1456,12 +1685,15 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_expr_free(s->a_pexpr);
     s->a_pexpr = NULL;
 
-    av_freep(&s->positions);
-    s->nb_positions = 0;
+    for (i = 0; i < MAX_TEXT_NUM; i++) {
+        av_freep(&s->expansions[i].str);
+        av_freep(&s->fontcolor_expansions[i].str);
+        av_freep(&s->runs[i].text);
+        av_freep(&s->runs[i].glyphs);
+        av_freep(&s->runs[i].positions);
+    }
 
-    av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
-    av_tree_destroy(s->glyphs);
-    s->glyphs = NULL;
+    glyph_atlas_free(&s->glyphs);
 
     for (i = 0; i < s->text_num; i++) {
         FT_Done_Face(s->face[i]);
@@ -1471,6 +1703,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_bprint_finalize(&s->expanded_text, NULL);
     av_bprint_finalize(&s->expanded_fontcolor, NULL);
+    av_dict_free(&s->prev_metadata);
+    av_freep(&s->loaded_text);
 }
 
 #if IS_FFMPEG_342_AND_ABOVE
@@ -1600,6 +1834,7 @@ static int config_input(AVFilterLink *inlink, AVFrame *in)
                                  inlink->w, inlink->h, NI_PIX_FMT_RGBA)) {
         return AVERROR(ENOMEM);
     }
+    s->canvas_valid = 0;
     s->up_frame = av_frame_alloc();
 
     return 0;
@@ -1854,23 +2089,25 @@ static const struct drawtext_function {
     unsigned argc_min, argc_max;
     int tag;                            /**< opaque argument to func */
     int (*func)(AVFilterContext *, AVBPrint *, char *, unsigned, char **, int);
+    unsigned deps;                      /**< EXP_DEP_* the result depends on */
 } functions[] = {
-    { "expr",      1, 1, 0,   func_eval_expr },
-    { "e",         1, 1, 0,   func_eval_expr },
-    { "expr_int_format", 2, 3, 0, func_eval_expr_int_format },
-    { "eif",       2, 3, 0,   func_eval_expr_int_format },
-    { "pict_type", 0, 0, 0,   func_pict_type },
-    { "pts",       0, 3, 0,   func_pts      },
-    { "gmtime",    0, 1, 'G', func_strftime },
-    { "localtime", 0, 1, 'L', func_strftime },
-    { "frame_num", 0, 0, 0,   func_frame_num },
-    { "n",         0, 0, 0,   func_frame_num },
-    { "metadata",  1, 2, 0,   func_metadata },
+    { "expr",      1, 1, 0,   func_eval_expr, EXP_DEP_VARS },
+    { "e",         1, 1, 0,   func_eval_expr, EXP_DEP_VARS },
+    { "expr_int_format", 2, 3, 0, func_eval_expr_int_format, EXP_DEP_VARS },
+    { "eif",       2, 3, 0,   func_eval_expr_int_format, EXP_DEP_VARS },
+    { "pict_type", 0, 0, 0,   func_pict_type, EXP_DEP_PICT_TYPE },
+    { "pts",       0, 3, 0,   func_pts,       EXP_DEP_T },
+    { "gmtime",    0, 1, 'G', func_strftime,  EXP_DEP_CLOCK },
+    { "localtime", 0, 1, 'L', func_strftime,  EXP_DEP_CLOCK },
+    { "frame_num", 0, 0, 0,   func_frame_num, EXP_DEP_N },
+    { "n",         0, 0, 0,   func_frame_num, EXP_DEP_N },
+    { "metadata",  1, 2, 0,   func_metadata,  EXP_DEP_METADATA },
 };
 
 static int eval_function(AVFilterContext *ctx, AVBPrint *bp, char *fct,
                          unsigned argc, char **argv)
 {
+    NetIntDrawTextContext *s = ctx->priv;
     unsigned i;
 
     for (i = 0; i < FF_ARRAY_ELEMS(functions); i++) {
@@ -1892,6 +2129,12 @@ static int eval_function(AVFilterContext *ctx, AVBPrint *bp, char *fct,
         av_log(ctx, AV_LOG_ERROR, "%%{%s} is not known\n", fct);
         return AVERROR(EINVAL);
     }
+
+    s->expansion_deps |= functions[i].deps;
+    /* rand() draws from the filter PRNG */
+    if (functions[i].deps & EXP_DEP_VARS && strstr(argv[0], "rand"))
+        s->expansion_deps |= EXP_DEP_ALWAYS;
+
     return functions[i].func(ctx, bp, fct, argc, argv, functions[i].tag);
 }
 
@@ -1958,54 +2201,145 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(NetIntDrawTextContext *s, ni_frame_t *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw, int index)
+static void update_metadata_serial(NetIntDrawTextContext *s)
 {
-    char *text = s->expanded_text.str;
-    uint32_t code = 0;
-    int i, x1, y1;
-    uint8_t *p;
-    Glyph *glyph = NULL;
-    int dst_linesize[NI_MAX_NUM_DATA_POINTERS] = {0};
+    const AVDictionaryEntry *e = NULL, *prev = NULL;
 
-    dst_linesize[0] = frame->data_len[0] / height;
-    dst_linesize[1] = dst_linesize[2] = frame->data_len[1] / (height / 2);
+    do {
+        e    = av_dict_get(s->metadata,      "", e,    AV_DICT_IGNORE_SUFFIX);
+        prev = av_dict_get(s->prev_metadata, "", prev, AV_DICT_IGNORE_SUFFIX);
+        if (!e != !prev ||
+            (e && (strcmp(e->key, prev->key) || strcmp(e->value, prev->value))))
+            break;
+    } while (e);
+    if (!e && !prev)
+        return;
 
-    for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
-#if IS_FFMPEG_43_AND_ABOVE
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
-continue_on_invalid:
-#else
-        GET_UTF8(code, *p++, continue;);
-#endif
+    av_dict_free(&s->prev_metadata);
+    av_dict_copy(&s->prev_metadata, s->metadata, 0);
+    s->metadata_serial++;
+}
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
-            continue;
+static int expansion_is_current(const NetIntDrawTextContext *s,
+                                const TextExpansion *e, time_t clock)
+{
+    static const struct {
+        unsigned int dep;
+        int var;
+    } var_deps[] = {
+        { EXP_DEP_N,         VAR_N         },
+        { EXP_DEP_T,         VAR_T         },
+        { EXP_DEP_PICT_TYPE, VAR_PICT_TYPE },
+    };
+
+    if (!e->valid || e->deps & EXP_DEP_ALWAYS)
+        return 0;
+    if (e->deps & EXP_DEP_VARS) {
+        if (memcmp(e->var_values, s->var_values, sizeof(e->var_values)))
+            return 0;
+    } else {
+        /* compared bitwise, so that NAN timestamps match */
+        for (int i = 0; i < FF_ARRAY_ELEMS(var_deps); i++)
+            if (e->deps & var_deps[i].dep &&
+                memcmp(&e->var_values[var_deps[i].var],
+                       &s->var_values[var_deps[i].var], sizeof(double)))
+                return 0;
+    }
+    if (e->deps & EXP_DEP_CLOCK && e->clock != clock)
+        return 0;
+    if (e->deps & EXP_DEP_METADATA && e->metadata_serial != s->metadata_serial)
+        return 0;
+    return 1;
+}
+
+/**
+ * Expand text into bp the way exp_mode says, or put there what it expanded
+ * to the last time if none of the inputs it depends on changed since.
+ *
+ * @param now time for EXP_STRFTIME
+ * @return 1 if the previous expansion was reused, 0 if the text was
+ *         expanded, a negative error code on failure
+ */
+static int expand_text_cached(AVFilterContext *ctx, TextExpansion *e,
+                              char *text, AVBPrint *bp, int exp_mode,
+                              time_t now, time_t wallclock)
+{
+    NetIntDrawTextContext *s = ctx->priv;
+    time_t clock = exp_mode == EXP_STRFTIME ? now : wallclock;
+    struct tm ltime;
+    unsigned int start;
+    int ret;
 
-        dummy.code = code;
-        dummy.fontsize = s->fontsize[index];
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+    /* expand_text() starts over, the other modes append */
+    if (exp_mode == EXP_NORMAL)
+        av_bprint_clear(bp);
+    start = bp->len;
 
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+    if (expansion_is_current(s, e, clock)) {
+        av_bprint_append_data(bp, e->str, e->len);
+        s->nb_expansions_reused++;
+        return av_bprint_is_complete(bp) ? 1 : AVERROR(ENOMEM);
+    }
+
+    e->valid = 0;
+    s->expansion_deps = 0;
+    switch (exp_mode) {
+    case EXP_NONE:
+        av_bprintf(bp, "%s", text);
+        break;
+    case EXP_NORMAL:
+        if ((ret = expand_text(ctx, text, bp)) < 0)
+            return ret;
+        break;
+    case EXP_STRFTIME:
+        localtime_r(&now, &ltime);
+        av_bprint_strftime(bp, text, &ltime);
+        s->expansion_deps = EXP_DEP_CLOCK;
+        break;
+    }
+    s->nb_expanded++;
+
+    if (!av_bprint_is_complete(bp))
+        return AVERROR(ENOMEM);
+    av_fast_malloc(&e->str, &e->size, bp->len - start + 1);
+    if (!e->str)
+        return AVERROR(ENOMEM);
+    e->len = bp->len - start;
+    memcpy(e->str, bp->str + start, e->len);
+    e->deps = s->expansion_deps;
+    memcpy(e->var_values, s->var_values, sizeof(e->var_values));
+    e->clock = clock;
+    e->metadata_serial = s->metadata_serial;
+    e->valid = 1;
+    s->deps_seen |= e->deps;
+
+    return 0;
+}
+
+static int draw_glyphs(NetIntDrawTextContext *s, const TextRun *run,
+                       uint8_t *data[], int linesize[], int width, int height,
+                       FFDrawColor *color, int x, int y, int borderw)
+{
+    for (unsigned int i = 0; i < run->nb_chars; i++) {
+        const Glyph *glyph = run->glyphs[i];
+        const FT_Bitmap *bitmap;
+
+        /* new line and tab chars are not drawn */
+        if (!glyph)
+            continue;
+
+        bitmap = borderw ? &glyph->border_bitmap : &glyph->bitmap;
 
         if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
-        x1 = s->positions[i].x + s->x[index] + x - borderw;
-        y1 = s->positions[i].y + s->y[index] + y - borderw;
-
-        ff_blend_mask(&s->dc, color,
-                      frame->p_data, dst_linesize, width, height,
-                      bitmap.buffer, bitmap.pitch,
-                      bitmap.width, bitmap.rows,
-                      bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
-                      0, x1, y1);
+        ff_blend_mask(&s->dc, color, data, linesize, width, height,
+                      bitmap->buffer, bitmap->pitch,
+                      bitmap->width, bitmap->rows,
+                      bitmap->pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
+                      0, run->positions[i].x + x - borderw,
+                      run->positions[i].y + y - borderw);
     }
 
     return 0;
@@ -2153,37 +2487,299 @@ static void check_and_expand_canvas_size(NetIntDrawTextContext *s, int min_filte
     }
 }
 
+static void rect_union(TextRect *r, int x0, int y0, int x1, int y1)
+{
+    if (x0 >= x1 || y0 >= y1)
+        return;
+    if (r->x0 >= r->x1 || r->y0 >= r->y1) {
+        r->x0 = x0;
+        r->y0 = y0;
+        r->x1 = x1;
+        r->y1 = y1;
+        return;
+    }
+    r->x0 = FFMIN(r->x0, x0);
+    r->y0 = FFMIN(r->y0, y0);
+    r->x1 = FFMAX(r->x1, x1);
+    r->y1 = FFMAX(r->y1, y1);
+}
+
+static void rect_add(TextRect *r, const TextRect *a, int dx, int dy)
+{
+    rect_union(r, a->x0 + dx, a->y0 + dy, a->x1 + dx, a->y1 + dy);
+}
+
+static void rect_clip(TextRect *r, int width, int height)
+{
+    r->x0 = FFMAX(r->x0, 0);
+    r->y0 = FFMAX(r->y0, 0);
+    r->x1 = FFMIN(r->x1, width);
+    r->y1 = FFMIN(r->y1, height);
+    if (r->x0 >= r->x1 || r->y0 >= r->y1)
+        memset(r, 0, sizeof(*r));
+}
+
+static int rect_intersects(const TextRect *a, const TextRect *b)
+{
+    return FFMAX(a->x0, b->x0) < FFMIN(a->x1, b->x1) &&
+           FFMAX(a->y0, b->y0) < FFMIN(a->y1, b->y1);
+}
+
+/**
+ * Compute the position of each glyph of the expanded text, unless it was
+ * already done for the same text and the same state left by the texts
+ * before it.
+ *
+ * @param extents   x_min, x_max, y_min, y_max of the glyphs so far, updated
+ * @param prev_code last char code so far, updated
+ */
+static int layout_text_run(AVFilterContext *ctx, TextRun *run, int index,
+                           int extents[4], uint32_t *prev_code)
+{
+    NetIntDrawTextContext *s = ctx->priv;
+    char *text = s->expanded_text.str;
+    unsigned int len = s->expanded_text.len;
+    uint32_t code = 0;
+    int x = 0, y = 0, j, ret;
+    int max_text_line_w = 0, max_glyph_h;
+    uint8_t *p;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
+
+    if (run->layout_serial && run->fontsize == s->fontsize[index] &&
+        run->in_prev_code == *prev_code &&
+        !memcmp(run->in_extents, extents, sizeof(run->in_extents)) &&
+        !strcmp(run->text, text)) {
+        memcpy(extents, run->out_extents, sizeof(run->out_extents));
+        *prev_code = run->out_prev_code;
+        return 0;
+    }
+
+    run->layout_serial = 0;
+    av_fast_malloc(&run->text, &run->text_size, len + 1);
+    if (!run->text)
+        return AVERROR(ENOMEM);
+    if (len > run->chars_size) {
+        av_freep(&run->glyphs);
+        av_freep(&run->positions);
+        run->chars_size = 0;
+        run->glyphs    = av_malloc_array(len, sizeof(*run->glyphs));
+        run->positions = av_malloc_array(len, sizeof(*run->positions));
+        if (!run->glyphs || !run->positions)
+            return AVERROR(ENOMEM);
+        run->chars_size = len;
+    }
+    memcpy(run->text, text, len + 1);
+    memcpy(run->in_extents, extents, sizeof(run->in_extents));
+    run->in_prev_code = *prev_code;
+    run->fontsize     = s->fontsize[index];
+
+    /* load and cache glyphs */
+    for (j = 0, p = text; *p; j++) {
+#if IS_FFMPEG_43_AND_ABOVE
+        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
+continue_on_invalid:
+#else
+        GET_UTF8(code, *p++, continue;);
+#endif
+
+        if ((ret = load_glyph(ctx, &glyph, code, index)) < 0)
+            return ret;
+
+        extents[0] = FFMIN(glyph->bbox.xMin, extents[0]);
+        extents[1] = FFMAX(glyph->bbox.xMax, extents[1]);
+        extents[2] = FFMIN(glyph->bbox.yMin, extents[2]);
+        extents[3] = FFMAX(glyph->bbox.yMax, extents[3]);
+    }
+    max_glyph_h = extents[3] - extents[2];
+
+    /* compute and save position for each glyph */
+    glyph = NULL;
+    for (j = 0, p = text; *p; j++) {
+#if IS_FFMPEG_43_AND_ABOVE
+        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
+continue_on_invalid2:
+#else
+        GET_UTF8(code, *p++, continue;);
+#endif
+
+        run->glyphs[j] = NULL;
+
+        /* skip the \n in the sequence \r\n */
+        if (*prev_code == '\r' && code == '\n')
+            continue;
+
+        *prev_code = code;
+        if (is_newline(code)) {
+            max_text_line_w = FFMAX(max_text_line_w, x);
+            y += max_glyph_h + s->line_spacing;
+            x = 0;
+            continue;
+        }
+
+        /* get glyph */
+        prev_glyph = glyph;
+        glyph = glyph_atlas_find(&s->glyphs, code, s->fontsize[index]);
+
+        /* kerning */
+        if (s->use_kerning[index] && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face[index], prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
+
+        /* save position */
+        run->positions[j].x = x + glyph->bitmap_left;
+        run->positions[j].y = y - glyph->bitmap_top + extents[3];
+        if (code == '\t') {
+            x  = (x / s->tabsize[index] + 1)*s->tabsize[index];
+        } else {
+            x += glyph->advance;
+            run->glyphs[j] = glyph;
+        }
+    }
+    run->nb_chars = j;
+
+    run->text_w = FFMAX(x, max_text_line_w);
+    run->text_h = y + max_glyph_h;
+
+    /* pixels covered by the glyph bitmaps */
+    memset(&run->ink, 0, sizeof(run->ink));
+    memset(&run->border_ink, 0, sizeof(run->border_ink));
+    for (j = 0; j < run->nb_chars; j++) {
+        const FT_Vector *pos = &run->positions[j];
+
+        if (!(glyph = run->glyphs[j]))
+            continue;
+        rect_union(&run->ink, pos->x, pos->y,
+                   pos->x + glyph->bitmap.width, pos->y + glyph->bitmap.rows);
+        if (s->borderw)
+            rect_union(&run->border_ink, pos->x - s->borderw, pos->y - s->borderw,
+                       pos->x - s->borderw + glyph->border_bitmap.width,
+                       pos->y - s->borderw + glyph->border_bitmap.rows);
+    }
+
+    memcpy(run->out_extents, extents, sizeof(run->out_extents));
+    run->out_prev_code = *prev_code;
+    run->layout_serial = ++s->layout_serial;
+    return 0;
+}
+
+/**
+ * Draw the texts whose layout, position or colors changed since the previous
+ * frame. The canvas keeps what was drawn before; the area covered by the
+ * changed texts, before and after the change, is cleared and every text
+ * touching it is drawn again, in order, clipped to it.
+ */
+static int redraw_canvas(NetIntDrawTextContext *s, ni_frame_t *frame,
+                         int width, int height)
+{
+    TextRect dirty = { 0 };
+    uint8_t *data[4] = { NULL };
+    int linesize[4] = { 0 };
+    int pixelstep = s->dc.pixelstep[0];
+    int i, w, h, ret;
+
+    linesize[0] = frame->data_len[0] / height;
+
+    if (!s->canvas_valid || s->canvas_w != width || s->canvas_h != height) {
+        memset(frame->p_buffer, 0, frame->buffer_size);
+        for (i = 0; i < MAX_TEXT_NUM; i++)
+            s->runs[i].drawn = 0;
+        rect_union(&dirty, 0, 0, width, height);
+        s->canvas_w = width;
+        s->canvas_h = height;
+    } else {
+        for (i = 0; i < MAX_TEXT_NUM; i++) {
+            TextRun *run = &s->runs[i];
+
+            if (i < s->text_num && run->drawn &&
+                !memcmp(&run->draw, &run->next, sizeof(run->draw)))
+                continue;
+            if (run->drawn)
+                rect_add(&dirty, &run->draw.rect, 0, 0);
+            if (i < s->text_num)
+                rect_add(&dirty, &run->next.rect, 0, 0);
+            run->drawn = 0;
+        }
+    }
+    rect_clip(&dirty, width, height);
+    s->dirty = dirty;
+
+    if (dirty.x0 >= dirty.x1) {
+        s->nb_draw_skipped += s->text_num;
+        return 0;
+    }
+    s->canvas_serial++;
+
+    w = dirty.x1 - dirty.x0;
+    h = dirty.y1 - dirty.y0;
+    data[0] = frame->p_data[0] + dirty.y0 * linesize[0] + dirty.x0 * pixelstep;
+    for (i = 0; i < h; i++)
+        memset(data[0] + i * linesize[0], 0, w * pixelstep);
+
+    /* invalid until all the texts are back on it */
+    s->canvas_valid = 0;
+    for (i = 0; i < s->text_num; i++) {
+        TextRun *run = &s->runs[i];
+        const TextRunDraw *d = &run->next;
+        int x = d->x - dirty.x0;
+        int y = d->y - dirty.y0;
+
+        run->draw  = *d;
+        run->drawn = 1;
+        if (!rect_intersects(&d->rect, &dirty)) {
+            s->nb_draw_skipped++;
+            continue;
+        }
+        s->nb_drawn++;
+
+        /* draw box */
+        if (s->draw_box)
+            ff_blend_rectangle(&s->dc, &run->boxcolor, data, linesize, w, h,
+                               x - d->bb_left, y - d->bb_top,
+                               run->text_w + d->bb_left + d->bb_right,
+                               run->text_h + d->bb_top + d->bb_bottom);
+
+        if (s->shadowx || s->shadowy) {
+            if ((ret = draw_glyphs(s, run, data, linesize, w, h, &run->shadowcolor,
+                                   x + s->shadowx, y + s->shadowy, 0)) < 0)
+                return ret;
+        }
+
+        if (s->borderw) {
+            if ((ret = draw_glyphs(s, run, data, linesize, w, h, &run->bordercolor,
+                                   x, y, s->borderw)) < 0)
+                return ret;
+        }
+        if ((ret = draw_glyphs(s, run, data, linesize, w, h, &run->fontcolor,
+                               x, y, 0)) < 0)
+            return ret;
+    }
+    s->canvas_valid = 1;
+
+    return 0;
+}
+
 static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
                      int width, int height, int64_t pts)
 {
     NetIntDrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
 
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, j = 0, ret;
-    int max_text_line_w = 0, len;
+    uint32_t prev_code = 0;
+    int i = 0, ret;
     int box_w, box_h;
-    char *text;
-    uint8_t *p;
-    int y_min = 32000, y_max = -32000;
-    int x_min = 32000, x_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
+    int extents[4] = { 32000, -32000, 32000, -32000 };
 
     time_t now = time(0);
-    struct tm ltime;
+    time_t wallclock = now;
     AVBPrint *bp = &s->expanded_text;
 
-    FFDrawColor fontcolor;
-    FFDrawColor shadowcolor;
-    FFDrawColor bordercolor;
-    FFDrawColor boxcolor;
-    unsigned int dst_linesize[NI_MAX_NUM_DATA_POINTERS] = {0};
-    dst_linesize[0] = frame->data_len[0] / height;
-    dst_linesize[1] = dst_linesize[2] = frame->data_len[1] / height / 2;
-
     av_bprint_clear(bp);
+    memset(&s->dirty, 0, sizeof(s->dirty));
+    if (s->deps_seen & EXP_DEP_METADATA)
+        update_metadata_serial(s);
 
     if (s->basetime != AV_NOPTS_VALUE)
         now = pts * av_q2d(ctx->inputs[0]->time_base) + s->basetime/1000000;
@@ -2191,19 +2787,12 @@ static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
     s->upload_drawtext_frame = 0;
 
     for (i = 0; i < s->text_num; i++) {
-        switch (s->exp_mode) {
-        case EXP_NONE:
-            av_bprintf(bp, "%s", s->text[i]);
-            break;
-        case EXP_NORMAL:
-            if ((ret = expand_text(ctx, s->text[i], &s->expanded_text)) < 0)
-                return ret;
-            break;
-        case EXP_STRFTIME:
-            localtime_r(&now, &ltime);
-            av_bprint_strftime(bp, s->text[i], &ltime);
-            break;
-        }
+        TextRun *run = &s->runs[i];
+        TextRunDraw *next = &run->next;
+
+        if ((ret = expand_text_cached(ctx, &s->expansions[i], s->text[i], bp,
+                                      s->exp_mode, now, wallclock)) < 0)
+            return ret;
         if (s->text_last_updated[i] == NULL) {
             s->upload_drawtext_frame = 1;
         } else {
@@ -2229,116 +2818,40 @@ static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
 
         if (!av_bprint_is_complete(bp))
             return AVERROR(ENOMEM);
-        text = s->expanded_text.str;
-        if ((len = s->expanded_text.len) > s->nb_positions) {
-            if (!(s->positions =
-                av_realloc(s->positions, len*sizeof(*s->positions))))
-                return AVERROR(ENOMEM);
-            s->nb_positions = len;
-        }
 
         if (s->fontcolor_expr[i]) {
             /* If expression is set, evaluate and replace the static value */
-            av_bprint_clear(&s->expanded_fontcolor);
-            if ((ret = expand_text(ctx, s->fontcolor_expr[i], &s->expanded_fontcolor)) < 0)
+            if ((ret = expand_text_cached(ctx, &s->fontcolor_expansions[i],
+                                          s->fontcolor_expr[i], &s->expanded_fontcolor,
+                                          EXP_NORMAL, now, wallclock)) < 0)
                 return ret;
-            if (!av_bprint_is_complete(&s->expanded_fontcolor))
-                return AVERROR(ENOMEM);
-            av_log(s, AV_LOG_DEBUG, "Evaluated fontcolor is '%s'\n", s->expanded_fontcolor.str);
-            ret = av_parse_color(s->fontcolor[i].rgba, s->expanded_fontcolor.str, -1, s);
-            if (ret)
-                return ret;
-            ff_draw_color(&s->dc, &s->fontcolor[i], s->fontcolor[i].rgba);
-        }
-
-        x = 0;
-        y = 0;
-        max_text_line_w = 0;
-
-        if ((ret = update_fontsize(ctx, i)) < 0)
-            return ret;
-
-        /* load and cache glyphs */
-        for (j = 0, p = text; *p; j++) {
-#if IS_FFMPEG_43_AND_ABOVE
-            GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
-continue_on_invalid:
-#else
-            GET_UTF8(code, *p++, continue;);
-#endif
-
-            /* get glyph */
-            dummy.code = code;
-            dummy.fontsize = s->fontsize[i];
-            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-            if (!glyph) {
-                ret = load_glyph(ctx, &glyph, code, i);
-                if (ret < 0)
+            /* unless the color is still the one parsed from the same expansion */
+            if (!ret) {
+                av_log(s, AV_LOG_DEBUG, "Evaluated fontcolor is '%s'\n", s->expanded_fontcolor.str);
+                ret = av_parse_color(s->fontcolor[i].rgba, s->expanded_fontcolor.str, -1, s);
+                if (ret) {
+                    s->fontcolor_expansions[i].valid = 0;
                     return ret;
+                }
+                ff_draw_color(&s->dc, &s->fontcolor[i], s->fontcolor[i].rgba);
             }
-
-            y_min = FFMIN(glyph->bbox.yMin, y_min);
-            y_max = FFMAX(glyph->bbox.yMax, y_max);
-            x_min = FFMIN(glyph->bbox.xMin, x_min);
-            x_max = FFMAX(glyph->bbox.xMax, x_max);
         }
-        s->max_glyph_h = y_max - y_min;
-        s->max_glyph_w = x_max - x_min;
 
-        /* compute and save position for each glyph */
-        glyph = NULL;
-        for (j = 0, p = text; *p; j++) {
-#if IS_FFMPEG_43_AND_ABOVE
-            GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
-continue_on_invalid2:
-#else
-            GET_UTF8(code, *p++, continue;);
-#endif
-
-            /* skip the \n in the sequence \r\n */
-            if (prev_code == '\r' && code == '\n')
-                continue;
-
-            prev_code = code;
-            if (is_newline(code)) {
-
-                max_text_line_w = FFMAX(max_text_line_w, x);
-                y += s->max_glyph_h + s->line_spacing;
-                x = 0;
-                continue;
-            }
-
-            /* get glyph */
-            prev_glyph = glyph;
-            dummy.code = code;
-            dummy.fontsize = s->fontsize[i];
-            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-            /* kerning */
-            if (s->use_kerning[i] && prev_glyph && glyph->code) {
-                FT_Get_Kerning(s->face[i], prev_glyph->code, glyph->code,
-                               ft_kerning_default, &delta);
-                x += delta.x >> 6;
-            }
-
-            /* save position */
-            s->positions[j].x = x + glyph->bitmap_left;
-            s->positions[j].y = y - glyph->bitmap_top + y_max;
-            if (code == '\t')
-                x  = (x / s->tabsize[i] + 1)*s->tabsize[i];
-            else
-                x += glyph->advance;
-        }
+        if ((ret = update_fontsize(ctx, i)) < 0)
+            return ret;
 
-        max_text_line_w = FFMAX(x, max_text_line_w);
+        if ((ret = layout_text_run(ctx, run, i, extents, &prev_code)) < 0)
+            return ret;
+        s->max_glyph_h = extents[3] - extents[2];
+        s->max_glyph_w = extents[1] - extents[0];
 
-        s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
-        s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
+        s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = run->text_w;
+        s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = run->text_h;
 
         s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
         s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
-        s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
-        s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
+        s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = extents[3];
+        s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = extents[2];
 
         s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
@@ -2348,13 +2861,13 @@ continue_on_invalid2:
         s->x[i] = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr[i], s->var_values, &s->prng);
 
         update_alpha(s);
-        update_color_with_alpha(s, &fontcolor  , s->fontcolor[i]);
-        update_color_with_alpha(s, &shadowcolor, s->shadowcolor);
-        update_color_with_alpha(s, &bordercolor, s->bordercolor);
-        update_color_with_alpha(s, &boxcolor   , s->boxcolor[i]);
+        update_color_with_alpha(s, &run->fontcolor  , s->fontcolor[i]);
+        update_color_with_alpha(s, &run->shadowcolor, s->shadowcolor);
+        update_color_with_alpha(s, &run->bordercolor, s->bordercolor);
+        update_color_with_alpha(s, &run->boxcolor   , s->boxcolor[i]);
 
-        box_w = max_text_line_w;
-        box_h = y + s->max_glyph_h;
+        box_w = run->text_w;
+        box_h = run->text_h;
 
         if (s->draw_box && s->boxborderw[i]) {
             int bbsize[4];
@@ -2407,34 +2920,37 @@ continue_on_invalid2:
             s->y_bak[i] = s->y[i];
             s->upload_drawtext_frame = 1;
         }
-        /* draw box */
-        if (s->draw_box)
-            ff_blend_rectangle(&s->dc, &boxcolor,
-                               frame->p_data, dst_linesize, width, height,
-                               s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
-                               box_w + s->bb_left[i] + s->bb_right[i], box_h + s->bb_top[i] + s->bb_bottom[i]);
-
-        if (s->shadowx || s->shadowy) {
-            if ((ret = draw_glyphs(s, frame, width, height,
-                                   &shadowcolor, s->shadowx, s->shadowy, 0, i)) < 0)
-                return ret;
-        }
 
-        if (s->borderw) {
-            if ((ret = draw_glyphs(s, frame, width, height,
-                                &bordercolor, 0, 0, s->borderw, i)) < 0)
-                return ret;
-        }
-        if ((ret = draw_glyphs(s, frame, width, height,
-                            &fontcolor, 0, 0, 0, i)) < 0)
-            return ret;
+        /* what the text puts on the canvas */
+        memset(next, 0, sizeof(*next));
+        next->layout_serial = run->layout_serial;
+        next->x         = s->x[i];
+        next->y         = s->y[i];
+        next->bb_top    = s->bb_top[i];
+        next->bb_right  = s->bb_right[i];
+        next->bb_bottom = s->bb_bottom[i];
+        next->bb_left   = s->bb_left[i];
+        memcpy(next->fontcolor,   run->fontcolor.rgba,   sizeof(next->fontcolor));
+        memcpy(next->shadowcolor, run->shadowcolor.rgba, sizeof(next->shadowcolor));
+        memcpy(next->bordercolor, run->bordercolor.rgba, sizeof(next->bordercolor));
+        memcpy(next->boxcolor,    run->boxcolor.rgba,    sizeof(next->boxcolor));
+        if (s->draw_box)
+            rect_union(&next->rect, s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
+                       s->x[i] + box_w + s->bb_right[i], s->y[i] + box_h + s->bb_bottom[i]);
+        if (s->shadowx || s->shadowy)
+            rect_add(&next->rect, &run->ink, s->x[i] + s->shadowx, s->y[i] + s->shadowy);
+        if (s->borderw)
+            rect_add(&next->rect, &run->border_ink, s->x[i], s->y[i]);
+        rect_add(&next->rect, &run->ink, s->x[i], s->y[i]);
+        rect_clip(&next->rect, width, height);
 
         update_canvas_size(s, s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
                            box_w + s->bb_left[i] + s->bb_right[i],  box_h + s->bb_top[i] + s->bb_bottom[i]);
         update_watermark(s, s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
                          box_w + s->bb_left[i] + s->bb_right[i], box_h + s->bb_top[i] + s->bb_bottom[i]);
     }
-    return 0;
+
+    return redraw_canvas(s, frame, width, height);
 }
 
 static int init_hwframe_uploader(AVFilterContext *ctx, NetIntDrawTextContext *s,
@@ -2894,7 +3410,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     AVFilterLink *outlink = ctx->outputs[0];
     NetIntDrawTextContext *s = ctx->priv;
     niFrameSurface1_t *logging_surface, *logging_surface_out;
-    uint8_t *p_dst, *p_src;
+    uint8_t *p_dst, *p_src, *txt_buf;
     int y, txt_img_width, txt_img_height;
     int ret;
 
@@ -2921,13 +3437,18 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             av_frame_free(&frame);
             return ret;
         }
+        s->nb_reloads++;
+        if (ret > 0) {
+            s->nb_reloads_unchanged++;
+        } else {
 #if CONFIG_LIBFRIBIDI
-        if (s->text_shaping)
-            if ((ret = shape_text(ctx)) < 0) {
-                av_frame_free(&frame);
-                return ret;
-            }
+            if (s->text_shaping)
+                if ((ret = shape_text(ctx)) < 0) {
+                    av_frame_free(&frame);
+                    return ret;
+                }
 #endif
+        }
     }
 
 #if !IS_FFMPEG_342_AND_ABOVE
@@ -2977,11 +3498,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
            av_get_pix_fmt_name(main_frame_ctx->sw_format),
            (int)s->var_values[VAR_TEXT_W], (int)s->var_values[VAR_TEXT_H]);
 
-    memset(s->dl_frame.data.frame.p_buffer, 0,
-           s->dl_frame.data.frame.buffer_size);
-
     draw_text(ctx, &(s->dl_frame.data.frame), frame->width, frame->height,
               frame->pts);
+    // txt_frame is only known to match the canvas once it is copied again
+    txt_buf = s->txt_buf;
+    s->txt_buf = NULL;
     check_and_expand_canvas_size(s, NI_MIN_RESOLUTION_WIDTH_SCALER, NI_MIN_RESOLUTION_HEIGHT_SCALER);
 
     av_log(ctx, AV_LOG_DEBUG, "n:%d t:%f text_w:%d text_h:%d x:%d y:%d "
@@ -3067,51 +3588,58 @@ FF_ENABLE_DEPRECATION_WARNINGS
         s->up_frame->data[0] = s->dl_frame.data.frame.p_data[0];
         s->up_frame->linesize[0] = FFALIGN(ovly_width, 16) * 4;
     } else {
-        av_log(ctx, AV_LOG_DEBUG, "%s alloc txt_frame %dx%d\n", __func__,
-            txt_img_width, txt_img_height);
-        if (ni_frame_buffer_alloc_dl(&(s->txt_frame.data.frame),
-                                    txt_img_width, txt_img_height,
-                                    NI_PIX_FMT_RGBA)) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+        if (!s->txt_frame.data.frame.p_buffer ||
+            s->txt_frame.data.frame.video_width != txt_img_width ||
+            s->txt_frame.data.frame.video_height != txt_img_height) {
+            av_log(ctx, AV_LOG_DEBUG, "%s alloc txt_frame %dx%d\n", __func__,
+                   txt_img_width, txt_img_height);
+            if (ni_frame_buffer_alloc_dl(&(s->txt_frame.data.frame),
+                                        txt_img_width, txt_img_height,
+                                        NI_PIX_FMT_RGBA)) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            txt_buf = NULL;
         }
 
         p_dst = s->txt_frame.data.frame.p_buffer;
-        memset(p_dst, 0, s->txt_frame.data.frame.buffer_size);
-
-        start_row = s->y_start;
-        stop_row  = start_row + txt_img_height;
         dl_frame_linesize0 = FFALIGN(frame->width, 16);
         text_frame_linesize0 = FFALIGN(txt_img_width, 16);
-        // if overlay intersects at the main top/bottom, only copy the overlaying
-        // portion
-        if (start_row < 0) {
-            p_dst += -1 * start_row * text_frame_linesize0 * 4;
-            start_row = 0;
-        }
-        if (stop_row > frame->height) {
-            stop_row = frame->height;
-        }
 
-        // if overlay intersects at the main left/right, only copy the overlaying
-        // portion
-        start_col = s->x_start;
-        stop_col  = start_col + txt_img_width;
-        if (start_col < 0) {
-            p_dst += (-4 * start_col);
-            start_col = 0;
-        }
-        if (stop_col > frame->width) {
-            stop_col = frame->width;
+        // if the clip did not move, only the part of the canvas drawn for
+        // this frame has to be copied again
+        if (txt_buf == p_dst && s->txt_x == s->x_start && s->txt_y == s->y_start) {
+            start_row = s->dirty.y0;
+            stop_row  = s->dirty.y1;
+            start_col = s->dirty.x0;
+            stop_col  = s->dirty.x1;
+        } else {
+            memset(p_dst, 0, s->txt_frame.data.frame.buffer_size);
+            start_row = start_col = 0;
+            stop_row  = frame->height;
+            stop_col  = frame->width;
+            s->canvas_serial++;
         }
 
-        for (y = start_row; y < stop_row; y++) {
+        // if overlay intersects at the main top/bottom/left/right, only copy
+        // the overlaying portion
+        start_row = FFMAX(start_row, s->y_start);
+        stop_row  = FFMIN(stop_row, s->y_start + txt_img_height);
+        start_col = FFMAX(start_col, s->x_start);
+        stop_col  = FFMIN(stop_col, s->x_start + txt_img_width);
+
+        for (y = start_row; y < stop_row && start_col < stop_col; y++) {
             p_src = s->dl_frame.data.frame.p_buffer +
                 (y * dl_frame_linesize0 + start_col) * 4;
 
-            memcpy(p_dst, p_src, (stop_col - start_col) * 4);
-            p_dst += text_frame_linesize0 * 4;
+            memcpy(p_dst + ((y - s->y_start) * text_frame_linesize0 +
+                            start_col - s->x_start) * 4,
+                   p_src, (stop_col - start_col) * 4);
         }
+        s->txt_buf = p_dst;
+        s->txt_x   = s->x_start;
+        s->txt_y   = s->y_start;
+
         // wrap the txt ni_frame into AVFrame up_frame
         // for RGBA format, only need to copy the first data
         // in some situation, like linesize[0] == align64(width*4)
@@ -3130,6 +3658,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         s->filtered_frame_count = 0;
     }
 
+    // the kept overlay may already hold this very image
+    if (s->upload_drawtext_frame && s->optimize_upload && s->keep_overlay &&
+        s->uploaded_serial == s->canvas_serial) {
+        s->upload_drawtext_frame = 0;
+        s->nb_uploads_skipped++;
+    }
+
     if (s->upload_drawtext_frame) {
         av_frame_free(&s->keep_overlay);
         s->keep_overlay = NULL;
@@ -3163,6 +3698,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             av_log(ctx, AV_LOG_ERROR, "upload failed, ret = %d\n", ret);
             return ret;
         }
+        s->uploaded_serial = s->canvas_serial;
+        s->nb_uploads++;
     }
     else {
         overlay = s->keep_overlay;
@@ -44,12 +44,14 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/ni_copy.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/time.h"
 #include "libswscale/swscale.h"
 #include "drawutils.h"
+#include "ni_ai_pipe.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
 #include "video.h"
@@ -119,6 +121,9 @@ typedef struct NetIntHvsplusContext {
     int ai_timeout;
     int channel_mode;
     int buffer_limit;
+
+    int depth;              /* frames in flight on the AI engine */
+    NIAIPipe pipe;
 } NetIntHvsplusContext;
 
 static const ni_hvsplus_nbsize_t nbSizes[] = {
@@ -307,7 +312,7 @@ static int init_ai_context(AVFilterContext *ctx, NetIntHvsplusContext *s,
             0, // rec height
             0, // rec X pos
             0, // rec Y pos
-            8, // rgba color/pool size
+            8 + s->pipe.depth - 1, // rgba color/pool size
             0, // frame index
             NI_DEVICE_TYPE_AI);
     if (retval != NI_RETCODE_SUCCESS) {
@@ -460,7 +465,8 @@ static av_cold int init_hwframe_pad(AVFilterContext *ctx, NetIntHvsplusContext *
     /* Create scale frame pool on device */
     retval = ff_ni_build_frame_pool(&hwp_ctx->api_ctx, s->nb_width,
                                     s->nb_height, format,
-                                    DEFAULT_NI_FILTER_POOL_SIZE, s->buffer_limit);
+                                    DEFAULT_NI_FILTER_POOL_SIZE + s->pipe.depth - 1,
+                                    s->buffer_limit);
 
     if (retval < 0) {
         av_log(ctx, AV_LOG_ERROR, "Error: could not build frame pool\n");
@@ -578,7 +584,11 @@ static av_cold int init(AVFilterContext *ctx)
     s->nb_height = -1;
     s->need_padding = 0;
 
-    return 0;
+#if !IS_FFMPEG_61_AND_ABOVE
+    /* frames in flight can only be flushed from activate() */
+    s->depth = 1;
+#endif
+    return ff_ni_ai_pipe_init(&s->pipe, s->depth);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -586,6 +596,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     NetIntHvsplusContext *s  = ctx->priv;
     ni_hvsplus_network_t *network = &s->network;
 
+    ff_ni_ai_pipe_log_stats(ctx, &s->pipe);
+    ff_ni_ai_pipe_uninit(&s->pipe);
+
     cleanup_ai_context(ctx, s);
 
     ni_destroy_network(ctx, network);
@@ -608,6 +621,8 @@ static int config_input(AVFilterContext *ctx, AVFrame *frame)
     if (s->initialized)
         return 0;
 
+    ff_ni_ai_pipe_fit_input(ctx, &s->pipe, frame);
+
     ret = init_ai_context(ctx, s, frame);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "Error: failed to initialize ai context\n");
@@ -793,414 +808,95 @@ static int output_config_props(AVFilterLink *outlink)
 
 static int av_to_niframe_copy(NetIntHvsplusContext *s, ni_frame_t *dst, const AVFrame *src, int nb_planes)
 {
-    int dst_stride[4],src_height[4], hpad[4], vpad[4], linesize[4];
-    int i, j, h;
-    uint8_t *src_line, *dst_line, YUVsample, *sample, *dest;
-    uint16_t lastidx;
-    bool tenBit;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->format);
+    NICopyPlane planes[4] = { 0 };
+    int dst_stride[4], dst_height[4], src_linesize[4], src_height[4];
+    uint8_t *dst_line;
+    int i;
 
     av_log(NULL, AV_LOG_DEBUG, "%s: src width %d height %d nb w %d nb h %d format %s linesize %d %d %d nb_planes %d\n", __func__,
            src->width, src->height, s->nb_width, s->nb_height, av_get_pix_fmt_name(src->format),
            src->linesize[0], src->linesize[1], src->linesize[2], nb_planes);
 
-    linesize[0] = src->linesize[0];
-    linesize[1] = src->linesize[1];
-    linesize[2] = src->linesize[2];
-    linesize[3] = 0;
-
-    switch (src->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        dst_stride[0] = FFALIGN(s->nb_width, 128);
-        dst_stride[1] = FFALIGN((s->nb_width / 2), 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        linesize[0] = FFALIGN(src->width, 2);
-        linesize[1] = FFALIGN(src->width, 2) / 2;
-        linesize[2] = linesize[1];
-
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(s->nb_height, 2) - src->height;
-        vpad[1] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[2] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        dst_stride[0] = FFALIGN(s->nb_width * 2, 128);
-        dst_stride[1] = FFALIGN(s->nb_width, 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        linesize[0] = src->width * 2;
-        linesize[1] = src->width;
-        linesize[2] = linesize[1];
-
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(s->nb_height, 2) - src->height;
-        vpad[1] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[2] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_NV12:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_NV16:
-        dst_stride[0] = FFALIGN(src->width, 64);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = 0;
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_P010LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_BGRP:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = src->height;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    default:
+    /* the planes are packed one after the other at the network input size */
+    if (avpriv_ni_copy_device_layout(src->format, s->nb_width,
+                                     FFALIGN(s->nb_height, 2), dst_stride,
+                                     dst_height) < 0 ||
+        avpriv_ni_copy_device_layout(src->format, src->width, src->height,
+                                     src_linesize, src_height) < 0) {
         av_log(NULL, AV_LOG_ERROR, "Error: Pixel format %s not supported\n",
                av_get_pix_fmt_name(src->format));
         return AVERROR(EINVAL);
     }
-    av_log(NULL, AV_LOG_DEBUG, "%s: dst_stride %d %d %d linesize %d %d %d hpad %d %d %d\n", __func__,
-           dst_stride[0], dst_stride[1], dst_stride[2],
-           src->linesize[0], src->linesize[1], src->linesize[2],
-           hpad[0], hpad[1], hpad[2]);
-    av_log(NULL, AV_LOG_DEBUG, "%s: src_height %d %d %d vpad %d %d %d tenBit %d\n", __func__,
-           src_height[0], src_height[1], src_height[2],
-           vpad[0], vpad[1], vpad[2], tenBit);
 
     dst_line = dst->p_buffer;
     for (i = 0; i < nb_planes; i++) {
-        src_line = src->data[i];
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line, FFMIN(linesize[i], dst_stride[i]));
-
-            if (h == 0)
-                av_log(NULL, AV_LOG_DEBUG, "%s: i %d h %d to %d memcpy size %d\n", __func__, i, h, src_height[i]-1, FFMIN(linesize[i], dst_stride[i]));
-
-            if (hpad[i]) {
-                lastidx = linesize[i];
-
-                if (tenBit) {
-                    sample = &src_line[lastidx - 2];
-                    dest   = &dst_line[lastidx];
-
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++) {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
-                    }
-                    if (h == 0)
-                        av_log(NULL, AV_LOG_DEBUG, "%s: i %d hpad %d to %d memset size %d value %d %d tenBit\n", __func__, i, h, src_height[i]-1, hpad[i], sample[0], sample[1]);
-
-                } else {
-                    YUVsample = dst_line[lastidx - 1];
-                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
-
-                    if (h == 0)
-                        av_log(NULL, AV_LOG_DEBUG, "%s: i %d hpad %d to %d memset size %d value %d\n", __func__, i, h, src_height[i]-1, hpad[i], YUVsample);
-                }
-            }
+        int bytewidth = av_image_get_linesize(src->format, src->width, i);
 
-            src_line += src->linesize[i];
-            dst_line += dst_stride[i];
-        }
+        bytewidth = FFMIN(bytewidth, dst_stride[i]);
 
-        /* Extend the height by cloning the last line */
-        src_line = dst_line - dst_stride[i];
-        for (h = 0; h < vpad[i]; h++) {
-            memcpy(dst_line, src_line, dst_stride[i]);
+        planes[i].dst          = dst_line;
+        planes[i].src          = src->data[i];
+        planes[i].dst_linesize = dst_stride[i];
+        planes[i].src_linesize = src->linesize[i];
+        planes[i].bytewidth    = bytewidth;
+        planes[i].height       = src_height[i];
+        planes[i].hpad         = dst_stride[i] - bytewidth;
+        planes[i].vpad         = FFMAX(dst_height[i] - src_height[i], 0);
+        planes[i].sample_size  = desc->comp[0].depth > 8 ? 2 : 1;
 
-            av_log(NULL, AV_LOG_DEBUG, "%s: h %d memcpy vpad size %d\n", __func__, h, dst_stride[i]);
+        av_log(NULL, AV_LOG_DEBUG, "%s: plane %d stride %d bytes %d rows %d hpad %d vpad %d\n",
+               __func__, i, dst_stride[i], bytewidth, src_height[i],
+               planes[i].hpad, planes[i].vpad);
 
-            dst_line += dst_stride[i];
-        }
+        dst_line += (ptrdiff_t)dst_stride[i] * FFMAX(dst_height[i], src_height[i]);
     }
 
+    avpriv_ni_copy_planes(NULL, planes, nb_planes);
+
     return 0;
 }
 
 static int ni_to_avframe_copy(NetIntHvsplusContext *s, AVFrame *dst, const ni_packet_t *src, int nb_planes)
 {
-    int src_linesize[4], src_height[4], dst_height[4];
-    int i, h;
-    uint8_t *src_line, *dst_line;
+    NICopyPlane planes[4] = { 0 };
+    int src_linesize[4], src_height[4], dst_linesize[4], dst_height[4];
+    uint8_t *src_line;
+    int i;
 
     av_log(NULL, AV_LOG_DEBUG, "%s: dst width %d height %d nb w %d nb h %d format %s nb_planes %d\n", __func__,
            dst->width, dst->height, s->nb_width, s->nb_height, av_get_pix_fmt_name(dst->format), nb_planes);
 
-    dst_height[0] = dst->height;
-    dst_height[1] = dst->height / 2;
-    dst_height[2] = dst_height[1];
-    dst_height[3] = 0;
-
-    switch (dst->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        src_linesize[0] = FFALIGN(s->nb_width, 128);
-        src_linesize[1] = FFALIGN(s->nb_width / 2, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = s->nb_height;
-        src_height[1] = FFALIGN(s->nb_height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        src_linesize[0] = FFALIGN(s->nb_width * 2, 128);
-        src_linesize[1] = FFALIGN(s->nb_width, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = s->nb_height;
-        src_height[1] = FFALIGN(s->nb_height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV12:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV16:
-        src_linesize[0] = FFALIGN(dst->width, 64);
-        src_linesize[1] = FFALIGN(dst->width, 64);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 2;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_P010LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width * 2, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 4;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_BGRP:
-        src_linesize[0] = FFALIGN(dst->width, 32);
-        src_linesize[1] = FFALIGN(dst->width, 32);
-        src_linesize[2] = FFALIGN(dst->width, 32);
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = dst->height;
-        src_height[3] = 0;
-        break;
-    default:
+    /* crop the network output size to the frame size */
+    if (avpriv_ni_copy_device_layout(dst->format, s->nb_width, s->nb_height,
+                                     src_linesize, src_height) < 0 ||
+        avpriv_ni_copy_device_layout(dst->format, dst->width, dst->height,
+                                     dst_linesize, dst_height) < 0) {
         av_log(NULL, AV_LOG_ERROR, "Error: Unsupported pixel format %s\n",
                av_get_pix_fmt_name(dst->format));
         return AVERROR(EINVAL);
     }
-    av_log(NULL, AV_LOG_DEBUG, "%s: src_linesize %d %d %d src_height %d %d %d dst linesize %d %d %d dst_height %d %d %d\n", __func__,
-           src_linesize[0], src_linesize[1], src_linesize[2],
-           src_height[0], src_height[1], src_height[2],
-           dst->linesize[0], dst->linesize[1], dst->linesize[2],
-           dst_height[0], dst_height[1], dst_height[2]);
 
     src_line = src->p_data;
     for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            if (h < dst_height[i]) {
-                memcpy(dst_line, src_line,
-                       FFMIN(src_linesize[i], dst->linesize[i]));
-                if (h == 0)
-                    av_log(NULL, AV_LOG_DEBUG, "%s: i %d h %d to %d memcpy size %d\n", __func__, i, h, src_height[i]-1,  FFMIN(src_linesize[i], dst->linesize[i]));
-                dst_line += FFMIN(src_linesize[i], dst->linesize[i]);
-            }
-            src_line += src_linesize[i];
-        }
+        int bytewidth = av_image_get_linesize(dst->format, dst->width, i);
+
+        planes[i].dst          = dst->data[i];
+        planes[i].src          = src_line;
+        planes[i].dst_linesize = dst->linesize[i];
+        planes[i].src_linesize = src_linesize[i];
+        planes[i].bytewidth    = FFMIN3(bytewidth, src_linesize[i], dst->linesize[i]);
+        planes[i].height       = FFMIN(dst_height[i], src_height[i]);
+
+        av_log(NULL, AV_LOG_DEBUG, "%s: plane %d stride %d bytes %d rows %d\n",
+               __func__, i, src_linesize[i], planes[i].bytewidth,
+               planes[i].height);
+
+        src_line += (ptrdiff_t)src_linesize[i] * src_height[i];
     }
 
+    avpriv_ni_copy_planes(NULL, planes, nb_planes);
+
     return 0;
 }
 
@@ -1394,48 +1090,21 @@ static int ni_hwframe_crop(AVFilterContext *ctx, NetIntHvsplusContext *s, AVFram
     return 0;
 }
 
-static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
+/* read the output of the oldest frame in flight and send it out, unless
+ * wait is 0 and it is not there yet */
+static int hvsplus_complete(AVFilterContext *ctx, int wait)
 {
-    AVFilterContext *ctx = link->dst;
-    AVHWFramesContext *in_frames_context = NULL; //= (AVHWFramesContext *) in->hw_frames_ctx->data;
     NetIntHvsplusContext *s  = ctx->priv;
+    AiContext *ai_ctx = s->ai_ctx;
+    NIAIPipeEntry *e = ff_ni_ai_pipe_head(&s->pipe);
+    AVFrame *in = e->frame;
+    AVHWFramesContext *in_frames_context = NULL;
     AVFrame *out         = NULL;
     ni_retcode_t retval;
     int ret;
-    AiContext *ai_ctx;
     ni_hvsplus_network_t *network = &s->network;
     int nb_planes;
-    int64_t start_t;
-    int hwframe = in->format == AV_PIX_FMT_NI_QUAD ? 1 : 0;
-
-    av_log(ctx, AV_LOG_DEBUG, "%s: filter %p hwframe %d format %s\n", __func__, s, hwframe, av_get_pix_fmt_name(in->format));
-
-    if (!s->initialized) {
-        AVHWFramesContext *pAVHFWCtx;
-        if (hwframe) {
-            pAVHFWCtx = (AVHWFramesContext *) in->hw_frames_ctx->data;
-        }
-#if IS_FFMPEG_71_AND_ABOVE
-        AVFilterLink *outlink = link->dst->outputs[0];
-        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
-           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
-        }
-#endif
-        ret = config_input(ctx, in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "Error: failed to config input\n");
-            goto failed_out;
-        }
-        if (hwframe) {
-            av_hwframe_ctx_init(s->out_frames_ref);
-            AVHWFramesContext *out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
-            AVNIFramesContext *out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
-            ni_cpy_hwframe_ctx(pAVHFWCtx, out_frames_ctx);
-            ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
-        }
-    }
 
-    ai_ctx = s->ai_ctx;
     out = av_frame_alloc();
     if (!out) {
         ret = AVERROR(ENOMEM);
@@ -1447,13 +1116,10 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
     av_log(ctx, AV_LOG_DEBUG, "%s: out_width %d out_height %d in width %d height %d\n",
             __func__, s->out_width, s->out_height, in->width, in->height);
 
-    if (hwframe) {
-        niFrameSurface1_t *frame_surface;
+    if (in->format == AV_PIX_FMT_NI_QUAD) {
         niFrameSurface1_t *hvsplus_surface;
         niFrameSurface1_t *out_surface;
         niFrameSurface1_t *frame_surface2;
-        int ai_out_format;
-        niFrameSurface1_t dst_surface = {0};
 
         in_frames_context = (AVHWFramesContext *) in->hw_frames_ctx->data;
 
@@ -1465,6 +1131,175 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
         /* Quadra 2D engine always outputs limited color range */
         out->color_range = AVCOL_RANGE_MPEG;
 
+        out->data[3] = av_malloc(sizeof(niFrameSurface1_t));
+        if (!out->data[3]) {
+            av_log(ctx, AV_LOG_ERROR, "Error: ni hvsplus filter av_malloc returned NULL\n");
+            ret = AVERROR(ENOMEM);
+            goto failed_out;
+        }
+
+        memcpy(out->data[3], in->data[3], sizeof(niFrameSurface1_t));
+
+        /* Set the new frame index */
+        av_log(ctx, AV_LOG_DEBUG, "%s: 3. Read hw frame from Ai w %d h %d\n",
+                                        __func__, out->width, out->height);
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_frame, 1,
+                                 wait ? s->ai_timeout : NI_AI_PIPE_NO_WAIT);
+        if (ret < 0) {
+            av_freep(&out->data[3]);
+            goto failed_out;
+        }
+
+#ifdef NI_MEASURE_LATENCY
+        ff_ni_update_benchmark("ni_quadra_hvsplus");
+#endif
+
+        if (s->need_padding) {
+
+            hvsplus_surface = (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.p_data[3];
+
+            memcpy(out->data[3], ai_ctx->api_dst_frame.data.frame.p_data[3], sizeof(niFrameSurface1_t));
+
+            ret = ni_hwframe_crop(ctx, s, in, in->width, in->height, &frame_surface2);
+            if (ret < 0) {
+                av_log(ctx, AV_LOG_ERROR, "Error run hwframe crop\n");
+                av_freep(&out->data[3]);
+                goto failed_out;
+            }
+
+            ni_hwframe_buffer_recycle(hvsplus_surface, hvsplus_surface->device_handle);
+
+            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
+                    frame_surface2->ui16FrameIdx);
+        } else {
+            frame_surface2 = (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.p_data[3];
+        }
+
+        out_surface = (niFrameSurface1_t *) out->data[3];
+
+        av_log(ctx, AV_LOG_DEBUG,"ai pre process, idx=%d\n", frame_surface2->ui16FrameIdx);
+
+        out_surface->ui16FrameIdx = frame_surface2->ui16FrameIdx;
+        out_surface->ui16session_ID = frame_surface2->ui16session_ID;
+        out_surface->device_handle = frame_surface2->device_handle;
+        out_surface->output_idx = frame_surface2->output_idx;
+        out_surface->src_cpu = frame_surface2->src_cpu;
+        out_surface->ui32nodeAddress = 0;
+        out_surface->dma_buf_fd = 0;
+        out_surface->ui16width = out->width;
+        out_surface->ui16height = out->height;
+        ff_ni_set_bit_depth_and_encoding_type(&out_surface->bit_depth,
+                                            &out_surface->encoding_type,
+                                            in_frames_context->sw_format);
+
+        av_log(ctx, AV_LOG_DEBUG, "%s: need_padding %d 4. Read hw frame from Ai w %d %d h %d %d\n",
+                                                        __func__, s->need_padding, out->width, s->out_width, out->height, s->out_height);
+
+        out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t), ff_ni_frame_free, NULL, 0);
+
+        if (!out->buf[0]) {
+            av_log(ctx, AV_LOG_ERROR, "Error: ni hvsplus filter av_buffer_create returned NULL\n");
+            ret = AVERROR(ENOMEM);
+            av_log(NULL, AV_LOG_DEBUG, "Recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
+                    out_surface->ui16FrameIdx, out_surface->device_handle);
+            retval = ni_hwframe_buffer_recycle(out_surface, out_surface->device_handle);
+            if (retval != NI_RETCODE_SUCCESS) {
+                av_log(NULL, AV_LOG_ERROR, "ERROR: Failed to recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
+                        out_surface->ui16FrameIdx, out_surface->device_handle);
+            }
+            av_freep(&out->data[3]);
+            goto failed_out;
+        }
+
+        /* Reference the new hw frames context */
+        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+    } else {
+        out->width = s->out_width;
+        out->height = s->out_height;
+
+        out->format = in->format;
+        av_log(ctx, AV_LOG_DEBUG, "%s: format %s allocate frame %d x %d\n", __func__, av_get_pix_fmt_name(in->format), out->width, out->height);
+        if (av_frame_get_buffer(out, 32) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error: Could not allocate the AVFrame buffers\n");
+            ret = AVERROR(ENOMEM);
+            goto failed_out;
+        }
+
+        // sw frame: step 4: alloc frame for read
+        retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
+                                        &network->raw);
+        if (retval != NI_RETCODE_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "Error: failed to allocate ni packet\n");
+            ret = AVERROR(ENOMEM);
+            goto failed_out;
+        }
+
+        // sw frame: step 5: read a frame from AI
+        ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                                 &ai_ctx->api_dst_frame, 0,
+                                 wait ? s->ai_timeout : NI_AI_PIPE_NO_WAIT);
+        if (ret < 0)
+            goto failed_out;
+#ifdef NI_MEASURE_LATENCY
+        ff_ni_update_benchmark("ni_quadra_hvsplus");
+#endif
+        nb_planes = av_pix_fmt_count_planes(out->format);
+        if (s->channel_mode) {
+            if (out->format != AV_PIX_FMT_YUV420P && out->format != AV_PIX_FMT_YUVJ420P) {
+                av_log(ctx, AV_LOG_ERROR, "Error: support yuv420p and yuvj420p only, current fmt %d\n",
+                        out->format);
+                ret = AVERROR(EINVAL);
+                goto failed_out;
+            }
+            nb_planes = 1; // only copy Y data
+            // copy U/V data from the input sw frame
+            memcpy(out->data[1], in->data[1], in->height * in->linesize[1] / 2);
+            memcpy(out->data[2], in->data[2], in->height * in->linesize[2] / 2);
+        }
+        // sw frame: step 6: crop
+        retval = ni_to_avframe_copy(s, out, &ai_ctx->api_dst_frame.data.packet, nb_planes);
+        if (retval < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error: hvsplus cannot copy ai frame to avframe\n");
+            ret = AVERROR(EIO);
+            goto failed_out;
+        }
+    }
+
+    /* recycles the padded input of the network */
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ff_filter_frame(ctx->outputs[0], out);
+
+failed_out:
+    av_frame_free(&out);
+    /* no output yet, the frame stays in flight */
+    if (ret == AVERROR(EAGAIN))
+        return ret;
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ret;
+}
+
+/* send a frame to the network, the pipe must not be full */
+static int hvsplus_submit(AVFilterContext *ctx, AVFrame *in)
+{
+    NetIntHvsplusContext *s  = ctx->priv;
+    AiContext *ai_ctx = s->ai_ctx;
+    AVHWFramesContext *in_frames_context = NULL;
+    NIAIPipeEntry *e;
+    niFrameSurface1_t pad_surface = {0};
+    ni_retcode_t retval;
+    int ret;
+    ni_hvsplus_network_t *network = &s->network;
+    int nb_planes;
+    int64_t start_t;
+
+    if (in->format == AV_PIX_FMT_NI_QUAD) {
+        niFrameSurface1_t *frame_surface;
+        int ai_out_format;
+        niFrameSurface1_t dst_surface = {0};
+
+        in_frames_context = (AVHWFramesContext *) in->hw_frames_ctx->data;
+
         if (s->need_padding) {
             ret = ni_hwframe_pad(ctx, s, in, s->nb_width, s->nb_height, //network->netw, network->neth,
                                    &frame_surface);
@@ -1476,20 +1311,14 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
             av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
                     frame_surface->ui16FrameIdx);
 
-            out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+            /* the padded frame is read by the network until its output is */
+            pad_surface = *frame_surface;
+            frame_surface = &pad_surface;
         } else {
             // To hvsplus
             frame_surface = (niFrameSurface1_t *)in->data[3];
         }
 
-        out->data[3] = av_malloc(sizeof(niFrameSurface1_t));
-        if (!out->data[3]) {
-            av_log(ctx, AV_LOG_ERROR, "Error: ni hvsplus filter av_malloc returned NULL\n");
-            ret = AVERROR(ENOMEM);
-            goto failed_out;
-        }
-
-        memcpy(out->data[3], frame_surface, sizeof(niFrameSurface1_t));
         av_log(ctx, AV_LOG_DEBUG, "%s: input frame surface frameIdx %d ui16width %d ui16height %d\n",
                __func__, frame_surface->ui16FrameIdx, frame_surface->ui16width, frame_surface->ui16height);
 
@@ -1584,104 +1413,7 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
             ret = AVERROR(ENOMEM);
             goto failed_out;
         }
-
-        /* Set the new frame index */
-        start_t = av_gettime();
-        do{
-            av_log(ctx, AV_LOG_DEBUG, "%s: 3. Read hw frame from Ai w %d h %d\n",
-                                            __func__, out->width, out->height);
-            retval = ni_device_session_read_hwdesc(
-                &ai_ctx->api_ctx, &s->ai_ctx->api_dst_frame, NI_DEVICE_TYPE_AI);
-
-            if (retval < NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "Error: failed to read hwdesc,retval=%d\n", retval);
-                ret = AVERROR(EINVAL);
-                goto failed_out;
-            }
-            if (av_gettime() - start_t > s->ai_timeout * 1000000) {
-                av_log(ctx, AV_LOG_ERROR, "Error: alloc hw output timeout\n");
-                ret = AVERROR(ENOMEM);
-                goto failed_out;
-            }
-        } while (retval != NI_RETCODE_SUCCESS);
-
-#ifdef NI_MEASURE_LATENCY
-        ff_ni_update_benchmark("ni_quadra_hvsplus");
-#endif
-
-        if (s->need_padding) {
-
-            hvsplus_surface = (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.p_data[3];
-
-            ni_hwframe_buffer_recycle(frame_surface, frame_surface->device_handle);
-
-            out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
-
-            memcpy(out->data[3], ai_ctx->api_dst_frame.data.frame.p_data[3], sizeof(niFrameSurface1_t));
-
-            ret = ni_hwframe_crop(ctx, s, in, in->width, in->height, &frame_surface2);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_ERROR, "Error run hwframe crop\n");
-                goto failed_out;
-            }
-
-            ni_hwframe_buffer_recycle(hvsplus_surface, hvsplus_surface->device_handle);
-
-            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
-                    frame_surface2->ui16FrameIdx);
-        } else {
-            frame_surface2 = (niFrameSurface1_t *) ai_ctx->api_dst_frame.data.frame.p_data[3];
-        }
-
-        out_surface = (niFrameSurface1_t *) out->data[3];
-
-        av_log(ctx, AV_LOG_DEBUG,"ai pre process, idx=%d\n", frame_surface2->ui16FrameIdx);
-
-        out_surface->ui16FrameIdx = frame_surface2->ui16FrameIdx;
-        out_surface->ui16session_ID = frame_surface2->ui16session_ID;
-        out_surface->device_handle = frame_surface2->device_handle;
-        out_surface->output_idx = frame_surface2->output_idx;
-        out_surface->src_cpu = frame_surface2->src_cpu;
-        out_surface->ui32nodeAddress = 0;
-        out_surface->dma_buf_fd = 0;
-        out_surface->ui16width = out->width;
-        out_surface->ui16height = out->height;
-        ff_ni_set_bit_depth_and_encoding_type(&out_surface->bit_depth,
-                                            &out_surface->encoding_type,
-                                            in_frames_context->sw_format);
-
-        av_log(ctx, AV_LOG_DEBUG, "%s: need_padding %d 4. Read hw frame from Ai w %d %d h %d %d\n",
-                                                        __func__, s->need_padding, out->width, s->out_width, out->height, s->out_height);
-
-        out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t), ff_ni_frame_free, NULL, 0);
-
-        if (!out->buf[0]) {
-            av_log(ctx, AV_LOG_ERROR, "Error: ni hvsplus filter av_buffer_create returned NULL\n");
-            ret = AVERROR(ENOMEM);
-            av_log(NULL, AV_LOG_DEBUG, "Recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
-                    out_surface->ui16FrameIdx, out_surface->device_handle);
-            retval = ni_hwframe_buffer_recycle(out_surface, out_surface->device_handle);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(NULL, AV_LOG_ERROR, "ERROR: Failed to recycle trace ui16FrameIdx = [%d] DevHandle %d\n",
-                        out_surface->ui16FrameIdx, out_surface->device_handle);
-            }
-            goto failed_out;
-        }
-
-        /* Reference the new hw frames context */
-        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
     } else {
-        out->width = s->out_width;
-        out->height = s->out_height;
-
-        out->format = in->format;
-        av_log(ctx, AV_LOG_DEBUG, "%s: format %s allocate frame %d x %d\n", __func__, av_get_pix_fmt_name(in->format), out->width, out->height);
-        if (av_frame_get_buffer(out, 32) < 0) {
-            av_log(ctx, AV_LOG_ERROR, "Error: Could not allocate the AVFrame buffers\n");
-            ret = AVERROR(ENOMEM);
-            goto failed_out;
-        }
-
         start_t = av_gettime();
         // sw frame: step 1: allocate
         retval = ni_ai_frame_buffer_alloc(&ai_ctx->api_src_frame.data.frame,
@@ -1713,7 +1445,7 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
         ff_ni_update_benchmark(NULL);
 #endif
 
-        /* write frame */
+        /* write frame, making room by completing the frames in flight */
         // sw frame: step 3: write a frame to AI
         do {
             retval = ni_device_session_write(
@@ -1723,6 +1455,10 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
                        "Error: failed to write ai session: retval %d\n", retval);
                 ret = AVERROR(EIO);
                 goto failed_out;
+            } else if (retval == 0 && s->pipe.count) {
+                ret = hvsplus_complete(ctx, 1);
+                if (ret < 0)
+                    goto failed_out;
             }
 
             if (av_gettime() - start_t > s->ai_timeout * 1000000) {
@@ -1731,65 +1467,66 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
                 goto failed_out;
             }
         } while (retval == 0);
-        // sw frame: step 4: alloc frame for read
-        retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
-                                        &network->raw);
-        if (retval != NI_RETCODE_SUCCESS) {
-            av_log(ctx, AV_LOG_ERROR, "Error: failed to allocate ni packet\n");
-            ret = AVERROR(ENOMEM);
-            goto failed_out;
-        }
+    }
 
-        start_t = av_gettime();
-        // sw frame: step 5: read a frame from AI
-        do {
-            retval = ni_device_session_read(&ai_ctx->api_ctx, &ai_ctx->api_dst_frame, NI_DEVICE_TYPE_AI);
-            if (retval < 0) {
-                av_log(NULL,AV_LOG_ERROR,"Error: read AI data retval %d\n", retval);
-                ret = AVERROR(EIO);
-                goto failed_out;
-            } else if (retval > 0) {
-                if (av_gettime() - start_t > s->ai_timeout * 1000000) {
-                    av_log(ctx, AV_LOG_ERROR, "Error: read sw frame from AI timeout\n");
-                    ret = AVERROR(ENOMEM);
-                    goto failed_out;
-                }
-            }
-        } while (retval == 0);
-#ifdef NI_MEASURE_LATENCY
-        ff_ni_update_benchmark("ni_quadra_hvsplus");
+    e = ff_ni_ai_pipe_push(&s->pipe, in);
+    e->surface = pad_surface;
+    e->submitted = 1;
+    return 0;
+
+failed_out:
+    if (pad_surface.ui16FrameIdx)
+        ni_hwframe_buffer_recycle(&pad_surface, pad_surface.device_handle);
+    av_frame_free(&in);
+    return ret;
+}
+
+static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntHvsplusContext *s  = ctx->priv;
+    int ret;
+    int hwframe = in->format == AV_PIX_FMT_NI_QUAD ? 1 : 0;
+
+    av_log(ctx, AV_LOG_DEBUG, "%s: filter %p hwframe %d format %s\n", __func__, s, hwframe, av_get_pix_fmt_name(in->format));
+
+    if (!s->initialized) {
+        AVHWFramesContext *pAVHFWCtx;
+        if (hwframe) {
+            pAVHFWCtx = (AVHWFramesContext *) in->hw_frames_ctx->data;
+        }
+#if IS_FFMPEG_71_AND_ABOVE
+        AVFilterLink *outlink = link->dst->outputs[0];
+        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
+           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
+        }
 #endif
-        nb_planes = av_pix_fmt_count_planes(out->format);
-        if (s->channel_mode) {
-            if (out->format != AV_PIX_FMT_YUV420P && out->format != AV_PIX_FMT_YUVJ420P) {
-                av_log(ctx, AV_LOG_ERROR, "Error: support yuv420p and yuvj420p only, current fmt %d\n",
-                        out->format);
-                ret = AVERROR(EINVAL);
-                goto failed_out;
-            }
-            nb_planes = 1; // only copy Y data
-            // copy U/V data from the input sw frame
-            memcpy(out->data[1], in->data[1], in->height * in->linesize[1] / 2);
-            memcpy(out->data[2], in->data[2], in->height * in->linesize[2] / 2);
+        ret = config_input(ctx, in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "Error: failed to config input\n");
+            av_frame_free(&in);
+            return ret;
         }
-        // sw frame: step 6: crop
-        retval = ni_to_avframe_copy(s, out, &ai_ctx->api_dst_frame.data.packet, nb_planes);
-        if (retval < 0) {
-            av_log(ctx, AV_LOG_ERROR, "Error: hvsplus cannot copy ai frame to avframe\n");
-            ret = AVERROR(EIO);
-            goto failed_out;
+        if (hwframe) {
+            av_hwframe_ctx_init(s->out_frames_ref);
+            AVHWFramesContext *out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
+            AVNIFramesContext *out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
+            ni_cpy_hwframe_ctx(pAVHFWCtx, out_frames_ctx);
+            ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
         }
     }
 
-    av_frame_free(&in);
-    return ff_filter_frame(link->dst->outputs[0], out);
-
-failed_out:
-    if (out)
-        av_frame_free(&out);
+    ret = hvsplus_submit(ctx, in);
+    if (ret < 0)
+        return ret;
 
-    av_frame_free(&in);
-    return ret;
+    /* with depth 1 this reads the frame just submitted */
+    while (ff_ni_ai_pipe_full(&s->pipe)) {
+        ret = hvsplus_complete(ctx, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
 }
 
 static int filter_frame(AVFilterLink *link, AVFrame *in)
@@ -1807,6 +1544,52 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     return ret;
 }
 
+#if IS_FFMPEG_61_AND_ABOVE
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    NetIntHvsplusContext *s = ctx->priv;
+    AVFrame *frame = NULL;
+    int ret;
+    int status;
+    int64_t pts;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    /* send out the frames whose result is already there */
+    ret = ff_ni_ai_pipe_complete_ready(ctx, &s->pipe, hvsplus_complete);
+    if (ret < 0)
+        return ret;
+
+    if (ff_inlink_check_available_frame(inlink)) {
+        ret = ff_inlink_consume_frame(inlink, &frame);
+        if (ret < 0)
+            return ret;
+
+        ret = filter_frame(inlink, frame);
+        if (ret >= 0)
+            ff_filter_set_ready(ctx, 100);
+        return ret;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        // Read back the frames still in flight before forwarding EOF
+        while (s->pipe.count) {
+            ret = hvsplus_complete(ctx, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+#endif
+
 #define OFFSET(x) offsetof(NetIntHvsplusContext, x)
 #define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM)
 
@@ -1819,6 +1602,7 @@ static const AVOption ni_hvsplus_options[] = {
         { "YUV",    "process channels Y, U, and V", 0, AV_OPT_TYPE_CONST, {.i64 = 0}, 0, 0, FLAGS, "mode" },
         { "Y_only", "process only channel Y",       0, AV_OPT_TYPE_CONST, {.i64 = 1}, 0, 0, FLAGS, "mode" },
     { "timeout", "Timeout for AI operations",         OFFSET(ai_timeout),   AV_OPT_TYPE_INT,  {.i64 = NI_DEFAULT_KEEP_ALIVE_TIMEOUT}, NI_MIN_KEEP_ALIVE_TIMEOUT, NI_MAX_KEEP_ALIVE_TIMEOUT, FLAGS, "AI_timeout" },
+    NI_AI_PIPE_OPTION_DEPTH,
     NI_FILT_OPTION_KEEPALIVE10,
     NI_FILT_OPTION_BUFFER_LIMIT,
     { NULL }
@@ -1854,6 +1638,9 @@ AVFilter ff_vf_hvsplus_ni_quadra = {
     .description    = NULL_IF_CONFIG_SMALL("NETINT Quadra hvsplus v" NI_XCODER_REVISION),
     .init           = init,
     .uninit         = uninit,
+#if IS_FFMPEG_61_AND_ABOVE
+    .activate       = activate,
+#endif
     .priv_size      = sizeof(NetIntHvsplusContext),
     .priv_class     = &ni_hvsplus_class,
     .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
@@ -33,6 +33,8 @@ typedef struct HWDownloadContext {
 
     AVBufferRef       *hwframes_ref;
     AVHWFramesContext *hwframes;
+
+    int                zerocopy;
 } HWDownloadContext;
 
 static int hwdownload_query_formats(AVFilterContext *avctx)
@@ -129,8 +131,15 @@ static int hwdownload_filter_frame(AVFilterLink *link, AVFrame *input)
         goto fail;
     }
 
-    output = ff_get_video_buffer(outlink, ctx->hwframes->width,
-                                 ctx->hwframes->height);
+    if (ctx->zerocopy) {
+        /* let the device hand out the buffers it downloads into, if it can */
+        output = av_frame_alloc();
+        if (output)
+            output->format = outlink->format;
+    } else {
+        output = ff_get_video_buffer(outlink, ctx->hwframes->width,
+                                     ctx->hwframes->height);
+    }
     if (!output) {
         err = AVERROR(ENOMEM);
         goto fail;
@@ -166,10 +175,18 @@ static av_cold void hwdownload_uninit(AVFilterContext *avctx)
     av_buffer_unref(&ctx->hwframes_ref);
 }
 
+#define OFFSET(x) offsetof(HWDownloadContext, x)
+#define FLAGS (AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption hwdownload_options[] = {
+    { "zerocopy", "Output the buffers frames are downloaded into when the device supports it",
+      OFFSET(zerocopy), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { NULL }
+};
+
 static const AVClass hwdownload_class = {
     .class_name = "hwdownload",
     .item_name  = av_default_item_name,
-    .option     = NULL,
+    .option     = hwdownload_options,
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
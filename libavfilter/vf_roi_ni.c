@@ -38,6 +38,7 @@
 #endif
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/file_open.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
@@ -45,25 +46,15 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "libswscale/swscale.h"
+#include "ni_ai_pipe.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
+#include "ni_yolo.h"
 #include "nifilter.h"
 #include "video.h"
 
 #define NI_NUM_FRAMES_IN_QUEUE 8
 
-typedef struct _ni_roi_network_layer {
-    int32_t width;
-    int32_t height;
-    int32_t channel;
-    int32_t classes;
-    int32_t component;
-    int32_t mask[3];
-    float biases[12];
-    int32_t output_number;
-    float *output;
-} ni_roi_network_layer_t;
-
 typedef struct _ni_roi_network {
     int32_t netw;
     int32_t neth;
@@ -71,37 +62,6 @@ typedef struct _ni_roi_network {
     ni_roi_network_layer_t *layers;
 } ni_roi_network_t;
 
-typedef struct box {
-    float x, y, w, h;
-} box;
-
-typedef struct detection {
-    box bbox;
-    float objectness;
-    int classes;
-    int color;
-    float *prob;
-    int prob_class;
-    float max_prob;
-} detection;
-
-typedef struct detetion_cache {
-    detection *dets;
-    int capacity;
-    int dets_num;
-} detection_cache;
-
-struct roi_box {
-    int left;
-    int right;
-    int top;
-    int bottom;
-    int color;
-    float objectness;
-    int cls;
-    float prob;
-};
-
 typedef struct HwScaleContext {
     ni_session_context_t api_ctx;
     ni_session_data_io_t api_dst_frame;
@@ -121,19 +81,24 @@ typedef struct NetIntRoiContext {
     int devid;
     float obj_thresh;
     float nms_thresh;
+    char *layer_dump;     /* file to write the network output of each frame to */
+    FILE *layer_dump_file;
 
     AiContext *ai_ctx;
 
     AVBufferRef *out_frames_ref;
 
     ni_roi_network_t network;
-    detection_cache det_cache;
+    NIYoloContext yolo;
     struct SwsContext *img_cvt_ctx;
     AVFrame rgb_picture;
 
     HwScaleContext *hws_ctx;
     int keep_alive_timeout; /* keep alive timeout setting */
     int buffer_limit;
+
+    int depth;              /* frames in flight on the AI engine */
+    NIAIPipe pipe;
 } NetIntRoiContext;
 
 /* class */
@@ -144,353 +109,6 @@ typedef struct NetIntRoiContext {
 static int g_masks[2][3] = {{3, 4, 5}, {0, 1, 2}};
 static float g_biases[] = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
 
-static int entry_index(ni_roi_network_layer_t *l, int batch, int location,
-                       int entry)
-{
-    int n   = location / (l->width * l->height);
-    int loc = location % (l->width * l->height);
-    return batch * l->output_number +
-           n * l->width * l->height * (4 + l->classes + 1) +
-           entry * l->width * l->height + loc;
-}
-
-static inline float sigmoid(float x)
-{
-    return (float)(1.0 / (1.0 + (float)exp((double)(-x))));
-}
-
-/*
- * nw: network input width
- * nh: network input height
- * lw: layer width
- * lh: layer height
- */
-static box get_yolo_box(float *x, float *biases, int n, int index, int col,
-                        int row, int lw, int lh, int nw, int nh, int stride)
-{
-    box b;
-
-    b.x = (float)((float)col + sigmoid(x[index + 0 * stride])) / (float)lw;
-    b.y = (float)((float)row + sigmoid(x[index + 1 * stride])) / (float)lh;
-    b.w = (float)exp((double)x[index + 2 * stride]) * biases[2 * n] / (float)nw;
-    b.h = (float)exp((double)x[index + 3 * stride]) * biases[2 * n + 1] /
-          (float)nh;
-
-    b.x -= (float)(b.w / 2.0);
-    b.y -= (float)(b.h / 2.0);
-
-    return b;
-}
-
-static int get_yolo_detections(void *ctx, ni_roi_network_layer_t *l, int netw,
-                               int neth, float thresh,
-                               detection_cache *det_cache, int *dets_num)
-{
-    int i, n, k;
-    float *predictions = l->output;
-    float max_prob;
-    int prob_class;
-    // This snippet below is not necessary
-    // Need to comment it in order to batch processing >= 2 images
-    // if (l.batch == 2) avg_flipped_yolo(l);
-    int count       = 0;
-    detection *dets = det_cache->dets;
-    int row;
-    int col;
-    int obj_index;
-    float objectness;
-    int class_index;
-    double prob;
-    int box_index;
-    box bbox;
-
-    *dets_num = 0;
-
-    av_log(ctx, AV_LOG_TRACE,
-           "pic %dx%d, comp=%d, class=%d, net %dx%d, thresh=%f\n", l->width,
-           l->height, l->component, l->classes, netw, neth, thresh);
-    for (i = 0; i < l->width * l->height; ++i) {
-        row = i / l->width;
-        col = i % l->width;
-        for (n = 0; n < l->component; ++n) {
-            obj_index = entry_index(l, 0, n * l->width * l->height + i, 4);
-            objectness = predictions[obj_index];
-            objectness       = sigmoid(objectness);
-
-            prob_class = -1;
-            max_prob   = thresh;
-            for (k = 0; k < l->classes; k++) {
-                class_index =
-                    entry_index(l, 0, n * l->width * l->height + i, 4 + 1 + k);
-                prob = objectness * sigmoid(predictions[class_index]);
-                if (prob >= max_prob) {
-                    prob_class = k;
-                    max_prob   = (float)prob;
-                }
-            }
-
-            if (prob_class >= 0) {
-                box_index =
-                    entry_index(l, 0, n * l->width * l->height + i, 0);
-
-                if (det_cache->dets_num >= det_cache->capacity) {
-                    dets =
-                        av_realloc(det_cache->dets,
-                                   sizeof(detection) * (det_cache->capacity + 10));
-                    if (!dets) {
-                        av_log(ctx, AV_LOG_ERROR,
-                               "failed to realloc detections capacity %d\n",
-                               det_cache->capacity);
-                        return AVERROR(ENOMEM);
-                    }
-                    det_cache->dets = dets;
-                    det_cache->capacity += 10;
-                    if (det_cache->capacity >= 100) {
-                        av_log(ctx, AV_LOG_WARNING, "too many detections %d\n",
-                               det_cache->dets_num);
-                    }
-                }
-
-                av_log(ctx, AV_LOG_TRACE, "max_prob %f, class %d\n", max_prob,
-                       prob_class);
-                bbox = get_yolo_box(predictions, l->biases, l->mask[n],
-                                    box_index, col, row, l->width, l->height,
-                                    netw, neth, l->width * l->height);
-
-                dets[det_cache->dets_num].max_prob   = max_prob;
-                dets[det_cache->dets_num].prob_class = prob_class;
-                dets[det_cache->dets_num].bbox       = bbox;
-                dets[det_cache->dets_num].objectness = objectness;
-                dets[det_cache->dets_num].classes    = l->classes;
-                dets[det_cache->dets_num].color      = n;
-
-                av_log(ctx, AV_LOG_TRACE, "%d, x %f, y %f, w %f, h %f\n",
-                       det_cache->dets_num, dets[det_cache->dets_num].bbox.x,
-                       dets[det_cache->dets_num].bbox.y,
-                       dets[det_cache->dets_num].bbox.w,
-                       dets[det_cache->dets_num].bbox.h);
-                det_cache->dets_num++;
-                count++;
-            }
-        }
-    }
-    *dets_num = count;
-    return 0;
-}
-
-static int nms_comparator(const void *pa, const void *pb)
-{
-    detection *a = (detection *)pa;
-    detection *b = (detection *)pb;
-
-    if (a->prob_class > b->prob_class)
-        return 1;
-    else if (a->prob_class < b->prob_class)
-        return -1;
-    else {
-        if (a->max_prob < b->max_prob)
-            return 1;
-        else if (a->max_prob > b->max_prob)
-            return -1;
-    }
-    return 0;
-}
-
-static float overlap(float x1, float w1, float x2, float w2)
-{
-    float l1    = x1 - w1 / 2;
-    float l2    = x2 - w2 / 2;
-    float left  = l1 > l2 ? l1 : l2;
-    float r1    = x1 + w1 / 2;
-    float r2    = x2 + w2 / 2;
-    float right = r1 < r2 ? r1 : r2;
-    return right - left;
-}
-
-static float box_intersection(box a, box b)
-{
-    float w = overlap(a.x, a.w, b.x, b.w);
-    float h = overlap(a.y, a.h, b.y, b.h);
-    float area;
-
-    if (w < 0 || h < 0)
-        return 0;
-
-    area = w * h;
-    return area;
-}
-
-static float box_union(box a, box b)
-{
-    float i = box_intersection(a, b);
-    float u = a.w * a.h + b.w * b.h - i;
-    return u;
-}
-
-static float box_iou(box a, box b)
-{
-    // return box_intersection(a, b)/box_union(a, b);
-
-    float I = box_intersection(a, b);
-    float U = box_union(a, b);
-    if (I == 0 || U == 0)
-        return 0;
-
-    return I / U;
-}
-
-static int nms_sort(void *ctx, detection *dets, int dets_num, float nms_thresh)
-{
-    int i, j;
-    box boxa, boxb;
-    int class;
-
-    for (i = 0; i < (dets_num - 1); i++) {
-        class = dets[i].prob_class;
-        if (dets[i].max_prob == 0)
-            continue;
-
-        if (dets[i].prob_class != dets[i + 1].prob_class)
-            continue;
-
-        boxa = dets[i].bbox;
-        for (j = i + 1; j < dets_num && dets[j].prob_class == class; j++) {
-            if (dets[j].max_prob == 0)
-                continue;
-
-            boxb = dets[j].bbox;
-            if (box_iou(boxa, boxb) > nms_thresh)
-                dets[j].max_prob = 0;
-        }
-    }
-
-    return 0;
-}
-
-static int resize_coords(void *ctx, detection *dets, int dets_num,
-                         uint32_t img_width, uint32_t img_height,
-                         struct roi_box **roi_box, int *roi_num)
-{
-    int i;
-    int left, right, top, bot;
-    struct roi_box *rbox;
-    int rbox_num = 0;
-
-    if (dets_num == 0) {
-        return 0;
-    }
-
-    rbox = av_malloc(sizeof(struct roi_box) * dets_num);
-    if (!rbox)
-        return AVERROR(ENOMEM);
-
-    for (i = 0; i < dets_num; i++) {
-        av_log(ctx, AV_LOG_TRACE, "index %d, max_prob %f, class %d\n", i,
-               dets[i].max_prob, dets[i].prob_class);
-        if (dets[i].max_prob == 0)
-            continue;
-
-        top   = (int)floor(dets[i].bbox.y * img_height + 0.5);
-        left  = (int)floor(dets[i].bbox.x * img_width + 0.5);
-        right = (int)floor((dets[i].bbox.x + dets[i].bbox.w) * img_width + 0.5);
-        bot = (int)floor((dets[i].bbox.y + dets[i].bbox.h) * img_height + 0.5);
-
-        if (top < 0)
-            top = 0;
-
-        if (left < 0)
-            left = 0;
-
-        if (right > img_width)
-            right = img_width;
-
-        if (bot > img_height)
-            bot = img_height;
-
-        av_log(ctx, AV_LOG_DEBUG, "top %d, left %d, right %d, bottom %d\n", top,
-               left, right, bot);
-
-        rbox[rbox_num].left       = left;
-        rbox[rbox_num].right      = right;
-        rbox[rbox_num].top        = top;
-        rbox[rbox_num].bottom     = bot;
-        rbox[rbox_num].cls        = dets[i].prob_class;
-        rbox[rbox_num].objectness = dets[i].objectness;
-        rbox[rbox_num].color      = dets[i].color;
-        rbox[rbox_num].prob       = dets[i].max_prob;
-        rbox_num++;
-    }
-
-    if (rbox_num == 0) {
-        av_freep(&rbox);
-        *roi_num = rbox_num;
-        *roi_box = NULL;
-    } else {
-        *roi_num = rbox_num;
-        *roi_box = rbox;
-    }
-
-    return 0;
-}
-
-static int ni_get_detections(void *ctx, ni_roi_network_t *network,
-                             detection_cache *det_cache, uint32_t img_width,
-                             uint32_t img_height, float obj_thresh,
-                             float nms_thresh, struct roi_box **roi_box,
-                             int *roi_num)
-{
-    int i;
-    int ret;
-    int dets_num    = 0;
-    detection *dets = NULL;
-
-    *roi_box = NULL;
-    *roi_num = 0;
-
-    for (i = 0; i < network->raw.output_num; i++) {
-        ret = get_yolo_detections(ctx, &network->layers[i], network->netw,
-                                  network->neth, obj_thresh, det_cache,
-                                  &dets_num);
-        if (ret != 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to get yolo detection at layer %d\n", i);
-            return ret;
-        }
-        av_log(ctx, AV_LOG_TRACE, "layer %d, yolo detections: %d\n", i,
-               dets_num);
-    }
-
-    if (det_cache->dets_num == 0)
-        return 0;
-
-    dets     = det_cache->dets;
-    dets_num = det_cache->dets_num;
-    for (i = 0; i < dets_num; i++) {
-        av_log(ctx, AV_LOG_TRACE,
-               "orig dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
-               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
-               dets[i].prob_class, dets[i].max_prob);
-    }
-
-    qsort(dets, dets_num, sizeof(detection), nms_comparator);
-    for (i = 0; i < dets_num; i++) {
-        av_log(ctx, AV_LOG_TRACE,
-               "sorted dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
-               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
-               dets[i].prob_class, dets[i].max_prob);
-    }
-
-    nms_sort(ctx, dets, dets_num, nms_thresh);
-    ret = resize_coords(ctx, dets, dets_num, img_width, img_height, roi_box,
-                        roi_num);
-    if (ret != 0) {
-        av_log(ctx, AV_LOG_ERROR, "cannot resize coordinates\n");
-        return ret;
-    }
-
-    return 0;
-}
-
 static int query_formats(AVFilterContext *ctx)
 {
     static const enum AVPixelFormat pix_fmts[] = {
@@ -735,7 +353,8 @@ static av_cold int init_hwframe_scale(AVFilterContext *ctx, NetIntRoiContext *s,
     AVHWFramesContext *pAVHFWCtx;
     AVNIDeviceContext *pAVNIDevCtx;
     int cardno;
-    int pool_size = DEFAULT_NI_FILTER_POOL_SIZE;
+    /* the scaled frames in flight stay allocated until read back */
+    int pool_size = DEFAULT_NI_FILTER_POOL_SIZE + s->pipe.depth - 1;
 
     hws_ctx = av_mallocz(sizeof(HwScaleContext));
     if (!hws_ctx) {
@@ -810,13 +429,30 @@ static void cleanup_hwframe_scale(AVFilterContext *ctx, NetIntRoiContext *s)
 static av_cold int init(AVFilterContext *ctx)
 {
     NetIntRoiContext *s = ctx->priv;
+    int ret;
+
+#if !IS_FFMPEG_61_AND_ABOVE
+    /* frames in flight can only be flushed from activate() */
+    s->depth = 1;
+#endif
+    ret = ff_ni_ai_pipe_init(&s->pipe, s->depth);
+    if (ret < 0)
+        return ret;
 
-    s->det_cache.dets_num = 0;
-    s->det_cache.capacity = 20;
-    s->det_cache.dets     = av_malloc(sizeof(detection) * s->det_cache.capacity);
-    if (!s->det_cache.dets) {
+    ret = ff_ni_yolo_init(&s->yolo);
+    if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to allocate detection cache\n");
-        return AVERROR(ENOMEM);
+        return ret;
+    }
+
+    if (s->layer_dump) {
+        s->layer_dump_file = avpriv_fopen_utf8(s->layer_dump, "wb");
+        if (!s->layer_dump_file) {
+            ret = AVERROR(errno);
+            av_log(ctx, AV_LOG_ERROR, "failed to open layer dump file %s\n",
+                   s->layer_dump);
+            return ret;
+        }
     }
 
     return 0;
@@ -827,11 +463,19 @@ static av_cold void uninit(AVFilterContext *ctx)
     NetIntRoiContext *s       = ctx->priv;
     ni_roi_network_t *network = &s->network;
 
+    ff_ni_ai_pipe_log_stats(ctx, &s->pipe);
+    ff_ni_ai_pipe_uninit(&s->pipe);
+
     cleanup_ai_context(ctx, s);
 
     ni_destroy_network(ctx, network);
 
-    av_freep(&s->det_cache.dets);
+    ff_ni_yolo_uninit(&s->yolo);
+
+    if (s->layer_dump_file) {
+        fclose(s->layer_dump_file);
+        s->layer_dump_file = NULL;
+    }
 
     av_buffer_unref(&s->out_frames_ref);
     s->out_frames_ref = NULL;
@@ -854,6 +498,8 @@ static int config_input(AVFilterContext *ctx, AVFrame *frame)
     if (s->initialized)
         return 0;
 
+    ff_ni_ai_pipe_fit_input(ctx, &s->pipe, frame);
+
     ret = init_ai_context(ctx, s, frame);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to initialize ai context\n");
@@ -898,6 +544,9 @@ static int config_input(AVFilterContext *ctx, AVFrame *frame)
         out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
         ni_cpy_hwframe_ctx(in_frames_ctx, out_frames_ctx);
         ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
+        /* the input frames are passed on */
+        out_ni_ctx->pool_size =
+            ((AVNIFramesContext *)in_frames_ctx->hwctx)->pool_size;
     }
 
     s->initialized = 1;
@@ -1026,12 +675,24 @@ static int ni_read_roi(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
         }
     }
 
+    if (s->layer_dump_file) {
+        ret = ff_ni_yolo_dump_layers(s->layer_dump_file, network->layers,
+                                     network->raw.output_num, network->netw,
+                                     network->neth);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to write layer dump\n");
+            return ret;
+        }
+    }
+
     width  = pic_width;
     height = pic_height;
 
-    s->det_cache.dets_num = 0;
-    ret = ni_get_detections(ctx, network, &s->det_cache, width, height,
-                            s->obj_thresh, s->nms_thresh, &roi_box, &roi_num);
+    ret = ff_ni_yolo_get_detections(ctx, &s->yolo, network->layers,
+                                    network->raw.output_num, network->netw,
+                                    network->neth, width, height,
+                                    s->obj_thresh, s->nms_thresh, &roi_box,
+                                    &roi_num);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to get roi.\n");
         return ret;
@@ -1205,51 +866,75 @@ static int ni_hwframe_scale(AVFilterContext *ctx, NetIntRoiContext *s,
     return 0;
 }
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+/* read the result of the oldest frame in flight and send it out, unless
+ * wait is 0 and it is not there yet */
+static int roi_complete(AVFilterContext *ctx, int wait)
 {
-    AVFilterContext *ctx = link->dst;
-    NetIntRoiContext *s  = ctx->priv;
-    AVFrame *out         = NULL;
-    ni_roi_network_t *network;
+    NetIntRoiContext *s = ctx->priv;
+    AiContext *ai_ctx   = s->ai_ctx;
+    NIAIPipeEntry *e    = ff_ni_ai_pipe_head(&s->pipe);
+    AVFrame *out;
     ni_retcode_t retval;
     int ret;
-    AiContext *ai_ctx;
-
-    if (in == NULL) {
-        av_log(ctx, AV_LOG_WARNING, "in frame is null\n");
-        return AVERROR(EINVAL);
-    }
-
-    if (!s->initialized) {
-#if IS_FFMPEG_71_AND_ABOVE
-        AVFilterLink *outlink = link->dst->outputs[0];
-        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
-           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
-        }
-#endif
-        ret = config_input(ctx, in);
-        if (ret) {
-            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
-            goto failed_out;
-        }
-    }
 
-    ai_ctx  = s->ai_ctx;
-    network = &s->network;
-    retval  = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
-                                       &network->raw);
+    retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
+                                       &s->network.raw);
     if (retval != NI_RETCODE_SUCCESS) {
         av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
         ret = AVERROR(EAGAIN);
         goto failed_out;
     }
 
-    out = av_frame_clone(in);
-    if (!out) {
-        ret = AVERROR(ENOMEM);
+    ret = ff_ni_ai_pipe_read(ctx, &s->pipe, &ai_ctx->api_ctx,
+                             &ai_ctx->api_dst_pkt, 0,
+                             wait ? 0 : NI_AI_PIPE_NO_WAIT);
+    if (ret == AVERROR(EAGAIN))
+        return ret;
+    if (ret < 0)
+        goto failed_out;
+
+    out = e->frame;
+    ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out, out->width,
+                      out->height);
+    if (ret != 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to read roi from packet\n");
         goto failed_out;
     }
 
+    if (out->format == AV_PIX_FMT_NI_QUAD) {
+        av_buffer_unref(&out->hw_frames_ctx);
+        /* Reference the new hw frames context */
+        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+    }
+
+#ifdef NI_MEASURE_LATENCY
+    ff_ni_update_benchmark("ni_quadra_roi");
+#endif
+
+    e->frame = NULL;
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ff_filter_frame(ctx->outputs[0], out);
+
+failed_out:
+    ff_ni_ai_pipe_pop(&s->pipe);
+    return ret;
+}
+
+/* send a frame to the network, the pipe must not be full */
+static int roi_submit(AVFilterContext *ctx, AVFrame *in)
+{
+    NetIntRoiContext *s = ctx->priv;
+    AiContext *ai_ctx   = s->ai_ctx;
+    ni_roi_network_t *network = &s->network;
+    NIAIPipeEntry *e;
+    AVFrame *out = NULL;
+    ni_retcode_t retval;
+    int ret;
+
+    out = av_frame_clone(in);
+    if (!out)
+        return AVERROR(ENOMEM);
+
 #ifdef NI_MEASURE_LATENCY
     ff_ni_update_benchmark(NULL);
 #endif
@@ -1274,34 +959,15 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                                        NI_DEVICE_TYPE_AI);
         if (retval != NI_RETCODE_SUCCESS) {
             av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
+            ni_hwframe_buffer_recycle(filt_frame_surface,
+                                      filt_frame_surface->device_handle);
             ret = AVERROR(ENOMEM);
             goto failed_out;
         }
 
-        do {
-            retval = ni_device_session_read(
-                &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-            if (retval < 0) {
-                av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                ret = AVERROR(EIO);
-                goto failed_out;
-            } else if (retval > 0) {
-                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out, out->width,
-                                  out->height);
-                if (ret != 0) {
-                    av_log(ctx, AV_LOG_ERROR,
-                           "failed to read roi from packet\n");
-                    goto failed_out;
-                }
-            }
-        } while (retval == 0);
-
-        ni_hwframe_buffer_recycle(filt_frame_surface,
-                                  filt_frame_surface->device_handle);
-
-        av_buffer_unref(&out->hw_frames_ctx);
-        /* Reference the new hw frames context */
-        out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+        /* the scaled frame is read by the network until the result is */
+        e = ff_ni_ai_pipe_push(&s->pipe, out);
+        e->surface = *filt_frame_surface;
     } else {
         ret = sws_scale(s->img_cvt_ctx, (const uint8_t *const *)in->data,
                         in->linesize, 0, in->height, s->rgb_picture.data,
@@ -1326,7 +992,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             goto failed_out;
         }
 
-        /* write frame */
+        /* write frame, making room by completing the frames in flight */
         do {
             retval = ni_device_session_write(
                 &ai_ctx->api_ctx, &ai_ctx->api_src_frame, NI_DEVICE_TYPE_AI);
@@ -1335,42 +1001,62 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                        "failed to write ai session: retval %d\n", retval);
                 ret = AVERROR(EIO);
                 goto failed_out;
-            }
-        } while (retval == 0);
-
-        /* read roi result */
-        do {
-            retval = ni_device_session_read(
-                &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-            if (retval < 0) {
-                av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                ret = AVERROR(EIO);
-                goto failed_out;
-            } else if (retval > 0) {
-                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out, out->width,
-                                  out->height);
-                if (ret != 0) {
-                    av_log(ctx, AV_LOG_ERROR,
-                           "failed to read roi from packet\n");
+            } else if (retval == 0 && s->pipe.count) {
+                ret = roi_complete(ctx, 1);
+                if (ret < 0)
                     goto failed_out;
-                }
             }
         } while (retval == 0);
-    }
 
-#ifdef NI_MEASURE_LATENCY
-    ff_ni_update_benchmark("ni_quadra_roi");
-#endif
+        e = ff_ni_ai_pipe_push(&s->pipe, out);
+    }
 
-    av_frame_free(&in);
-    return ff_filter_frame(link->dst->outputs[0], out);
+    e->submitted = 1;
+    return 0;
 
 failed_out:
-    if (out)
-        av_frame_free(&out);
+    av_frame_free(&out);
+    return ret;
+}
 
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntRoiContext *s  = ctx->priv;
+    int ret;
+
+    if (in == NULL) {
+        av_log(ctx, AV_LOG_WARNING, "in frame is null\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (!s->initialized) {
+#if IS_FFMPEG_71_AND_ABOVE
+        AVFilterLink *outlink = link->dst->outputs[0];
+        if (!((av_strstart(outlink->dst->filter->name, "ni_quadra", NULL)) || (av_strstart(outlink->dst->filter->name, "hwdownload", NULL)))) {
+           ctx->extra_hw_frames = (DEFAULT_FRAME_THREAD_QUEUE_SIZE > 1) ? DEFAULT_FRAME_THREAD_QUEUE_SIZE : 0;
+        }
+#endif
+        ret = config_input(ctx, in);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to config input\n");
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+
+    ret = roi_submit(ctx, in);
     av_frame_free(&in);
-    return ret;
+    if (ret < 0)
+        return ret;
+
+    /* with depth 1 this reads the frame just submitted */
+    while (ff_ni_ai_pipe_full(&s->pipe)) {
+        ret = roi_complete(ctx, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
 }
 
 #if IS_FFMPEG_61_AND_ABOVE
@@ -1380,11 +1066,18 @@ static int activate(AVFilterContext *ctx)
     AVFilterLink  *outlink = ctx->outputs[0];
     AVFrame *frame = NULL;
     int ret = 0;
+    int status;
+    int64_t pts;
     NetIntRoiContext *s = inlink->dst->priv;
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    /* send out the frames whose result is already there */
+    ret = ff_ni_ai_pipe_complete_ready(ctx, &s->pipe, roi_complete);
+    if (ret < 0)
+        return ret;
+
     if (ff_inlink_check_available_frame(inlink)) {
         if (s->initialized) {
             if (s->hws_ctx) {
@@ -1412,7 +1105,16 @@ static int activate(AVFilterContext *ctx)
     }
 
     // We did not get a frame from input link, check its status
-    FF_FILTER_FORWARD_STATUS(inlink, outlink);
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        // Read back the frames still in flight before forwarding EOF
+        while (s->pipe.count) {
+            ret = roi_complete(ctx, 1);
+            if (ret < 0)
+                return ret;
+        }
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
 
     // We have no frames yet from input link and no EOF, so request some.
     FF_FILTER_FORWARD_WANTED(outlink, inlink);
@@ -1430,6 +1132,8 @@ static const AVOption ni_roi_options[] = {
     { "devid",      "device to operate in swframe mode",        OFFSET(devid),      AV_OPT_TYPE_INT,      {.i64 = 0},    -1,       INT_MAX,  FLAGS, "range" },
     { "obj_thresh", "objectness threshold",                     OFFSET(obj_thresh), AV_OPT_TYPE_FLOAT,    {.dbl = 0.25}, -FLT_MAX, FLT_MAX,  FLAGS, "range" },
     { "nms_thresh", "yolov4 non-maximum suppression threshold", OFFSET(nms_thresh), AV_OPT_TYPE_FLOAT,    {.dbl = 0.45}, -FLT_MAX, FLT_MAX,  FLAGS, "range" },
+    { "layer_dump", "write the network output to a file",       OFFSET(layer_dump), AV_OPT_TYPE_STRING,   {.str = NULL}, 0,        0,        FLAGS },
+    NI_AI_PIPE_OPTION_DEPTH,
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
 {NULL}};
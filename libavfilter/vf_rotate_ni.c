@@ -416,6 +416,8 @@ static int init_out_pool(AVFilterContext *ctx)
 #if IS_FFMPEG_61_AND_ABOVE
     rot->buffer_limit = 1;
 #endif
+    ((AVNIFramesContext *)out_frames_context->hwctx)->pool_size = pool_size;
+
     /* Create frame pool on device */
     return ff_ni_build_frame_pool(&rot->api_ctx,
                                   out_frames_context->width,
@@ -24,6 +24,7 @@
  * audio and video splitter
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 
 #include "libavutil/attributes.h"
@@ -62,6 +63,10 @@ typedef struct NetIntSplitContext {
     int frame_contexts_applied;
     ni_split_context_t src_ctx;
     AVBufferRef *out_frames_ref[3];
+
+    int fanout;
+    uint64_t nb_frames;         /* input frames fanned out */
+    uint64_t nb_outputs_served; /* output frames sharing a surface */
 } NetIntSplitContext;
 
 #if IS_FFMPEG_342_AND_ABOVE
@@ -162,6 +167,10 @@ static av_cold void split_uninit(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
 
+    if (s->fanout && s->nb_frames)
+        av_log(ctx, AV_LOG_VERBOSE, "Fan-out: %" PRIu64 " frames to %" PRIu64
+               " outputs\n", s->nb_frames, s->nb_outputs_served);
+
     for (i = 0; i < 3; i++) {
         if (s->out_frames_ref[i])
             av_buffer_unref(&s->out_frames_ref[i]);
@@ -232,6 +241,20 @@ static int config_input(AVFilterLink *inlink, AVFrame *in)
     return 0;
 }
 
+static int ppu_nb_outputs(NetIntSplitContext *s, int ppu)
+{
+    return ppu == 0 ? s->nb_output0 : ppu == 1 ? s->nb_output1 : s->nb_output2;
+}
+
+static int output_ppu(NetIntSplitContext *s, int output)
+{
+    if (output < s->nb_output0)
+        return 0;
+    if (output < s->nb_output0 + s->nb_output1)
+        return 1;
+    return 2;
+}
+
 #if IS_FFMPEG_342_AND_ABOVE
 static int init_out_hwctxs(AVFilterContext *ctx)
 #else
@@ -266,6 +289,11 @@ static int init_out_hwctxs(AVFilterContext *ctx, AVFrame *in)
 
     if (s->src_ctx.enabled == 1) {
         for (i = 0; i < 3; i++) {
+            /* in fan-out mode only the PPU outputs with consumers get a
+             * frames context */
+            if (s->fanout && !ppu_nb_outputs(s, i))
+                continue;
+
             s->out_frames_ref[i] =
                 av_hwframe_ctx_alloc(in_frames_ctx->device_ref);
             if (!s->out_frames_ref[i])
@@ -431,6 +459,114 @@ static int config_output(AVFilterLink *link, AVFrame *in)
     return 0;
 }
 
+static int output_is_closed(AVFilterContext *ctx, int i)
+{
+#if IS_FFMPEG_70_AND_ABOVE
+    FilterLinkInternal* const li = ff_link_internal(ctx->outputs[i]);
+    return !!li->status_in;
+#elif IS_FFMPEG_342_AND_ABOVE
+    return !!ctx->outputs[i]->status_in;
+#else
+    return !!ctx->outputs[i]->status;
+#endif
+}
+
+/*
+ * Fan-out of a decoder frame: the frame is split into one frame per PPU
+ * output, whose surface, frames context and dimensions are set up once, and
+ * the outputs of a PPU get references to it. The last output of a PPU takes
+ * the frame itself rather than a clone. The input frame is left empty.
+ */
+static int filter_ni_frame_fanout(AVFilterContext *ctx, AVFrame *frame)
+{
+    NetIntSplitContext *s = ctx->priv;
+    AVFrame *ppu_frame[3] = { NULL };
+    int nb_live[3] = { 0 };
+    niFrameSurface1_t *p_data3;
+    int i, j, ret = AVERROR_EOF;
+
+    for (i = 0; i < ctx->nb_outputs; i++)
+        if (!output_is_closed(ctx, i))
+            nb_live[output_ppu(s, i)]++;
+
+    /* PPU1 and PPU2 surfaces are taken from the input frame before PPU0
+     * takes the frame itself */
+    for (j = 2; j >= 0; j--) {
+        if (!nb_live[j])
+            continue;
+        if (!frame->buf[j]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+
+        ppu_frame[j] = av_frame_alloc();
+        if (!ppu_frame[j]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if (j) {
+            ret = av_frame_copy_props(ppu_frame[j], frame);
+            if (ret < 0)
+                goto end;
+            ppu_frame[j]->format = frame->format;
+            ppu_frame[j]->buf[0] = frame->buf[j];
+            frame->buf[j]        = NULL;
+        } else {
+            av_frame_move_ref(ppu_frame[j], frame);
+            av_buffer_unref(&ppu_frame[j]->buf[1]);
+            av_buffer_unref(&ppu_frame[j]->buf[2]);
+        }
+
+        av_buffer_unref(&ppu_frame[j]->hw_frames_ctx);
+        ppu_frame[j]->hw_frames_ctx = av_buffer_ref(s->out_frames_ref[j]);
+        if (!ppu_frame[j]->hw_frames_ctx) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ppu_frame[j]->data[3] = ppu_frame[j]->buf[0]->data;
+        p_data3 = (niFrameSurface1_t *)ppu_frame[j]->data[3];
+        ppu_frame[j]->width  = p_data3->ui16width;
+        ppu_frame[j]->height = p_data3->ui16height;
+
+        s->nb_outputs_served += nb_live[j];
+    }
+    s->nb_frames++;
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        AVFrame *buf_out;
+
+        if (output_is_closed(ctx, i))
+            continue;
+
+        j = output_ppu(s, i);
+        if (--nb_live[j]) {
+            buf_out = av_frame_clone(ppu_frame[j]);
+            if (!buf_out) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+        } else {
+            buf_out      = ppu_frame[j];
+            ppu_frame[j] = NULL;
+        }
+        ctx->outputs[i]->w = buf_out->width;
+        ctx->outputs[i]->h = buf_out->height;
+
+        av_log(ctx, AV_LOG_DEBUG, "output %d shares PPU%d WxH = %d x %d FID %d\n",
+               i, j, buf_out->width, buf_out->height,
+               ((niFrameSurface1_t *)buf_out->data[3])->ui16FrameIdx);
+
+        ret = ff_filter_frame(ctx->outputs[i], buf_out);
+        if (ret < 0)
+            break;
+    }
+
+end:
+    for (j = 0; j < 3; j++)
+        av_frame_free(&ppu_frame[j]);
+    return ret;
+}
+
 static int filter_ni_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -442,14 +578,24 @@ static int filter_ni_frame(AVFilterLink *inlink, AVFrame *frame)
     if (!s->initialized) {
         for (i = 0; i < 3; i++) {
             AVHWFramesContext *in_frames_ctx = (AVHWFramesContext *)frame->hw_frames_ctx->data;
-            AVHWFramesContext *out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref[i]->data;
+            AVHWFramesContext *out_frames_ctx;
+            AVNIFramesContext *ni_frames_ctx;
+            if (!s->out_frames_ref[i])
+                continue;
+            out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref[i]->data;
             ni_cpy_hwframe_ctx(in_frames_ctx, out_frames_ctx);
-            AVNIFramesContext *ni_frames_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
+            ni_frames_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
             ni_frames_ctx->split_ctx.enabled = 0;
+            /* the outputs are the input frames */
+            ni_frames_ctx->pool_size =
+                ((AVNIFramesContext *)in_frames_ctx->hwctx)->pool_size;
         }
         s->initialized = 1;
     }
 
+    if (s->fanout)
+        return filter_ni_frame_fanout(ctx, frame);
+
     for (i = 0; i < ctx->nb_outputs; i++) {
         AVFrame *buf_out;
 #if IS_FFMPEG_70_AND_ABOVE
@@ -523,6 +669,42 @@ static int filter_std_frame(AVFilterLink *inlink, AVFrame *frame)
         return ret;
     }
 
+    if (s->fanout) {
+        int nb_live = 0;
+
+        for (i = 0; i < ctx->nb_outputs; i++)
+            nb_live += !output_is_closed(ctx, i);
+
+        if (frame->format == AV_PIX_FMT_NI_QUAD && nb_live) {
+            s->nb_frames++;
+            s->nb_outputs_served += nb_live;
+        }
+
+        /* the last output takes the input frame instead of a clone */
+        for (i = 0; i < ctx->nb_outputs; i++) {
+            AVFrame *buf_out;
+
+            if (output_is_closed(ctx, i))
+                continue;
+            if (--nb_live) {
+                buf_out = av_frame_clone(frame);
+            } else {
+                buf_out = av_frame_alloc();
+                if (buf_out)
+                    av_frame_move_ref(buf_out, frame);
+            }
+            if (!buf_out) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+
+            ret = ff_filter_frame(ctx->outputs[i], buf_out);
+            if (ret < 0)
+                break;
+        }
+        return ret;
+    }
+
     for (i = 0; i < ctx->nb_outputs; i++) {
         AVFrame *buf_out;
 #if IS_FFMPEG_70_AND_ABOVE
@@ -671,6 +853,7 @@ static const AVOption ni_split_options[] = {
     { "output0", "Copies of output0", OFFSET(nb_output0), AV_OPT_TYPE_INT, {.i64 = 2}, 0, INT_MAX, FLAGS },
     { "output1", "Copies of output1", OFFSET(nb_output1), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS },
     { "output2", "Copies of output2", OFFSET(nb_output2), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS },
+    { "fanout",  "Set up one frame per PPU output and share it between its outputs", OFFSET(fanout), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -413,6 +413,16 @@ static int transfer_data_alloc(AVFrame *dst, const AVFrame *src, int flags)
         frame_tmp->format = formats[0];
         av_freep(&formats);
     }
+    if (ffhwframesctx(ctx)->hw_type->map_from_is_download &&
+        frame_tmp->format == ctx->sw_format) {
+        ret = ffhwframesctx(ctx)->hw_type->map_from(ctx, frame_tmp, src,
+                                                    AV_HWFRAME_MAP_READ);
+        if (ret >= 0)
+            goto done;
+        if (ret != AVERROR(ENOSYS))
+            goto fail;
+    }
+
     frame_tmp->width  = ctx->width;
     frame_tmp->height = ctx->height;
 
@@ -424,6 +434,7 @@ static int transfer_data_alloc(AVFrame *dst, const AVFrame *src, int flags)
     if (ret < 0)
         goto fail;
 
+done:
     frame_tmp->width  = src->width;
     frame_tmp->height = src->height;
 
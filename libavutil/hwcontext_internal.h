@@ -84,6 +84,14 @@ typedef struct HWContextType {
     int              (*map_from)(AVHWFramesContext *ctx, AVFrame *dst,
                                  const AVFrame *src, int flags);
 
+    /**
+     * Set if map_from() in read-only mode downloads the frame into host
+     * buffers owned by the mapped frame, without keeping a reference to the
+     * source. Transfers into frames without buffers then map instead of
+     * copying into newly allocated buffers.
+     */
+    int                map_from_is_download;
+
     int              (*frames_derive_to)(AVHWFramesContext *dst_ctx,
                                          AVHWFramesContext *src_ctx, int flags);
     int              (*frames_derive_from)(AVHWFramesContext *dst_ctx,
@@ -19,6 +19,8 @@
 #include "config.h"
 
 #include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
@@ -27,11 +29,14 @@
 #include "avassert.h"
 #include "buffer.h"
 #include "common.h"
+#include "cpu.h"
+#include "dict.h"
 #include "hwcontext.h"
 #include "hwcontext_internal.h"
 #include "hwcontext_ni_quad.h"
 #include "libavutil/imgutils.h"
 #include "mem.h"
+#include "ni_copy.h"
 #include "pixdesc.h"
 #include "pixfmt.h"
 
@@ -43,6 +48,38 @@ static enum AVPixelFormat supported_pixel_formats[] = {
     AV_PIX_FMT_BGRP
 };
 
+typedef struct NIDeviceContext {
+    /**
+     * The public AVNIDeviceContext. See hwcontext_ni_quad.h for it.
+     */
+    AVNIDeviceContext p;
+
+    /* threads copying frames between host and device buffers, 0 for auto */
+    int copy_threads;
+} NIDeviceContext;
+
+typedef struct NIFramesContext {
+    /**
+     * The public AVNIFramesContext. See hwcontext_ni_quad.h for it.
+     */
+    AVNIFramesContext p;
+
+    /* NICopyEngine created on the first transfer, most frames contexts never
+     * copy; copy_failed is set when creating it failed */
+    atomic_uintptr_t copy;
+    atomic_int       copy_failed;
+
+    /* buffers handed out by zero-copy downloads, see ni_map_from() */
+    AVBufferPool *dl_pool;
+    int           dl_width;
+    int           dl_height;
+    int           dl_nb_planes;         ///< 0 if the layout is not usable
+    uint32_t      dl_size;
+    uint32_t      dl_len[NI_MAX_NUM_DATA_POINTERS];
+    size_t        dl_offset[NI_MAX_NUM_DATA_POINTERS];
+    int           dl_linesize[4];
+} NIFramesContext;
+
 static inline void ni_frame_free(void *opaque, uint8_t *data)
 {
     if (data) {
@@ -57,7 +94,9 @@ static inline void ni_frame_free(void *opaque, uint8_t *data)
 static int ni_device_create(AVHWDeviceContext *ctx, const char *device,
                             AVDictionary *opts, int flags)
 {
+    NIDeviceContext *priv = ctx->hwctx;
     AVNIDeviceContext *ni_hw_ctx;
+    AVDictionaryEntry *ent;
     char *blk_name;
     int i, module_id = 0, ret = 0;
     ni_device_handle_t fd;
@@ -93,6 +132,17 @@ static int ni_device_create(AVHWDeviceContext *ctx, const char *device,
         ni_hw_ctx->cards[i] = NI_INVALID_DEVICE_HANDLE;
     }
 
+    ent = av_dict_get(opts, "copy_threads", NULL, 0);
+    if (ent) {
+        priv->copy_threads = strtol(ent->value, NULL, 10);
+        if (priv->copy_threads < 0) {
+            av_log(ctx, AV_LOG_ERROR, "%s: copy_threads %d must be >= 0.\n",
+                   __func__, priv->copy_threads);
+            ret = AVERROR(EINVAL);
+            LRETURN;
+        }
+    }
+
     /* Scan all cards on the host, only look at NETINT cards */
     if (ni_rsrc_list_all_devices(p_ni_devices) == NI_RETCODE_SUCCESS) {
         // Note: this only checks for Netint encoders
@@ -235,9 +285,16 @@ static int ni_transfer_get_formats(AVHWFramesContext *ctx,
 
 static void ni_frames_uninit(AVHWFramesContext *ctx)
 {
+    NIFramesContext *priv = ctx->hwctx;
     AVNIFramesContext *f_hwctx = (AVNIFramesContext*) ctx->hwctx;
     int dev_dec_idx = f_hwctx->uploader_device_id; //Supplied by init_hw_device ni=<name>:<id> or ni_hwupload=<id>
 
+    NICopyEngine *copy = (NICopyEngine *)atomic_load(&priv->copy);
+
+    avpriv_ni_copy_engine_free(&copy);
+    atomic_store(&priv->copy, 0);
+    av_buffer_pool_uninit(&priv->dl_pool);
+
     av_log(ctx, AV_LOG_DEBUG, "%s: only close if upload instance, poolsize=%d "
                               "devid=%d\n",
                               __func__, ctx->initial_pool_size, dev_dec_idx);
@@ -410,6 +467,7 @@ static int ni_frames_init(AVHWFramesContext *ctx) //hwupload runs this on hwuplo
         pool_size = ctx->initial_pool_size = 3;
         av_log(ctx, AV_LOG_INFO, "%s: Pool_size autoset to %d\n", __func__, pool_size);
     }
+    f_hwctx->pool_size = pool_size;
 
     /*Kept in AVNIFramesContext for future reference, the AVNIDeviceContext data member gets overwritten*/
     f_hwctx->uploader_device_id = device_hwctx->uploader_ID;
@@ -583,349 +641,142 @@ static int ni_frames_init(AVHWFramesContext *ctx) //hwupload runs this on hwuplo
     return 0;
 }
 
-static int ni_to_avframe_copy(AVHWFramesContext *hwfc, AVFrame *dst,
-                              const ni_frame_t *src)
+/* Transfers may run concurrently on several threads, e.g. hwdownload filters
+ * of different filtergraphs sharing the frames context of a decoder. Without
+ * an engine the planes are copied on the calling thread. */
+static NICopyEngine *ni_get_copy_engine(AVHWFramesContext *hwfc)
 {
-    int src_linesize[4], src_height[4];
-    int i, h, nb_planes;
-    uint8_t *src_line, *dst_line;
-
-    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
-
-    switch (hwfc->sw_format) {
-    case AV_PIX_FMT_YUV420P:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width / 2, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_YUV420P10LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_NV12:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_NV16:
-        src_linesize[0] = FFALIGN(dst->width, 64);
-        src_linesize[1] = FFALIGN(dst->width, 64);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
+    NIFramesContext *ctx = hwfc->hwctx;
+    NIDeviceContext *dev = hwfc->device_ctx->hwctx;
+    NICopyEngine *copy = (NICopyEngine *)atomic_load(&ctx->copy);
+    uintptr_t expected = 0;
+    int ret;
 
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 2;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
+    if (copy || atomic_load(&ctx->copy_failed))
+        return copy;
 
-    case AV_PIX_FMT_P010LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width * 2, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
+    ret = avpriv_ni_copy_engine_alloc(&copy, dev->copy_threads);
+    if (ret < 0) {
+        if (!atomic_exchange(&ctx->copy_failed, 1))
+            av_log(hwfc, AV_LOG_WARNING, "Cannot create copy threads, copying "
+                   "on the calling thread: %s\n", av_err2str(ret));
+        return NULL;
+    }
 
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 4;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
+    // another thread may have created one meanwhile
+    if (!atomic_compare_exchange_strong(&ctx->copy, &expected,
+                                        (uintptr_t)copy)) {
+        avpriv_ni_copy_engine_free(&copy);
+        copy = (NICopyEngine *)expected;
+    }
+    return copy;
+}
 
-    case AV_PIX_FMT_BGRP:
-        src_linesize[0] = FFALIGN(dst->width, 32);
-        src_linesize[1] = FFALIGN(dst->width, 32);
-        src_linesize[2] = FFALIGN(dst->width, 32);
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = dst->height;
-        src_height[3] = 0;
-        break;
+static int ni_to_avframe_copy(AVHWFramesContext *hwfc, AVFrame *dst,
+                              const ni_frame_t *src)
+{
+    NICopyPlane planes[4] = { 0 };
+    int src_linesize[4], src_height[4];
+    int i, nb_planes;
 
-    default:
+    nb_planes = avpriv_ni_copy_device_layout(hwfc->sw_format, dst->width,
+                                             dst->height, src_linesize,
+                                             src_height);
+    if (nb_planes < 0) {
         av_log(hwfc, AV_LOG_ERROR, "Unsupported pixel format %s\n",
                av_get_pix_fmt_name(hwfc->sw_format));
         return AVERROR(EINVAL);
     }
 
     for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->data[i];
-        src_line = src->p_data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line,
-                   FFMIN(src_linesize[i], dst->linesize[i]));
-            dst_line += dst->linesize[i];
-            src_line += src_linesize[i];
-        }
+        int bytewidth = av_image_get_linesize(hwfc->sw_format, dst->width, i);
+
+        planes[i].dst          = dst->data[i];
+        planes[i].src          = src->p_data[i];
+        planes[i].dst_linesize = dst->linesize[i];
+        planes[i].src_linesize = src_linesize[i];
+        planes[i].bytewidth    = FFMIN3(bytewidth, src_linesize[i],
+                                        FFABS(dst->linesize[i]));
+        planes[i].height       = src_height[i];
     }
 
+    avpriv_ni_copy_planes(ni_get_copy_engine(hwfc), planes, nb_planes);
+
     return 0;
 }
 
 static int av_to_niframe_copy(AVHWFramesContext *hwfc, const int dst_stride[4],
-                              ni_frame_t *dst, const AVFrame *src) {
-    int src_height[4], hpad[4], vpad[4];
-    int i, j, h, nb_planes;
-    uint8_t *src_line, *dst_line, YUVsample, *sample, *dest;
-    uint16_t lastidx;
-    bool tenBit;
+                              ni_frame_t *dst, const AVFrame *src)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->format);
+    NICopyPlane planes[4] = { 0 };
+    int linesize[4], height[4];
+    int i, nb_planes;
+
+    nb_planes = avpriv_ni_copy_device_layout(src->format, src->width,
+                                             src->height, linesize, height);
+    if (nb_planes < 0) {
+        av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported\n",
+               av_get_pix_fmt_name(src->format));
+        return AVERROR(EINVAL);
+    }
 
-    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
+    for (i = 0; i < nb_planes; i++) {
+        int bytewidth = av_image_get_linesize(src->format, src->width, i);
+
+        bytewidth = FFMIN(bytewidth, dst_stride[i]);
+
+        planes[i].dst          = dst->p_data[i];
+        planes[i].src          = src->data[i];
+        planes[i].dst_linesize = dst_stride[i];
+        planes[i].src_linesize = src->linesize[i];
+        planes[i].bytewidth    = bytewidth;
+        planes[i].height       = height[i];
+        /* pad the rows up to the device stride with their last sample */
+        planes[i].hpad         = dst_stride[i] - bytewidth;
+        planes[i].sample_size  = desc->comp[0].depth > 8 ? 2 : 1;
+        /* 4:2:0 planes are extended to an even height */
+        if (desc->log2_chroma_h)
+            planes[i].vpad     = FFALIGN(height[i], 2) - height[i];
+    }
 
-    switch (src->format) {
-    case AV_PIX_FMT_YUV420P:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
+    avpriv_ni_copy_planes(ni_get_copy_engine(hwfc), planes, nb_planes);
 
-    case AV_PIX_FMT_YUV420P10LE:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
+    return 0;
+}
 
+static int ni_dl_pixel_format(enum AVPixelFormat pix_fmt)
+{
+    switch (pix_fmt) {
+    case AV_PIX_FMT_YUV420P:
+        return NI_PIX_FMT_YUV420P;
+    case AV_PIX_FMT_YUV420P10LE:
+        return NI_PIX_FMT_YUV420P10LE;
     case AV_PIX_FMT_NV12:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
+        return NI_PIX_FMT_NV12;
     case AV_PIX_FMT_NV16:
-        hpad[0] = 0;
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
+        return NI_PIX_FMT_NV16;
+    case AV_PIX_FMT_YUYV422:
+        return NI_PIX_FMT_YUYV422;
+    case AV_PIX_FMT_UYVY422:
+        return NI_PIX_FMT_UYVY422;
     case AV_PIX_FMT_P010LE:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-
+        return NI_PIX_FMT_P010LE;
     case AV_PIX_FMT_RGBA:
+        return NI_PIX_FMT_RGBA;
     case AV_PIX_FMT_BGRA:
+        return NI_PIX_FMT_BGRA;
     case AV_PIX_FMT_ABGR:
+        return NI_PIX_FMT_ABGR;
     case AV_PIX_FMT_ARGB:
+        return NI_PIX_FMT_ARGB;
     case AV_PIX_FMT_BGR0:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
+        return NI_PIX_FMT_BGR0;
     case AV_PIX_FMT_BGRP:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = src->height;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
+        return NI_PIX_FMT_BGRP;
     default:
-        av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported\n",
-               av_get_pix_fmt_name(src->format));
-        break;
-    }
-
-    for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->p_data[i];
-        src_line = src->data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line, FFMIN(src->linesize[i], dst_stride[i]));
-
-            if (hpad[i]) {
-                lastidx = src->linesize[i];
-
-                if (tenBit) {
-                    sample = &src_line[lastidx - 2];
-                    dest   = &dst_line[lastidx];
-
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++) {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
-                    }
-                } else {
-                    YUVsample = dst_line[lastidx - 1];
-                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
-                }
-            }
-
-            src_line += src->linesize[i];
-            dst_line += dst_stride[i];
-        }
-
-        /* Extend the height by cloning the last line */
-        src_line = dst_line - dst_stride[i];
-        for (h = 0; h < vpad[i]; h++) {
-            memcpy(dst_line, src_line, dst_stride[i]);
-            dst_line += dst_stride[i];
-        }
+        return -1;
     }
-
-    return 0;
 }
 
 static int ni_hwdl_frame(AVHWFramesContext *hwfc, AVFrame *dst,
@@ -948,47 +799,8 @@ static int ni_hwdl_frame(AVHWFramesContext *hwfc, AVFrame *dst,
     av_log(hwfc, AV_LOG_DEBUG, "%s hwdl processed h/w = %d/%d\n", __func__,
            src->height, src->width);
 
-    switch (hwfc->sw_format) {
-    case AV_PIX_FMT_YUV420P:
-        pixel_format = NI_PIX_FMT_YUV420P;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        pixel_format = NI_PIX_FMT_YUV420P10LE;
-        break;
-    case AV_PIX_FMT_NV12:
-        pixel_format = NI_PIX_FMT_NV12;
-        break;
-    case AV_PIX_FMT_NV16:
-        pixel_format = NI_PIX_FMT_NV16;
-        break;
-    case AV_PIX_FMT_YUYV422:
-        pixel_format = NI_PIX_FMT_YUYV422;
-        break;
-    case AV_PIX_FMT_UYVY422:
-        pixel_format = NI_PIX_FMT_UYVY422;
-        break;
-    case AV_PIX_FMT_P010LE:
-        pixel_format = NI_PIX_FMT_P010LE;
-        break;
-    case AV_PIX_FMT_RGBA:
-        pixel_format = NI_PIX_FMT_RGBA;
-        break;
-    case AV_PIX_FMT_BGRA:
-        pixel_format = NI_PIX_FMT_BGRA;
-        break;
-    case AV_PIX_FMT_ABGR:
-        pixel_format = NI_PIX_FMT_ABGR;
-        break;
-    case AV_PIX_FMT_ARGB:
-        pixel_format = NI_PIX_FMT_ARGB;
-        break;
-    case AV_PIX_FMT_BGR0:
-        pixel_format = NI_PIX_FMT_BGR0;
-        break;
-    case AV_PIX_FMT_BGRP:
-        pixel_format = NI_PIX_FMT_BGRP;
-        break;
-    default:
+    pixel_format = ni_dl_pixel_format(hwfc->sw_format);
+    if (pixel_format < 0) {
         av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported\n",
                av_get_pix_fmt_name(hwfc->sw_format));
         return AVERROR(EINVAL);
@@ -1024,6 +836,131 @@ static int ni_hwdl_frame(AVHWFramesContext *hwfc, AVFrame *dst,
     return 0;
 }
 
+static AVBufferRef *ni_dl_buffer_alloc(size_t size)
+{
+    /* page aligned like the buffers of ni_frame_buffer_alloc_dl() */
+    return av_buffer_alloc_quadra(size);
+}
+
+/**
+ * Find out how libxcoder lays out a download of the given size and set up a
+ * pool of buffers with that layout if it is a valid AVFrame layout.
+ */
+static int ni_dl_pool_init(AVHWFramesContext *hwfc, int pixel_format,
+                           int width, int height)
+{
+    NIFramesContext *ctx = hwfc->hwctx;
+    ni_frame_t frame = { 0 };
+    int plane_height[4];
+    int i, nb_planes, align = av_cpu_max_align();
+
+    if (ctx->dl_width == width && ctx->dl_height == height)
+        return ctx->dl_nb_planes ? 0 : AVERROR(ENOSYS);
+
+    av_buffer_pool_uninit(&ctx->dl_pool);
+    ctx->dl_width     = width;
+    ctx->dl_height    = height;
+    ctx->dl_nb_planes = 0;
+
+    nb_planes = avpriv_ni_copy_device_layout(hwfc->sw_format, width, height,
+                                             ctx->dl_linesize, plane_height);
+    if (nb_planes < 0)
+        return AVERROR(ENOSYS);
+
+    if (ni_frame_buffer_alloc_dl(&frame, width, height, pixel_format) !=
+        NI_RETCODE_SUCCESS)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        ctx->dl_len[i]    = frame.data_len[i];
+        ctx->dl_offset[i] = frame.p_data[i] ? frame.p_data[i] - frame.p_buffer : 0;
+    }
+    ctx->dl_size = frame.buffer_size;
+    ni_frame_buffer_free(&frame);
+
+    for (i = 0; i < nb_planes; i++) {
+        if (ctx->dl_linesize[i] % align || ctx->dl_offset[i] % align ||
+            ctx->dl_len[i] < (size_t)ctx->dl_linesize[i] * plane_height[i]) {
+            av_log(hwfc, AV_LOG_VERBOSE, "Device layout of %dx%d %s is not a "
+                   "valid frame layout, downloads are copied\n", width, height,
+                   av_get_pix_fmt_name(hwfc->sw_format));
+            return AVERROR(ENOSYS);
+        }
+    }
+
+    /* room for the overreads frame users are allowed */
+    ctx->dl_pool = av_buffer_pool_init(ctx->dl_size + align, ni_dl_buffer_alloc);
+    if (!ctx->dl_pool)
+        return AVERROR(ENOMEM);
+    ctx->dl_nb_planes = nb_planes;
+
+    return 0;
+}
+
+/**
+ * Download a frame into a pooled buffer and hand that buffer out instead of
+ * copying it into the destination. The mapping does not reference the
+ * hardware frame, writes to it stay in host memory.
+ */
+static int ni_map_from(AVHWFramesContext *hwfc, AVFrame *dst,
+                       const AVFrame *src, int flags)
+{
+    NIFramesContext *ctx = hwfc->hwctx;
+    AVNIFramesContext *f_hwctx = &ctx->p;
+    niFrameSurface1_t *src_surf = (niFrameSurface1_t *)src->data[3];
+    ni_session_data_io_t session_io_data;
+    ni_frame_t *frame = &session_io_data.data.frame;
+    AVBufferRef *buf;
+    int i, ret, pixel_format;
+
+    if (!(flags & AV_HWFRAME_MAP_READ) || (flags & AV_HWFRAME_MAP_WRITE))
+        return AVERROR(ENOSYS);
+    if (dst->format != AV_PIX_FMT_NONE && dst->format != hwfc->sw_format)
+        return AVERROR(ENOSYS);
+
+    pixel_format = ni_dl_pixel_format(hwfc->sw_format);
+    if (pixel_format < 0)
+        return AVERROR(ENOSYS);
+
+    ret = ni_dl_pool_init(hwfc, pixel_format, src->width, src->height);
+    if (ret < 0)
+        return ret;
+
+    buf = av_buffer_pool_get(ctx->dl_pool);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    memset(&session_io_data, 0, sizeof(session_io_data));
+    frame->p_buffer     = buf->data;
+    frame->buffer_size  = ctx->dl_size;
+    frame->video_width  = src->width;
+    frame->video_height = src->height;
+    frame->pixel_format = pixel_format;
+    for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        frame->data_len[i] = ctx->dl_len[i];
+        frame->p_data[i]   = ctx->dl_len[i] ? buf->data + ctx->dl_offset[i] : NULL;
+    }
+
+    f_hwctx->api_ctx.is_auto_dl = false;
+    ret = ni_device_session_hwdl(&f_hwctx->api_ctx, &session_io_data, src_surf);
+    if (ret <= 0) {
+        av_log(hwfc, AV_LOG_DEBUG, "%s failed to retrieve frame\n", __func__);
+        av_buffer_unref(&buf);
+        return AVERROR_EXTERNAL;
+    }
+
+    dst->buf[0] = buf;
+    for (i = 0; i < ctx->dl_nb_planes; i++) {
+        dst->data[i]     = buf->data + ctx->dl_offset[i];
+        dst->linesize[i] = ctx->dl_linesize[i];
+    }
+    dst->format = hwfc->sw_format;
+    dst->width  = src->width;
+    dst->height = src->height;
+
+    return av_frame_copy_props(dst, src);
+}
+
 static void ff_ni_set_bit_depth_and_encoding_type(int8_t *p_bit_depth,
                                            int8_t *p_enc_type,
                                            enum AVPixelFormat pix_fmt)
@@ -1093,7 +1030,7 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
     ni_session_data_io_t *p_src_session_data;
     niFrameSurface1_t *dst_surf;
     int ret = 0;
-    int dst_stride[4];
+    int dst_stride[4], plane_height[4];
     int pixel_format;
     int need_to_copy = 1;
     size_t crop_right = 0, crop_bottom = 0;
@@ -1110,131 +1047,60 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
     switch (src->format) {
     /* 8-bit YUV420 planar */
     case AV_PIX_FMT_YUV420P:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = FFALIGN((src->width / 2), 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_YUV420P;
         break;
 
     /* 10-bit YUV420 planar, little-endian, least significant bits */
     case AV_PIX_FMT_YUV420P10LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = FFALIGN(src->width, 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_YUV420P10LE;
         break;
 
     /* 8-bit YUV420 semi-planar */
     case AV_PIX_FMT_NV12:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_NV12;
         break;
 
     /* 8-bit yuv422 semi-planar */
     case AV_PIX_FMT_NV16:
-        dst_stride[0] = FFALIGN(src->width, 64);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_NV16;
         break;
 
     /*8-bit yuv422 planar */
     case AV_PIX_FMT_YUYV422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_YUYV422;
         break;
 
     case AV_PIX_FMT_UYVY422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_UYVY422;
         break;
 
     /* 10-bit YUV420 semi-planar, little endian, most significant bits */
     case AV_PIX_FMT_P010LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_P010LE;
         break;
 
     /* 32-bit RGBA packed */
     case AV_PIX_FMT_RGBA:
-        /* RGBA for the scaler has a 16-byte width/64-byte stride alignment */
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_RGBA;
         break;
 
     case AV_PIX_FMT_BGRA:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_BGRA;
         break;
 
     case AV_PIX_FMT_ABGR:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_ABGR;
         break;
 
     case AV_PIX_FMT_ARGB:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_ARGB;
         break;
 
     case AV_PIX_FMT_BGR0:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
         pixel_format = NI_PIX_FMT_BGR0;
         break;
 
     /* 24-bit BGR planar not supported for hwupload */
-    /*
-    case AV_PIX_FMT_BGRP:
-        dst_stride[0] = FFALIGN(src->width, 32);
-        dst_stride[1] = FFALIGN(src->width, 32);
-        dst_stride[2] = FFALIGN(src->width, 32);
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_BGRP;
-        break;
-    */
     default:
         av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported by device %s\n",
 #if IS_FFMPEG_70_AND_ABOVE_FOR_LIBAVUTIL
@@ -1245,6 +1111,9 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
         return AVERROR(EINVAL);
     }
 
+    avpriv_ni_copy_device_layout(src->format, src->width, src->height,
+                                 dst_stride, plane_height);
+
     // check input resolution zero copy compatible or not
     if (ni_uploader_frame_zerocopy_check(&f_hwctx->api_ctx,
         src->width, src->height,
@@ -1362,8 +1231,8 @@ const HWContextType ff_hwcontext_type_ni_quadra = {
     .type = AV_HWDEVICE_TYPE_NI_QUADRA,
     .name = "NI_QUADRA",
 
-    .device_hwctx_size = sizeof(AVNIDeviceContext),
-    .frames_hwctx_size = sizeof(AVNIFramesContext),
+    .device_hwctx_size = sizeof(NIDeviceContext),
+    .frames_hwctx_size = sizeof(NIFramesContext),
 
     .device_create = ni_device_create,
     .device_uninit = ni_device_uninit,
@@ -1379,6 +1248,9 @@ const HWContextType ff_hwcontext_type_ni_quadra = {
     .transfer_data_to     = ni_transfer_data_to,
     .transfer_data_from   = ni_transfer_data_from,
 
+    .map_from             = ni_map_from,
+    .map_from_is_download = 1,
+
     .pix_fmts =
         (const enum AVPixelFormat[]){AV_PIX_FMT_NI_QUAD, AV_PIX_FMT_NONE},
 };
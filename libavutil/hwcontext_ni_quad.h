@@ -84,6 +84,7 @@ typedef struct AVNIFramesContext {
     ni_split_context_t   split_ctx;
     ni_device_handle_t   suspended_device_handle;
     int                  uploader_device_id; // same one passed to libxcoder session open
+    int                  pool_size; // frames of the device pool the frames come from, 0 if unknown
 
     // Accessed only by hwcontext_ni_quad.c
     niFrameSurface1_t    *surfaces_internal;
@@ -98,11 +99,16 @@ static inline int ni_get_cardno(const AVFrame *frame) {
     return ni_hwf_ctx->hw_id;
 }
 
-// copy hwctx specific data from one AVHWFramesContext to another
+// copy hwctx specific data from one AVHWFramesContext to another, but the
+// pool size: the frames of out_frames_ctx do not come from the input pool
 static inline void ni_cpy_hwframe_ctx(AVHWFramesContext *in_frames_ctx,
                                       AVHWFramesContext *out_frames_ctx)
 {
-    memcpy(out_frames_ctx->hwctx, in_frames_ctx->hwctx, sizeof(AVNIFramesContext));
+    AVNIFramesContext *out_hwctx = out_frames_ctx->hwctx;
+    int pool_size = out_hwctx->pool_size;
+
+    memcpy(out_hwctx, in_frames_ctx->hwctx, sizeof(AVNIFramesContext));
+    out_hwctx->pool_size = pool_size;
 }
 
 #endif /* AVUTIL_HWCONTEXT_NI_H */
@@ -0,0 +1,303 @@
+/*
+ * NETINT Quadra padded plane copy
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "attributes.h"
+#include "cpu.h"
+#include "error.h"
+#include "macros.h"
+#include "mem.h"
+#include "ni_copy.h"
+#include "slicethread.h"
+#include "thread.h"
+
+/* Smaller frames are not worth waking up the slice threads for */
+#define SLICE_THRESHOLD (1 << 20)
+/* Larger frames do not stay in the cache anyway, so do not let them evict it */
+#define NT_THRESHOLD    (1 << 21)
+#define MIN_SLICE_ROWS  32
+
+struct NICopyEngine {
+    NICopyDSPContext   dsp;
+    AVSliceThread     *slicethread;
+    int                nb_threads;
+    AVMutex            lock;
+
+    /* task being executed by the slice threads */
+    const NICopyPlane *planes;
+    int                nb_planes;
+    int                nt;
+};
+
+static void copy_plane_c(uint8_t *dst, ptrdiff_t dst_linesize,
+                         const uint8_t *src, ptrdiff_t src_linesize,
+                         ptrdiff_t bytewidth, int height)
+{
+    for (int y = 0; y < height; y++) {
+        memcpy(dst, src, bytewidth);
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+}
+
+av_cold void ff_ni_copy_init(NICopyDSPContext *c)
+{
+    c->copy_plane_nt = copy_plane_c;
+}
+
+static void copy_rows(const NICopyDSPContext *dsp, const NICopyPlane *p,
+                      int y0, int y1, int nt)
+{
+    uint8_t       *dst = p->dst + (ptrdiff_t)y0 * p->dst_linesize;
+    const uint8_t *src = p->src + (ptrdiff_t)y0 * p->src_linesize;
+    int bytewidth = p->bytewidth;
+    int height    = y1 - y0;
+    int bulk      = bytewidth & ~63;
+
+    if (height <= 0 || bytewidth <= 0)
+        return;
+
+    if (p->dst_linesize == bytewidth && p->src_linesize == bytewidth &&
+        !(nt && bulk)) {
+        memcpy(dst, src, (size_t)bytewidth * height);
+    } else if (nt && bulk && !((uintptr_t)dst & 31) && !(p->dst_linesize & 31)) {
+        dsp->copy_plane_nt(dst, p->dst_linesize, src, p->src_linesize,
+                           bulk, height);
+        if (bulk < bytewidth)
+            copy_plane_c(dst + bulk, p->dst_linesize, src + bulk,
+                         p->src_linesize, bytewidth - bulk, height);
+    } else {
+        copy_plane_c(dst, p->dst_linesize, src, p->src_linesize,
+                     bytewidth, height);
+    }
+
+    if (p->hpad > 0) {
+        for (int y = 0; y < height; y++) {
+            uint8_t *end = dst + bytewidth;
+
+            if (p->sample_size == 2 && bytewidth >= 2)
+                av_memcpy_backptr(end, 2, p->hpad);
+            else
+                memset(end, end[-1], p->hpad);
+            dst += p->dst_linesize;
+        }
+    }
+}
+
+/* Extend the height by cloning the last row */
+static void clone_rows(const NICopyPlane *p)
+{
+    const uint8_t *last;
+    uint8_t *dst;
+
+    if (p->vpad <= 0 || p->height <= 0)
+        return;
+
+    last = p->dst + (ptrdiff_t)(p->height - 1) * p->dst_linesize;
+    dst  = p->dst + (ptrdiff_t)p->height * p->dst_linesize;
+    for (int y = 0; y < p->vpad; y++) {
+        memcpy(dst, last, p->bytewidth + FFMAX(p->hpad, 0));
+        dst += p->dst_linesize;
+    }
+}
+
+static void copy_slice(void *priv, int jobnr, int threadnr, int nb_jobs,
+                       int nb_threads)
+{
+    NICopyEngine *e = priv;
+
+    for (int i = 0; i < e->nb_planes; i++) {
+        const NICopyPlane *p = &e->planes[i];
+
+        copy_rows(&e->dsp, p, (int64_t)p->height * jobnr / nb_jobs,
+                  (int64_t)p->height * (jobnr + 1) / nb_jobs, e->nt);
+        /* the last row belongs to the last slice */
+        if (jobnr == nb_jobs - 1)
+            clone_rows(p);
+    }
+}
+
+int avpriv_ni_copy_engine_alloc(NICopyEngine **engine, int nb_threads)
+{
+    NICopyEngine *e;
+    int ret;
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return AVERROR(ENOMEM);
+
+    ff_ni_copy_init(&e->dsp);
+    ff_mutex_init(&e->lock, NULL);
+    e->nb_threads = 1;
+
+    if (nb_threads <= 0)
+        nb_threads = FFMIN(av_cpu_count(), NI_COPY_MAX_THREADS);
+    if (nb_threads > 1) {
+        ret = avpriv_slicethread_create(&e->slicethread, e, copy_slice, NULL,
+                                        nb_threads);
+        if (ret > 1) {
+            e->nb_threads = ret;
+        } else if (ret < 0 && ret != AVERROR(ENOSYS)) {
+            avpriv_ni_copy_engine_free(&e);
+            return ret;
+        } else {
+            avpriv_slicethread_free(&e->slicethread);
+        }
+    }
+
+    *engine = e;
+    return 0;
+}
+
+void avpriv_ni_copy_engine_free(NICopyEngine **engine)
+{
+    NICopyEngine *e = *engine;
+
+    if (!e)
+        return;
+
+    avpriv_slicethread_free(&e->slicethread);
+    ff_mutex_destroy(&e->lock);
+    av_freep(engine);
+}
+
+static NICopyDSPContext default_dsp;
+
+static av_cold void init_default_dsp(void)
+{
+    ff_ni_copy_init(&default_dsp);
+}
+
+void avpriv_ni_copy_planes(NICopyEngine *e, const NICopyPlane *planes,
+                           int nb_planes)
+{
+    static AVOnce init_static_once = AV_ONCE_INIT;
+    const NICopyDSPContext *dsp;
+    size_t bytes = 0;
+    int max_height = 0, nt;
+
+    for (int i = 0; i < nb_planes; i++) {
+        const NICopyPlane *p = &planes[i];
+
+        bytes += (size_t)(p->bytewidth + FFMAX(p->hpad, 0)) *
+                 (p->height + FFMAX(p->vpad, 0));
+        max_height = FFMAX(max_height, p->height);
+    }
+    nt = bytes >= NT_THRESHOLD;
+
+    if (e && e->slicethread && bytes >= SLICE_THRESHOLD) {
+        int nb_jobs = FFMIN(e->nb_threads, max_height / MIN_SLICE_ROWS);
+
+        if (nb_jobs > 1) {
+            ff_mutex_lock(&e->lock);
+            e->planes    = planes;
+            e->nb_planes = nb_planes;
+            e->nt        = nt;
+            avpriv_slicethread_execute(e->slicethread, nb_jobs, 0);
+            ff_mutex_unlock(&e->lock);
+            return;
+        }
+    }
+
+    if (e) {
+        dsp = &e->dsp;
+    } else {
+        ff_thread_once(&init_static_once, init_default_dsp);
+        dsp = &default_dsp;
+    }
+
+    for (int i = 0; i < nb_planes; i++) {
+        copy_rows(dsp, &planes[i], 0, planes[i].height, nt);
+        clone_rows(&planes[i]);
+    }
+}
+
+int avpriv_ni_copy_device_layout(enum AVPixelFormat fmt, int width, int height,
+                                 int linesize[4], int plane_height[4])
+{
+    int chroma_height = FFALIGN(height, 2) / 2;
+
+    memset(linesize,     0, 4 * sizeof(*linesize));
+    memset(plane_height, 0, 4 * sizeof(*plane_height));
+
+    switch (fmt) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        linesize[0] = FFALIGN(width, 128);
+        linesize[1] = FFALIGN(width / 2, 128);
+        linesize[2] = linesize[1];
+        plane_height[0] = height;
+        plane_height[1] = plane_height[2] = chroma_height;
+        return 3;
+
+    case AV_PIX_FMT_YUV420P10LE:
+        linesize[0] = FFALIGN(width * 2, 128);
+        linesize[1] = FFALIGN(width, 128);
+        linesize[2] = linesize[1];
+        plane_height[0] = height;
+        plane_height[1] = plane_height[2] = chroma_height;
+        return 3;
+
+    case AV_PIX_FMT_NV12:
+        linesize[0] = linesize[1] = FFALIGN(width, 128);
+        plane_height[0] = height;
+        plane_height[1] = chroma_height;
+        return 2;
+
+    case AV_PIX_FMT_P010LE:
+        linesize[0] = linesize[1] = FFALIGN(width * 2, 128);
+        plane_height[0] = height;
+        plane_height[1] = chroma_height;
+        return 2;
+
+    case AV_PIX_FMT_NV16:
+        linesize[0] = linesize[1] = FFALIGN(width, 64);
+        plane_height[0] = plane_height[1] = height;
+        return 2;
+
+    case AV_PIX_FMT_YUYV422:
+    case AV_PIX_FMT_UYVY422:
+        linesize[0] = FFALIGN(width, 16) * 2;
+        plane_height[0] = height;
+        return 1;
+
+    case AV_PIX_FMT_RGBA:
+    case AV_PIX_FMT_BGRA:
+    case AV_PIX_FMT_ABGR:
+    case AV_PIX_FMT_ARGB:
+    case AV_PIX_FMT_BGR0:
+        /* RGBA for the scaler has a 16-byte width/64-byte stride alignment */
+        linesize[0] = FFALIGN(width, 16) * 4;
+        plane_height[0] = height;
+        return 1;
+
+    case AV_PIX_FMT_BGRP:
+        linesize[0] = linesize[1] = linesize[2] = FFALIGN(width, 32);
+        plane_height[0] = plane_height[1] = plane_height[2] = height;
+        return 3;
+
+    default:
+        return AVERROR(EINVAL);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * NETINT Quadra padded plane copy
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_NI_COPY_H
+#define AVUTIL_NI_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pixfmt.h"
+
+typedef struct NICopyDSPContext {
+    /**
+     * Copy a plane of a large frame, which does not need to stay in the
+     * cache. No architecture has a non-temporal kernel for it yet.
+     *
+     * @param bytewidth bytes per row, a positive multiple of 64; the rows of
+     *                  both planes must be at least that long
+     * @param height    number of rows, > 0
+     *
+     * dst and dst_linesize must be multiples of 32.
+     */
+    void (*copy_plane_nt)(uint8_t *dst, ptrdiff_t dst_linesize,
+                          const uint8_t *src, ptrdiff_t src_linesize,
+                          ptrdiff_t bytewidth, int height);
+} NICopyDSPContext;
+
+void ff_ni_copy_init(NICopyDSPContext *c);
+
+/**
+ * One plane of a copy between host memory and a Quadra frame buffer.
+ */
+typedef struct NICopyPlane {
+    uint8_t       *dst;
+    const uint8_t *src;
+    int            dst_linesize;
+    int            src_linesize;
+    int            bytewidth;    ///< bytes copied per row
+    int            height;       ///< rows copied
+    /**
+     * Bytes after bytewidth filled by repeating the last sample of each
+     * row, e.g. up to the device stride.
+     */
+    int            hpad;
+    int            vpad;         ///< rows cloned from the last one after height
+    int            sample_size;  ///< bytes per sample repeated into hpad, 1 or 2
+} NICopyPlane;
+
+typedef struct NICopyEngine NICopyEngine;
+
+/**
+ * Allocate a copy engine.
+ *
+ * @param nb_threads number of slice threads, 0 for one per core (at most
+ *                   NI_COPY_MAX_THREADS), 1 to copy on the calling thread
+ */
+int avpriv_ni_copy_engine_alloc(NICopyEngine **engine, int nb_threads);
+
+void avpriv_ni_copy_engine_free(NICopyEngine **engine);
+
+#define NI_COPY_MAX_THREADS 8
+
+/**
+ * Copy planes, splitting large frames in slices over the engine threads and
+ * bypassing the cache with non-temporal stores when the frame does not fit.
+ *
+ * @param engine an engine or NULL to copy on the calling thread
+ */
+void avpriv_ni_copy_planes(NICopyEngine *engine, const NICopyPlane *planes,
+                           int nb_planes);
+
+/**
+ * Get the layout of a Quadra frame buffer: the stride of each plane, which
+ * is padded to 16..128 bytes depending on the format, and its height.
+ *
+ * @return number of planes or a negative AVERROR for an unsupported format
+ */
+int avpriv_ni_copy_device_layout(enum AVPixelFormat fmt, int width, int height,
+                                 int linesize[4], int plane_height[4]);
+
+#endif /* AVUTIL_NI_COPY_H */
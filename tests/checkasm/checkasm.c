@@ -290,6 +290,9 @@ static const struct {
         { "float_dsp", checkasm_check_float_dsp },
         { "lls",       checkasm_check_lls },
         { "av_tx",     checkasm_check_av_tx },
+#endif
+#if CONFIG_NI_QUADRA
+        { "ni_copy",   checkasm_check_ni_copy },
 #endif
     { NULL }
 };
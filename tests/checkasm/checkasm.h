@@ -111,6 +111,7 @@ void checkasm_check_llviddspenc(void);
 void checkasm_check_lpc(void);
 void checkasm_check_motion(void);
 void checkasm_check_mpegvideoencdsp(void);
+void checkasm_check_ni_copy(void);
 void checkasm_check_nlmeans(void);
 void checkasm_check_opusdsp(void);
 void checkasm_check_pixblockdsp(void);
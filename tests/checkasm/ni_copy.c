@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+#include "libavutil/ni_copy.h"
+
+#define MAX_WIDTH   1024
+#define MAX_HEIGHT  16
+#define SRC_STRIDE  (MAX_WIDTH + 64)
+#define DST_STRIDE  (MAX_WIDTH + 128)
+#define SRC_SIZE    (SRC_STRIDE * MAX_HEIGHT + 64)
+#define DST_SIZE    (DST_STRIDE * MAX_HEIGHT)
+
+static void randomize_buffer(uint8_t *buf, int size)
+{
+    for (int i = 0; i < size; i += 4)
+        AV_WN32A(buf + i, rnd());
+}
+
+static void check_copy_plane_nt(const NICopyDSPContext *c)
+{
+    static const int widths[]  = { 64, 128, 320, 704, MAX_WIDTH };
+    static const int heights[] = { 1, 3, MAX_HEIGHT };
+    LOCAL_ALIGNED_32(uint8_t, src,  [SRC_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_SIZE]);
+
+    declare_func(void, uint8_t *dst, ptrdiff_t dst_linesize,
+                 const uint8_t *src, ptrdiff_t src_linesize,
+                 ptrdiff_t bytewidth, int height);
+
+    if (check_func(c->copy_plane_nt, "ni_copy_plane_nt")) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            for (int j = 0; j < FF_ARRAY_ELEMS(heights); j++) {
+                /* the source of an upload is not aligned to anything */
+                int offset     = (i * 7 + j) % 64;
+                int dst_stride = FFALIGN(widths[i], 128);
+
+                randomize_buffer(src,  SRC_SIZE);
+                randomize_buffer(dst0, DST_SIZE);
+                memcpy(dst1, dst0, DST_SIZE);
+
+                call_ref(dst0, dst_stride, src + offset, SRC_STRIDE,
+                         widths[i], heights[j]);
+                call_new(dst1, dst_stride, src + offset, SRC_STRIDE,
+                         widths[i], heights[j]);
+                if (memcmp(dst0, dst1, DST_SIZE))
+                    fail();
+            }
+        }
+        bench_new(dst1, DST_STRIDE, src + 1, SRC_STRIDE, MAX_WIDTH, MAX_HEIGHT);
+    }
+    report("copy_plane_nt");
+}
+
+void checkasm_check_ni_copy(void)
+{
+    NICopyDSPContext c;
+
+    ff_ni_copy_init(&c);
+    check_copy_plane_nt(&c);
+}
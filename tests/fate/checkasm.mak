@@ -68,6 +68,9 @@ FATE_CHECKASM = fate-checkasm-aacencdsp                                 \
                 fate-checkasm-vvc_alf                                   \
                 fate-checkasm-vvc_mc                                    \
 
+FATE_CHECKASM-$(CONFIG_NI_QUADRA) += fate-checkasm-ni_copy
+FATE_CHECKASM += $(FATE_CHECKASM-yes)
+
 $(FATE_CHECKASM): tests/checkasm/checkasm$(EXESUF)
 $(FATE_CHECKASM): CMD = run tests/checkasm/checkasm$(EXESUF) --test=$(@:fate-checkasm-%=%)
 $(FATE_CHECKASM): CMP = null
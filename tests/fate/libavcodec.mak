@@ -3,6 +3,10 @@ fate-av1-levels: libavcodec/tests/av1_levels$(EXESUF)
 fate-av1-levels: CMD = run libavcodec/tests/av1_levels$(EXESUF)
 fate-av1-levels: REF = /dev/null
 
+FATE_LIBAVCODEC-$(call ALLYES, AV1_RAWTOTILE_BSF AV1_TILE_REPACK_BSF) += fate-av1-tile-repack
+fate-av1-tile-repack: libavcodec/tests/av1_tile_repack$(EXESUF)
+fate-av1-tile-repack: CMD = run libavcodec/tests/av1_tile_repack$(EXESUF)
+
 FATE_LIBAVCODEC-yes += fate-avpacket
 fate-avpacket: libavcodec/tests/avpacket$(EXESUF)
 fate-avpacket: CMD = run libavcodec/tests/avpacket$(EXESUF)
@@ -71,6 +75,14 @@ fate-h265-levels: libavcodec/tests/h265_levels$(EXESUF)
 fate-h265-levels: CMD = run libavcodec/tests/h265_levels$(EXESUF)
 fate-h265-levels: REF = /dev/null
 
+FATE_LIBAVCODEC-$(CONFIG_HEVC_FRAME_SPLIT_BSF) += fate-hevc-frame-split
+fate-hevc-frame-split: libavcodec/tests/hevc_frame_split$(EXESUF)
+fate-hevc-frame-split: CMD = run libavcodec/tests/hevc_frame_split$(EXESUF)
+
+FATE_LIBAVCODEC-$(CONFIG_HEVC_TILE_REPACK_BSF) += fate-hevc-tile-repack
+fate-hevc-tile-repack: libavcodec/tests/hevc_tile_repack$(EXESUF)
+fate-hevc-tile-repack: CMD = run libavcodec/tests/hevc_tile_repack$(EXESUF)
+
 FATE_LIBAVCODEC-$(CONFIG_IIRFILTER) += fate-iirfilter
 fate-iirfilter: libavcodec/tests/iirfilter$(EXESUF)
 fate-iirfilter: CMD = run libavcodec/tests/iirfilter$(EXESUF)
@@ -0,0 +1,46 @@
+# Round trips through the NETINT Quadra codecs and filters. They need a card,
+# so they only run when built against the software libxcoder emulation
+# (--enable-ni_quadra_emu).
+
+# the H.264 encoder output must be decodable by the native decoder
+FATE_NI_QUADRA-$(call TRANSCODE, H264_NI_QUADRA H264, H264, NI_QUADRA_EMU RAWVIDEO_DEMUXER H264_PARSER) += fate-ni-quadra-h264
+fate-ni-quadra-h264: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p" \
+  tests/data/vsynth1.yuv h264 "-c:v h264_ni_quadra_enc -frames:v 10"
+
+FATE_NI_QUADRA-$(call TRANSCODE, H265_NI_QUADRA, HEVC, NI_QUADRA_EMU RAWVIDEO_DEMUXER HEVC_PARSER) += fate-ni-quadra-h265
+fate-ni-quadra-h265: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p" \
+  tests/data/vsynth1.yuv hevc "-c:v h265_ni_quadra_enc -frames:v 10" \
+  "" "" "" "-c:v h265_ni_quadra_dec"
+
+# a decoder with a fixed frame pool waits for the encoder to recycle its
+# frames, which must not keep the encoder from getting the only worker
+FATE_NI_QUADRA-$(call TRANSCODE, H265_NI_QUADRA, HEVC, NI_QUADRA_EMU RAWVIDEO_DEMUXER HEVC_PARSER) += fate-ni-quadra-sched-workers
+fate-ni-quadra-sched-workers: CMD = NI_QUADRA_EMU=dec_pool=2 \
+  transcode "rawvideo -s 352x288 -pix_fmt yuv420p" \
+  tests/data/vsynth1.yuv hevc "-c:v h265_ni_quadra_enc -frames:v 30" \
+  "-c:v h265_ni_quadra_enc" "" "" \
+  "-sched_workers 1 -c:v h265_ni_quadra_dec -xcoder-params out=hw"
+
+NI_QUADRA_SPLIT = $(call FILTERDEMDEC, HWUPLOAD_NI_QUADRA SPLIT_NI_QUADRA HWDOWNLOAD FORMAT, RAWVIDEO, RAWVIDEO, NI_QUADRA_EMU)
+NI_QUADRA_SPLIT_GRAPH = ni_quadra_hwupload,ni_quadra_split=output0=2$(1)[a][b];[a]hwdownload,format=yuv420p[a1];[b]hwdownload,format=yuv420p[b1]
+NI_QUADRA_SPLIT_CMD = framecrc -init_hw_device ni_quadra=ni:0 -filter_hw_device ni  \
+  -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -filter_complex "$(call NI_QUADRA_SPLIT_GRAPH,$(1))" -map "[a1]" -map "[b1]" -frames:v 10
+
+FATE_NI_QUADRA-$(NI_QUADRA_SPLIT) += fate-ni-quadra-split
+fate-ni-quadra-split: CMD = $(call NI_QUADRA_SPLIT_CMD)
+
+FATE_NI_QUADRA-$(NI_QUADRA_SPLIT) += fate-ni-quadra-split-fanout
+fate-ni-quadra-split-fanout: CMD = $(call NI_QUADRA_SPLIT_CMD,:fanout=1)
+
+$(FATE_NI_QUADRA-yes): tests/data/vsynth1.yuv
+
+# the YOLO post-processing of ni_quadra_roi runs without the card, on a
+# synthesized layer dump
+FATE_NI_QUADRA_PROGS-$(CONFIG_ROI_NI_QUADRA_FILTER) += fate-ni-quadra-yolo
+fate-ni-quadra-yolo: libavfilter/tests/ni_yolo$(EXESUF)
+fate-ni-quadra-yolo: CMD = run libavfilter/tests/ni_yolo$(EXESUF)
+
+FATE_FFMPEG += $(FATE_NI_QUADRA-yes)
+FATE-yes += $(FATE_NI_QUADRA_PROGS-yes)
+fate-ni-quadra: $(FATE_NI_QUADRA-yes) $(FATE_NI_QUADRA_PROGS-yes)
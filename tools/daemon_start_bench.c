@@ -0,0 +1,242 @@
+/*
+ * ffmpeg daemon job start latency benchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the time to run short jobs with a new ffmpeg process per job to
+ * the time to run them in an ffmpeg daemon (-daemon).
+ *
+ * The same job is first run nb_jobs times as a separate process, then a
+ * daemon is started and the job is sent to it nb_jobs times. For every job
+ * the time from starting the process (or connecting to the daemon) to
+ * receiving its exit status is measured. Keep the job short (e.g. a few
+ * frames, or -t 0.1) so that the startup cost dominates.
+ *
+ * Usage: daemon_start_bench <ffmpeg> <socket> <nb_jobs> <job arguments>...
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "libavutil/time.h"
+
+extern char **environ;
+
+static int spawn(const char *ffmpeg, char **args, int nb_args, pid_t *pid)
+{
+    posix_spawn_file_actions_t fa;
+    char **argv;
+    int ret;
+
+    argv = calloc(nb_args + 5, sizeof(*argv));
+    if (!argv)
+        return ENOMEM;
+
+    argv[0] = (char*)ffmpeg;
+    argv[1] = (char*)"-nostdin";
+    argv[2] = (char*)"-loglevel";
+    argv[3] = (char*)"error";
+    memcpy(argv + 4, args, nb_args * sizeof(*args));
+
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    ret = posix_spawn(pid, ffmpeg, &fa, NULL, argv, environ);
+
+    posix_spawn_file_actions_destroy(&fa);
+    free(argv);
+
+    return ret;
+}
+
+static int connect_daemon(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* run one job in the daemon, return its exit status or -1 on error */
+static int send_job(const char *path, char **args, int nb_args)
+{
+    char buf[4096], status[16];
+    size_t status_len = 0;
+    int in_status = 0;
+    ssize_t len;
+    int fd;
+
+    fd = connect_daemon(path);
+    if (fd < 0)
+        return -1;
+
+    for (int i = 0; i < nb_args; i++)
+        if (write(fd, args[i], strlen(args[i]) + 1) < 0)
+            goto fail;
+    if (write(fd, "", 1) < 0)
+        goto fail;
+
+    // log output, then a NUL and the status
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            if (in_status) {
+                if (status_len < sizeof(status) - 1)
+                    status[status_len++] = buf[i];
+            } else if (!buf[i]) {
+                in_status = 1;
+            } else {
+                fputc(buf[i], stderr);
+            }
+        }
+    }
+    close(fd);
+
+    if (!in_status)
+        return -1;
+    status[status_len] = 0;
+    return atoi(status);
+fail:
+    close(fd);
+    return -1;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t*)a, vb = *(const int64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+static void report(const char *name, int64_t *t, int nb)
+{
+    int64_t sum = 0;
+
+    qsort(t, nb, sizeof(*t), cmp_int64);
+    for (int i = 0; i < nb; i++)
+        sum += t[i];
+
+    printf("%-8s jobs %4d  mean %8.2f ms  p50 %8.2f ms  p90 %8.2f ms  max %8.2f ms\n",
+           name, nb, sum / 1000.0 / nb, t[nb / 2] / 1000.0,
+           t[nb * 9 / 10] / 1000.0, t[nb - 1] / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *ffmpeg, *path;
+    char *daemon_args[2];
+    int64_t *t;
+    pid_t pid;
+    int nb_jobs, nb_args, status, ret = 1;
+
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <ffmpeg> <socket> <nb_jobs> <job arguments>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    ffmpeg  = argv[1];
+    path    = argv[2];
+    nb_jobs = atoi(argv[3]);
+    nb_args = argc - 4;
+    if (nb_jobs <= 0) {
+        fprintf(stderr, "Invalid number of jobs: %s\n", argv[3]);
+        return 1;
+    }
+
+    t = calloc(nb_jobs, sizeof(*t));
+    if (!t)
+        return 1;
+
+    for (int i = 0; i < nb_jobs; i++) {
+        int64_t t0 = av_gettime_relative();
+
+        if (spawn(ffmpeg, argv + 4, nb_args, &pid) ||
+            waitpid(pid, &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "Job %d failed when run as a process\n", i);
+            goto finish;
+        }
+
+        t[i] = av_gettime_relative() - t0;
+    }
+    report("process", t, nb_jobs);
+
+    daemon_args[0] = (char*)"-daemon";
+    daemon_args[1] = (char*)path;
+    if (spawn(ffmpeg, daemon_args, 2, &pid)) {
+        fprintf(stderr, "Error starting the daemon\n");
+        goto finish;
+    }
+
+    // wait up to 10 seconds for the daemon to listen
+    for (int i = 0; ; i++) {
+        int fd = connect_daemon(path);
+        if (fd >= 0) {
+            close(fd);
+            break;
+        }
+        if (i == 1000) {
+            fprintf(stderr, "The daemon did not start listening on %s\n", path);
+            goto stop;
+        }
+        av_usleep(10000);
+    }
+
+    for (int i = 0; i < nb_jobs; i++) {
+        int64_t t0 = av_gettime_relative();
+
+        if (send_job(path, argv + 4, nb_args)) {
+            fprintf(stderr, "Job %d failed when run in the daemon\n", i);
+            goto stop;
+        }
+
+        t[i] = av_gettime_relative() - t0;
+    }
+    report("daemon", t, nb_jobs);
+
+    ret = 0;
+stop:
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+finish:
+    free(t);
+    return ret;
+}
@@ -0,0 +1,344 @@
+/*
+ * NETINT HEVC frame split benchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Throughput benchmark of the hevc_frame_split bitstream filter on 4K
+ * tiled HEVC.
+ *
+ * Streams of 3840x2160 frames with 2 to 32 uniformly spaced tiles, one
+ * slice per tile and the parameter sets repeated in every frame, are
+ * written with CBS. The slice payloads are random, with enough zero bytes
+ * for emulation prevention to happen. The frames per second the filter
+ * splits each stream at are reported; its tile packets are checked by the
+ * fate-hevc-frame-split test.
+ *
+ * Usage: ni_hevc_frame_split_bench [nb_frames [intra_size [inter_size [threads]]]]
+ *
+ * It calls internal libavcodec functions, so it needs a static build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/bsf.h"
+#include "libavcodec/cbs.h"
+#include "libavcodec/cbs_h265.h"
+#include "libavcodec/hevc/hevc.h"
+
+#define WIDTH     3840
+#define HEIGHT    2160
+#define LOG2_CTB  6
+#define CTB_W     ((WIDTH  + (1 << LOG2_CTB) - 1) >> LOG2_CTB)
+#define CTB_H     ((HEIGHT + (1 << LOG2_CTB) - 1) >> LOG2_CTB)
+#define MAX_TILES 32
+
+typedef struct Layout {
+    int cols, rows;
+    int col_ctb[MAX_TILES + 1];
+    int row_ctb[MAX_TILES + 1];
+} Layout;
+
+static void init_layout(Layout *l, int cols, int rows)
+{
+    l->cols = cols;
+    l->rows = rows;
+    for (int i = 0; i <= cols; i++)
+        l->col_ctb[i] = i * CTB_W / cols;
+    for (int i = 0; i <= rows; i++)
+        l->row_ctb[i] = i * CTB_H / rows;
+}
+
+/* Stream synthesis */
+
+static void fill_ps(H265RawVPS *vps, H265RawSPS *sps, H265RawPPS *pps,
+                    const Layout *l)
+{
+    H265RawProfileTierLevel ptl = { 0 };
+
+    ptl.general_profile_idc                   = 1;
+    ptl.general_profile_compatibility_flag[1] = 1;
+    ptl.general_profile_compatibility_flag[2] = 1;
+    ptl.general_progressive_source_flag       = 1;
+    ptl.general_frame_only_constraint_flag    = 1;
+    ptl.general_level_idc                     = 153;
+
+    memset(vps, 0, sizeof(*vps));
+    vps->nal_unit_header.nal_unit_type         = HEVC_NAL_VPS;
+    vps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    vps->vps_base_layer_internal_flag          = 1;
+    vps->vps_base_layer_available_flag         = 1;
+    vps->vps_temporal_id_nesting_flag          = 1;
+    vps->profile_tier_level                    = ptl;
+    vps->vps_sub_layer_ordering_info_present_flag = 1;
+    vps->vps_max_dec_pic_buffering_minus1[0]   = 4;
+    vps->layer_id_included_flag[0][0]          = 1;
+
+    memset(sps, 0, sizeof(*sps));
+    sps->nal_unit_header.nal_unit_type         = HEVC_NAL_SPS;
+    sps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    sps->sps_temporal_id_nesting_flag          = 1;
+    sps->profile_tier_level                    = ptl;
+    sps->chroma_format_idc                     = 1;
+    sps->pic_width_in_luma_samples             = WIDTH;
+    sps->pic_height_in_luma_samples            = HEIGHT;
+    sps->log2_max_pic_order_cnt_lsb_minus4     = 4;
+    sps->sps_sub_layer_ordering_info_present_flag = 1;
+    sps->sps_max_dec_pic_buffering_minus1[0]   = 4;
+    sps->log2_diff_max_min_luma_coding_block_size    = LOG2_CTB - 3;
+    sps->log2_diff_max_min_luma_transform_block_size = 3;
+    sps->max_transform_hierarchy_depth_inter   = 1;
+    sps->max_transform_hierarchy_depth_intra   = 1;
+    sps->sample_adaptive_offset_enabled_flag   = 1;
+    sps->sps_temporal_mvp_enabled_flag         = 1;
+    sps->strong_intra_smoothing_enabled_flag   = 1;
+    /* the values inferred without VUI */
+    sps->vui.video_format                      = 5;
+    sps->vui.colour_primaries                  = 2;
+    sps->vui.transfer_characteristics          = 2;
+    sps->vui.matrix_coefficients               = 2;
+    sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
+    sps->vui.max_bytes_per_pic_denom           = 2;
+    sps->vui.max_bits_per_min_cu_denom         = 1;
+    sps->vui.log2_max_mv_length_horizontal     = 15;
+    sps->vui.log2_max_mv_length_vertical       = 15;
+
+    memset(pps, 0, sizeof(*pps));
+    pps->nal_unit_header.nal_unit_type         = HEVC_NAL_PPS;
+    pps->nal_unit_header.nuh_temporal_id_plus1 = 1;
+    pps->cu_qp_delta_enabled_flag              = 1;
+    pps->tiles_enabled_flag                    = 1;
+    pps->num_tile_columns_minus1               = l->cols - 1;
+    pps->num_tile_rows_minus1                  = l->rows - 1;
+    pps->uniform_spacing_flag                  = 1;
+}
+
+static void fill_data(uint8_t *data, int size, AVLFG *lfg)
+{
+    for (int i = 0; i < size; i++) {
+        unsigned r = av_lfg_get(lfg);
+        /* one byte in eight is zero so that escapes are common */
+        data[i] = r & 7 ? r >> 8 : 0;
+    }
+    data[size - 1] = 0x80;
+}
+
+static int synth_frame(CodedBitstreamContext *cbc, CodedBitstreamFragment *frag,
+                       const Layout *l, int poc, int idr, int slice_size,
+                       uint8_t *data, AVLFG *lfg, AVPacket *pkt)
+{
+    int nb_tiles = l->cols * l->rows;
+    H265RawSlice *slices;
+    H265RawVPS vps;
+    H265RawSPS sps;
+    H265RawPPS pps;
+    int ret;
+
+    slices = av_calloc(nb_tiles, sizeof(*slices));
+    if (!slices)
+        return AVERROR(ENOMEM);
+
+    fill_ps(&vps, &sps, &pps, l);
+    ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_VPS, &vps, NULL);
+    if (ret >= 0)
+        ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_SPS, &sps, NULL);
+    if (ret >= 0)
+        ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_PPS, &pps, NULL);
+
+    for (int t = 0; ret >= 0 && t < nb_tiles; t++) {
+        H265RawSlice *slice     = &slices[t];
+        H265RawSliceHeader *sh  = &slice->header;
+        int col = t % l->cols, row = t / l->cols;
+        /* tiles of a frame differ in size as they do in real streams */
+        int size = slice_size / 2 + av_lfg_get(lfg) % slice_size;
+
+        sh->nal_unit_header.nal_unit_type = idr ? HEVC_NAL_IDR_W_RADL :
+                                                  HEVC_NAL_TRAIL_R;
+        sh->nal_unit_header.nuh_temporal_id_plus1 = 1;
+        sh->slice_segment_address = l->row_ctb[row] * CTB_W + l->col_ctb[col];
+        sh->first_slice_segment_in_pic_flag = !sh->slice_segment_address;
+        sh->slice_type             = HEVC_SLICE_I;
+        sh->slice_pic_order_cnt_lsb = poc & 0xff;
+        sh->slice_sao_luma_flag    = 1;
+        sh->slice_sao_chroma_flag  = 1;
+        sh->slice_qp_delta         = t % 5 - 2;
+
+        fill_data(data, size, lfg);
+        slice->data      = data;
+        slice->data_size = size;
+        data += size;
+
+        ret = ff_cbs_insert_unit_content(frag, -1, sh->nal_unit_header.nal_unit_type,
+                                         slice, NULL);
+    }
+
+    if (ret >= 0)
+        ret = ff_cbs_write_packet(cbc, pkt, frag);
+    ff_cbs_fragment_reset(frag);
+    av_free(slices);
+    return ret;
+}
+
+static int run(const char *name, int cols, int rows, int nb_frames,
+               int intra, int frame_size, int threads)
+{
+    const AVBitStreamFilter *filter = av_bsf_get_by_name("hevc_frame_split");
+    int nb_tiles = cols * rows;
+    CodedBitstreamContext *cbc = NULL;
+    CodedBitstreamFragment frag = { 0 };
+    AVPacket **frames = NULL, *tmp = NULL;
+    AVBSFContext *bsf = NULL;
+    uint8_t *data = NULL;
+    int64_t t_total = 0, t0;
+    int64_t bytes = 0;
+    Layout l;
+    AVLFG lfg;
+    int ret;
+
+    if (!filter)
+        return AVERROR_BSF_NOT_FOUND;
+
+    init_layout(&l, cols, rows);
+    av_lfg_init(&lfg, 0x4e49 + nb_tiles);
+
+    frames = av_calloc(nb_frames, sizeof(*frames));
+    data   = av_malloc(frame_size * 2 + nb_tiles);
+    tmp    = av_packet_alloc();
+    if (!frames || !data || !tmp) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    ret = ff_cbs_init(&cbc, AV_CODEC_ID_HEVC, NULL);
+    if (ret < 0)
+        goto finish;
+    for (int i = 0; i < nb_frames; i++) {
+        frames[i] = av_packet_alloc();
+        if (!frames[i]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        ret = synth_frame(cbc, &frag, &l, i, intra, frame_size / nb_tiles,
+                          data, &lfg, frames[i]);
+        if (ret < 0)
+            goto finish;
+        bytes += frames[i]->size;
+    }
+
+    ret = av_bsf_alloc(filter, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_HEVC;
+    /* the parameter sets of the first frame */
+    bsf->par_in->extradata = av_mallocz(frames[0]->size +
+                                        AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!bsf->par_in->extradata) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+    memcpy(bsf->par_in->extradata, frames[0]->data, frames[0]->size);
+    bsf->par_in->extradata_size = frames[0]->size;
+    av_opt_set_int(bsf->priv_data, "threads", threads, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    for (int i = 0; i < nb_frames; i++) {
+        int n = 0;
+
+        t0  = av_gettime_relative();
+        ret = av_packet_ref(tmp, frames[i]);
+        if (ret >= 0)
+            ret = av_bsf_send_packet(bsf, tmp);
+        while (ret >= 0) {
+            ret = av_bsf_receive_packet(bsf, tmp);
+            if (ret < 0)
+                break;
+            n++;
+            av_packet_unref(tmp);
+        }
+        t_total += av_gettime_relative() - t0;
+        if (ret != AVERROR(EAGAIN))
+            goto finish;
+
+        if (n != nb_tiles) {
+            fprintf(stderr, "%s %dx%d: frame %d split into %d packets\n",
+                    name, cols, rows, i, n);
+            ret = AVERROR_BUG;
+            goto finish;
+        }
+    }
+    ret = 0;
+
+    printf("%s %dx%d tiles %6.2f MB/frame: %7.1f fps\n",
+           name, cols, rows, bytes / (double)nb_frames / (1 << 20),
+           nb_frames * 1000000.0 / t_total);
+
+finish:
+    av_bsf_free(&bsf);
+    ff_cbs_fragment_free(&frag);
+    ff_cbs_close(&cbc);
+    for (int i = 0; frames && i < nb_frames; i++)
+        av_packet_free(&frames[i]);
+    av_free(frames);
+    av_free(data);
+    av_packet_free(&tmp);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int layouts[][2] = { { 2, 1 }, { 2, 2 }, { 4, 2 }, { 4, 4 }, { 8, 4 } };
+    int nb_frames  = argc > 1 ? atoi(argv[1]) : 30;
+    int intra_size = argc > 2 ? atoi(argv[2]) : 1 << 20;
+    int inter_size = argc > 3 ? atoi(argv[3]) : 100 << 10;
+    int threads    = argc > 4 ? atoi(argv[4]) : 0;
+    int ret = 0;
+
+    if (nb_frames <= 0 || intra_size < 64 * MAX_TILES ||
+        inter_size < 64 * MAX_TILES || threads < 0) {
+        fprintf(stderr, "Usage: %s [nb_frames [intra_size [inter_size [threads]]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(layouts); i++)
+        ret = run("intra", layouts[i][0], layouts[i][1], nb_frames, 1, intra_size,
+                  threads);
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(layouts); i++)
+        ret = run("inter", layouts[i][0], layouts[i][1], nb_frames, 0, inter_size,
+                  threads);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
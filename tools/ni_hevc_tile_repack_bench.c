@@ -0,0 +1,232 @@
+/*
+ * NETINT HEVC tile repack benchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark of the hevc_tile_repack bitstream filter.
+ *
+ * Frames of 2 to 64 tiles are synthesized the way the tile encoders emit
+ * them: the first tile with its parameter sets, every other tile with
+ * parameter sets, SEI and one or two slices. The time the filter takes to
+ * repack a frame is reported, including the av_bsf_send_packet() and
+ * av_bsf_receive_packet() round trips of all its tiles. The repacked
+ * frames are checked by the fate-hevc-tile-repack test.
+ *
+ * Usage: ni_hevc_tile_repack_bench [frame_size [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/bsf.h"
+#include "libavcodec/packet.h"
+
+#define MAX_TILES 64
+
+enum {
+    NAL_TRAIL_R    = 1,
+    NAL_IDR_W_RADL = 19,
+    NAL_VPS        = 32,
+    NAL_SPS        = 33,
+    NAL_PPS        = 34,
+    NAL_SEI_PREFIX = 39,
+    NAL_SEI_SUFFIX = 40,
+};
+
+static uint8_t *put_nal(uint8_t *p, AVLFG *lfg, int type, int size)
+{
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 1;
+    *p++ = type << 1;
+    *p++ = 1;
+    /* no zero byte, so no emulated start code */
+    for (int i = 0; i < size; i++)
+        *p++ = av_lfg_get(lfg) % 255 + 1;
+    return p;
+}
+
+static int synth_tile(AVPacket *pkt, AVLFG *lfg, int idx, int slice_size,
+                      int intra)
+{
+    int slice_type = intra ? NAL_IDR_W_RADL : NAL_TRAIL_R;
+    int two_slices = idx % 3 == 1;
+    int *addr;
+    uint8_t *p;
+    int ret;
+
+    ret = av_new_packet(pkt, 256 + slice_size + 2 * 6);
+    if (ret < 0)
+        return ret;
+
+    p = put_nal(pkt->data, lfg, NAL_VPS, 20);
+    p = put_nal(p, lfg, NAL_SPS, 40);
+    p = put_nal(p, lfg, NAL_PPS, 10);
+    if (idx) {
+        p = put_nal(p, lfg, NAL_SEI_PREFIX, 24);
+        if (two_slices) {
+            p = put_nal(p, lfg, slice_type, slice_size / 2);
+            p = put_nal(p, lfg, slice_type, slice_size - slice_size / 2);
+        } else {
+            p = put_nal(p, lfg, slice_type, slice_size);
+        }
+        if (idx % 4 == 2)
+            p = put_nal(p, lfg, NAL_SEI_SUFFIX, 16);
+    } else {
+        p = put_nal(p, lfg, slice_type, slice_size);
+    }
+    av_shrink_packet(pkt, p - pkt->data);
+
+    addr = (int *)av_packet_new_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                          sizeof(*addr));
+    if (!addr)
+        return AVERROR(ENOMEM);
+    *addr = idx;
+    if (intra)
+        pkt->flags |= AV_PKT_FLAG_KEY;
+    return 0;
+}
+
+static int repack(AVBSFContext *bsf, AVPacket **tiles, int nb_tiles,
+                  int reverse, int64_t pts, AVPacket *tmp, AVPacket *out)
+{
+    int ret;
+
+    for (int i = 0; i < nb_tiles; i++) {
+        ret = av_packet_ref(tmp, tiles[reverse ? nb_tiles - 1 - i : i]);
+        if (ret < 0)
+            return ret;
+        tmp->pts = tmp->dts = pts;
+        ret = av_bsf_send_packet(bsf, tmp);
+        if (ret < 0)
+            return ret;
+        ret = av_bsf_receive_packet(bsf, out);
+        if (i < nb_tiles - 1) {
+            if (ret != AVERROR(EAGAIN))
+                return ret < 0 ? ret : AVERROR_BUG;
+        } else if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int run(int nb_tiles, int frame_size, int intra, int iterations)
+{
+    const AVBitStreamFilter *filter = av_bsf_get_by_name("hevc_tile_repack");
+    AVPacket *tiles[MAX_TILES] = { NULL };
+    AVBSFContext *bsf = NULL;
+    AVPacket *tmp = NULL, *out = NULL;
+    int64_t t_total = 0, t0;
+    int out_size = 0;
+    AVLFG lfg;
+    int ret;
+
+    if (!filter)
+        return AVERROR_BSF_NOT_FOUND;
+
+    av_lfg_init(&lfg, 0x4e49 + nb_tiles);
+    for (int i = 0; i < nb_tiles; i++) {
+        tiles[i] = av_packet_alloc();
+        if (!tiles[i]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        ret = synth_tile(tiles[i], &lfg, i, frame_size / nb_tiles, intra);
+        if (ret < 0)
+            goto finish;
+    }
+
+    tmp = av_packet_alloc();
+    out = av_packet_alloc();
+    if (!tmp || !out) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    ret = av_bsf_alloc(filter, &bsf);
+    if (ret < 0)
+        goto finish;
+    bsf->par_in->codec_id = AV_CODEC_ID_HEVC;
+    av_opt_set_int(bsf->priv_data, "tile_num", nb_tiles, 0);
+    ret = av_bsf_init(bsf);
+    if (ret < 0)
+        goto finish;
+
+    for (int i = 0; i < iterations; i++) {
+        /* tiles may come in any order */
+        t0  = av_gettime_relative();
+        ret = repack(bsf, tiles, nb_tiles, i & 1, i, tmp, out);
+        t_total += av_gettime_relative() - t0;
+        if (ret < 0)
+            goto finish;
+        out_size = out->size;
+        av_packet_unref(out);
+    }
+
+    printf("%2d tiles %s %8d bytes: %8.2f us/frame\n",
+           nb_tiles, intra ? "intra" : "inter", out_size,
+           (double)t_total / iterations);
+
+finish:
+    av_bsf_free(&bsf);
+    av_packet_free(&tmp);
+    av_packet_free(&out);
+    for (int i = 0; i < nb_tiles; i++)
+        av_packet_free(&tiles[i]);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int frame_size = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    int ret = 0;
+
+    if (frame_size < MAX_TILES || iterations <= 0) {
+        fprintf(stderr, "Usage: %s [frame_size [iterations]]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int intra = 1; ret >= 0 && intra >= 0; intra--) {
+        /* inter frames are a tenth of the size */
+        int size = intra ? frame_size : frame_size / 10;
+
+        for (int nb_tiles = 2; ret >= 0 && nb_tiles <= MAX_TILES; nb_tiles *= 2)
+            ret = run(nb_tiles, size, intra, iterations);
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * NETINT Quadra roi post-processing benchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark of the YOLO post-processing of the ni_quadra_roi filter,
+ * without hardware.
+ *
+ * Frames come from a layer dump recorded with the layer_dump option of the
+ * filter, or are synthesized for scenes where 1% to 50% of the anchors
+ * hold an object. The time per frame of libavfilter/ni_yolo.c is reported;
+ * the fate-ni-quadra-yolo test checks its regions of interest.
+ *
+ * Usage: ni_yolo_bench [obj_thresh [nms_thresh [dump_file]]]
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/ni_yolo.h"
+
+#define MAX_LAYERS 8
+
+/* human face model of the filter */
+static const int32_t masks[2][3] = {{3, 4, 5}, {0, 1, 2}};
+static const float biases[] = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
+
+typedef struct Frame {
+    int netw, neth;
+    int nb_layers;
+    ni_roi_network_layer_t layers[MAX_LAYERS];
+} Frame;
+
+/* Frames */
+
+static void free_frame(Frame *f)
+{
+    for (int i = 0; i < f->nb_layers; i++)
+        av_freep(&f->layers[i].output);
+    f->nb_layers = 0;
+}
+
+static int init_layer(ni_roi_network_layer_t *l, int idx, int width,
+                      int height, int channel)
+{
+    if (width <= 0 || height <= 0 || channel < 3 * 6 || channel % 3 ||
+        (int64_t)width * height * channel > INT_MAX / sizeof(float))
+        return AVERROR_INVALIDDATA;
+
+    memset(l, 0, sizeof(*l));
+    l->width         = width;
+    l->height        = height;
+    l->channel       = channel;
+    l->component     = 3;
+    l->classes       = channel / l->component - 5;
+    l->output_number = width * height * channel;
+    memcpy(l->mask, masks[idx < 2 ? idx : 1], sizeof(l->mask));
+    memcpy(l->biases, biases, sizeof(l->biases));
+
+    l->output = av_malloc_array(l->output_number, sizeof(*l->output));
+    return l->output ? 0 : AVERROR(ENOMEM);
+}
+
+static int read_frame(FILE *in, Frame *f)
+{
+    int ret = ff_ni_yolo_read_layers(in, f->layers, MAX_LAYERS,
+                                     &f->nb_layers, &f->netw, &f->neth);
+
+    for (int i = 0; i < f->nb_layers; i++) {
+        memcpy(f->layers[i].mask, masks[i < 2 ? i : 1], sizeof(f->layers[i].mask));
+        memcpy(f->layers[i].biases, biases, sizeof(f->layers[i].biases));
+    }
+    return ret;
+}
+
+static float uniform(AVLFG *lfg, float lo, float hi)
+{
+    return lo + (hi - lo) * (av_lfg_get(lfg) / 4294967296.0f);
+}
+
+/* a 416x416 face network where density of the anchors hold an object */
+static int synth_frame(Frame *f, AVLFG *lfg, float density)
+{
+    static const int sizes[2] = { 13, 26 };
+    int ret;
+
+    f->netw = f->neth = 416;
+    for (int i = 0; i < 2; i++) {
+        ni_roi_network_layer_t *l = &f->layers[i];
+        int wh;
+
+        ret = init_layer(l, i, sizes[i], sizes[i], 3 * (5 + 1));
+        if (ret < 0)
+            return ret;
+        f->nb_layers++;
+
+        wh = l->width * l->height;
+        for (int n = 0; n < l->component; n++) {
+            float *p = l->output + n * wh * (5 + l->classes);
+            for (int j = 0; j < wh; j++) {
+                p[0 * wh + j] = uniform(lfg, -3.0f, 3.0f);
+                p[1 * wh + j] = uniform(lfg, -3.0f, 3.0f);
+                p[2 * wh + j] = uniform(lfg, -1.5f, 0.5f);
+                p[3 * wh + j] = uniform(lfg, -1.5f, 0.5f);
+                p[4 * wh + j] = uniform(lfg, 0.0f, 1.0f) < density ?
+                                uniform(lfg, -1.0f, 4.0f) :
+                                uniform(lfg, -12.0f, -2.0f);
+                for (int k = 0; k < l->classes; k++)
+                    p[(5 + k) * wh + j] = uniform(lfg, -1.0f, 4.0f);
+            }
+        }
+    }
+    return 0;
+}
+
+static int run(const char *name, Frame *frames, int nb_frames,
+               float obj_thresh, float nms_thresh)
+{
+    NIYoloContext y;
+    int64_t t_total = 0;
+    int64_t nb_dets = 0, nb_rois = 0;
+    int nb_runs = 0;
+    int ret;
+
+    ret = ff_ni_yolo_init(&y);
+    if (ret < 0)
+        return ret;
+
+    do {
+        for (int i = 0; i < nb_frames; i++) {
+            struct roi_box *boxes;
+            int nb_boxes;
+            int64_t t0;
+
+            t0  = av_gettime_relative();
+            ret = ff_ni_yolo_get_detections(NULL, &y, frames[i].layers,
+                                            frames[i].nb_layers, frames[i].netw,
+                                            frames[i].neth, 1920, 1080,
+                                            obj_thresh, nms_thresh,
+                                            &boxes, &nb_boxes);
+            t_total += av_gettime_relative() - t0;
+            if (ret < 0)
+                goto finish;
+            av_free(boxes);
+
+            nb_dets += y.det_cache.dets_num;
+            nb_rois += nb_boxes;
+        }
+        nb_runs++;
+    } while (t_total < 500000);
+
+    printf("%-12s dets/frame=%-7.1f rois/frame=%-6.1f %9.1f us/frame\n",
+           name, (double)nb_dets / (nb_runs * nb_frames),
+           (double)nb_rois / (nb_runs * nb_frames),
+           (double)t_total / (nb_runs * nb_frames));
+
+finish:
+    ff_ni_yolo_uninit(&y);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    float obj_thresh = argc > 1 ? strtof(argv[1], NULL) : 0.25f;
+    float nms_thresh = argc > 2 ? strtof(argv[2], NULL) : 0.45f;
+    Frame *frames    = NULL;
+    int nb_frames    = 0;
+    int ret          = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    if (argc > 3) {
+        FILE *in = fopen(argv[3], "rb");
+        if (!in) {
+            fprintf(stderr, "Cannot open %s\n", argv[3]);
+            return 1;
+        }
+        for (;;) {
+            Frame *tmp = av_realloc_array(frames, nb_frames + 1, sizeof(*frames));
+            if (!tmp) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            frames = tmp;
+            memset(&frames[nb_frames], 0, sizeof(*frames));
+            ret = read_frame(in, &frames[nb_frames]);
+            if (ret < 0)
+                break;
+            nb_frames++;
+        }
+        fclose(in);
+        if (ret != AVERROR_EOF)
+            free_frame(&frames[nb_frames]);
+        else
+            ret = nb_frames ? 0 : AVERROR_INVALIDDATA;
+        if (ret >= 0)
+            ret = run(argv[3], frames, nb_frames, obj_thresh, nms_thresh);
+    } else {
+        static const float densities[] = { 0.01f, 0.05f, 0.2f, 0.5f };
+        AVLFG lfg;
+
+        av_lfg_init(&lfg, 0x4e49);
+        frames = av_calloc(4, sizeof(*frames));
+        if (!frames)
+            ret = AVERROR(ENOMEM);
+        for (int d = 0; ret >= 0 && d < FF_ARRAY_ELEMS(densities); d++) {
+            char name[32];
+
+            for (nb_frames = 0; ret >= 0 && nb_frames < 4; nb_frames++)
+                ret = synth_frame(&frames[nb_frames], &lfg, densities[d]);
+            snprintf(name, sizeof(name), "busy=%.0f%%", densities[d] * 100);
+            if (ret >= 0)
+                ret = run(name, frames, nb_frames, obj_thresh, nms_thresh);
+            for (int i = 0; i < nb_frames; i++)
+                free_frame(&frames[i]);
+        }
+        nb_frames = 0;
+    }
+
+    for (int i = 0; i < nb_frames; i++)
+        free_frame(&frames[i]);
+    av_free(frames);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
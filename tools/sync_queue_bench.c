@@ -0,0 +1,130 @@
+/*
+ * SyncQueue microbenchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Microbenchmark for the fftools SyncQueue with many streams.
+ *
+ * Packets are sent round-robin for all the streams, with slightly different
+ * durations per stream, and everything that can be output is received after
+ * every send, the way the muxer uses the queue. The time per packet is
+ * reported for 1 to 256 streams.
+ *
+ * Usage: sync_queue_bench [nb_packets_per_stream [max_streams]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+
+#include "libavutil/error.h"
+#include "libavutil/time.h"
+
+#include "fftools/sync_queue.h"
+
+static int run(unsigned nb_streams, unsigned nb_packets)
+{
+    SyncQueue *sq;
+    AVPacket *pkt;
+    int64_t  *pts;
+    uint64_t nb_received = 0;
+    int64_t  t0, t1;
+    int ret = 0;
+
+    sq  = sq_alloc(SYNC_QUEUE_PACKETS, INT64_MAX, NULL);
+    pkt = av_packet_alloc();
+    pts = calloc(nb_streams, sizeof(*pts));
+    if (!sq || !pkt || !pts) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        ret = sq_add_stream(sq, 1);
+        if (ret < 0)
+            goto finish;
+    }
+
+    t0 = av_gettime_relative();
+
+    for (unsigned n = 0; n < nb_packets; n++) {
+        for (unsigned i = 0; i < nb_streams; i++) {
+            pkt->time_base = (AVRational){ 1, 48000 };
+            pkt->duration  = 1024 + 16 * (i % 8);
+            pkt->pts       = pkt->dts = pts[i];
+            pts[i]        += pkt->duration;
+
+            ret = sq_send(sq, i, SQPKT(pkt));
+            if (ret < 0)
+                goto finish;
+
+            while ((ret = sq_receive(sq, -1, SQPKT(pkt))) >= 0) {
+                nb_received++;
+                av_packet_unref(pkt);
+            }
+            if (ret != AVERROR(EAGAIN))
+                goto finish;
+        }
+    }
+
+    for (unsigned i = 0; i < nb_streams; i++)
+        sq_send(sq, i, SQPKT(NULL));
+    while ((ret = sq_receive(sq, -1, SQPKT(pkt))) >= 0) {
+        nb_received++;
+        av_packet_unref(pkt);
+    }
+    ret = ret == AVERROR_EOF ? 0 : ret;
+
+    t1 = av_gettime_relative();
+
+    printf("streams=%-4u packets=%-9"PRIu64" %8.1f ns/packet\n",
+           nb_streams, nb_received,
+           (t1 - t0) * 1e3 / (nb_received ? nb_received : 1));
+
+finish:
+    sq_free(&sq);
+    av_packet_free(&pkt);
+    free(pts);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned nb_packets  = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+    unsigned max_streams = argc > 2 ? strtoul(argv[2], NULL, 0) : 256;
+
+    if (!nb_packets || !max_streams) {
+        fprintf(stderr, "Usage: %s [nb_packets_per_stream [max_streams]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (unsigned nb_streams = 1; nb_streams <= max_streams; nb_streams *= 2) {
+        int ret = run(nb_streams, nb_packets);
+        if (ret < 0) {
+            fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * ThreadQueue microbenchmark
+ * Copyright (c) 2026 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Microbenchmark for the fftools ThreadQueue implementations.
+ *
+ * A number of producer threads send packets to a single consumer thread, each
+ * producer on its own stream, like encoders feeding a muxer. The throughput,
+ * the number of times either side had to block and the number of wakeups are
+ * reported for every queue type.
+ *
+ * Usage: thread_queue_bench [nb_producers [nb_packets [queue_size]]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "fftools/objpool.h"
+#include "fftools/thread_queue.h"
+
+typedef struct Producer {
+    ThreadQueue *tq;
+    unsigned     idx;
+    unsigned     nb_packets;
+    AVPacket    *src;
+    int          ret;
+} Producer;
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void *producer_thread(void *arg)
+{
+    Producer *p = arg;
+    AVPacket *pkt = av_packet_alloc();
+
+    if (!pkt) {
+        p->ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (unsigned i = 0; i < p->nb_packets; i++) {
+        p->ret = av_packet_ref(pkt, p->src);
+        if (p->ret < 0)
+            break;
+        pkt->pts = i;
+
+        p->ret = tq_send(p->tq, p->idx, pkt);
+        if (p->ret < 0)
+            break;
+    }
+
+finish:
+    tq_send_finish(p->tq, p->idx);
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+static int run(enum ThreadQueueType type, unsigned nb_producers,
+               unsigned nb_packets, unsigned queue_size, AVPacket *src)
+{
+    static const char *type_names[] = {
+        [THREAD_QUEUE_MUTEX]    = "mutex",
+        [THREAD_QUEUE_LOCKFREE] = "lockfree",
+    };
+
+    Producer *producers = NULL;
+    pthread_t  *threads = NULL;
+    ThreadQueue     *tq = NULL;
+    AVPacket       *pkt = NULL;
+    ObjPool         *op;
+    ThreadQueueStats st;
+    uint64_t nb_received = 0;
+    int64_t  t0, t1;
+    int ret = 0, stream_idx;
+
+    op = objpool_alloc_packets();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    tq = tq_alloc(nb_producers, queue_size, op, pkt_move, type);
+    if (!tq) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+
+    pkt       = av_packet_alloc();
+    producers = calloc(nb_producers, sizeof(*producers));
+    threads   = calloc(nb_producers, sizeof(*threads));
+    if (!pkt || !producers || !threads) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    t0 = av_gettime_relative();
+
+    for (unsigned i = 0; i < nb_producers; i++) {
+        producers[i] = (Producer){ .tq = tq, .idx = i,
+                                   .nb_packets = nb_packets, .src = src };
+        ret = pthread_create(&threads[i], NULL, producer_thread, &producers[i]);
+        if (ret) {
+            fprintf(stderr, "pthread_create() failed\n");
+            exit(1);
+        }
+    }
+
+    while (1) {
+        ret = tq_receive(tq, &stream_idx, pkt);
+        if (ret == AVERROR_EOF && stream_idx < 0)
+            break;
+        if (ret >= 0) {
+            nb_received++;
+            av_packet_unref(pkt);
+        }
+    }
+    ret = 0;
+
+    t1 = av_gettime_relative();
+
+    for (unsigned i = 0; i < nb_producers; i++) {
+        pthread_join(threads[i], NULL);
+        if (producers[i].ret < 0)
+            ret = producers[i].ret;
+    }
+
+    tq_stats(tq, &st);
+
+    printf("%-8s producers=%-3u queue=%-4u packets=%-9"PRIu64" "
+           "%10.0f pkt/s  send_waits=%-8"PRIu64" recv_waits=%-8"PRIu64" "
+           "wakeups=%-8"PRIu64" allocs=%"PRIu64"\n",
+           type_names[type], nb_producers, queue_size, nb_received,
+           nb_received * 1e6 / FFMAX(t1 - t0, 1),
+           st.nb_send_waits, st.nb_recv_waits, st.nb_wakeups,
+           st.pool.nb_misses);
+
+finish:
+    tq_free(&tq);
+    av_packet_free(&pkt);
+    free(producers);
+    free(threads);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned nb_producers = argc > 1 ? strtoul(argv[1], NULL, 0) : 8;
+    unsigned nb_packets   = argc > 2 ? strtoul(argv[2], NULL, 0) : 200000;
+    unsigned queue_size   = argc > 3 ? strtoul(argv[3], NULL, 0) : 8;
+    AVPacket *src;
+    int ret = 0;
+
+    if (!nb_producers || !queue_size) {
+        fprintf(stderr, "Usage: %s [nb_producers [nb_packets [queue_size]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    src = av_packet_alloc();
+    if (!src || av_new_packet(src, 188) < 0)
+        return 1;
+
+    for (int type = THREAD_QUEUE_MUTEX; type <= THREAD_QUEUE_LOCKFREE; type++) {
+        ret = run(type, nb_producers, nb_packets, queue_size, src);
+        if (ret < 0)
+            break;
+    }
+
+    av_packet_free(&src);
+    return ret < 0;
+}